@@ -8,8 +8,11 @@ VLAD检索结果可视化工具
     python3 scripts/visualize_vlad_retrieval.py \\
         --vlad-dir ./vlad_cache --images ./images.json --output ./retrieval_report.html --top-k 10
 
-VLAD 文件格式 (.isat_vlad):
-    Magic: 0x44414C56 ("VLAD"), Version: uint32, Size: uint32, Data: float32[Size]
+VLAD 向量来源（按优先级）:
+    vlad_store.isat_vlads: isat_retrieve 写入的单文件向量库（IDC 容器，blobs: keys uint32[N],
+        vectors float32[N, D]；有 PCA 时为 PCA 后向量）
+    {image_id}.isat_vlad（旧版每图缓存）:
+        Magic: 0x44414C56 ("VLAD"), Version: uint32, Size: uint32, Data: float32[Size]
 """
 
 import argparse
@@ -61,6 +64,29 @@ def load_vlad_cache(vlad_path: str) -> Optional[np.ndarray]:
         return None
 
 
+def load_vlad_store(store_path: Path) -> dict:
+    """加载单文件 VLAD 向量库，返回 {image_id(str): vector}；不存在或格式不符返回空 dict。"""
+    if not store_path.exists():
+        return {}
+    data = store_path.read_bytes()
+    magic, _version, json_size = struct.unpack_from('<IIQ', data, 0)
+    if magic != 0x54415349:  # "ISAT"
+        print(f"Warning: Invalid IDC file (wrong magic): {store_path}")
+        return {}
+    meta = json.loads(data[16:16 + json_size].decode('utf-8'))
+    if meta.get('format') != 'isat_vlad_store':
+        return {}
+    payload = 16 + json_size
+    payload += (8 - payload % 8) % 8
+    blobs = {b['name']: b for b in meta.get('blobs', [])}
+    count, dim = int(meta['count']), int(meta['dim'])
+    keys = np.frombuffer(data, dtype=np.uint32, count=count, offset=payload + blobs['keys']['offset'])
+    vectors = np.frombuffer(data, dtype=np.float32, count=count * dim,
+                            offset=payload + blobs['vectors']['offset']).reshape(count, dim)
+    print(f"Loaded VLAD store {store_path}: {count} vectors, dim={dim}")
+    return {str(int(k)): vectors[i] for i, k in enumerate(keys)}
+
+
 def compute_l2_distance(v1: np.ndarray, v2: np.ndarray) -> float:
     return float(np.linalg.norm(v1 - v2))
 
@@ -86,10 +112,14 @@ def load_images_from_json(json_path: str, vlad_dir: str) -> List[ImageInfo]:
     return images
 
 
-def load_vlad_vectors(images: List[ImageInfo]) -> List[ImageInfo]:
-    """为图像列表加载 VLAD 向量，返回有效子集。"""
+def load_vlad_vectors(images: List[ImageInfo], store: Optional[dict] = None) -> List[ImageInfo]:
+    """为图像列表加载 VLAD 向量（优先取向量库），返回有效子集。"""
     valid = []
     for img in images:
+        if store and img.image_id in store:
+            img.vlad_vector = store[img.image_id]
+            valid.append(img)
+            continue
         if not img.vlad_file or not Path(img.vlad_file).exists():
             print(f"Warning: VLAD file not found for {img.image_id}: {img.vlad_file}")
             continue
@@ -222,7 +252,7 @@ def main() -> int:
   python3 scripts/visualize_vlad_retrieval.py --vlad-dir ./vlad_cache --images ./images.json --output report.html --top-k 5 --max-queries 10
 """,
     )
-    parser.add_argument("--vlad-dir", required=True, help="VLAD 缓存目录 (包含 *.isat_vlad)")
+    parser.add_argument("--vlad-dir", required=True, help="VLAD 缓存目录 (包含 vlad_store.isat_vlads 或旧版 *.isat_vlad)")
     parser.add_argument("--images", required=True, help="图像列表 JSON 文件")
     parser.add_argument("--output", required=True, help="输出 HTML 文件路径")
     parser.add_argument("--top-k", type=int, default=10, help="每个查询的检索结果数量 (默认: 10)")
@@ -240,7 +270,8 @@ def main() -> int:
     if not images:
         print("Error: No images loaded")
         return 1
-    images = load_vlad_vectors(images)
+    store = load_vlad_store(Path(args.vlad_dir) / "vlad_store.isat_vlads")
+    images = load_vlad_vectors(images, store)
     if not images:
         print("Error: No valid VLAD vectors loaded")
         return 1
@@ -6,8 +6,13 @@
 namespace insight {
 namespace io {
 
-IDCReader::IDCReader(const std::string& filepath) : filepath_(filepath) {
-  is_valid_ = parse_header();
+IDCReader::IDCReader(const std::string& filepath, IDCReadMode mode) : filepath_(filepath) {
+  if (mode == IDCReadMode::kMapped) {
+    mapped_ = MappedFile::open(filepath);
+    is_valid_ = mapped_ && parse_mapped_header();
+  } else {
+    is_valid_ = parse_header();
+  }
 
   if (!is_valid_) {
     LOG(ERROR) << "Failed to parse IDC file: " << filepath;
@@ -52,6 +57,43 @@ bool IDCReader::parse_header() {
     return false;
   }
 
+  return finish_header(json_str, json_size);
+}
+
+bool IDCReader::parse_mapped_header() {
+  const uint8_t* base = mapped_->data();
+  const size_t file_size = mapped_->size();
+  constexpr size_t kFixedHeader = 4 + 4 + 8;
+  if (file_size < kFixedHeader) {
+    LOG(ERROR) << "File too small for IDC header: " << filepath_;
+    return false;
+  }
+
+  uint32_t magic;
+  std::memcpy(&magic, base, sizeof(magic));
+  if (magic != MAGIC_NUMBER) {
+    LOG(ERROR) << "Invalid magic number: " << std::hex << magic << " (expected " << MAGIC_NUMBER
+               << ")";
+    return false;
+  }
+  uint32_t version;
+  std::memcpy(&version, base + 4, sizeof(version));
+  if (version != FORMAT_VERSION) {
+    LOG(WARNING) << "Format version mismatch: " << version << " (expected " << FORMAT_VERSION
+                 << ")";
+  }
+  uint64_t json_size;
+  std::memcpy(&json_size, base + 8, sizeof(json_size));
+  if (json_size > file_size - kFixedHeader) {
+    LOG(ERROR) << "Failed to read JSON descriptor";
+    return false;
+  }
+  const std::string json_str(reinterpret_cast<const char*>(base + kFixedHeader),
+                             static_cast<size_t>(json_size));
+  return finish_header(json_str, json_size);
+}
+
+bool IDCReader::finish_header(const std::string& json_str, uint64_t json_size) {
   // 5. Parse JSON
   try {
     metadata_ = nlohmann::json::parse(json_str);
@@ -172,6 +214,14 @@ std::vector<uint8_t> IDCReader::read_full_payload() const {
 }
 
 void IDCReader::read_full_payload_into(std::vector<uint8_t>& buf) const {
+  if (mapped_) {
+    if (mapped_->size() <= payload_offset_) {
+      buf.clear();
+      return;
+    }
+    buf.assign(mapped_->data() + payload_offset_, mapped_->data() + mapped_->size());
+    return;
+  }
   std::ifstream file(filepath_, std::ios::binary | std::ios::ate);
   if (!file.is_open()) {
     LOG(ERROR) << "read_full_payload: cannot open " << filepath_;
@@ -212,5 +262,21 @@ const uint8_t* IDCReader::get_blob_from_payload(const std::string& blob_name,
   return payload.data() + offset;
 }
 
+const uint8_t* IDCReader::mapped_blob_bytes(const std::string& blob_name, size_t* out_size) const {
+  *out_size = 0;
+  auto it = blob_index_.find(blob_name);
+  if (it == blob_index_.end()) {
+    LOG(ERROR) << "Blob '" << blob_name << "' not found in " << filepath_;
+    return nullptr;
+  }
+  const size_t begin = payload_offset_ + it->second.offset;
+  if (begin > mapped_->size() || it->second.size > mapped_->size() - begin) {
+    LOG(ERROR) << "Blob '" << blob_name << "' out of file bounds in " << filepath_;
+    return nullptr;
+  }
+  *out_size = it->second.size;
+  return mapped_->data() + begin;
+}
+
 } // namespace io
 } // namespace insight
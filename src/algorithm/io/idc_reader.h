@@ -2,6 +2,7 @@
 
 #include <Eigen/Core>
 #include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <glog/logging.h>
 #include <memory>
@@ -11,12 +12,35 @@
 #include <unordered_map>
 #include <vector>
 
+#include "mapped_file.h"
+
 namespace insight {
 namespace io {
 
 // Forward declaration
 struct DescriptorSchema;
 
+/**
+ * Typed, read-only view into a blob of a memory-mapped IDC file (span-style).
+ * Valid as long as the owning IDCReader (or a copy of its MappedFile handle) is alive.
+ */
+template <typename T> struct BlobView {
+  const T* ptr = nullptr;
+  size_t count = 0;
+
+  const T* data() const { return ptr; }
+  size_t size() const { return count; }
+  size_t size_bytes() const { return count * sizeof(T); }
+  bool empty() const { return count == 0; }
+  const T* begin() const { return ptr; }
+  const T* end() const { return ptr + count; }
+  const T& operator[](size_t i) const { return ptr[i]; }
+};
+
+/// kStream: header parsed with ifstream, every read_blob() reopens the file (legacy behaviour).
+/// kMapped: file mmap'd once; view_blob() returns zero-copy views, read_blob() copies from the map.
+enum class IDCReadMode { kStream, kMapped };
+
 /**
  * IDC (Insight Data Container) Reader
  *
@@ -30,17 +54,26 @@ struct DescriptorSchema;
  */
 class IDCReader {
 public:
-  explicit IDCReader(const std::string& filepath);
+  explicit IDCReader(const std::string& filepath, IDCReadMode mode = IDCReadMode::kStream);
   ~IDCReader() = default;
 
   const nlohmann::json& get_metadata() const { return metadata_; }
   nlohmann::json get_blob_descriptor(const std::string& blob_name) const;
+  bool has_blob(const std::string& blob_name) const { return blob_index_.count(blob_name) != 0; }
   std::vector<uint8_t> read_blob_raw(const std::string& blob_name);
   template <typename T> std::vector<T> read_blob(const std::string& blob_name);
   size_t get_payload_offset() const { return payload_offset_; }
   bool is_valid() const { return is_valid_; }
   std::optional<DescriptorSchema> get_descriptor_schema() const;
 
+  // Zero-copy API (kMapped only). All methods are const and the mapping is immutable, so one
+  // reader may be shared across threads. Returns an empty view (and logs) when the blob is
+  // missing, out of bounds, not a multiple of sizeof(T) or misaligned for T.
+  bool is_mapped() const { return mapped_ != nullptr; }
+  template <typename T> BlobView<T> view_blob(const std::string& blob_name) const;
+  // Keeps the mapping alive beyond the reader's lifetime (e.g. for views held by a cache).
+  std::shared_ptr<const MappedFile> mapped_file() const { return mapped_; }
+
   // Block-load API: read entire payload in one sequential fread, then access
   // individual blobs via pointer arithmetic (zero seeks, zero copies).
   std::vector<uint8_t> read_full_payload() const;
@@ -58,6 +91,7 @@ private:
   nlohmann::json metadata_;
   size_t payload_offset_ = 0;
   bool is_valid_ = false;
+  std::shared_ptr<const MappedFile> mapped_;
 
   // O(1) blob lookup index: name → {offset, size}
   struct BlobInfo { size_t offset; size_t size; };
@@ -68,6 +102,10 @@ private:
   static constexpr size_t ALIGNMENT = 8;
 
   bool parse_header();
+  bool parse_mapped_header();
+  bool finish_header(const std::string& json_str, uint64_t json_size);
+  // Byte view of a blob inside the mapping; nullptr if absent or out of bounds.
+  const uint8_t* mapped_blob_bytes(const std::string& blob_name, size_t* out_size) const;
 };
 
 // Template implementation
@@ -87,6 +125,15 @@ template <typename T> std::vector<T> IDCReader::read_blob(const std::string& blo
   }
   const size_t n_elems = size / sizeof(T);
 
+  if (mapped_) {
+    size_t mapped_size = 0;
+    const uint8_t* src = mapped_blob_bytes(blob_name, &mapped_size);
+    if (!src) return {};
+    std::vector<T> data(n_elems);
+    std::memcpy(data.data(), src, size);
+    return data;
+  }
+
   std::ifstream file(filepath_, std::ios::binary);
   if (!file.is_open()) {
     LOG(ERROR) << "Failed to open file: " << filepath_;
@@ -102,5 +149,25 @@ template <typename T> std::vector<T> IDCReader::read_blob(const std::string& blo
   return data;
 }
 
+template <typename T> BlobView<T> IDCReader::view_blob(const std::string& blob_name) const {
+  if (!mapped_) {
+    LOG(ERROR) << "view_blob('" << blob_name << "') requires IDCReadMode::kMapped: " << filepath_;
+    return {};
+  }
+  size_t size = 0;
+  const uint8_t* src = mapped_blob_bytes(blob_name, &size);
+  if (!src) return {};
+  if (size % sizeof(T) != 0) {
+    LOG(ERROR) << "Blob size " << size << " not divisible by element size " << sizeof(T);
+    return {};
+  }
+  if (reinterpret_cast<uintptr_t>(src) % alignof(T) != 0) {
+    LOG(ERROR) << "Blob '" << blob_name << "' is not " << alignof(T) << "-byte aligned in "
+               << filepath_;
+    return {};
+  }
+  return BlobView<T>{reinterpret_cast<const T*>(src), size / sizeof(T)};
+}
+
 } // namespace io
 } // namespace insight
@@ -0,0 +1,120 @@
+#include "mapped_file.h"
+
+#include <glog/logging.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace insight {
+namespace io {
+
+#ifdef _WIN32
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& filepath,
+                                                   AccessHint hint) {
+  std::shared_ptr<MappedFile> mf(new MappedFile());
+  mf->filepath_ = filepath;
+
+  const DWORD flags = (hint == AccessHint::kSequential) ? FILE_FLAG_SEQUENTIAL_SCAN
+                      : (hint == AccessHint::kRandom)   ? FILE_FLAG_RANDOM_ACCESS
+                                                        : FILE_ATTRIBUTE_NORMAL;
+  HANDLE fh = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                          flags, nullptr);
+  if (fh == INVALID_HANDLE_VALUE) {
+    LOG(ERROR) << "MappedFile: cannot open " << filepath;
+    return nullptr;
+  }
+  mf->file_handle_ = fh;
+
+  LARGE_INTEGER sz;
+  if (!GetFileSizeEx(fh, &sz)) {
+    LOG(ERROR) << "MappedFile: cannot stat " << filepath;
+    return nullptr;
+  }
+  mf->size_ = static_cast<size_t>(sz.QuadPart);
+  if (mf->size_ == 0)
+    return mf;
+
+  HANDLE mh = CreateFileMappingA(fh, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mh) {
+    LOG(ERROR) << "MappedFile: CreateFileMapping failed for " << filepath;
+    return nullptr;
+  }
+  mf->mapping_handle_ = mh;
+
+  void* p = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+  if (!p) {
+    LOG(ERROR) << "MappedFile: MapViewOfFile failed for " << filepath;
+    return nullptr;
+  }
+  mf->data_ = static_cast<const uint8_t*>(p);
+  return mf;
+}
+
+MappedFile::~MappedFile() {
+  if (data_)
+    UnmapViewOfFile(data_);
+  if (mapping_handle_)
+    CloseHandle(static_cast<HANDLE>(mapping_handle_));
+  if (file_handle_)
+    CloseHandle(static_cast<HANDLE>(file_handle_));
+}
+
+#else
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& filepath,
+                                                   AccessHint hint) {
+  const int fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    LOG(ERROR) << "MappedFile: cannot open " << filepath;
+    return nullptr;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    LOG(ERROR) << "MappedFile: cannot stat " << filepath;
+    ::close(fd);
+    return nullptr;
+  }
+
+  std::shared_ptr<MappedFile> mf(new MappedFile());
+  mf->filepath_ = filepath;
+  mf->size_ = static_cast<size_t>(st.st_size);
+  if (mf->size_ == 0) {
+    ::close(fd);
+    return mf;
+  }
+
+  void* p = ::mmap(nullptr, mf->size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file; the descriptor is no longer needed.
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    LOG(ERROR) << "MappedFile: mmap failed for " << filepath << " (" << mf->size_ << " bytes)";
+    return nullptr;
+  }
+  mf->data_ = static_cast<const uint8_t*>(p);
+
+  if (hint == AccessHint::kSequential)
+    ::madvise(p, mf->size_, MADV_SEQUENTIAL);
+  else if (hint == AccessHint::kRandom)
+    ::madvise(p, mf->size_, MADV_RANDOM);
+  return mf;
+}
+
+MappedFile::~MappedFile() {
+  if (data_)
+    ::munmap(const_cast<uint8_t*>(data_), size_);
+}
+
+#endif
+
+} // namespace io
+} // namespace insight
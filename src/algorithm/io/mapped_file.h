@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace insight {
+namespace io {
+
+/**
+ * Read-only memory mapping of a whole file.
+ *
+ * The mapping is immutable for its whole lifetime, so a single instance can be
+ * shared between threads (typically through std::shared_ptr<const MappedFile>)
+ * without additional locking. Pages are faulted in lazily by the OS; no heap
+ * copy of the file is ever made.
+ *
+ * POSIX: open + mmap(PROT_READ, MAP_PRIVATE). Windows: CreateFileMapping +
+ * MapViewOfFile. An empty file maps successfully with data() == nullptr.
+ */
+class MappedFile {
+public:
+  enum class AccessHint {
+    kNormal,     // default readahead
+    kSequential, // large blocks scanned front-to-back (geopack / match packs)
+    kRandom,     // small blobs picked out of a large file
+  };
+
+  /// Returns nullptr (and logs) when the file cannot be opened or mapped.
+  static std::shared_ptr<const MappedFile> open(const std::string& filepath,
+                                                AccessHint hint = AccessHint::kNormal);
+
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+  const std::string& path() const { return filepath_; }
+
+private:
+  MappedFile() = default;
+
+  std::string filepath_;
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  void* file_handle_ = nullptr;
+  void* mapping_handle_ = nullptr;
+#endif
+};
+
+} // namespace io
+} // namespace insight
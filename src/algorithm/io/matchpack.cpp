@@ -0,0 +1,304 @@
+#include "matchpack.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+#include <glog/logging.h>
+
+#include "idc_writer.h"
+
+namespace fs = std::filesystem;
+
+namespace insight {
+namespace io {
+
+// ─────────────────────────────────────────────────────────────────────────────
+// MatchPackIndex
+// ─────────────────────────────────────────────────────────────────────────────
+
+std::string MatchPackIndex::pack_file_name_from_block_index(uint32_t block_index) {
+  std::ostringstream oss;
+  oss << "match_block_" << std::setfill('0') << std::setw(6) << block_index << ".isat_matchpack";
+  return oss.str();
+}
+
+bool MatchPackIndex::exists_in_dir(const std::string& match_dir) {
+  std::error_code ec;
+  return fs::is_regular_file(fs::path(match_dir) / kIndexFileName, ec);
+}
+
+size_t MatchPackIndex::remove_from_dir(const std::string& match_dir) {
+  std::error_code ec;
+  size_t removed = fs::remove(fs::path(match_dir) / kIndexFileName, ec) ? 1 : 0;
+  std::vector<fs::path> blocks;
+  for (fs::directory_iterator it(match_dir, ec), end; !ec && it != end; it.increment(ec)) {
+    const std::string name = it->path().filename().string();
+    if (name.rfind("match_block_", 0) == 0 && it->path().extension() == ".isat_matchpack")
+      blocks.push_back(it->path());
+  }
+  for (const auto& p : blocks) {
+    if (fs::remove(p, ec))
+      ++removed;
+  }
+  if (removed > 0)
+    LOG(INFO) << "MatchPack: removed " << removed << " stale pack file(s) from " << match_dir;
+  return removed;
+}
+
+uint64_t MatchPackIndex::pair_key(uint32_t image1_index, uint32_t image2_index) {
+  uint32_t lo = image1_index;
+  uint32_t hi = image2_index;
+  if (lo > hi)
+    std::swap(lo, hi);
+  return (static_cast<uint64_t>(lo) << 32) | static_cast<uint64_t>(hi);
+}
+
+bool MatchPackIndex::load_from_dir(const std::string& match_dir) {
+  valid_ = false;
+  match_dir_ = match_dir;
+  records_.clear();
+  by_pair_.clear();
+
+  const std::string index_path = (fs::path(match_dir) / kIndexFileName).string();
+  IDCReader reader(index_path, IDCReadMode::kMapped);
+  if (!reader.is_valid()) {
+    VLOG(1) << "MatchPack index not found: " << index_path;
+    return false;
+  }
+  const auto& meta = reader.get_metadata();
+  if (meta.value("record_size_bytes", 0) != static_cast<int>(sizeof(MatchPackIndexRecordV1))) {
+    LOG(ERROR) << "MatchPack index record size mismatch: " << index_path;
+    return false;
+  }
+  if (reader.has_blob(kIndexBlobName))
+    records_ = reader.read_blob<MatchPackIndexRecordV1>(kIndexBlobName);
+
+  by_pair_.reserve(records_.size());
+  for (size_t i = 0; i < records_.size(); ++i)
+    by_pair_[pair_key(records_[i].image1_index, records_[i].image2_index)] = i;
+
+  LOG(INFO) << "MatchPack index loaded: " << index_path << " pairs=" << records_.size()
+            << " blocks=" << meta.value("num_blocks", 0);
+  valid_ = true;
+  return true;
+}
+
+const MatchPackIndexRecordV1* MatchPackIndex::find(uint32_t image1_index,
+                                                   uint32_t image2_index) const {
+  const auto it = by_pair_.find(pair_key(image1_index, image2_index));
+  if (it == by_pair_.end())
+    return nullptr;
+  return &records_[it->second];
+}
+
+std::string MatchPackIndex::pack_path(uint32_t block_index) const {
+  return (fs::path(match_dir_) / pack_file_name_from_block_index(block_index)).string();
+}
+
+std::shared_ptr<const IDCReader> MatchPackIndex::open_block(uint32_t block_index) const {
+  {
+    std::lock_guard<std::mutex> lock(block_mutex_);
+    for (size_t i = 0; i < open_blocks_.size(); ++i) {
+      if (open_blocks_[i].first == block_index) {
+        auto hit = open_blocks_[i];
+        open_blocks_.erase(open_blocks_.begin() + static_cast<std::ptrdiff_t>(i));
+        open_blocks_.push_back(hit);
+        return hit.second;
+      }
+    }
+  }
+  // Map outside the lock; if two threads race on the same block the later insert is dropped.
+  auto reader = std::make_shared<const IDCReader>(pack_path(block_index), IDCReadMode::kMapped);
+  if (!reader->is_valid())
+    return nullptr;
+
+  std::lock_guard<std::mutex> lock(block_mutex_);
+  for (const auto& ob : open_blocks_) {
+    if (ob.first == block_index)
+      return ob.second;
+  }
+  open_blocks_.emplace_back(block_index, reader);
+  while (open_blocks_.size() > max_open_blocks_)
+    open_blocks_.erase(open_blocks_.begin());
+  return reader;
+}
+
+void MatchPackIndex::release_block(uint32_t block_index) const {
+  std::lock_guard<std::mutex> lock(block_mutex_);
+  open_blocks_.erase(std::remove_if(open_blocks_.begin(), open_blocks_.end(),
+                                    [block_index](const auto& ob) {
+                                      return ob.first == block_index;
+                                    }),
+                     open_blocks_.end());
+}
+
+bool MatchPackIndex::read_pair(const MatchPackIndexRecordV1& rec, MatchPackPairView* out) const {
+  if (!out)
+    return false;
+  *out = MatchPackPairView();
+  auto block = open_block(rec.block_index);
+  if (!block) {
+    LOG(WARNING) << "MatchPack block unreadable: " << pack_path(rec.block_index);
+    return false;
+  }
+  const auto indices = block->view_blob<uint16_t>(kIndicesBlobName);
+  const auto coords = block->view_blob<float>(kCoordsBlobName);
+  const auto scales = block->view_blob<float>(kScalesBlobName);
+  const auto distances = block->view_blob<float>(kDistancesBlobName);
+  const size_t row0 = static_cast<size_t>(rec.row_offset);
+  const size_t n = rec.num_matches;
+  if ((row0 + n) * 2 > indices.size() || (row0 + n) * 4 > coords.size() ||
+      (row0 + n) * 2 > scales.size() || row0 + n > distances.size()) {
+    LOG(ERROR) << "MatchPack pair " << rec.image1_index << "_" << rec.image2_index
+               << " out of block bounds: " << pack_path(rec.block_index);
+    return false;
+  }
+
+  out->image1_index = rec.image1_index;
+  out->image2_index = rec.image2_index;
+  out->num_matches = n;
+  out->indices = BlobView<uint16_t>{indices.data() + row0 * 2, n * 2};
+  out->coords_pixel = BlobView<float>{coords.data() + row0 * 4, n * 4};
+  out->scales = BlobView<float>{scales.data() + row0 * 2, n * 2};
+  out->distances = BlobView<float>{distances.data() + row0, n};
+  out->block = std::move(block);
+  return true;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// MatchPackWriter
+// ─────────────────────────────────────────────────────────────────────────────
+
+MatchPackWriter::MatchPackWriter(const std::string& match_dir, int block_size,
+                                 const nlohmann::json& algorithm)
+    : match_dir_(match_dir), block_size_(std::max(1, block_size)), algorithm_(algorithm) {
+  MatchPackIndex::remove_from_dir(match_dir_);
+}
+
+size_t MatchPackWriter::num_pairs() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return records_.size();
+}
+
+bool MatchPackWriter::add_pair(uint32_t image1_index, uint32_t image2_index,
+                               const uint16_t* indices, const float* coords_pixel,
+                               const float* scales, const float* distances, size_t num_matches) {
+  if (num_matches == 0 || !indices || !coords_pixel)
+    return false;
+
+  Block full;
+  uint32_t full_index = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    MatchPackIndexRecordV1 rec{};
+    rec.image1_index = image1_index;
+    rec.image2_index = image2_index;
+    rec.block_index = next_block_index_;
+    rec.num_matches = static_cast<uint32_t>(num_matches);
+    rec.row_offset = current_.distances.size();
+    records_.push_back(rec);
+
+    current_.indices.insert(current_.indices.end(), indices, indices + num_matches * 2);
+    current_.coords.insert(current_.coords.end(), coords_pixel, coords_pixel + num_matches * 4);
+    if (scales)
+      current_.scales.insert(current_.scales.end(), scales, scales + num_matches * 2);
+    else
+      current_.scales.resize(current_.scales.size() + num_matches * 2, 1.0f);
+    if (distances)
+      current_.distances.insert(current_.distances.end(), distances, distances + num_matches);
+    else
+      current_.distances.resize(current_.distances.size() + num_matches, 0.0f);
+
+    if (++current_.pair_count < block_size_)
+      return true;
+    full = std::move(current_);
+    current_ = Block();
+    full_index = next_block_index_++;
+  }
+  // Block write happens outside the lock so other writer threads keep appending.
+  if (!write_block(full_index, full)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    write_failed_ = true;
+    return false;
+  }
+  return true;
+}
+
+bool MatchPackWriter::write_block(uint32_t block_index, const Block& block) const {
+  const std::string pack_path =
+      (fs::path(match_dir_) / MatchPackIndex::pack_file_name_from_block_index(block_index))
+          .string();
+  const int rows = static_cast<int>(block.distances.size());
+
+  nlohmann::json meta;
+  meta["schema_version"] = "1.0";
+  meta["task_type"] = "feature_matching_pack";
+  meta["algorithm"] = algorithm_;
+  meta["pack"]["block_index"] = block_index;
+  meta["pack"]["pair_count"] = block.pair_count;
+  meta["pack"]["num_matches"] = rows;
+
+  IDCWriter writer(pack_path);
+  writer.set_metadata(meta);
+  writer.add_blob(MatchPackIndex::kIndicesBlobName, block.indices.data(),
+                  block.indices.size() * sizeof(uint16_t), "uint16", {rows, 2});
+  writer.add_blob(MatchPackIndex::kCoordsBlobName, block.coords.data(),
+                  block.coords.size() * sizeof(float), "float32", {rows, 4});
+  writer.add_blob(MatchPackIndex::kScalesBlobName, block.scales.data(),
+                  block.scales.size() * sizeof(float), "float32", {rows, 2});
+  writer.add_blob(MatchPackIndex::kDistancesBlobName, block.distances.data(),
+                  block.distances.size() * sizeof(float), "float32", {rows});
+  if (!writer.write()) {
+    LOG(ERROR) << "Failed to write match pack: " << pack_path;
+    return false;
+  }
+  VLOG(1) << "Wrote match pack " << pack_path << " pairs=" << block.pair_count
+          << " matches=" << rows;
+  return true;
+}
+
+std::string MatchPackWriter::finish() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (current_.pair_count > 0) {
+    if (!write_block(next_block_index_, current_))
+      write_failed_ = true;
+    ++next_block_index_;
+    current_ = Block();
+  }
+  if (write_failed_)
+    return "";
+
+  const std::string out_path = (fs::path(match_dir_) / MatchPackIndex::kIndexFileName).string();
+  nlohmann::json meta;
+  meta["schema_version"] = "1.0";
+  meta["task_type"] = "feature_matching_pack_binary_index";
+  meta["pack_suffix"] = ".isat_matchpack";
+  meta["record_blob"] = MatchPackIndex::kIndexBlobName;
+  meta["record_layout"] = "MatchPackIndexRecordV1";
+  meta["record_size_bytes"] = static_cast<int>(sizeof(MatchPackIndexRecordV1));
+  meta["num_pairs"] = static_cast<int>(records_.size());
+  meta["num_blocks"] = static_cast<int>(next_block_index_);
+  meta["block_size"] = block_size_;
+  meta["algorithm"] = algorithm_;
+
+  IDCWriter writer(out_path);
+  writer.set_metadata(meta);
+  if (!records_.empty()) {
+    writer.add_blob(MatchPackIndex::kIndexBlobName, records_.data(),
+                    records_.size() * sizeof(MatchPackIndexRecordV1), "uint8",
+                    {static_cast<int>(records_.size()),
+                     static_cast<int>(sizeof(MatchPackIndexRecordV1))});
+  }
+  if (!writer.write()) {
+    LOG(ERROR) << "Failed to write match pack index: " << out_path;
+    return "";
+  }
+  LOG(INFO) << "MatchPack index written: " << out_path << " pairs=" << records_.size()
+            << " blocks=" << next_block_index_;
+  return out_path;
+}
+
+} // namespace io
+} // namespace insight
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "idc_reader.h"
+
+namespace insight {
+namespace io {
+
+/**
+ * Block-packed match container (counterpart of the geopack for .isat_match).
+ *
+ * Instead of one .isat_match per pair, matches are appended to block files
+ *   {match_dir}/match_block_NNNNNN.isat_matchpack
+ * each an IDC with four columnar blobs shared by all pairs of the block:
+ *   indices      uint16[R, 2]
+ *   coords_pixel float32[R, 4]
+ *   scales       float32[R, 2]
+ *   distances    float32[R]
+ * where R is the total number of matches in the block. A binary index
+ *   {match_dir}/matchpack_index.isat_mpkx
+ * maps each pair to (block_index, row_offset, num_matches), so a pair is read as a
+ * zero-copy row range of the mapped block. Pair orientation (image1/image2) is stored as
+ * written, i.e. it is the orientation of indices/coords.
+ */
+
+#pragma pack(push, 1)
+struct MatchPackIndexRecordV1 {
+  uint32_t image1_index;
+  uint32_t image2_index;
+  uint32_t block_index;
+  uint32_t num_matches;
+  uint64_t row_offset; // first match row of this pair inside the block blobs
+};
+#pragma pack(pop)
+
+static_assert(sizeof(MatchPackIndexRecordV1) == 24, "MatchPackIndexRecordV1 layout mismatch");
+
+/// Zero-copy view of one pair's matches; valid while the block reader it came from is alive.
+struct MatchPackPairView {
+  uint32_t image1_index = 0;
+  uint32_t image2_index = 0;
+  size_t num_matches = 0;
+  BlobView<uint16_t> indices;    // 2 * num_matches
+  BlobView<float> coords_pixel;  // 4 * num_matches
+  BlobView<float> scales;        // 2 * num_matches
+  BlobView<float> distances;     // num_matches
+  std::shared_ptr<const IDCReader> block; // keeps the mapping alive
+};
+
+class MatchPackIndex {
+public:
+  static constexpr const char* kIndexFileName = "matchpack_index.isat_mpkx";
+  static constexpr const char* kIndexBlobName = "entries_v1";
+  static constexpr const char* kIndicesBlobName = "indices";
+  static constexpr const char* kCoordsBlobName = "coords_pixel";
+  static constexpr const char* kScalesBlobName = "scales";
+  static constexpr const char* kDistancesBlobName = "distances";
+
+  static std::string pack_file_name_from_block_index(uint32_t block_index);
+  static bool exists_in_dir(const std::string& match_dir);
+  /// Deletes the index and every match_block_* file in match_dir (index first, so an
+  /// interrupted cleanup never leaves an index pointing at missing blocks). Returns the
+  /// number of files removed. Called whenever a matcher starts writing into match_dir, so a
+  /// pack from an earlier run cannot shadow fresh per-pair .isat_match output.
+  static size_t remove_from_dir(const std::string& match_dir);
+  static uint64_t pair_key(uint32_t image1_index, uint32_t image2_index);
+
+  bool load_from_dir(const std::string& match_dir);
+  bool is_valid() const { return valid_; }
+  size_t size() const { return records_.size(); }
+  const std::vector<MatchPackIndexRecordV1>& records() const { return records_; }
+  /// Order-independent lookup: (i, j) and (j, i) find the same record.
+  const MatchPackIndexRecordV1* find(uint32_t image1_index, uint32_t image2_index) const;
+  std::string pack_path(uint32_t block_index) const;
+
+  /// Thread-safe. Blocks are mapped on first use and kept in a small LRU of open blocks
+  /// (max_open_blocks), so callers that visit pairs in (block_index, row_offset) order read
+  /// each block sequentially exactly once.
+  bool read_pair(const MatchPackIndexRecordV1& rec, MatchPackPairView* out) const;
+  void set_max_open_blocks(size_t n) { max_open_blocks_ = n > 0 ? n : 1; }
+  /// Drops the cached mapping for a block (views already handed out stay valid).
+  void release_block(uint32_t block_index) const;
+
+private:
+  std::shared_ptr<const IDCReader> open_block(uint32_t block_index) const;
+
+  bool valid_ = false;
+  std::string match_dir_;
+  std::vector<MatchPackIndexRecordV1> records_;
+  std::unordered_map<uint64_t, size_t> by_pair_;
+
+  size_t max_open_blocks_ = 4;
+  mutable std::mutex block_mutex_;
+  mutable std::vector<std::pair<uint32_t, std::shared_ptr<const IDCReader>>> open_blocks_; // MRU last
+};
+
+/**
+ * Streaming writer for match packs. add_pair() is thread-safe and may be called from the
+ * multi-threaded write stage of the matchers; pairs are appended to the current in-memory
+ * block, which is flushed to disk once it holds block_size pairs. finish() flushes the tail
+ * block and writes the binary index. The constructor removes any pack already in match_dir.
+ */
+class MatchPackWriter {
+public:
+  MatchPackWriter(const std::string& match_dir, int block_size, const nlohmann::json& algorithm);
+
+  bool add_pair(uint32_t image1_index, uint32_t image2_index, const uint16_t* indices,
+                const float* coords_pixel, const float* scales, const float* distances,
+                size_t num_matches);
+  /// Returns the index path, or "" on failure.
+  std::string finish();
+
+  size_t num_pairs() const;
+
+private:
+  struct Block {
+    std::vector<uint16_t> indices;
+    std::vector<float> coords;
+    std::vector<float> scales;
+    std::vector<float> distances;
+    int pair_count = 0;
+  };
+  bool write_block(uint32_t block_index, const Block& block) const;
+
+  std::string match_dir_;
+  int block_size_;
+  nlohmann::json algorithm_;
+
+  mutable std::mutex mutex_;
+  Block current_;
+  uint32_t next_block_index_ = 0;
+  std::vector<MatchPackIndexRecordV1> records_;
+  bool write_failed_ = false;
+};
+
+} // namespace io
+} // namespace insight
@@ -0,0 +1,149 @@
+#include "pair_list.h"
+
+#include <fstream>
+#include <sstream>
+
+#include <glog/logging.h>
+
+#include "idc_writer.h"
+
+namespace insight {
+namespace io {
+
+namespace {
+
+struct MethodName {
+  uint32_t flag;
+  const char* name;
+};
+
+constexpr MethodName kMethodNames[] = {
+    {kPairMethodExhaustive, "exhaustive"}, {kPairMethodSequential, "sequential"},
+    {kPairMethodGps, "gps"},               {kPairMethodVlad, "vlad"},
+    {kPairMethodVocabTree, "vocab_tree"},  {kPairMethodMatched, "matched"},
+    {kPairMethodVerified, "verified"},
+};
+
+const std::string kEmpty;
+
+} // namespace
+
+uint32_t pair_method_flags_from_string(const std::string& method) {
+  uint32_t flags = kPairMethodNone;
+  std::istringstream ss(method);
+  std::string token;
+  while (std::getline(ss, token, '+')) {
+    for (const auto& m : kMethodNames) {
+      if (token == m.name)
+        flags |= m.flag;
+    }
+  }
+  return flags;
+}
+
+std::string pair_method_string_from_flags(uint32_t flags) {
+  std::string out;
+  for (const auto& m : kMethodNames) {
+    if (!(flags & m.flag))
+      continue;
+    if (!out.empty())
+      out += "+";
+    out += m.name;
+  }
+  return out;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// PairListWriter
+// ─────────────────────────────────────────────────────────────────────────────
+
+bool PairListWriter::write(const std::string& path) const {
+  nlohmann::json meta = extra_.is_object() ? extra_ : nlohmann::json::object();
+  meta["schema_version"] = "1.0";
+  meta["task_type"] = "pair_list";
+  meta["record_blob"] = kRecordBlobName;
+  meta["record_layout"] = "PairListRecordV1";
+  meta["record_size_bytes"] = static_cast<int>(sizeof(PairListRecordV1));
+  meta["num_pairs"] = records_.size();
+  if (!feature_files_.empty())
+    meta["feature_files"] = feature_files_;
+
+  IDCWriter writer(path);
+  writer.set_metadata(meta);
+  if (!records_.empty()) {
+    writer.add_blob(kRecordBlobName, records_.data(), records_.size() * sizeof(PairListRecordV1),
+                    "uint8",
+                    {static_cast<int>(records_.size()), static_cast<int>(sizeof(PairListRecordV1))});
+  }
+  if (!writer.write()) {
+    LOG(ERROR) << "Failed to write pair list: " << path;
+    return false;
+  }
+  LOG(INFO) << "Wrote " << records_.size() << " pairs to " << path;
+  return true;
+}
+
+bool PairListWriter::write_json(const std::string& path) const {
+  std::ofstream out(path);
+  if (!out.is_open()) {
+    LOG(ERROR) << "Failed to open output file: " << path;
+    return false;
+  }
+  nlohmann::json output = extra_.is_object() ? extra_ : nlohmann::json::object();
+  output["schema_version"] = "1.0";
+  output["pairs"] = nlohmann::json::array();
+  for (const auto& r : records_) {
+    nlohmann::json p;
+    p["image1_index"] = r.image1_index;
+    p["image2_index"] = r.image2_index;
+    if (r.image1_index < feature_files_.size() && r.image2_index < feature_files_.size()) {
+      p["feature1_file"] = feature_files_[r.image1_index];
+      p["feature2_file"] = feature_files_[r.image2_index];
+    }
+    p["score"] = r.score;
+    if (r.flags != kPairMethodNone)
+      p["method"] = pair_method_string_from_flags(r.flags);
+    output["pairs"].push_back(std::move(p));
+  }
+  out << output.dump(2) << "\n";
+  LOG(INFO) << "Wrote " << records_.size() << " pairs to " << path;
+  return static_cast<bool>(out);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// PairListReader
+// ─────────────────────────────────────────────────────────────────────────────
+
+PairListReader::PairListReader(const std::string& path)
+    : reader_(std::make_unique<IDCReader>(path, IDCReadMode::kMapped)) {
+  if (!reader_->is_valid()) {
+    LOG(ERROR) << "Invalid pair list: " << path;
+    return;
+  }
+  const auto& meta = reader_->get_metadata();
+  if (meta.value("task_type", std::string()) != "pair_list" ||
+      meta.value("record_size_bytes", 0) != static_cast<int>(sizeof(PairListRecordV1))) {
+    LOG(ERROR) << "Not a PairListRecordV1 pair list: " << path;
+    return;
+  }
+  if (reader_->has_blob(PairListWriter::kRecordBlobName))
+    records_ = reader_->view_blob<PairListRecordV1>(PairListWriter::kRecordBlobName);
+  if (meta.contains("feature_files") && meta["feature_files"].is_array())
+    feature_files_ = meta["feature_files"].get<std::vector<std::string>>();
+  valid_ = true;
+}
+
+const std::string& PairListReader::feature_file(uint32_t image_index) const {
+  return image_index < feature_files_.size() ? feature_files_[image_index] : kEmpty;
+}
+
+bool is_pair_list_file(const std::string& path) {
+  std::ifstream f(path, std::ios::binary);
+  uint32_t magic = 0;
+  if (!f.read(reinterpret_cast<char*>(&magic), sizeof(magic)))
+    return false;
+  return magic == 0x54415349; // "ISAT", see IDCReader::MAGIC_NUMBER
+}
+
+} // namespace io
+} // namespace insight
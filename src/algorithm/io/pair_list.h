@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+#include "idc_reader.h"
+
+namespace insight {
+namespace io {
+
+/**
+ * Binary candidate-pair list (.isat_pairs), the compact replacement for pairs.json between
+ * isat_retrieve → isat_match → isat_geo → isat_tracks.
+ *
+ * One IDC file with a single blob "pairs_v1" of fixed 16-byte records (i, j, score, method
+ * flags). Per-image feature file paths (what pairs.json repeated for every pair) are stored
+ * once in the JSON metadata as "feature_files", indexed by image index.
+ *
+ * PairListReader maps the file and iterates records in place, so readers never build a JSON
+ * DOM and never copy the record array.
+ */
+
+enum PairMethodFlags : uint32_t {
+  kPairMethodNone = 0,
+  kPairMethodExhaustive = 1u << 0,
+  kPairMethodSequential = 1u << 1,
+  kPairMethodGps = 1u << 2,
+  kPairMethodVlad = 1u << 3,
+  kPairMethodVocabTree = 1u << 4,
+  kPairMethodMatched = 1u << 5,  // survived feature matching (--output-pairs-json)
+  kPairMethodVerified = 1u << 6, // survived geometric verification
+};
+
+/// "gps+vlad" → kPairMethodGps | kPairMethodVlad. Unknown tokens are ignored.
+uint32_t pair_method_flags_from_string(const std::string& method);
+/// Inverse of pair_method_flags_from_string ("" when no flag is set).
+std::string pair_method_string_from_flags(uint32_t flags);
+
+#pragma pack(push, 1)
+struct PairListRecordV1 {
+  uint32_t image1_index;
+  uint32_t image2_index;
+  float score;
+  uint32_t flags; // PairMethodFlags
+};
+#pragma pack(pop)
+
+static_assert(sizeof(PairListRecordV1) == 16, "PairListRecordV1 layout mismatch");
+
+class PairListWriter {
+public:
+  static constexpr const char* kRecordBlobName = "pairs_v1";
+
+  void reserve(size_t n) { records_.reserve(n); }
+  void add(uint32_t image1_index, uint32_t image2_index, float score = 1.0f,
+           uint32_t flags = kPairMethodNone) {
+    records_.push_back(PairListRecordV1{image1_index, image2_index, score, flags});
+  }
+  /// Optional: feature file per image index; readers use it when no --feature-dir is given.
+  void set_feature_files(std::vector<std::string> files) { feature_files_ = std::move(files); }
+  /// Free-form provenance ("retrieval_method", ...) merged into the file metadata.
+  void set_extra_metadata(const nlohmann::json& extra) { extra_ = extra; }
+
+  size_t size() const { return records_.size(); }
+  bool write(const std::string& path) const;
+  /// Legacy pairs.json export (same schema isat_retrieve used to write).
+  bool write_json(const std::string& path) const;
+
+private:
+  std::vector<PairListRecordV1> records_;
+  std::vector<std::string> feature_files_;
+  nlohmann::json extra_;
+};
+
+class PairListReader {
+public:
+  explicit PairListReader(const std::string& path);
+
+  bool is_valid() const { return valid_; }
+  size_t size() const { return records_.size(); }
+  const PairListRecordV1& operator[](size_t i) const { return records_[i]; }
+  const PairListRecordV1* begin() const { return records_.begin(); }
+  const PairListRecordV1* end() const { return records_.end(); }
+
+  const nlohmann::json& metadata() const { return reader_->get_metadata(); }
+  /// Empty when the list carries no feature file for this image.
+  const std::string& feature_file(uint32_t image_index) const;
+
+private:
+  std::unique_ptr<IDCReader> reader_;
+  BlobView<PairListRecordV1> records_;
+  std::vector<std::string> feature_files_;
+  bool valid_ = false;
+};
+
+/// True when path starts with the IDC magic (i.e. is not a pairs.json); extension is ignored.
+bool is_pair_list_file(const std::string& path);
+
+} // namespace io
+} // namespace insight
@@ -65,6 +65,8 @@ bool load_track_store_from_idc(const std::string& path, TrackStore* store_out,
     return false;
   }
 
+  const bool exact_state = meta.value("keeps_deleted_observations", false);
+
   store_out->set_num_images(num_images);
   for (int t = 0; t < num_tracks; ++t) {
     float x = track_xyz[static_cast<size_t>(t) * 3];
@@ -72,13 +74,14 @@ bool load_track_store_from_idc(const std::string& path, TrackStore* store_out,
     float z = track_xyz[static_cast<size_t>(t) * 3 + 2];
     store_out->add_track(x, y, z);
     const uint8_t flags = track_flags[static_cast<size_t>(t)];
-    if ((flags & track_flags::kAlive) == 0)
-      store_out->mark_track_deleted(t);
     // Restore kHasTriangulated so that track_has_triangulated_xyz() works after reload.
     // add_track sets the flag only on camera-ready triangulations; on-disk the bit may
     // have been set by the SfM pipeline (schema >= 1.2).
     if (flags & track_flags::kHasTriangulated)
       store_out->set_track_xyz(t, x, y, z);  // also increments num_triangulated_
+    // Delete after restoring XYZ so that num_triangulated_ counts alive tracks only.
+    if ((flags & track_flags::kAlive) == 0)
+      store_out->mark_track_deleted(t);
   }
   for (int t = 0; t < num_tracks; ++t) {
     const size_t beg = track_obs_offset[static_cast<size_t>(t)];
@@ -88,11 +91,28 @@ bool load_track_store_from_idc(const std::string& path, TrackStore* store_out,
       store_out->add_observation(t, obs_image_slot[g], obs_feature_id[g], obs_u[g], obs_v[g], s);
     }
   }
+  store_out->compact();  // image lists were appended interleaved
   for (int g = 0; g < num_observations; ++g) {
-    if (static_cast<size_t>(g) < obs_flags.size() &&
-        (obs_flags[static_cast<size_t>(g)] & obs_flags::kAlive) == 0)
+    if (static_cast<size_t>(g) >= obs_flags.size())
+      continue;
+    const uint8_t f = obs_flags[static_cast<size_t>(g)];
+    if ((f & obs_flags::kAlive) != 0)
+      continue;
+    if (exact_state && (f & obs_flags::kRestorable))
+      store_out->mark_observation_deleted_restorable(g);
+    else
       store_out->mark_observation_deleted(g);
   }
+  if (exact_state) {
+    // Deleting observations above flagged their tracks for retriangulation; put back the saved
+    // bits (the pending queue itself is scheduler state, see TrackStore::restore_scheduler_state).
+    for (int t = 0; t < num_tracks; ++t) {
+      const uint8_t flags = track_flags[static_cast<size_t>(t)];
+      store_out->set_track_retriangulation_flag(t, (flags & track_flags::kNeedsRetriangulation) != 0);
+      if (flags & track_flags::kSkipFromBA)
+        store_out->set_track_skip_ba(t, true);
+    }
+  }
 
   if (view_graph_out && meta.contains("view_graph_pairs") && meta["view_graph_pairs"].is_array()) {
     if (!view_graph_from_json_array(meta["view_graph_pairs"], view_graph_out)) {
@@ -114,6 +134,20 @@ bool load_track_store_from_idc(const std::string& path, TrackStore* store_out,
     sfm_pose_out->cam_idx = reader.read_blob<int32_t>("cam_idx");
     sfm_pose_out->intrinsics = reader.read_blob<float>("intrinsics");
     sfm_pose_out->num_cameras = meta.value("num_cameras", 0);
+    if (reader.has_blob("pose_R_f64") && reader.has_blob("pose_C_f64") &&
+        reader.has_blob("intrinsics_f64")) {
+      sfm_pose_out->pose_R_f64 = reader.read_blob<double>("pose_R_f64");
+      sfm_pose_out->pose_C_f64 = reader.read_blob<double>("pose_C_f64");
+      sfm_pose_out->intrinsics_f64 = reader.read_blob<double>("intrinsics_f64");
+      if (sfm_pose_out->pose_R_f64.size() != sfm_pose_out->pose_R.size() ||
+          sfm_pose_out->pose_C_f64.size() != sfm_pose_out->pose_C.size() ||
+          sfm_pose_out->intrinsics_f64.size() != sfm_pose_out->intrinsics.size()) {
+        LOG(WARNING) << "load_track_store_from_idc: f64 pose blob size mismatch, using float32";
+        sfm_pose_out->pose_R_f64.clear();
+        sfm_pose_out->pose_C_f64.clear();
+        sfm_pose_out->intrinsics_f64.clear();
+      }
+    }
 
     // Validate sizes
     if (sfm_pose_out->pose_R.size() != static_cast<size_t>(n_imgs) * 9) {
@@ -131,12 +165,31 @@ bool load_track_store_from_idc(const std::string& path, TrackStore* store_out,
   return true;
 }
 
+bool load_track_provenance_from_idc(const std::string& path, TrackProvenance* out) {
+  if (!out)
+    return false;
+  *out = TrackProvenance();
+  io::IDCReader reader(path);
+  if (!reader.is_valid()) {
+    LOG(ERROR) << "load_track_provenance_from_idc: invalid IDC " << path;
+    return false;
+  }
+  if (reader.has_blob("source_pairs"))
+    out->source_pairs = reader.read_blob<uint32_t>("source_pairs");
+  if (reader.has_blob("track_update_status"))
+    out->track_update_status = reader.read_blob<uint8_t>("track_update_status");
+  if (reader.has_blob("track_update_link"))
+    out->track_update_link = reader.read_blob<int32_t>("track_update_link");
+  return true;
+}
+
 bool save_track_store_to_idc(const TrackStore& store, const std::vector<uint32_t>& image_indices,
                              const std::string& path, const ViewGraph* view_graph,
                              const TrackSaveOptions* opts) {
   const size_t n_tracks = store.num_tracks();
   const bool embed_vg  = view_graph != nullptr && view_graph->num_pairs() > 0;
   const bool is_sfm    = opts != nullptr && opts->is_sfm_result;
+  const bool keep_deleted = opts != nullptr && opts->keep_deleted_observations;
 
   // Determine schema_version
   const bool has_sfm_pose = (opts != nullptr && opts->sfm_pose != nullptr);
@@ -154,6 +207,8 @@ bool save_track_store_to_idc(const TrackStore& store, const std::vector<uint32_t
 
   if (embed_vg)
     meta["view_graph_pairs"] = view_graph_pairs_to_json_array(*view_graph);
+  if (keep_deleted)
+    meta["keeps_deleted_observations"] = true;
 
   // ── Serialize tracks (always all tracks, never filter) ───────────────────
   std::vector<float>   track_xyz(static_cast<size_t>(n_tracks) * 3);
@@ -174,8 +229,10 @@ bool save_track_store_to_idc(const TrackStore& store, const std::vector<uint32_t
     const bool tri   = store.track_has_triangulated_xyz(static_cast<int>(t));
     if (alive) flags |= track_flags::kAlive;
     if (tri)   flags |= track_flags::kHasTriangulated;
-    if (is_sfm && store.is_track_skip_ba(static_cast<int>(t)))
+    if ((is_sfm || keep_deleted) && store.is_track_skip_ba(static_cast<int>(t)))
       flags |= track_flags::kSkipFromBA;
+    if (keep_deleted && store.track_needs_retriangulation(static_cast<int>(t)))
+      flags |= track_flags::kNeedsRetriangulation;
     track_flag_bytes[t] = flags;
 
     if (tri) {
@@ -215,6 +272,23 @@ bool save_track_store_to_idc(const TrackStore& store, const std::vector<uint32_t
   size_t offset = 0;
   for (size_t t = 0; t < n_tracks; ++t) {
     track_obs_offset[t] = static_cast<uint32_t>(offset);
+    if (keep_deleted) {
+      // Every observation id of the track in storage order, deleted ones included.
+      const ObsIdSpan ids = store.track_all_obs_ids_view(static_cast<int>(t));
+      for (int obs_id : ids) {
+        obs_image_slot.push_back(store.obs_image_index(obs_id));
+        obs_feature_id.push_back(store.obs_feature_id(obs_id));
+        obs_u.push_back(store.obs_u(obs_id));
+        obs_v.push_back(store.obs_v(obs_id));
+        obs_scale.push_back(store.obs_scale(obs_id));
+        uint8_t f = 0;
+        if (store.is_obs_valid(obs_id)) f |= obs_flags::kAlive;
+        else if (store.is_obs_restorable(obs_id)) f |= obs_flags::kRestorable;
+        obs_flag_bytes.push_back(f);
+      }
+      offset += ids.size();
+      continue;
+    }
     obs_buf.clear();
     store.get_track_observations(static_cast<int>(t), &obs_buf);
     for (const auto& o : obs_buf) {
@@ -231,6 +305,23 @@ bool save_track_store_to_idc(const TrackStore& store, const std::vector<uint32_t
   const size_t n_obs = obs_image_slot.size();
   meta["num_observations"] = static_cast<int>(n_obs);
 
+  const TrackProvenance* prov = opts != nullptr ? opts->provenance : nullptr;
+  const bool has_update = prov != nullptr && prov->track_update_status.size() == n_tracks &&
+                          prov->track_update_link.size() == n_tracks;
+  if (prov != nullptr && !prov->source_pairs.empty())
+    meta["num_source_pairs"] = static_cast<int>(prov->source_pairs.size() / 2);
+  if (has_update)
+    meta["is_track_update"] = true;
+
+  const bool has_sfm_f64 = has_sfm_pose && !opts->sfm_pose->pose_R_f64.empty() &&
+                           !opts->sfm_pose->pose_C_f64.empty() &&
+                           !opts->sfm_pose->intrinsics_f64.empty();
+  if (has_sfm_pose) {
+    // Must be in meta before set_metadata(), which copies it.
+    meta["has_pose_data"] = true;
+    meta["num_cameras"]   = opts->sfm_pose->num_cameras;
+  }
+
   io::IDCWriter writer(path);
   writer.set_metadata(meta);
   writer.add_blob("track_xyz", track_xyz.data(), track_xyz.size() * sizeof(float), "float32",
@@ -253,12 +344,22 @@ bool save_track_store_to_idc(const TrackStore& store, const std::vector<uint32_t
   writer.add_blob("obs_flags", obs_flag_bytes.data(), obs_flag_bytes.size() * sizeof(uint8_t),
                   "uint8", {static_cast<int>(obs_flag_bytes.size())});
 
+  if (prov != nullptr && !prov->source_pairs.empty())
+    writer.add_blob("source_pairs", prov->source_pairs.data(),
+                    prov->source_pairs.size() * sizeof(uint32_t), "uint32",
+                    {static_cast<int>(prov->source_pairs.size() / 2), 2});
+  if (has_update) {
+    writer.add_blob("track_update_status", prov->track_update_status.data(),
+                    prov->track_update_status.size() * sizeof(uint8_t), "uint8",
+                    {static_cast<int>(n_tracks)});
+    writer.add_blob("track_update_link", prov->track_update_link.data(),
+                    prov->track_update_link.size() * sizeof(int32_t), "int32",
+                    {static_cast<int>(n_tracks)});
+  }
+
   // ── Optional: embed pose + intrinsics blobs (schema 1.3) ──────────────────
   if (has_sfm_pose) {
     const auto* sp = opts->sfm_pose;
-    meta["has_pose_data"] = true;
-    meta["num_cameras"]   = sp->num_cameras;
-
     writer.add_blob("pose_R", sp->pose_R.data(), sp->pose_R.size() * sizeof(float),
                     "float32", {static_cast<int>(sp->pose_R.size() / 9), 9});
     writer.add_blob("pose_C", sp->pose_C.data(), sp->pose_C.size() * sizeof(float),
@@ -269,6 +370,15 @@ bool save_track_store_to_idc(const TrackStore& store, const std::vector<uint32_t
                     "int32", {static_cast<int>(sp->cam_idx.size())});
     writer.add_blob("intrinsics", sp->intrinsics.data(), sp->intrinsics.size() * sizeof(float),
                     "float32", {static_cast<int>(sp->num_cameras), 11});
+    if (has_sfm_f64) {
+      writer.add_blob("pose_R_f64", sp->pose_R_f64.data(), sp->pose_R_f64.size() * sizeof(double),
+                      "float64", {static_cast<int>(sp->pose_R_f64.size() / 9), 9});
+      writer.add_blob("pose_C_f64", sp->pose_C_f64.data(), sp->pose_C_f64.size() * sizeof(double),
+                      "float64", {static_cast<int>(sp->pose_C_f64.size() / 3), 3});
+      writer.add_blob("intrinsics_f64", sp->intrinsics_f64.data(),
+                      sp->intrinsics_f64.size() * sizeof(double), "float64",
+                      {static_cast<int>(sp->num_cameras), 11});
+    }
     VLOG(1) << "save_track_store_to_idc: embedded " << sp->pose_R.size() / 9 << " poses, "
             << sp->num_cameras << " cameras";
   }
@@ -7,6 +7,13 @@
  * Schema 1.2: adds SfM-result metadata + preserves kHasTriangulated bit.
  * Schema 1.3: adds optional pose + intrinsics + registered blobs (SfMResultData).
  *              Backward compatible: older loaders ignore unknown blobs.
+ *              Optional "pose_R_f64" / "pose_C_f64" / "intrinsics_f64" blobs carry the same data
+ *              in double precision (checkpoints); loaders prefer them when present.
+ * Optional at any schema: "keeps_deleted_observations" metadata — deleted observations are
+ *              written with their flags (kRestorable) and track flags keep kNeedsRetriangulation /
+ *              kSkipFromBA, so a reload reproduces the store exactly (incremental SfM checkpoint).
+ * Optional at any schema: "source_pairs" blob (image pairs merged into the tracks) and
+ *              "track_update_status" / "track_update_link" blobs written by isat_tracks --update.
  */
 
 #pragma once
@@ -35,6 +42,24 @@ struct SfMResultData {
   // Camera intrinsics (size = num_cameras)
   std::vector<float> intrinsics;   // 11 * num_cameras [fx,fy,cx,cy,w,h,k1,k2,k3,p1,p2]
   int num_cameras = 0;
+
+  // Optional double-precision copies (same layout); empty = not stored / not present on disk.
+  std::vector<double> pose_R_f64;
+  std::vector<double> pose_C_f64;
+  std::vector<double> intrinsics_f64;
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Track provenance (optional blobs, any schema)
+// ─────────────────────────────────────────────────────────────────────────────
+
+struct TrackProvenance {
+  /// 2 * num_pairs: (image1_index, image2_index) of every pair whose matches built the tracks.
+  std::vector<uint32_t> source_pairs;
+  /// Per track, track_update::k* (modules/sfm/track_update.h); empty for a fresh build.
+  std::vector<uint8_t> track_update_status;
+  /// Per track: surviving id (kMergedAway), source id (split-off kSplit), else -1.
+  std::vector<int32_t> track_update_link;
 };
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -49,6 +74,14 @@ struct TrackSaveOptions {
 
     // ── Optional embedded pose/intrinsics (schema 1.3) ──────────────────────
     const SfMResultData* sfm_pose = nullptr;
+
+    // ── Optional provenance blobs (source pairs, incremental update status) ─
+    const TrackProvenance* provenance = nullptr;
+
+    // ── Exact-state mode (checkpoints) ──────────────────────────────────────
+    /// Also write deleted observations (with kRestorable) and the kNeedsRetriangulation bit, so
+    /// that load_track_store_from_idc rebuilds the same observation ids and flags.
+    bool keep_deleted_observations = false;
 };
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -60,6 +93,9 @@ bool load_track_store_from_idc(const std::string& path, TrackStore* store_out,
                                ViewGraph* view_graph_out = nullptr,
                                SfMResultData* sfm_pose_out = nullptr);
 
+/// Read the optional provenance blobs; missing blobs leave the fields empty.
+bool load_track_provenance_from_idc(const std::string& path, TrackProvenance* out);
+
 bool save_track_store_to_idc(const TrackStore& store, const std::vector<uint32_t>& image_indices,
                              const std::string& path,
                              const ViewGraph* view_graph        = nullptr,
@@ -130,35 +130,33 @@ double legacy_normal_random(std::mt19937* rng) {
   return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * std::acos(-1.0) * u2);
 }
 
-std::vector<std::vector<float>> build_projection_matrix(int rows, uint32_t seed, bool use_legacy_rng) {
+/** Appends rows x 128 row-major projection values drawn from one seeded stream. */
+void append_projection_rows(int rows, uint32_t seed, bool use_legacy_rng, std::vector<float>* matrix) {
+  matrix->reserve(matrix->size() + static_cast<size_t>(rows) * kDescriptorDim);
+  std::mt19937 rng(seed);
   if (use_legacy_rng) {
-    std::mt19937 rng(seed);
-    std::vector<std::vector<float>> matrix(rows, std::vector<float>(kDescriptorDim, 0.0f));
-    for (int r = 0; r < rows; ++r) {
-      for (int c = 0; c < kDescriptorDim; ++c) {
-        matrix[r][c] = static_cast<float>(legacy_normal_random(&rng) * 1000.0);
-      }
+    for (int i = 0; i < rows * kDescriptorDim; ++i) {
+      matrix->push_back(static_cast<float>(legacy_normal_random(&rng) * 1000.0));
     }
-    return matrix;
+    return;
   }
-  std::mt19937 rng(seed);
   std::normal_distribution<float> normal(0.0f, 1.0f);
-  std::vector<std::vector<float>> matrix(rows, std::vector<float>(kDescriptorDim, 0.0f));
-  for (int r = 0; r < rows; ++r) {
-    for (int c = 0; c < kDescriptorDim; ++c) {
-      matrix[r][c] = normal(rng);
-    }
+  for (int i = 0; i < rows * kDescriptorDim; ++i) {
+    matrix->push_back(normal(rng));
   }
+}
+
+std::vector<float> build_projection_matrix(int rows, uint32_t seed, bool use_legacy_rng) {
+  std::vector<float> matrix;
+  append_projection_rows(rows, seed, use_legacy_rng, &matrix);
   return matrix;
 }
 
-std::vector<std::vector<std::vector<float>>> build_secondary_projection_matrix(
-    int groups, int bucket_bits, uint32_t seed, bool use_legacy_rng) {
-  std::vector<std::vector<std::vector<float>>> matrix;
-  matrix.reserve(groups);
+std::vector<float> build_secondary_projection_matrix(int groups, int bucket_bits, uint32_t seed,
+                                                     bool use_legacy_rng) {
+  std::vector<float> matrix;
   for (int g = 0; g < groups; ++g) {
-    matrix.push_back(build_projection_matrix(bucket_bits, seed + static_cast<uint32_t>(131 * g),
-                                             use_legacy_rng));
+    append_projection_rows(bucket_bits, seed + static_cast<uint32_t>(131 * g), use_legacy_rng, &matrix);
   }
   return matrix;
 }
@@ -178,9 +176,87 @@ std::vector<std::vector<int>> build_bucket_bit_indices(int groups, int bucket_bi
   return bit_indices;
 }
 
+constexpr int kProjectBlockPoints = 4;   ///< descriptors per projection micro-kernel
+constexpr int kProjectBlockRows = 16;    ///< projection rows per micro-kernel (2 x 8 lanes)
+
+/**
+ * Primary and secondary projection rows stacked and transposed for the blocked projection:
+ * values[d * ld + r] = row r, dim d. Rows [0, hash_bits) are primary, the rest secondary;
+ * ld is padded to kProjectBlockRows with zero rows.
+ */
+struct StackedProjection {
+  std::vector<float> values;
+  int rows = 0;
+  int ld = 0;
+};
+
+StackedProjection stack_projection(const std::vector<float>& primary, const std::vector<float>& secondary) {
+  StackedProjection p;
+  p.rows = static_cast<int>((primary.size() + secondary.size()) / kDescriptorDim);
+  p.ld = (p.rows + kProjectBlockRows - 1) / kProjectBlockRows * kProjectBlockRows;
+  p.values.assign(static_cast<size_t>(p.ld) * kDescriptorDim, 0.0f);
+  const int primary_rows = static_cast<int>(primary.size() / kDescriptorDim);
+  for (int r = 0; r < p.rows; ++r) {
+    const float* row = r < primary_rows
+                           ? primary.data() + static_cast<size_t>(r) * kDescriptorDim
+                           : secondary.data() + static_cast<size_t>(r - primary_rows) * kDescriptorDim;
+    for (int d = 0; d < kDescriptorDim; ++d) {
+      p.values[static_cast<size_t>(d) * p.ld + r] = row[d];
+    }
+  }
+  return p;
+}
+
+/**
+ * out[i * ld + r] = sum_d centered[i * 128 + d] * row_r[d] for kProjectBlockPoints descriptors.
+ * Each output is accumulated over d in ascending order with a separate multiply and add (lanes
+ * run across r, never across d), i.e. exactly the per-row scalar dot product, so hash bits are
+ * bit-identical to it. The file is built with -ffp-contract=off to keep the scalar path unfused.
+ */
+void project_block(const float* centered, const StackedProjection& p, float* out) {
+  const float* pt = p.values.data();
+  for (int r0 = 0; r0 < p.ld; r0 += kProjectBlockRows) {
+#if defined(__AVX2__)
+    __m256 acc[kProjectBlockPoints][2];
+    for (auto& a : acc) {
+      a[0] = _mm256_setzero_ps();
+      a[1] = _mm256_setzero_ps();
+    }
+    for (int d = 0; d < kDescriptorDim; ++d) {
+      const float* col = pt + static_cast<size_t>(d) * p.ld + r0;
+      const __m256 b0 = _mm256_loadu_ps(col);
+      const __m256 b1 = _mm256_loadu_ps(col + 8);
+      for (int i = 0; i < kProjectBlockPoints; ++i) {
+        const __m256 a = _mm256_broadcast_ss(centered + i * kDescriptorDim + d);
+        acc[i][0] = _mm256_add_ps(acc[i][0], _mm256_mul_ps(a, b0));
+        acc[i][1] = _mm256_add_ps(acc[i][1], _mm256_mul_ps(a, b1));
+      }
+    }
+    for (int i = 0; i < kProjectBlockPoints; ++i) {
+      _mm256_storeu_ps(out + static_cast<size_t>(i) * p.ld + r0, acc[i][0]);
+      _mm256_storeu_ps(out + static_cast<size_t>(i) * p.ld + r0 + 8, acc[i][1]);
+    }
+#else
+    float acc[kProjectBlockPoints][kProjectBlockRows] = {};
+    for (int d = 0; d < kDescriptorDim; ++d) {
+      const float* col = pt + static_cast<size_t>(d) * p.ld + r0;
+      for (int i = 0; i < kProjectBlockPoints; ++i) {
+        const float a = centered[i * kDescriptorDim + d];
+        for (int r = 0; r < kProjectBlockRows; ++r) {
+          acc[i][r] += a * col[r];
+        }
+      }
+    }
+    for (int i = 0; i < kProjectBlockPoints; ++i) {
+      std::copy_n(acc[i], kProjectBlockRows, out + static_cast<size_t>(i) * p.ld + r0);
+    }
+#endif
+  }
+}
+
 ImageFeatures build_hash_index(const matching::FeatureData& f, const std::vector<float>& mean_descriptor,
-                               const std::vector<std::vector<float>>& primary_projection,
-                               const std::vector<std::vector<std::vector<float>>>& secondary_projection,
+                               const std::vector<float>& primary_projection,
+                               const std::vector<float>& secondary_projection,
                                const std::vector<std::vector<int>>& bucket_bit_indices,
                                const CascadeHashOptions& options) {
   const int bucket_count = 1 << options.bucket_bits;
@@ -192,34 +268,9 @@ ImageFeatures build_hash_index(const matching::FeatureData& f, const std::vector
   index.bucket_offsets.assign(static_cast<size_t>(options.bucket_groups) * static_cast<size_t>(bucket_count + 1), 0);
   index.bucket_indices.resize(num_points * static_cast<size_t>(options.bucket_groups), 0);
 
-  std::vector<float> centered(kDescriptorDim, 0.0f);
-  std::vector<int16_t> centered_i16(kDescriptorDim, 0);
-  for (size_t i = 0; i < num_points; ++i) {
-    std::array<uint8_t, 128> hash_bits{};
-    for (int d = 0; d < kDescriptorDim; ++d) {
-      const float centered_value = descriptor_value(f, static_cast<int>(i), d) - mean_descriptor[d];
-      centered[d] = centered_value;
-      centered_i16[d] = static_cast<int16_t>(centered_value);
-    }
-
-    for (int h = 0; h < options.hash_bits; ++h) {
-      if (options.use_legacy_numeric) {
-        int sum = 0;
-        for (int d = 0; d < kDescriptorDim; ++d) {
-          if (centered_i16[d] != 0) {
-            sum += static_cast<int>(centered_i16[d]) * static_cast<int>(primary_projection[h][d]);
-          }
-        }
-        hash_bits[h] = sum > 0 ? 1 : 0;
-      } else {
-        float dot = 0.0f;
-        for (int d = 0; d < kDescriptorDim; ++d) {
-          dot += primary_projection[h][d] * centered[d];
-        }
-        hash_bits[h] = dot > 0.0f ? 1 : 0;
-      }
-    }
-
+  // Packs hash bits (bit h at hash_bits[h]) and per-group bucket ids for descriptor i;
+  // secondary_bits[g * bucket_bits + b] is bit b of group g when use_bucket_secondary_hash.
+  auto store_codes = [&](size_t i, const std::array<uint8_t, 128>& hash_bits, const uint8_t* secondary_bits) {
     for (int w = 0; w < kCompressedWords; ++w) {
       uint64_t packed = 0;
       for (int b = 0; b < 64; ++b) {
@@ -230,33 +281,74 @@ ImageFeatures build_hash_index(const matching::FeatureData& f, const std::vector
 
     for (int g = 0; g < options.bucket_groups; ++g) {
       uint16_t bucket_id = 0;
-      if (options.use_bucket_secondary_hash) {
-        for (int b = 0; b < options.bucket_bits; ++b) {
-          if (options.use_legacy_numeric) {
-            int sum = 0;
-            for (int d = 0; d < kDescriptorDim; ++d) {
-              if (centered_i16[d] != 0) {
-                sum += static_cast<int>(centered_i16[d]) *
-                       static_cast<int>(secondary_projection[g][b][d]);
-              }
-            }
-            bucket_id = static_cast<uint16_t>((bucket_id << 1) | (sum > 0 ? 1 : 0));
-          } else {
-            float dot = 0.0f;
-            for (int d = 0; d < kDescriptorDim; ++d) {
-              dot += secondary_projection[g][b][d] * centered[d];
-            }
-            bucket_id = static_cast<uint16_t>((bucket_id << 1) | (dot > 0.0f ? 1 : 0));
-          }
-        }
-      } else {
-        for (int b = 0; b < options.bucket_bits; ++b) {
-          bucket_id = static_cast<uint16_t>((bucket_id << 1) | hash_bits[bucket_bit_indices[g][b]]);
-        }
+      for (int b = 0; b < options.bucket_bits; ++b) {
+        const uint8_t bit = options.use_bucket_secondary_hash
+                                ? secondary_bits[g * options.bucket_bits + b]
+                                : hash_bits[bucket_bit_indices[g][b]];
+        bucket_id = static_cast<uint16_t>((bucket_id << 1) | bit);
       }
       index.bucket_ids_flat[i * static_cast<size_t>(options.bucket_groups) + static_cast<size_t>(g)] = bucket_id;
       ++index.bucket_counts[bucket_index(g, static_cast<int>(bucket_id), bucket_count)];
     }
+  };
+
+  const int secondary_rows = options.use_bucket_secondary_hash ? options.bucket_groups * options.bucket_bits : 0;
+  std::vector<uint8_t> secondary_bits(static_cast<size_t>(secondary_rows), 0);
+  if (options.use_legacy_numeric) {
+    // Legacy compat: int16 mean-centering and int accumulation, one descriptor at a time.
+    std::vector<int16_t> centered_i16(kDescriptorDim, 0);
+    auto legacy_sign = [&centered_i16](const float* row) {
+      int sum = 0;
+      for (int d = 0; d < kDescriptorDim; ++d) {
+        if (centered_i16[d] != 0) {
+          sum += static_cast<int>(centered_i16[d]) * static_cast<int>(row[d]);
+        }
+      }
+      return static_cast<uint8_t>(sum > 0 ? 1 : 0);
+    };
+    for (size_t i = 0; i < num_points; ++i) {
+      std::array<uint8_t, 128> hash_bits{};
+      for (int d = 0; d < kDescriptorDim; ++d) {
+        centered_i16[d] =
+            static_cast<int16_t>(descriptor_value(f, static_cast<int>(i), d) - mean_descriptor[d]);
+      }
+      for (int h = 0; h < options.hash_bits; ++h) {
+        hash_bits[h] = legacy_sign(primary_projection.data() + static_cast<size_t>(h) * kDescriptorDim);
+      }
+      for (int r = 0; r < secondary_rows; ++r) {
+        secondary_bits[static_cast<size_t>(r)] =
+            legacy_sign(secondary_projection.data() + static_cast<size_t>(r) * kDescriptorDim);
+      }
+      store_codes(i, hash_bits, secondary_bits.data());
+    }
+  } else {
+    // All hash and bucket projections of kProjectBlockPoints descriptors in one blocked product.
+    const StackedProjection projection = stack_projection(
+        primary_projection, options.use_bucket_secondary_hash ? secondary_projection : std::vector<float>());
+    std::vector<float> centered(static_cast<size_t>(kProjectBlockPoints) * kDescriptorDim, 0.0f);
+    std::vector<float> dots(static_cast<size_t>(kProjectBlockPoints) * projection.ld, 0.0f);
+    for (size_t i0 = 0; i0 < num_points; i0 += kProjectBlockPoints) {
+      const size_t block = std::min<size_t>(kProjectBlockPoints, num_points - i0);
+      std::fill(centered.begin(), centered.end(), 0.0f);
+      for (size_t k = 0; k < block; ++k) {
+        for (int d = 0; d < kDescriptorDim; ++d) {
+          centered[k * kDescriptorDim + d] =
+              descriptor_value(f, static_cast<int>(i0 + k), d) - mean_descriptor[d];
+        }
+      }
+      project_block(centered.data(), projection, dots.data());
+      for (size_t k = 0; k < block; ++k) {
+        const float* row = dots.data() + k * static_cast<size_t>(projection.ld);
+        std::array<uint8_t, 128> hash_bits{};
+        for (int h = 0; h < options.hash_bits; ++h) {
+          hash_bits[h] = row[h] > 0.0f ? 1 : 0;
+        }
+        for (int r = 0; r < secondary_rows; ++r) {
+          secondary_bits[static_cast<size_t>(r)] = row[options.hash_bits + r] > 0.0f ? 1 : 0;
+        }
+        store_codes(i0 + k, hash_bits, secondary_bits.data());
+      }
+    }
   }
 
   // Prefix-sum per group to build contiguous bucket spans.
@@ -513,10 +605,10 @@ CascadeHashSampleModel build_sample_model_from_mean_descriptor(
       value = static_cast<float>(static_cast<int16_t>(value));
     }
   }
-  model.primary_projection_matrix =
+  model.primary_projection =
       build_projection_matrix(options.hash_bits, options.random_seed, options.use_legacy_rng);
   if (options.use_bucket_secondary_hash) {
-    model.secondary_projection_matrix =
+    model.secondary_projection =
         build_secondary_projection_matrix(options.bucket_groups, options.bucket_bits,
                                           options.random_seed + 10007, options.use_legacy_rng);
   }
@@ -532,9 +624,8 @@ CascadeHashSampleModel build_sample_model(
 
 ImageFeatures compute_image_features(const matching::FeatureData& features,
                                      const CascadeHashSampleModel& model) {
-  return build_hash_index(features, model.mean_descriptor, model.primary_projection_matrix,
-                          model.secondary_projection_matrix,
-                          model.bucket_bit_indices, model.options);
+  return build_hash_index(features, model.mean_descriptor, model.primary_projection,
+                          model.secondary_projection, model.bucket_bit_indices, model.options);
 }
 
 matching::MatchResult match_cascade_hash(const matching::FeatureData& query_features,
@@ -58,8 +58,12 @@ struct ImageFeatures {
 struct CascadeHashSampleModel {
   CascadeHashOptions options;
   std::vector<float> mean_descriptor;
-  std::vector<std::vector<float>> primary_projection_matrix;
-  std::vector<std::vector<std::vector<float>>> secondary_projection_matrix;
+  // Row-major projection matrices, 128 floats per row:
+  // - primary_projection: hash_bits rows (row h -> hash bit h)
+  // - secondary_projection: bucket_groups * bucket_bits rows (row g * bucket_bits + b -> bit b of
+  //   group g bucket id); empty unless options.use_bucket_secondary_hash
+  std::vector<float> primary_projection;
+  std::vector<float> secondary_projection;
   std::vector<std::vector<int>> bucket_bit_indices;
 };
 
@@ -13,6 +13,7 @@
 
 #include <algorithm>
 #include <array>
+#include <cmath>
 #include <cstdint>
 #include <iostream>
 #include <random>
@@ -171,6 +172,56 @@ int test_group_images_for_pairs() {
   return 0;
 }
 
+int test_blocked_projection_matches_reference() {
+  std::cout << "[Test 3] Blocked projection matches the per-row float loop bit for bit\n";
+  // 37 features: exercises the partial trailing block of the 4-descriptor projection kernel.
+  const matching::FeatureData features = make_random_feature_data(37, 7);
+  CascadeHashOptions options;
+  options.use_legacy_rng = false;
+  std::vector<const matching::FeatureData*> samples = {&features};
+  const CascadeHashSampleModel model = build_sample_model(samples, options);
+  const ImageFeatures index = compute_image_features(features, model);
+
+  // The pre-blocking per-descriptor loop: float centering, float dot accumulated over d in order.
+  std::vector<float> centered(kDescriptorDim, 0.0f);
+  auto reference_bit = [&centered](const float* row) {
+    float dot = 0.0f;
+    for (int d = 0; d < kDescriptorDim; ++d) {
+      dot += row[d] * centered[d];
+    }
+    return dot > 0.0f ? 1 : 0;
+  };
+
+  for (size_t i = 0; i < features.num_features; ++i) {
+    for (int d = 0; d < kDescriptorDim; ++d) {
+      centered[d] = static_cast<float>(features.descriptors_uint8[i * kDescriptorDim + d]) -
+                    model.mean_descriptor[d];
+    }
+    for (int h = 0; h < options.hash_bits; ++h) {
+      const int expected = reference_bit(model.primary_projection.data() + static_cast<size_t>(h) * kDescriptorDim);
+      const int got = static_cast<int>((index.compressed_hashes[i][h / 64] >> (63 - h % 64)) & 1u);
+      if (got != expected) {
+        std::cerr << "  FAIL: hash bit " << h << " of descriptor " << i << "\n";
+        return 1;
+      }
+    }
+    for (int g = 0; g < options.bucket_groups; ++g) {
+      const uint16_t bucket = index.bucket_ids_flat[i * static_cast<size_t>(options.bucket_groups) + g];
+      for (int b = 0; b < options.bucket_bits; ++b) {
+        const size_t row = static_cast<size_t>(g * options.bucket_bits + b);
+        const int expected = reference_bit(model.secondary_projection.data() + row * kDescriptorDim);
+        const int got = (bucket >> (options.bucket_bits - 1 - b)) & 1;
+        if (got != expected) {
+          std::cerr << "  FAIL: bucket bit " << b << " of group " << g << ", descriptor " << i << "\n";
+          return 1;
+        }
+      }
+    }
+  }
+  std::cout << "  PASS\n";
+  return 0;
+}
+
 }  // namespace
 
 }  // namespace cpu_cascade_hash
@@ -185,6 +236,7 @@ int main() {
   int failures = 0;
   failures += insight::algorithm::cpu_cascade_hash::test_match_cascade_hash_with_synthetic_descriptors();
   failures += insight::algorithm::cpu_cascade_hash::test_group_images_for_pairs();
+  failures += insight::algorithm::cpu_cascade_hash::test_blocked_projection_matches_reference();
 
   if (failures == 0) {
     std::cout << "\nAll tests PASSED.\n";
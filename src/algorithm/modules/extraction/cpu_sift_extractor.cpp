@@ -0,0 +1,865 @@
+/**
+ * @file  cpu_sift_extractor.cpp
+ * @brief CPU SIFT 实现：可分离高斯金字塔、DoG 极值、方向直方图与 4x4x8 描述子。
+ *
+ * 坐标约定与 SiftGPU 一致：输出 x/y 为原图像素坐标 + 0.5，s 为原图像素尺度，o 为弧度。
+ * 整数像素坐标 p 在第 o 个 octave（相对 base 图）对应 base 坐标 p * 2^o（抽取降采样），
+ * base 与输入图之间按像素中心对齐的比例 f 映射：x_in + 0.5 = (x_base + 0.5) * f。
+ */
+
+#include "cpu_sift_extractor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <glog/logging.h>
+#include <opencv2/imgproc.hpp>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace insight {
+namespace modules {
+namespace {
+
+constexpr int kDescWidth = 4;      // 4x4 空间 bin
+constexpr int kDescHistBins = 8;   // 每 bin 8 个方向
+constexpr int kDescDim = kDescWidth * kDescWidth * kDescHistBins;
+constexpr int kOriHistBins = 36;
+constexpr float kOriPeakRatio = 0.8f;
+constexpr float kOriSigmaFactor = 1.5f;
+constexpr float kOriRadiusFactor = 3.0f;
+constexpr float kDescScaleFactor = 3.0f;
+constexpr float kDescMagThreshold = 0.2f;
+constexpr int kImageBorder = 5;
+constexpr int kMaxInterpSteps = 5;
+constexpr float kTwoPi = 6.283185307179586f;
+
+/** 行主序单通道浮点图。 */
+struct Plane {
+  int w = 0;
+  int h = 0;
+  std::vector<float> data;
+
+  Plane() = default;
+  Plane(int width, int height) : w(width), h(height), data(static_cast<size_t>(width) * height) {}
+  float* row(int y) { return data.data() + static_cast<size_t>(y) * w; }
+  const float* row(int y) const { return data.data() + static_cast<size_t>(y) * w; }
+  float at(int y, int x) const { return data[static_cast<size_t>(y) * w + x]; }
+};
+
+/** 检测阶段的候选点（octave 内坐标）。 */
+struct Candidate {
+  int octave;
+  int layer;       // 最近的高斯层（1..n_level），用于方向与描述子
+  float x;         // octave 内亚像素坐标
+  float y;
+  float sigma;     // octave 内尺度
+  float response;  // |DoG| 插值值
+};
+
+struct Octave {
+  std::vector<Plane> gauss; // n_level + 3 层
+};
+
+inline int clampi(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Kernels
+// ─────────────────────────────────────────────────────────────────────────────
+
+/** 对称高斯核的半边：k[0] 为中心，k[i] 为距离 i 的权重，总和（含对称项）为 1。 */
+std::vector<float> gaussian_half_kernel(double sigma) {
+  const int radius = std::max(1, static_cast<int>(std::ceil(4.0 * sigma)));
+  std::vector<float> k(static_cast<size_t>(radius) + 1);
+  double sum = 0.0;
+  for (int i = 0; i <= radius; ++i) {
+    const double v = std::exp(-0.5 * (i * i) / (sigma * sigma));
+    k[static_cast<size_t>(i)] = static_cast<float>(v);
+    sum += (i == 0) ? v : 2.0 * v;
+  }
+  for (auto& v : k)
+    v = static_cast<float>(v / sum);
+  return k;
+}
+
+/** 水平方向卷积，边界按 clamp 取样；内部区段 8 路 SIMD。 */
+void blur_horizontal(const Plane& src, Plane& dst, const std::vector<float>& k) {
+  const int w = src.w;
+  const int r = static_cast<int>(k.size()) - 1;
+  for (int y = 0; y < src.h; ++y) {
+    const float* s = src.row(y);
+    float* d = dst.row(y);
+    auto scalar_at = [&](int x) {
+      float acc = k[0] * s[x];
+      for (int i = 1; i <= r; ++i)
+        acc += k[static_cast<size_t>(i)] * (s[clampi(x - i, 0, w - 1)] + s[clampi(x + i, 0, w - 1)]);
+      return acc;
+    };
+    int x = 0;
+    const int interior_end = w - r; // x + r < w
+    for (; x < std::min(r, w); ++x)
+      d[x] = scalar_at(x);
+#if defined(__AVX2__)
+    for (; x + 8 <= interior_end; x += 8) {
+      __m256 acc = _mm256_mul_ps(_mm256_set1_ps(k[0]), _mm256_loadu_ps(s + x));
+      for (int i = 1; i <= r; ++i) {
+        const __m256 pair = _mm256_add_ps(_mm256_loadu_ps(s + x - i), _mm256_loadu_ps(s + x + i));
+        acc = _mm256_fmadd_ps(_mm256_set1_ps(k[static_cast<size_t>(i)]), pair, acc);
+      }
+      _mm256_storeu_ps(d + x, acc);
+    }
+#endif
+    for (; x < interior_end; ++x) {
+      float acc = k[0] * s[x];
+      for (int i = 1; i <= r; ++i)
+        acc += k[static_cast<size_t>(i)] * (s[x - i] + s[x + i]);
+      d[x] = acc;
+    }
+    for (; x < w; ++x)
+      d[x] = scalar_at(x);
+  }
+}
+
+/** 垂直方向卷积：逐行累加对称行对，沿 x 做 8 路 SIMD。 */
+void blur_vertical(const Plane& src, Plane& dst, const std::vector<float>& k) {
+  const int w = src.w;
+  const int h = src.h;
+  const int r = static_cast<int>(k.size()) - 1;
+  for (int y = 0; y < h; ++y) {
+    float* d = dst.row(y);
+    const float* c = src.row(y);
+    int x = 0;
+#if defined(__AVX2__)
+    for (; x + 8 <= w; x += 8) {
+      __m256 acc = _mm256_mul_ps(_mm256_set1_ps(k[0]), _mm256_loadu_ps(c + x));
+      for (int i = 1; i <= r; ++i) {
+        const float* up = src.row(clampi(y - i, 0, h - 1));
+        const float* dn = src.row(clampi(y + i, 0, h - 1));
+        const __m256 pair = _mm256_add_ps(_mm256_loadu_ps(up + x), _mm256_loadu_ps(dn + x));
+        acc = _mm256_fmadd_ps(_mm256_set1_ps(k[static_cast<size_t>(i)]), pair, acc);
+      }
+      _mm256_storeu_ps(d + x, acc);
+    }
+#endif
+    for (int xx = x; xx < w; ++xx)
+      d[xx] = k[0] * c[xx];
+    for (int i = 1; i <= r; ++i) {
+      const float* up = src.row(clampi(y - i, 0, h - 1));
+      const float* dn = src.row(clampi(y + i, 0, h - 1));
+      const float ki = k[static_cast<size_t>(i)];
+      for (int xx = x; xx < w; ++xx)
+        d[xx] += ki * (up[xx] + dn[xx]);
+    }
+  }
+}
+
+void gaussian_blur(const Plane& src, Plane& dst, double sigma, Plane& tmp) {
+  if (sigma <= 0.0) {
+    dst = src;
+    return;
+  }
+  const auto k = gaussian_half_kernel(sigma);
+  tmp = Plane(src.w, src.h);
+  dst = Plane(src.w, src.h);
+  blur_horizontal(src, tmp, k);
+  blur_vertical(tmp, dst, k);
+}
+
+void subtract(const Plane& a, const Plane& b, Plane& out) {
+  out = Plane(a.w, a.h);
+  const size_t n = a.data.size();
+  const float* pa = a.data.data();
+  const float* pb = b.data.data();
+  float* po = out.data.data();
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(po + i, _mm256_sub_ps(_mm256_loadu_ps(pa + i), _mm256_loadu_ps(pb + i)));
+#endif
+  for (; i < n; ++i)
+    po[i] = pa[i] - pb[i];
+}
+
+Plane decimate(const Plane& src) {
+  Plane out(std::max(1, src.w / 2), std::max(1, src.h / 2));
+  for (int y = 0; y < out.h; ++y) {
+    const float* s = src.row(2 * y);
+    float* d = out.row(y);
+    for (int x = 0; x < out.w; ++x)
+      d[x] = s[2 * x];
+  }
+  return out;
+}
+
+/** 双线性 2x 上采样（像素中心对齐）。 */
+Plane upsample2x(const Plane& src) {
+  Plane out(src.w * 2, src.h * 2);
+  for (int y = 0; y < out.h; ++y) {
+    const float fy = std::max(0.0f, (y + 0.5f) * 0.5f - 0.5f);
+    const int y0 = std::min(static_cast<int>(fy), src.h - 1);
+    const int y1 = std::min(y0 + 1, src.h - 1);
+    const float wy = fy - static_cast<float>(y0);
+    const float* r0 = src.row(y0);
+    const float* r1 = src.row(y1);
+    float* d = out.row(y);
+    for (int x = 0; x < out.w; ++x) {
+      const float fx = std::max(0.0f, (x + 0.5f) * 0.5f - 0.5f);
+      const int x0 = std::min(static_cast<int>(fx), src.w - 1);
+      const int x1 = std::min(x0 + 1, src.w - 1);
+      const float wx = fx - static_cast<float>(x0);
+      const float top = r0[x0] + wx * (r0[x1] - r0[x0]);
+      const float bot = r1[x0] + wx * (r1[x1] - r1[x0]);
+      d[x] = top + wy * (bot - top);
+    }
+  }
+  return out;
+}
+
+/** 2x 面积平均降采样（像素中心对齐，与 base → 输入的比例映射一致）。 */
+Plane downsample2x_area(const Plane& src) {
+  Plane out(std::max(1, src.w / 2), std::max(1, src.h / 2));
+  for (int y = 0; y < out.h; ++y) {
+    const float* r0 = src.row(std::min(2 * y, src.h - 1));
+    const float* r1 = src.row(std::min(2 * y + 1, src.h - 1));
+    float* d = out.row(y);
+    for (int x = 0; x < out.w; ++x) {
+      const int x0 = std::min(2 * x, src.w - 1);
+      const int x1 = std::min(2 * x + 1, src.w - 1);
+      d[x] = 0.25f * (r0[x0] + r0[x1] + r1[x0] + r1[x1]);
+    }
+  }
+  return out;
+}
+
+/** atan2 多项式近似（最大误差约 1e-5 rad），返回 [0, 2π)。标量与 SIMD 版本使用同一公式。 */
+inline float fast_atan2_0_2pi(float y, float x) {
+  const float ax = std::fabs(x);
+  const float ay = std::fabs(y);
+  const float a = std::min(ax, ay) / (std::max(ax, ay) + 1e-20f);
+  const float s = a * a;
+  float r = ((-0.0464964749f * s + 0.15931422f) * s - 0.327622764f) * s * a + a;
+  if (ay > ax)
+    r = 1.57079637f - r;
+  if (x < 0)
+    r = 3.14159274f - r;
+  if (y < 0)
+    r = kTwoPi - r;
+  return r >= kTwoPi ? r - kTwoPi : r;
+}
+
+#if defined(__AVX2__)
+inline __m256 fast_atan2_0_2pi_avx2(__m256 y, __m256 x) {
+  const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 ax = _mm256_andnot_ps(sign_mask, x);
+  const __m256 ay = _mm256_andnot_ps(sign_mask, y);
+  const __m256 a = _mm256_div_ps(_mm256_min_ps(ax, ay),
+                                 _mm256_add_ps(_mm256_max_ps(ax, ay), _mm256_set1_ps(1e-20f)));
+  const __m256 s = _mm256_mul_ps(a, a);
+  __m256 p = _mm256_fmadd_ps(_mm256_set1_ps(-0.0464964749f), s, _mm256_set1_ps(0.15931422f));
+  p = _mm256_fmadd_ps(p, s, _mm256_set1_ps(-0.327622764f));
+  __m256 r = _mm256_fmadd_ps(_mm256_mul_ps(p, s), a, a);
+  r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(1.57079637f), r),
+                       _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+  r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(3.14159274f), r),
+                       _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+  r = _mm256_blendv_ps(r, _mm256_sub_ps(_mm256_set1_ps(kTwoPi), r),
+                       _mm256_cmp_ps(y, zero, _CMP_LT_OQ));
+  const __m256 two_pi = _mm256_set1_ps(kTwoPi);
+  return _mm256_blendv_ps(r, _mm256_sub_ps(r, two_pi), _mm256_cmp_ps(r, two_pi, _CMP_GE_OQ));
+}
+#endif
+
+/**
+ * 梯度幅值与方向图（dx = I(x+1) - I(x-1)，dy = I(y-1) - I(y+1)，即 y 轴向上的角度）。
+ * 边界一圈像素置 0，方向与描述子的采样本来就不会越过它。
+ */
+void gradient_planes(const Plane& img, Plane& mag, Plane& ori) {
+  const int w = img.w;
+  const int h = img.h;
+  mag = Plane(w, h);
+  ori = Plane(w, h);
+  for (int y = 1; y < h - 1; ++y) {
+    const float* up = img.row(y - 1);
+    const float* c = img.row(y);
+    const float* dn = img.row(y + 1);
+    float* m = mag.row(y);
+    float* o = ori.row(y);
+    int x = 1;
+#if defined(__AVX2__)
+    for (; x + 8 <= w - 1; x += 8) {
+      const __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(c + x + 1), _mm256_loadu_ps(c + x - 1));
+      const __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(up + x), _mm256_loadu_ps(dn + x));
+      _mm256_storeu_ps(m + x, _mm256_sqrt_ps(_mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy))));
+      _mm256_storeu_ps(o + x, fast_atan2_0_2pi_avx2(dy, dx));
+    }
+#endif
+    for (; x < w - 1; ++x) {
+      const float dx = c[x + 1] - c[x - 1];
+      const float dy = up[x] - dn[x];
+      m[x] = std::sqrt(dx * dx + dy * dy);
+      o[x] = fast_atan2_0_2pi(dy, dx);
+    }
+  }
+}
+
+/** 将 v 归一化为单位 L2 范数（与 SiftGPU 输出一致），返回原范数。 */
+float normalize_l2(float* v, int n) {
+  float sum = 0.0f;
+  int i = 0;
+#if defined(__AVX2__)
+  __m256 acc = _mm256_setzero_ps();
+  for (; i + 8 <= n; i += 8) {
+    const __m256 x = _mm256_loadu_ps(v + i);
+    acc = _mm256_fmadd_ps(x, x, acc);
+  }
+  alignas(32) float lanes[8];
+  _mm256_store_ps(lanes, acc);
+  for (float l : lanes)
+    sum += l;
+#endif
+  for (; i < n; ++i)
+    sum += v[i] * v[i];
+  const float norm = std::sqrt(sum);
+  if (norm <= 0.0f)
+    return 0.0f;
+  const float inv = 1.0f / norm;
+  i = 0;
+#if defined(__AVX2__)
+  const __m256 vinv = _mm256_set1_ps(inv);
+  for (; i + 8 <= n; i += 8)
+    _mm256_storeu_ps(v + i, _mm256_mul_ps(_mm256_loadu_ps(v + i), vinv));
+#endif
+  for (; i < n; ++i)
+    v[i] *= inv;
+  return norm;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Detection
+// ─────────────────────────────────────────────────────────────────────────────
+
+inline bool is_extremum(const Plane* dogs[3], int y, int x, float v) {
+  if (v > 0.0f) {
+    for (int l = 0; l < 3; ++l) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        const float* r = dogs[l]->row(y + dy);
+        if (r[x - 1] > v || r[x] > v || r[x + 1] > v)
+          return false;
+      }
+    }
+  } else {
+    for (int l = 0; l < 3; ++l) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        const float* r = dogs[l]->row(y + dy);
+        if (r[x - 1] < v || r[x] < v || r[x + 1] < v)
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+/** 解 3x3 对称线性系统 H x = b（Cramer），奇异时返回 false。 */
+bool solve3(const float H[3][3], const float b[3], float x[3]) {
+  const float det = H[0][0] * (H[1][1] * H[2][2] - H[1][2] * H[2][1]) -
+                    H[0][1] * (H[1][0] * H[2][2] - H[1][2] * H[2][0]) +
+                    H[0][2] * (H[1][0] * H[2][1] - H[1][1] * H[2][0]);
+  if (std::fabs(det) < 1e-12f)
+    return false;
+  const float inv = 1.0f / det;
+  x[0] = inv * (b[0] * (H[1][1] * H[2][2] - H[1][2] * H[2][1]) -
+                H[0][1] * (b[1] * H[2][2] - H[1][2] * b[2]) +
+                H[0][2] * (b[1] * H[2][1] - H[1][1] * b[2]));
+  x[1] = inv * (H[0][0] * (b[1] * H[2][2] - H[1][2] * b[2]) -
+                b[0] * (H[1][0] * H[2][2] - H[1][2] * H[2][0]) +
+                H[0][2] * (H[1][0] * b[2] - b[1] * H[2][0]));
+  x[2] = inv * (H[0][0] * (H[1][1] * b[2] - b[1] * H[2][1]) -
+                H[0][1] * (H[1][0] * b[2] - b[1] * H[2][0]) +
+                b[0] * (H[1][0] * H[2][1] - H[1][1] * H[2][0]));
+  return true;
+}
+
+/**
+ * 亚像素/亚层插值 + 对比度与边缘检验（Lowe 2004 §4）。dogs 为该 octave 的全部 DoG 层，
+ * layer 为 1..n_level。成功时填充 cand。
+ */
+bool refine_extremum(const std::vector<Plane>& dogs, int octave, int layer, int y, int x,
+                     int n_level, float contrast_threshold, float edge_threshold,
+                     double sigma, Candidate* cand) {
+  const int w = dogs[0].w;
+  const int h = dogs[0].h;
+  float off[3] = {0.0f, 0.0f, 0.0f}; // (x, y, layer)
+  float grad[3] = {0.0f, 0.0f, 0.0f};
+  int step = 0;
+  for (; step < kMaxInterpSteps; ++step) {
+    const Plane& prev = dogs[static_cast<size_t>(layer - 1)];
+    const Plane& cur = dogs[static_cast<size_t>(layer)];
+    const Plane& next = dogs[static_cast<size_t>(layer + 1)];
+    const float v2 = 2.0f * cur.at(y, x);
+    grad[0] = 0.5f * (cur.at(y, x + 1) - cur.at(y, x - 1));
+    grad[1] = 0.5f * (cur.at(y + 1, x) - cur.at(y - 1, x));
+    grad[2] = 0.5f * (next.at(y, x) - prev.at(y, x));
+    const float dxx = cur.at(y, x + 1) + cur.at(y, x - 1) - v2;
+    const float dyy = cur.at(y + 1, x) + cur.at(y - 1, x) - v2;
+    const float dss = next.at(y, x) + prev.at(y, x) - v2;
+    const float dxy = 0.25f * (cur.at(y + 1, x + 1) - cur.at(y + 1, x - 1) -
+                               cur.at(y - 1, x + 1) + cur.at(y - 1, x - 1));
+    const float dxs = 0.25f * (next.at(y, x + 1) - next.at(y, x - 1) -
+                               prev.at(y, x + 1) + prev.at(y, x - 1));
+    const float dys = 0.25f * (next.at(y + 1, x) - next.at(y - 1, x) -
+                               prev.at(y + 1, x) + prev.at(y - 1, x));
+    const float H[3][3] = {{dxx, dxy, dxs}, {dxy, dyy, dys}, {dxs, dys, dss}};
+    const float b[3] = {-grad[0], -grad[1], -grad[2]};
+    if (!solve3(H, b, off))
+      return false;
+    if (std::fabs(off[0]) < 0.5f && std::fabs(off[1]) < 0.5f && std::fabs(off[2]) < 0.5f)
+      break;
+    if (std::fabs(off[0]) > 1e6f || std::fabs(off[1]) > 1e6f || std::fabs(off[2]) > 1e6f)
+      return false;
+    x += static_cast<int>(std::lround(off[0]));
+    y += static_cast<int>(std::lround(off[1]));
+    layer += static_cast<int>(std::lround(off[2]));
+    if (layer < 1 || layer > n_level || x < kImageBorder || x >= w - kImageBorder ||
+        y < kImageBorder || y >= h - kImageBorder)
+      return false;
+  }
+  if (step >= kMaxInterpSteps)
+    return false;
+
+  const Plane& cur = dogs[static_cast<size_t>(layer)];
+  const float contrast =
+      cur.at(y, x) + 0.5f * (grad[0] * off[0] + grad[1] * off[1] + grad[2] * off[2]);
+  if (std::fabs(contrast) < contrast_threshold)
+    return false;
+
+  const float v2 = 2.0f * cur.at(y, x);
+  const float dxx = cur.at(y, x + 1) + cur.at(y, x - 1) - v2;
+  const float dyy = cur.at(y + 1, x) + cur.at(y - 1, x) - v2;
+  const float dxy = 0.25f * (cur.at(y + 1, x + 1) - cur.at(y + 1, x - 1) -
+                             cur.at(y - 1, x + 1) + cur.at(y - 1, x - 1));
+  const float tr = dxx + dyy;
+  const float det = dxx * dyy - dxy * dxy;
+  if (det <= 0.0f ||
+      tr * tr * edge_threshold >= (edge_threshold + 1.0f) * (edge_threshold + 1.0f) * det)
+    return false;
+
+  const float layer_f = static_cast<float>(layer) + off[2];
+  cand->octave = octave;
+  cand->layer = clampi(static_cast<int>(std::lround(layer_f)), 1, n_level);
+  cand->x = static_cast<float>(x) + off[0];
+  cand->y = static_cast<float>(y) + off[1];
+  cand->sigma = static_cast<float>(sigma * std::pow(2.0, layer_f / n_level));
+  cand->response = std::fabs(contrast);
+  return true;
+}
+
+/**
+ * 在 DoG 层 layer 上扫描极值。每行先以 |v| > prethreshold 做 SIMD 预筛（movemask），
+ * 仅对通过的像素做 26 邻域比较与插值。
+ */
+void detect_layer(const std::vector<Plane>& dogs, int octave, int layer, int n_level,
+                  float contrast_threshold, float edge_threshold, double sigma,
+                  std::vector<Candidate>& out) {
+  const Plane* trio[3] = {&dogs[static_cast<size_t>(layer - 1)], &dogs[static_cast<size_t>(layer)],
+                          &dogs[static_cast<size_t>(layer + 1)]};
+  const Plane& cur = *trio[1];
+  const int w = cur.w;
+  const int h = cur.h;
+  const float prethreshold = 0.5f * contrast_threshold;
+  auto visit = [&](int y, int x, float v) {
+    if (!is_extremum(trio, y, x, v))
+      return;
+    Candidate c;
+    if (refine_extremum(dogs, octave, layer, y, x, n_level, contrast_threshold, edge_threshold,
+                        sigma, &c))
+      out.push_back(c);
+  };
+  for (int y = kImageBorder; y < h - kImageBorder; ++y) {
+    const float* r = cur.row(y);
+    int x = kImageBorder;
+#if defined(__AVX2__)
+    const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+    const __m256 thr = _mm256_set1_ps(prethreshold);
+    for (; x + 8 <= w - kImageBorder; x += 8) {
+      const __m256 av = _mm256_andnot_ps(sign_mask, _mm256_loadu_ps(r + x));
+      int mask = _mm256_movemask_ps(_mm256_cmp_ps(av, thr, _CMP_GT_OQ));
+      while (mask) {
+        const int lane = __builtin_ctz(static_cast<unsigned>(mask));
+        mask &= mask - 1;
+        visit(y, x + lane, r[x + lane]);
+      }
+    }
+#endif
+    for (; x < w - kImageBorder; ++x) {
+      if (std::fabs(r[x]) > prethreshold)
+        visit(y, x, r[x]);
+    }
+  }
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Orientation / descriptor
+// ─────────────────────────────────────────────────────────────────────────────
+
+/** 36-bin 方向直方图，返回 ≥ 0.8 * 峰值的局部峰（抛物线插值，弧度 [0, 2π)）。 */
+void compute_orientations(const Plane& mag, const Plane& ori, float x, float y, float sigma,
+                          std::vector<float>& angles) {
+  angles.clear();
+  const float sig = kOriSigmaFactor * sigma;
+  const int radius = static_cast<int>(std::lround(kOriRadiusFactor * sig));
+  const float exp_scale = -1.0f / (2.0f * sig * sig);
+  const int cx = static_cast<int>(std::lround(x));
+  const int cy = static_cast<int>(std::lround(y));
+  float hist[kOriHistBins + 4] = {};
+  float* h = hist + 2;
+  for (int dy = -radius; dy <= radius; ++dy) {
+    const int yy = cy + dy;
+    if (yy <= 0 || yy >= mag.h - 1)
+      continue;
+    const float* m = mag.row(yy);
+    const float* o = ori.row(yy);
+    for (int dx = -radius; dx <= radius; ++dx) {
+      const int xx = cx + dx;
+      if (xx <= 0 || xx >= mag.w - 1)
+        continue;
+      const float wgt = std::exp(static_cast<float>(dx * dx + dy * dy) * exp_scale);
+      int bin = static_cast<int>(std::lround(o[xx] * (kOriHistBins / kTwoPi)));
+      if (bin >= kOriHistBins)
+        bin -= kOriHistBins;
+      h[bin] += wgt * m[xx];
+    }
+  }
+  // [1 4 6 4 1] / 16 环形平滑
+  h[-1] = h[kOriHistBins - 1];
+  h[-2] = h[kOriHistBins - 2];
+  h[kOriHistBins] = h[0];
+  h[kOriHistBins + 1] = h[1];
+  float smooth[kOriHistBins];
+  float max_v = 0.0f;
+  for (int i = 0; i < kOriHistBins; ++i) {
+    smooth[i] = (h[i - 2] + h[i + 2]) * (1.0f / 16) + (h[i - 1] + h[i + 1]) * (4.0f / 16) +
+                h[i] * (6.0f / 16);
+    max_v = std::max(max_v, smooth[i]);
+  }
+  if (max_v <= 0.0f)
+    return;
+  const float thr = kOriPeakRatio * max_v;
+  for (int i = 0; i < kOriHistBins; ++i) {
+    const float l = smooth[(i + kOriHistBins - 1) % kOriHistBins];
+    const float r = smooth[(i + 1) % kOriHistBins];
+    const float c = smooth[i];
+    if (c > l && c > r && c >= thr) {
+      float bin = static_cast<float>(i) + 0.5f * (l - r) / (l - 2.0f * c + r);
+      if (bin < 0.0f)
+        bin += kOriHistBins;
+      else if (bin >= kOriHistBins)
+        bin -= kOriHistBins;
+      angles.push_back(bin * (kTwoPi / kOriHistBins));
+    }
+  }
+}
+
+/**
+ * 4x4x8 描述子（UBC/Lowe 布局：dst[(row * 4 + col) * 8 + o]），采样预计算的梯度图，
+ * 三线性插值分配；归一化 → 截断 0.2 → 再归一化（单位 L2，与 SiftGPU float 输出一致）。
+ */
+void compute_descriptor(const Plane& mag, const Plane& ori, float x, float y, float sigma,
+                        float angle, float* dst) {
+  const float cos_t = std::cos(angle);
+  const float sin_t = std::sin(angle);
+  const float hist_width = kDescScaleFactor * sigma;
+  const float bins_per_rad = kDescHistBins / kTwoPi;
+  const float exp_scale = -1.0f / (kDescWidth * kDescWidth * 0.5f);
+  int radius = static_cast<int>(
+      std::lround(hist_width * 1.4142135623730951f * (kDescWidth + 1) * 0.5f));
+  radius = std::min(radius, static_cast<int>(std::sqrt(static_cast<double>(mag.w) * mag.w +
+                                                       static_cast<double>(mag.h) * mag.h)));
+  const float cos_n = cos_t / hist_width;
+  const float sin_n = sin_t / hist_width;
+  const int cx = static_cast<int>(std::lround(x));
+  const int cy = static_cast<int>(std::lround(y));
+
+  constexpr int kHistW = kDescWidth + 2;
+  float hist[kHistW * kHistW * (kDescHistBins + 2)] = {};
+  for (int i = -radius; i <= radius; ++i) {
+    const int yy = cy + i;
+    if (yy <= 0 || yy >= mag.h - 1)
+      continue;
+    const float* m = mag.row(yy);
+    const float* o = ori.row(yy);
+    for (int j = -radius; j <= radius; ++j) {
+      const int xx = cx + j;
+      if (xx <= 0 || xx >= mag.w - 1)
+        continue;
+      const float c_rot = static_cast<float>(j) * cos_n - static_cast<float>(i) * sin_n;
+      const float r_rot = static_cast<float>(j) * sin_n + static_cast<float>(i) * cos_n;
+      // 角度为 y 向上约定；(c_rot, r_rot) 已是旋转后坐标系中的 (列, 行向下) 偏移
+      const float rbin = r_rot + kDescWidth / 2 - 0.5f;
+      const float cbin = c_rot + kDescWidth / 2 - 0.5f;
+      if (rbin <= -1.0f || rbin >= kDescWidth || cbin <= -1.0f || cbin >= kDescWidth)
+        continue;
+      float obin = (o[xx] - angle) * bins_per_rad;
+      const float wgt = std::exp((c_rot * c_rot + r_rot * r_rot) * exp_scale) * m[xx];
+
+      const int r0 = static_cast<int>(std::floor(rbin));
+      const int c0 = static_cast<int>(std::floor(cbin));
+      int o0 = static_cast<int>(std::floor(obin));
+      const float fr = rbin - r0;
+      const float fc = cbin - c0;
+      const float fo = obin - o0;
+      o0 = ((o0 % kDescHistBins) + kDescHistBins) % kDescHistBins;
+
+      const float v_r1 = wgt * fr;
+      const float v_r0 = wgt - v_r1;
+      const float v_rc11 = v_r1 * fc;
+      const float v_rc10 = v_r1 - v_rc11;
+      const float v_rc01 = v_r0 * fc;
+      const float v_rc00 = v_r0 - v_rc01;
+      const float v_rco111 = v_rc11 * fo;
+      const float v_rco110 = v_rc11 - v_rco111;
+      const float v_rco101 = v_rc10 * fo;
+      const float v_rco100 = v_rc10 - v_rco101;
+      const float v_rco011 = v_rc01 * fo;
+      const float v_rco010 = v_rc01 - v_rco011;
+      const float v_rco001 = v_rc00 * fo;
+      const float v_rco000 = v_rc00 - v_rco001;
+
+      const int idx = ((r0 + 1) * kHistW + (c0 + 1)) * (kDescHistBins + 2) + o0;
+      hist[idx] += v_rco000;
+      hist[idx + 1] += v_rco001;
+      hist[idx + (kDescHistBins + 2)] += v_rco010;
+      hist[idx + (kDescHistBins + 3)] += v_rco011;
+      hist[idx + kHistW * (kDescHistBins + 2)] += v_rco100;
+      hist[idx + kHistW * (kDescHistBins + 2) + 1] += v_rco101;
+      hist[idx + (kHistW + 1) * (kDescHistBins + 2)] += v_rco110;
+      hist[idx + (kHistW + 1) * (kDescHistBins + 2) + 1] += v_rco111;
+    }
+  }
+  for (int r = 0; r < kDescWidth; ++r) {
+    for (int c = 0; c < kDescWidth; ++c) {
+      const int idx = ((r + 1) * kHistW + (c + 1)) * (kDescHistBins + 2);
+      hist[idx] += hist[idx + kDescHistBins];
+      hist[idx + 1] += hist[idx + kDescHistBins + 1];
+      for (int k = 0; k < kDescHistBins; ++k)
+        dst[(r * kDescWidth + c) * kDescHistBins + k] = hist[idx + k];
+    }
+  }
+  if (normalize_l2(dst, kDescDim) <= 0.0f)
+    return;
+  for (int k = 0; k < kDescDim; ++k)
+    dst[k] = std::min(dst[k], kDescMagThreshold);
+  normalize_l2(dst, kDescDim);
+}
+
+} // namespace
+
+// ─────────────────────────────────────────────────────────────────────────────
+// CpuSiftExtractor
+// ─────────────────────────────────────────────────────────────────────────────
+
+bool CpuSiftExtractor::simd_enabled() {
+#if defined(__AVX2__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+int CpuSiftExtractor::extract(const cv::Mat& image, std::vector<SiftGPU::SiftKeypoint>& keypoints,
+                              std::vector<float>& descriptors) const {
+  keypoints.clear();
+  descriptors.clear();
+  if (image.empty())
+    return 0;
+  cv::Mat gray;
+  if (image.channels() == 3)
+    cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+  else if (image.channels() == 4)
+    cv::cvtColor(image, gray, cv::COLOR_BGRA2GRAY);
+  else
+    gray = image;
+
+  double scale = 1.0;
+  if (gray.depth() == CV_8U)
+    scale = 1.0 / 255.0;
+  else if (gray.depth() == CV_16U)
+    scale = 1.0 / 65535.0;
+  cv::Mat gray_f;
+  gray.convertTo(gray_f, CV_32F, scale);
+  if (!gray_f.isContinuous())
+    gray_f = gray_f.clone();
+  return extract_gray(gray_f.ptr<float>(), gray_f.cols, gray_f.rows, keypoints, descriptors);
+}
+
+int CpuSiftExtractor::extract_gray(const float* gray, int width, int height,
+                                   std::vector<SiftGPU::SiftKeypoint>& keypoints,
+                                   std::vector<float>& descriptors) const {
+  keypoints.clear();
+  descriptors.clear();
+  if (!gray || width <= 0 || height <= 0)
+    return 0;
+
+  const int n_level = std::max(1, params_.n_level);
+  const double sigma = params_.sigma;
+
+  // ── Base image: max-dimension 限制 + 起始 octave ──────────────────────────
+  Plane base(width, height);
+  std::memcpy(base.data.data(), gray, base.data.size() * sizeof(float));
+  double to_input = 1.0; // x_in + 0.5 = (x_base + 0.5) * to_input
+  if (params_.image_max_dimension > 0) {
+    while (std::max(base.w, base.h) > params_.image_max_dimension) {
+      base = downsample2x_area(base);
+      to_input *= 2.0;
+    }
+  }
+  double base_blur = 0.5; // 假定输入图像自带 0.5 像素模糊
+  if (params_.n_octave_from < 0) {
+    base = upsample2x(base);
+    to_input *= 0.5;
+    base_blur = 1.0;
+  } else {
+    for (int i = 0; i < params_.n_octave_from && std::min(base.w, base.h) >= 32; ++i) {
+      base = downsample2x_area(base);
+      to_input *= 2.0;
+      base_blur = 0.5;
+    }
+  }
+
+  float contrast_threshold = static_cast<float>(params_.d_peak / n_level);
+  if (params_.adapt_darkness) {
+    // 暗图整体对比度低：按平均亮度线性降低阈值（与 SiftGPU -da 同向，下限 1/4）
+    double sum = 0.0;
+    for (float v : base.data)
+      sum += v;
+    const double mean = sum / static_cast<double>(base.data.size());
+    contrast_threshold *= static_cast<float>(std::clamp(mean * 2.0, 0.25, 1.0));
+  }
+  const float edge_threshold = static_cast<float>(params_.edge_threshold);
+
+  int n_octaves = static_cast<int>(std::floor(std::log2(std::min(base.w, base.h)))) - 3;
+  if (params_.n_octaves > 0)
+    n_octaves = std::min(n_octaves, params_.n_octaves);
+  n_octaves = std::max(1, n_octaves);
+
+  // 每层相对前一层的增量模糊
+  const double k = std::pow(2.0, 1.0 / n_level);
+  std::vector<double> sig_inc(static_cast<size_t>(n_level) + 3);
+  sig_inc[0] = std::sqrt(std::max(0.01, sigma * sigma - base_blur * base_blur));
+  for (int i = 1; i < n_level + 3; ++i) {
+    const double prev = std::pow(k, i - 1) * sigma;
+    const double total = prev * k;
+    sig_inc[static_cast<size_t>(i)] = std::sqrt(total * total - prev * prev);
+  }
+
+  // ── Pyramid + detection ───────────────────────────────────────────────────
+  std::vector<Octave> octaves(static_cast<size_t>(n_octaves));
+  std::vector<Candidate> candidates;
+  Plane tmp;
+  for (int o = 0; o < n_octaves; ++o) {
+    auto& gauss = octaves[static_cast<size_t>(o)].gauss;
+    gauss.resize(static_cast<size_t>(n_level) + 3);
+    if (o == 0)
+      gaussian_blur(base, gauss[0], sig_inc[0], tmp);
+    else
+      gauss[0] = decimate(octaves[static_cast<size_t>(o) - 1].gauss[static_cast<size_t>(n_level)]);
+    for (int i = 1; i < n_level + 3; ++i)
+      gaussian_blur(gauss[static_cast<size_t>(i) - 1], gauss[static_cast<size_t>(i)],
+                    sig_inc[static_cast<size_t>(i)], tmp);
+    if (o == 0)
+      base = Plane();
+
+    const int ow = gauss[0].w;
+    const int oh = gauss[0].h;
+    if (ow <= 2 * kImageBorder + 2 || oh <= 2 * kImageBorder + 2) {
+      octaves.resize(static_cast<size_t>(o) + 1);
+      break;
+    }
+    std::vector<Plane> dogs(static_cast<size_t>(n_level) + 2);
+    for (int i = 0; i < n_level + 2; ++i)
+      subtract(gauss[static_cast<size_t>(i) + 1], gauss[static_cast<size_t>(i)],
+               dogs[static_cast<size_t>(i)]);
+    for (int layer = 1; layer <= n_level; ++layer)
+      detect_layer(dogs, o, layer, n_level, contrast_threshold, edge_threshold, sigma, candidates);
+  }
+  tmp = Plane();
+
+  // 先按响应保留最强的 n_max_features 个候选，避免为被丢弃的点计算描述子
+  auto by_response = [](const Candidate& a, const Candidate& b) { return a.response > b.response; };
+  const size_t max_features =
+      params_.n_max_features > 0 ? static_cast<size_t>(params_.n_max_features) : candidates.size();
+  if (candidates.size() > max_features) {
+    std::nth_element(candidates.begin(), candidates.begin() + static_cast<std::ptrdiff_t>(max_features),
+                     candidates.end(), by_response);
+    candidates.resize(max_features);
+  }
+  // 按 (octave, layer) 分组，使每层梯度图只计算一次
+  std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+    if (a.octave != b.octave)
+      return a.octave < b.octave;
+    if (a.layer != b.layer)
+      return a.layer < b.layer;
+    return a.response > b.response;
+  });
+
+  // ── Orientation + descriptor ──────────────────────────────────────────────
+  struct Feature {
+    SiftGPU::SiftKeypoint kp;
+    float response;
+    size_t desc_offset;
+  };
+  std::vector<Feature> features;
+  features.reserve(candidates.size() + candidates.size() / 4);
+  std::vector<float> desc_pool;
+  desc_pool.reserve(features.capacity() * kDescDim);
+  std::vector<float> angles;
+  Plane mag, ori;
+  int grad_octave = -1;
+  int grad_layer = -1;
+  for (const auto& c : candidates) {
+    if (c.octave != grad_octave || c.layer != grad_layer) {
+      gradient_planes(octaves[static_cast<size_t>(c.octave)].gauss[static_cast<size_t>(c.layer)],
+                      mag, ori);
+      grad_octave = c.octave;
+      grad_layer = c.layer;
+    }
+    compute_orientations(mag, ori, c.x, c.y, c.sigma, angles);
+    const double octave_scale = std::ldexp(1.0, c.octave) * to_input;
+    for (float angle : angles) {
+      Feature f;
+      f.kp.x = static_cast<float>((std::ldexp(static_cast<double>(c.x), c.octave) + 0.5) * to_input);
+      f.kp.y = static_cast<float>((std::ldexp(static_cast<double>(c.y), c.octave) + 0.5) * to_input);
+      f.kp.s = static_cast<float>(c.sigma * octave_scale);
+      f.kp.o = angle;
+      f.response = c.response;
+      f.desc_offset = desc_pool.size();
+      desc_pool.resize(desc_pool.size() + kDescDim);
+      compute_descriptor(mag, ori, c.x, c.y, c.sigma, angle, desc_pool.data() + f.desc_offset);
+      features.push_back(f);
+    }
+  }
+
+  // 多方向会让数量略超上限：按响应稳定排序后截断
+  std::stable_sort(features.begin(), features.end(),
+                   [](const Feature& a, const Feature& b) { return a.response > b.response; });
+  if (features.size() > max_features)
+    features.resize(max_features);
+
+  keypoints.resize(features.size());
+  descriptors.resize(features.size() * kDescDim);
+  for (size_t i = 0; i < features.size(); ++i) {
+    keypoints[i] = features[i].kp;
+    std::memcpy(descriptors.data() + i * kDescDim, desc_pool.data() + features[i].desc_offset,
+                kDescDim * sizeof(float));
+  }
+  VLOG(2) << "CpuSift: " << width << "x" << height << " octaves=" << octaves.size()
+          << " features=" << keypoints.size();
+  return static_cast<int>(keypoints.size());
+}
+
+} // namespace modules
+} // namespace insight
@@ -0,0 +1,63 @@
+/**
+ * @file  cpu_sift_extractor.h
+ * @brief CPU SIFT 特征提取（无 GPU 节点）：DoG 金字塔 + 方向 + 128 维描述子。
+ *
+ * 输出与 SiftGPUExtractor 相同：SiftGPU::SiftKeypoint（原图像素坐标，像素中心 +0.5）与
+ * L2 归一化的 float 描述子（UBC 布局 4x4x8），后续 L2/RootSIFT、uint8(×512) 转换沿用
+ * isat_extract 的 PostProcess 阶段，因此 .isat_feat 的 DescriptorSchema 不变。
+ *
+ * extract() 为 const 且不持有共享可变状态，一个实例可被多个 Stage 线程同时调用。
+ * 高斯模糊 / DoG / 极值预筛 / 梯度幅值方向 / 描述子归一化在编译期启用 AVX2
+ * (__AVX2__，见 INSIGHTAT_ENABLE_AVX2) 时走 SIMD 核，否则走等价的标量实现。
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "SiftGPU/SiftGPU.h"
+
+namespace insight {
+namespace modules {
+
+/** CPU SIFT 参数，字段含义与 SiftGPUParams 对齐。 */
+struct CpuSiftParams {
+  int n_octave_from = 0;          ///< 起始 octave（-1 = 先上采样一级）
+  int n_octaves = -1;             ///< octave 数（-1 自动）
+  int n_level = 3;                ///< 每 octave 层数
+  double d_peak = 0.02;           ///< 峰值阈值（与 SiftGPU 一致，会除以 n_level）
+  double edge_threshold = 10.0;   ///< 主曲率比阈值 r
+  double sigma = 1.6;             ///< 每 octave 基准尺度
+  int n_max_features = 10000;     ///< 最大特征数（按 DoG 响应保留最强者）
+  bool adapt_darkness = true;     ///< 暗图降低阈值
+  int image_max_dimension = 8000; ///< 最大图像维度
+};
+
+class CpuSiftExtractor {
+public:
+  explicit CpuSiftExtractor(const CpuSiftParams& params) : params_(params) {}
+
+  /** 从图像（8U/16U/32F，1/3/4 通道）提取特征，返回提取数量。线程安全。 */
+  int extract(const cv::Mat& image, std::vector<SiftGPU::SiftKeypoint>& keypoints,
+              std::vector<float>& descriptors) const;
+
+  /** 同上，输入为行主序灰度 [0,1] 浮点图。 */
+  int extract_gray(const float* gray, int width, int height,
+                   std::vector<SiftGPU::SiftKeypoint>& keypoints,
+                   std::vector<float>& descriptors) const;
+
+  const CpuSiftParams& params() const { return params_; }
+
+  /** 编译期是否启用了 AVX2 核。 */
+  static bool simd_enabled();
+
+private:
+  CpuSiftParams params_;
+};
+
+} // namespace modules
+} // namespace insight
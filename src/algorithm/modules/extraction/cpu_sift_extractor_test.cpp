@@ -0,0 +1,168 @@
+/**
+ * @file  cpu_sift_extractor_test.cpp
+ * @brief Unit tests for the CPU SIFT extractor on synthetic images.
+ *
+ * Usage
+ * ─────
+ *   ./test_cpu_sift_extractor
+ */
+
+#include "cpu_sift_extractor.h"
+
+#include <glog/logging.h>
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace insight {
+namespace modules {
+namespace {
+
+constexpr int kDescriptorDim = 128;
+
+/** Smooth background plus random Gaussian blobs (bright and dark), 8-bit. */
+cv::Mat make_blob_image(int width, int height, uint32_t seed) {
+  cv::Mat img(height, width, CV_32F);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x)
+      img.at<float>(y, x) = 0.3f + 0.2f * std::sin(x * 0.05f) * std::cos(y * 0.07f);
+  }
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> u(0.0f, 1.0f);
+  for (int b = 0; b < 200; ++b) {
+    const float cx = u(rng) * width;
+    const float cy = u(rng) * height;
+    const float r = 2.0f + u(rng) * 10.0f;
+    const float a = u(rng) - 0.5f;
+    for (int y = std::max(0, static_cast<int>(cy - 3 * r));
+         y < std::min(height, static_cast<int>(cy + 3 * r)); ++y) {
+      for (int x = std::max(0, static_cast<int>(cx - 3 * r));
+           x < std::min(width, static_cast<int>(cx + 3 * r)); ++x) {
+        const float d2 = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+        img.at<float>(y, x) += a * std::exp(-d2 / (2 * r * r));
+      }
+    }
+  }
+  cv::Mat out;
+  img.convertTo(out, CV_8U, 255.0);
+  return out;
+}
+
+float l2_distance(const float* a, const float* b) {
+  float s = 0.0f;
+  for (int k = 0; k < kDescriptorDim; ++k)
+    s += (a[k] - b[k]) * (a[k] - b[k]);
+  return std::sqrt(s);
+}
+
+int test_descriptor_schema() {
+  std::cout << "[Test 1] Keypoint count and unit-norm descriptors\n";
+  const cv::Mat img = make_blob_image(640, 480, 7);
+  CpuSiftParams params;
+  params.n_max_features = 150;
+  CpuSiftExtractor extractor(params);
+  std::vector<SiftGPU::SiftKeypoint> keypoints;
+  std::vector<float> descriptors;
+  const int n = extractor.extract(img, keypoints, descriptors);
+  std::cout << "  features=" << n << " simd=" << CpuSiftExtractor::simd_enabled() << "\n";
+  if (n < 50 || n > params.n_max_features ||
+      descriptors.size() != static_cast<size_t>(n) * kDescriptorDim) {
+    std::cerr << "  FAIL: unexpected feature count\n";
+    return 1;
+  }
+  for (int i = 0; i < n; ++i) {
+    const auto& kp = keypoints[static_cast<size_t>(i)];
+    if (kp.x < 0 || kp.x > img.cols || kp.y < 0 || kp.y > img.rows || kp.s <= 0) {
+      std::cerr << "  FAIL: keypoint out of image\n";
+      return 1;
+    }
+    float norm = 0.0f;
+    for (int k = 0; k < kDescriptorDim; ++k) {
+      const float v = descriptors[static_cast<size_t>(i) * kDescriptorDim + k];
+      if (v < 0.0f) {
+        std::cerr << "  FAIL: negative descriptor element\n";
+        return 1;
+      }
+      norm += v * v;
+    }
+    if (std::fabs(std::sqrt(norm) - 1.0f) > 1e-3f) {
+      std::cerr << "  FAIL: descriptor not L2-normalized\n";
+      return 1;
+    }
+  }
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+/** Rotating the image by 90° must give matching descriptors at the rotated positions. */
+int test_rotation_invariance() {
+  std::cout << "[Test 2] 90-degree rotation: descriptor matches land on rotated keypoints\n";
+  const cv::Mat img = make_blob_image(640, 480, 11);
+  cv::Mat rotated;
+  cv::rotate(img, rotated, cv::ROTATE_90_COUNTERCLOCKWISE);
+
+  CpuSiftExtractor extractor(CpuSiftParams{});
+  std::vector<SiftGPU::SiftKeypoint> k1, k2;
+  std::vector<float> d1, d2;
+  extractor.extract(img, k1, d1);
+  extractor.extract(rotated, k2, d2);
+
+  int matched = 0;
+  int correct = 0;
+  for (size_t i = 0; i < k1.size(); ++i) {
+    size_t best = 0;
+    float best_d = 1e9f;
+    float second_d = 1e9f;
+    for (size_t j = 0; j < k2.size(); ++j) {
+      const float d = l2_distance(&d1[i * kDescriptorDim], &d2[j * kDescriptorDim]);
+      if (d < best_d) {
+        second_d = best_d;
+        best_d = d;
+        best = j;
+      } else if (d < second_d) {
+        second_d = d;
+      }
+    }
+    if (best_d >= 0.8f * second_d)
+      continue;
+    ++matched;
+    // CCW rotation (SiftGPU +0.5 pixel-center convention): x' = y, y' = W - x
+    const float ex = k1[i].y;
+    const float ey = static_cast<float>(img.cols) - k1[i].x;
+    if (std::hypot(k2[best].x - ex, k2[best].y - ey) < 2.0f)
+      ++correct;
+  }
+  std::cout << "  features=" << k1.size() << "/" << k2.size() << " matched=" << matched
+            << " correct=" << correct << "\n";
+  if (matched < 50 || correct < matched * 9 / 10) {
+    std::cerr << "  FAIL: rotation invariance too low\n";
+    return 1;
+  }
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+} // namespace
+} // namespace modules
+} // namespace insight
+
+int main() {
+  google::InitGoogleLogging("test_cpu_sift_extractor");
+  FLAGS_logtostderr = 1;
+  FLAGS_minloglevel = 2;
+
+  int failures = 0;
+  failures += insight::modules::test_descriptor_schema();
+  failures += insight::modules::test_rotation_invariance();
+
+  if (failures == 0) {
+    std::cout << "\nAll tests PASSED.\n";
+    return 0;
+  }
+  std::cerr << "\n" << failures << " test(s) FAILED.\n";
+  return 1;
+}
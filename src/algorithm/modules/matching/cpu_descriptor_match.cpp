@@ -0,0 +1,288 @@
+/**
+ * @file  cpu_descriptor_match.cpp
+ * @brief CPU 暴力匹配实现：分块整数点积 + 同遍行/列 ratio test（SiftMatchGPU 语义）。
+ */
+
+#include "cpu_descriptor_match.h"
+#include "match_postprocess.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <glog/logging.h>
+
+#if defined(__AVX512VNNI__) && defined(__AVX512BW__)
+#define INSIGHTAT_CPU_MATCH_VNNI 1
+#include <immintrin.h>
+#elif defined(__AVX2__)
+#define INSIGHTAT_CPU_MATCH_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace insight {
+namespace algorithm {
+namespace matching {
+
+namespace {
+
+constexpr int kDim = 128;
+constexpr int kRowTile = 2;     ///< micro-kernel 行数
+constexpr int kColTile = 4;     ///< micro-kernel 列数
+constexpr int kRowBlock = 64;   ///< 外层行块（query）
+constexpr int kColBlock = 128;  ///< 外层列块（train，int16 时 32KB，驻留 L1/L2）
+constexpr float kDotScale = 1.0f / (512.0f * 512.0f);
+
+static_assert(kRowBlock % kRowTile == 0 && kColBlock % kColTile == 0, "tile must divide block");
+
+/** 最优 / 次优点积（越大越近）。 */
+struct BestTwo {
+  int best = INT_MIN;
+  int second = INT_MIN;
+  int best_idx = -1;
+
+  void update(int dot, int idx) {
+    if (dot > best) {
+      second = best;
+      best = dot;
+      best_idx = idx;
+    } else if (dot > second) {
+      second = dot;
+    }
+  }
+
+  /** SiftMatchGPU 判据：d1 < distmax && d1 < ratio * d2，d = acos(min(dot/512², 1))。 */
+  bool accepted(float distance_max, float ratio) const {
+    if (best_idx < 0) return false;
+    const float d1 = std::acos(std::min(static_cast<float>(best) * kDotScale, 1.0f));
+    const float d2 = second == INT_MIN
+                         ? 1.5707963f
+                         : std::acos(std::min(static_cast<float>(second) * kDotScale, 1.0f));
+    return d1 < distance_max && d1 < ratio * d2;
+  }
+};
+
+/** 子采样后的描述子打包为连续 uint8(×512)，行数补齐到 pad 的倍数（补零，不参与统计）。 */
+std::vector<uint8_t> pack_uint8(const FeatureData& f, const std::vector<int>& idx, int pad) {
+  const size_t n = idx.size();
+  const size_t n_padded = (n + static_cast<size_t>(pad) - 1) / static_cast<size_t>(pad) *
+                          static_cast<size_t>(pad);
+  std::vector<uint8_t> out(n_padded * kDim, 0);
+  for (size_t i = 0; i < n; ++i) {
+    uint8_t* dst = out.data() + i * kDim;
+    const size_t src_row = static_cast<size_t>(idx[i]) * kDim;
+    if (f.descriptor_type == DescriptorType::kUInt8) {
+      std::copy_n(f.descriptors_uint8.data() + src_row, kDim, dst);
+    } else {
+      const float* src = f.descriptors_float.data() + src_row;
+      for (int k = 0; k < kDim; ++k) {
+        const float v = std::floor(0.5f + 512.0f * src[k]);
+        dst[k] = static_cast<uint8_t>(std::min(255.0f, std::max(0.0f, v)));
+      }
+    }
+  }
+  return out;
+}
+
+#if defined(INSIGHTAT_CPU_MATCH_VNNI)
+
+/**
+ * VNNI: dpbusd 为 u8 × s8。train 侧存 b ^ 0x80（= b - 128，s8），
+ * Σ a·(b-128) + 128·Σa = Σ a·b；query 侧每行 Σa 预先算好。
+ */
+struct PackedQuery {
+  std::vector<uint8_t> desc;
+  std::vector<int> sum;
+};
+using PackedTrain = std::vector<uint8_t>;
+
+PackedQuery prepare_query(std::vector<uint8_t> u8) {
+  PackedQuery q;
+  const size_t n = u8.size() / kDim;
+  q.sum.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    int s = 0;
+    for (int k = 0; k < kDim; ++k) s += u8[i * kDim + k];
+    q.sum[i] = s * 128;
+  }
+  q.desc = std::move(u8);
+  return q;
+}
+
+PackedTrain prepare_train(std::vector<uint8_t> u8) {
+  for (auto& v : u8) v ^= 0x80;
+  return u8;
+}
+
+/** 2×4 点积块：out[r * ld + c]。 */
+inline void dot_tile(const PackedQuery& q, int i, const PackedTrain& t, int j, int* out, int ld) {
+  const uint8_t* a0 = q.desc.data() + static_cast<size_t>(i) * kDim;
+  const uint8_t* a1 = a0 + kDim;
+  __m512i acc[kRowTile][kColTile];
+  for (auto& row : acc)
+    for (auto& v : row) v = _mm512_setzero_si512();
+  for (int k = 0; k < kDim; k += 64) {
+    const __m512i va0 = _mm512_loadu_si512(a0 + k);
+    const __m512i va1 = _mm512_loadu_si512(a1 + k);
+    for (int c = 0; c < kColTile; ++c) {
+      const __m512i vb =
+          _mm512_loadu_si512(t.data() + static_cast<size_t>(j + c) * kDim + k);
+      acc[0][c] = _mm512_dpbusd_epi32(acc[0][c], va0, vb);
+      acc[1][c] = _mm512_dpbusd_epi32(acc[1][c], va1, vb);
+    }
+  }
+  for (int r = 0; r < kRowTile; ++r) {
+    const int corr = q.sum[static_cast<size_t>(i + r)];
+    for (int c = 0; c < kColTile; ++c)
+      out[r * ld + c] = _mm512_reduce_add_epi32(acc[r][c]) + corr;
+  }
+}
+
+#elif defined(INSIGHTAT_CPU_MATCH_AVX2)
+
+/** AVX2：预先扩展为 int16，用 madd_epi16（Σ 两项 ≤ 2·255²，不溢出）。 */
+using PackedQuery = std::vector<int16_t>;
+using PackedTrain = std::vector<int16_t>;
+
+std::vector<int16_t> widen(const std::vector<uint8_t>& u8) {
+  return std::vector<int16_t>(u8.begin(), u8.end());
+}
+PackedQuery prepare_query(std::vector<uint8_t> u8) { return widen(u8); }
+PackedTrain prepare_train(std::vector<uint8_t> u8) { return widen(u8); }
+
+/** 4 个 8×int32 向量的水平和 → [s0, s1, s2, s3]。 */
+inline __m128i hsum4(__m256i v0, __m256i v1, __m256i v2, __m256i v3) {
+  const __m256i h = _mm256_hadd_epi32(_mm256_hadd_epi32(v0, v1), _mm256_hadd_epi32(v2, v3));
+  return _mm_add_epi32(_mm256_castsi256_si128(h), _mm256_extracti128_si256(h, 1));
+}
+
+inline void dot_tile(const PackedQuery& q, int i, const PackedTrain& t, int j, int* out, int ld) {
+  const int16_t* a0 = q.data() + static_cast<size_t>(i) * kDim;
+  const int16_t* a1 = a0 + kDim;
+  const int16_t* b = t.data() + static_cast<size_t>(j) * kDim;
+  __m256i acc[kRowTile][kColTile];
+  for (auto& row : acc)
+    for (auto& v : row) v = _mm256_setzero_si256();
+  for (int k = 0; k < kDim; k += 16) {
+    const __m256i va0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a0 + k));
+    const __m256i va1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a1 + k));
+    for (int c = 0; c < kColTile; ++c) {
+      const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + c * kDim + k));
+      acc[0][c] = _mm256_add_epi32(acc[0][c], _mm256_madd_epi16(va0, vb));
+      acc[1][c] = _mm256_add_epi32(acc[1][c], _mm256_madd_epi16(va1, vb));
+    }
+  }
+  for (int r = 0; r < kRowTile; ++r)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + r * ld),
+                     hsum4(acc[r][0], acc[r][1], acc[r][2], acc[r][3]));
+}
+
+#else
+
+using PackedQuery = std::vector<uint8_t>;
+using PackedTrain = std::vector<uint8_t>;
+
+PackedQuery prepare_query(std::vector<uint8_t> u8) { return u8; }
+PackedTrain prepare_train(std::vector<uint8_t> u8) { return u8; }
+
+inline void dot_tile(const PackedQuery& q, int i, const PackedTrain& t, int j, int* out, int ld) {
+  for (int r = 0; r < kRowTile; ++r) {
+    const uint8_t* a = q.data() + static_cast<size_t>(i + r) * kDim;
+    for (int c = 0; c < kColTile; ++c) {
+      const uint8_t* b = t.data() + static_cast<size_t>(j + c) * kDim;
+      int s = 0;
+      for (int k = 0; k < kDim; ++k) s += static_cast<int>(a[k]) * static_cast<int>(b[k]);
+      out[r * ld + c] = s;
+    }
+  }
+}
+
+#endif
+
+}  // namespace
+
+const char* cpu_descriptor_match_kernel() {
+#if defined(INSIGHTAT_CPU_MATCH_VNNI)
+  return "avx512vnni";
+#elif defined(INSIGHTAT_CPU_MATCH_AVX2)
+  return "avx2";
+#else
+  return "scalar";
+#endif
+}
+
+MatchResult match_descriptors_cpu(const FeatureData& features1, const FeatureData& features2,
+                                  const MatchOptions& options) {
+  if (features1.num_features == 0 || features2.num_features == 0) {
+    return MatchResult();
+  }
+
+  const int cap = options.max_features_per_image;
+  const int grow = options.spatial_grid_rows > 0 ? options.spatial_grid_rows : 4;
+  const int gcol = options.spatial_grid_cols > 0 ? options.spatial_grid_cols : 4;
+  const auto idx1 = select_top_n_spatial_indices(features1, cap, grow, gcol);
+  const auto idx2 = select_top_n_spatial_indices(features2, cap, grow, gcol);
+  const int n1 = static_cast<int>(idx1.size());
+  const int n2 = static_cast<int>(idx2.size());
+
+  const PackedQuery query = prepare_query(pack_uint8(features1, idx1, kRowTile));
+  const PackedTrain train = prepare_train(pack_uint8(features2, idx2, kColTile));
+
+  std::vector<BestTwo> row_best(static_cast<size_t>(n1));
+  std::vector<BestTwo> col_best(options.mutual_best_match ? static_cast<size_t>(n2) : 0);
+  std::vector<int> tile(static_cast<size_t>(kRowBlock) * kColBlock);
+
+  // 外层按 (行块, 列块) 遍历，块内 2×4 micro-kernel 写入 tile，再一次扫描更新行/列统计。
+  for (int i0 = 0; i0 < n1; i0 += kRowBlock) {
+    const int i_end = std::min(n1, i0 + kRowBlock);
+    const int i_padded = i0 + (i_end - i0 + kRowTile - 1) / kRowTile * kRowTile;
+    for (int j0 = 0; j0 < n2; j0 += kColBlock) {
+      const int j_end = std::min(n2, j0 + kColBlock);
+      const int j_padded = j0 + (j_end - j0 + kColTile - 1) / kColTile * kColTile;
+      for (int i = i0; i < i_padded; i += kRowTile) {
+        for (int j = j0; j < j_padded; j += kColTile) {
+          dot_tile(query, i, train, j, tile.data() + (i - i0) * kColBlock + (j - j0), kColBlock);
+        }
+      }
+      for (int i = i0; i < i_end; ++i) {
+        const int* row = tile.data() + (i - i0) * kColBlock;
+        BestTwo& rb = row_best[static_cast<size_t>(i)];
+        for (int j = j0; j < j_end; ++j) {
+          rb.update(row[j - j0], j);
+        }
+        if (options.mutual_best_match) {
+          for (int j = j0; j < j_end; ++j) {
+            col_best[static_cast<size_t>(j)].update(row[j - j0], i);
+          }
+        }
+      }
+    }
+  }
+
+  MatchResult result;
+  const int max_match = options.max_matches > 0 ? options.max_matches : std::min(n1, n2);
+  result.reserve(static_cast<size_t>(std::min(n1, max_match)));
+  for (int i = 0; i < n1 && static_cast<int>(result.indices.size()) < max_match; ++i) {
+    const BestTwo& rb = row_best[static_cast<size_t>(i)];
+    if (!rb.accepted(options.distance_max, options.ratio_test)) continue;
+    const int j = rb.best_idx;
+    if (options.mutual_best_match) {
+      const BestTwo& cb = col_best[static_cast<size_t>(j)];
+      if (cb.best_idx != i || !cb.accepted(options.distance_max, options.ratio_test)) continue;
+    }
+    append_match(&result, features1, features2, static_cast<uint16_t>(idx1[static_cast<size_t>(i)]),
+                 static_cast<uint16_t>(idx2[static_cast<size_t>(j)]), options.compute_distances);
+  }
+  deduplicate_match_indices(&result);
+  result.num_matches = result.indices.size();
+
+  VLOG(1) << "CPU brute-force (" << cpu_descriptor_match_kernel() << "): " << n1 << " vs " << n2
+          << " -> " << result.num_matches << " matches";
+  return result;
+}
+
+}  // namespace matching
+}  // namespace algorithm
+}  // namespace insight
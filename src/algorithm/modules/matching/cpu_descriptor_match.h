@@ -0,0 +1,34 @@
+/**
+ * @file  cpu_descriptor_match.h
+ * @brief CPU 暴力匹配 SIFT 描述子（语义与 SiftMatchGPU::GetSiftMatch 一致），无 GPU 节点可用。
+ *
+ * 描述子按 uint8(×512) 参与计算（float 描述子按 SiftMatchGPU::SetDescriptors 的方式量化）；
+ * 相似度为整数点积，距离 = acos(dot / 512²)。行最优满足 d1 < distance_max 且
+ * d1 < ratio_test * d2 时接受；mutual_best_match 时对列做同样的检验并要求双向一致。
+ * 行/列的最优与次优在同一次分块点积遍历中更新，点积核在编译期选择
+ * AVX-512 VNNI (__AVX512VNNI__) / AVX2 (__AVX2__，见 INSIGHTAT_ENABLE_AVX2) / 标量。
+ *
+ * 无共享状态，线程安全：isat_match 的 CPU 后端在并行 Stage 中同时匹配多对图像。
+ */
+
+#pragma once
+
+#include "match_types.h"
+
+namespace insight {
+namespace algorithm {
+namespace matching {
+
+/**
+ * 暴力匹配两组特征，遵循 MatchOptions：max_features_per_image + spatial grid 子采样、
+ * ratio_test、distance_max、mutual_best_match、max_matches、compute_distances。
+ */
+MatchResult match_descriptors_cpu(const FeatureData& features1, const FeatureData& features2,
+                                  const MatchOptions& options = MatchOptions());
+
+/** 编译进本构建的点积核："avx512vnni"、"avx2" 或 "scalar"。 */
+const char* cpu_descriptor_match_kernel();
+
+}  // namespace matching
+}  // namespace algorithm
+}  // namespace insight
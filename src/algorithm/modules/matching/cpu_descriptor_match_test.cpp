@@ -0,0 +1,220 @@
+/**
+ * @file  cpu_descriptor_match_test.cpp
+ * @brief Unit tests for the CPU brute-force descriptor matcher (SiftMatchGPU semantics).
+ *
+ * Usage
+ * ─────
+ *   ./test_cpu_descriptor_match
+ */
+
+#include "cpu_descriptor_match.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace insight {
+namespace algorithm {
+namespace matching {
+namespace {
+
+constexpr int kDescriptorDim = 128;
+
+/** SIFT-like descriptor: non-negative, L2 = 1, stored as uint8(×512). */
+void quantize_unit(std::vector<float>& v, uint8_t* out) {
+  float norm = 0.0f;
+  for (float x : v) norm += x * x;
+  norm = std::sqrt(std::max(norm, 1e-12f));
+  for (int d = 0; d < kDescriptorDim; ++d) {
+    const float q = std::floor(0.5f + 512.0f * v[static_cast<size_t>(d)] / norm);
+    out[d] = static_cast<uint8_t>(std::min(255.0f, q));
+  }
+}
+
+FeatureData make_sift_like(int n, uint32_t seed) {
+  FeatureData data(static_cast<size_t>(n), DescriptorType::kUInt8);
+  std::mt19937 rng(seed);
+  std::exponential_distribution<float> dist_e(4.0f);
+  std::uniform_real_distribution<float> dist_xy(0.0f, 4000.0f);
+  std::vector<float> v(kDescriptorDim);
+  for (int i = 0; i < n; ++i) {
+    data.keypoints[static_cast<size_t>(i)] =
+        Eigen::Vector4f(dist_xy(rng), dist_xy(rng), 1.0f + static_cast<float>(i % 7), 0.0f);
+    for (auto& x : v) x = dist_e(rng);
+    quantize_unit(v, &data.descriptors_uint8[static_cast<size_t>(i) * kDescriptorDim]);
+  }
+  return data;
+}
+
+/** First n_src features are noisy copies of src (same order), then n_extra random ones. */
+FeatureData make_perturbed(const FeatureData& src, int n_extra, float noise, uint32_t seed) {
+  const int n_src = static_cast<int>(src.num_features);
+  FeatureData dst(static_cast<size_t>(n_src + n_extra), DescriptorType::kUInt8);
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> dist_n(0.0f, noise);
+  std::vector<float> v(kDescriptorDim);
+  for (int i = 0; i < n_src; ++i) {
+    dst.keypoints[static_cast<size_t>(i)] = src.keypoints[static_cast<size_t>(i)];
+    for (int d = 0; d < kDescriptorDim; ++d) {
+      const float base = src.descriptors_uint8[static_cast<size_t>(i) * kDescriptorDim + d] / 512.0f;
+      v[static_cast<size_t>(d)] = std::max(0.0f, base + dist_n(rng));
+    }
+    quantize_unit(v, &dst.descriptors_uint8[static_cast<size_t>(i) * kDescriptorDim]);
+  }
+  const FeatureData extra = make_sift_like(n_extra, seed + 1);
+  std::copy(extra.keypoints.begin(), extra.keypoints.end(), dst.keypoints.begin() + n_src);
+  std::copy(extra.descriptors_uint8.begin(), extra.descriptors_uint8.end(),
+            dst.descriptors_uint8.begin() + static_cast<size_t>(n_src) * kDescriptorDim);
+  return dst;
+}
+
+/** Straightforward reference of the GetSiftMatch rule (no subsampling). */
+std::set<std::pair<int, int>> reference_match(const FeatureData& f1, const FeatureData& f2,
+                                              const MatchOptions& opt) {
+  const int n1 = static_cast<int>(f1.num_features);
+  const int n2 = static_cast<int>(f2.num_features);
+  std::vector<int> dot(static_cast<size_t>(n1) * n2);
+  for (int i = 0; i < n1; ++i)
+    for (int j = 0; j < n2; ++j) {
+      int s = 0;
+      for (int d = 0; d < kDescriptorDim; ++d)
+        s += f1.descriptors_uint8[static_cast<size_t>(i) * kDescriptorDim + d] *
+             f2.descriptors_uint8[static_cast<size_t>(j) * kDescriptorDim + d];
+      dot[static_cast<size_t>(i) * n2 + j] = s;
+    }
+  auto dist = [](int s) { return std::acos(std::min(s / 262144.0f, 1.0f)); };
+  auto best_of = [&](int count, auto at, int* best_idx) {
+    float d1 = 10.0f, d2 = 1.5707963f;
+    for (int k = 0; k < count; ++k) {
+      const float d = dist(at(k));
+      if (d < d1) {
+        d2 = d1;
+        d1 = d;
+        *best_idx = k;
+      } else if (d < d2) {
+        d2 = d;
+      }
+    }
+    return d1 < opt.distance_max && d1 < opt.ratio_test * d2;
+  };
+  std::set<std::pair<int, int>> out;
+  for (int i = 0; i < n1; ++i) {
+    int j = -1;
+    if (!best_of(n2, [&](int k) { return dot[static_cast<size_t>(i) * n2 + k]; }, &j)) continue;
+    if (opt.mutual_best_match) {
+      int back = -1;
+      if (!best_of(n1, [&](int k) { return dot[static_cast<size_t>(k) * n2 + j]; }, &back) ||
+          back != i)
+        continue;
+    }
+    out.emplace(i, j);
+  }
+  return out;
+}
+
+int test_matches_reference() {
+  std::cout << "[Test 1] Blocked kernel agrees with reference rule (" << cpu_descriptor_match_kernel()
+            << ")\n";
+  // Odd sizes exercise the 2x4 tile padding and block edges; the noise level leaves part of
+  // the true pairs above distance_max so both acceptance branches are covered.
+  const FeatureData f1 = make_sift_like(301, 3);
+  const FeatureData f2 = make_perturbed(f1, 157, 0.09f, 5);
+  for (bool mutual : {false, true}) {
+    MatchOptions opt;
+    opt.mutual_best_match = mutual;
+    const MatchResult r = match_descriptors_cpu(f1, f2, opt);
+    std::set<std::pair<int, int>> got;
+    for (const auto& p : r.indices) got.emplace(p.first, p.second);
+    const auto expected = reference_match(f1, f2, opt);
+    int correct = 0;
+    for (const auto& p : got) correct += p.first == p.second ? 1 : 0;
+    std::cout << "  mutual=" << mutual << " matches=" << got.size() << " expected=" << expected.size()
+              << " correct=" << correct << "\n";
+    if (got != expected) {
+      std::cerr << "  FAIL: match set differs from reference\n";
+      return 1;
+    }
+    if (correct < 200) {
+      std::cerr << "  FAIL: too few true correspondences\n";
+      return 1;
+    }
+  }
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+int test_options() {
+  std::cout << "[Test 2] Float input, max_features_per_image, max_matches, distances\n";
+  const FeatureData u8 = make_sift_like(500, 11);
+  FeatureData f1(u8.num_features, DescriptorType::kFloat32);
+  f1.keypoints = u8.keypoints;
+  for (size_t k = 0; k < u8.descriptors_uint8.size(); ++k)
+    f1.descriptors_float[k] = u8.descriptors_uint8[k] / 512.0f;
+  const FeatureData f2 = make_perturbed(u8, 50, 0.01f, 13);
+
+  MatchOptions opt;
+  opt.max_features_per_image = 0;
+  opt.compute_distances = true;
+  const MatchResult full = match_descriptors_cpu(u8, f2, opt);
+  if (full.num_matches < 450 || full.distances.size() != full.num_matches) {
+    std::cerr << "  FAIL: full match count " << full.num_matches << "\n";
+    return 1;
+  }
+  const MatchResult from_float = match_descriptors_cpu(f1, f2, MatchOptions());
+  if (from_float.num_matches != match_descriptors_cpu(u8, f2, MatchOptions()).num_matches) {
+    std::cerr << "  FAIL: float descriptors not quantized like uint8(x512)\n";
+    return 1;
+  }
+
+  opt.max_features_per_image = 200;
+  const MatchResult capped = match_descriptors_cpu(u8, f2, opt);
+  std::set<int> used1, used2;
+  for (const auto& p : capped.indices) {
+    used1.insert(p.first);
+    used2.insert(p.second);
+  }
+  if (capped.num_matches == 0 || capped.num_matches > 200 || used1.size() > 200 ||
+      used2.size() > 200) {
+    std::cerr << "  FAIL: max_features_per_image not honoured (" << capped.num_matches << ")\n";
+    return 1;
+  }
+
+  opt.max_features_per_image = 0;
+  opt.max_matches = 37;
+  if (match_descriptors_cpu(u8, f2, opt).num_matches != 37) {
+    std::cerr << "  FAIL: max_matches not honoured\n";
+    return 1;
+  }
+  std::cout << "  full=" << full.num_matches << " capped=" << capped.num_matches << "\n";
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+}  // namespace
+}  // namespace matching
+}  // namespace algorithm
+}  // namespace insight
+
+int main() {
+  google::InitGoogleLogging("test_cpu_descriptor_match");
+  FLAGS_logtostderr = 1;
+  FLAGS_minloglevel = 2;
+
+  int failures = 0;
+  failures += insight::algorithm::matching::test_matches_reference();
+  failures += insight::algorithm::matching::test_options();
+
+  if (failures == 0) {
+    std::cout << "\nAll tests PASSED.\n";
+    return 0;
+  }
+  std::cerr << "\n" << failures << " test(s) FAILED.\n";
+  return 1;
+}
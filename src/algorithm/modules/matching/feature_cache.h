@@ -0,0 +1,140 @@
+/**
+ * @file  feature_cache.h
+ * @brief 按图像 ID 共享的引用计数 LRU 缓存（解码后的 FeatureData / 哈希后的 ImageFeatures）。
+ *
+ * 匹配工具按 PairScheduler 的顺序处理图像对时，同一图像会在短时间内被多对复用；
+ * 缓存让每张图只读取/解码一次（预算足够时）。
+ *
+ * - acquire() 返回 shared_ptr：调用方持有期间该项被“钉住”，不会被淘汰；
+ *   释放后才按 LRU 顺序参与淘汰，使已加载字节数回到 budget_bytes 以内。
+ *   所有项都被钉住时允许暂时超出预算（上限为在途图像对数）。
+ * - 同一 key 并发 acquire 只加载一次，其余线程等待同一个 shared_future。
+ * - 加载器返回 nullptr 表示失败；失败结果不缓存。
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace insight {
+namespace algorithm {
+namespace matching {
+
+struct FeatureCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  size_t resident_bytes = 0;
+  size_t peak_bytes = 0;
+};
+
+template <typename Value>
+class FeatureCache {
+public:
+  using Handle = std::shared_ptr<const Value>;
+  using Loader = std::function<Handle()>;
+  using SizeOf = std::function<size_t(const Value&)>;
+
+  FeatureCache(size_t budget_bytes, SizeOf size_of)
+      : budget_bytes_(budget_bytes), size_of_(std::move(size_of)) {}
+
+  FeatureCache(const FeatureCache&) = delete;
+  FeatureCache& operator=(const FeatureCache&) = delete;
+
+  /** 命中直接返回；未命中时在调用线程执行 load（不持锁），并发请求同一 key 时共享结果。 */
+  Handle acquire(uint32_t key, const Loader& load) {
+    std::shared_future<Handle> pending;
+    std::promise<Handle> promise;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = slots_.find(key);
+      if (it != slots_.end()) {
+        ++stats_.hits;
+        lru_.splice(lru_.begin(), lru_, it->second.lru_pos);
+        pending = it->second.value;
+      } else {
+        ++stats_.misses;
+        lru_.push_front(key);
+        Slot slot;
+        slot.value = promise.get_future().share();
+        slot.lru_pos = lru_.begin();
+        slots_.emplace(key, slot);
+      }
+    }
+    if (pending.valid()) {
+      return pending.get();
+    }
+
+    Handle value;
+    try {
+      value = load();
+    } catch (...) {
+      value = nullptr;
+    }
+    promise.set_value(value);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = slots_.find(key);
+    if (!value) {
+      lru_.erase(it->second.lru_pos);
+      slots_.erase(it);
+      return value;
+    }
+    it->second.bytes = size_of_(*value);
+    it->second.ready = value;
+    stats_.resident_bytes += it->second.bytes;
+    if (stats_.resident_bytes > stats_.peak_bytes) stats_.peak_bytes = stats_.resident_bytes;
+    evict_locked();
+    return value;
+  }
+
+  FeatureCacheStats stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+  }
+
+  size_t budget_bytes() const { return budget_bytes_; }
+
+private:
+  struct Slot {
+    std::shared_future<Handle> value;
+    Handle ready;  ///< 加载完成后缓存自身持有的引用（use_count()==1 表示未被钉住）
+    std::list<uint32_t>::iterator lru_pos;
+    size_t bytes = 0;
+  };
+
+  /** 从 LRU 尾部淘汰未被钉住、已加载完成的项，直到回到预算内。 */
+  void evict_locked() {
+    auto pos = lru_.end();
+    while (stats_.resident_bytes > budget_bytes_ && pos != lru_.begin()) {
+      --pos;
+      auto it = slots_.find(*pos);
+      const Slot& slot = it->second;
+      // shared_future 与 ready 各持一份引用；更多引用说明仍有调用方在使用
+      if (!slot.ready || slot.ready.use_count() > 2) continue;
+      stats_.resident_bytes -= slot.bytes;
+      ++stats_.evictions;
+      slots_.erase(it);
+      pos = lru_.erase(pos);
+    }
+  }
+
+  size_t budget_bytes_;
+  SizeOf size_of_;
+  mutable std::mutex mutex_;
+  std::list<uint32_t> lru_;  ///< 头部最近使用
+  std::unordered_map<uint32_t, Slot> slots_;
+  FeatureCacheStats stats_;
+};
+
+}  // namespace matching
+}  // namespace algorithm
+}  // namespace insight
@@ -0,0 +1,80 @@
+/**
+ * @file  feature_loader.cpp
+ * @brief load_feature_data_idc implementation (mmap-backed IDCReader).
+ */
+
+#include "feature_loader.h"
+
+#include <cstring>
+
+#include <glog/logging.h>
+
+#include "../../io/idc_reader.h"
+
+namespace insight {
+namespace algorithm {
+namespace matching {
+
+static_assert(sizeof(Eigen::Vector4f) == 4 * sizeof(float),
+              "Eigen::Vector4f must be tightly packed for direct keypoint copy");
+
+FeatureData load_feature_data_idc(const std::string& idc_path) {
+  io::IDCReader reader(idc_path, io::IDCReadMode::kMapped);
+  if (!reader.is_valid()) {
+    LOG(ERROR) << "Invalid IDC file: " << idc_path;
+    return FeatureData();
+  }
+
+  const auto keypoints_raw = reader.view_blob<float>("keypoints");
+  if (keypoints_raw.empty()) {
+    LOG(ERROR) << "Failed to read keypoints from " << idc_path;
+    return FeatureData();
+  }
+
+  const auto desc_blob = reader.get_blob_descriptor("descriptors");
+  if (desc_blob.is_null() || !desc_blob.contains("dtype")) {
+    LOG(ERROR) << "Missing descriptors blob or dtype in " << idc_path;
+    return FeatureData();
+  }
+  const std::string dtype = desc_blob["dtype"];
+  DescriptorType descriptor_type;
+  if (dtype == "uint8") {
+    descriptor_type = DescriptorType::kUInt8;
+  } else if (dtype == "float32") {
+    descriptor_type = DescriptorType::kFloat32;
+  } else {
+    LOG(ERROR) << "Unsupported descriptor dtype: " << dtype << " in " << idc_path;
+    return FeatureData();
+  }
+
+  const size_t num_features = keypoints_raw.size() / 4;
+  FeatureData features;
+  features.num_features = num_features;
+  features.descriptor_type = descriptor_type;
+  features.keypoints.resize(num_features);
+  std::memcpy(static_cast<void*>(features.keypoints.data()), keypoints_raw.data(),
+              num_features * 4 * sizeof(float));
+
+  if (descriptor_type == DescriptorType::kUInt8) {
+    const auto desc = reader.view_blob<uint8_t>("descriptors");
+    if (desc.empty()) {
+      LOG(ERROR) << "Failed to read uint8 descriptors from " << idc_path;
+      return FeatureData();
+    }
+    features.descriptors_uint8.assign(desc.begin(), desc.end());
+  } else {
+    const auto desc = reader.view_blob<float>("descriptors");
+    if (desc.empty()) {
+      LOG(ERROR) << "Failed to read float32 descriptors from " << idc_path;
+      return FeatureData();
+    }
+    features.descriptors_float.assign(desc.begin(), desc.end());
+  }
+
+  VLOG(1) << "Loaded " << num_features << " features (" << dtype << ") from " << idc_path;
+  return features;
+}
+
+} // namespace matching
+} // namespace algorithm
+} // namespace insight
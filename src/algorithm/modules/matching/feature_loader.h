@@ -0,0 +1,31 @@
+/**
+ * @file  feature_loader.h
+ * @brief Load .isat_feat (IDC) into FeatureData through a memory-mapped IDCReader.
+ *
+ * Shared by isat_match and the cascade-hash matchers. The file is mapped once; keypoints and
+ * descriptors are copied straight from the mapped payload into FeatureData (single memcpy per
+ * blob, no ifstream reopen per blob, no intermediate std::vector<float>).
+ */
+
+#pragma once
+
+#include "match_types.h"
+
+#include <string>
+
+namespace insight {
+namespace algorithm {
+namespace matching {
+
+/// Returns an empty FeatureData (num_features == 0) and logs on any error.
+FeatureData load_feature_data_idc(const std::string& idc_path);
+
+/// Heap bytes held by keypoints + descriptors (FeatureCache budget accounting).
+inline size_t feature_data_bytes(const FeatureData& f) {
+  return f.keypoints.size() * sizeof(f.keypoints[0]) + f.descriptors_uint8.size() +
+         f.descriptors_float.size() * sizeof(float);
+}
+
+} // namespace matching
+} // namespace algorithm
+} // namespace insight
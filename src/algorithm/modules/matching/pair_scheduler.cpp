@@ -0,0 +1,154 @@
+/**
+ * @file  pair_scheduler.cpp
+ * @brief schedule_pairs_for_locality（RCM 图像编号 + 按端点输出边）实现。
+ */
+
+#include "pair_scheduler.h"
+
+#include <algorithm>
+#include <list>
+#include <numeric>
+#include <queue>
+#include <unordered_map>
+
+namespace insight {
+namespace algorithm {
+namespace matching {
+
+namespace {
+
+/** 将图像 ID 压缩为 0..n-1（按首次出现顺序），返回每条边的压缩端点。 */
+std::vector<std::pair<int, int>> compact_edges(
+    const std::vector<std::pair<uint32_t, uint32_t>>& pairs, size_t* num_images) {
+  std::unordered_map<uint32_t, int> id_to_vertex;
+  id_to_vertex.reserve(pairs.size());
+  std::vector<std::pair<int, int>> edges;
+  edges.reserve(pairs.size());
+  auto vertex = [&](uint32_t id) {
+    auto it = id_to_vertex.emplace(id, static_cast<int>(id_to_vertex.size())).first;
+    return it->second;
+  };
+  for (const auto& p : pairs) {
+    const int a = vertex(p.first);
+    const int b = vertex(p.second);
+    edges.emplace_back(a, b);
+  }
+  *num_images = id_to_vertex.size();
+  return edges;
+}
+
+size_t bandwidth_of(const std::vector<std::pair<int, int>>& edges, const std::vector<int>& rank) {
+  size_t bw = 0;
+  for (const auto& e : edges) {
+    const int d = rank[static_cast<size_t>(e.first)] - rank[static_cast<size_t>(e.second)];
+    bw = std::max(bw, static_cast<size_t>(d < 0 ? -d : d));
+  }
+  return bw;
+}
+
+}  // namespace
+
+std::vector<int> schedule_pairs_for_locality(
+    const std::vector<std::pair<uint32_t, uint32_t>>& pairs, PairScheduleStats* stats) {
+  size_t n = 0;
+  const auto edges = compact_edges(pairs, &n);
+
+  std::vector<std::vector<int>> adj(n);
+  for (const auto& e : edges) {
+    if (e.first == e.second) continue;
+    adj[static_cast<size_t>(e.first)].push_back(e.second);
+    adj[static_cast<size_t>(e.second)].push_back(e.first);
+  }
+  std::vector<int> degree(n);
+  for (size_t v = 0; v < n; ++v) {
+    auto& nb = adj[v];
+    std::sort(nb.begin(), nb.end());
+    nb.erase(std::unique(nb.begin(), nb.end()), nb.end());
+    degree[v] = static_cast<int>(nb.size());
+  }
+  for (auto& nb : adj) {
+    std::stable_sort(nb.begin(), nb.end(), [&degree](int a, int b) {
+      return degree[static_cast<size_t>(a)] < degree[static_cast<size_t>(b)];
+    });
+  }
+
+  // Cuthill–McKee：每个连通分量从度最小的未访问顶点开始 BFS
+  std::vector<int> by_degree(n);
+  std::iota(by_degree.begin(), by_degree.end(), 0);
+  std::stable_sort(by_degree.begin(), by_degree.end(), [&degree](int a, int b) {
+    return degree[static_cast<size_t>(a)] < degree[static_cast<size_t>(b)];
+  });
+  std::vector<int> cm_order;
+  cm_order.reserve(n);
+  std::vector<char> visited(n, 0);
+  for (int start : by_degree) {
+    if (visited[static_cast<size_t>(start)]) continue;
+    std::queue<int> q;
+    q.push(start);
+    visited[static_cast<size_t>(start)] = 1;
+    while (!q.empty()) {
+      const int v = q.front();
+      q.pop();
+      cm_order.push_back(v);
+      for (int w : adj[static_cast<size_t>(v)]) {
+        if (!visited[static_cast<size_t>(w)]) {
+          visited[static_cast<size_t>(w)] = 1;
+          q.push(w);
+        }
+      }
+    }
+  }
+  std::vector<int> rank(n);
+  for (size_t i = 0; i < n; ++i) {
+    rank[static_cast<size_t>(cm_order[n - 1 - i])] = static_cast<int>(i);  // reverse
+  }
+
+  // 边按 (较大端点编号 升序, 较小端点编号 降序) 输出
+  std::vector<int> order(edges.size());
+  std::iota(order.begin(), order.end(), 0);
+  auto key = [&](int e) {
+    const int ra = rank[static_cast<size_t>(edges[static_cast<size_t>(e)].first)];
+    const int rb = rank[static_cast<size_t>(edges[static_cast<size_t>(e)].second)];
+    return std::make_pair(std::max(ra, rb), -std::min(ra, rb));
+  };
+  std::stable_sort(order.begin(), order.end(), [&key](int a, int b) { return key(a) < key(b); });
+
+  if (stats != nullptr) {
+    std::vector<int> identity(n);
+    std::iota(identity.begin(), identity.end(), 0);
+    stats->num_images = n;
+    stats->bandwidth = bandwidth_of(edges, rank);
+    stats->input_bandwidth = bandwidth_of(edges, identity);
+  }
+  return order;
+}
+
+size_t simulate_lru_loads(const std::vector<std::pair<uint32_t, uint32_t>>& pairs,
+                          const std::vector<int>& order, size_t capacity_images) {
+  std::list<uint32_t> lru;
+  std::unordered_map<uint32_t, std::list<uint32_t>::iterator> pos;
+  size_t loads = 0;
+  auto touch = [&](uint32_t id) {
+    auto it = pos.find(id);
+    if (it != pos.end()) {
+      lru.splice(lru.begin(), lru, it->second);
+      return;
+    }
+    ++loads;
+    lru.push_front(id);
+    pos[id] = lru.begin();
+    if (lru.size() > std::max<size_t>(capacity_images, 2)) {
+      pos.erase(lru.back());
+      lru.pop_back();
+    }
+  };
+  for (int i : order) {
+    touch(pairs[static_cast<size_t>(i)].first);
+    touch(pairs[static_cast<size_t>(i)].second);
+  }
+  return loads;
+}
+
+}  // namespace matching
+}  // namespace algorithm
+}  // namespace insight
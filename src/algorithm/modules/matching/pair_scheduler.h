@@ -0,0 +1,46 @@
+/**
+ * @file  pair_scheduler.h
+ * @brief 面向特征复用的图像对调度：按匹配图遍历顺序重排图像对。
+ *
+ * 图像为顶点、图像对为边。先用 Reverse Cuthill–McKee（按连通分量 BFS，起点取度最小者，
+ * 邻居按度升序入队）给图像编号，使相邻编号的图像在匹配图中也相邻；再按编号较大的端点
+ * 升序输出边（同一端点内另一端编号降序，最近加载的先用）。这样任一时刻“还会被用到”的
+ * 图像集中在一个宽度约为图带宽的窗口里，配合 FeatureCache 的 LRU，预算能容纳该窗口时
+ * 每张图只加载一次。
+ *
+ * 纯函数，不读文件；isat_match 与 isat_cpu_cascade_hashing_match 共用。
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace insight {
+namespace algorithm {
+namespace matching {
+
+struct PairScheduleStats {
+  size_t num_images = 0;
+  size_t bandwidth = 0;        ///< 重排后 max |rank(a) - rank(b)|，近似所需缓存图像数
+  size_t input_bandwidth = 0;  ///< 按输入中图像首次出现顺序编号时的带宽
+};
+
+/**
+ * 返回 pairs 的处理顺序（pairs 下标的排列）。stats 可为空。
+ * 顺序只依赖输入，结果确定。
+ */
+std::vector<int> schedule_pairs_for_locality(
+    const std::vector<std::pair<uint32_t, uint32_t>>& pairs, PairScheduleStats* stats = nullptr);
+
+/**
+ * 按顺序模拟容量为 capacity_images 的 LRU，返回图像加载次数（用于日志/基准）。
+ */
+size_t simulate_lru_loads(const std::vector<std::pair<uint32_t, uint32_t>>& pairs,
+                          const std::vector<int>& order, size_t capacity_images);
+
+}  // namespace matching
+}  // namespace algorithm
+}  // namespace insight
@@ -0,0 +1,155 @@
+/**
+ * @file  pair_scheduler_test.cpp
+ * @brief Unit tests for locality pair scheduling and the shared FeatureCache.
+ *
+ * Usage
+ * ─────
+ *   ./test_pair_scheduler
+ */
+
+#include "feature_cache.h"
+#include "pair_scheduler.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace insight {
+namespace algorithm {
+namespace matching {
+namespace {
+
+/** Images on a W x H grid with shuffled IDs; pairs within a (2r+1)^2 window, sorted by ID. */
+std::vector<std::pair<uint32_t, uint32_t>> make_grid_pairs(int w, int h, int r, uint32_t seed) {
+  std::vector<uint32_t> id(static_cast<size_t>(w * h));
+  std::iota(id.begin(), id.end(), 0u);
+  std::mt19937 rng(seed);
+  std::shuffle(id.begin(), id.end(), rng);
+  std::vector<std::pair<uint32_t, uint32_t>> pairs;
+  for (int y = 0; y < h; ++y)
+    for (int x = 0; x < w; ++x)
+      for (int dy = -r; dy <= r; ++dy)
+        for (int dx = -r; dx <= r; ++dx) {
+          const int nx = x + dx, ny = y + dy;
+          if (nx < 0 || ny < 0 || nx >= w || ny >= h) continue;
+          const uint32_t a = id[static_cast<size_t>(y * w + x)];
+          const uint32_t b = id[static_cast<size_t>(ny * w + nx)];
+          if (a < b) pairs.emplace_back(a, b);
+        }
+  std::sort(pairs.begin(), pairs.end());
+  return pairs;
+}
+
+int test_schedule_reuse() {
+  std::cout << "[Test 1] Locality schedule is a permutation and cuts LRU reloads\n";
+  const auto pairs = make_grid_pairs(40, 40, 2, 3);
+  PairScheduleStats stats;
+  const std::vector<int> order = schedule_pairs_for_locality(pairs, &stats);
+  std::vector<int> sorted = order;
+  std::sort(sorted.begin(), sorted.end());
+  std::vector<int> input(pairs.size());
+  std::iota(input.begin(), input.end(), 0);
+  if (sorted != input) {
+    std::cerr << "  FAIL: schedule is not a permutation of the pairs\n";
+    return 1;
+  }
+  const size_t capacity = 2 * stats.bandwidth + 2;
+  const size_t loads_input = simulate_lru_loads(pairs, input, capacity);
+  const size_t loads_sched = simulate_lru_loads(pairs, order, capacity);
+  std::cout << "  images=" << stats.num_images << " bandwidth " << stats.input_bandwidth << " -> "
+            << stats.bandwidth << ", loads (cap " << capacity << ") " << loads_input << " -> "
+            << loads_sched << "\n";
+  if (stats.bandwidth * 4 > stats.input_bandwidth || loads_sched != stats.num_images ||
+      loads_sched * 4 > loads_input) {
+    std::cerr << "  FAIL: schedule does not keep the working set within the cache\n";
+    return 1;
+  }
+  if (schedule_pairs_for_locality(pairs) != order) {
+    std::cerr << "  FAIL: schedule is not deterministic\n";
+    return 1;
+  }
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+int test_cache_pin_and_evict() {
+  std::cout << "[Test 2] FeatureCache: single load per key, pinned entries survive eviction\n";
+  FeatureCache<std::vector<int>> cache(
+      400, [](const std::vector<int>& v) { return v.size() * sizeof(int); });
+  std::atomic<int> loads{0};
+  auto loader = [&loads](int n) {
+    return [&loads, n] {
+      ++loads;
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      return std::make_shared<const std::vector<int>>(static_cast<size_t>(n), n);
+    };
+  };
+
+  // Concurrent acquires of one key share a single load.
+  std::vector<std::thread> threads;
+  std::vector<std::shared_ptr<const std::vector<int>>> got(8);
+  for (int t = 0; t < 8; ++t)
+    threads.emplace_back([&, t] { got[static_cast<size_t>(t)] = cache.acquire(7, loader(50)); });
+  for (auto& th : threads) th.join();
+  if (loads != 1 || got[0] != got[7]) {
+    std::cerr << "  FAIL: concurrent acquire loaded " << loads << " times\n";
+    return 1;
+  }
+
+  // Key 7 (200 B) stays pinned while keys 1..3 (200 B each) push the cache over budget.
+  got.clear();
+  auto pinned = cache.acquire(7, loader(50));
+  for (uint32_t k = 1; k <= 3; ++k) cache.acquire(k, loader(50));
+  const int loads_before = loads;
+  auto again = cache.acquire(7, loader(50));
+  if (loads != loads_before || again != pinned) {
+    std::cerr << "  FAIL: pinned entry was evicted\n";
+    return 1;
+  }
+  const FeatureCacheStats stats = cache.stats();
+  if (stats.resident_bytes > 400 || stats.evictions < 2) {
+    std::cerr << "  FAIL: resident " << stats.resident_bytes << " B, evictions " << stats.evictions
+              << "\n";
+    return 1;
+  }
+  // Failed loads are not cached.
+  if (cache.acquire(99, [] { return std::shared_ptr<const std::vector<int>>(); }) != nullptr ||
+      cache.acquire(99, loader(1)) == nullptr) {
+    std::cerr << "  FAIL: failed load was cached\n";
+    return 1;
+  }
+  std::cout << "  hits=" << stats.hits << " misses=" << stats.misses
+            << " evictions=" << stats.evictions << "\n";
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+}  // namespace
+}  // namespace matching
+}  // namespace algorithm
+}  // namespace insight
+
+int main() {
+  google::InitGoogleLogging("test_pair_scheduler");
+  FLAGS_logtostderr = 1;
+  FLAGS_minloglevel = 2;
+
+  int failures = 0;
+  failures += insight::algorithm::matching::test_schedule_reuse();
+  failures += insight::algorithm::matching::test_cache_pin_and_evict();
+
+  if (failures == 0) {
+    std::cout << "\nAll tests PASSED.\n";
+    return 0;
+  }
+  std::cerr << "\n" << failures << " test(s) FAILED.\n";
+  return 1;
+}
@@ -5,6 +5,7 @@
  */
 
 #include "sift_matcher.h"
+#include "cpu_descriptor_match.h"
 #include "match_postprocess.h"
 
 #include <algorithm>
@@ -33,6 +34,12 @@ SiftMatcher::SiftMatcher(int max_features, bool use_cuda)
 
 SiftMatcher::SiftMatcher(const SiftMatcherParams& params)
     : max_features_(params.max_features), params_(params) {
+  if (params_.use_cpu) {
+    backend_ = Backend::kCpu;
+    LOG(INFO) << "SiftMatcher initialized with CPU brute-force backend (kernel="
+              << cpu_descriptor_match_kernel() << ")";
+    return;
+  }
   if (params_.use_sift_gpu == params_.use_pop_sift) {
     LOG(ERROR) << "Exactly one matching backend must be enabled: use_sift_gpu xor use_pop_sift";
     return;
@@ -93,6 +100,9 @@ SiftMatcher::~SiftMatcher() {
 }
 
 bool SiftMatcher::verify_context() const {
+  if (backend_ == Backend::kCpu) {
+    return true;
+  }
   if (backend_ == Backend::kPopSift) {
 #if INSIGHTAT_HAS_POPSIFT_MATCH
     return true;
@@ -109,6 +119,9 @@ bool SiftMatcher::verify_context() const {
 
 MatchResult SiftMatcher::match(const FeatureData& features1, const FeatureData& features2,
                                const MatchOptions& options) {
+  if (backend_ == Backend::kCpu) {
+    return match_descriptors_cpu(features1, features2, options);
+  }
   if (backend_ == Backend::kPopSift) {
     return match_popsift(features1, features2, options);
   }
@@ -26,6 +26,7 @@ struct SiftMatcherParams {
   bool use_cuda = true;
   bool use_sift_gpu = false;
   bool use_pop_sift = true;
+  bool use_cpu = false;  ///< CPU 暴力匹配（cpu_descriptor_match），优先于 GPU 后端；无共享状态
 };
 
 /**
@@ -34,6 +35,9 @@ struct SiftMatcherParams {
  * Provides high-level interface for feature matching using GPU acceleration.
  * Manages OpenGL context and GPU resources.
  *
+ * With params.use_cpu the matcher holds no GPU state and match() may be called
+ * concurrently from several threads.
+ *
  * Usage:
  *   SiftMatcher matcher(10000);
  *   auto result = matcher.match(features1, features2, options);
@@ -83,13 +87,13 @@ public:
                           const Eigen::Matrix3f* F = nullptr, const Eigen::Matrix3f* H = nullptr,
                           const MatchOptions& options = MatchOptions());
 
-  /** @return true 表示 GPU 上下文已正确初始化。 */
+  /** @return true 表示 GPU 上下文已正确初始化（CPU 后端恒为 true）。 */
   bool verify_context() const;
 
   int get_max_features() const { return max_features_; }
 
 private:
-  enum class Backend { kSiftGPU, kPopSift };
+  enum class Backend { kSiftGPU, kPopSift, kCpu };
   int max_features_;
   SiftMatcherParams params_;
   Backend backend_ = Backend::kSiftGPU;
@@ -0,0 +1,495 @@
+/**
+ * @file  minibatch_kmeans.cpp
+ * @brief 分块最近中心分配（GEMM 筛选 + 标量复核）、k-means++ 初始化与流式 mini-batch k-means。
+ */
+
+#include "minibatch_kmeans.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <numeric>
+#include <random>
+
+#include <Eigen/Core>
+#include <glog/logging.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "../../io/idc_reader.h"
+
+namespace insight {
+namespace algorithm {
+namespace retrieval {
+
+namespace {
+
+using RowMatrixXf = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+constexpr int kAssignRowBlock = 256;  ///< 每个任务分配的描述子行数
+
+int resolve_threads(int num_threads) {
+#ifdef _OPENMP
+  return num_threads > 0 ? num_threads : omp_get_max_threads();
+#else
+  (void)num_threads;
+  return 1;
+#endif
+}
+
+/** 同 find_top_k_similar：GEMM 展开距离与逐元素累加距离之差的上界系数（× (‖x‖²+‖c‖²)）。 */
+double distance_error_factor(int dim) {
+  const double u = std::numeric_limits<float>::epsilon() * 0.5;
+  const double nu = (dim + 4) * u;
+  return 4.0 * nu / (1.0 - nu);
+}
+
+/** 与旧 assign_to_clusters 相同的逐元素累加顺序。 */
+float exact_dist_sq(const float* a, const float* b, int dim) {
+  float dist = 0.0f;
+  for (int d = 0; d < dim; ++d) {
+    float diff = a[d] - b[d];
+    dist += diff * diff;
+  }
+  return dist;
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+/** 按顺序读入若干块并拼接；threads > 1 时块间并行读取。 */
+std::vector<float> load_chunks(const DescriptorSource& source, const std::vector<int>& chunks,
+                               int dim, [[maybe_unused]] int threads) {
+  std::vector<std::vector<float>> parts(chunks.size());
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+  for (int i = 0; i < static_cast<int>(chunks.size()); ++i) {
+    if (!source.load(chunks[static_cast<size_t>(i)], &parts[static_cast<size_t>(i)]) ||
+        parts[static_cast<size_t>(i)].size() % static_cast<size_t>(dim) != 0) {
+      parts[static_cast<size_t>(i)].clear();
+    }
+  }
+  size_t total = 0;
+  for (const auto& p : parts) total += p.size();
+  std::vector<float> out;
+  out.reserve(total);
+  for (const auto& p : parts) out.insert(out.end(), p.begin(), p.end());
+  return out;
+}
+
+/** pool 每行到 cands 每行的平方距离（展开式，仅用于初始化抽样），结果 num_points × num_cands。 */
+RowMatrixXf pool_to_candidates(const std::vector<float>& pool, const std::vector<double>& pool_norm,
+                               int num_points, const float* cands, int num_cands, int dim,
+                               [[maybe_unused]] int threads) {
+  Eigen::Map<const RowMatrixXf> C(cands, num_cands, dim);
+  std::vector<double> c_norm(static_cast<size_t>(num_cands));
+  for (int t = 0; t < num_cands; ++t) c_norm[static_cast<size_t>(t)] = C.row(t).cast<double>().squaredNorm();
+  RowMatrixXf dist(num_points, num_cands);
+  const int num_blocks = (num_points + kAssignRowBlock - 1) / kAssignRowBlock;
+#pragma omp parallel for schedule(static) num_threads(threads)
+  for (int b = 0; b < num_blocks; ++b) {
+    const int r0 = b * kAssignRowBlock;
+    const int rows = std::min(kAssignRowBlock, num_points - r0);
+    Eigen::Map<const RowMatrixXf> X(pool.data() + static_cast<size_t>(r0) * dim, rows, dim);
+    const RowMatrixXf dots = X * C.transpose();
+    for (int r = 0; r < rows; ++r) {
+      for (int t = 0; t < num_cands; ++t) {
+        const double d = pool_norm[static_cast<size_t>(r0 + r)] + c_norm[static_cast<size_t>(t)] -
+                         2.0 * static_cast<double>(dots(r, t));
+        dist(r0 + r, t) = static_cast<float>(std::max(0.0, d));
+      }
+    }
+  }
+  return dist;
+}
+
+/**
+ * 贪心 k-means++（Arthur & Vassilvitskii；与 scikit-learn 相同取 2 + ln k 个候选）：
+ * 每步按到已选中心的最小平方距离加权抽取候选，选使总势能最小者。纯 k-means++ 在簇数较多时
+ * 有明显概率把两个中心放进同一簇，而 mini-batch 更新无法把它们分开。
+ */
+std::vector<float> kmeans_plus_plus(const std::vector<float>& pool, int num_points, int k, int dim,
+                                    std::mt19937& rng, int threads) {
+  const int num_trials = 2 + static_cast<int>(std::log(static_cast<double>(k)));
+  std::vector<double> pool_norm(static_cast<size_t>(num_points));
+  for (int i = 0; i < num_points; ++i) {
+    double s = 0.0;
+    for (int d = 0; d < dim; ++d) {
+      const double v = pool[static_cast<size_t>(i) * dim + d];
+      s += v * v;
+    }
+    pool_norm[static_cast<size_t>(i)] = s;
+  }
+
+  std::vector<float> centroids(static_cast<size_t>(k) * dim);
+  const int first = std::uniform_int_distribution<int>(0, num_points - 1)(rng);
+  std::copy(pool.data() + static_cast<size_t>(first) * dim,
+            pool.data() + static_cast<size_t>(first + 1) * dim, centroids.data());
+  const RowMatrixXf d0 = pool_to_candidates(pool, pool_norm, num_points, centroids.data(), 1, dim, threads);
+  std::vector<float> d2(d0.data(), d0.data() + num_points);
+
+  std::vector<double> prefix(static_cast<size_t>(num_points));
+  std::vector<float> cands(static_cast<size_t>(num_trials) * dim);
+  for (int c = 1; c < k; ++c) {
+    double acc = 0.0;
+    for (int i = 0; i < num_points; ++i) prefix[static_cast<size_t>(i)] = acc += d2[static_cast<size_t>(i)];
+    for (int t = 0; t < num_trials; ++t) {
+      int pick;
+      if (acc <= 0.0) {
+        // 剩余样本与已选中心全部重合：退化为均匀抽取
+        pick = std::uniform_int_distribution<int>(0, num_points - 1)(rng);
+      } else {
+        const double r = std::uniform_real_distribution<double>(0.0, acc)(rng);
+        pick = static_cast<int>(std::upper_bound(prefix.begin(), prefix.end(), r) - prefix.begin());
+        pick = std::min(pick, num_points - 1);
+      }
+      std::copy(pool.data() + static_cast<size_t>(pick) * dim,
+                pool.data() + static_cast<size_t>(pick + 1) * dim,
+                cands.data() + static_cast<size_t>(t) * dim);
+    }
+
+    const RowMatrixXf dist =
+        pool_to_candidates(pool, pool_norm, num_points, cands.data(), num_trials, dim, threads);
+    int best = 0;
+    double best_potential = std::numeric_limits<double>::max();
+    for (int t = 0; t < num_trials; ++t) {
+      double potential = 0.0;
+      for (int i = 0; i < num_points; ++i) {
+        potential += std::min(d2[static_cast<size_t>(i)], dist(i, t));
+      }
+      if (potential < best_potential) {
+        best_potential = potential;
+        best = t;
+      }
+    }
+    for (int i = 0; i < num_points; ++i) {
+      d2[static_cast<size_t>(i)] = std::min(d2[static_cast<size_t>(i)], dist(i, best));
+    }
+    std::copy(cands.data() + static_cast<size_t>(best) * dim,
+              cands.data() + static_cast<size_t>(best + 1) * dim,
+              centroids.data() + static_cast<size_t>(c) * dim);
+  }
+  return centroids;
+}
+
+}  // namespace
+
+void assign_nearest_centroids(const float* points, int num_points, const float* centroids,
+                              int num_clusters, int dim, int* labels, float* dist_sq,
+                              int num_threads) {
+  if (num_points <= 0 || num_clusters <= 0 || dim <= 0) {
+    return;
+  }
+
+  // 1) GEMM 得到 ‖c‖²-2x·c（‖x‖² 对同一行是常数）只用于筛选：保留不超过 最小值 + 2E 的中心；
+  // 2) 候选按下标升序用逐元素累加复核，严格小于才替换，因此与逐对标量循环的结果逐位一致。
+  Eigen::Map<const RowMatrixXf> C(centroids, num_clusters, dim);
+  std::vector<double> c_norm(static_cast<size_t>(num_clusters));
+  for (int c = 0; c < num_clusters; ++c) {
+    double s = 0.0;
+    for (int d = 0; d < dim; ++d) {
+      const double v = centroids[static_cast<size_t>(c) * dim + d];
+      s += v * v;
+    }
+    c_norm[static_cast<size_t>(c)] = s;
+  }
+  const double max_c_norm = *std::max_element(c_norm.begin(), c_norm.end());
+  const double err_factor = distance_error_factor(dim);
+  [[maybe_unused]] const int threads = resolve_threads(num_threads);
+  const int num_blocks = (num_points + kAssignRowBlock - 1) / kAssignRowBlock;
+
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+  for (int b = 0; b < num_blocks; ++b) {
+    const int r0 = b * kAssignRowBlock;
+    const int rows = std::min(kAssignRowBlock, num_points - r0);
+    Eigen::Map<const RowMatrixXf> X(points + static_cast<size_t>(r0) * dim, rows, dim);
+    const RowMatrixXf dots = X * C.transpose();
+
+    for (int r = 0; r < rows; ++r) {
+      const float* x = points + static_cast<size_t>(r0 + r) * dim;
+      double x_norm = 0.0;
+      for (int d = 0; d < dim; ++d) x_norm += static_cast<double>(x[d]) * x[d];
+
+      double approx_min = std::numeric_limits<double>::max();
+      for (int c = 0; c < num_clusters; ++c) {
+        approx_min = std::min(approx_min,
+                              c_norm[static_cast<size_t>(c)] - 2.0 * static_cast<double>(dots(r, c)));
+      }
+      const double tau = approx_min + 2.0 * err_factor * (x_norm + max_c_norm);
+
+      float min_dist = std::numeric_limits<float>::max();
+      int best_cluster = 0;
+      for (int c = 0; c < num_clusters; ++c) {
+        if (c_norm[static_cast<size_t>(c)] - 2.0 * static_cast<double>(dots(r, c)) > tau) continue;
+        const float dist = exact_dist_sq(x, centroids + static_cast<size_t>(c) * dim, dim);
+        if (dist < min_dist) {
+          min_dist = dist;
+          best_cluster = c;
+        }
+      }
+      labels[r0 + r] = best_cluster;
+      if (dist_sq != nullptr) dist_sq[r0 + r] = min_dist;
+    }
+  }
+}
+
+DescriptorSource feature_file_source(std::vector<std::string> feature_files, int max_per_file,
+                                     uint32_t seed) {
+  DescriptorSource source;
+  source.num_chunks = static_cast<int>(feature_files.size());
+  source.max_rows_per_chunk = max_per_file;
+  source.load = [files = std::move(feature_files), max_per_file,
+                 seed](int chunk, std::vector<float>* out) -> bool {
+    constexpr int kDim = 128;
+    const std::string& file = files[static_cast<size_t>(chunk)];
+    io::IDCReader reader(file, io::IDCReadMode::kMapped);
+    if (!reader.is_valid() || !reader.has_blob("descriptors")) {
+      LOG(WARNING) << "Skipping invalid file: " << file;
+      return false;
+    }
+    const std::string dtype = reader.get_blob_descriptor("descriptors")["dtype"];
+    size_t count = 0;
+    const uint8_t* desc_u8 = nullptr;
+    const float* desc_f32 = nullptr;
+    if (dtype == "uint8") {
+      const auto view = reader.view_blob<uint8_t>("descriptors");
+      desc_u8 = view.data();
+      count = view.size();
+    } else if (dtype == "float32") {
+      const auto view = reader.view_blob<float>("descriptors");
+      desc_f32 = view.data();
+      count = view.size();
+    } else {
+      LOG(WARNING) << "Unsupported descriptor type in " << file;
+      return false;
+    }
+    const int num_features = static_cast<int>(count / kDim);
+
+    // 每个文件固定一份样本（与轮次无关）：部分 Fisher-Yates 取前 m 个，再按下标排序
+    std::vector<int> rows(static_cast<size_t>(num_features));
+    std::iota(rows.begin(), rows.end(), 0);
+    if (num_features > max_per_file) {
+      std::mt19937 gen(seed ^ (0x9E3779B9u * static_cast<uint32_t>(chunk + 1)));
+      for (int i = 0; i < max_per_file; ++i) {
+        const int j = std::uniform_int_distribution<int>(i, num_features - 1)(gen);
+        std::swap(rows[static_cast<size_t>(i)], rows[static_cast<size_t>(j)]);
+      }
+      rows.resize(static_cast<size_t>(max_per_file));
+      std::sort(rows.begin(), rows.end());
+    }
+
+    out->resize(rows.size() * kDim);
+    for (size_t i = 0; i < rows.size(); ++i) {
+      const size_t src = static_cast<size_t>(rows[i]) * kDim;
+      float* dst = out->data() + i * kDim;
+      if (desc_u8 != nullptr) {
+        // uint8 descriptors were scaled by 512 during storage, need to reverse
+        for (int d = 0; d < kDim; ++d) dst[d] = static_cast<float>(desc_u8[src + d]) / 512.0f;
+      } else {
+        std::copy(desc_f32 + src, desc_f32 + src + kDim, dst);
+      }
+    }
+    return true;
+  };
+  return source;
+}
+
+DescriptorSource memory_source(const std::vector<float>& descriptors, int dim, int rows_per_chunk) {
+  DescriptorSource source;
+  const int num_rows = static_cast<int>(descriptors.size() / static_cast<size_t>(dim));
+  source.num_chunks = (num_rows + rows_per_chunk - 1) / rows_per_chunk;
+  source.max_rows_per_chunk = rows_per_chunk;
+  source.load = [&descriptors, dim, rows_per_chunk, num_rows](int chunk, std::vector<float>* out) {
+    const int r0 = chunk * rows_per_chunk;
+    const int r1 = std::min(num_rows, r0 + rows_per_chunk);
+    out->assign(descriptors.begin() + static_cast<size_t>(r0) * dim,
+                descriptors.begin() + static_cast<size_t>(r1) * dim);
+    return true;
+  };
+  return source;
+}
+
+MiniBatchKMeansResult train_minibatch_kmeans(
+    const DescriptorSource& source, const MiniBatchKMeansOptions& options,
+    const std::function<void(const KMeansEpochStats&)>& on_epoch) {
+  MiniBatchKMeansResult result;
+  const int k = options.num_clusters;
+  const int dim = options.dim;
+  if (source.num_chunks <= 0 || source.max_rows_per_chunk <= 0 || !source.load || k <= 0 ||
+      dim <= 0 || options.batch_size <= 0 || options.max_epochs <= 0) {
+    LOG(ERROR) << "Invalid input for mini-batch k-means training";
+    return result;
+  }
+  const int threads = resolve_threads(options.num_threads);
+  const int chunks_per_batch =
+      std::max(1, (options.batch_size + source.max_rows_per_chunk - 1) / source.max_rows_per_chunk);
+
+  // ── k-means++ 初始化：按 seed 打乱块顺序，读入约 seed_pool_size 条描述子 ──
+  auto start = std::chrono::steady_clock::now();
+  std::mt19937 rng(options.seed);
+  std::vector<int> order(static_cast<size_t>(source.num_chunks));
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), rng);
+
+  const size_t pool_target = static_cast<size_t>(
+      options.seed_pool_size > 0 ? options.seed_pool_size : std::max(options.batch_size, 64 * k));
+  std::vector<float> pool;
+  for (size_t next = 0; next < order.size() && pool.size() / dim < pool_target;) {
+    const size_t want = (pool_target - pool.size() / dim + source.max_rows_per_chunk - 1) /
+                        source.max_rows_per_chunk;
+    const size_t end = std::min(order.size(), next + std::max<size_t>(want, 1));
+    const auto part = load_chunks(source, std::vector<int>(order.begin() + next, order.begin() + end),
+                                  dim, threads);
+    pool.insert(pool.end(), part.begin(), part.end());
+    next = end;
+  }
+  const int pool_points = static_cast<int>(pool.size() / dim);
+  if (pool_points < k) {
+    LOG(ERROR) << "Too few descriptors (" << pool_points << ") for " << k << " clusters";
+    return result;
+  }
+  std::vector<float> centroids = kmeans_plus_plus(pool, pool_points, k, dim, rng, threads);
+  pool = std::vector<float>();
+  LOG(INFO) << "k-means++ seeding: " << pool_points << " descriptors, " << k << " clusters in "
+            << static_cast<int64_t>(elapsed_ms(start)) << "ms";
+
+  // ── mini-batch 迭代：每个 batch 先分配，再按簇并行更新 c ← (v·c + Σx) / (v + n_b) ──
+  std::vector<int64_t> counts(static_cast<size_t>(k), 0);
+  std::vector<int> labels;
+  std::vector<float> dist;
+  std::vector<int> starts(static_cast<size_t>(k) + 1);
+  std::vector<int> members;
+  std::vector<double> shift(static_cast<size_t>(k));
+  double prev_inertia = -1.0;
+
+  for (int epoch = 1; epoch <= options.max_epochs; ++epoch) {
+    const auto epoch_start = std::chrono::steady_clock::now();
+    std::mt19937 epoch_rng(options.seed + 0x9E3779B9u * static_cast<uint32_t>(epoch));
+    std::shuffle(order.begin(), order.end(), epoch_rng);
+    std::vector<std::vector<int>> batches;
+    for (size_t i = 0; i < order.size(); i += static_cast<size_t>(chunks_per_batch)) {
+      batches.emplace_back(order.begin() + i,
+                           order.begin() + std::min(order.size(), i + chunks_per_batch));
+    }
+
+    // 下一个 batch 在后台读取，与当前 batch 的计算重叠
+    auto fetch = [&](size_t b) {
+      return std::async(std::launch::async,
+                        [&source, &batches, b, dim] { return load_chunks(source, batches[b], dim, 1); });
+    };
+    std::future<std::vector<float>> pending = fetch(0);
+    std::vector<float> batch;
+    std::vector<int> hits(static_cast<size_t>(k), 0);
+    int64_t samples = 0;
+    double inertia_sum = 0.0;
+    double shift_sum = 0.0;
+
+    for (size_t b = 0; b < batches.size(); ++b) {
+      batch = pending.get();
+      if (b + 1 < batches.size()) pending = fetch(b + 1);
+      const int n = static_cast<int>(batch.size() / dim);
+      if (n == 0) continue;
+
+      labels.resize(static_cast<size_t>(n));
+      dist.resize(static_cast<size_t>(n));
+      assign_nearest_centroids(batch.data(), n, centroids.data(), k, dim, labels.data(), dist.data(),
+                               threads);
+
+      // 计数排序：簇内保持样本顺序，累加结果与线程数无关
+      std::fill(starts.begin(), starts.end(), 0);
+      for (int i = 0; i < n; ++i) ++starts[static_cast<size_t>(labels[static_cast<size_t>(i)]) + 1];
+      for (int c = 0; c < k; ++c) starts[static_cast<size_t>(c) + 1] += starts[static_cast<size_t>(c)];
+      members.resize(static_cast<size_t>(n));
+      {
+        std::vector<int> fill(starts.begin(), starts.end() - 1);
+        for (int i = 0; i < n; ++i) {
+          members[static_cast<size_t>(fill[static_cast<size_t>(labels[static_cast<size_t>(i)])]++)] = i;
+        }
+      }
+
+#pragma omp parallel for schedule(dynamic, 4) num_threads(threads)
+      for (int c = 0; c < k; ++c) {
+        const int m0 = starts[static_cast<size_t>(c)];
+        const int m1 = starts[static_cast<size_t>(c) + 1];
+        shift[static_cast<size_t>(c)] = 0.0;
+        if (m0 == m1) continue;
+        std::vector<double> sum(static_cast<size_t>(dim), 0.0);
+        for (int m = m0; m < m1; ++m) {
+          const float* x = batch.data() + static_cast<size_t>(members[static_cast<size_t>(m)]) * dim;
+          for (int d = 0; d < dim; ++d) sum[static_cast<size_t>(d)] += x[d];
+        }
+        const double v = static_cast<double>(counts[static_cast<size_t>(c)]);
+        const double nb = static_cast<double>(m1 - m0);
+        float* center = centroids.data() + static_cast<size_t>(c) * dim;
+        double s = 0.0;
+        for (int d = 0; d < dim; ++d) {
+          const float updated =
+              static_cast<float>((v * center[d] + sum[static_cast<size_t>(d)]) / (v + nb));
+          const double delta = static_cast<double>(updated) - center[d];
+          s += delta * delta;
+          center[d] = updated;
+        }
+        shift[static_cast<size_t>(c)] = s;
+        counts[static_cast<size_t>(c)] += m1 - m0;
+        hits[static_cast<size_t>(c)] += m1 - m0;
+      }
+
+      for (int c = 0; c < k; ++c) shift_sum += shift[static_cast<size_t>(c)];
+      for (int i = 0; i < n; ++i) inertia_sum += dist[static_cast<size_t>(i)];
+      samples += n;
+    }
+
+    if (samples == 0) {
+      LOG(ERROR) << "No descriptors could be read for k-means training";
+      return MiniBatchKMeansResult();
+    }
+
+    // 本轮没有样本的簇移到最后一个 batch 中离其中心最远的样本上
+    int reassigned = 0;
+    const int last_n = static_cast<int>(batch.size() / dim);
+    if (last_n > 0) {
+      std::vector<int> far(static_cast<size_t>(last_n));
+      std::iota(far.begin(), far.end(), 0);
+      std::stable_sort(far.begin(), far.end(), [&dist](int a, int b) {
+        return dist[static_cast<size_t>(a)] > dist[static_cast<size_t>(b)];
+      });
+      for (int c = 0; c < k && reassigned < last_n; ++c) {
+        if (hits[static_cast<size_t>(c)] != 0) continue;
+        const float* x = batch.data() + static_cast<size_t>(far[static_cast<size_t>(reassigned)]) * dim;
+        std::copy(x, x + dim, centroids.data() + static_cast<size_t>(c) * dim);
+        counts[static_cast<size_t>(c)] = 0;
+        ++reassigned;
+      }
+    }
+
+    double center_norm = 0.0;
+    for (float v : centroids) center_norm += static_cast<double>(v) * v;
+
+    KMeansEpochStats stats;
+    stats.epoch = epoch;
+    stats.samples = samples;
+    stats.inertia = inertia_sum / static_cast<double>(samples);
+    stats.center_shift = center_norm > 0.0 ? shift_sum / center_norm : 0.0;
+    stats.reassigned = reassigned;
+    stats.elapsed_ms = elapsed_ms(epoch_start);
+    result.trace.push_back(stats);
+    if (on_epoch) on_epoch(stats);
+
+    if (prev_inertia > 0.0 && reassigned == 0 &&
+        (prev_inertia - stats.inertia) / prev_inertia < options.convergence_threshold) {
+      result.converged = true;
+      break;
+    }
+    prev_inertia = stats.inertia;
+  }
+
+  result.centroids = std::move(centroids);
+  return result;
+}
+
+}  // namespace retrieval
+}  // namespace algorithm
+}  // namespace insight
@@ -0,0 +1,82 @@
+/**
+ * @file  minibatch_kmeans.h
+ * @brief VLAD 码本训练：流式多线程 mini-batch k-means（k-means++ 初始化）与分块最近中心分配。
+ *
+ * - assign_nearest_centroids：Eigen GEMM 展开 ‖x‖²+‖c‖²-2x·c 筛选候选，再用逐元素 float 累加
+ *   复核，结果（含并列取最小下标）与逐对标量循环逐位一致；assign_to_clusters / encode_vlad 也用它。
+ * - train_minibatch_kmeans：描述子按“块”（一个 .isat_feat 的采样描述子）从 DescriptorSource
+ *   流式读取，内存只保留当前 batch 与预取的下一 batch，不再把全部样本拷进 cv::Mat。
+ *   每轮（epoch）按 seed 打乱块顺序；中心更新按簇并行、簇内按样本顺序累加，结果与线程数无关。
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace insight {
+namespace algorithm {
+namespace retrieval {
+
+/**
+ * 最近中心分配（L2）。points: num_points × dim，centroids: num_clusters × dim，均为行主序。
+ * dist_sq 可为 nullptr；num_threads <= 0 时用 OpenMP 默认线程数。
+ */
+void assign_nearest_centroids(const float* points, int num_points, const float* centroids,
+                              int num_clusters, int dim, int* labels, float* dist_sq = nullptr,
+                              int num_threads = 0);
+
+/** 分块描述子来源：load(i, out) 把第 i 块（行主序 × dim）写入 *out，失败返回 false。需可并发调用。 */
+struct DescriptorSource {
+  int num_chunks = 0;
+  int max_rows_per_chunk = 0;  ///< 每块行数上限，用于换算每个 batch 取多少块
+  std::function<bool(int chunk, std::vector<float>* out)> load;
+};
+
+/** .isat_feat 文件来源：每个文件为一块，最多随机取 max_per_file 条描述子（由 seed 与文件序号确定）。 */
+DescriptorSource feature_file_source(std::vector<std::string> feature_files, int max_per_file,
+                                     uint32_t seed);
+
+/** 内存来源：descriptors 按 rows_per_chunk 行切块（不拷贝，调用方保证其生命周期）。 */
+DescriptorSource memory_source(const std::vector<float>& descriptors, int dim, int rows_per_chunk);
+
+struct MiniBatchKMeansOptions {
+  int num_clusters = 64;
+  int dim = 128;
+  int batch_size = 10000;              ///< 每个 mini-batch 的目标描述子数
+  int max_epochs = 100;                ///< 最多遍历来源的轮数
+  float convergence_threshold = 1e-4f; ///< 相邻两轮平均惯量的相对下降低于此值即收敛
+  int seed_pool_size = 0;              ///< k-means++ 初始化样本数；0 → max(batch_size, 64·k)
+  int num_threads = 0;                 ///< <= 0：OpenMP 默认
+  uint32_t seed = 42;
+};
+
+/** 每轮收敛轨迹。 */
+struct KMeansEpochStats {
+  int epoch = 0;
+  int64_t samples = 0;        ///< 本轮处理的描述子数
+  double inertia = 0.0;       ///< 本轮平均平方距离（分配时的中心）
+  double center_shift = 0.0;  ///< 本轮中心移动量 Σ‖Δc‖² / Σ‖c‖²
+  int reassigned = 0;         ///< 本轮无样本、被重置到远点的簇数
+  double elapsed_ms = 0.0;
+};
+
+struct MiniBatchKMeansResult {
+  std::vector<float> centroids;  ///< num_clusters × dim；失败时为空
+  std::vector<KMeansEpochStats> trace;
+  bool converged = false;
+};
+
+/**
+ * 流式 mini-batch k-means（Sculley 2010，按簇累计计数作学习率）。
+ * on_epoch 在每轮结束后调用（主线程），用于输出收敛轨迹。
+ */
+MiniBatchKMeansResult train_minibatch_kmeans(
+    const DescriptorSource& source, const MiniBatchKMeansOptions& options,
+    const std::function<void(const KMeansEpochStats&)>& on_epoch = {});
+
+}  // namespace retrieval
+}  // namespace algorithm
+}  // namespace insight
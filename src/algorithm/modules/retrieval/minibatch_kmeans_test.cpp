@@ -0,0 +1,183 @@
+/**
+ * @file  minibatch_kmeans_test.cpp
+ * @brief Unit tests for blocked centroid assignment and streaming mini-batch k-means.
+ *
+ * Usage
+ * ─────
+ *   ./test_minibatch_kmeans
+ */
+
+#include "minibatch_kmeans.h"
+
+#include <glog/logging.h>
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace insight {
+namespace algorithm {
+namespace retrieval {
+namespace {
+
+constexpr int kDim = 128;
+
+/** Scalar nearest centroid, identical to the original assign_to_clusters loop. */
+std::vector<int> reference_assign(const std::vector<float>& x, const std::vector<float>& c, int dim) {
+  const int n = static_cast<int>(x.size() / dim);
+  const int k = static_cast<int>(c.size() / dim);
+  std::vector<int> labels(static_cast<size_t>(n));
+  for (int i = 0; i < n; ++i) {
+    float min_dist = std::numeric_limits<float>::max();
+    int best = 0;
+    for (int j = 0; j < k; ++j) {
+      float dist = 0.0f;
+      for (int d = 0; d < dim; ++d) {
+        float diff = x[static_cast<size_t>(i) * dim + d] - c[static_cast<size_t>(j) * dim + d];
+        dist += diff * diff;
+      }
+      if (dist < min_dist) {
+        min_dist = dist;
+        best = j;
+      }
+    }
+    labels[static_cast<size_t>(i)] = best;
+  }
+  return labels;
+}
+
+/** SIFT-like descriptors: uint8 / 512 around `num_centers` cluster centres. */
+std::vector<float> make_descriptors(int n, int num_centers, uint32_t seed, std::vector<float>* centers) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> byte(0, 160);
+  std::normal_distribution<float> noise(0.0f, 6.0f);
+  centers->assign(static_cast<size_t>(num_centers) * kDim, 0.0f);
+  for (auto& v : *centers) v = static_cast<float>(byte(rng));
+  std::vector<float> x(static_cast<size_t>(n) * kDim);
+  for (int i = 0; i < n; ++i) {
+    const float* c = centers->data() + static_cast<size_t>(i % num_centers) * kDim;
+    for (int d = 0; d < kDim; ++d) {
+      const float v = std::round(std::min(255.0f, std::max(0.0f, c[d] + noise(rng))));
+      x[static_cast<size_t>(i) * kDim + d] = v / 512.0f;
+    }
+  }
+  for (auto& v : *centers) v /= 512.0f;
+  return x;
+}
+
+int test_assignment_matches_scalar() {
+  std::cout << "[Test 1] blocked assignment == scalar loop (incl. ties)\n";
+  std::vector<float> true_centers;
+  const auto x = make_descriptors(3000, 40, 7, &true_centers);
+  // Centroids: random descriptors plus exact duplicates (ties must pick the lower index)
+  std::vector<float> c(x.begin(), x.begin() + 64 * kDim);
+  c.insert(c.end(), x.begin() + 10 * kDim, x.begin() + 20 * kDim);
+  const int k = static_cast<int>(c.size() / kDim);
+
+  const auto expected = reference_assign(x, c, kDim);
+  std::vector<int> labels(expected.size());
+  std::vector<float> dist(expected.size());
+  assign_nearest_centroids(x.data(), static_cast<int>(expected.size()), c.data(), k, kDim,
+                           labels.data(), dist.data());
+  for (size_t i = 0; i < labels.size(); ++i) {
+    if (labels[i] != expected[i]) {
+      std::cerr << "  FAIL: row " << i << " got " << labels[i] << ", expected " << expected[i] << "\n";
+      return 1;
+    }
+  }
+  if (dist[10] != 0.0f || labels[10] != 10) {
+    std::cerr << "  FAIL: duplicate centroid tie\n";
+    return 1;
+  }
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+int test_minibatch_recovers_clusters() {
+  std::cout << "[Test 2] mini-batch k-means recovers separated clusters, thread-count independent\n";
+  constexpr int kClusters = 16;
+  std::vector<float> true_centers;
+  const auto x = make_descriptors(16000, kClusters, 11, &true_centers);
+  const auto source = memory_source(x, kDim, 500);
+
+  MiniBatchKMeansOptions opts;
+  opts.num_clusters = kClusters;
+  opts.batch_size = 2000;
+  opts.max_epochs = 20;
+  opts.convergence_threshold = 1e-3f;
+  opts.num_threads = 1;
+  int callbacks = 0;
+  const auto single = train_minibatch_kmeans(source, opts, [&](const KMeansEpochStats&) { ++callbacks; });
+  if (single.centroids.size() != static_cast<size_t>(kClusters) * kDim || single.trace.empty() ||
+      callbacks != static_cast<int>(single.trace.size())) {
+    std::cerr << "  FAIL: training produced no result\n";
+    return 1;
+  }
+  if (!single.converged || single.trace.back().inertia > single.trace.front().inertia) {
+    std::cerr << "  FAIL: did not converge (" << single.trace.size() << " epochs)\n";
+    return 1;
+  }
+
+  // Every true centre must have a learned centroid close by (clusters are ~1.4 apart)
+  const auto nearest = reference_assign(true_centers, single.centroids, kDim);
+  for (int t = 0; t < kClusters; ++t) {
+    const float* a = true_centers.data() + static_cast<size_t>(t) * kDim;
+    const float* b = single.centroids.data() + static_cast<size_t>(nearest[static_cast<size_t>(t)]) * kDim;
+    double d2 = 0.0;
+    for (int d = 0; d < kDim; ++d) d2 += (a[d] - b[d]) * (a[d] - b[d]);
+    if (std::sqrt(d2) > 0.05) {
+      std::cerr << "  FAIL: centre " << t << " missed (distance " << std::sqrt(d2) << ")\n";
+      return 1;
+    }
+  }
+
+  opts.num_threads = 4;
+  const auto multi = train_minibatch_kmeans(source, opts);
+  if (multi.centroids != single.centroids || multi.trace.size() != single.trace.size()) {
+    std::cerr << "  FAIL: result depends on thread count\n";
+    return 1;
+  }
+  std::cout << "  PASS (" << single.trace.size() << " epochs, inertia "
+            << single.trace.front().inertia << " -> " << single.trace.back().inertia << ")\n";
+  return 0;
+}
+
+int test_too_few_descriptors() {
+  std::cout << "[Test 3] fewer descriptors than clusters fails cleanly\n";
+  std::vector<float> true_centers;
+  const auto x = make_descriptors(10, 2, 3, &true_centers);
+  MiniBatchKMeansOptions opts;
+  opts.num_clusters = 32;
+  if (!train_minibatch_kmeans(memory_source(x, kDim, 4), opts).centroids.empty()) {
+    std::cerr << "  FAIL: expected empty result\n";
+    return 1;
+  }
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+}  // namespace
+}  // namespace retrieval
+}  // namespace algorithm
+}  // namespace insight
+
+int main() {
+  google::InitGoogleLogging("test_minibatch_kmeans");
+  FLAGS_logtostderr = 1;
+  FLAGS_minloglevel = 2;
+
+  int failures = 0;
+  failures += insight::algorithm::retrieval::test_assignment_matches_scalar();
+  failures += insight::algorithm::retrieval::test_minibatch_recovers_clusters();
+  failures += insight::algorithm::retrieval::test_too_few_descriptors();
+
+  if (failures == 0) {
+    std::cout << "\nAll tests PASSED.\n";
+    return 0;
+  }
+  std::cerr << "\n" << failures << " test(s) FAILED.\n";
+  return 1;
+}
@@ -0,0 +1,381 @@
+/**
+ * @file  vlad_ann_index.cpp
+ * @brief HnswIndex 实现（插入、分层搜索、启发式邻居选择、IDC 读写）。
+ */
+
+#include "vlad_ann_index.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+#include <glog/logging.h>
+
+#include "../../io/idc_reader.h"
+#include "../../io/idc_writer.h"
+
+namespace insight {
+namespace algorithm {
+namespace retrieval {
+
+namespace {
+
+constexpr int kMaxLevel = 16;
+constexpr int kFormatVersion = 1;
+
+uint64_t splitmix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+/** 每线程一份的访问标记（epoch 递增代替清零），使 const search() 可并发调用。 */
+struct VisitedTable {
+  std::vector<uint32_t> mark;
+  uint32_t epoch = 0;
+
+  uint32_t next(size_t n) {
+    if (mark.size() < n) mark.resize(n, 0);
+    if (++epoch == 0) {
+      std::fill(mark.begin(), mark.end(), 0);
+      epoch = 1;
+    }
+    return epoch;
+  }
+};
+
+thread_local VisitedTable t_visited;
+
+}  // namespace
+
+HnswIndex::HnswIndex(int dim, const HnswParams& params) : dim_(dim), params_(params) {
+  params_.M = std::max(params_.M, 2);
+  params_.ef_construction = std::max(params_.ef_construction, params_.M);
+}
+
+HnswIndex HnswIndex::build(const float* vectors, const uint32_t* ids, int num, int dim,
+                           const HnswParams& params) {
+  HnswIndex index(dim, params);
+  index.data_.reserve(static_cast<size_t>(num) * dim);
+  index.ids_.reserve(static_cast<size_t>(num));
+  index.stamps_.reserve(static_cast<size_t>(num));
+  for (int i = 0; i < num; ++i) {
+    index.add(ids[i], vectors + static_cast<size_t>(i) * dim);
+  }
+  return index;
+}
+
+float HnswIndex::distance_sq(const float* a, const float* b) const {
+  // 4 路部分和，便于编译器向量化
+  float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+  int d = 0;
+  for (; d + 4 <= dim_; d += 4) {
+    const float e0 = a[d] - b[d], e1 = a[d + 1] - b[d + 1];
+    const float e2 = a[d + 2] - b[d + 2], e3 = a[d + 3] - b[d + 3];
+    s0 += e0 * e0;
+    s1 += e1 * e1;
+    s2 += e2 * e2;
+    s3 += e3 * e3;
+  }
+  for (; d < dim_; ++d) {
+    const float e = a[d] - b[d];
+    s0 += e * e;
+  }
+  return (s0 + s1) + (s2 + s3);
+}
+
+int HnswIndex::level_for(int node) const {
+  const uint64_t h = splitmix64((static_cast<uint64_t>(params_.seed) << 32) ^ static_cast<uint64_t>(node));
+  const double u = (static_cast<double>(h >> 11) + 1.0) * (1.0 / 9007199254740992.0);  // (0, 1]
+  const int level = static_cast<int>(-std::log(u) / std::log(static_cast<double>(params_.M)));
+  return std::min(level, kMaxLevel);
+}
+
+int HnswIndex::greedy_descend(const float* query, int entry, int from_level, int to_level) const {
+  int cur = entry;
+  float cur_dist = distance_sq(query, node_vector(cur));
+  for (int level = from_level; level > to_level; --level) {
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (int nb : links_[static_cast<size_t>(cur)][static_cast<size_t>(level)]) {
+        const float d = distance_sq(query, node_vector(nb));
+        if (d < cur_dist || (d == cur_dist && nb < cur)) {
+          cur = nb;
+          cur_dist = d;
+          changed = true;
+        }
+      }
+    }
+  }
+  return cur;
+}
+
+std::vector<HnswIndex::Candidate> HnswIndex::search_layer(const float* query, int entry, int ef,
+                                                          int level) const {
+  const uint32_t tag = t_visited.next(ids_.size());
+  std::vector<uint32_t>& mark = t_visited.mark;
+
+  // candidates: 小顶堆（待扩展）；results: 大顶堆（当前 ef 个最近）
+  std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> candidates;
+  std::priority_queue<Candidate> results;
+  const Candidate start{distance_sq(query, node_vector(entry)), entry};
+  candidates.push(start);
+  results.push(start);
+  mark[static_cast<size_t>(entry)] = tag;
+
+  while (!candidates.empty()) {
+    const Candidate c = candidates.top();
+    if (c > results.top() && static_cast<int>(results.size()) >= ef) break;
+    candidates.pop();
+    for (int nb : links_[static_cast<size_t>(c.second)][static_cast<size_t>(level)]) {
+      if (mark[static_cast<size_t>(nb)] == tag) continue;
+      mark[static_cast<size_t>(nb)] = tag;
+      const Candidate e{distance_sq(query, node_vector(nb)), nb};
+      if (static_cast<int>(results.size()) < ef || e < results.top()) {
+        candidates.push(e);
+        results.push(e);
+        if (static_cast<int>(results.size()) > ef) results.pop();
+      }
+    }
+  }
+
+  std::vector<Candidate> out(results.size());
+  for (size_t i = out.size(); i-- > 0;) {
+    out[i] = results.top();
+    results.pop();
+  }
+  return out;
+}
+
+std::vector<int> HnswIndex::select_neighbors(const std::vector<Candidate>& candidates, int m) const {
+  std::vector<int> selected;
+  selected.reserve(static_cast<size_t>(m));
+  for (const Candidate& c : candidates) {
+    if (static_cast<int>(selected.size()) >= m) break;
+    bool keep = true;
+    for (int s : selected) {
+      if (distance_sq(node_vector(c.second), node_vector(s)) < c.first) {
+        keep = false;
+        break;
+      }
+    }
+    if (keep) selected.push_back(c.second);
+  }
+  return selected;
+}
+
+void HnswIndex::link(int from, int to, int level) {
+  auto& list = links_[static_cast<size_t>(from)][static_cast<size_t>(level)];
+  list.push_back(to);
+  const int cap = max_links(level);
+  if (static_cast<int>(list.size()) <= cap) return;
+  std::vector<Candidate> cands;
+  cands.reserve(list.size());
+  for (int nb : list) cands.push_back({distance_sq(node_vector(from), node_vector(nb)), nb});
+  std::sort(cands.begin(), cands.end());
+  list = select_neighbors(cands, cap);
+}
+
+void HnswIndex::relink(int node) {
+  const float* q = node_vector(node);
+  const int level = levels_[static_cast<size_t>(node)];
+  // 从入口点下降（入口点即 node 时从它自己出发，其旧邻居仍把它接在图里）
+  int entry = greedy_descend(q, entry_point_, max_level_, level);
+  for (int lc = std::min(level, max_level_); lc >= 0; --lc) {
+    std::vector<Candidate> nearest = search_layer(q, entry, params_.ef_construction + 1, lc);
+    nearest.erase(std::remove_if(nearest.begin(), nearest.end(),
+                                 [node](const Candidate& c) { return c.second == node; }),
+                  nearest.end());
+    if (nearest.empty()) continue;
+    const std::vector<int> neighbors = select_neighbors(nearest, params_.M);
+    links_[static_cast<size_t>(node)][static_cast<size_t>(lc)] = neighbors;
+    for (int nb : neighbors) {
+      const auto& list = links_[static_cast<size_t>(nb)][static_cast<size_t>(lc)];
+      if (std::find(list.begin(), list.end(), node) == list.end()) link(nb, node, lc);
+    }
+    entry = nearest.front().second;
+  }
+}
+
+int HnswIndex::add(uint32_t id, const float* vector, uint64_t stamp) {
+  auto found = id_to_node_.find(id);
+  if (found != id_to_node_.end()) {
+    const int node = found->second;
+    if (stamps_[static_cast<size_t>(node)] != stamp) {
+      std::copy(vector, vector + dim_, data_.data() + static_cast<size_t>(node) * dim_);
+      stamps_[static_cast<size_t>(node)] = stamp;
+      relink(node);
+    }
+    return node;
+  }
+
+  const int node = static_cast<int>(ids_.size());
+  const int level = level_for(node);
+  data_.insert(data_.end(), vector, vector + dim_);
+  ids_.push_back(id);
+  stamps_.push_back(stamp);
+  levels_.push_back(level);
+  links_.emplace_back(static_cast<size_t>(level + 1));
+  id_to_node_.emplace(id, node);
+
+  if (entry_point_ < 0) {
+    entry_point_ = node;
+    max_level_ = level;
+    return node;
+  }
+
+  const float* q = node_vector(node);
+  int entry = greedy_descend(q, entry_point_, max_level_, level);
+  for (int lc = std::min(level, max_level_); lc >= 0; --lc) {
+    const std::vector<Candidate> nearest = search_layer(q, entry, params_.ef_construction, lc);
+    const std::vector<int> neighbors = select_neighbors(nearest, params_.M);
+    links_[static_cast<size_t>(node)][static_cast<size_t>(lc)] = neighbors;
+    for (int nb : neighbors) link(nb, node, lc);
+    entry = nearest.front().second;
+  }
+  if (level > max_level_) {
+    max_level_ = level;
+    entry_point_ = node;
+  }
+  return node;
+}
+
+std::vector<std::pair<float, uint32_t>> HnswIndex::search(const float* query, int k, int ef) const {
+  std::vector<std::pair<float, uint32_t>> out;
+  if (entry_point_ < 0 || k <= 0) return out;
+  const int entry = greedy_descend(query, entry_point_, max_level_, 0);
+  const std::vector<Candidate> nearest =
+      search_layer(query, entry, std::max(ef > 0 ? ef : params_.ef_search, k), 0);
+  const size_t n = std::min(nearest.size(), static_cast<size_t>(k));
+  out.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    out.push_back({std::sqrt(nearest[i].first), ids_[static_cast<size_t>(nearest[i].second)]});
+  }
+  return out;
+}
+
+bool HnswIndex::save(const std::string& path, const nlohmann::json& user_metadata) const {
+  std::vector<int32_t> link_counts;
+  std::vector<int32_t> links;
+  for (const auto& node_links : links_) {
+    for (const auto& list : node_links) {
+      link_counts.push_back(static_cast<int32_t>(list.size()));
+      links.insert(links.end(), list.begin(), list.end());
+    }
+  }
+
+  nlohmann::json meta;
+  meta["format"] = "isat_vlad_ann";
+  meta["version"] = kFormatVersion;
+  meta["dim"] = dim_;
+  meta["M"] = params_.M;
+  meta["ef_construction"] = params_.ef_construction;
+  meta["ef_search"] = params_.ef_search;
+  meta["seed"] = params_.seed;
+  meta["count"] = size();
+  meta["entry_point"] = entry_point_;
+  meta["max_level"] = max_level_;
+  meta["user"] = user_metadata;
+
+  io::IDCWriter writer(path);
+  writer.set_metadata(meta);
+  writer.add_blob("stamps", stamps_.data(), stamps_.size() * sizeof(uint64_t), "uint64", {size()});
+  writer.add_blob("vectors", data_.data(), data_.size() * sizeof(float), "float32", {size(), dim_});
+  writer.add_blob("ids", ids_.data(), ids_.size() * sizeof(uint32_t), "uint32", {size()});
+  writer.add_blob("levels", levels_.data(), levels_.size() * sizeof(int32_t), "int32", {size()});
+  writer.add_blob("link_counts", link_counts.data(), link_counts.size() * sizeof(int32_t), "int32",
+                  {static_cast<int>(link_counts.size())});
+  writer.add_blob("links", links.data(), links.size() * sizeof(int32_t), "int32",
+                  {static_cast<int>(links.size())});
+  if (!writer.write()) {
+    LOG(ERROR) << "Failed to write ANN index: " << path;
+    return false;
+  }
+  return true;
+}
+
+bool HnswIndex::load(const std::string& path, HnswIndex* index, nlohmann::json* user_metadata) {
+  io::IDCReader reader(path, io::IDCReadMode::kMapped);
+  if (!reader.is_valid()) return false;
+  const nlohmann::json& meta = reader.get_metadata();
+  if (meta.value("format", std::string()) != "isat_vlad_ann" ||
+      meta.value("version", 0) != kFormatVersion) {
+    LOG(ERROR) << "Not a VLAD ANN index (or unsupported version): " << path;
+    return false;
+  }
+
+  HnswParams params;
+  params.M = meta.value("M", params.M);
+  params.ef_construction = meta.value("ef_construction", params.ef_construction);
+  params.ef_search = meta.value("ef_search", params.ef_search);
+  params.seed = meta.value("seed", params.seed);
+  HnswIndex out(meta.value("dim", 0), params);
+  const int count = meta.value("count", 0);
+
+  const auto vectors = reader.view_blob<float>("vectors");
+  const auto ids = reader.view_blob<uint32_t>("ids");
+  const auto levels = reader.view_blob<int32_t>("levels");
+  const auto link_counts = reader.view_blob<int32_t>("link_counts");
+  const auto links = reader.view_blob<int32_t>("links");
+  if (out.dim_ <= 0 || vectors.size() != static_cast<size_t>(count) * out.dim_ ||
+      ids.size() != static_cast<size_t>(count) || levels.size() != static_cast<size_t>(count)) {
+    LOG(ERROR) << "Corrupt ANN index: " << path;
+    return false;
+  }
+
+  out.data_.assign(vectors.begin(), vectors.end());
+  out.ids_.assign(ids.begin(), ids.end());
+  if (reader.has_blob("stamps")) {
+    const auto stamps = reader.view_blob<uint64_t>("stamps");
+    if (stamps.size() != static_cast<size_t>(count)) {
+      LOG(ERROR) << "Corrupt ANN index (stamps): " << path;
+      return false;
+    }
+    out.stamps_.assign(stamps.begin(), stamps.end());
+  } else {
+    out.stamps_.assign(static_cast<size_t>(count), 0);
+  }
+  out.levels_.assign(levels.begin(), levels.end());
+  out.links_.resize(static_cast<size_t>(count));
+  size_t list_idx = 0, link_pos = 0;
+  for (int node = 0; node < count; ++node) {
+    const int level = out.levels_[static_cast<size_t>(node)];
+    if (level < 0 || level > kMaxLevel) {
+      LOG(ERROR) << "Corrupt ANN index (level): " << path;
+      return false;
+    }
+    out.links_[static_cast<size_t>(node)].resize(static_cast<size_t>(level + 1));
+    for (int l = 0; l <= level; ++l, ++list_idx) {
+      if (list_idx >= link_counts.size() || link_pos + link_counts[list_idx] > links.size()) {
+        LOG(ERROR) << "Corrupt ANN index (links): " << path;
+        return false;
+      }
+      auto& list = out.links_[static_cast<size_t>(node)][static_cast<size_t>(l)];
+      list.assign(links.begin() + link_pos, links.begin() + link_pos + link_counts[list_idx]);
+      link_pos += static_cast<size_t>(link_counts[list_idx]);
+      for (int nb : list) {
+        if (nb < 0 || nb >= count) {
+          LOG(ERROR) << "Corrupt ANN index (neighbor): " << path;
+          return false;
+        }
+      }
+    }
+    out.id_to_node_.emplace(out.ids_[static_cast<size_t>(node)], node);
+  }
+  out.entry_point_ = meta.value("entry_point", -1);
+  out.max_level_ = meta.value("max_level", -1);
+  if (count > 0 && (out.entry_point_ < 0 || out.entry_point_ >= count)) {
+    LOG(ERROR) << "Corrupt ANN index (entry point): " << path;
+    return false;
+  }
+
+  if (user_metadata != nullptr) *user_metadata = meta.value("user", nlohmann::json());
+  *index = std::move(out);
+  return true;
+}
+
+}  // namespace retrieval
+}  // namespace algorithm
+}  // namespace insight
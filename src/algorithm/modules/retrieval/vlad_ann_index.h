@@ -0,0 +1,107 @@
+/**
+ * @file  vlad_ann_index.h
+ * @brief VLAD（PCA 白化后）向量的 HNSW 近似最近邻索引：构建、增量插入、查询、IDC 持久化。
+ *
+ * 面向 10 万级图像的 vlad-ann 检索：构建约 O(N log N)，单次查询约 O(log N)，替代
+ * find_top_k_similar 的 O(N²)。实现按 Malkov & Yashunin 的 HNSW：
+ * - 节点层数 = floor(-ln(u) / ln(M))，u 由 (seed, 插入序号) 哈希得到，因此
+ *   “一次构建 N 个”与“先构建 n、保存、加载、再插入 N-n 个”得到完全相同的图；
+ * - 邻居选择用启发式（候选按距离升序，只保留比已选邻居更接近查询点的候选）；
+ * - 构建串行、结果确定；search() 为 const，可多线程并发调用；
+ * - 每个节点带来源戳（特征文件大小 + 修改时间，vlad_source_stamp）：add() 遇到已有 id 但戳不同
+ *   时原位替换向量并重新选出边（旧入边保留，图仍可导航），特征重新提取的图像不会沿用旧向量。
+ *
+ * 文件格式（.isat_ann，IDC 容器）：
+ *   metadata: {"format": "isat_vlad_ann", "version": 1, dim, M, ef_construction, ef_search, seed,
+ *              count, entry_point, max_level, "user": 调用方附加信息}
+ *   blobs   : stamps uint64[count]（放首位保证 8 字节对齐；旧文件无此项时视为 0）,
+ *             vectors float32[count, dim], ids uint32[count], levels int32[count],
+ *             link_counts int32[Σ(levels+1)]（按节点、层 0..level 顺序）, links int32[Σ link_counts]
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+namespace insight {
+namespace algorithm {
+namespace retrieval {
+
+struct HnswParams {
+  int M = 16;                 ///< 上层每节点最大邻居数（第 0 层为 2M）
+  int ef_construction = 200;  ///< 插入时的候选队列长度
+  int ef_search = 128;        ///< 查询时的默认候选队列长度（实际取 max(ef, k)）
+  uint32_t seed = 42;         ///< 层数哈希种子
+};
+
+class HnswIndex {
+public:
+  HnswIndex() = default;
+  HnswIndex(int dim, const HnswParams& params);
+
+  /** 按顺序插入 num 个向量（vectors 行主序 num × dim，ids 为调用方 ID，如 image_id）。 */
+  static HnswIndex build(const float* vectors, const uint32_t* ids, int num, int dim,
+                         const HnswParams& params);
+
+  /**
+   * 插入一个向量，返回节点序号。id 已存在且 stamp 相同时不插入；stamp 不同时用新向量替换
+   * 该节点并重新连边。均返回已有节点序号。
+   */
+  int add(uint32_t id, const float* vector, uint64_t stamp = 0);
+
+  /**
+   * 返回最近的至多 k 个 (L2 距离, id)，按 (距离, 节点序号) 升序。ef <= 0 时用 params().ef_search。
+   */
+  std::vector<std::pair<float, uint32_t>> search(const float* query, int k, int ef = 0) const;
+
+  /** user_metadata 原样存入 metadata["user"]（如 PCA/码本指纹），load 时取回。 */
+  bool save(const std::string& path, const nlohmann::json& user_metadata = {}) const;
+  static bool load(const std::string& path, HnswIndex* index, nlohmann::json* user_metadata = nullptr);
+
+  int size() const { return static_cast<int>(ids_.size()); }
+  int dim() const { return dim_; }
+  const HnswParams& params() const { return params_; }
+  bool contains(uint32_t id) const { return id_to_node_.count(id) != 0; }
+  /** id 的来源戳；不在索引中时返回 0。 */
+  uint64_t stamp(uint32_t id) const {
+    const auto it = id_to_node_.find(id);
+    return it == id_to_node_.end() ? 0 : stamps_[static_cast<size_t>(it->second)];
+  }
+
+private:
+  using Candidate = std::pair<float, int>;  ///< (平方距离, 节点序号)
+
+  const float* node_vector(int node) const { return data_.data() + static_cast<size_t>(node) * dim_; }
+  float distance_sq(const float* a, const float* b) const;
+  int level_for(int node) const;
+  int max_links(int level) const { return level == 0 ? 2 * params_.M : params_.M; }
+  int greedy_descend(const float* query, int entry, int from_level, int to_level) const;
+  /** 在 level 层从 entry 出发的 ef 近邻搜索，结果按 (距离, 节点) 升序。 */
+  std::vector<Candidate> search_layer(const float* query, int entry, int ef, int level) const;
+  /** 启发式邻居选择：candidates 已升序，最多返回 m 个。 */
+  std::vector<int> select_neighbors(const std::vector<Candidate>& candidates, int m) const;
+  void link(int from, int to, int level);
+  /** 节点 node 的向量已替换：在各层重新搜索并选出边，再补反向边。 */
+  void relink(int node);
+
+  int dim_ = 0;
+  HnswParams params_;
+  std::vector<float> data_;
+  std::vector<uint32_t> ids_;
+  std::vector<uint64_t> stamps_;
+  std::vector<int> levels_;
+  std::vector<std::vector<std::vector<int>>> links_;  ///< links_[node][level]
+  std::unordered_map<uint32_t, int> id_to_node_;
+  int entry_point_ = -1;
+  int max_level_ = -1;
+};
+
+}  // namespace retrieval
+}  // namespace algorithm
+}  // namespace insight
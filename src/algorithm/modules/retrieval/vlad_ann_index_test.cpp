@@ -0,0 +1,198 @@
+/**
+ * @file  vlad_ann_index_test.cpp
+ * @brief Unit tests for the HNSW VLAD index: recall vs exact top-k, save/load, incremental insert,
+ *        replacement of re-extracted images.
+ *
+ * Usage
+ * ─────
+ *   ./test_vlad_ann_index
+ */
+
+#include "vlad_ann_index.h"
+#include "vlad_retrieval.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <tuple>
+#include <vector>
+
+namespace insight {
+namespace algorithm {
+namespace retrieval {
+namespace {
+
+/** Unit vectors around 40 cluster centres (PCA-whitened VLADs are similarly clumped). */
+std::vector<float> make_vectors(int n, int dim, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> dist(0.0f, 1.0f);
+  std::vector<float> centers(static_cast<size_t>(40) * dim);
+  for (auto& x : centers) x = dist(rng);
+  std::vector<float> v(static_cast<size_t>(n) * dim);
+  for (int i = 0; i < n; ++i) {
+    float* row = v.data() + static_cast<size_t>(i) * dim;
+    float norm = 0.0f;
+    for (int d = 0; d < dim; ++d) {
+      row[d] = centers[static_cast<size_t>(i % 40) * dim + d] + 0.8f * dist(rng);
+      norm += row[d] * row[d];
+    }
+    for (int d = 0; d < dim; ++d) row[d] /= std::sqrt(norm);
+  }
+  return v;
+}
+
+/** ANN top-k per row as (i, j, distance), excluding the query itself. */
+std::vector<std::tuple<int, int, float>> ann_top_k(const HnswIndex& index, const std::vector<float>& v,
+                                                   int n, int dim, int k) {
+  std::vector<std::tuple<int, int, float>> out;
+  for (int i = 0; i < n; ++i) {
+    int taken = 0;
+    for (const auto& [dist, id] : index.search(v.data() + static_cast<size_t>(i) * dim, k + 1)) {
+      if (static_cast<int>(id) == i || taken == k) continue;
+      out.push_back({i, static_cast<int>(id), dist});
+      ++taken;
+    }
+  }
+  return out;
+}
+
+int test_recall() {
+  std::cout << "[Test 1] HNSW recall@10 vs exact top-k\n";
+  const int n = 3000, dim = 64, k = 10;
+  const auto v = make_vectors(n, dim, 7);
+  std::vector<uint32_t> ids(n);
+  std::iota(ids.begin(), ids.end(), 0u);
+  const HnswIndex index = HnswIndex::build(v.data(), ids.data(), n, dim, HnswParams());
+  const double recall = recall_at_k(ann_top_k(index, v, n, dim, k), find_top_k_similar(v.data(), n, dim, k));
+  std::cout << "  recall@" << k << " = " << recall << "\n";
+  if (recall < 0.95) {
+    std::cerr << "  FAIL: recall too low (< 0.95)\n";
+    return 1;
+  }
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+int test_incremental_save_load() {
+  std::cout << "[Test 2] build(N) == build(n) + save + load + add(N-n)\n";
+  const int n = 1200, dim = 32, k = 8;
+  const auto v = make_vectors(n, dim, 11);
+  std::vector<uint32_t> ids(n);
+  for (int i = 0; i < n; ++i) ids[static_cast<size_t>(i)] = static_cast<uint32_t>(i);
+  HnswParams params;
+  params.M = 8;
+  params.ef_construction = 64;
+  const HnswIndex full = HnswIndex::build(v.data(), ids.data(), n, dim, params);
+
+  const int first = 700;
+  const HnswIndex part = HnswIndex::build(v.data(), ids.data(), first, dim, params);
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "test_vlad_ann_index.isat_ann").string();
+  if (!part.save(path, {{"fingerprint", "abc"}})) {
+    std::cerr << "  FAIL: save\n";
+    return 1;
+  }
+  HnswIndex resumed;
+  nlohmann::json user;
+  if (!HnswIndex::load(path, &resumed, &user) || user.value("fingerprint", "") != "abc" ||
+      resumed.size() != first) {
+    std::cerr << "  FAIL: load\n";
+    return 1;
+  }
+  for (int i = first; i < n; ++i) resumed.add(ids[static_cast<size_t>(i)], v.data() + static_cast<size_t>(i) * dim);
+  // Re-adding an existing id is a no-op.
+  resumed.add(ids[0], v.data() + static_cast<size_t>(5) * dim);
+  std::remove(path.c_str());
+
+  if (resumed.size() != n || ann_top_k(resumed, v, n, dim, k) != ann_top_k(full, v, n, dim, k)) {
+    std::cerr << "  FAIL: incremental index differs from one-shot build\n";
+    return 1;
+  }
+  HnswIndex bad;
+  if (HnswIndex::load(path, &bad)) {
+    std::cerr << "  FAIL: loading a missing file succeeded\n";
+    return 1;
+  }
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+int test_replace_changed_stamp() {
+  std::cout << "[Test 3] changed stamp replaces the vector; same stamp is a no-op\n";
+  const int n = 2000, dim = 32, k = 10, changed = 200;
+  auto v = make_vectors(n, dim, 13);
+  const auto fresh = make_vectors(changed, dim, 17);
+  HnswIndex index(dim, HnswParams());
+  for (int i = 0; i < n; ++i) index.add(static_cast<uint32_t>(i), v.data() + static_cast<size_t>(i) * dim, 1);
+
+  // "Re-extract" every 10th image: new vector, new stamp. Same stamp must not touch the index.
+  index.add(1u, fresh.data(), 1);
+  for (int c = 0; c < changed; ++c) {
+    const int i = c * 10;
+    std::copy(fresh.begin() + static_cast<ptrdiff_t>(c) * dim,
+              fresh.begin() + static_cast<ptrdiff_t>(c + 1) * dim,
+              v.begin() + static_cast<ptrdiff_t>(i) * dim);
+    index.add(static_cast<uint32_t>(i), v.data() + static_cast<size_t>(i) * dim, 2);
+  }
+  if (index.size() != n || index.stamp(10) != 2 || index.stamp(11) != 1 || index.stamp(n) != 0) {
+    std::cerr << "  FAIL: size or stamps after replacement\n";
+    return 1;
+  }
+  const auto self = index.search(fresh.data(), 1);  // image 0 now holds fresh row 0
+  const auto kept = index.search(v.data() + dim, 1);  // image 1 keeps its original vector
+  if (self.empty() || self[0].second != 0u || self[0].first > 1e-6f || kept.empty() ||
+      kept[0].second != 1u || kept[0].first > 1e-6f) {
+    std::cerr << "  FAIL: replaced / kept vector not found at its id\n";
+    return 1;
+  }
+  const double recall = recall_at_k(ann_top_k(index, v, n, dim, k), find_top_k_similar(v.data(), n, dim, k));
+  std::cout << "  recall@" << k << " after " << changed << " replacements = " << recall << "\n";
+  if (recall < 0.95) {
+    std::cerr << "  FAIL: recall too low (< 0.95)\n";
+    return 1;
+  }
+
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "test_vlad_ann_index_stamps.isat_ann").string();
+  HnswIndex loaded;
+  if (!index.save(path) || !HnswIndex::load(path, &loaded) || loaded.stamp(10) != 2 ||
+      loaded.stamp(11) != 1) {
+    std::remove(path.c_str());
+    std::cerr << "  FAIL: stamps not persisted\n";
+    return 1;
+  }
+  std::remove(path.c_str());
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+}  // namespace
+}  // namespace retrieval
+}  // namespace algorithm
+}  // namespace insight
+
+int main() {
+  google::InitGoogleLogging("test_vlad_ann_index");
+  FLAGS_logtostderr = 1;
+  FLAGS_minloglevel = 2;
+
+  int failures = 0;
+  failures += insight::algorithm::retrieval::test_recall();
+  failures += insight::algorithm::retrieval::test_incremental_save_load();
+  failures += insight::algorithm::retrieval::test_replace_changed_stamp();
+
+  if (failures == 0) {
+    std::cout << "\nAll tests PASSED.\n";
+    return 0;
+  }
+  std::cerr << "\n" << failures << " test(s) FAILED.\n";
+  return 1;
+}
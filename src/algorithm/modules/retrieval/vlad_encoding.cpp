@@ -1,6 +1,6 @@
 /**
  * @file  vlad_encoding.cpp
- * @brief VLAD 编码实现：k-means（OpenCV）、聚类分配、VLAD 计算与缓存。
+ * @brief VLAD 编码实现：k-means（OpenCV）、聚类分配（见 minibatch_kmeans）、VLAD 计算与缓存。
  */
 
 #include "vlad_encoding.h"
@@ -18,6 +18,7 @@
 
 #include "../../io/idc_reader.h"
 #include "../matching/match_types.h"
+#include "minibatch_kmeans.h"
 
 namespace insight {
 namespace algorithm {
@@ -73,33 +74,8 @@ std::vector<int> assign_to_clusters(const std::vector<float>& descriptors,
   int num_clusters = centroids.size() / descriptor_dim;
 
   std::vector<int> assignments(num_descriptors);
-
-// For each descriptor, find nearest centroid
-#pragma omp parallel for
-  for (int i = 0; i < num_descriptors; ++i) {
-    float min_dist = std::numeric_limits<float>::max();
-    int best_cluster = 0;
-
-    const float* desc = &descriptors[i * descriptor_dim];
-
-    for (int k = 0; k < num_clusters; ++k) {
-      const float* centroid = &centroids[k * descriptor_dim];
-
-      // Compute L2 distance
-      float dist = 0.0f;
-      for (int d = 0; d < descriptor_dim; ++d) {
-        float diff = desc[d] - centroid[d];
-        dist += diff * diff;
-      }
-
-      if (dist < min_dist) {
-        min_dist = dist;
-        best_cluster = k;
-      }
-    }
-
-    assignments[i] = best_cluster;
-  }
+  assign_nearest_centroids(descriptors.data(), num_descriptors, centroids.data(), num_clusters,
+                           descriptor_dim, assignments.data());
 
   return assignments;
 }
@@ -275,8 +251,12 @@ float compute_l2_distance(const std::vector<float>& vec1, const std::vector<floa
     return std::numeric_limits<float>::max();
   }
 
+  return compute_l2_distance(vec1.data(), vec2.data(), vec1.size());
+}
+
+float compute_l2_distance(const float* vec1, const float* vec2, size_t dim) {
   float dist = 0.0f;
-  for (size_t i = 0; i < vec1.size(); ++i) {
+  for (size_t i = 0; i < dim; ++i) {
     float diff = vec1[i] - vec2[i];
     dist += diff * diff;
   }
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -27,6 +28,8 @@ std::vector<float> encode_vlad_scale_weighted(const std::vector<float>& descript
                                               float target_scale = 4.0f, float sigma = 2.0f);
 void normalize_l2(std::vector<float>& vec);
 float compute_l2_distance(const std::vector<float>& vec1, const std::vector<float>& vec2);
+/// 与上面逐元素累加顺序相同（结果逐位一致），供连续存储的矩阵行使用。
+float compute_l2_distance(const float* vec1, const float* vec2, size_t dim);
 std::vector<float> load_vlad_cache(const std::string& cache_path);
 bool save_vlad_cache(const std::string& cache_path, const std::vector<float>& vlad_vector);
 std::vector<float> load_or_compute_vlad(const std::string& feature_file,
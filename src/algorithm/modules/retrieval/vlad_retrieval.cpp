@@ -7,10 +7,19 @@
 
 #include "pca_whitening.h"
 #include "vlad_encoding.h"
+#include "vlad_store.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <filesystem>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+#include <Eigen/Core>
 #include <glog/logging.h>
 
 namespace fs = std::filesystem;
@@ -21,51 +30,159 @@ double compute_vlad_score(double distance, double sigma) {
   return std::exp(-distance / sigma);
 }
 
-std::vector<std::tuple<int, int, float>>
-find_top_k_similar(const std::vector<std::vector<float>>& vlad_vectors, int top_k) {
-  int num_images = vlad_vectors.size();
-  std::vector<std::tuple<int, int, float>> results;
-  results.reserve(num_images * top_k);
+namespace {
 
-  for (int i = 0; i < num_images; ++i) {
-    std::vector<std::pair<float, int>> distances;
-    distances.reserve(num_images - 1);
+using RowMatrixXf = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
 
-    for (int j = 0; j < num_images; ++j) {
-      if (i == j)
-        continue;
+constexpr int kRowBlock = 64;    ///< 每个任务处理的查询行数
+constexpr int kColBlock = 1024;  ///< 每次 GEMM 的库向量列数（64×1024 距离块 256 KB）
 
-      float dist = compute_l2_distance(vlad_vectors[i], vlad_vectors[j]);
-      distances.push_back({dist, j});
-    }
+/**
+ * |‖a‖²+‖b‖²-2·fl(a·b) − d²| 与逐元素 float 累加 d² 的误差上界系数（× (‖a‖²+‖b‖²)）。
+ * 两者各不超过 γ_{dim+3}·2(‖a‖²+‖b‖²)（与求和顺序无关，GEMM 分块/FMA 均成立），取 4γ 留余量。
+ */
+double distance_error_factor(int dim) {
+  const double u = std::numeric_limits<float>::epsilon() * 0.5;
+  const double nu = (dim + 4) * u;
+  return 4.0 * nu / (1.0 - nu);
+}
 
-    // Partial sort to get top-k smallest distances
-    int k = std::min(top_k, static_cast<int>(distances.size()));
-    std::partial_sort(distances.begin(), distances.begin() + k, distances.end());
+}  // namespace
+
+std::vector<std::tuple<int, int, float>> find_top_k_similar(const float* vectors, int num_images,
+                                                            int dim, int top_k) {
+  std::vector<std::tuple<int, int, float>> results;
+  const int k = std::min(top_k, num_images - 1);
+  if (k <= 0 || dim <= 0) {
+    return results;
+  }
+
+  // 1) GEMM 展开的平方距离只用于筛选候选：每行维护 k 个最小近似距离的大顶堆，
+  //    并保留近似距离不超过 堆顶 + 2E 的列（堆顶单调下降，最终再按确定阈值过滤）。
+  // 2) 候选用与旧实现相同的逐元素累加重新计算距离，按 (distance, j) 排序取前 k，
+  //    因此结果（含并列时的次序）与逐对暴力计算逐位一致；误差界见 distance_error_factor。
+  Eigen::Map<const RowMatrixXf> X(vectors, num_images, dim);
+  std::vector<double> sq_norm(static_cast<size_t>(num_images));
+  for (int i = 0; i < num_images; ++i) {
+    double s = 0.0;
+    for (int d = 0; d < dim; ++d) {
+      const double v = vectors[static_cast<size_t>(i) * dim + d];
+      s += v * v;
+    }
+    sq_norm[static_cast<size_t>(i)] = s;
+  }
+  const double max_sq_norm = *std::max_element(sq_norm.begin(), sq_norm.end());
+  const double err_factor = distance_error_factor(dim);
+
+  const int num_row_blocks = (num_images + kRowBlock - 1) / kRowBlock;
+  std::vector<std::vector<std::pair<float, int>>> row_top(static_cast<size_t>(num_images));
+
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int rb = 0; rb < num_row_blocks; ++rb) {
+    const int r0 = rb * kRowBlock;
+    const int rows = std::min(kRowBlock, num_images - r0);
+    std::vector<std::vector<std::pair<double, int>>> heap(static_cast<size_t>(rows));
+    std::vector<std::vector<std::pair<double, int>>> cand(static_cast<size_t>(rows));
+    std::vector<double> margin(static_cast<size_t>(rows));
+    for (int r = 0; r < rows; ++r) {
+      heap[static_cast<size_t>(r)].reserve(static_cast<size_t>(k));
+      margin[static_cast<size_t>(r)] =
+          2.0 * err_factor * (sq_norm[static_cast<size_t>(r0 + r)] + max_sq_norm);
+    }
+    RowMatrixXf dots(rows, kColBlock);
+
+    for (int c0 = 0; c0 < num_images; c0 += kColBlock) {
+      const int cols = std::min(kColBlock, num_images - c0);
+      dots.leftCols(cols).noalias() = X.middleRows(r0, rows) * X.middleRows(c0, cols).transpose();
+      for (int r = 0; r < rows; ++r) {
+        const int i = r0 + r;
+        auto& h = heap[static_cast<size_t>(r)];
+        auto& c = cand[static_cast<size_t>(r)];
+        for (int t = 0; t < cols; ++t) {
+          const int j = c0 + t;
+          if (j == i) continue;
+          const double approx = sq_norm[static_cast<size_t>(i)] + sq_norm[static_cast<size_t>(j)] -
+                                2.0 * static_cast<double>(dots(r, t));
+          if (static_cast<int>(h.size()) < k) {
+            h.emplace_back(approx, j);
+            std::push_heap(h.begin(), h.end());
+          } else if (approx < h.front().first) {
+            std::pop_heap(h.begin(), h.end());
+            h.back() = {approx, j};
+            std::push_heap(h.begin(), h.end());
+          }
+          if (static_cast<int>(h.size()) < k || approx <= h.front().first + margin[static_cast<size_t>(r)]) {
+            c.emplace_back(approx, j);
+          }
+        }
+        // 候选过多时按当前阈值收缩（阈值只会变小，不会丢掉最终需要的列）
+        if (static_cast<int>(h.size()) == k && c.size() > static_cast<size_t>(4 * k + 256)) {
+          const double tau = h.front().first + margin[static_cast<size_t>(r)];
+          c.erase(std::remove_if(c.begin(), c.end(),
+                                 [tau](const std::pair<double, int>& e) { return e.first > tau; }),
+                  c.end());
+        }
+      }
+    }
 
-    // Add top-k pairs
-    for (int t = 0; t < k; ++t) {
-      results.push_back({i, distances[t].second, distances[t].first});
+    for (int r = 0; r < rows; ++r) {
+      const int i = r0 + r;
+      const double tau = heap[static_cast<size_t>(r)].front().first + margin[static_cast<size_t>(r)];
+      std::vector<std::pair<float, int>> exact;
+      exact.reserve(cand[static_cast<size_t>(r)].size());
+      for (const auto& [approx, j] : cand[static_cast<size_t>(r)]) {
+        if (approx > tau) continue;
+        exact.push_back({compute_l2_distance(vectors + static_cast<size_t>(i) * dim,
+                                             vectors + static_cast<size_t>(j) * dim,
+                                             static_cast<size_t>(dim)),
+                         j});
+      }
+      const int kk = std::min(k, static_cast<int>(exact.size()));
+      std::partial_sort(exact.begin(), exact.begin() + kk, exact.end());
+      exact.resize(static_cast<size_t>(kk));
+      row_top[static_cast<size_t>(i)] = std::move(exact);
     }
   }
 
+  results.reserve(static_cast<size_t>(num_images) * k);
+  for (int i = 0; i < num_images; ++i) {
+    for (const auto& [dist, j] : row_top[static_cast<size_t>(i)]) {
+      results.push_back({i, j, dist});
+    }
+  }
   return results;
 }
 
+std::vector<std::tuple<int, int, float>>
+find_top_k_similar(const std::vector<std::vector<float>>& vlad_vectors, int top_k) {
+  if (vlad_vectors.empty()) {
+    return {};
+  }
+  const size_t dim = vlad_vectors.front().size();
+  std::vector<float> matrix;
+  matrix.reserve(vlad_vectors.size() * dim);
+  for (const auto& v : vlad_vectors) {
+    if (v.size() != dim) {
+      LOG(ERROR) << "VLAD vector size mismatch: " << v.size() << " vs " << dim;
+      return {};
+    }
+    matrix.insert(matrix.end(), v.begin(), v.end());
+  }
+  return find_top_k_similar(matrix.data(), static_cast<int>(vlad_vectors.size()),
+                            static_cast<int>(dim), top_k);
+}
+
 // ============================================================================
-// VLAD Retrieval Strategy
+// VLAD Matrix
 // ============================================================================
 
-std::vector<ImagePair> retrieve_by_vlad(const std::vector<ImageInfo>& images,
+std::vector<float> compute_vlad_matrix(const std::vector<ImageInfo>& images,
                                        const RetrievalOptions& options,
                                        const std::vector<float>& centroids,
                                        const std::string& cache_dir, const PCAModel* pca_model,
-                                       bool scale_weighted, float target_scale, float scale_sigma) {
-  if (images.empty()) {
-    LOG(WARNING) << "No images provided for VLAD retrieval";
-    return {};
-  }
-
+                                       bool scale_weighted, float target_scale, float scale_sigma,
+                                       int* dim) {
+  *dim = 0;
   if (centroids.empty()) {
     LOG(ERROR) << "VLAD centroids not provided";
     return {};
@@ -80,57 +197,123 @@ std::vector<ImagePair> retrieve_by_vlad(const std::vector<ImageInfo>& images,
     return {};
   }
 
+  const int vlad_dim = num_clusters * descriptor_dim;
   bool use_pca = (pca_model != nullptr && pca_model->is_valid());
-  int final_dim = use_pca ? pca_model->n_components : (num_clusters * descriptor_dim);
+  int final_dim = use_pca ? pca_model->n_components : vlad_dim;
+  if (use_pca && pca_model->input_dim != vlad_dim) {
+    LOG(ERROR) << "PCA input dim " << pca_model->input_dim << " does not match VLAD dim " << vlad_dim;
+    return {};
+  }
 
-  LOG(INFO) << "VLAD retrieval: " << images.size() << " images, " << num_clusters
-            << " clusters, top-k=" << options.top_k;
+  LOG(INFO) << "VLAD encoding: " << images.size() << " images, " << num_clusters << " clusters";
   if (use_pca) {
-    LOG(INFO) << "PCA enabled: " << (num_clusters * descriptor_dim) << " -> " << final_dim
-              << " dimensions";
+    LOG(INFO) << "PCA enabled: " << vlad_dim << " -> " << final_dim << " dimensions";
   }
   if (scale_weighted) {
     LOG(INFO) << "Scale weighting enabled: target=" << target_scale << ", sigma=" << scale_sigma;
   }
 
-  // Load or compute VLAD vectors for all images
-  std::vector<std::vector<float>> vlad_vectors;
-  vlad_vectors.reserve(images.size());
+  // One contiguous row-major matrix. Rows come from the consolidated VLAD store in cache_dir
+  // (one mmap'd file) when its fingerprint and the feature file stamp match; the rest are encoded,
+  // projected in chunks via apply_pca_batch (8192-dim VLADs of all images are never resident at
+  // once) and appended to the store.
+  std::unique_ptr<VladStore> store;
+  if (!cache_dir.empty()) {
+    store = std::make_unique<VladStore>(
+        (fs::path(cache_dir) / kVladStoreFileName).string(),
+        vlad_fingerprint(centroids, pca_model, scale_weighted, target_scale, scale_sigma), final_dim);
+    store->open();
+  }
+
+  constexpr size_t kPcaChunk = 1024;
+  std::vector<float> vlad_matrix(images.size() * static_cast<size_t>(final_dim), 0.0f);
+  std::vector<float> raw_chunk;
+  std::vector<size_t> miss_rows;
+  std::vector<uint64_t> miss_stamps;
+  std::vector<char> miss_ok;
+  size_t hits = 0;
+
+  for (size_t chunk_begin = 0; chunk_begin < images.size(); chunk_begin += kPcaChunk) {
+    const size_t chunk_end = std::min(images.size(), chunk_begin + kPcaChunk);
+    raw_chunk.clear();
+    miss_rows.clear();
+    miss_stamps.clear();
+    miss_ok.clear();
+
+    for (size_t i = chunk_begin; i < chunk_end; ++i) {
+      const auto& img = images[i];
+      float* row = vlad_matrix.data() + i * static_cast<size_t>(final_dim);
+
+      const uint64_t stamp = store ? vlad_source_stamp(img.feature_file) : 0;
+      if (const float* cached = store ? store->find(img.image_id, stamp) : nullptr) {
+        std::copy(cached, cached + final_dim, row);
+        ++hits;
+        continue;
+      }
+
+      auto vlad = load_or_compute_vlad(img.feature_file, "", centroids, num_clusters, false,
+                                       scale_weighted, target_scale, scale_sigma);
 
-  for (size_t i = 0; i < images.size(); ++i) {
-    const auto& img = images[i];
+      bool ok = true;
+      if (vlad.empty()) {
+        LOG(WARNING) << "Failed to compute VLAD for " << img.image_id;
+        vlad.resize(vlad_dim, 0.0f);
+        ok = false;
+      }
+      if (vlad.size() != static_cast<size_t>(vlad_dim)) {
+        LOG(WARNING) << "VLAD size mismatch for " << img.image_id << ": " << vlad.size() << " vs "
+                     << vlad_dim;
+        vlad.resize(vlad_dim, 0.0f);
+        ok = false;
+      }
 
-    // Determine cache file path: {image_id}.isat_vlad
-    std::string cache_file;
-    if (!cache_dir.empty()) {
-      fs::path cache_path = fs::path(cache_dir) / (std::to_string(img.image_id) + ".isat_vlad");
-      cache_file = cache_path.string();
+      miss_rows.push_back(i);
+      miss_stamps.push_back(stamp);
+      miss_ok.push_back(ok && stamp != 0 ? 1 : 0);
+      if (use_pca) {
+        raw_chunk.insert(raw_chunk.end(), vlad.begin(), vlad.end());
+      } else {
+        std::copy(vlad.begin(), vlad.end(), row);
+      }
     }
 
-    auto vlad = load_or_compute_vlad(img.feature_file, cache_file, centroids, num_clusters,
-                                     false, scale_weighted, target_scale, scale_sigma);
-
-    if (vlad.empty()) {
-      LOG(WARNING) << "Failed to compute VLAD for " << img.image_id;
-      vlad.resize(num_clusters * descriptor_dim, 0.0f);
+    if (use_pca && !miss_rows.empty()) {
+      const auto projected =
+          apply_pca_batch(raw_chunk, static_cast<int>(miss_rows.size()), *pca_model);
+      if (projected.size() != miss_rows.size() * static_cast<size_t>(final_dim)) {
+        LOG(WARNING) << "PCA transformation failed for images " << chunk_begin << ".." << chunk_end;
+        continue;
+      }
+      for (size_t m = 0; m < miss_rows.size(); ++m) {
+        std::copy(projected.begin() + m * final_dim, projected.begin() + (m + 1) * final_dim,
+                  vlad_matrix.begin() + miss_rows[m] * static_cast<size_t>(final_dim));
+      }
     }
 
-    if (use_pca) {
-      vlad = apply_pca(vlad, *pca_model);
-      if (vlad.empty() || vlad.size() != static_cast<size_t>(final_dim)) {
-        LOG(WARNING) << "PCA transformation failed for " << img.image_id;
-        vlad.resize(final_dim, 0.0f);
+    if (store) {
+      for (size_t m = 0; m < miss_rows.size(); ++m) {
+        if (!miss_ok[m]) continue;  // 失败结果不入库
+        store->put(images[miss_rows[m]].image_id, miss_stamps[m],
+                   vlad_matrix.data() + miss_rows[m] * static_cast<size_t>(final_dim));
       }
     }
+  }
 
-    vlad_vectors.push_back(std::move(vlad));
+  if (store) {
+    LOG(INFO) << "VLAD store: " << hits << " cached, " << (images.size() - hits) << " encoded";
+    if (!store->commit()) {
+      LOG(WARNING) << "VLAD store not updated; vectors will be re-encoded next run";
+    }
   }
 
-  LOG(INFO) << "VLAD encoding complete for " << vlad_vectors.size() << " images";
+  LOG(INFO) << "VLAD encoding complete for " << images.size() << " images";
+  *dim = final_dim;
+  return vlad_matrix;
+}
 
-  auto similar_pairs = find_top_k_similar(vlad_vectors, options.top_k);
+namespace {
 
-  // Convert to ImagePair format
+std::vector<ImagePair> to_image_pairs(const std::vector<std::tuple<int, int, float>>& similar_pairs) {
   std::vector<ImagePair> pairs;
   pairs.reserve(similar_pairs.size());
 
@@ -148,6 +331,43 @@ std::vector<ImagePair> retrieve_by_vlad(const std::vector<ImageInfo>& images,
       pairs.push_back(pair);
     }
   }
+  return pairs;
+}
+
+double elapsed_ms(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+}  // namespace
+
+// ============================================================================
+// VLAD Retrieval Strategy
+// ============================================================================
+
+std::vector<ImagePair> retrieve_by_vlad(const std::vector<ImageInfo>& images,
+                                       const RetrievalOptions& options,
+                                       const std::vector<float>& centroids,
+                                       const std::string& cache_dir, const PCAModel* pca_model,
+                                       bool scale_weighted, float target_scale, float scale_sigma) {
+  if (images.empty()) {
+    LOG(WARNING) << "No images provided for VLAD retrieval";
+    return {};
+  }
+
+  LOG(INFO) << "VLAD retrieval: " << images.size() << " images, top-k=" << options.top_k;
+  int final_dim = 0;
+  const std::vector<float> vlad_matrix =
+      compute_vlad_matrix(images, options, centroids, cache_dir, pca_model, scale_weighted,
+                          target_scale, scale_sigma, &final_dim);
+  if (final_dim == 0) {
+    return {};
+  }
+
+  auto similar_pairs = find_top_k_similar(vlad_matrix.data(), static_cast<int>(images.size()),
+                                          final_dim, options.top_k);
+
+  // Convert to ImagePair format
+  std::vector<ImagePair> pairs = to_image_pairs(similar_pairs);
 
   LOG(INFO) << "VLAD retrieval: generated " << pairs.size() << " pairs from " << images.size()
             << " images";
@@ -155,4 +375,139 @@ std::vector<ImagePair> retrieve_by_vlad(const std::vector<ImageInfo>& images,
   return pairs;
 }
 
+// ============================================================================
+// VLAD ANN Retrieval Strategy
+// ============================================================================
+
+std::vector<ImagePair> retrieve_by_vlad_ann(const std::vector<ImageInfo>& images,
+                                           const RetrievalOptions& options,
+                                           const std::vector<float>& centroids,
+                                           const VladAnnOptions& ann_options,
+                                           const std::string& cache_dir,
+                                           const PCAModel* pca_model, bool scale_weighted,
+                                           float target_scale, float scale_sigma,
+                                           VladAnnStats* stats) {
+  VladAnnStats local_stats;
+  VladAnnStats& st = stats != nullptr ? *stats : local_stats;
+  st = VladAnnStats();
+  if (images.empty()) {
+    LOG(WARNING) << "No images provided for VLAD ANN retrieval";
+    return {};
+  }
+
+  LOG(INFO) << "VLAD ANN retrieval: " << images.size() << " images, top-k=" << options.top_k
+            << ", M=" << ann_options.hnsw.M << ", ef_construction=" << ann_options.hnsw.ef_construction
+            << ", ef_search=" << ann_options.hnsw.ef_search;
+  int dim = 0;
+  const std::vector<float> vlad_matrix = compute_vlad_matrix(
+      images, options, centroids, cache_dir, pca_model, scale_weighted, target_scale, scale_sigma, &dim);
+  if (dim == 0) {
+    return {};
+  }
+  const int num_images = static_cast<int>(images.size());
+
+  // 加载已有索引（指纹、维度一致才复用），插入索引中没有的图像、替换特征文件戳变化的图像，然后写回
+  const std::string fingerprint =
+      vlad_fingerprint(centroids, pca_model, scale_weighted, target_scale, scale_sigma);
+  HnswIndex index(dim, ann_options.hnsw);
+  if (!ann_options.index_file.empty() && fs::exists(ann_options.index_file)) {
+    HnswIndex loaded;
+    nlohmann::json user;
+    if (!HnswIndex::load(ann_options.index_file, &loaded, &user)) {
+      LOG(WARNING) << "Cannot load ANN index " << ann_options.index_file << ", rebuilding";
+    } else if (loaded.dim() != dim || user.value("fingerprint", std::string()) != fingerprint) {
+      LOG(WARNING) << "ANN index " << ann_options.index_file
+                   << " was built for a different codebook/PCA model, rebuilding";
+    } else {
+      index = std::move(loaded);
+      st.loaded_from_file = true;
+    }
+  }
+  st.indexed_before = index.size();
+
+  const auto build_start = std::chrono::steady_clock::now();
+  for (int i = 0; i < num_images; ++i) {
+    const ImageInfo& img = images[static_cast<size_t>(i)];
+    const uint64_t stamp = vlad_source_stamp(img.feature_file);
+    if (index.contains(img.image_id)) {
+      if (index.stamp(img.image_id) == stamp) continue;
+      ++st.updated;
+    } else {
+      ++st.inserted;
+    }
+    index.add(img.image_id, vlad_matrix.data() + static_cast<size_t>(i) * dim, stamp);
+  }
+  st.build_ms = elapsed_ms(build_start);
+  LOG(INFO) << "ANN index: " << st.indexed_before << " existing + " << st.inserted << " inserted, "
+            << st.updated << " updated in " << static_cast<int>(st.build_ms) << " ms";
+  if (!ann_options.index_file.empty() && st.inserted + st.updated > 0) {
+    index.save(ann_options.index_file, {{"fingerprint", fingerprint}});
+  }
+
+  std::unordered_map<uint32_t, int> id_to_index;
+  id_to_index.reserve(images.size());
+  for (int i = 0; i < num_images; ++i) id_to_index.emplace(images[static_cast<size_t>(i)].image_id, i);
+  if (index.size() > num_images) {
+    LOG(WARNING) << "ANN index holds " << (index.size() - num_images)
+                 << " images not in the current list; they are skipped in results";
+  }
+
+  // 每张图查询 k+1 个（含自身），跳过自身与不在当前列表中的图像
+  const int top_k = std::max(options.top_k, 0);
+  std::vector<std::vector<std::pair<float, int>>> row_top(static_cast<size_t>(num_images));
+  const auto query_start = std::chrono::steady_clock::now();
+#pragma omp parallel for schedule(dynamic, 16)
+  for (int i = 0; i < num_images; ++i) {
+    const auto found = index.search(vlad_matrix.data() + static_cast<size_t>(i) * dim, top_k + 1,
+                                    ann_options.hnsw.ef_search);
+    auto& row = row_top[static_cast<size_t>(i)];
+    for (const auto& [dist, id] : found) {
+      auto it = id_to_index.find(id);
+      if (it == id_to_index.end() || it->second == i) continue;
+      if (static_cast<int>(row.size()) < top_k) row.push_back({dist, it->second});
+    }
+  }
+  st.query_ms = elapsed_ms(query_start);
+
+  std::vector<std::tuple<int, int, float>> similar_pairs;
+  similar_pairs.reserve(static_cast<size_t>(num_images) * top_k);
+  for (int i = 0; i < num_images; ++i) {
+    for (const auto& [dist, j] : row_top[static_cast<size_t>(i)]) similar_pairs.push_back({i, j, dist});
+  }
+
+  if (ann_options.benchmark) {
+    const auto exact_start = std::chrono::steady_clock::now();
+    const auto exact = find_top_k_similar(vlad_matrix.data(), num_images, dim, top_k);
+    st.exact_ms = elapsed_ms(exact_start);
+    st.recall = recall_at_k(similar_pairs, exact);
+    LOG(INFO) << "ANN benchmark: recall@" << top_k << "=" << st.recall << ", query "
+              << static_cast<int>(st.query_ms) << " ms vs exact " << static_cast<int>(st.exact_ms)
+              << " ms";
+  }
+
+  // method 仍为 "vlad"：二进制 pair list 的方法位只区分检索来源，不区分精确/近似
+  std::vector<ImagePair> pairs = to_image_pairs(similar_pairs);
+
+  LOG(INFO) << "VLAD ANN retrieval: generated " << pairs.size() << " pairs from " << images.size()
+            << " images";
+  return pairs;
+}
+
+double recall_at_k(const std::vector<std::tuple<int, int, float>>& approx,
+                   const std::vector<std::tuple<int, int, float>>& exact) {
+  if (exact.empty()) {
+    return 1.0;
+  }
+  std::vector<std::pair<int, int>> a, e;
+  a.reserve(approx.size());
+  e.reserve(exact.size());
+  for (const auto& [i, j, d] : approx) a.push_back({i, j});
+  for (const auto& [i, j, d] : exact) e.push_back({i, j});
+  std::sort(a.begin(), a.end());
+  std::sort(e.begin(), e.end());
+  std::vector<std::pair<int, int>> common;
+  std::set_intersection(a.begin(), a.end(), e.begin(), e.end(), std::back_inserter(common));
+  return static_cast<double>(common.size()) / static_cast<double>(e.size());
+}
+
 }  // namespace insight::algorithm::retrieval
@@ -7,8 +7,10 @@
 
 #include "pca_whitening.h"
 #include "retrieval_types.h"
+#include "vlad_ann_index.h"
 
 #include <string>
+#include <tuple>
 #include <vector>
 
 namespace insight::algorithm::retrieval {
@@ -21,6 +23,62 @@ std::vector<ImagePair> retrieve_by_vlad(const std::vector<ImageInfo>& images,
                                        bool scale_weighted = false, float target_scale = 4.0f,
                                        float scale_sigma = 2.0f);
 double compute_vlad_score(double distance, double sigma = 1.0);
+
+/**
+ * 所有图像的 VLAD 向量（有 PCA 时为 apply_pca_batch 结果）组成的 images.size() × dim 行主序矩阵；
+ * 失败返回空且 *dim = 0。retrieve_by_vlad / retrieve_by_vlad_ann 共用。
+ */
+std::vector<float> compute_vlad_matrix(const std::vector<ImageInfo>& images,
+                                       const RetrievalOptions& options,
+                                       const std::vector<float>& centroids,
+                                       const std::string& cache_dir, const PCAModel* pca_model,
+                                       bool scale_weighted, float target_scale, float scale_sigma,
+                                       int* dim);
+
+struct VladAnnOptions {
+  std::string index_file;  ///< 非空：存在则加载并增量插入新图像，有新插入时写回
+  HnswParams hnsw;
+  bool benchmark = false;  ///< 同时在同一矩阵上跑精确 top-k，统计 recall@k 与耗时
+};
+
+struct VladAnnStats {
+  bool loaded_from_file = false;
+  int indexed_before = 0;  ///< 加载时索引已有的图像数
+  int inserted = 0;        ///< 本次插入的图像数
+  int updated = 0;         ///< 特征文件戳变化、向量被替换的图像数
+  double build_ms = 0.0;
+  double query_ms = 0.0;
+  double exact_ms = -1.0;  ///< 仅 benchmark
+  double recall = -1.0;    ///< 仅 benchmark：recall@k（相对精确 top-k）
+};
+
+/**
+ * vlad-ann 策略：HNSW 近似 top-k，配对/打分方式与 retrieve_by_vlad 相同（method = "vlad"）。
+ * stats 可为空。
+ */
+std::vector<ImagePair> retrieve_by_vlad_ann(const std::vector<ImageInfo>& images,
+                                           const RetrievalOptions& options,
+                                           const std::vector<float>& centroids,
+                                           const VladAnnOptions& ann_options,
+                                           const std::string& cache_dir = "",
+                                           const PCAModel* pca_model = nullptr,
+                                           bool scale_weighted = false, float target_scale = 4.0f,
+                                           float scale_sigma = 2.0f, VladAnnStats* stats = nullptr);
+
+/** |approx ∩ exact| / |exact|，按 (i, j) 比较。 */
+double recall_at_k(const std::vector<std::tuple<int, int, float>>& approx,
+                   const std::vector<std::tuple<int, int, float>>& exact);
+
+/**
+ * 每个向量取 L2 距离最小的 top_k 个其他向量，返回 (i, j, distance)，i 升序、同一 i 内按
+ * (distance, j) 升序。vectors 为 num_images × dim 行主序连续矩阵。
+ *
+ * 分块 GEMM（‖a‖²+‖b‖²-2a·b）+ 每行有界堆筛选候选，OpenMP 按行块并行，不生成 N×N 距离矩阵；
+ * 候选再用 compute_l2_distance 精确重排，结果与逐对暴力计算逐位一致。
+ */
+std::vector<std::tuple<int, int, float>> find_top_k_similar(const float* vectors, int num_images,
+                                                            int dim, int top_k);
+/// 兼容接口：打包为连续矩阵后调用上面的重载；各向量长度必须一致。
 std::vector<std::tuple<int, int, float>>
 find_top_k_similar(const std::vector<std::vector<float>>& vlad_vectors, int top_k);
 
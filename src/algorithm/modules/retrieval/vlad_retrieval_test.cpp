@@ -0,0 +1,123 @@
+/**
+ * @file  vlad_retrieval_test.cpp
+ * @brief Unit tests for the blocked VLAD top-k search (must equal brute-force output exactly).
+ *
+ * Usage
+ * ─────
+ *   ./test_vlad_retrieval
+ */
+
+#include "vlad_encoding.h"
+#include "vlad_retrieval.h"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace insight {
+namespace algorithm {
+namespace retrieval {
+namespace {
+
+/** The original O(N²) implementation: per-pair compute_l2_distance + partial_sort of (dist, j). */
+std::vector<std::tuple<int, int, float>> brute_force_top_k(const std::vector<std::vector<float>>& v,
+                                                           int top_k) {
+  const int n = static_cast<int>(v.size());
+  std::vector<std::tuple<int, int, float>> out;
+  for (int i = 0; i < n; ++i) {
+    std::vector<std::pair<float, int>> d;
+    for (int j = 0; j < n; ++j) {
+      if (i != j) d.push_back({compute_l2_distance(v[i], v[j]), j});
+    }
+    const int k = std::min(top_k, static_cast<int>(d.size()));
+    std::partial_sort(d.begin(), d.begin() + k, d.end());
+    for (int t = 0; t < k; ++t) out.push_back({i, d[t].second, d[t].first});
+  }
+  return out;
+}
+
+/** Clustered vectors (many near ties) plus exact duplicates (exact ties). */
+std::vector<std::vector<float>> make_vectors(int n, int dim, bool normalize, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<float> dist(0.0f, 1.0f);
+  std::vector<std::vector<float>> centers(8, std::vector<float>(static_cast<size_t>(dim)));
+  for (auto& c : centers)
+    for (auto& x : c) x = dist(rng);
+  std::vector<std::vector<float>> v(static_cast<size_t>(n));
+  for (int i = 0; i < n; ++i) {
+    if (i % 17 == 5) {
+      v[static_cast<size_t>(i)] = v[static_cast<size_t>(i - 1)];
+      continue;
+    }
+    v[static_cast<size_t>(i)] = centers[static_cast<size_t>(i % 8)];
+    for (auto& x : v[static_cast<size_t>(i)]) x += 0.05f * dist(rng);
+    if (normalize) normalize_l2(v[static_cast<size_t>(i)]);
+  }
+  return v;
+}
+
+int test_matches_brute_force() {
+  std::cout << "[Test 1] Blocked top-k equals brute force (ties, partial tiles)\n";
+  struct Case {
+    int n, dim, top_k;
+    bool normalize;
+  };
+  // 1500 images span two column tiles and a partial row block; 8192-dim matches raw VLAD.
+  for (const Case& c : {Case{1500, 256, 20, true}, Case{130, 8192, 10, true},
+                        Case{300, 64, 25, false}}) {
+    const auto v = make_vectors(c.n, c.dim, c.normalize, static_cast<uint32_t>(c.n + c.dim));
+    const auto expected = brute_force_top_k(v, c.top_k);
+    const auto got = find_top_k_similar(v, c.top_k);
+    std::cout << "  n=" << c.n << " dim=" << c.dim << " k=" << c.top_k << " pairs=" << got.size()
+              << "\n";
+    if (got != expected) {
+      std::cerr << "  FAIL: result differs from brute force\n";
+      return 1;
+    }
+  }
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+int test_edge_cases() {
+  std::cout << "[Test 2] top_k >= N, single image, top_k = 0\n";
+  const auto v = make_vectors(9, 32, true, 3);
+  if (find_top_k_similar(v, 50) != brute_force_top_k(v, 50) || find_top_k_similar(v, 50).size() != 72) {
+    std::cerr << "  FAIL: top_k larger than N-1\n";
+    return 1;
+  }
+  if (!find_top_k_similar({v[0]}, 5).empty() || !find_top_k_similar(v, 0).empty()) {
+    std::cerr << "  FAIL: expected empty result\n";
+    return 1;
+  }
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+}  // namespace
+}  // namespace retrieval
+}  // namespace algorithm
+}  // namespace insight
+
+int main() {
+  google::InitGoogleLogging("test_vlad_retrieval");
+  FLAGS_logtostderr = 1;
+  FLAGS_minloglevel = 2;
+
+  int failures = 0;
+  failures += insight::algorithm::retrieval::test_matches_brute_force();
+  failures += insight::algorithm::retrieval::test_edge_cases();
+
+  if (failures == 0) {
+    std::cout << "\nAll tests PASSED.\n";
+    return 0;
+  }
+  std::cerr << "\n" << failures << " test(s) FAILED.\n";
+  return 1;
+}
@@ -0,0 +1,213 @@
+/**
+ * @file  vlad_store.cpp
+ * @brief VladStore 实现（IDC mmap 读取、暂存、原子写回）与指纹/文件戳。
+ */
+
+#include "vlad_store.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+
+#include <glog/logging.h>
+
+#include "../../io/idc_reader.h"
+#include "../../io/idc_writer.h"
+
+namespace fs = std::filesystem;
+
+namespace insight {
+namespace algorithm {
+namespace retrieval {
+
+namespace {
+
+constexpr int kFormatVersion = 1;
+
+struct Fnv1a {
+  uint64_t h = 1469598103934665603ull;
+  void mix(const void* data, size_t bytes) {
+    const auto* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < bytes; ++i) {
+      h = (h ^ p[i]) * 1099511628211ull;
+    }
+  }
+};
+
+}  // namespace
+
+std::string vlad_fingerprint(const std::vector<float>& centroids, const PCAModel* pca_model,
+                             bool scale_weighted, float target_scale, float scale_sigma) {
+  Fnv1a f;
+  f.mix(centroids.data(), centroids.size() * sizeof(float));
+  if (pca_model != nullptr && pca_model->is_valid()) {
+    f.mix(pca_model->mean.data(), static_cast<size_t>(pca_model->mean.size()) * sizeof(float));
+    f.mix(pca_model->components.data(),
+          static_cast<size_t>(pca_model->components.size()) * sizeof(float));
+    if (pca_model->whiten) {
+      f.mix(pca_model->explained_variance.data(),
+            static_cast<size_t>(pca_model->explained_variance.size()) * sizeof(float));
+    }
+    const int flags[2] = {pca_model->n_components, pca_model->whiten ? 1 : 0};
+    f.mix(flags, sizeof(flags));
+  }
+  const float scale_params[3] = {scale_weighted ? 1.0f : 0.0f, target_scale, scale_sigma};
+  f.mix(scale_params, sizeof(scale_params));
+  char buf[17];
+  std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(f.h));
+  return buf;
+}
+
+uint64_t vlad_source_stamp(const std::string& feature_file) {
+  std::error_code ec;
+  const auto size = fs::file_size(feature_file, ec);
+  if (ec) return 0;
+  const auto mtime = fs::last_write_time(feature_file, ec);
+  if (ec) return 0;
+  const int64_t ticks = mtime.time_since_epoch().count();
+  Fnv1a f;
+  const uint64_t fields[2] = {static_cast<uint64_t>(size), static_cast<uint64_t>(ticks)};
+  f.mix(fields, sizeof(fields));
+  return f.h == 0 ? 1 : f.h;
+}
+
+VladStore::VladStore(std::string path, std::string fingerprint, int dim)
+    : path_(std::move(path)), fingerprint_(std::move(fingerprint)), dim_(dim) {}
+
+VladStore::~VladStore() = default;
+
+bool VladStore::open() {
+  reader_.reset();
+  mapped_vectors_ = nullptr;
+  mapped_stamps_ = nullptr;
+  mapped_index_.clear();
+  if (!fs::exists(path_)) return false;
+
+  auto reader = std::make_unique<io::IDCReader>(path_, io::IDCReadMode::kMapped);
+  if (!reader->is_valid()) return false;
+  const nlohmann::json& meta = reader->get_metadata();
+  if (meta.value("format", std::string()) != "isat_vlad_store" ||
+      meta.value("version", 0) != kFormatVersion) {
+    LOG(WARNING) << "Not a VLAD store (or unsupported version), will be replaced: " << path_;
+    return false;
+  }
+  if (meta.value("fingerprint", std::string()) != fingerprint_ || meta.value("dim", 0) != dim_) {
+    LOG(INFO) << "VLAD store " << path_ << " was built for a different codebook/PCA, will be replaced";
+    return false;
+  }
+  const size_t count = meta.value("count", static_cast<size_t>(0));
+  const auto stamps = reader->view_blob<uint64_t>("stamps");
+  const auto vectors = reader->view_blob<float>("vectors");
+  const auto keys = reader->view_blob<uint32_t>("keys");
+  if (stamps.size() != count || keys.size() != count || vectors.size() != count * dim_) {
+    LOG(WARNING) << "Corrupt VLAD store, will be replaced: " << path_;
+    return false;
+  }
+
+  mapped_index_.reserve(count);
+  for (size_t i = 0; i < count; ++i) mapped_index_[keys[i]] = i;
+  mapped_vectors_ = vectors.data();
+  mapped_stamps_ = stamps.data();
+  reader_ = std::move(reader);
+  return true;
+}
+
+const float* VladStore::find(uint32_t key, uint64_t stamp) const {
+  auto p = pending_index_.find(key);
+  if (p != pending_index_.end()) {
+    return pending_stamps_[p->second] == stamp ? pending_vectors_.data() + p->second * dim_ : nullptr;
+  }
+  auto m = mapped_index_.find(key);
+  if (m != mapped_index_.end() && mapped_stamps_[m->second] == stamp) {
+    return mapped_vectors_ + m->second * dim_;
+  }
+  return nullptr;
+}
+
+void VladStore::put(uint32_t key, uint64_t stamp, const float* vector) {
+  auto p = pending_index_.find(key);
+  if (p != pending_index_.end()) {
+    pending_stamps_[p->second] = stamp;
+    std::copy(vector, vector + dim_, pending_vectors_.begin() + p->second * dim_);
+    return;
+  }
+  pending_index_.emplace(key, pending_keys_.size());
+  pending_keys_.push_back(key);
+  pending_stamps_.push_back(stamp);
+  pending_vectors_.insert(pending_vectors_.end(), vector, vector + dim_);
+}
+
+size_t VladStore::size() const {
+  size_t n = mapped_index_.size();
+  for (uint32_t key : pending_keys_) n += mapped_index_.count(key) ? 0 : 1;
+  return n;
+}
+
+bool VladStore::commit() {
+  if (pending_keys_.empty()) return true;
+
+  // 旧行中未被替换的按原顺序保留，新行追加在后
+  std::vector<uint32_t> keys;
+  std::vector<uint64_t> stamps;
+  std::vector<float> vectors;
+  keys.reserve(size());
+  stamps.reserve(size());
+  vectors.reserve(size() * dim_);
+  if (reader_) {
+    std::vector<std::pair<size_t, uint32_t>> kept;
+    kept.reserve(mapped_index_.size());
+    for (const auto& [key, row] : mapped_index_) {
+      if (!pending_index_.count(key)) kept.push_back({row, key});
+    }
+    std::sort(kept.begin(), kept.end());
+    for (const auto& [row, key] : kept) {
+      keys.push_back(key);
+      stamps.push_back(mapped_stamps_[row]);
+      vectors.insert(vectors.end(), mapped_vectors_ + row * dim_, mapped_vectors_ + (row + 1) * dim_);
+    }
+  }
+  keys.insert(keys.end(), pending_keys_.begin(), pending_keys_.end());
+  stamps.insert(stamps.end(), pending_stamps_.begin(), pending_stamps_.end());
+  vectors.insert(vectors.end(), pending_vectors_.begin(), pending_vectors_.end());
+
+  nlohmann::json meta;
+  meta["format"] = "isat_vlad_store";
+  meta["version"] = kFormatVersion;
+  meta["fingerprint"] = fingerprint_;
+  meta["dim"] = dim_;
+  meta["count"] = keys.size();
+
+  const std::string tmp_path = path_ + ".tmp";
+  io::IDCWriter writer(tmp_path);
+  writer.set_metadata(meta);
+  const int count = static_cast<int>(keys.size());
+  writer.add_blob("stamps", stamps.data(), stamps.size() * sizeof(uint64_t), "uint64", {count});
+  writer.add_blob("vectors", vectors.data(), vectors.size() * sizeof(float), "float32", {count, dim_});
+  writer.add_blob("keys", keys.data(), keys.size() * sizeof(uint32_t), "uint32", {count});
+  if (!writer.write()) {
+    LOG(ERROR) << "Failed to write VLAD store: " << tmp_path;
+    return false;
+  }
+
+  // 先解除映射再替换（Windows 不允许覆盖已映射文件）
+  reader_.reset();
+  mapped_vectors_ = nullptr;
+  mapped_stamps_ = nullptr;
+  mapped_index_.clear();
+  std::error_code ec;
+  fs::rename(tmp_path, path_, ec);
+  if (ec) {
+    LOG(ERROR) << "Failed to replace VLAD store " << path_ << ": " << ec.message();
+    return false;
+  }
+  pending_keys_.clear();
+  pending_stamps_.clear();
+  pending_vectors_.clear();
+  pending_index_.clear();
+  return open();
+}
+
+}  // namespace retrieval
+}  // namespace algorithm
+}  // namespace insight
@@ -0,0 +1,87 @@
+/**
+ * @file  vlad_store.h
+ * @brief 单文件 VLAD 向量库：替代每图一个 .isat_vlad 缓存，mmap 读取、可追加、指纹失效。
+ *
+ * 存放 retrieve_by_vlad 实际使用的向量（有 PCA 时为 PCA 后向量），按 image_id 索引。
+ * - 整库指纹 = 码本 + PCA 模型 + 尺度加权参数（vlad_fingerprint）；指纹或维度不符时整库视为空，
+ *   下次 commit() 覆盖旧文件；
+ * - 每行带特征文件戳（大小 + 修改时间，vlad_source_stamp），特征重新提取后该行自动重算；
+ * - put() 暂存新行，commit() 把“旧行（未被替换的）+ 新行”写入临时文件后原子 rename，
+ *   并重新 mmap。读取只打开一个文件，5 万张图的热启动不再打开 5 万个小文件。
+ *
+ * 文件格式（.isat_vlads，IDC 容器）：
+ *   metadata: {"format": "isat_vlad_store", "version": 1, fingerprint, dim, count}
+ *   blobs   : stamps uint64[count]（放首位保证 8 字节对齐）, vectors float32[count, dim],
+ *             keys uint32[count]
+ */
+
+#pragma once
+
+#include "pca_whitening.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace insight {
+namespace io {
+class IDCReader;
+}
+
+namespace algorithm {
+namespace retrieval {
+
+/// cache_dir 下的向量库文件名
+inline constexpr const char* kVladStoreFileName = "vlad_store.isat_vlads";
+
+/** 码本 / PCA / 编码参数指纹（16 位十六进制）。 */
+std::string vlad_fingerprint(const std::vector<float>& centroids, const PCAModel* pca_model,
+                             bool scale_weighted, float target_scale, float scale_sigma);
+
+/** 特征文件戳（文件大小与修改时间的哈希）；文件不存在返回 0。 */
+uint64_t vlad_source_stamp(const std::string& feature_file);
+
+class VladStore {
+public:
+  VladStore(std::string path, std::string fingerprint, int dim);
+  ~VladStore();
+  VladStore(const VladStore&) = delete;
+  VladStore& operator=(const VladStore&) = delete;
+
+  /** 映射已有文件；不存在、损坏或指纹/维度不符时返回 false（库为空）。 */
+  bool open();
+
+  /** key 对应且戳一致的行（指向映射或暂存区），否则 nullptr。 */
+  const float* find(uint32_t key, uint64_t stamp) const;
+
+  /** 暂存一行（新增或替换），commit() 后落盘。 */
+  void put(uint32_t key, uint64_t stamp, const float* vector);
+
+  /** 有暂存行时写回文件；无暂存行直接返回 true。 */
+  bool commit();
+
+  int dim() const { return dim_; }
+  size_t size() const;  ///< 已映射行数 + 暂存新增行数
+  size_t pending() const { return pending_keys_.size(); }
+
+private:
+  std::string path_;
+  std::string fingerprint_;
+  int dim_ = 0;
+
+  std::unique_ptr<io::IDCReader> reader_;
+  const float* mapped_vectors_ = nullptr;
+  const uint64_t* mapped_stamps_ = nullptr;
+  std::unordered_map<uint32_t, size_t> mapped_index_;  ///< key → 映射行
+
+  std::vector<uint32_t> pending_keys_;
+  std::vector<uint64_t> pending_stamps_;
+  std::vector<float> pending_vectors_;
+  std::unordered_map<uint32_t, size_t> pending_index_;  ///< key → 暂存行
+};
+
+}  // namespace retrieval
+}  // namespace algorithm
+}  // namespace insight
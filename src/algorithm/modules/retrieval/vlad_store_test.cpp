@@ -0,0 +1,169 @@
+/**
+ * @file  vlad_store_test.cpp
+ * @brief Unit tests for the single-file VLAD vector store: round trip, append, invalidation.
+ *
+ * Usage
+ * ─────
+ *   ./test_vlad_store
+ */
+
+#include "vlad_store.h"
+
+#include <glog/logging.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+namespace insight {
+namespace algorithm {
+namespace retrieval {
+namespace {
+
+constexpr int kDim = 8;
+
+std::vector<float> row(uint32_t key) {
+  std::vector<float> v(kDim);
+  for (int d = 0; d < kDim; ++d) v[d] = static_cast<float>(key) + 0.125f * d;
+  return v;
+}
+
+bool row_equals(const float* p, uint32_t key) {
+  if (p == nullptr) return false;
+  const auto expected = row(key);
+  for (int d = 0; d < kDim; ++d) {
+    if (p[d] != expected[d]) return false;
+  }
+  return true;
+}
+
+std::string store_path() {
+  return (std::filesystem::temp_directory_path() / "test_vlad_store.isat_vlads").string();
+}
+
+int test_round_trip_and_append() {
+  std::cout << "[Test 1] put + commit + reopen, then append without losing old rows\n";
+  const std::string path = store_path();
+  std::filesystem::remove(path);
+
+  {
+    VladStore store(path, "fp-a", kDim);
+    if (store.open()) {
+      std::cerr << "  FAIL: opening a missing store succeeded\n";
+      return 1;
+    }
+    for (uint32_t k = 0; k < 5; ++k) store.put(k, 100 + k, row(k).data());
+    if (!row_equals(store.find(3, 103), 3)) {
+      std::cerr << "  FAIL: pending row not visible\n";
+      return 1;
+    }
+    if (!store.commit()) {
+      std::cerr << "  FAIL: commit\n";
+      return 1;
+    }
+  }
+
+  VladStore store(path, "fp-a", kDim);
+  if (!store.open() || store.size() != 5) {
+    std::cerr << "  FAIL: reopen (size " << store.size() << ")\n";
+    return 1;
+  }
+  for (uint32_t k = 0; k < 5; ++k) {
+    if (!row_equals(store.find(k, 100 + k), k)) {
+      std::cerr << "  FAIL: row " << k << " after reopen\n";
+      return 1;
+    }
+  }
+  if (store.find(2, 999) != nullptr) {
+    std::cerr << "  FAIL: stale stamp returned a row\n";
+    return 1;
+  }
+
+  // 追加 2 行并替换 key 1（特征文件变了）
+  store.put(5, 105, row(5).data());
+  store.put(6, 106, row(6).data());
+  store.put(1, 201, row(11).data());
+  if (!store.commit() || store.size() != 7 || store.pending() != 0) {
+    std::cerr << "  FAIL: append commit\n";
+    return 1;
+  }
+  VladStore reopened(path, "fp-a", kDim);
+  reopened.open();
+  for (uint32_t k : {0u, 2u, 3u, 4u, 5u, 6u}) {
+    if (!row_equals(reopened.find(k, 100 + k), k)) {
+      std::cerr << "  FAIL: row " << k << " after append\n";
+      return 1;
+    }
+  }
+  if (!row_equals(reopened.find(1, 201), 11) || reopened.find(1, 101) != nullptr) {
+    std::cerr << "  FAIL: replaced row\n";
+    return 1;
+  }
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+int test_fingerprint_invalidation() {
+  std::cout << "[Test 2] different fingerprint or dim invalidates the store\n";
+  const std::string path = store_path();
+  VladStore other_codebook(path, "fp-b", kDim);
+  if (other_codebook.open() || other_codebook.find(0, 100) != nullptr) {
+    std::cerr << "  FAIL: store opened under a different fingerprint\n";
+    return 1;
+  }
+  VladStore other_dim(path, "fp-a", kDim * 2);
+  if (other_dim.open()) {
+    std::cerr << "  FAIL: store opened with a different dim\n";
+    return 1;
+  }
+  // 新指纹下提交会整体覆盖旧库
+  other_codebook.put(42, 7, row(42).data());
+  if (!other_codebook.commit() || other_codebook.size() != 1) {
+    std::cerr << "  FAIL: rebuild under new fingerprint\n";
+    return 1;
+  }
+  VladStore old_fp(path, "fp-a", kDim);
+  if (old_fp.open()) {
+    std::cerr << "  FAIL: old fingerprint still valid after rebuild\n";
+    return 1;
+  }
+
+  std::vector<float> centroids(16, 0.5f);
+  const std::string fp = vlad_fingerprint(centroids, nullptr, false, 4.0f, 2.0f);
+  centroids[7] = 0.25f;
+  if (fp == vlad_fingerprint(centroids, nullptr, false, 4.0f, 2.0f) ||
+      fp == vlad_fingerprint(std::vector<float>(16, 0.5f), nullptr, true, 4.0f, 2.0f)) {
+    std::cerr << "  FAIL: fingerprint ignores codebook or scale parameters\n";
+    return 1;
+  }
+  if (vlad_source_stamp(path) == 0 || vlad_source_stamp(path + ".missing") != 0) {
+    std::cerr << "  FAIL: source stamp\n";
+    return 1;
+  }
+  std::filesystem::remove(path);
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+}  // namespace
+}  // namespace retrieval
+}  // namespace algorithm
+}  // namespace insight
+
+int main() {
+  google::InitGoogleLogging("test_vlad_store");
+  FLAGS_logtostderr = 1;
+  FLAGS_minloglevel = 2;
+
+  int failures = 0;
+  failures += insight::algorithm::retrieval::test_round_trip_and_append();
+  failures += insight::algorithm::retrieval::test_fingerprint_invalidation();
+
+  if (failures == 0) {
+    std::cout << "\nAll tests PASSED.\n";
+    return 0;
+  }
+  std::cerr << "\n" << failures << " test(s) FAILED.\n";
+  return 1;
+}
@@ -0,0 +1,1653 @@
+/**
+ * @file  ba_schur_solver.cpp
+ * @brief Native block-sparse Schur LM solver (see ba_schur_solver.h).
+ *
+ * Storage
+ * ───────
+ *  · Per observation: √ρ′-scaled residual and Jacobians (2×6 pose tangent, 2×9 intrinsics,
+ *    2×3 point) — the same 38 doubles Ceres keeps per residual block.
+ *  · Per variable point: V (3×3), V⁻¹ (damped), gradient, and one W block (d×3) per camera block
+ *    it touches ("slot"; slots of a point are sorted by camera block).
+ *  · Per camera block: undamped diagonal block U_bb, gradient and, for pose blocks, the 6×9
+ *    coupling with the intrinsics block of its camera.
+ *  · S: block-CSR over camera blocks (pose blocks first, intrinsics blocks last), both triangles
+ *    stored so the PCG matrix-vector product is row-parallel.  The sparsity pattern is fixed at
+ *    setup; each LM solve only refills the values.
+ */
+
+#include "ba_schur_solver.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Cholesky>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/LU>
+#include <glog/logging.h>
+
+namespace insight {
+namespace sfm {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point t0) {
+  return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+constexpr int kPoseDof = 6;
+constexpr int kIntrDof = kAnalyticIntrCount;
+
+// Linear solver: same budget as the Ceres ITERATIVE_SCHUR retry (configure_iterative_schur_retry).
+constexpr int kPcgMaxIterations = 500;
+constexpr double kPcgEta = 0.01;
+// Visibility clusters: at most this many pose blocks per dense preconditioner block.
+constexpr int kClusterMaxCameras = 16;
+
+// Trust-region constants: Ceres LEVENBERG_MARQUARDT defaults.
+constexpr double kInitialRadius = 1e4;
+constexpr double kMaxRadius = 1e16;
+constexpr double kMinRadius = 1e-32;
+constexpr double kMinRelativeDecrease = 1e-3;
+constexpr double kMinDiagonal = 1e-6;
+constexpr double kMaxDiagonal = 1e32;
+constexpr double kDefaultFunctionTolerance = 1e-6;
+constexpr double kDefaultGradientTolerance = 1e-10;
+constexpr double kDefaultParameterTolerance = 1e-8;
+
+template <int R, int C>
+using RowMat = Eigen::Matrix<double, R, C, (C == 1 ? Eigen::ColMajor : Eigen::RowMajor)>;
+template <int R, int C>
+using MapMat = Eigen::Map<RowMat<R, C>>;
+template <int R, int C>
+using CMapMat = Eigen::Map<const RowMat<R, C>>;
+using RowMatX = Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+/// One observation linearised at the current parameters, scaled by √ρ′ (Huber IRLS weight).
+struct ObsJacobian {
+  double r[2];
+  double J_pose[2 * kPoseDof]; ///< [dθ(3), dC(3)], row-major.
+  double J_intr[2 * kIntrDof]; ///< Masked intrinsics columns are zero.
+  double J_pt[2 * 3];
+};
+
+/// d(exp(δ)⊗q)/dδ at δ = 0 for q = [x, y, z, w]; 4×3 row-major (ceres::EigenQuaternionManifold).
+inline void quaternion_plus_jacobian(const double* q, double* P) {
+  P[0] = q[3];
+  P[1] = q[2];
+  P[2] = -q[1];
+  P[3] = -q[2];
+  P[4] = q[3];
+  P[5] = q[0];
+  P[6] = q[1];
+  P[7] = -q[0];
+  P[8] = q[3];
+  P[9] = -q[0];
+  P[10] = -q[1];
+  P[11] = -q[2];
+}
+
+/// q ← exp(δ) ⊗ q, re-normalised (ceres::EigenQuaternionManifold::Plus).
+inline void quaternion_plus(const double* delta, double* q) {
+  const double n = std::sqrt(delta[0] * delta[0] + delta[1] * delta[1] + delta[2] * delta[2]);
+  if (n <= 0.0)
+    return;
+  const double s = std::sin(n) / n;
+  const Eigen::Quaterniond dq(std::cos(n), s * delta[0], s * delta[1], s * delta[2]);
+  const Eigen::Quaterniond q0(q[3], q[0], q[1], q[2]);
+  const Eigen::Quaterniond q1 = (dq * q0).normalized();
+  q[0] = q1.x();
+  q[1] = q1.y();
+  q[2] = q1.z();
+  q[3] = q1.w();
+}
+
+const char* preconditioner_name(BAPreconditioner p) {
+  switch (p) {
+  case BAPreconditioner::kBlockJacobi:
+    return "block Jacobi";
+  case BAPreconditioner::kSchurJacobi:
+    return "Schur-Jacobi";
+  case BAPreconditioner::kClusterJacobi:
+    return "cluster Jacobi";
+  }
+  return "?";
+}
+
+/// Intrinsics bounds of an optimised block; same values as the Ceres path (global_bundle_analytic).
+void intrinsics_bounds(int total_obs, int relax_threshold, double* lo, double* hi) {
+  const bool relaxed = relax_threshold > 0 && total_obs >= relax_threshold;
+  const double k1 = relaxed ? 0.8 : 0.3;
+  const double k2 = relaxed ? 0.5 : 0.25;
+  const double k3 = relaxed ? 0.3 : 0.2;
+  lo[kSigma] = 0.95;
+  hi[kSigma] = 1.05;
+  lo[kK1] = -k1;
+  hi[kK1] = k1;
+  lo[kK2] = -k2;
+  hi[kK2] = k2;
+  lo[kK3] = -k3;
+  hi[kK3] = k3;
+  lo[kP1] = lo[kP2] = -0.05;
+  hi[kP1] = hi[kP2] = 0.05;
+}
+
+/// Camera centre of image \p i in the n × 7 pose array.
+inline Eigen::Map<const Eigen::Vector3d> pose_centre(const std::vector<double>& poses, int i) {
+  return Eigen::Map<const Eigen::Vector3d>(poses.data() + static_cast<size_t>(i) * 7 + 4);
+}
+
+struct DistancePrior {
+  int image_a = -1;
+  int image_b = -1;
+  double d0 = 1.0;
+  double scale = 0.0; ///< √w / d₀ (residual = scale · (‖C_a − C_b‖ − d₀)).
+};
+
+/// S -= T · Wᵀ for one (DB × DJ) block, T = W_b V⁻¹ (DB × 3).
+template <int DB, int DJ>
+inline void sub_schur_block(const double* T, const double* W, double* out) {
+  MapMat<DB, DJ>(out).noalias() -= CMapMat<DB, 3>(T) * CMapMat<DJ, 3>(W).transpose();
+}
+
+class NativeSchurSolver {
+public:
+  NativeSchurSolver(const BAInput& input, int num_threads)
+      : in_(input), nt_(std::max(1, num_threads)) {}
+
+  bool setup(std::vector<Eigen::Vector3d>* points);
+  bool solve(int max_iterations, NativeSchurSummary* summary);
+  void extract(BAResult* result) const;
+  int num_residuals() const { return num_residuals_; }
+
+private:
+  // ── Setup helpers ──────────────────────────────────────────────────────────
+  void build_point_slots();
+  void build_schur_pattern();
+  void build_clusters();
+
+  // ── Per-iteration ──────────────────────────────────────────────────────────
+  double evaluate_cost(const std::vector<double>& intr, const std::vector<double>& poses,
+                       const std::vector<Eigen::Vector3d>& points) const;
+  double prior_cost(const std::vector<double>& intr, const std::vector<double>& poses) const;
+  void linearize();
+  void eliminate_points(double mu);
+  void assemble_reduced_system(double mu);
+  void build_preconditioner(double mu);
+  int solve_pcg(const std::vector<double>& b, std::vector<double>* x) const;
+  void apply_preconditioner(const std::vector<double>& r, std::vector<double>* z) const;
+  void multiply_s(const std::vector<double>& x, std::vector<double>* y) const;
+  void back_substitute(const std::vector<double>& dc, std::vector<double>* dp) const;
+  double model_cost_change(const std::vector<double>& dc, const std::vector<double>& dp) const;
+  void apply_step(const std::vector<double>& dc, const std::vector<double>& dp,
+                  std::vector<double>* intr, std::vector<double>* poses,
+                  std::vector<Eigen::Vector3d>* points) const;
+
+  void damped_diag_block(int b, double mu, double* out) const;
+  void assemble_row_schur(int b, int s_begin, int s_end, double* seg, double* rhs) const;
+  template <int DB>
+  void assemble_row_schur_fixed(int b, int s_begin, int s_end, double* seg, double* rhs) const;
+  int find_col(int row, int col) const {
+    const auto begin = col_.begin() + row_begin_[static_cast<size_t>(row)];
+    const auto end = col_.begin() + row_begin_[static_cast<size_t>(row) + 1];
+    const auto it = std::lower_bound(begin, end, col);
+    return (it != end && *it == col) ? static_cast<int>(it - col_.begin()) : -1;
+  }
+  bool is_intr_block(int b) const { return b >= n_pose_blocks_; }
+  uint32_t intr_mask_of_block(int b) const {
+    return intr_mask_[static_cast<size_t>(block_owner_[static_cast<size_t>(b)])];
+  }
+
+  const BAInput& in_;
+  const int nt_;
+  int n_cams_ = 0;
+  int n_pts_ = 0;
+  int n_distinct_ = 0;
+  double huber_delta_ = 4.0;
+
+  // Parameters (layout of the Ceres path).
+  std::vector<double> intr_;  ///< n_distinct × 9: fx, sigma, cx, cy, k1, k2, k3, p1, p2.
+  std::vector<double> intr0_; ///< Values at entry (focal prior / Tikhonov anchors).
+  std::vector<double> poses_; ///< n_cams × 7: qx, qy, qz, qw, Cx, Cy, Cz.
+  std::vector<double> poses0_;
+  std::vector<Eigen::Vector3d>* points_ = nullptr;
+  std::vector<double> lower_, upper_; ///< n_distinct × 9 intrinsics bounds.
+  std::vector<uint32_t> intr_mask_;   ///< Per camera; kFixIntrAll when not optimised.
+  std::vector<double> focal_prior_sqrt_w_; ///< Per camera; 0 = no prior residual.
+  std::vector<bool> pose_tikhonov_, intr_tikhonov_;
+  std::vector<DistancePrior> distance_priors_;
+  int num_residuals_ = 0;
+
+  // Observations (valid only), sorted by point.
+  std::vector<int> obs_image_, obs_point_, obs_cam_;
+  std::vector<double> obs_uv_;
+  std::vector<int> pt_obs_begin_;    ///< n_pts + 1.
+  std::vector<int> image_obs_begin_; ///< n_cams + 1, into image_obs_.
+  std::vector<int> image_obs_;
+
+  // Camera blocks: [0, n_pose_blocks) poses, then intrinsics.
+  std::vector<int> pose_block_; ///< Per image; −1 = fixed / unused.
+  std::vector<int> intr_block_; ///< Per camera; −1 = constant / unused.
+  std::vector<int> block_owner_; ///< Image (pose block) or camera (intrinsics block).
+  std::vector<int> block_dim_, block_offset_;
+  int n_pose_blocks_ = 0;
+  int n_blocks_ = 0;
+  int n_cam_dof_ = 0;
+
+  // Points.
+  std::vector<bool> point_var_;
+  std::vector<int> pt_slot_begin_; ///< n_pts + 1 (empty range for non-variable points).
+  std::vector<int> slot_block_, slot_point_;
+  std::vector<size_t> slot_w_offset_;
+  std::vector<int> obs_pose_slot_, obs_intr_slot_;
+  std::vector<int> blk_slot_begin_, blk_slots_; ///< Camera block → slots (ascending point).
+
+  // Reduced camera system pattern.
+  std::vector<int> row_begin_, col_, diag_k_;
+  std::vector<size_t> val_off_;
+  std::vector<double> s_val_;
+  std::vector<double> rhs_;
+  std::vector<int> heavy_rows_, light_rows_;
+
+  // Preconditioner: dense factorised groups of camera blocks.
+  std::vector<std::vector<int>> clusters_;
+  std::vector<Eigen::LDLT<Eigen::MatrixXd>> precond_;
+
+  // Linearisation.
+  std::vector<ObsJacobian> lin_;
+  std::vector<double> pt_V_, pt_Vinv_, pt_g_; ///< 9 / 9 / 3 per point.
+  std::vector<double> slot_W_;
+  std::vector<size_t> udiag_off_;
+  std::vector<double> udiag_;  ///< Undamped diagonal camera blocks.
+  std::vector<double> upi_;    ///< Pose block × its intrinsics block, 6×9 per pose block.
+  std::vector<double> g_cam_;  ///< n_cam_dof.
+  double cost_ = 0.0;
+  double grad_max_norm_ = 0.0;
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Setup
+// ─────────────────────────────────────────────────────────────────────────────
+
+bool NativeSchurSolver::setup(std::vector<Eigen::Vector3d>* points) {
+  points_ = points;
+  n_cams_ = static_cast<int>(in_.poses_R.size());
+  n_pts_ = static_cast<int>(points->size());
+  n_distinct_ = static_cast<int>(in_.cameras.size());
+  huber_delta_ = in_.huber_loss_delta > 0.0 ? in_.huber_loss_delta : 4.0;
+
+  intr_.resize(static_cast<size_t>(n_distinct_) * kIntrDof);
+  for (int c = 0; c < n_distinct_; ++c) {
+    const auto& K = in_.cameras[static_cast<size_t>(c)];
+    double* ip = intr_.data() + static_cast<size_t>(c) * kIntrDof;
+    ip[kFx] = K.fx;
+    ip[kSigma] = (K.fx != 0.0) ? K.fy / K.fx : 1.0;
+    ip[kCx] = K.cx;
+    ip[kCy] = K.cy;
+    ip[kK1] = K.k1;
+    ip[kK2] = K.k2;
+    ip[kK3] = K.k3;
+    ip[kP1] = K.p1;
+    ip[kP2] = K.p2;
+  }
+  intr0_ = intr_;
+  poses_.resize(static_cast<size_t>(n_cams_) * 7);
+  for (int i = 0; i < n_cams_; ++i) {
+    const Eigen::Quaterniond q(in_.poses_R[static_cast<size_t>(i)]);
+    const Eigen::Vector3d& C = in_.poses_C[static_cast<size_t>(i)];
+    double* pd = poses_.data() + static_cast<size_t>(i) * 7;
+    pd[0] = q.x();
+    pd[1] = q.y();
+    pd[2] = q.z();
+    pd[3] = q.w();
+    pd[4] = C.x();
+    pd[5] = C.y();
+    pd[6] = C.z();
+  }
+  poses0_ = poses_;
+
+  // ── Valid observations, counting-sorted by point ─────────────────────────
+  std::vector<int> valid;
+  valid.reserve(in_.observations.size());
+  pt_obs_begin_.assign(static_cast<size_t>(n_pts_) + 1, 0);
+  for (size_t k = 0; k < in_.observations.size(); ++k) {
+    const auto& obs = in_.observations[k];
+    if (obs.image_index < 0 || obs.image_index >= n_cams_ || obs.point_index < 0 ||
+        obs.point_index >= n_pts_)
+      continue;
+    const int cam = in_.image_camera_index[static_cast<size_t>(obs.image_index)];
+    if (cam < 0 || cam >= n_distinct_)
+      continue;
+    valid.push_back(static_cast<int>(k));
+    ++pt_obs_begin_[static_cast<size_t>(obs.point_index) + 1];
+  }
+  if (valid.empty())
+    return false;
+  for (int p = 0; p < n_pts_; ++p)
+    pt_obs_begin_[static_cast<size_t>(p) + 1] += pt_obs_begin_[static_cast<size_t>(p)];
+  const size_t n_obs = valid.size();
+  obs_image_.resize(n_obs);
+  obs_point_.resize(n_obs);
+  obs_cam_.resize(n_obs);
+  obs_uv_.resize(2 * n_obs);
+  {
+    std::vector<int> fill(pt_obs_begin_.begin(), pt_obs_begin_.end() - 1);
+    for (int k : valid) {
+      const auto& obs = in_.observations[static_cast<size_t>(k)];
+      const size_t o = static_cast<size_t>(fill[static_cast<size_t>(obs.point_index)]++);
+      obs_image_[o] = obs.image_index;
+      obs_point_[o] = obs.point_index;
+      obs_cam_[o] = in_.image_camera_index[static_cast<size_t>(obs.image_index)];
+      obs_uv_[2 * o] = obs.u;
+      obs_uv_[2 * o + 1] = obs.v;
+    }
+  }
+  image_obs_begin_.assign(static_cast<size_t>(n_cams_) + 1, 0);
+  for (size_t o = 0; o < n_obs; ++o)
+    ++image_obs_begin_[static_cast<size_t>(obs_image_[o]) + 1];
+  for (int i = 0; i < n_cams_; ++i)
+    image_obs_begin_[static_cast<size_t>(i) + 1] += image_obs_begin_[static_cast<size_t>(i)];
+  image_obs_.resize(n_obs);
+  {
+    std::vector<int> fill(image_obs_begin_.begin(), image_obs_begin_.end() - 1);
+    for (size_t o = 0; o < n_obs; ++o)
+      image_obs_[static_cast<size_t>(fill[static_cast<size_t>(obs_image_[o])]++)] =
+          static_cast<int>(o);
+  }
+
+  // ── Fixed / variable blocks (same rules as the Ceres path) ───────────────
+  std::vector<bool> cam_used(static_cast<size_t>(n_distinct_), false);
+  for (size_t o = 0; o < n_obs; ++o)
+    cam_used[static_cast<size_t>(obs_cam_[o])] = true;
+  bool any_pose_fixed = false;
+  for (int i = 0; i < n_cams_; ++i)
+    if (in_.fix_pose.size() > static_cast<size_t>(i) && in_.fix_pose[static_cast<size_t>(i)])
+      any_pose_fixed = true;
+  pose_block_.assign(static_cast<size_t>(n_cams_), -1);
+  for (int i = 0; i < n_cams_; ++i) {
+    if (image_obs_begin_[static_cast<size_t>(i) + 1] == image_obs_begin_[static_cast<size_t>(i)])
+      continue;
+    const bool fix_from_input =
+        in_.fix_pose.size() > static_cast<size_t>(i) && in_.fix_pose[static_cast<size_t>(i)];
+    if (fix_from_input || (!any_pose_fixed && i == 0))
+      continue;
+    pose_block_[static_cast<size_t>(i)] = n_pose_blocks_++;
+    block_owner_.push_back(i);
+    block_dim_.push_back(kPoseDof);
+  }
+  intr_mask_.assign(static_cast<size_t>(n_distinct_), kFixIntrAll);
+  intr_block_.assign(static_cast<size_t>(n_distinct_), -1);
+  n_blocks_ = n_pose_blocks_;
+  for (int c = 0; c < n_distinct_; ++c) {
+    if (!cam_used[static_cast<size_t>(c)] || !in_.optimize_intrinsics)
+      continue;
+    const uint32_t flags = (in_.fix_intrinsics_flags.size() > static_cast<size_t>(c))
+                               ? in_.fix_intrinsics_flags[static_cast<size_t>(c)] & kFixIntrAll
+                               : 0u;
+    intr_mask_[static_cast<size_t>(c)] = flags;
+    if (flags == kFixIntrAll)
+      continue;
+    intr_block_[static_cast<size_t>(c)] = n_blocks_++;
+    block_owner_.push_back(c);
+    block_dim_.push_back(kIntrDof);
+  }
+  block_offset_.assign(static_cast<size_t>(n_blocks_) + 1, 0);
+  udiag_off_.assign(static_cast<size_t>(n_blocks_) + 1, 0);
+  for (int b = 0; b < n_blocks_; ++b) {
+    const int d = block_dim_[static_cast<size_t>(b)];
+    block_offset_[static_cast<size_t>(b) + 1] = block_offset_[static_cast<size_t>(b)] + d;
+    udiag_off_[static_cast<size_t>(b) + 1] =
+        udiag_off_[static_cast<size_t>(b)] + static_cast<size_t>(d * d);
+  }
+  n_cam_dof_ = block_offset_[static_cast<size_t>(n_blocks_)];
+
+  point_var_.assign(static_cast<size_t>(n_pts_), false);
+  for (int p = 0; p < n_pts_; ++p) {
+    const bool has_obs =
+        pt_obs_begin_[static_cast<size_t>(p) + 1] > pt_obs_begin_[static_cast<size_t>(p)];
+    const bool fixed =
+        in_.fix_point.size() > static_cast<size_t>(p) && in_.fix_point[static_cast<size_t>(p)];
+    point_var_[static_cast<size_t>(p)] = has_obs && !fixed;
+  }
+
+  // ── Intrinsics bounds: only on optimised blocks, as in the Ceres path ────
+  lower_.assign(intr_.size(), -std::numeric_limits<double>::infinity());
+  upper_.assign(intr_.size(), std::numeric_limits<double>::infinity());
+  std::vector<int> obs_per_cam(static_cast<size_t>(n_distinct_), 0);
+  if (in_.relax_intrinsics_obs_threshold > 0 && in_.camera_total_obs.empty()) {
+    for (const auto& obs : in_.observations) {
+      if (obs.image_index < 0 || obs.image_index >= n_cams_)
+        continue;
+      const int c = in_.image_camera_index[static_cast<size_t>(obs.image_index)];
+      if (c >= 0 && c < n_distinct_)
+        ++obs_per_cam[static_cast<size_t>(c)];
+    }
+  }
+  for (int c = 0; c < n_distinct_; ++c) {
+    if (intr_block_[static_cast<size_t>(c)] < 0)
+      continue;
+    const int total_obs_c = (in_.camera_total_obs.size() > static_cast<size_t>(c))
+                                ? in_.camera_total_obs[static_cast<size_t>(c)]
+                                : obs_per_cam[static_cast<size_t>(c)];
+    intrinsics_bounds(total_obs_c, in_.relax_intrinsics_obs_threshold,
+                      lower_.data() + static_cast<size_t>(c) * kIntrDof,
+                      upper_.data() + static_cast<size_t>(c) * kIntrDof);
+  }
+
+  // ── Priors and residual count (mirrors the residual blocks of the Ceres path) ──
+  num_residuals_ = static_cast<int>(2 * n_obs);
+  focal_prior_sqrt_w_.assign(static_cast<size_t>(n_distinct_), 0.0);
+  if (in_.focal_prior_weight > 0.0) {
+    for (int c = 0; c < n_distinct_; ++c) {
+      if (!cam_used[static_cast<size_t>(c)])
+        continue;
+      const uint32_t flags = (in_.fix_intrinsics_flags.size() > static_cast<size_t>(c))
+                                 ? in_.fix_intrinsics_flags[static_cast<size_t>(c)]
+                                 : 0u;
+      if ((flags & kFixIntrFx) || intr_[static_cast<size_t>(c) * kIntrDof + kFx] <= 0.0)
+        continue;
+      focal_prior_sqrt_w_[static_cast<size_t>(c)] = std::sqrt(in_.focal_prior_weight);
+      ++num_residuals_;
+    }
+  }
+  for (const auto& dp : in_.camera_distance_priors) {
+    if (dp.weight <= 0.0 || dp.distance_m <= 1e-12)
+      continue;
+    if (dp.image_index_a < 0 || dp.image_index_a >= n_cams_ || dp.image_index_b < 0 ||
+        dp.image_index_b >= n_cams_ || dp.image_index_a == dp.image_index_b)
+      continue;
+    auto has_obs = [&](int i) {
+      return image_obs_begin_[static_cast<size_t>(i) + 1] >
+             image_obs_begin_[static_cast<size_t>(i)];
+    };
+    if (!has_obs(dp.image_index_a) || !has_obs(dp.image_index_b))
+      continue;
+    distance_priors_.push_back(
+        {dp.image_index_a, dp.image_index_b, dp.distance_m, std::sqrt(dp.weight) / dp.distance_m});
+    ++num_residuals_;
+  }
+  pose_tikhonov_.assign(static_cast<size_t>(n_cams_), false);
+  intr_tikhonov_.assign(static_cast<size_t>(n_distinct_), false);
+  if (in_.tikhonov_lambda > 0.0) {
+    if (in_.tikhonov_lambda > 0.1)
+      LOG(WARNING) << "tikhonov_lambda=" << in_.tikhonov_lambda
+                   << " is very high, may cause pose drift";
+    for (int i = 0; i < n_cams_; ++i)
+      if (pose_block_[static_cast<size_t>(i)] >= 0) {
+        pose_tikhonov_[static_cast<size_t>(i)] = true;
+        num_residuals_ += 7;
+      }
+    for (int c = 0; c < n_distinct_; ++c)
+      if (intr_block_[static_cast<size_t>(c)] >= 0) {
+        intr_tikhonov_[static_cast<size_t>(c)] = true;
+        num_residuals_ += kIntrDof;
+      }
+  }
+
+  build_point_slots();
+  build_schur_pattern();
+  if (in_.native_preconditioner == BAPreconditioner::kClusterJacobi) {
+    build_clusters();
+  } else {
+    clusters_.resize(static_cast<size_t>(n_blocks_));
+    for (int b = 0; b < n_blocks_; ++b)
+      clusters_[static_cast<size_t>(b)] = {b};
+  }
+
+  lin_.resize(n_obs);
+  pt_V_.assign(static_cast<size_t>(n_pts_) * 9, 0.0);
+  pt_Vinv_.assign(static_cast<size_t>(n_pts_) * 9, 0.0);
+  pt_g_.assign(static_cast<size_t>(n_pts_) * 3, 0.0);
+  udiag_.assign(udiag_off_[static_cast<size_t>(n_blocks_)], 0.0);
+  upi_.assign(static_cast<size_t>(n_pose_blocks_) * kPoseDof * kIntrDof, 0.0);
+  g_cam_.assign(static_cast<size_t>(n_cam_dof_), 0.0);
+  rhs_.assign(static_cast<size_t>(n_cam_dof_), 0.0);
+  return true;
+}
+
+void NativeSchurSolver::build_point_slots() {
+  const size_t n_obs = obs_image_.size();
+  obs_pose_slot_.assign(n_obs, -1);
+  obs_intr_slot_.assign(n_obs, -1);
+  pt_slot_begin_.assign(static_cast<size_t>(n_pts_) + 1, 0);
+  slot_w_offset_.assign(1, 0);
+  std::vector<int> blocks;
+  for (int p = 0; p < n_pts_; ++p) {
+    pt_slot_begin_[static_cast<size_t>(p)] = static_cast<int>(slot_block_.size());
+    if (!point_var_[static_cast<size_t>(p)])
+      continue;
+    blocks.clear();
+    const int o0 = pt_obs_begin_[static_cast<size_t>(p)];
+    const int o1 = pt_obs_begin_[static_cast<size_t>(p) + 1];
+    for (int o = o0; o < o1; ++o) {
+      const int pb = pose_block_[static_cast<size_t>(obs_image_[static_cast<size_t>(o)])];
+      const int ib = intr_block_[static_cast<size_t>(obs_cam_[static_cast<size_t>(o)])];
+      if (pb >= 0)
+        blocks.push_back(pb);
+      if (ib >= 0)
+        blocks.push_back(ib);
+    }
+    std::sort(blocks.begin(), blocks.end());
+    blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+    const int s0 = static_cast<int>(slot_block_.size());
+    for (int b : blocks) {
+      slot_block_.push_back(b);
+      slot_point_.push_back(p);
+      slot_w_offset_.push_back(slot_w_offset_.back() +
+                               static_cast<size_t>(block_dim_[static_cast<size_t>(b)]) * 3);
+    }
+    auto slot_of = [&](int b) {
+      return s0 + static_cast<int>(std::lower_bound(blocks.begin(), blocks.end(), b) -
+                                   blocks.begin());
+    };
+    for (int o = o0; o < o1; ++o) {
+      const int pb = pose_block_[static_cast<size_t>(obs_image_[static_cast<size_t>(o)])];
+      const int ib = intr_block_[static_cast<size_t>(obs_cam_[static_cast<size_t>(o)])];
+      if (pb >= 0)
+        obs_pose_slot_[static_cast<size_t>(o)] = slot_of(pb);
+      if (ib >= 0)
+        obs_intr_slot_[static_cast<size_t>(o)] = slot_of(ib);
+    }
+  }
+  pt_slot_begin_[static_cast<size_t>(n_pts_)] = static_cast<int>(slot_block_.size());
+  // Points without slots keep an empty range: make begin of non-variable points consistent.
+  for (int p = n_pts_ - 1; p >= 0; --p)
+    if (!point_var_[static_cast<size_t>(p)])
+      pt_slot_begin_[static_cast<size_t>(p)] = pt_slot_begin_[static_cast<size_t>(p) + 1];
+  slot_W_.assign(slot_w_offset_.back(), 0.0);
+
+  blk_slot_begin_.assign(static_cast<size_t>(n_blocks_) + 1, 0);
+  for (int b : slot_block_)
+    ++blk_slot_begin_[static_cast<size_t>(b) + 1];
+  for (int b = 0; b < n_blocks_; ++b)
+    blk_slot_begin_[static_cast<size_t>(b) + 1] += blk_slot_begin_[static_cast<size_t>(b)];
+  blk_slots_.resize(slot_block_.size());
+  std::vector<int> fill(blk_slot_begin_.begin(), blk_slot_begin_.end() - 1);
+  for (size_t s = 0; s < slot_block_.size(); ++s)
+    blk_slots_[static_cast<size_t>(fill[static_cast<size_t>(slot_block_[s])]++)] =
+        static_cast<int>(s);
+}
+
+void NativeSchurSolver::build_schur_pattern() {
+  // Pose blocks of each intrinsics block, and distance-prior neighbours, for the U coupling.
+  std::vector<std::vector<int>> extra(static_cast<size_t>(n_blocks_));
+  for (int i = 0; i < n_cams_; ++i) {
+    const int pb = pose_block_[static_cast<size_t>(i)];
+    if (pb < 0)
+      continue;
+    const int ib = intr_block_[static_cast<size_t>(in_.image_camera_index[static_cast<size_t>(i)])];
+    if (ib < 0)
+      continue;
+    extra[static_cast<size_t>(pb)].push_back(ib);
+    extra[static_cast<size_t>(ib)].push_back(pb);
+  }
+  for (const auto& dp : distance_priors_) {
+    const int a = pose_block_[static_cast<size_t>(dp.image_a)];
+    const int b = pose_block_[static_cast<size_t>(dp.image_b)];
+    if (a < 0 || b < 0)
+      continue;
+    extra[static_cast<size_t>(a)].push_back(b);
+    extra[static_cast<size_t>(b)].push_back(a);
+  }
+
+  std::vector<std::vector<int>> row_cols(static_cast<size_t>(n_blocks_));
+#pragma omp parallel for schedule(dynamic, 16) num_threads(nt_)
+  for (int b = 0; b < n_blocks_; ++b) {
+    std::vector<int>& cols = row_cols[static_cast<size_t>(b)];
+    cols = extra[static_cast<size_t>(b)];
+    cols.push_back(b);
+    for (int k = blk_slot_begin_[static_cast<size_t>(b)];
+         k < blk_slot_begin_[static_cast<size_t>(b) + 1]; ++k) {
+      const int p = slot_point_[static_cast<size_t>(blk_slots_[static_cast<size_t>(k)])];
+      for (int t = pt_slot_begin_[static_cast<size_t>(p)];
+           t < pt_slot_begin_[static_cast<size_t>(p) + 1]; ++t)
+        cols.push_back(slot_block_[static_cast<size_t>(t)]);
+      // Keep the temporary bounded on rows that see many points.
+      if (cols.size() > 4096) {
+        std::sort(cols.begin(), cols.end());
+        cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+      }
+    }
+    std::sort(cols.begin(), cols.end());
+    cols.erase(std::unique(cols.begin(), cols.end()), cols.end());
+  }
+
+  row_begin_.assign(static_cast<size_t>(n_blocks_) + 1, 0);
+  for (int b = 0; b < n_blocks_; ++b) {
+    const int n = static_cast<int>(row_cols[static_cast<size_t>(b)].size());
+    row_begin_[static_cast<size_t>(b) + 1] = row_begin_[static_cast<size_t>(b)] + n;
+  }
+  col_.resize(static_cast<size_t>(row_begin_[static_cast<size_t>(n_blocks_)]));
+  val_off_.resize(col_.size() + 1);
+  diag_k_.resize(static_cast<size_t>(n_blocks_));
+  size_t off = 0;
+  for (int b = 0; b < n_blocks_; ++b) {
+    const int db = block_dim_[static_cast<size_t>(b)];
+    int k = row_begin_[static_cast<size_t>(b)];
+    for (int c : row_cols[static_cast<size_t>(b)]) {
+      col_[static_cast<size_t>(k)] = c;
+      val_off_[static_cast<size_t>(k)] = off;
+      if (c == b)
+        diag_k_[static_cast<size_t>(b)] = k;
+      off += static_cast<size_t>(db * block_dim_[static_cast<size_t>(c)]);
+      ++k;
+    }
+  }
+  val_off_.back() = off;
+  s_val_.assign(off, 0.0);
+
+  // Rows touching many points (typically a shared intrinsics block) are split across threads.
+  const size_t total_slots = slot_block_.size();
+  const int heavy_min =
+      std::max<int>(4096, static_cast<int>(total_slots / static_cast<size_t>(4 * nt_)));
+  for (int b = 0; b < n_blocks_; ++b) {
+    const int n =
+        blk_slot_begin_[static_cast<size_t>(b) + 1] - blk_slot_begin_[static_cast<size_t>(b)];
+    if (nt_ > 1 && n > heavy_min)
+      heavy_rows_.push_back(b);
+    else
+      light_rows_.push_back(b);
+  }
+}
+
+void NativeSchurSolver::build_clusters() {
+  // Covisibility weight (shared variable points) between pose blocks, on the S pattern.
+  struct Edge {
+    int w, a, b;
+  };
+  std::vector<std::vector<Edge>> row_edges(static_cast<size_t>(n_pose_blocks_));
+#pragma omp parallel for schedule(dynamic, 16) num_threads(nt_)
+  for (int a = 0; a < n_pose_blocks_; ++a) {
+    const int k0 = row_begin_[static_cast<size_t>(a)];
+    std::vector<int> count(static_cast<size_t>(row_begin_[static_cast<size_t>(a) + 1] - k0), 0);
+    for (int k = blk_slot_begin_[static_cast<size_t>(a)];
+         k < blk_slot_begin_[static_cast<size_t>(a) + 1]; ++k) {
+      const int p = slot_point_[static_cast<size_t>(blk_slots_[static_cast<size_t>(k)])];
+      for (int t = pt_slot_begin_[static_cast<size_t>(p)];
+           t < pt_slot_begin_[static_cast<size_t>(p) + 1]; ++t) {
+        const int b = slot_block_[static_cast<size_t>(t)];
+        if (b <= a || b >= n_pose_blocks_)
+          continue;
+        ++count[static_cast<size_t>(find_col(a, b) - k0)];
+      }
+    }
+    for (size_t j = 0; j < count.size(); ++j)
+      if (count[j] > 0)
+        row_edges[static_cast<size_t>(a)].push_back(
+            {count[j], a, col_[static_cast<size_t>(k0) + j]});
+  }
+  std::vector<Edge> edges;
+  for (auto& re : row_edges)
+    edges.insert(edges.end(), re.begin(), re.end());
+  std::sort(edges.begin(), edges.end(), [](const Edge& x, const Edge& y) {
+    if (x.w != y.w)
+      return x.w > y.w;
+    return x.a != y.a ? x.a < y.a : x.b < y.b;
+  });
+
+  // Greedy size-capped agglomeration along the strongest covisibility edges.
+  std::vector<int> parent(static_cast<size_t>(n_pose_blocks_));
+  std::vector<int> size(static_cast<size_t>(n_pose_blocks_), 1);
+  std::iota(parent.begin(), parent.end(), 0);
+  auto find = [&](int x) {
+    while (parent[static_cast<size_t>(x)] != x) {
+      parent[static_cast<size_t>(x)] = parent[static_cast<size_t>(parent[static_cast<size_t>(x)])];
+      x = parent[static_cast<size_t>(x)];
+    }
+    return x;
+  };
+  for (const Edge& e : edges) {
+    int ra = find(e.a), rb = find(e.b);
+    if (ra == rb ||
+        size[static_cast<size_t>(ra)] + size[static_cast<size_t>(rb)] > kClusterMaxCameras)
+      continue;
+    if (ra > rb)
+      std::swap(ra, rb);
+    parent[static_cast<size_t>(rb)] = ra;
+    size[static_cast<size_t>(ra)] += size[static_cast<size_t>(rb)];
+  }
+  std::vector<int> cluster_of_root(static_cast<size_t>(n_pose_blocks_), -1);
+  for (int a = 0; a < n_pose_blocks_; ++a) {
+    const int r = find(a);
+    if (cluster_of_root[static_cast<size_t>(r)] < 0) {
+      cluster_of_root[static_cast<size_t>(r)] = static_cast<int>(clusters_.size());
+      clusters_.emplace_back();
+    }
+    clusters_[static_cast<size_t>(cluster_of_root[static_cast<size_t>(r)])].push_back(a);
+  }
+  for (int b = n_pose_blocks_; b < n_blocks_; ++b)
+    clusters_.push_back({b});
+  VLOG(1) << "native_schur_bundle: " << n_pose_blocks_ << " pose blocks in " << clusters_.size()
+          << " preconditioner clusters (incl. " << (n_blocks_ - n_pose_blocks_)
+          << " intrinsics blocks)";
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Cost and linearisation
+// ─────────────────────────────────────────────────────────────────────────────
+
+double NativeSchurSolver::prior_cost(const std::vector<double>& intr,
+                                     const std::vector<double>& poses) const {
+  double cost = 0.0;
+  for (int c = 0; c < n_distinct_; ++c) {
+    const double sw = focal_prior_sqrt_w_[static_cast<size_t>(c)];
+    if (sw > 0.0) {
+      const double r = sw * (intr[static_cast<size_t>(c) * kIntrDof + kFx] -
+                             intr0_[static_cast<size_t>(c) * kIntrDof + kFx]);
+      cost += 0.5 * r * r;
+    }
+    if (intr_tikhonov_[static_cast<size_t>(c)])
+      for (int k = 0; k < kIntrDof; ++k) {
+        const double d = intr[static_cast<size_t>(c) * kIntrDof + static_cast<size_t>(k)] -
+                         intr0_[static_cast<size_t>(c) * kIntrDof + static_cast<size_t>(k)];
+        cost += 0.5 * in_.tikhonov_lambda * d * d;
+      }
+  }
+  for (int i = 0; i < n_cams_; ++i) {
+    if (!pose_tikhonov_[static_cast<size_t>(i)])
+      continue;
+    for (int k = 0; k < 7; ++k) {
+      const double d = poses[static_cast<size_t>(i) * 7 + static_cast<size_t>(k)] -
+                       poses0_[static_cast<size_t>(i) * 7 + static_cast<size_t>(k)];
+      cost += 0.5 * in_.tikhonov_lambda * d * d;
+    }
+  }
+  for (const auto& dp : distance_priors_) {
+    const double dist = (pose_centre(poses, dp.image_a) - pose_centre(poses, dp.image_b)).norm();
+    const double r = dist < 1e-12 ? 0.0 : dp.scale * (dist - dp.d0);
+    cost += 0.5 * r * r;
+  }
+  return cost;
+}
+
+double NativeSchurSolver::evaluate_cost(const std::vector<double>& intr,
+                                        const std::vector<double>& poses,
+                                        const std::vector<Eigen::Vector3d>& points) const {
+  const int n_obs = static_cast<int>(obs_image_.size());
+  const double d = huber_delta_, d2 = d * d;
+  double cost = 0.0;
+#pragma omp parallel num_threads(nt_) reduction(+ : cost)
+  {
+    const ReprojectionCostAnalytic proj(0.0, 0.0);
+#pragma omp for schedule(static)
+    for (int o = 0; o < n_obs; ++o) {
+      const double* params[3] = {
+          intr.data() + static_cast<size_t>(obs_cam_[static_cast<size_t>(o)]) * kIntrDof,
+          poses.data() + static_cast<size_t>(obs_image_[static_cast<size_t>(o)]) * 7,
+          points[static_cast<size_t>(obs_point_[static_cast<size_t>(o)])].data()};
+      double r[2];
+      proj.Evaluate(params, r, nullptr);
+      r[0] -= obs_uv_[2 * static_cast<size_t>(o)];
+      r[1] -= obs_uv_[2 * static_cast<size_t>(o) + 1];
+      const double s = r[0] * r[0] + r[1] * r[1];
+      cost += 0.5 * (s <= d2 ? s : 2.0 * d * std::sqrt(s) - d2);
+    }
+  }
+  return cost + prior_cost(intr, poses);
+}
+
+void NativeSchurSolver::linearize() {
+  const int n_obs = static_cast<int>(obs_image_.size());
+  const double d = huber_delta_, d2 = d * d;
+  double cost = 0.0;
+
+  // ── Per-observation residuals and Jacobians ──────────────────────────────
+#pragma omp parallel num_threads(nt_) reduction(+ : cost)
+  {
+    const ReprojectionCostAnalytic proj(0.0, 0.0);
+    double J_intr[2 * kIntrDof], J_pose7[2 * 7], J_pt[6], P[12];
+    double* jac[3] = {J_intr, J_pose7, J_pt};
+#pragma omp for schedule(static)
+    for (int o = 0; o < n_obs; ++o) {
+      const int cam = obs_cam_[static_cast<size_t>(o)];
+      const size_t image = static_cast<size_t>(obs_image_[static_cast<size_t>(o)]);
+      const size_t point = static_cast<size_t>(obs_point_[static_cast<size_t>(o)]);
+      const double* pose = poses_.data() + image * 7;
+      const double* params[3] = {intr_.data() + static_cast<size_t>(cam) * kIntrDof, pose,
+                                 (*points_)[point].data()};
+      double r[2];
+      proj.Evaluate(params, r, jac);
+      r[0] -= obs_uv_[2 * static_cast<size_t>(o)];
+      r[1] -= obs_uv_[2 * static_cast<size_t>(o) + 1];
+      const double s = r[0] * r[0] + r[1] * r[1];
+      double sw = 1.0;
+      if (s <= d2) {
+        cost += 0.5 * s;
+      } else {
+        const double rs = std::sqrt(s);
+        cost += 0.5 * (2.0 * d * rs - d2);
+        sw = std::sqrt(d / rs);
+      }
+      ObsJacobian& L = lin_[static_cast<size_t>(o)];
+      L.r[0] = sw * r[0];
+      L.r[1] = sw * r[1];
+      quaternion_plus_jacobian(pose, P);
+      for (int row = 0; row < 2; ++row) {
+        const double* J7 = J_pose7 + row * 7;
+        double* J6 = L.J_pose + row * kPoseDof;
+        for (int j = 0; j < 3; ++j)
+          J6[j] = sw * (J7[0] * P[j] + J7[1] * P[3 + j] + J7[2] * P[6 + j] + J7[3] * P[9 + j]);
+        J6[3] = sw * J7[4];
+        J6[4] = sw * J7[5];
+        J6[5] = sw * J7[6];
+      }
+      const uint32_t mask = intr_mask_[static_cast<size_t>(cam)];
+      for (int k = 0; k < kIntrDof; ++k) {
+        const bool fixed = (mask >> k) & 1u;
+        L.J_intr[k] = fixed ? 0.0 : sw * J_intr[k];
+        L.J_intr[kIntrDof + k] = fixed ? 0.0 : sw * J_intr[kIntrDof + k];
+      }
+      for (int k = 0; k < 6; ++k)
+        L.J_pt[k] = sw * J_pt[k];
+    }
+  }
+
+  // ── Points: V = Σ J_pᵀJ_p, g_p = Σ J_pᵀ r, W_slot = Σ J_bᵀJ_p ──────────────
+#pragma omp parallel for schedule(dynamic, 256) num_threads(nt_)
+  for (int p = 0; p < n_pts_; ++p) {
+    if (!point_var_[static_cast<size_t>(p)])
+      continue;
+    MapMat<3, 3> V(pt_V_.data() + static_cast<size_t>(p) * 9);
+    Eigen::Map<Eigen::Vector3d> g(pt_g_.data() + static_cast<size_t>(p) * 3);
+    V.setZero();
+    g.setZero();
+    const int s0 = pt_slot_begin_[static_cast<size_t>(p)];
+    const int s1 = pt_slot_begin_[static_cast<size_t>(p) + 1];
+    std::fill(slot_W_.data() + slot_w_offset_[static_cast<size_t>(s0)],
+              slot_W_.data() + slot_w_offset_[static_cast<size_t>(s1)], 0.0);
+    const int o0 = pt_obs_begin_[static_cast<size_t>(p)];
+    const int o1 = pt_obs_begin_[static_cast<size_t>(p) + 1];
+    for (int o = o0; o < o1; ++o) {
+      const ObsJacobian& L = lin_[static_cast<size_t>(o)];
+      const CMapMat<2, 3> Jp(L.J_pt);
+      V.noalias() += Jp.transpose() * Jp;
+      g.noalias() += Jp.transpose() * Eigen::Map<const Eigen::Vector2d>(L.r);
+      const int ps = obs_pose_slot_[static_cast<size_t>(o)];
+      if (ps >= 0)
+        MapMat<kPoseDof, 3>(slot_W_.data() + slot_w_offset_[static_cast<size_t>(ps)]).noalias() +=
+            CMapMat<2, kPoseDof>(L.J_pose).transpose() * Jp;
+      const int is = obs_intr_slot_[static_cast<size_t>(o)];
+      if (is >= 0)
+        MapMat<kIntrDof, 3>(slot_W_.data() + slot_w_offset_[static_cast<size_t>(is)]).noalias() +=
+            CMapMat<2, kIntrDof>(L.J_intr).transpose() * Jp;
+    }
+  }
+
+  // ── Pose blocks: U_bb, U_b,intr, g_b ──────────────────────────────────────
+#pragma omp parallel for schedule(dynamic, 16) num_threads(nt_)
+  for (int b = 0; b < n_pose_blocks_; ++b) {
+    const int i = block_owner_[static_cast<size_t>(b)];
+    const bool has_intr =
+        intr_block_[static_cast<size_t>(in_.image_camera_index[static_cast<size_t>(i)])] >= 0;
+    MapMat<kPoseDof, kPoseDof> U(udiag_.data() + udiag_off_[static_cast<size_t>(b)]);
+    MapMat<kPoseDof, kIntrDof> Upi(upi_.data() + static_cast<size_t>(b) * kPoseDof * kIntrDof);
+    Eigen::Map<RowMat<kPoseDof, 1>> g(g_cam_.data() + block_offset_[static_cast<size_t>(b)]);
+    U.setZero();
+    Upi.setZero();
+    g.setZero();
+    for (int k = image_obs_begin_[static_cast<size_t>(i)];
+         k < image_obs_begin_[static_cast<size_t>(i) + 1]; ++k) {
+      const ObsJacobian& L = lin_[static_cast<size_t>(image_obs_[static_cast<size_t>(k)])];
+      const CMapMat<2, kPoseDof> J(L.J_pose);
+      U.noalias() += J.transpose() * J;
+      g.noalias() += J.transpose() * Eigen::Map<const Eigen::Vector2d>(L.r);
+      if (has_intr)
+        Upi.noalias() += J.transpose() * CMapMat<2, kIntrDof>(L.J_intr);
+    }
+  }
+
+  // ── Intrinsics blocks: per-thread partial sums, reduced in thread order ──
+  const int n_intr_blocks = n_blocks_ - n_pose_blocks_;
+  if (n_intr_blocks > 0) {
+    constexpr int kStride = kIntrDof * kIntrDof + kIntrDof;
+    std::vector<std::vector<double>> partial(static_cast<size_t>(nt_));
+#pragma omp parallel num_threads(nt_)
+    {
+      std::vector<double>& acc = partial[static_cast<size_t>(omp_get_thread_num())];
+      acc.assign(static_cast<size_t>(n_intr_blocks) * kStride, 0.0);
+#pragma omp for schedule(static)
+      for (int o = 0; o < n_obs; ++o) {
+        const int b = intr_block_[static_cast<size_t>(obs_cam_[static_cast<size_t>(o)])];
+        if (b < 0)
+          continue;
+        double* a = acc.data() + static_cast<size_t>(b - n_pose_blocks_) * kStride;
+        const ObsJacobian& L = lin_[static_cast<size_t>(o)];
+        const CMapMat<2, kIntrDof> J(L.J_intr);
+        MapMat<kIntrDof, kIntrDof>(a).noalias() += J.transpose() * J;
+        Eigen::Map<RowMat<kIntrDof, 1>>(a + kIntrDof * kIntrDof).noalias() +=
+            J.transpose() * Eigen::Map<const Eigen::Vector2d>(L.r);
+      }
+    }
+    for (int b = n_pose_blocks_; b < n_blocks_; ++b) {
+      double* U = udiag_.data() + udiag_off_[static_cast<size_t>(b)];
+      double* g = g_cam_.data() + block_offset_[static_cast<size_t>(b)];
+      std::fill_n(U, kIntrDof * kIntrDof, 0.0);
+      std::fill_n(g, kIntrDof, 0.0);
+      for (const auto& acc : partial) {
+        if (acc.empty())
+          continue;
+        const double* a = acc.data() + static_cast<size_t>(b - n_pose_blocks_) * kStride;
+        for (int k = 0; k < kIntrDof * kIntrDof; ++k)
+          U[k] += a[k];
+        for (int k = 0; k < kIntrDof; ++k)
+          g[k] += a[kIntrDof * kIntrDof + k];
+      }
+    }
+  }
+
+  // ── Priors: diagonal Hessian blocks and gradient ─────────────────────────
+  for (int c = 0; c < n_distinct_; ++c) {
+    const int b = intr_block_[static_cast<size_t>(c)];
+    if (b < 0)
+      continue;
+    double* U = udiag_.data() + udiag_off_[static_cast<size_t>(b)];
+    double* g = g_cam_.data() + block_offset_[static_cast<size_t>(b)];
+    const double* ip = intr_.data() + static_cast<size_t>(c) * kIntrDof;
+    const double* ip0 = intr0_.data() + static_cast<size_t>(c) * kIntrDof;
+    const double sw = focal_prior_sqrt_w_[static_cast<size_t>(c)];
+    if (sw > 0.0) {
+      U[kFx * kIntrDof + kFx] += sw * sw;
+      g[kFx] += sw * sw * (ip[kFx] - ip0[kFx]);
+    }
+    if (intr_tikhonov_[static_cast<size_t>(c)]) {
+      const uint32_t mask = intr_mask_[static_cast<size_t>(c)];
+      for (int k = 0; k < kIntrDof; ++k) {
+        if ((mask >> k) & 1u)
+          continue;
+        U[k * kIntrDof + k] += in_.tikhonov_lambda;
+        g[k] += in_.tikhonov_lambda * (ip[k] - ip0[k]);
+      }
+    }
+  }
+  for (int b = 0; b < n_pose_blocks_; ++b) {
+    const int i = block_owner_[static_cast<size_t>(b)];
+    if (!pose_tikhonov_[static_cast<size_t>(i)])
+      continue;
+    // J = √λ · [P 0; 0 I₃], PᵀP = I₃ for a unit quaternion  →  JᵀJ = λ I₆.
+    const double* pd = poses_.data() + static_cast<size_t>(i) * 7;
+    const double* pd0 = poses0_.data() + static_cast<size_t>(i) * 7;
+    double P[12];
+    quaternion_plus_jacobian(pd, P);
+    double* U = udiag_.data() + udiag_off_[static_cast<size_t>(b)];
+    double* g = g_cam_.data() + block_offset_[static_cast<size_t>(b)];
+    for (int k = 0; k < kPoseDof; ++k)
+      U[k * kPoseDof + k] += in_.tikhonov_lambda;
+    for (int j = 0; j < 3; ++j) {
+      double s = 0.0;
+      for (int m = 0; m < 4; ++m)
+        s += P[m * 3 + j] * (pd[m] - pd0[m]);
+      g[j] += in_.tikhonov_lambda * s;
+      g[3 + j] += in_.tikhonov_lambda * (pd[4 + j] - pd0[4 + j]);
+    }
+  }
+  for (const auto& dp : distance_priors_) {
+    const auto Ca = pose_centre(poses_, dp.image_a);
+    const auto Cb = pose_centre(poses_, dp.image_b);
+    const double dist = (Ca - Cb).norm();
+    if (dist < 1e-12)
+      continue;
+    const Eigen::Vector3d jn = dp.scale * (Ca - Cb) / dist; // d r / d C_a
+    const double r = dp.scale * (dist - dp.d0);
+    const Eigen::Matrix3d H = jn * jn.transpose();
+    for (int side = 0; side < 2; ++side) {
+      const int b = pose_block_[static_cast<size_t>(side == 0 ? dp.image_a : dp.image_b)];
+      if (b < 0)
+        continue;
+      MapMat<kPoseDof, kPoseDof>(udiag_.data() + udiag_off_[static_cast<size_t>(b)])
+          .block<3, 3>(3, 3) += H;
+      Eigen::Map<Eigen::Vector3d>(g_cam_.data() + block_offset_[static_cast<size_t>(b)] + 3) +=
+          (side == 0 ? 1.0 : -1.0) * r * jn;
+    }
+  }
+
+  // Masked intrinsics have no gradient (Tikhonov / focal prior are skipped for them already).
+  for (int b = n_pose_blocks_; b < n_blocks_; ++b) {
+    const uint32_t mask = intr_mask_of_block(b);
+    for (int k = 0; k < kIntrDof; ++k)
+      if ((mask >> k) & 1u)
+        g_cam_[static_cast<size_t>(block_offset_[static_cast<size_t>(b)] + k)] = 0.0;
+  }
+
+  double gmax = 0.0;
+  for (double v : g_cam_)
+    gmax = std::max(gmax, std::abs(v));
+  for (int p = 0; p < n_pts_; ++p)
+    if (point_var_[static_cast<size_t>(p)])
+      for (int k = 0; k < 3; ++k)
+        gmax = std::max(gmax, std::abs(pt_g_[static_cast<size_t>(p) * 3 + static_cast<size_t>(k)]));
+  grad_max_norm_ = gmax;
+  cost_ = cost + prior_cost(intr_, poses_);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Schur complement
+// ─────────────────────────────────────────────────────────────────────────────
+
+void NativeSchurSolver::eliminate_points(double mu) {
+#pragma omp parallel for schedule(static) num_threads(nt_)
+  for (int p = 0; p < n_pts_; ++p) {
+    if (!point_var_[static_cast<size_t>(p)])
+      continue;
+    Eigen::Matrix3d V = CMapMat<3, 3>(pt_V_.data() + static_cast<size_t>(p) * 9);
+    for (int k = 0; k < 3; ++k)
+      V(k, k) += std::min(std::max(V(k, k), kMinDiagonal), kMaxDiagonal) / mu;
+    Eigen::Matrix3d Vinv;
+    bool invertible = false;
+    double det = 0.0;
+    V.computeInverseAndDetWithCheck(Vinv, det, invertible, 1e-300);
+    MapMat<3, 3> out(pt_Vinv_.data() + static_cast<size_t>(p) * 9);
+    if (invertible && Vinv.allFinite())
+      out = Vinv;
+    else
+      out.setZero(); // degenerate point: keep it in place this step
+  }
+}
+
+void NativeSchurSolver::damped_diag_block(int b, double mu, double* out) const {
+  const int d = block_dim_[static_cast<size_t>(b)];
+  const double* U = udiag_.data() + udiag_off_[static_cast<size_t>(b)];
+  std::copy(U, U + d * d, out);
+  for (int k = 0; k < d; ++k)
+    out[k * d + k] += std::min(std::max(U[k * d + k], kMinDiagonal), kMaxDiagonal) / mu;
+  if (is_intr_block(b)) {
+    const uint32_t mask = intr_mask_of_block(b);
+    for (int k = 0; k < d; ++k) {
+      if (!((mask >> k) & 1u))
+        continue;
+      for (int j = 0; j < d; ++j)
+        out[k * d + j] = out[j * d + k] = 0.0;
+      out[k * d + k] = 1.0;
+    }
+  }
+}
+
+template <int DB>
+void NativeSchurSolver::assemble_row_schur_fixed(int b, int s_begin, int s_end, double* seg,
+                                                 double* rhs) const {
+  const int k0 = diag_k_[static_cast<size_t>(b)];
+  const int k_end = row_begin_[static_cast<size_t>(b) + 1];
+  const size_t base = val_off_[static_cast<size_t>(k0)];
+  Eigen::Map<RowMat<DB, 1>> rb(rhs);
+  RowMat<DB, 3> T;
+  for (int k = s_begin; k < s_end; ++k) {
+    const int s = blk_slots_[static_cast<size_t>(k)];
+    const int p = slot_point_[static_cast<size_t>(s)];
+    T.noalias() = CMapMat<DB, 3>(slot_W_.data() + slot_w_offset_[static_cast<size_t>(s)]) *
+                  CMapMat<3, 3>(pt_Vinv_.data() + static_cast<size_t>(p) * 9);
+    rb.noalias() +=
+        T * Eigen::Map<const Eigen::Vector3d>(pt_g_.data() + static_cast<size_t>(p) * 3);
+    int kc = k0;
+    for (int t = s; t < pt_slot_begin_[static_cast<size_t>(p) + 1]; ++t) {
+      const int j = slot_block_[static_cast<size_t>(t)];
+      while (kc < k_end && col_[static_cast<size_t>(kc)] < j)
+        ++kc;
+      double* out = seg + (val_off_[static_cast<size_t>(kc)] - base);
+      const double* W = slot_W_.data() + slot_w_offset_[static_cast<size_t>(t)];
+      if (block_dim_[static_cast<size_t>(j)] == kPoseDof)
+        sub_schur_block<DB, kPoseDof>(T.data(), W, out);
+      else
+        sub_schur_block<DB, kIntrDof>(T.data(), W, out);
+    }
+  }
+}
+
+void NativeSchurSolver::assemble_row_schur(int b, int s_begin, int s_end, double* seg,
+                                           double* rhs) const {
+  if (block_dim_[static_cast<size_t>(b)] == kPoseDof)
+    assemble_row_schur_fixed<kPoseDof>(b, s_begin, s_end, seg, rhs);
+  else
+    assemble_row_schur_fixed<kIntrDof>(b, s_begin, s_end, seg, rhs);
+}
+
+void NativeSchurSolver::assemble_reduced_system(double mu) {
+  // Upper triangle + rhs: S_bj = U_bj (+ damping on b = j) − Σ_p W_pb V_p⁻¹ W_pjᵀ (j ≥ b),
+  // rhs_b = −g_b + Σ_p W_pb V_p⁻¹ g_p.
+  auto init_row = [&](int b) {
+    const size_t base = val_off_[static_cast<size_t>(diag_k_[static_cast<size_t>(b)])];
+    const size_t end = val_off_[static_cast<size_t>(row_begin_[static_cast<size_t>(b) + 1])];
+    std::fill(s_val_.data() + base, s_val_.data() + end, 0.0);
+    damped_diag_block(b, mu, s_val_.data() + base);
+    if (!is_intr_block(b)) {
+      const int i = block_owner_[static_cast<size_t>(b)];
+      const int cam = in_.image_camera_index[static_cast<size_t>(i)];
+      const int ib = intr_block_[static_cast<size_t>(cam)];
+      if (ib >= 0)
+        std::copy_n(upi_.data() + static_cast<size_t>(b) * kPoseDof * kIntrDof, kPoseDof * kIntrDof,
+                    s_val_.data() + val_off_[static_cast<size_t>(find_col(b, ib))]);
+    }
+    const int o = block_offset_[static_cast<size_t>(b)];
+    for (int k = 0; k < block_dim_[static_cast<size_t>(b)]; ++k)
+      rhs_[static_cast<size_t>(o + k)] = -g_cam_[static_cast<size_t>(o + k)];
+  };
+
+  const int n_light = static_cast<int>(light_rows_.size());
+#pragma omp parallel for schedule(dynamic, 8) num_threads(nt_)
+  for (int r = 0; r < n_light; ++r) {
+    const int b = light_rows_[static_cast<size_t>(r)];
+    init_row(b);
+    const size_t base = val_off_[static_cast<size_t>(diag_k_[static_cast<size_t>(b)])];
+    assemble_row_schur(b, blk_slot_begin_[static_cast<size_t>(b)],
+                       blk_slot_begin_[static_cast<size_t>(b) + 1], s_val_.data() + base,
+                       rhs_.data() + block_offset_[static_cast<size_t>(b)]);
+  }
+
+  for (int b : heavy_rows_) {
+    init_row(b);
+    const size_t base = val_off_[static_cast<size_t>(diag_k_[static_cast<size_t>(b)])];
+    const size_t len = val_off_[static_cast<size_t>(row_begin_[static_cast<size_t>(b) + 1])] - base;
+    const int db = block_dim_[static_cast<size_t>(b)];
+    const int s0 = blk_slot_begin_[static_cast<size_t>(b)];
+    const int n = blk_slot_begin_[static_cast<size_t>(b) + 1] - s0;
+    std::vector<std::vector<double>> partial(static_cast<size_t>(nt_));
+#pragma omp parallel num_threads(nt_)
+    {
+      const int t = omp_get_thread_num();
+      const int nth = omp_get_num_threads();
+      std::vector<double>& buf = partial[static_cast<size_t>(t)];
+      buf.assign(len + static_cast<size_t>(db), 0.0);
+      const int lo = s0 + static_cast<int>(static_cast<long long>(n) * t / nth);
+      const int hi = s0 + static_cast<int>(static_cast<long long>(n) * (t + 1) / nth);
+      assemble_row_schur(b, lo, hi, buf.data(), buf.data() + len);
+    }
+    for (const auto& buf : partial) {
+      if (buf.empty())
+        continue;
+      for (size_t k = 0; k < len; ++k)
+        s_val_[base + k] += buf[k];
+      double* rb = rhs_.data() + block_offset_[static_cast<size_t>(b)];
+      for (int k = 0; k < db; ++k)
+        rb[k] += buf[len + static_cast<size_t>(k)];
+    }
+  }
+
+  // Distance-prior coupling between two variable poses (C part only).
+  for (const auto& dp : distance_priors_) {
+    int a = pose_block_[static_cast<size_t>(dp.image_a)];
+    int b = pose_block_[static_cast<size_t>(dp.image_b)];
+    if (a < 0 || b < 0)
+      continue;
+    const auto Ca = pose_centre(poses_, dp.image_a);
+    const auto Cb = pose_centre(poses_, dp.image_b);
+    const double dist = (Ca - Cb).norm();
+    if (dist < 1e-12)
+      continue;
+    const Eigen::Vector3d jn = dp.scale * (Ca - Cb) / dist;
+    if (a > b)
+      std::swap(a, b);
+    MapMat<kPoseDof, kPoseDof>(s_val_.data() + val_off_[static_cast<size_t>(find_col(a, b))])
+        .block<3, 3>(3, 3) -= jn * jn.transpose();
+  }
+
+  // Mirror the strict upper triangle into the lower one.
+#pragma omp parallel for schedule(dynamic, 16) num_threads(nt_)
+  for (int b = 0; b < n_blocks_; ++b) {
+    const int db = block_dim_[static_cast<size_t>(b)];
+    const int k_end = row_begin_[static_cast<size_t>(b) + 1];
+    for (int k = diag_k_[static_cast<size_t>(b)] + 1; k < k_end; ++k) {
+      const int j = col_[static_cast<size_t>(k)];
+      const int dj = block_dim_[static_cast<size_t>(j)];
+      const double* src = s_val_.data() + val_off_[static_cast<size_t>(k)];
+      double* dst = s_val_.data() + val_off_[static_cast<size_t>(find_col(j, b))];
+      for (int r = 0; r < db; ++r)
+        for (int c = 0; c < dj; ++c)
+          dst[c * db + r] = src[r * dj + c];
+    }
+  }
+}
+
+void NativeSchurSolver::build_preconditioner(double mu) {
+  precond_.resize(clusters_.size());
+  const bool from_u = in_.native_preconditioner == BAPreconditioner::kBlockJacobi;
+  const int n_clusters = static_cast<int>(clusters_.size());
+#pragma omp parallel for schedule(dynamic, 4) num_threads(nt_)
+  for (int ci = 0; ci < n_clusters; ++ci) {
+    const std::vector<int>& members = clusters_[static_cast<size_t>(ci)];
+    std::vector<int> off(members.size() + 1, 0);
+    for (size_t m = 0; m < members.size(); ++m)
+      off[m + 1] = off[m] + block_dim_[static_cast<size_t>(members[m])];
+    Eigen::MatrixXd M = Eigen::MatrixXd::Zero(off.back(), off.back());
+    for (size_t m = 0; m < members.size(); ++m) {
+      const int a = members[m];
+      const int da = block_dim_[static_cast<size_t>(a)];
+      if (from_u) {
+        RowMatX D(da, da);
+        damped_diag_block(a, mu, D.data());
+        M.block(off[m], off[m], da, da) = D;
+        continue;
+      }
+      for (size_t n = 0; n < members.size(); ++n) {
+        const int k = find_col(a, members[n]);
+        if (k < 0)
+          continue;
+        const int dn = block_dim_[static_cast<size_t>(members[n])];
+        M.block(off[m], off[n], da, dn) =
+            Eigen::Map<const RowMatX>(s_val_.data() + val_off_[static_cast<size_t>(k)], da, dn);
+      }
+    }
+    precond_[static_cast<size_t>(ci)].compute(M);
+  }
+}
+
+void NativeSchurSolver::apply_preconditioner(const std::vector<double>& r,
+                                             std::vector<double>* z) const {
+  const int n_clusters = static_cast<int>(clusters_.size());
+#pragma omp parallel for schedule(dynamic, 16) num_threads(nt_)
+  for (int ci = 0; ci < n_clusters; ++ci) {
+    const std::vector<int>& members = clusters_[static_cast<size_t>(ci)];
+    int n = 0;
+    for (int b : members)
+      n += block_dim_[static_cast<size_t>(b)];
+    Eigen::VectorXd v(n);
+    int pos = 0;
+    for (int b : members) {
+      const int d = block_dim_[static_cast<size_t>(b)];
+      v.segment(pos, d) =
+          Eigen::Map<const Eigen::VectorXd>(r.data() + block_offset_[static_cast<size_t>(b)], d);
+      pos += d;
+    }
+    v = precond_[static_cast<size_t>(ci)].solve(v);
+    pos = 0;
+    for (int b : members) {
+      const int d = block_dim_[static_cast<size_t>(b)];
+      Eigen::Map<Eigen::VectorXd>(z->data() + block_offset_[static_cast<size_t>(b)], d) =
+          v.segment(pos, d);
+      pos += d;
+    }
+  }
+}
+
+void NativeSchurSolver::multiply_s(const std::vector<double>& x, std::vector<double>* y) const {
+#pragma omp parallel for schedule(dynamic, 32) num_threads(nt_)
+  for (int b = 0; b < n_blocks_; ++b) {
+    const int db = block_dim_[static_cast<size_t>(b)];
+    Eigen::Map<Eigen::VectorXd> yb(y->data() + block_offset_[static_cast<size_t>(b)], db);
+    yb.setZero();
+    const int k_end = row_begin_[static_cast<size_t>(b) + 1];
+    for (int k = row_begin_[static_cast<size_t>(b)]; k < k_end; ++k) {
+      const int j = col_[static_cast<size_t>(k)];
+      const int dj = block_dim_[static_cast<size_t>(j)];
+      yb.noalias() +=
+          Eigen::Map<const RowMatX>(s_val_.data() + val_off_[static_cast<size_t>(k)], db, dj) *
+          Eigen::Map<const Eigen::VectorXd>(x.data() + block_offset_[static_cast<size_t>(j)], dj);
+    }
+  }
+}
+
+int NativeSchurSolver::solve_pcg(const std::vector<double>& b, std::vector<double>* x) const {
+  const int n = n_cam_dof_;
+  auto dot = [&](const std::vector<double>& u, const std::vector<double>& v) {
+    double s = 0.0;
+#pragma omp parallel for reduction(+ : s) schedule(static) num_threads(nt_)
+    for (int k = 0; k < n; ++k)
+      s += u[static_cast<size_t>(k)] * v[static_cast<size_t>(k)];
+    return s;
+  };
+  x->assign(static_cast<size_t>(n), 0.0);
+  if (n == 0)
+    return 0;
+  std::vector<double> r = b, z(static_cast<size_t>(n)), p, q(static_cast<size_t>(n));
+  const double b_norm = std::sqrt(dot(b, b));
+  if (b_norm == 0.0)
+    return 0;
+  apply_preconditioner(r, &z);
+  p = z;
+  double rz = dot(r, z);
+  int it = 0;
+  while (it < kPcgMaxIterations) {
+    ++it;
+    multiply_s(p, &q);
+    const double pq = dot(p, q);
+    if (!(pq > 0.0))
+      break; // not positive definite along p (or NaN): keep the current iterate
+    const double alpha = rz / pq;
+#pragma omp parallel for schedule(static) num_threads(nt_)
+    for (int k = 0; k < n; ++k) {
+      (*x)[static_cast<size_t>(k)] += alpha * p[static_cast<size_t>(k)];
+      r[static_cast<size_t>(k)] -= alpha * q[static_cast<size_t>(k)];
+    }
+    if (std::sqrt(dot(r, r)) <= kPcgEta * b_norm)
+      break;
+    apply_preconditioner(r, &z);
+    const double rz_new = dot(r, z);
+    const double beta = rz_new / rz;
+    rz = rz_new;
+#pragma omp parallel for schedule(static) num_threads(nt_)
+    for (int k = 0; k < n; ++k)
+      p[static_cast<size_t>(k)] = z[static_cast<size_t>(k)] + beta * p[static_cast<size_t>(k)];
+  }
+  return it;
+}
+
+void NativeSchurSolver::back_substitute(const std::vector<double>& dc,
+                                        std::vector<double>* dp) const {
+  dp->assign(static_cast<size_t>(n_pts_) * 3, 0.0);
+#pragma omp parallel for schedule(static) num_threads(nt_)
+  for (int p = 0; p < n_pts_; ++p) {
+    if (!point_var_[static_cast<size_t>(p)])
+      continue;
+    // V δp = −g_p − Σ W_sᵀ δc_s
+    Eigen::Vector3d rhs =
+        -Eigen::Map<const Eigen::Vector3d>(pt_g_.data() + static_cast<size_t>(p) * 3);
+    const int s1 = pt_slot_begin_[static_cast<size_t>(p) + 1];
+    for (int s = pt_slot_begin_[static_cast<size_t>(p)]; s < s1; ++s) {
+      const int b = slot_block_[static_cast<size_t>(s)];
+      const int d = block_dim_[static_cast<size_t>(b)];
+      rhs.noalias() -=
+          Eigen::Map<const RowMatX>(slot_W_.data() + slot_w_offset_[static_cast<size_t>(s)], d, 3)
+              .transpose() *
+          Eigen::Map<const Eigen::VectorXd>(dc.data() + block_offset_[static_cast<size_t>(b)], d);
+    }
+    Eigen::Map<Eigen::Vector3d>(dp->data() + static_cast<size_t>(p) * 3) =
+        CMapMat<3, 3>(pt_Vinv_.data() + static_cast<size_t>(p) * 9) * rhs;
+  }
+}
+
+double NativeSchurSolver::model_cost_change(const std::vector<double>& dc,
+                                            const std::vector<double>& dp) const {
+  // L(0) − L(δ) = −(gᵀδ + ½‖Jδ‖²)
+  const int n_obs = static_cast<int>(obs_image_.size());
+  double jd2 = 0.0, gd = 0.0;
+#pragma omp parallel for reduction(+ : jd2) schedule(static) num_threads(nt_)
+  for (int o = 0; o < n_obs; ++o) {
+    const ObsJacobian& L = lin_[static_cast<size_t>(o)];
+    Eigen::Vector2d jd = Eigen::Vector2d::Zero();
+    const int pb = pose_block_[static_cast<size_t>(obs_image_[static_cast<size_t>(o)])];
+    if (pb >= 0)
+      jd.noalias() +=
+          CMapMat<2, kPoseDof>(L.J_pose) *
+          Eigen::Map<const RowMat<kPoseDof, 1>>(dc.data() + block_offset_[static_cast<size_t>(pb)]);
+    const int ib = intr_block_[static_cast<size_t>(obs_cam_[static_cast<size_t>(o)])];
+    if (ib >= 0)
+      jd.noalias() +=
+          CMapMat<2, kIntrDof>(L.J_intr) *
+          Eigen::Map<const RowMat<kIntrDof, 1>>(dc.data() + block_offset_[static_cast<size_t>(ib)]);
+    const int p = obs_point_[static_cast<size_t>(o)];
+    if (point_var_[static_cast<size_t>(p)])
+      jd.noalias() += CMapMat<2, 3>(L.J_pt) *
+                      Eigen::Map<const Eigen::Vector3d>(dp.data() + static_cast<size_t>(p) * 3);
+    jd2 += jd.squaredNorm();
+  }
+  for (int c = 0; c < n_distinct_; ++c) {
+    const int b = intr_block_[static_cast<size_t>(c)];
+    if (b < 0)
+      continue;
+    const double* d = dc.data() + block_offset_[static_cast<size_t>(b)];
+    const double sw = focal_prior_sqrt_w_[static_cast<size_t>(c)];
+    if (sw > 0.0)
+      jd2 += sw * sw * d[kFx] * d[kFx];
+    if (intr_tikhonov_[static_cast<size_t>(c)])
+      for (int k = 0; k < kIntrDof; ++k)
+        jd2 += in_.tikhonov_lambda * d[k] * d[k]; // masked entries have δ = 0
+  }
+  for (int b = 0; b < n_pose_blocks_; ++b) {
+    if (!pose_tikhonov_[static_cast<size_t>(block_owner_[static_cast<size_t>(b)])])
+      continue;
+    const double* d = dc.data() + block_offset_[static_cast<size_t>(b)];
+    for (int k = 0; k < kPoseDof; ++k)
+      jd2 += in_.tikhonov_lambda * d[k] * d[k];
+  }
+  for (const auto& dpr : distance_priors_) {
+    const auto Ca = pose_centre(poses_, dpr.image_a);
+    const auto Cb = pose_centre(poses_, dpr.image_b);
+    const double dist = (Ca - Cb).norm();
+    if (dist < 1e-12)
+      continue;
+    const Eigen::Vector3d jn = dpr.scale * (Ca - Cb) / dist;
+    double v = 0.0;
+    const int a = pose_block_[static_cast<size_t>(dpr.image_a)];
+    const int b = pose_block_[static_cast<size_t>(dpr.image_b)];
+    if (a >= 0)
+      v += jn.dot(Eigen::Vector3d::Map(dc.data() + block_offset_[static_cast<size_t>(a)] + 3));
+    if (b >= 0)
+      v -= jn.dot(Eigen::Vector3d::Map(dc.data() + block_offset_[static_cast<size_t>(b)] + 3));
+    jd2 += v * v;
+  }
+  for (int k = 0; k < n_cam_dof_; ++k)
+    gd += g_cam_[static_cast<size_t>(k)] * dc[static_cast<size_t>(k)];
+  for (size_t k = 0; k < pt_g_.size(); ++k)
+    gd += pt_g_[k] * dp[k];
+  return -(gd + 0.5 * jd2);
+}
+
+void NativeSchurSolver::apply_step(const std::vector<double>& dc, const std::vector<double>& dp,
+                                   std::vector<double>* intr, std::vector<double>* poses,
+                                   std::vector<Eigen::Vector3d>* points) const {
+  for (int b = 0; b < n_pose_blocks_; ++b) {
+    double* pd = poses->data() + static_cast<size_t>(block_owner_[static_cast<size_t>(b)]) * 7;
+    const double* d = dc.data() + block_offset_[static_cast<size_t>(b)];
+    quaternion_plus(d, pd);
+    pd[4] += d[3];
+    pd[5] += d[4];
+    pd[6] += d[5];
+  }
+  for (int b = n_pose_blocks_; b < n_blocks_; ++b) {
+    const size_t c = static_cast<size_t>(block_owner_[static_cast<size_t>(b)]);
+    const uint32_t mask = intr_mask_[c];
+    const double* d = dc.data() + block_offset_[static_cast<size_t>(b)];
+    for (int k = 0; k < kIntrDof; ++k) {
+      if ((mask >> k) & 1u)
+        continue;
+      const size_t i = c * kIntrDof + static_cast<size_t>(k);
+      (*intr)[i] = std::min(std::max((*intr)[i] + d[k], lower_[i]), upper_[i]);
+    }
+  }
+#pragma omp parallel for schedule(static) num_threads(nt_)
+  for (int p = 0; p < n_pts_; ++p)
+    if (point_var_[static_cast<size_t>(p)])
+      (*points)[static_cast<size_t>(p)] +=
+          Eigen::Map<const Eigen::Vector3d>(dp.data() + static_cast<size_t>(p) * 3);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// LM loop (Ceres LEVENBERG_MARQUARDT trust-region strategy)
+// ─────────────────────────────────────────────────────────────────────────────
+
+bool NativeSchurSolver::solve(int max_iterations, NativeSchurSummary* summary) {
+  const auto t_total = Clock::now();
+  const double ftol = in_.solver_function_tolerance > 0.0 ? in_.solver_function_tolerance
+                                                          : kDefaultFunctionTolerance;
+  const double gtol = in_.solver_gradient_tolerance > 0.0 ? in_.solver_gradient_tolerance
+                                                          : kDefaultGradientTolerance;
+  const double ptol = in_.solver_parameter_tolerance > 0.0 ? in_.solver_parameter_tolerance
+                                                           : kDefaultParameterTolerance;
+
+  auto t0 = Clock::now();
+  linearize();
+  summary->linearize_seconds += seconds_since(t0);
+  summary->initial_cost = cost_;
+  summary->final_cost = cost_;
+  if (!std::isfinite(cost_)) {
+    summary->message = "initial cost is not finite";
+    return false;
+  }
+
+  double radius = kInitialRadius;
+  double decrease_factor = 2.0;
+  std::vector<double> dc, dp;
+  std::vector<double> trial_intr, trial_poses;
+  std::vector<Eigen::Vector3d> trial_points;
+  summary->message = "maximum iterations reached";
+
+  while (summary->iterations < max_iterations) {
+    if (grad_max_norm_ <= gtol) {
+      summary->message = "gradient tolerance reached";
+      break;
+    }
+    ++summary->iterations;
+    const double mu = radius;
+
+    t0 = Clock::now();
+    eliminate_points(mu);
+    assemble_reduced_system(mu);
+    build_preconditioner(mu);
+    summary->schur_seconds += seconds_since(t0);
+
+    t0 = Clock::now();
+    summary->pcg_iterations += solve_pcg(rhs_, &dc);
+    summary->pcg_seconds += seconds_since(t0);
+    back_substitute(dc, &dp);
+
+    double step_sq = 0.0, x_sq = 0.0;
+    for (double v : dc)
+      step_sq += v * v;
+    for (double v : dp)
+      step_sq += v * v;
+    for (int b = 0; b < n_blocks_; ++b) {
+      const size_t owner = static_cast<size_t>(block_owner_[static_cast<size_t>(b)]);
+      const double* x =
+          is_intr_block(b) ? intr_.data() + owner * kIntrDof : poses_.data() + owner * 7;
+      for (int k = 0; k < (is_intr_block(b) ? kIntrDof : 7); ++k)
+        x_sq += x[k] * x[k];
+    }
+    for (int p = 0; p < n_pts_; ++p)
+      if (point_var_[static_cast<size_t>(p)])
+        x_sq += (*points_)[static_cast<size_t>(p)].squaredNorm();
+
+    const double model_change = model_cost_change(dc, dp);
+    bool accepted = false;
+    if (std::isfinite(step_sq) && model_change > 0.0) {
+      if (std::sqrt(step_sq) <= ptol * (std::sqrt(x_sq) + ptol)) {
+        summary->message = "parameter tolerance reached";
+        break;
+      }
+      trial_intr = intr_;
+      trial_poses = poses_;
+      trial_points = *points_;
+      apply_step(dc, dp, &trial_intr, &trial_poses, &trial_points);
+      const double new_cost = evaluate_cost(trial_intr, trial_poses, trial_points);
+      const double rho = (cost_ - new_cost) / model_change;
+      if (std::isfinite(new_cost) && rho > kMinRelativeDecrease) {
+        accepted = true;
+        ++summary->successful_iterations;
+        const double old_cost = cost_;
+        intr_.swap(trial_intr);
+        poses_.swap(trial_poses);
+        points_->swap(trial_points);
+        radius = std::min(kMaxRadius,
+                          radius / std::max(1.0 / 3.0, 1.0 - std::pow(2.0 * rho - 1.0, 3)));
+        decrease_factor = 2.0;
+        t0 = Clock::now();
+        linearize();
+        summary->linearize_seconds += seconds_since(t0);
+        if (std::abs(old_cost - cost_) <= ftol * old_cost) {
+          summary->message = "function tolerance reached";
+          break;
+        }
+      }
+    }
+    if (!accepted) {
+      radius /= decrease_factor;
+      decrease_factor *= 2.0;
+      if (radius < kMinRadius) {
+        summary->message = "trust region radius below minimum";
+        break;
+      }
+    }
+  }
+  summary->final_cost = cost_;
+  summary->num_residuals = num_residuals_;
+  summary->total_seconds = seconds_since(t_total);
+  return true;
+}
+
+void NativeSchurSolver::extract(BAResult* result) const {
+  result->poses_R.resize(static_cast<size_t>(n_cams_));
+  result->poses_C.resize(static_cast<size_t>(n_cams_));
+  for (int i = 0; i < n_cams_; ++i) {
+    const double* pd = poses_.data() + static_cast<size_t>(i) * 7;
+    const Eigen::Quaterniond q(pd[3], pd[0], pd[1], pd[2]); // (w,x,y,z)
+    result->poses_R[static_cast<size_t>(i)] = q.normalized().toRotationMatrix();
+    result->poses_C[static_cast<size_t>(i)] = Eigen::Vector3d(pd[4], pd[5], pd[6]);
+  }
+  result->cameras.resize(static_cast<size_t>(n_distinct_));
+  for (int c = 0; c < n_distinct_; ++c) {
+    const double* ip = intr_.data() + static_cast<size_t>(c) * kIntrDof;
+    auto& K = result->cameras[static_cast<size_t>(c)];
+    K.fx = ip[kFx];
+    K.fy = ip[kSigma] * ip[kFx];
+    K.cx = ip[kCx];
+    K.cy = ip[kCy];
+    K.k1 = ip[kK1];
+    K.k2 = ip[kK2];
+    K.k3 = ip[kK3];
+    K.p1 = ip[kP1];
+    K.p2 = ip[kP2];
+    K.width = in_.cameras[static_cast<size_t>(c)].width;
+    K.height = in_.cameras[static_cast<size_t>(c)].height;
+  }
+}
+
+} // namespace
+
+// ─────────────────────────────────────────────────────────────────────────────
+// native_schur_bundle
+// ─────────────────────────────────────────────────────────────────────────────
+
+bool native_schur_bundle(const BAInput& input, BAResult* result, int max_iterations,
+                         NativeSchurSummary* summary) {
+  if (!result)
+    return false;
+  if (input.poses_R.size() != input.poses_C.size() || input.poses_R.empty() ||
+      input.points3d.empty() || input.observations.empty())
+    return false;
+  if (input.image_camera_index.size() != input.poses_R.size() || input.cameras.empty()) {
+    LOG(WARNING) << "native_schur_bundle: image_camera_index and cameras required";
+    return false;
+  }
+
+  const int hw = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  int num_threads = input.num_threads > 0 ? input.num_threads : hw;
+  if (num_threads > hw) {
+    LOG(WARNING) << "Requested num_threads=" << num_threads
+                 << " exceeds hardware concurrency; using max available threads instead.";
+    num_threads = hw;
+  }
+  const int iters =
+      (input.solver_max_num_iterations > 0) ? input.solver_max_num_iterations : max_iterations;
+
+  NativeSchurSummary local_summary;
+  NativeSchurSummary* sum = summary ? summary : &local_summary;
+  *sum = NativeSchurSummary{};
+
+  result->points3d = input.points3d;
+  NativeSchurSolver solver(input, num_threads);
+  if (!solver.setup(&result->points3d)) {
+    LOG(WARNING) << "native_schur_bundle: no valid observations";
+    return false;
+  }
+  if (!solver.solve(iters, sum)) {
+    LOG(WARNING) << "native_schur_bundle: " << sum->message;
+    return false;
+  }
+  solver.extract(result);
+
+  const double rmse_before =
+      sum->num_residuals > 0 ? std::sqrt(sum->initial_cost * 2.0 / sum->num_residuals) : 0.0;
+  const double rmse_after =
+      sum->num_residuals > 0 ? std::sqrt(sum->final_cost * 2.0 / sum->num_residuals) : 0.0;
+  LOG(INFO) << "global_bundle_analytic (native Schur + PCG/"
+            << preconditioner_name(input.native_preconditioner) << ", " << num_threads
+            << " threads): RMSE  before=" << rmse_before << " px  after=" << rmse_after
+            << " px  iters=" << sum->iterations << " (" << sum->successful_iterations
+            << " accepted)  pcg_iters=" << sum->pcg_iterations << "  time linearize="
+            << sum->linearize_seconds << "s schur=" << sum->schur_seconds
+            << "s pcg=" << sum->pcg_seconds << "s total=" << sum->total_seconds << "s  ("
+            << sum->message << ")";
+
+  result->success = true;
+  result->num_residuals = sum->num_residuals;
+  result->rmse_px = rmse_after;
+  return true;
+}
+
+} // namespace sfm
+} // namespace insight
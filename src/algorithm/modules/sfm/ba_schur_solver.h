@@ -0,0 +1,61 @@
+/**
+ * @file  ba_schur_solver.h
+ * @brief Native Levenberg-Marquardt BA specialised for the ReprojectionCostAnalytic blocks.
+ *
+ * Same objective as the Ceres path of global_bundle_analytic (Huber reprojection residuals, focal
+ * prior, camera-distance priors, Tikhonov terms, intrinsics masks and bounds), solved in-house:
+ *
+ *   1. Linearise: residual and intr(9) / pose(7) / pt(3) Jacobians per observation from
+ *      ReprojectionCostAnalytic::Evaluate.  The pose block is mapped to a 6-DOF tangent (left
+ *      quaternion increment, as ceres::EigenQuaternionManifold, plus centre); Huber is applied as
+ *      an IRLS weight √ρ′ on residual and Jacobian.
+ *   2. Eliminate points: V_p = Σ J_pᵀJ_p (3×3) and the camera–point coupling blocks W_p.
+ *   3. Reduced camera system  S = U − Σ_p W_p V_p⁻¹ W_pᵀ,  assembled in parallel by block row
+ *      (each row owned by one thread; rows touching very many points, e.g. a shared intrinsics
+ *      block, are split across threads and reduced in a fixed order).
+ *   4. PCG on S with a block-Jacobi, Schur-Jacobi or visibility-cluster preconditioner
+ *      (BAPreconditioner).
+ *   5. Back-substitute the points; trust-region step control as Ceres' LEVENBERG_MARQUARDT.
+ *
+ * Camera unknowns: one 6-DOF block per variable image pose, then one 9-DOF block per optimised
+ * intrinsics.  Masked intrinsics (fix_intrinsics_flags) get a unit diagonal and a zero step;
+ * parameter bounds are enforced by clamping after each step.
+ */
+
+#pragma once
+
+#include "bundle_adjustment_analytic.h"
+
+#include <string>
+
+namespace insight {
+namespace sfm {
+
+struct NativeSchurSummary {
+  int iterations = 0; ///< LM iterations, accepted and rejected.
+  int successful_iterations = 0;
+  int pcg_iterations = 0; ///< Sum over all linear solves.
+  int num_residuals = 0;
+  double initial_cost = 0.0; ///< ½ Σ ρ(‖r‖²) + priors (Ceres convention).
+  double final_cost = 0.0;
+  double linearize_seconds = 0.0;
+  double schur_seconds = 0.0; ///< Point elimination + reduced camera system + preconditioner.
+  double pcg_seconds = 0.0;
+  double total_seconds = 0.0;
+  std::string message;
+};
+
+/**
+ * Solve \p input with the native solver.  global_bundle_analytic calls this when
+ * input.solver_backend == BASolverBackend::kNativeSchur; \p result is filled as by the Ceres path.
+ *
+ * Honours solver_max_num_iterations, the three solver_*_tolerance overrides (0 = Ceres defaults),
+ * num_threads and native_preconditioner; solver_dense_schur_max_variable_cams is ignored.
+ *
+ * @return false on invalid input or a non-finite initial cost.
+ */
+bool native_schur_bundle(const BAInput& input, BAResult* result, int max_iterations = 500,
+                         NativeSchurSummary* summary = nullptr);
+
+} // namespace sfm
+} // namespace insight
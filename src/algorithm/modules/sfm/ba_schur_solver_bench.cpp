@@ -0,0 +1,204 @@
+/**
+ * @file  ba_schur_solver_bench.cpp
+ * @brief Native Schur + PCG bundle adjustment vs Ceres on the same BAInput.
+ *
+ * Synthetic aerial block: a grid of nadir cameras (one shared distorted camera model) over a
+ * gently undulating ground; each point is seen by every camera whose footprint contains it.
+ * Poses, points and the focal length are perturbed, then the same BAInput is solved with
+ * BASolverBackend::kCeres and with BASolverBackend::kNativeSchur under every BAPreconditioner.
+ *
+ * Exits non-zero if a native run fails or ends with RMSE above 1.05 × Ceres + 0.01 px.
+ *
+ * Usage: bench_ba_schur_solver [num_images=400] [num_points=40000] [num_threads=0]
+ *
+ * Native-only reference at 3200 images / 200000 points (5.31M residuals, 1 core, -O2,
+ * max 100 LM iterations); no Ceres build was available for that run, so speedup is unmeasured:
+ *
+ *   preconditioner   LM  PCG iters  RMSE px  total s  (linearize / schur / pcg)
+ *   block_jacobi      5       1347   0.4699     49.8  (13.5 / 14.5 / 16.0)
+ *   schur_jacobi      7       2494   0.4699     86.6  (20.6 / 23.7 / 35.5)
+ *   cluster_jacobi    7       2457   0.4699     87.4  (20.1 / 21.2 / 39.0)
+ */
+
+#include "ba_schur_solver.h"
+#include "bundle_adjustment_analytic.h"
+
+#include "../camera/camera_types.h"
+
+#include <glog/logging.h>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using insight::camera::Intrinsics;
+using namespace insight::sfm;
+
+namespace {
+
+BAInput make_scene(int num_images, int num_points, uint32_t seed) {
+  Intrinsics K;
+  K.fx = K.fy = 3000.0;
+  K.cx = 2000.0;
+  K.cy = 1500.0;
+  K.width = 4000;
+  K.height = 3000;
+  K.k1 = -0.05;
+  K.k2 = 0.01;
+
+  const int cols = std::max(1, static_cast<int>(std::ceil(std::sqrt(num_images * 1.5))));
+  const double spacing = 30.0, altitude = 100.0;
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0.0, 0.5);
+  std::normal_distribution<double> perturb(0.0, 1.0);
+
+  BAInput in;
+  in.cameras = {K};
+  in.optimize_intrinsics = true;
+  in.fix_intrinsics_flags = {kFixIntrK3 | kFixIntrP1 | kFixIntrP2};
+  std::vector<Eigen::Matrix3d> R_gt;
+  std::vector<Eigen::Vector3d> C_gt;
+  for (int i = 0; i < num_images; ++i) {
+    const Eigen::Vector3d C((i % cols) * spacing, (i / cols) * spacing, altitude);
+    // Nadir: camera z looks down, small per-image yaw.
+    const double yaw = 0.02 * perturb(rng);
+    const Eigen::Matrix3d R =
+        (Eigen::AngleAxisd(yaw, Eigen::Vector3d::UnitZ()) *
+         Eigen::AngleAxisd(M_PI, Eigen::Vector3d::UnitX()))
+            .toRotationMatrix()
+            .transpose();
+    R_gt.push_back(R);
+    C_gt.push_back(C);
+    in.image_camera_index.push_back(0);
+  }
+  const double x_max = (cols - 1) * spacing;
+  const double y_max = ((num_images - 1) / cols) * spacing;
+  std::uniform_real_distribution<double> ux(-20.0, x_max + 20.0), uy(-20.0, y_max + 20.0);
+
+  const ReprojectionCostAnalytic proj(0.0, 0.0);
+  double intr[kAnalyticIntrCount] = {K.fx, 1.0, K.cx, K.cy, K.k1, K.k2, K.k3, K.p1, K.p2};
+  std::vector<double> poses(static_cast<size_t>(num_images) * 7);
+  for (int i = 0; i < num_images; ++i) {
+    const Eigen::Quaterniond q(R_gt[static_cast<size_t>(i)]);
+    double* pd = poses.data() + static_cast<size_t>(i) * 7;
+    pd[0] = q.x();
+    pd[1] = q.y();
+    pd[2] = q.z();
+    pd[3] = q.w();
+    for (int k = 0; k < 3; ++k)
+      pd[4 + k] = C_gt[static_cast<size_t>(i)][k];
+  }
+  for (int j = 0; j < num_points; ++j) {
+    const double x = ux(rng), y = uy(rng);
+    const Eigen::Vector3d X(x, y, 5.0 * std::sin(0.02 * x) * std::cos(0.03 * y));
+    const int pid = static_cast<int>(in.points3d.size());
+    int n_obs = 0;
+    for (int i = 0; i < num_images; ++i) {
+      const Eigen::Vector3d d = X - C_gt[static_cast<size_t>(i)];
+      if (std::abs(d.x()) > 65.0 || std::abs(d.y()) > 48.0)
+        continue;
+      const double* params[3] = {intr, poses.data() + static_cast<size_t>(i) * 7, X.data()};
+      double uv[2];
+      proj.Evaluate(params, uv, nullptr);
+      BAObservation obs;
+      obs.image_index = i;
+      obs.point_index = pid;
+      obs.u = uv[0] + noise(rng);
+      obs.v = uv[1] + noise(rng);
+      in.observations.push_back(obs);
+      ++n_obs;
+    }
+    if (n_obs < 2) {
+      in.observations.resize(in.observations.size() - static_cast<size_t>(n_obs));
+      continue;
+    }
+    in.points3d.push_back(X + 0.05 * Eigen::Vector3d(perturb(rng), perturb(rng), perturb(rng)));
+  }
+
+  in.fix_pose.assign(static_cast<size_t>(num_images), false);
+  for (int i = 0; i < num_images; ++i) {
+    const Eigen::Vector3d w = 2e-4 * Eigen::Vector3d(perturb(rng), perturb(rng), perturb(rng));
+    in.poses_R.push_back(Eigen::AngleAxisd(w.norm(), w.normalized()).toRotationMatrix() *
+                         R_gt[static_cast<size_t>(i)]);
+    in.poses_C.push_back(C_gt[static_cast<size_t>(i)] +
+                         0.05 * Eigen::Vector3d(perturb(rng), perturb(rng), perturb(rng)));
+  }
+  // Gauge: first image fixed at ground truth, distance prior to its neighbour fixes the scale.
+  in.poses_R[0] = R_gt[0];
+  in.poses_C[0] = C_gt[0];
+  in.fix_pose[0] = true;
+  if (num_images > 1)
+    in.camera_distance_priors.push_back({0, 1, (C_gt[1] - C_gt[0]).norm(), 1.0});
+  in.cameras[0].fx = in.cameras[0].fy = 1.005 * K.fx;
+  in.focal_prior_weight = 1.0;
+  return in;
+}
+
+struct Run {
+  const char* name;
+  bool ok = false;
+  double seconds = 0.0;
+  double rmse = 0.0;
+  double fx = 0.0;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  FLAGS_logtostderr = 1;
+  FLAGS_minloglevel = 1;
+  const int num_images = argc > 1 ? std::atoi(argv[1]) : 400;
+  const int num_points = argc > 2 ? std::atoi(argv[2]) : 40000;
+  const int num_threads = argc > 3 ? std::atoi(argv[3]) : 0;
+  if (num_images < 2 || num_points < 1 || num_threads < 0) {
+    std::fprintf(stderr, "usage: %s [num_images=400] [num_points=40000] [num_threads=0]\n",
+                 argv[0]);
+    return 2;
+  }
+
+  BAInput input = make_scene(num_images, num_points, 1234u);
+  input.num_threads = num_threads;
+  std::printf("scene: %d images, %zu points, %zu observations\n", num_images,
+              input.points3d.size(), input.observations.size());
+
+  auto run = [&](const char* name, BASolverBackend backend, BAPreconditioner precond) {
+    Run r;
+    r.name = name;
+    BAInput in = input;
+    in.solver_backend = backend;
+    in.native_preconditioner = precond;
+    BAResult res;
+    const auto t0 = std::chrono::steady_clock::now();
+    r.ok = global_bundle_analytic(in, &res, 100) && res.success;
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    r.rmse = res.rmse_px;
+    r.fx = res.cameras.empty() ? 0.0 : res.cameras[0].fx;
+    std::printf("  %-28s ok=%d  time=%8.3f s  RMSE=%.4f px  fx=%.2f\n", r.name, r.ok ? 1 : 0,
+                r.seconds, r.rmse, r.fx);
+    return r;
+  };
+
+  const Run ceres = run("ceres", BASolverBackend::kCeres, BAPreconditioner::kSchurJacobi);
+  const Run native[] = {
+      run("native / block Jacobi", BASolverBackend::kNativeSchur, BAPreconditioner::kBlockJacobi),
+      run("native / Schur-Jacobi", BASolverBackend::kNativeSchur, BAPreconditioner::kSchurJacobi),
+      run("native / cluster Jacobi", BASolverBackend::kNativeSchur,
+          BAPreconditioner::kClusterJacobi)};
+
+  int failures = 0;
+  for (const Run& r : native) {
+    if (!r.ok || (ceres.ok && r.rmse > 1.05 * ceres.rmse + 0.01)) {
+      std::fprintf(stderr, "FAIL: %s (RMSE %.4f vs ceres %.4f)\n", r.name, r.rmse, ceres.rmse);
+      ++failures;
+    } else if (ceres.ok) {
+      std::printf("  %-28s speedup vs ceres: %.2fx\n", r.name, ceres.seconds / r.seconds);
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+/**
+ * @file  bench_ring_scene.h
+ * @brief Synthetic ring-of-cameras scene shared by the triangulation and resection benchmarks.
+ *
+ * num_images cameras (one distorted model) on a circle of radius 20 looking at the origin;
+ * num_tracks random points in a flat box around the origin, each seen by 2–8 consecutive
+ * cameras with 0.5 px pixel noise and a fraction of gross outliers.  Poses are ground truth.
+ */
+
+#pragma once
+
+#ifndef BENCH_RING_SCENE_H
+#define BENCH_RING_SCENE_H
+
+#include "track_store.h"
+
+#include "../camera/camera_types.h"
+#include "../camera/camera_utils.h"
+
+#include <Eigen/Dense>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace insight {
+namespace sfm {
+namespace bench {
+
+struct RingScene {
+  std::vector<Eigen::Matrix3d> R;
+  std::vector<Eigen::Vector3d> C;
+  std::vector<camera::Intrinsics> cameras;
+  std::vector<int> image_to_camera;
+  TrackStore store;
+};
+
+/// Outliers (probability outlier_ratio per observation) are shifted by up to ±outlier_px / 2.
+inline RingScene make_ring_scene(int num_tracks, int num_images, double outlier_ratio,
+                                 double outlier_px, uint32_t seed) {
+  RingScene s;
+  camera::Intrinsics K;
+  K.fx = K.fy = 2400.0;
+  K.cx = 2000.0;
+  K.cy = 1500.0;
+  K.width = 4000;
+  K.height = 3000;
+  K.k1 = -0.08;
+  K.k2 = 0.02;
+  s.cameras = {K};
+  s.image_to_camera.assign(static_cast<size_t>(num_images), 0);
+  for (int i = 0; i < num_images; ++i) {
+    const double a = 2.0 * 3.141592653589793 * i / num_images;
+    const Eigen::Vector3d C(20.0 * std::cos(a), 20.0 * std::sin(a), 2.0);
+    const Eigen::Vector3d z = (-C).normalized();
+    const Eigen::Vector3d x = z.cross(Eigen::Vector3d::UnitZ()).normalized();
+    const Eigen::Vector3d y = z.cross(x);
+    Eigen::Matrix3d R;
+    R.row(0) = x.transpose();
+    R.row(1) = y.transpose();
+    R.row(2) = z.transpose();
+    s.R.push_back(R);
+    s.C.push_back(C);
+  }
+
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> pos(-5.0, 5.0);
+  std::normal_distribution<double> noise(0.0, 0.5);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+  std::uniform_int_distribution<int> first(0, num_images - 1);
+  std::uniform_int_distribution<int> span(2, 8);
+  s.store.set_num_images(num_images);
+  s.store.reserve_tracks(static_cast<size_t>(num_tracks));
+  s.store.reserve_observations(static_cast<size_t>(num_tracks) * 6);
+  for (int t = 0; t < num_tracks; ++t) {
+    const Eigen::Vector3d X(pos(rng), pos(rng), pos(rng) * 0.3);
+    const int tid = s.store.add_track(0.f, 0.f, 0.f);
+    const int i0 = first(rng), n = span(rng);
+    for (int k = 0; k < n; ++k) {
+      const int im = (i0 + k) % num_images;
+      const Eigen::Vector3d p = s.R[static_cast<size_t>(im)] * (X - s.C[static_cast<size_t>(im)]);
+      double xd, yd;
+      camera::apply_distortion(p.x() / p.z(), p.y() / p.z(), K, &xd, &yd);
+      double u = K.fx * xd + K.cx + noise(rng), v = K.fy * yd + K.cy + noise(rng);
+      if (unit(rng) < outlier_ratio) {
+        u += outlier_px * (unit(rng) - 0.5);
+        v += outlier_px * (unit(rng) - 0.5);
+      }
+      s.store.add_observation(tid, static_cast<uint32_t>(im), static_cast<uint32_t>(t),
+                              static_cast<float>(u), static_cast<float>(v));
+    }
+  }
+  return s;
+}
+
+}  // namespace bench
+}  // namespace sfm
+}  // namespace insight
+
+#endif  // BENCH_RING_SCENE_H
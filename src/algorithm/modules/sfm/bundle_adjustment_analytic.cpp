@@ -20,6 +20,7 @@
  */
 
 #include "bundle_adjustment_analytic.h"
+#include "ba_schur_solver.h"
 
 #include "../camera/camera_utils.h"
 #include <chrono>
@@ -772,6 +773,8 @@ bool global_bundle_analytic(const BAInput& input, BAResult* result, int max_iter
     LOG(WARNING) << "global_bundle_analytic: image_camera_index and cameras required";
     return false;
   }
+  if (input.solver_backend == BASolverBackend::kNativeSchur)
+    return native_schur_bundle(input, result, max_iterations);
 
   const int n_distinct = static_cast<int>(input.cameras.size());
 
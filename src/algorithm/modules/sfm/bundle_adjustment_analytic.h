@@ -89,6 +89,19 @@ enum FixIntrinsicsMask : uint32_t {
   kFixIntrAll   = (1u << 9) - 1u
 };
 
+/// Linear-algebra backend of global_bundle_analytic (same objective either way).
+enum class BASolverBackend : int {
+  kCeres = 0,       ///< ceres::Solve with DENSE_SCHUR / SPARSE_SCHUR (+ ITERATIVE_SCHUR retry).
+  kNativeSchur = 1, ///< In-house block-sparse Schur LM with multithreaded PCG (ba_schur_solver.h).
+};
+
+/// PCG preconditioner of the native Schur solver.
+enum class BAPreconditioner : int {
+  kBlockJacobi = 0,   ///< Damped diagonal camera blocks of JᵀJ (cheapest, weakest).
+  kSchurJacobi = 1,   ///< Diagonal blocks of the reduced camera system S.
+  kClusterJacobi = 2, ///< Dense blocks of S over covisibility clusters of up to 16 cameras.
+};
+
 /// BA input: N images (poses), M points, multi-camera intrinsics. Compact layout.
 /// Gauge: set fix_pose[i]=true on exactly one (or more for local BA constants) camera(s).
 /// Optional camera_distance_priors (see BACameraDistancePrior) can stabilise scale with a fixed anchor.
@@ -137,6 +150,11 @@ struct BAInput {
   /// are applied for camera c (k1 ±0.8, k2 ±0.5, k3 ±0.3) instead of the default tight
   /// bounds (k1 ±0.3, k2 ±0.25, k3 ±0.2). 0 = always use tight bounds (default=50000).
   int relax_intrinsics_obs_threshold = 50000;
+
+  /// Solver backend; kNativeSchur ignores solver_dense_schur_max_variable_cams.
+  BASolverBackend solver_backend = BASolverBackend::kCeres;
+  /// Preconditioner for solver_backend == kNativeSchur.
+  BAPreconditioner native_preconditioner = BAPreconditioner::kSchurJacobi;
 };
 
 struct BAResult {
@@ -13,12 +13,14 @@
  *  7. Two-view one camera (2 images, same intrinsics via image_to_camera).
  *  8. Two-view two cameras (different intrinsics).
  *  9. Fix pose and fix point (constant parameter blocks).
+ * 10–12. Tikhonov pose cost (λ = 0, residuals, Jacobian).
+ * 13. Native Schur backend: convergence from a perturbed start with each preconditioner.
  *
  * Build: test_ba_analytic (see sfm/CMakeLists.txt).
  */
 
 #include "bundle_adjustment_analytic.h"
-#include "bundle_adjustment_analytic.h"
+#include "ba_schur_solver.h"
 #include "../camera/camera_types.h"
 
 #include <glog/logging.h>
@@ -725,6 +727,111 @@ static int test_tikhonov_pose_cost_jacobian() {
   return 0;
 }
 
+// ─────────────────────────────────────────────────────────────────────────────
+// Test 13 – Native Schur backend (solver_backend = kNativeSchur)
+// ─────────────────────────────────────────────────────────────────────────────
+
+static int test_native_schur_backend() {
+  std::cout << "[Test 13] Native Schur + PCG: perturbed start, masked intrinsics, 3 preconditioners\n";
+
+  const int n_cams = 8, n_pts = 300;
+
+  Intrinsics K0, K1;
+  K0.fx = 900.0; K0.fy = 900.0; K0.cx = 400.0; K0.cy = 300.0;
+  K0.k1 = 0.03;  K0.k2 = -0.008; K0.k3 = 0.0; K0.p1 = 0.0015; K0.p2 = -0.001;
+  K1.fx = 600.0; K1.fy = 600.0; K1.cx = 320.0; K1.cy = 240.0;
+  K1.k1 = 0.01;  K1.k2 = 0.0;    K1.k3 = 0.0; K1.p1 = 0.0;    K1.p2 = 0.0;
+  double intr0[kAnalyticIntrCount] = {K0.fx, 1.0, K0.cx, K0.cy,
+                                       K0.k1, K0.k2, K0.k3, K0.p1, K0.p2};
+  double intr1[kAnalyticIntrCount] = {K1.fx, 1.0, K1.cx, K1.cy,
+                                       K1.k1, K1.k2, K1.k3, K1.p1, K1.p2};
+
+  std::vector<Eigen::Matrix3d> R_gt(n_cams);
+  std::vector<Eigen::Vector3d> t_gt(n_cams);
+  for (int i = 0; i < n_cams; ++i) {
+    const double angle = i * (1.2 * M_PI / n_cams);
+    const Eigen::Vector3d C(8.0*std::cos(angle), 0.5*(i % 3), 8.0*std::sin(angle) - 4.0);
+    look_at_origin(C, &R_gt[i], &t_gt[i]);
+  }
+
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> dxy(-3.0, 3.0);
+  std::uniform_real_distribution<double> dz(-1.0, 3.0);
+  std::normal_distribution<double> noise(0.0, 0.3);
+  std::normal_distribution<double> perturb(0.0, 0.02);
+
+  std::vector<Eigen::Vector3d> pts_gt(n_pts);
+  for (auto& p : pts_gt) p = {dxy(rng), dxy(rng), dz(rng)};
+
+  BAInput input;
+  input.cameras = {K0, K1};
+  input.cameras[0].fx = input.cameras[0].fy = 0.99 * K0.fx; // 1 % focal error
+  input.optimize_intrinsics = true;
+  input.fix_intrinsics_flags = {0u, kFixIntrCx | kFixIntrCy | kFixIntrK3 | kFixIntrP1 | kFixIntrP2};
+  input.fix_pose.assign(n_cams, false);
+  input.fix_pose[0] = input.fix_pose[1] = true; // gauge incl. scale
+  for (int i = 0; i < n_cams; ++i) {
+    input.image_camera_index.push_back(i % 2);
+    const Eigen::Vector3d C = -R_gt[i].transpose() * t_gt[i];
+    const bool fixed = input.fix_pose[i];
+    const Eigen::Vector3d w(perturb(rng), perturb(rng), perturb(rng));
+    input.poses_R.push_back(fixed ? R_gt[i]
+                                  : Eigen::Matrix3d(Eigen::AngleAxisd(w.norm(), w.normalized()) * R_gt[i]));
+    input.poses_C.push_back(fixed ? C : C + 5.0 * Eigen::Vector3d(perturb(rng), perturb(rng), perturb(rng)));
+  }
+  for (int j = 0; j < n_pts; ++j)
+    input.points3d.push_back(pts_gt[j] + 2.0 * Eigen::Vector3d(perturb(rng), perturb(rng), perturb(rng)));
+  for (int i = 0; i < n_cams; ++i) {
+    double pose_d[7];
+    Rt_to_pose(R_gt[i], t_gt[i], pose_d);
+    const double* intr = (i % 2 == 0) ? intr0 : intr1;
+    for (int j = 0; j < n_pts; ++j) {
+      double uv[2], pt[3] = {pts_gt[j].x(), pts_gt[j].y(), pts_gt[j].z()};
+      if (!project(intr, pose_d, pt, uv)) continue;
+      BAObservation obs;
+      obs.image_index = i; obs.point_index = j;
+      obs.u = uv[0] + noise(rng); obs.v = uv[1] + noise(rng);
+      input.observations.push_back(obs);
+    }
+  }
+  input.solver_backend = BASolverBackend::kNativeSchur;
+
+  const BAPreconditioner kinds[] = {BAPreconditioner::kBlockJacobi, BAPreconditioner::kSchurJacobi,
+                                    BAPreconditioner::kClusterJacobi};
+  for (BAPreconditioner kind : kinds) {
+    input.native_preconditioner = kind;
+    BAResult res;
+    NativeSchurSummary summary;
+    const bool ok = native_schur_bundle(input, &res, 100, &summary);
+    const double fx_err = std::abs(res.cameras.empty() ? 0.0 : res.cameras[0].fx - K0.fx) / K0.fx;
+    std::cout << "  preconditioner=" << static_cast<int>(kind) << "  ok=" << ok
+              << "  RMSE=" << res.rmse_px << " px  iters=" << summary.iterations
+              << "  pcg=" << summary.pcg_iterations << "  fx err=" << 100.0 * fx_err
+              << " %  (" << summary.message << ")\n";
+    if (!ok || !res.success || res.rmse_px > 0.35) {
+      std::cerr << "  FAIL: native Schur BA did not converge\n";
+      return 1;
+    }
+    if (fx_err > 0.003) {
+      std::cerr << "  FAIL: focal not recovered\n";
+      return 1;
+    }
+    if (res.cameras[1].cx != K1.cx || res.cameras[1].k3 != K1.k3) {
+      std::cerr << "  FAIL: masked intrinsics changed\n";
+      return 1;
+    }
+  }
+
+  // global_bundle_analytic dispatches on solver_backend.
+  BAResult res;
+  if (!global_bundle_analytic(input, &res, 100) || res.rmse_px > 0.35) {
+    std::cerr << "  FAIL: global_bundle_analytic(kNativeSchur)\n";
+    return 1;
+  }
+  std::cout << "  PASS\n";
+  return 0;
+}
+
 // ─────────────────────────────────────────────────────────────────────────────
 // main
 // ─────────────────────────────────────────────────────────────────────────────
@@ -747,6 +854,7 @@ int main() {
   failures += test_tikhonov_pose_cost_lambda_zero();
   failures += test_tikhonov_pose_cost_residuals();
   failures += test_tikhonov_pose_cost_jacobian();
+  failures += test_native_schur_backend();
 
   if (failures == 0) {
     std::cout << "\nAll tests PASSED.\n";
@@ -0,0 +1,578 @@
+/**
+ * @file  external_track_builder.cpp
+ * @brief ExternalTrackBuilder: spill runs, k-way merges and per-component union-find replay.
+ */
+
+#include "external_track_builder.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+#include <glog/logging.h>
+
+namespace fs = std::filesystem;
+
+namespace insight {
+namespace sfm {
+
+namespace {
+
+// ── Spill records (fixed-size PODs, written with fwrite) ───────────────────────
+
+struct EdgeRec {  // stage 1: one per match, sorted by (k1, seq)
+  uint64_t k1, k2, seq;
+};
+struct NodeRec {  // stage 1: two per match, sorted by (key, seq) → first-seen coords
+  uint64_t key, seq;
+  float u, v, s;
+  uint32_t pad;
+};
+struct NodeOut {  // stage 2: node file, key order (node id = record index)
+  uint64_t key;
+  float u, v, s;
+  uint32_t pad;
+};
+struct JoinRec {  // stage 3: first endpoint resolved, sorted by (k2, seq)
+  uint64_t k2, seq;
+  int32_t id1;
+  uint32_t img1;
+};
+struct IdEdge {  // stage 3 output: both endpoints resolved
+  uint64_t seq;
+  int32_t id1, id2;
+  uint32_t img1, img2;
+};
+struct CompEdge {  // stage 4: sorted by (component, seq) = serial order inside a component
+  int32_t comp;
+  int32_t id1, id2;
+  uint32_t img1, img2;
+  uint32_t pad;
+  uint64_t seq;
+};
+struct ObsRec {  // stage 5: sorted by (track, key) = (track, image, feature)
+  int32_t track;
+  uint32_t pad;
+  uint64_t key;
+  float u, v, s;
+  uint32_t pad2;
+};
+
+struct SpillCounters {
+  int runs = 0;
+  int64_t bytes = 0;
+};
+
+bool write_records(std::FILE* f, const void* data, size_t bytes) {
+  return bytes == 0 || std::fwrite(data, 1, bytes, f) == bytes;
+}
+
+/// Sequential chunked reader over a file of T records.
+template <typename T>
+class RecordReader {
+ public:
+  RecordReader() = default;
+  RecordReader(const RecordReader&) = delete;
+  RecordReader& operator=(const RecordReader&) = delete;
+  RecordReader(RecordReader&& o) noexcept { *this = std::move(o); }
+  RecordReader& operator=(RecordReader&& o) noexcept {
+    std::swap(f_, o.f_);
+    buf_ = std::move(o.buf_);
+    pos_ = o.pos_;
+    len_ = o.len_;
+    return *this;
+  }
+  ~RecordReader() {
+    if (f_) std::fclose(f_);
+  }
+
+  bool open(const std::string& path, size_t chunk_records) {
+    f_ = std::fopen(path.c_str(), "rb");
+    buf_.resize(std::max<size_t>(1, chunk_records));
+    pos_ = len_ = 0;
+    return f_ != nullptr;
+  }
+  bool next(T* out) {
+    if (pos_ == len_) {
+      len_ = std::fread(buf_.data(), sizeof(T), buf_.size(), f_);
+      pos_ = 0;
+      if (len_ == 0) return false;
+    }
+    *out = buf_[pos_++];
+    return true;
+  }
+
+ private:
+  std::FILE* f_ = nullptr;
+  std::vector<T> buf_;
+  size_t pos_ = 0, len_ = 0;
+};
+
+/**
+ * Buffer records up to `capacity`, spill each full buffer as a sorted run, then iterate all
+ * records in sorted order (k-way merge).  Stays in memory when everything fits one buffer.
+ */
+template <typename T, typename Less>
+class RunSorter {
+ public:
+  RunSorter(std::string path_prefix, size_t capacity_records, SpillCounters* counters)
+      : prefix_(std::move(path_prefix)), capacity_(std::max<size_t>(1024, capacity_records)),
+        counters_(counters) {
+    buf_.reserve(std::min<size_t>(capacity_, size_t(1) << 20));
+  }
+  ~RunSorter() {
+    readers_.clear();
+    std::error_code ec;
+    for (const std::string& p : runs_) fs::remove(p, ec);
+  }
+
+  bool push(const T& r) {
+    buf_.push_back(r);
+    return buf_.size() < capacity_ || spill();
+  }
+
+  /// Switch to reading; `read_budget_bytes` is shared by the run read buffers.
+  bool finish(size_t read_budget_bytes) {
+    if (runs_.empty()) {
+      std::sort(buf_.begin(), buf_.end(), Less());
+      pos_ = 0;
+      return true;
+    }
+    if (!buf_.empty() && !spill()) return false;
+    std::vector<T>().swap(buf_);
+    const size_t chunk = std::max<size_t>(4096, read_budget_bytes / (runs_.size() * sizeof(T)));
+    readers_.resize(runs_.size());
+    heads_.resize(runs_.size());
+    for (size_t r = 0; r < runs_.size(); ++r) {
+      if (!readers_[r].open(runs_[r], chunk)) {
+        LOG(ERROR) << "ExternalTrackBuilder: cannot reopen run " << runs_[r];
+        return false;
+      }
+      if (readers_[r].next(&heads_[r])) heap_.push(r);
+    }
+    return true;
+  }
+
+  bool next(T* out) {
+    if (runs_.empty()) {
+      if (pos_ == buf_.size()) return false;
+      *out = buf_[pos_++];
+      return true;
+    }
+    if (heap_.empty()) return false;
+    const size_t r = heap_.top();
+    heap_.pop();
+    *out = heads_[r];
+    if (readers_[r].next(&heads_[r])) heap_.push(r);
+    return true;
+  }
+
+ private:
+  bool spill() {
+    std::sort(buf_.begin(), buf_.end(), Less());
+    const std::string path = prefix_ + "." + std::to_string(runs_.size()) + ".run";
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    const size_t bytes = buf_.size() * sizeof(T);
+    const bool ok = f && write_records(f, buf_.data(), bytes);
+    if (f && std::fclose(f) != 0) {
+      LOG(ERROR) << "ExternalTrackBuilder: cannot close run " << path;
+      return false;
+    }
+    if (!ok) {
+      LOG(ERROR) << "ExternalTrackBuilder: cannot write run " << path;
+      return false;
+    }
+    runs_.push_back(path);
+    ++counters_->runs;
+    counters_->bytes += static_cast<int64_t>(bytes);
+    buf_.clear();
+    return true;
+  }
+
+  struct HeadGreater {
+    const std::vector<T>* heads;
+    bool operator()(size_t a, size_t b) const {
+      // Ties broken by run index: earlier runs hold earlier records (stable merge).
+      if (Less()((*heads)[b], (*heads)[a])) return true;
+      if (Less()((*heads)[a], (*heads)[b])) return false;
+      return a > b;
+    }
+  };
+
+  std::string prefix_;
+  size_t capacity_;
+  SpillCounters* counters_;
+  std::vector<T> buf_;
+  size_t pos_ = 0;
+  std::vector<std::string> runs_;
+  std::vector<RecordReader<T>> readers_;
+  std::vector<T> heads_;
+  std::priority_queue<size_t, std::vector<size_t>, HeadGreater> heap_{HeadGreater{&heads_}};
+};
+
+struct EdgeByK1 {
+  bool operator()(const EdgeRec& a, const EdgeRec& b) const {
+    return a.k1 != b.k1 ? a.k1 < b.k1 : a.seq < b.seq;
+  }
+};
+struct NodeByKey {
+  bool operator()(const NodeRec& a, const NodeRec& b) const {
+    return a.key != b.key ? a.key < b.key : a.seq < b.seq;
+  }
+};
+struct JoinByK2 {
+  bool operator()(const JoinRec& a, const JoinRec& b) const {
+    return a.k2 != b.k2 ? a.k2 < b.k2 : a.seq < b.seq;
+  }
+};
+struct CompBySeq {
+  bool operator()(const CompEdge& a, const CompEdge& b) const {
+    return a.comp != b.comp ? a.comp < b.comp : a.seq < b.seq;
+  }
+};
+struct ObsByTrack {
+  bool operator()(const ObsRec& a, const ObsRec& b) const {
+    return a.track != b.track ? a.track < b.track : a.key < b.key;
+  }
+};
+
+size_t records_for(size_t bytes, size_t record_size) { return bytes / record_size; }
+
+// Rough stage 4 replay cost per multi-node root besides its image ids: hash node and bucket slot,
+// vector header and heap block overheads.
+constexpr size_t kReplayBytesPerRoot = 96;
+
+std::atomic<int> g_builder_counter{0};
+
+}  // namespace
+
+struct ExternalTrackBuilder::Impl {
+  ExternalTrackBuilderOptions options;
+  std::string dir;
+  SpillCounters counters;
+  uint64_t next_seq = 0;
+  std::unique_ptr<RunSorter<EdgeRec, EdgeByK1>> edges;
+  std::unique_ptr<RunSorter<NodeRec, NodeByKey>> nodes;
+  bool built = false;
+
+  std::string path(const std::string& name) const { return dir + "/" + name; }
+};
+
+ExternalTrackBuilder::ExternalTrackBuilder(const ExternalTrackBuilderOptions& options)
+    : impl_(new Impl) {
+  impl_->options = options;
+  const fs::path base = options.spill_dir.empty() ? fs::temp_directory_path()
+                                                  : fs::path(options.spill_dir);
+  spill_dir_ = (base / ("isat_tracks_spill_" + std::to_string(::getpid()) + "_" +
+                        std::to_string(g_builder_counter++)))
+                   .string();
+  std::error_code ec;
+  fs::create_directories(spill_dir_, ec);
+  if (ec)
+    LOG(ERROR) << "ExternalTrackBuilder: cannot create spill dir " << spill_dir_ << ": "
+               << ec.message();
+  impl_->dir = spill_dir_;
+
+  // Stage-1 buffers: 24 B edge + 2 × 32 B node records per match.
+  const size_t budget = options.memory_budget_bytes;
+  const size_t per_match = sizeof(EdgeRec) + 2 * sizeof(NodeRec);
+  impl_->edges.reset(new RunSorter<EdgeRec, EdgeByK1>(
+      impl_->path("edges"), records_for(budget / per_match * sizeof(EdgeRec), sizeof(EdgeRec)),
+      &impl_->counters));
+  impl_->nodes.reset(new RunSorter<NodeRec, NodeByKey>(
+      impl_->path("nodes"),
+      records_for(budget / per_match * 2 * sizeof(NodeRec), sizeof(NodeRec)), &impl_->counters));
+}
+
+ExternalTrackBuilder::~ExternalTrackBuilder() {
+  impl_.reset();
+  std::error_code ec;
+  fs::remove_all(spill_dir_, ec);
+}
+
+bool ExternalTrackBuilder::add_pairs(const std::vector<TrackPairMatches>& pairs) {
+  Impl& s = *impl_;
+  if (s.built) return false;
+  for (const TrackPairMatches& pm : pairs) {
+    for (size_t j = 0; j < pm.num_matches; ++j) {
+      const TrackInlierMatch& m = pm.matches[j];
+      const uint64_t seq = s.next_seq++;
+      const uint64_t k1 = track_node_key(pm.image1_index, m.idx1);
+      const uint64_t k2 = track_node_key(pm.image2_index, m.idx2);
+      // Node records in get_or_create order (k1 before k2 of the same match).
+      if (!s.edges->push({k1, k2, seq}) || !s.nodes->push({k1, 2 * seq, m.x1, m.y1, m.s1, 0}) ||
+          !s.nodes->push({k2, 2 * seq + 1, m.x2, m.y2, m.s2, 0}))
+        return false;
+    }
+  }
+  return true;
+}
+
+bool ExternalTrackBuilder::build(const TrackObservationSink& sink, ExternalTrackStats* stats_out) {
+  Impl& s = *impl_;
+  if (s.built) return false;
+  s.built = true;
+  const size_t budget = s.options.memory_budget_bytes;
+  ExternalTrackStats stats;
+  stats.num_matches = static_cast<int64_t>(s.next_seq);
+
+  // ── 2. Unique nodes, first-seen coords, ids = rank in key order ──────────────
+  const std::string node_path = s.path("nodes.bin");
+  int64_t num_nodes = 0;
+  {
+    if (!s.nodes->finish(budget)) return false;
+    std::FILE* f = std::fopen(node_path.c_str(), "wb");
+    if (!f) {
+      LOG(ERROR) << "ExternalTrackBuilder: cannot write " << node_path;
+      return false;
+    }
+    std::vector<NodeOut> out;
+    out.reserve(1 << 16);
+    NodeRec r;
+    uint64_t last = std::numeric_limits<uint64_t>::max();
+    bool ok = true;
+    while (ok && s.nodes->next(&r)) {
+      if (num_nodes > 0 && r.key == last) continue;  // later sighting, first-seen wins
+      last = r.key;
+      ++num_nodes;
+      out.push_back({r.key, r.u, r.v, r.s, 0});
+      if (out.size() == out.capacity()) {
+        ok = write_records(f, out.data(), out.size() * sizeof(NodeOut));
+        out.clear();
+      }
+    }
+    ok = ok && write_records(f, out.data(), out.size() * sizeof(NodeOut));
+    ok = (std::fclose(f) == 0) && ok;
+    s.nodes.reset();
+    if (!ok) {
+      LOG(ERROR) << "ExternalTrackBuilder: cannot write " << node_path;
+      return false;
+    }
+    s.counters.bytes += num_nodes * static_cast<int64_t>(sizeof(NodeOut));
+  }
+  stats.num_nodes = num_nodes;
+  if (num_nodes >= std::numeric_limits<int32_t>::max()) {
+    LOG(ERROR) << "ExternalTrackBuilder: " << num_nodes << " nodes exceed the int32 node id range";
+    return false;
+  }
+  const size_t node_chunk = std::max<size_t>(4096, budget / 8 / sizeof(NodeOut));
+
+  // ── 3. Resolve edge endpoints to node ids (two merge joins with the node file) ─
+  const std::string id_edge_path = s.path("id_edges.bin");
+  {
+    RunSorter<JoinRec, JoinByK2> by_k2(s.path("join"), records_for(budget, sizeof(JoinRec)),
+                                       &s.counters);
+    if (!s.edges->finish(budget / 2)) return false;
+    RecordReader<NodeOut> nodes;
+    if (!nodes.open(node_path, node_chunk)) return false;
+    NodeOut n{};
+    int32_t id = -1;
+    EdgeRec e;
+    while (s.edges->next(&e)) {
+      while (id < 0 || n.key < e.k1) {
+        if (!nodes.next(&n)) {
+          LOG(ERROR) << "ExternalTrackBuilder: node file truncated (join 1)";
+          return false;
+        }
+        ++id;
+      }
+      if (!by_k2.push({e.k2, e.seq, id, image_index_from_track_node_key(e.k1)})) return false;
+    }
+    s.edges.reset();
+
+    if (!by_k2.finish(budget / 2)) return false;
+    RecordReader<NodeOut> nodes2;
+    if (!nodes2.open(node_path, node_chunk)) return false;
+    std::FILE* f = std::fopen(id_edge_path.c_str(), "wb");
+    if (!f) return false;
+    std::vector<IdEdge> out;
+    out.reserve(1 << 16);
+    bool ok = true;
+    id = -1;
+    JoinRec j;
+    while (ok && by_k2.next(&j)) {
+      while (id < 0 || n.key < j.k2) {
+        if (!nodes2.next(&n)) {
+          LOG(ERROR) << "ExternalTrackBuilder: node file truncated (join 2)";
+          std::fclose(f);
+          return false;
+        }
+        ++id;
+      }
+      out.push_back({j.seq, j.id1, id, j.img1, image_index_from_track_node_key(j.k2)});
+      if (out.size() == out.capacity()) {
+        ok = write_records(f, out.data(), out.size() * sizeof(IdEdge));
+        out.clear();
+      }
+    }
+    ok = ok && write_records(f, out.data(), out.size() * sizeof(IdEdge));
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok) {
+      LOG(ERROR) << "ExternalTrackBuilder: cannot write " << id_edge_path;
+      return false;
+    }
+    s.counters.bytes += stats.num_matches * static_cast<int64_t>(sizeof(IdEdge));
+  }
+
+  // ── 4. Components without the conflict rule; root = smallest node id ─────────
+  std::vector<int32_t> node_arr(static_cast<size_t>(num_nodes));
+  for (int32_t i = 0; i < static_cast<int32_t>(num_nodes); ++i) node_arr[static_cast<size_t>(i)] = i;
+  auto find = [&node_arr](int32_t x) {
+    while (node_arr[static_cast<size_t>(x)] != x) {  // path halving; parent[x] <= x always
+      node_arr[static_cast<size_t>(x)] = node_arr[static_cast<size_t>(node_arr[static_cast<size_t>(x)])];
+      x = node_arr[static_cast<size_t>(x)];
+    }
+    return x;
+  };
+  const size_t edge_chunk = std::max<size_t>(4096, budget / 4 / sizeof(IdEdge));
+  {
+    RecordReader<IdEdge> in;
+    if (!in.open(id_edge_path, edge_chunk)) return false;
+    IdEdge e;
+    while (in.next(&e)) {
+      const int32_t a = find(e.id1);
+      const int32_t b = find(e.id2);
+      if (a < b) node_arr[static_cast<size_t>(b)] = a;
+      else if (b < a) node_arr[static_cast<size_t>(a)] = b;
+    }
+  }
+  for (size_t i = 0; i < node_arr.size(); ++i) {
+    node_arr[i] = node_arr[static_cast<size_t>(node_arr[i])];
+    if (node_arr[i] == static_cast<int32_t>(i)) ++stats.num_components;
+  }
+
+  RunSorter<CompEdge, CompBySeq> by_comp(s.path("comp"), records_for(budget, sizeof(CompEdge)),
+                                         &s.counters);
+  {
+    RecordReader<IdEdge> in;
+    if (!in.open(id_edge_path, edge_chunk)) return false;
+    IdEdge e;
+    while (in.next(&e)) {
+      if (!by_comp.push({node_arr[static_cast<size_t>(e.id1)], e.id1, e.id2, e.img1, e.img2, 0,
+                         e.seq}))
+        return false;
+    }
+  }
+  std::error_code ec;
+  fs::remove(id_edge_path, ec);
+  // Half the budget for the run read buffers, half for the replay state of one component.
+  if (!by_comp.finish(budget / 2)) return false;
+
+  // Replay each component in serial order with the conflict rule.  Parent links live in node_arr
+  // (global ids; a union keeps the smaller root, so parent < child and the root of a track is its
+  // smallest node id), so the only extra state is the sorted image list of every multi-node root
+  // of the current component.  Edges are streamed, never held.  A component whose image lists
+  // outgrow their share of the budget is still replayed exactly, past memory_budget_bytes, and
+  // reported in stats.over_budget_components: exactness needs that component's state at once.
+  for (int32_t i = 0; i < static_cast<int32_t>(num_nodes); ++i) node_arr[static_cast<size_t>(i)] = i;
+  {
+    const size_t replay_share = budget / 2;
+    std::unordered_map<int32_t, std::vector<uint32_t>> images;  // root → images (≥ 2 nodes)
+    std::vector<uint32_t> merged_images;
+    size_t replay_bytes = 0;
+    bool over_budget = false;
+    int32_t comp = -1;
+    int64_t comp_edges = 0;
+    auto list_of = [&images](int32_t root, const uint32_t& single) -> const uint32_t* {
+      auto it = images.find(root);
+      return it == images.end() ? &single : it->second.data();
+    };
+    auto size_of = [&images](int32_t root) -> size_t {
+      auto it = images.find(root);
+      return it == images.end() ? 1 : it->second.size();
+    };
+    auto end_component = [&]() {
+      stats.largest_component_edges = std::max(stats.largest_component_edges, comp_edges);
+      if (over_budget) ++stats.over_budget_components;
+      if (images.bucket_count() > 4096) decltype(images)().swap(images);  // clear() is O(buckets)
+      images.clear();
+      replay_bytes = 0;
+      over_budget = false;
+      comp_edges = 0;
+    };
+    CompEdge e;
+    while (by_comp.next(&e)) {
+      if (e.comp != comp) {
+        if (comp_edges > 0) end_component();
+        comp = e.comp;
+      }
+      ++comp_edges;
+      const int32_t a = find(e.id1);
+      const int32_t b = find(e.id2);
+      if (a == b) {
+        ++stats.merged;
+        continue;
+      }
+      // A root without an image list is a single node, i.e. the edge endpoint itself.
+      const size_t na = size_of(a), nb = size_of(b);
+      const uint32_t* ia = list_of(a, e.img1);
+      const uint32_t* ib = list_of(b, e.img2);
+      merged_images.resize(na + nb);
+      const auto last = std::set_union(ia, ia + na, ib, ib + nb, merged_images.begin());
+      if (static_cast<size_t>(last - merged_images.begin()) != na + nb) {
+        ++stats.rejected;  // both components already observe one image
+        continue;
+      }
+      ++stats.merged;
+      const int32_t root = std::min(a, b), child = std::max(a, b);
+      node_arr[static_cast<size_t>(child)] = root;
+      auto it = images.find(child);
+      if (it != images.end()) {
+        replay_bytes -= kReplayBytesPerRoot + it->second.capacity() * sizeof(uint32_t);
+        images.erase(it);
+      }
+      std::vector<uint32_t>& dst = images[root];
+      replay_bytes -= dst.empty() ? 0 : kReplayBytesPerRoot + dst.capacity() * sizeof(uint32_t);
+      dst.assign(merged_images.begin(), merged_images.end());
+      replay_bytes += kReplayBytesPerRoot + dst.capacity() * sizeof(uint32_t);
+      if (!over_budget && replay_bytes > replay_share) {
+        over_budget = true;
+        LOG(WARNING) << "ExternalTrackBuilder: connected component " << comp
+                     << " needs more than " << replay_share
+                     << " bytes to replay the conflict rule; replaying it past memory_budget_bytes="
+                     << budget;
+      }
+    }
+    if (comp_edges > 0) end_component();
+  }
+
+  // ── 5. Track ids in order of smallest node key; observations sorted by (track, key) ─
+  int32_t num_tracks = 0;
+  for (size_t i = 0; i < node_arr.size(); ++i) {
+    // node_arr[i] <= i: representatives are renumbered before their members are reached.
+    if (node_arr[i] == static_cast<int32_t>(i))
+      node_arr[i] = num_tracks++;
+    else
+      node_arr[i] = node_arr[static_cast<size_t>(node_arr[i])];
+  }
+  stats.num_tracks = num_tracks;
+  {
+    RunSorter<ObsRec, ObsByTrack> by_track(s.path("obs"), records_for(budget, sizeof(ObsRec)),
+                                           &s.counters);
+    RecordReader<NodeOut> nodes;
+    if (!nodes.open(node_path, node_chunk)) return false;
+    NodeOut n;
+    for (size_t i = 0; nodes.next(&n); ++i) {
+      if (!by_track.push({node_arr[i], 0, n.key, n.u, n.v, n.s, 0})) return false;
+    }
+    std::vector<int32_t>().swap(node_arr);
+    if (!by_track.finish(budget)) return false;
+    ObsRec o;
+    while (by_track.next(&o)) sink(o.track, o.key, o.u, o.v, o.s);
+  }
+  fs::remove(node_path, ec);
+
+  stats.num_runs = s.counters.runs;
+  stats.spill_bytes = s.counters.bytes;
+  if (stats_out) *stats_out = stats;
+  return true;
+}
+
+}  // namespace sfm
+}  // namespace insight
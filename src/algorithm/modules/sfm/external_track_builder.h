@@ -0,0 +1,107 @@
+/**
+ * @file  external_track_builder.h
+ * @brief Out-of-core track building: inlier matches are spilled to sorted run files and tracks
+ *        are formed by sort/merge passes under a memory budget.
+ *
+ * Design
+ * ──────
+ * Produces exactly the tracks of TrackUnionFind::merge_keys() over the same match sequence
+ * (same-image conflict rule included) without the in-memory node_key → node hash map and
+ * per-component image lists.
+ *
+ *   1. add_pairs()  every match gets a global sequence number; edge records (k1, k2, seq) and
+ *                   node records (key, seq, u, v, s) are buffered and spilled as sorted runs.
+ *   2. nodes        node runs merged by (key, seq): unique nodes with first-seen coords, dense
+ *                   node id = rank in key order, written to a node file.
+ *   3. join         edge keys replaced by node ids with two sort/merge joins against the node file.
+ *   4. components   connected components *ignoring* the conflict rule (one int32 per node).
+ *                   The conflict rule only removes edges, so every final track lies inside one of
+ *                   these components, and a merge decision only depends on earlier edges of the
+ *                   same component.  Edges are therefore sorted by (component, seq) and each
+ *                   component is replayed with the conflict rule (parent links in the per-node
+ *                   array, sorted image lists per multi-node root): the result is identical to
+ *                   the global serial merge.
+ *   5. output       tracks numbered by their smallest node key; observations emitted sorted by
+ *                   (track_id, image_index, feature_id) through a final sorted spill.
+ *
+ * Memory: sort buffers stay within memory_budget_bytes; on top of that the builder keeps one
+ * int32 per unique feature (stage 4/5).  The component replay streams its edges and gets half of
+ * the budget for the image lists of one component (~96 B per multi-node track + 4 B per feature).
+ * Fallback: a larger component (noisy matches can chain most features into one component
+ * before the conflict rule splits it) is still replayed exactly, exceeding the budget by its
+ * replay state, with a warning and ExternalTrackStats::over_budget_components > 0.  That state
+ * holds no per-feature hash entries or coords, so it stays below what the in-memory union-find
+ * needs for the same features.
+ *
+ * Usage
+ * ─────
+ *   ExternalTrackBuilder builder({budget_bytes, "/local/tmp"});
+ *   builder.add_pairs(block);                  // repeatedly, in processing order
+ *   builder.build([&](int track_id, uint64_t key, float u, float v, float s) { ... }, &stats);
+ */
+
+#pragma once
+
+#ifndef EXTERNAL_TRACK_BUILDER_H
+#define EXTERNAL_TRACK_BUILDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "track_union_find.h"
+
+namespace insight {
+namespace sfm {
+
+struct ExternalTrackBuilderOptions {
+  size_t memory_budget_bytes = size_t(1) << 30;
+  std::string spill_dir;  ///< Directory for run files (empty = system temp directory)
+};
+
+struct ExternalTrackStats {
+  int64_t num_matches = 0;
+  int64_t merged = 0;    ///< matches accepted (same as TrackUnionFind::merge_keys returning true)
+  int64_t rejected = 0;  ///< matches rejected by the same-image conflict rule
+  int64_t num_nodes = 0;  ///< unique (image, feature) pairs
+  int64_t num_tracks = 0;
+  int64_t num_components = 0;  ///< connected components before the conflict rule
+  int64_t largest_component_edges = 0;
+  int64_t over_budget_components = 0;  ///< components replayed past half of memory_budget_bytes
+  int num_runs = 0;             ///< sorted run files written (all stages)
+  int64_t spill_bytes = 0;      ///< bytes written to spill files (all stages)
+};
+
+/// Receives observations sorted by (track_id, image_index, feature_id); track ids are dense.
+using TrackObservationSink =
+    std::function<void(int track_id, uint64_t node_key, float u, float v, float scale)>;
+
+class ExternalTrackBuilder {
+ public:
+  explicit ExternalTrackBuilder(const ExternalTrackBuilderOptions& options);
+  ~ExternalTrackBuilder();  // removes the spill directory
+  ExternalTrackBuilder(const ExternalTrackBuilder&) = delete;
+  ExternalTrackBuilder& operator=(const ExternalTrackBuilder&) = delete;
+
+  /// Append matches in processing order (same order the serial union-find would merge them).
+  /// Returns false on spill I/O failure.
+  bool add_pairs(const std::vector<TrackPairMatches>& pairs);
+
+  /// Run stages 2–5 and stream the observations to `sink`.  Call once, after all add_pairs().
+  bool build(const TrackObservationSink& sink, ExternalTrackStats* stats = nullptr);
+
+  const std::string& spill_directory() const { return spill_dir_; }
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+  std::string spill_dir_;
+};
+
+}  // namespace sfm
+}  // namespace insight
+
+#endif  // EXTERNAL_TRACK_BUILDER_H
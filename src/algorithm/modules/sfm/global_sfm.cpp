@@ -0,0 +1,817 @@
+/**
+ * @file  global_sfm.cpp
+ * @brief Rotation / translation averaging and the global SfM driver (see global_sfm.h).
+ */
+
+#include "global_sfm.h"
+
+#include "incremental_triangulation.h"
+#include "view_graph_loader.h"
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <PoseLib/robust.h>
+#include <algorithm>
+#include <cmath>
+#include <glog/logging.h>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace insight {
+namespace sfm {
+
+namespace {
+
+constexpr double kDegToRad = M_PI / 180.0;
+
+inline uint64_t pair_key(uint32_t a, uint32_t b) {
+  if (a > b)
+    std::swap(a, b);
+  return (static_cast<uint64_t>(a) << 32) | b;
+}
+
+Eigen::Vector3d rotation_log(const Eigen::Matrix3d& R) {
+  const Eigen::AngleAxisd aa(R);
+  return aa.angle() * aa.axis();
+}
+
+Eigen::Matrix3d rotation_exp(const Eigen::Vector3d& w) {
+  const double angle = w.norm();
+  if (angle < 1e-12)
+    return Eigen::Matrix3d::Identity();
+  return Eigen::AngleAxisd(angle, w / angle).toRotationMatrix();
+}
+
+double rotation_angle_deg(const Eigen::Matrix3d& R) {
+  const double c = std::clamp((R.trace() - 1.0) * 0.5, -1.0, 1.0);
+  return std::acos(c) / kDegToRad;
+}
+
+/// Relative rotation of \p e taking camera \p from to the other endpoint.
+inline Eigen::Matrix3d rotation_from(const RelativePoseEdge& e, int from) {
+  return from == e.image_i ? e.R_ij : Eigen::Matrix3d(e.R_ij.transpose());
+}
+
+struct UnionFind {
+  std::vector<int> parent;
+  explicit UnionFind(int n) : parent(static_cast<size_t>(n)) {
+    std::iota(parent.begin(), parent.end(), 0);
+  }
+  int find(int x) {
+    while (parent[static_cast<size_t>(x)] != x) {
+      parent[static_cast<size_t>(x)] = parent[static_cast<size_t>(parent[static_cast<size_t>(x)])];
+      x = parent[static_cast<size_t>(x)];
+    }
+    return x;
+  }
+  bool unite(int a, int b) {
+    a = find(a);
+    b = find(b);
+    if (a == b)
+      return false;
+    parent[static_cast<size_t>(std::max(a, b))] = std::min(a, b);
+    return true;
+  }
+};
+
+/// Images of the largest component spanned by \p edges (ties: component with the smallest image).
+/// Sorted ascending.
+std::vector<int> largest_component(int n_images, const std::vector<const RelativePoseEdge*>& edges) {
+  UnionFind uf(n_images);
+  std::vector<char> touched(static_cast<size_t>(n_images), 0);
+  for (const RelativePoseEdge* e : edges) {
+    uf.unite(e->image_i, e->image_j);
+    touched[static_cast<size_t>(e->image_i)] = touched[static_cast<size_t>(e->image_j)] = 1;
+  }
+  std::vector<int> size(static_cast<size_t>(n_images), 0);
+  for (int i = 0; i < n_images; ++i)
+    if (touched[static_cast<size_t>(i)])
+      ++size[static_cast<size_t>(uf.find(i))];
+  int best = -1;
+  for (int i = 0; i < n_images; ++i)
+    if (size[static_cast<size_t>(i)] > 0 && (best < 0 || size[static_cast<size_t>(i)] >
+                                                              size[static_cast<size_t>(best)]))
+      best = i;
+  std::vector<int> out;
+  if (best < 0)
+    return out;
+  for (int i = 0; i < n_images; ++i)
+    if (touched[static_cast<size_t>(i)] && uf.find(i) == best)
+      out.push_back(i);
+  return out;
+}
+
+/**
+ * Weighted least squares on a graph:  min Σ_k w_k ‖x_b − x_a − y_k‖²  with x_0 = 0.
+ * Edge k joins local nodes (a_k, b_k).  The graph must be connected; the three coordinates
+ * share one factorisation of the weighted Laplacian.
+ */
+bool solve_graph_least_squares(int n_nodes, const std::vector<int>& a, const std::vector<int>& b,
+                               const std::vector<double>& w, const Eigen::MatrixX3d& y,
+                               Eigen::MatrixX3d* x) {
+  x->setZero(n_nodes, 3);
+  if (n_nodes < 2)
+    return true;
+  const int m = n_nodes - 1; // node 0 is the gauge
+  std::vector<Eigen::Triplet<double>> trip;
+  trip.reserve(a.size() * 4);
+  Eigen::MatrixX3d rhs = Eigen::MatrixX3d::Zero(m, 3);
+  for (size_t k = 0; k < a.size(); ++k) {
+    const int ia = a[k] - 1, ib = b[k] - 1;
+    const double wk = w[k];
+    if (ia >= 0) {
+      trip.emplace_back(ia, ia, wk);
+      rhs.row(ia) -= wk * y.row(static_cast<Eigen::Index>(k));
+    }
+    if (ib >= 0) {
+      trip.emplace_back(ib, ib, wk);
+      rhs.row(ib) += wk * y.row(static_cast<Eigen::Index>(k));
+    }
+    if (ia >= 0 && ib >= 0) {
+      trip.emplace_back(ia, ib, -wk);
+      trip.emplace_back(ib, ia, -wk);
+    }
+  }
+  Eigen::SparseMatrix<double> L(m, m);
+  L.setFromTriplets(trip.begin(), trip.end());
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> ldlt(L);
+  if (ldlt.info() != Eigen::Success)
+    return false;
+  const Eigen::MatrixX3d sol = ldlt.solve(rhs);
+  if (ldlt.info() != Eigen::Success || !sol.allFinite())
+    return false;
+  x->bottomRows(m) = sol;
+  return true;
+}
+
+/**
+ * One weighted least-squares step of translation averaging (node 0 at the origin):
+ *   min Σ_k w_k ‖c_a − c_b − d_k v_k‖²,  d_k = 1 on bound edges, free otherwise.
+ * Free d_k are eliminated (residual = (I − v vᵀ)(c_a − c_b)), so the system couples the three
+ * coordinates; bound edges fix the scale.
+ */
+bool solve_translation_step(int n_nodes, const std::vector<int>& a, const std::vector<int>& b,
+                            const std::vector<Eigen::Vector3d>& v, const std::vector<double>& w,
+                            const std::vector<char>& bound, Eigen::MatrixX3d* c) {
+  c->setZero(n_nodes, 3);
+  if (n_nodes < 2)
+    return true;
+  const int m = 3 * (n_nodes - 1);
+  std::vector<Eigen::Triplet<double>> trip;
+  trip.reserve(a.size() * 36);
+  Eigen::VectorXd rhs = Eigen::VectorXd::Zero(m);
+  auto add_block = [&](int r, int col, const Eigen::Matrix3d& B) {
+    if (r < 0 || col < 0)
+      return;
+    for (int i = 0; i < 3; ++i)
+      for (int j = 0; j < 3; ++j)
+        if (B(i, j) != 0.0)
+          trip.emplace_back(3 * r + i, 3 * col + j, B(i, j));
+  };
+  for (size_t k = 0; k < a.size(); ++k) {
+    const int ia = a[k] - 1, ib = b[k] - 1;
+    const Eigen::Matrix3d B =
+        w[k] * (bound[k] ? Eigen::Matrix3d::Identity()
+                         : Eigen::Matrix3d(Eigen::Matrix3d::Identity() - v[k] * v[k].transpose()));
+    add_block(ia, ia, B);
+    add_block(ib, ib, B);
+    add_block(ia, ib, -B);
+    add_block(ib, ia, -B);
+    if (bound[k]) {
+      if (ia >= 0)
+        rhs.segment<3>(3 * ia) += w[k] * v[k];
+      if (ib >= 0)
+        rhs.segment<3>(3 * ib) -= w[k] * v[k];
+    }
+  }
+  Eigen::SparseMatrix<double> L(m, m);
+  L.setFromTriplets(trip.begin(), trip.end());
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> ldlt(L);
+  if (ldlt.info() != Eigen::Success)
+    return false;
+  const Eigen::VectorXd sol = ldlt.solve(rhs);
+  if (ldlt.info() != Eigen::Success || !sol.allFinite())
+    return false;
+  for (int n = 1; n < n_nodes; ++n)
+    c->row(n) = sol.segment<3>(3 * (n - 1)).transpose();
+  return true;
+}
+
+/// Sampson-error inliers of \p pose (normalised coordinates, X_b = R X_a + t) below \p thresh.
+size_t sampson_inliers(const std::vector<poselib::Point2D>& xa,
+                       const std::vector<poselib::Point2D>& xb, const poselib::CameraPose& pose,
+                       double thresh, std::vector<char>* inliers) {
+  Eigen::Matrix3d tx;
+  tx << 0.0, -pose.t(2), pose.t(1), pose.t(2), 0.0, -pose.t(0), -pose.t(1), pose.t(0), 0.0;
+  const Eigen::Matrix3d E = tx * pose.R();
+  const double thresh2 = thresh * thresh;
+  inliers->assign(xa.size(), 0);
+  size_t n = 0;
+  for (size_t k = 0; k < xa.size(); ++k) {
+    const Eigen::Vector3d a = xa[k].homogeneous();
+    const Eigen::Vector3d b = xb[k].homogeneous();
+    const Eigen::Vector3d Ea = E * a;
+    const Eigen::Vector3d Etb = E.transpose() * b;
+    const double c = b.dot(Ea);
+    const double denom = Ea.head<2>().squaredNorm() + Etb.head<2>().squaredNorm();
+    if (denom > 0.0 && c * c < thresh2 * denom) {
+      (*inliers)[k] = 1;
+      ++n;
+    }
+  }
+  return n;
+}
+
+double median_inplace(std::vector<double>* v) {
+  if (v->empty())
+    return 0.0;
+  const size_t mid = v->size() / 2;
+  std::nth_element(v->begin(), v->begin() + static_cast<std::ptrdiff_t>(mid), v->end());
+  return (*v)[mid];
+}
+
+} // namespace
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Relative poses
+// ─────────────────────────────────────────────────────────────────────────────
+
+void estimate_relative_poses(const ViewGraph& view_graph, const TrackStore& store,
+                             const std::vector<camera::Intrinsics>& cameras,
+                             const std::vector<int>& image_to_camera_index,
+                             const GlobalSfMOptions& opts, std::vector<RelativePoseEdge>* edges) {
+  edges->clear();
+  const int n_images = store.num_images();
+  std::vector<std::pair<int, int>> pairs;
+  {
+    std::unordered_set<uint64_t> seen;
+    for (size_t i = 0; i < view_graph.num_pairs(); ++i) {
+      const PairGeoInfo& p = view_graph.pair_at(i);
+      const int a = static_cast<int>(std::min(p.image1_index, p.image2_index));
+      const int b = static_cast<int>(std::max(p.image1_index, p.image2_index));
+      if (a == b || b >= n_images || !seen.insert(pair_key(a, b)).second)
+        continue;
+      pairs.emplace_back(a, b);
+    }
+  }
+
+  // Pairs isat_geo already solved (--twoview R/t): that pose is checked and refined on the track
+  // correspondences; only pairs without one (or whose pose the tracks reject) run RANSAC.
+  std::vector<Eigen::Matrix3d> geo_R;
+  std::vector<Eigen::Vector3d> geo_t;
+  std::vector<char> has_geo(pairs.size(), 0);
+  if (!opts.geo_dir.empty()) {
+    std::vector<std::pair<uint32_t, uint32_t>> geo_pairs;
+    geo_pairs.reserve(pairs.size());
+    for (const auto& ab : pairs)
+      geo_pairs.emplace_back(static_cast<uint32_t>(ab.first), static_cast<uint32_t>(ab.second));
+    const size_t n_geo =
+        load_two_view_poses_from_geo_dir(opts.geo_dir, geo_pairs, &geo_R, &geo_t, &has_geo);
+    LOG(INFO) << "estimate_relative_poses: two-view poses for " << n_geo << " / " << pairs.size()
+              << " pairs in " << opts.geo_dir;
+  }
+
+  std::vector<RelativePoseEdge> results(pairs.size());
+  std::vector<char> ok(pairs.size(), 0);
+  std::vector<char> seeded(pairs.size(), 0);
+#pragma omp parallel for schedule(dynamic, 4)
+  for (int p = 0; p < static_cast<int>(pairs.size()); ++p) {
+    const int a = pairs[static_cast<size_t>(p)].first;
+    const int b = pairs[static_cast<size_t>(p)].second;
+    const int ca = image_to_camera_index[static_cast<size_t>(a)];
+    const int cb = image_to_camera_index[static_cast<size_t>(b)];
+    if (ca < 0 || cb < 0 || ca >= static_cast<int>(cameras.size()) ||
+        cb >= static_cast<int>(cameras.size()))
+      continue;
+
+    // Tracks seen in both images → normalised correspondences.
+    std::vector<poselib::Point2D> xa, xb;
+    std::vector<std::pair<int, int>> obs_pairs;
+    for (int oa : store.image_all_obs_ids_view(a)) {
+      if (!store.is_obs_valid(oa))
+        continue;
+      const int tid = store.obs_track_id(oa);
+      if (!store.is_track_valid(tid))
+        continue;
+      for (int ob : store.track_all_obs_ids_view(tid)) {
+        if (store.obs_image_index(ob) != static_cast<uint32_t>(b) || !store.is_obs_valid(ob))
+          continue;
+        double ua, va, ub, vb;
+        if (store.obs_undistorted_normalized(oa, &ua, &va) &&
+            store.obs_undistorted_normalized(ob, &ub, &vb)) {
+          xa.emplace_back(ua, va);
+          xb.emplace_back(ub, vb);
+          obs_pairs.emplace_back(oa, ob);
+        }
+        break;
+      }
+    }
+    if (static_cast<int>(xa.size()) < opts.rel_pose_min_inliers)
+      continue;
+
+    const camera::Intrinsics& Ka = cameras[static_cast<size_t>(ca)];
+    const camera::Intrinsics& Kb = cameras[static_cast<size_t>(cb)];
+    const double focal = 0.25 * (Ka.fx + Ka.fy + Kb.fx + Kb.fy);
+    const double thresh = opts.rel_pose_max_error_px / std::max(focal, 1.0);
+    const poselib::Camera unit_cam(poselib::CameraModelId::PINHOLE, {1.0, 1.0, 0.0, 0.0});
+    poselib::RelativePoseOptions pl_opt;
+    pl_opt.max_error = thresh;
+    pl_opt.ransac.max_iterations = static_cast<size_t>(opts.rel_pose_ransac_max_iterations);
+    pl_opt.ransac.min_iterations =
+        std::min<size_t>(100, static_cast<size_t>(opts.rel_pose_ransac_max_iterations));
+    pl_opt.bundle.max_iterations = 100;
+    pl_opt.bundle.loss_type = poselib::BundleOptions::CAUCHY;
+    pl_opt.bundle.loss_scale = thresh;
+    poselib::CameraPose pose;
+    std::vector<char> inliers;
+    size_t num_inliers = 0;
+    const size_t min_inliers = static_cast<size_t>(opts.rel_pose_min_inliers);
+    if (has_geo[static_cast<size_t>(p)] && geo_t[static_cast<size_t>(p)].norm() > 1e-12) {
+      const Eigen::Quaterniond q(geo_R[static_cast<size_t>(p)]);
+      pose = poselib::CameraPose(q.normalized().toRotationMatrix(),
+                                 geo_t[static_cast<size_t>(p)].normalized());
+      if (sampson_inliers(xa, xb, pose, thresh, &inliers) >= min_inliers) {
+        std::vector<poselib::Point2D> ia, ib;
+        for (size_t k = 0; k < inliers.size(); ++k) {
+          if (inliers[k]) {
+            ia.push_back(xa[k]);
+            ib.push_back(xb[k]);
+          }
+        }
+        poselib::refine_relpose(ia, ib, &pose, pl_opt.bundle);
+        num_inliers = pose.t.norm() > 1e-12 ? sampson_inliers(xa, xb, pose, thresh, &inliers) : 0;
+      }
+      seeded[static_cast<size_t>(p)] = num_inliers >= min_inliers ? 1 : 0;
+    }
+    if (num_inliers < min_inliers) {
+      const poselib::RansacStats stats =
+          poselib::estimate_relative_pose(xa, xb, unit_cam, unit_cam, pl_opt, &pose, &inliers);
+      num_inliers = stats.num_inliers;
+    }
+    if (num_inliers < min_inliers || pose.t.norm() < 1e-12)
+      continue;
+
+    RelativePoseEdge& e = results[static_cast<size_t>(p)];
+    e.image_i = a;
+    e.image_j = b;
+    e.R_ij = pose.R();
+    e.t_ij = pose.t.normalized();
+    e.translation_ok = true;
+    e.num_inliers = static_cast<int>(num_inliers);
+    e.inlier_obs.reserve(num_inliers);
+    for (size_t k = 0; k < inliers.size(); ++k)
+      if (inliers[k])
+        e.inlier_obs.push_back(obs_pairs[k]);
+    ok[static_cast<size_t>(p)] = 1;
+  }
+
+  for (size_t p = 0; p < pairs.size(); ++p)
+    if (ok[p])
+      edges->push_back(std::move(results[p]));
+  if (!opts.geo_dir.empty())
+    LOG(INFO) << "estimate_relative_poses: " << std::count(seeded.begin(), seeded.end(), 1)
+              << " pairs from the two-view pose, "
+              << (edges->size() - static_cast<size_t>(std::count(seeded.begin(), seeded.end(), 1)))
+              << " re-estimated by RANSAC";
+}
+
+int filter_edges_by_loop_consistency(std::vector<RelativePoseEdge>* edges, double max_error_deg) {
+  int n_images = 0;
+  for (const RelativePoseEdge& e : *edges)
+    n_images = std::max(n_images, e.image_j + 1);
+  std::unordered_map<uint64_t, int> edge_index;
+  edge_index.reserve(edges->size() * 2);
+  std::vector<std::vector<int>> neighbours(static_cast<size_t>(n_images));
+  for (size_t k = 0; k < edges->size(); ++k) {
+    const RelativePoseEdge& e = (*edges)[k];
+    edge_index.emplace(pair_key(e.image_i, e.image_j), static_cast<int>(k));
+    neighbours[static_cast<size_t>(e.image_i)].push_back(e.image_j);
+    neighbours[static_cast<size_t>(e.image_j)].push_back(e.image_i);
+  }
+  for (auto& nb : neighbours)
+    std::sort(nb.begin(), nb.end());
+
+  std::vector<char> keep(edges->size(), 1);
+#pragma omp parallel for schedule(dynamic, 16)
+  for (int k = 0; k < static_cast<int>(edges->size()); ++k) {
+    const RelativePoseEdge& e = (*edges)[static_cast<size_t>(k)];
+    const std::vector<int>& ni = neighbours[static_cast<size_t>(e.image_i)];
+    const std::vector<int>& nj = neighbours[static_cast<size_t>(e.image_j)];
+    int n_triangles = 0;
+    bool consistent = false;
+    for (size_t u = 0, v = 0; u < ni.size() && v < nj.size() && !consistent;) {
+      if (ni[u] < nj[v]) {
+        ++u;
+      } else if (nj[v] < ni[u]) {
+        ++v;
+      } else {
+        const int third = ni[u];
+        const RelativePoseEdge& e_ik =
+            (*edges)[static_cast<size_t>(edge_index.at(pair_key(e.image_i, third)))];
+        const RelativePoseEdge& e_jk =
+            (*edges)[static_cast<size_t>(edge_index.at(pair_key(e.image_j, third)))];
+        const Eigen::Matrix3d cycle =
+            rotation_from(e_ik, e.image_i).transpose() * rotation_from(e_jk, e.image_j) * e.R_ij;
+        ++n_triangles;
+        consistent = rotation_angle_deg(cycle) <= max_error_deg;
+        ++u;
+        ++v;
+      }
+    }
+    if (n_triangles > 0 && !consistent)
+      keep[static_cast<size_t>(k)] = 0;
+  }
+
+  int removed = 0;
+  size_t w = 0;
+  for (size_t k = 0; k < edges->size(); ++k) {
+    if (!keep[k]) {
+      ++removed;
+      continue;
+    }
+    if (w != k)
+      (*edges)[w] = std::move((*edges)[k]);
+    ++w;
+  }
+  edges->resize(w);
+  return removed;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Rotation averaging
+// ─────────────────────────────────────────────────────────────────────────────
+
+bool average_rotations(int n_images, const std::vector<RelativePoseEdge>& edges,
+                       const GlobalSfMOptions& opts, std::vector<Eigen::Matrix3d>* rotations,
+                       std::vector<bool>* valid) {
+  rotations->assign(static_cast<size_t>(n_images), Eigen::Matrix3d::Identity());
+  valid->assign(static_cast<size_t>(n_images), false);
+
+  std::vector<const RelativePoseEdge*> all;
+  all.reserve(edges.size());
+  for (const RelativePoseEdge& e : edges)
+    if (e.image_i >= 0 && e.image_j < n_images)
+      all.push_back(&e);
+  const std::vector<int> component = largest_component(n_images, all);
+  if (component.size() < 2)
+    return false;
+  std::vector<int> local(static_cast<size_t>(n_images), -1);
+  for (size_t n = 0; n < component.size(); ++n)
+    local[static_cast<size_t>(component[n])] = static_cast<int>(n);
+  std::vector<const RelativePoseEdge*> comp_edges;
+  for (const RelativePoseEdge* e : all)
+    if (local[static_cast<size_t>(e->image_i)] >= 0)
+      comp_edges.push_back(e);
+
+  // Initialisation: maximum spanning tree on inlier counts, rotations chained from image 0.
+  const int m = static_cast<int>(component.size());
+  std::vector<Eigen::Matrix3d> R(static_cast<size_t>(m), Eigen::Matrix3d::Identity());
+  {
+    std::vector<const RelativePoseEdge*> order = comp_edges;
+    std::stable_sort(order.begin(), order.end(),
+                     [](const RelativePoseEdge* x, const RelativePoseEdge* y) {
+                       return x->num_inliers > y->num_inliers;
+                     });
+    UnionFind uf(m);
+    std::vector<std::vector<const RelativePoseEdge*>> tree(static_cast<size_t>(m));
+    for (const RelativePoseEdge* e : order) {
+      const int a = local[static_cast<size_t>(e->image_i)];
+      const int b = local[static_cast<size_t>(e->image_j)];
+      if (uf.unite(a, b)) {
+        tree[static_cast<size_t>(a)].push_back(e);
+        tree[static_cast<size_t>(b)].push_back(e);
+      }
+    }
+    std::vector<char> done(static_cast<size_t>(m), 0);
+    std::vector<int> queue{0};
+    done[0] = 1;
+    for (size_t q = 0; q < queue.size(); ++q) {
+      const int cur = queue[q];
+      const int cur_image = component[static_cast<size_t>(cur)];
+      for (const RelativePoseEdge* e : tree[static_cast<size_t>(cur)]) {
+        const int other_image = e->image_i == cur_image ? e->image_j : e->image_i;
+        const int other = local[static_cast<size_t>(other_image)];
+        if (done[static_cast<size_t>(other)])
+          continue;
+        R[static_cast<size_t>(other)] = rotation_from(*e, cur_image) * R[static_cast<size_t>(cur)];
+        done[static_cast<size_t>(other)] = 1;
+        queue.push_back(other);
+      }
+    }
+  }
+
+  // Linearised problem per iteration: R_i ← R_i exp(w_i), and each edge asks
+  // w_j − w_i = log(R_jᵀ R_ij R_i).  Solved as a weighted graph least squares (w_0 = 0).
+  const size_t n_edges = comp_edges.size();
+  std::vector<int> ea(n_edges), eb(n_edges);
+  for (size_t k = 0; k < n_edges; ++k) {
+    ea[k] = local[static_cast<size_t>(comp_edges[k]->image_i)];
+    eb[k] = local[static_cast<size_t>(comp_edges[k]->image_j)];
+  }
+  Eigen::MatrixX3d y(static_cast<Eigen::Index>(n_edges), 3);
+  auto compute_residuals = [&]() {
+    for (size_t k = 0; k < n_edges; ++k)
+      y.row(static_cast<Eigen::Index>(k)) =
+          rotation_log(R[static_cast<size_t>(eb[k])].transpose() * comp_edges[k]->R_ij *
+                       R[static_cast<size_t>(ea[k])])
+              .transpose();
+  };
+  auto apply_update = [&](const Eigen::MatrixX3d& x) {
+    for (int n = 0; n < m; ++n)
+      R[static_cast<size_t>(n)] =
+          R[static_cast<size_t>(n)] * rotation_exp(x.row(n).transpose());
+    return x.rowwise().norm().maxCoeff();
+  };
+
+  std::vector<double> w(n_edges, 1.0);
+  Eigen::MatrixX3d x;
+  // L1 IRLS (weights 1 / |residual|): robust to the outliers left by the loop filter.
+  for (int it = 0; it < opts.rotation_l1_iterations; ++it) {
+    compute_residuals();
+    std::fill(w.begin(), w.end(), 1.0);
+    for (int inner = 0; inner < 5; ++inner) {
+      if (!solve_graph_least_squares(m, ea, eb, w, y, &x))
+        return false;
+      for (size_t k = 0; k < n_edges; ++k) {
+        const double r = (x.row(eb[k]) - x.row(ea[k]) - y.row(static_cast<Eigen::Index>(k))).norm();
+        w[k] = 1.0 / std::max(r, 1e-5);
+      }
+    }
+    if (apply_update(x) < 1e-7)
+      break;
+  }
+  // Geman-McClure IRLS refinement.
+  const double sigma2 = std::pow(opts.rotation_irls_sigma_deg * kDegToRad, 2);
+  for (int it = 0; it < opts.rotation_irls_iterations; ++it) {
+    compute_residuals();
+    for (size_t k = 0; k < n_edges; ++k) {
+      const double g = sigma2 / (sigma2 + y.row(static_cast<Eigen::Index>(k)).squaredNorm());
+      w[k] = g * g;
+    }
+    if (!solve_graph_least_squares(m, ea, eb, w, y, &x))
+      return false;
+    if (apply_update(x) < 1e-7)
+      break;
+  }
+
+  for (int n = 0; n < m; ++n) {
+    const size_t im = static_cast<size_t>(component[static_cast<size_t>(n)]);
+    (*rotations)[im] = R[static_cast<size_t>(n)];
+    (*valid)[im] = true;
+  }
+  return true;
+}
+
+int filter_edges_by_rotation_residual(std::vector<RelativePoseEdge>* edges,
+                                      const std::vector<Eigen::Matrix3d>& rotations,
+                                      const std::vector<bool>& valid, double max_residual_deg) {
+  const size_t before = edges->size();
+  edges->erase(std::remove_if(edges->begin(), edges->end(),
+                              [&](const RelativePoseEdge& e) {
+                                const size_t i = static_cast<size_t>(e.image_i);
+                                const size_t j = static_cast<size_t>(e.image_j);
+                                if (!valid[i] || !valid[j])
+                                  return true;
+                                return rotation_angle_deg(rotations[j].transpose() * e.R_ij *
+                                                          rotations[i]) > max_residual_deg;
+                              }),
+               edges->end());
+  return static_cast<int>(before - edges->size());
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Translations
+// ─────────────────────────────────────────────────────────────────────────────
+
+void refine_relative_translations(const TrackStore& store,
+                                  const std::vector<Eigen::Matrix3d>& rotations,
+                                  const GlobalSfMOptions& opts,
+                                  std::vector<RelativePoseEdge>* edges) {
+#pragma omp parallel for schedule(dynamic, 16)
+  for (int k = 0; k < static_cast<int>(edges->size()); ++k) {
+    RelativePoseEdge& e = (*edges)[static_cast<size_t>(k)];
+    const Eigen::Matrix3d R =
+        rotations[static_cast<size_t>(e.image_j)] * rotations[static_cast<size_t>(e.image_i)].transpose();
+    e.R_ij = R;
+    e.translation_ok = false;
+
+    // Epipolar constraint with known R:  t · ((R f_i) × f_j) = 0  for every inlier.
+    std::vector<Eigen::Vector3d> rays_i, rays_j;
+    rays_i.reserve(e.inlier_obs.size());
+    rays_j.reserve(e.inlier_obs.size());
+    std::vector<double> parallax;
+    parallax.reserve(e.inlier_obs.size());
+    Eigen::Matrix3d AtA = Eigen::Matrix3d::Zero();
+    for (const auto& [oi, oj] : e.inlier_obs) {
+      double xi, yi, xj, yj;
+      if (!store.obs_undistorted_normalized(oi, &xi, &yi) ||
+          !store.obs_undistorted_normalized(oj, &xj, &yj))
+        continue;
+      const Eigen::Vector3d fi = (R * Eigen::Vector3d(xi, yi, 1.0)).normalized();
+      const Eigen::Vector3d fj = Eigen::Vector3d(xj, yj, 1.0).normalized();
+      const Eigen::Vector3d row = fi.cross(fj);
+      AtA += row * row.transpose();
+      parallax.push_back(std::acos(std::clamp(fi.dot(fj), -1.0, 1.0)) / kDegToRad);
+      rays_i.push_back(fi);
+      rays_j.push_back(fj);
+    }
+    if (rays_i.size() < 5)
+      continue;
+    const Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> eig(AtA);
+    Eigen::Vector3d t = eig.eigenvectors().col(0);
+
+    // Cheirality: depths of  d_i (R f_i) − d_j f_j = −t  should be positive.
+    int front = 0, back = 0;
+    for (size_t n = 0; n < rays_i.size(); ++n) {
+      Eigen::Matrix<double, 3, 2> A;
+      A.col(0) = rays_i[n];
+      A.col(1) = -rays_j[n];
+      const Eigen::Vector2d d = (A.transpose() * A).ldlt().solve(-A.transpose() * t);
+      if (d(0) > 0.0 && d(1) > 0.0)
+        ++front;
+      else if (d(0) < 0.0 && d(1) < 0.0)
+        ++back;
+    }
+    if (back > front)
+      t = -t;
+    e.t_ij = t;
+    e.translation_ok = std::max(front, back) * 2 > static_cast<int>(rays_i.size()) &&
+                       median_inplace(&parallax) >= opts.min_translation_parallax_deg;
+  }
+}
+
+bool average_translations(int n_images, const std::vector<RelativePoseEdge>& edges,
+                          const std::vector<Eigen::Matrix3d>& rotations,
+                          const GlobalSfMOptions& opts, std::vector<Eigen::Vector3d>* centers,
+                          std::vector<bool>* valid) {
+  centers->assign(static_cast<size_t>(n_images), Eigen::Vector3d::Zero());
+  std::vector<const RelativePoseEdge*> usable;
+  for (const RelativePoseEdge& e : edges)
+    if (e.translation_ok && (*valid)[static_cast<size_t>(e.image_i)] &&
+        (*valid)[static_cast<size_t>(e.image_j)])
+      usable.push_back(&e);
+
+  // Two passes: solve, drop edges that disagree with the solution, solve again.
+  std::vector<int> component;
+  Eigen::MatrixX3d c;
+  for (int pass = 0; pass < 2; ++pass) {
+    component = largest_component(n_images, usable);
+    if (component.size() < 2)
+      return false;
+    std::vector<int> local(static_cast<size_t>(n_images), -1);
+    for (size_t n = 0; n < component.size(); ++n)
+      local[static_cast<size_t>(component[n])] = static_cast<int>(n);
+    std::vector<int> ea, eb;
+    std::vector<Eigen::Vector3d> v; // unit direction of c_i − c_j in the world frame
+    for (const RelativePoseEdge* e : usable) {
+      if (local[static_cast<size_t>(e->image_i)] < 0)
+        continue;
+      ea.push_back(local[static_cast<size_t>(e->image_i)]);
+      eb.push_back(local[static_cast<size_t>(e->image_j)]);
+      v.push_back((rotations[static_cast<size_t>(e->image_j)].transpose() * e->t_ij).normalized());
+    }
+    const size_t n_edges = v.size();
+    const int m = static_cast<int>(component.size());
+
+    // LUD IRLS:  min Σ ‖c_i − c_j − d_ij v_ij‖  s.t. d_ij ≥ 1.  Each step solves the weighted
+    // least squares jointly in c and d (active set on the bound), then reweights by 1/‖r‖.
+    std::vector<double> w(n_edges, 1.0);
+    std::vector<char> bound(n_edges, 1);
+    Eigen::MatrixX3d prev;
+    for (int it = 0; it < opts.translation_iterations; ++it) {
+      if (!solve_translation_step(m, ea, eb, v, w, bound, &c))
+        return false;
+      size_t tightest = 0;
+      double tightest_d = std::numeric_limits<double>::max();
+      bool any_bound = false;
+      for (size_t k = 0; k < n_edges; ++k) {
+        const Eigen::Vector3d diff = (c.row(ea[k]) - c.row(eb[k])).transpose();
+        const double dk = v[k].dot(diff);
+        bound[k] = dk <= 1.0 ? 1 : 0;
+        any_bound = any_bound || bound[k];
+        if (dk < tightest_d) {
+          tightest_d = dk;
+          tightest = k;
+        }
+        w[k] = 1.0 / std::max((diff - std::max(1.0, dk) * v[k]).norm(), 1e-3);
+      }
+      if (!any_bound)
+        bound[tightest] = 1; // keeps the scale fixed
+      if (it > 0 && (c - prev).rowwise().norm().maxCoeff() <
+                        1e-6 * std::max(1.0, c.rowwise().norm().maxCoeff()))
+        break;
+      prev = c;
+    }
+    if (pass == 1)
+      break;
+
+    std::vector<const RelativePoseEdge*> kept;
+    const double cos_max = std::cos(opts.translation_max_angle_deg * kDegToRad);
+    size_t k = 0;
+    for (const RelativePoseEdge* e : usable) {
+      if (local[static_cast<size_t>(e->image_i)] < 0)
+        continue;
+      const Eigen::Vector3d diff = (c.row(ea[k]) - c.row(eb[k])).transpose();
+      if (diff.norm() > 0.0 && v[k].dot(diff.normalized()) >= cos_max)
+        kept.push_back(e);
+      ++k;
+    }
+    LOG(INFO) << "average_translations: " << (n_edges - kept.size()) << " / " << n_edges
+              << " edges above " << opts.translation_max_angle_deg << " deg removed";
+    usable.swap(kept);
+  }
+
+  valid->assign(static_cast<size_t>(n_images), false);
+  for (size_t n = 0; n < component.size(); ++n) {
+    const size_t im = static_cast<size_t>(component[n]);
+    (*centers)[im] = c.row(static_cast<Eigen::Index>(n)).transpose();
+    (*valid)[im] = true;
+  }
+  return true;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Driver
+// ─────────────────────────────────────────────────────────────────────────────
+
+bool run_global_sfm(TrackStore* store, const ViewGraph& view_graph,
+                    const std::vector<int>& image_to_camera_index, const GlobalSfMOptions& opts,
+                    const IncrementalSfMOptions& ba_opts,
+                    std::vector<camera::Intrinsics>* cameras,
+                    std::vector<Eigen::Matrix3d>* poses_R, std::vector<Eigen::Vector3d>* poses_C,
+                    std::vector<bool>* registered) {
+  const int n_images = store->num_images();
+  if (static_cast<int>(image_to_camera_index.size()) != n_images) {
+    LOG(ERROR) << "run_global_sfm: " << n_images << " images in tracks, "
+               << image_to_camera_index.size() << " in project";
+    return false;
+  }
+  store->refresh_undistorted_cache(*cameras, image_to_camera_index);
+
+  std::vector<RelativePoseEdge> edges;
+  estimate_relative_poses(view_graph, *store, *cameras, image_to_camera_index, opts, &edges);
+  LOG(INFO) << "run_global_sfm: relative poses for " << edges.size() << " / "
+            << view_graph.num_pairs() << " pairs";
+  const int n_loop = filter_edges_by_loop_consistency(&edges, opts.loop_max_rotation_error_deg);
+  LOG(INFO) << "run_global_sfm: loop consistency removed " << n_loop << " edges";
+
+  std::vector<Eigen::Matrix3d> rotations;
+  std::vector<bool> valid;
+  if (!average_rotations(n_images, edges, opts, &rotations, &valid)) {
+    LOG(ERROR) << "run_global_sfm: rotation averaging failed";
+    return false;
+  }
+  const int n_rot = filter_edges_by_rotation_residual(&edges, rotations, valid,
+                                                      opts.rotation_max_residual_deg);
+  // Re-average without the outlier edges so they no longer bias the solution.
+  if (n_rot > 0 && !average_rotations(n_images, edges, opts, &rotations, &valid)) {
+    LOG(ERROR) << "run_global_sfm: rotation averaging failed after edge filtering";
+    return false;
+  }
+  LOG(INFO) << "run_global_sfm: rotations for "
+            << std::count(valid.begin(), valid.end(), true) << " images ("
+            << n_rot << " edges above " << opts.rotation_max_residual_deg << " deg removed)";
+
+  refine_relative_translations(*store, rotations, opts, &edges);
+  std::vector<Eigen::Vector3d> centers;
+  if (!average_translations(n_images, edges, rotations, opts, &centers, &valid)) {
+    LOG(ERROR) << "run_global_sfm: translation averaging failed";
+    return false;
+  }
+
+  *poses_R = std::move(rotations);
+  *poses_C = std::move(centers);
+  *registered = std::move(valid);
+  std::vector<int> reg_images;
+  for (int i = 0; i < n_images; ++i)
+    if ((*registered)[static_cast<size_t>(i)])
+      reg_images.push_back(i);
+  LOG(INFO) << "run_global_sfm: " << reg_images.size() << " / " << n_images
+            << " images with averaged poses";
+
+  const double min_angle = ba_opts.triangulation.min_angle_deg;
+  int n_tri = run_batch_triangulation(store, reg_images, *poses_R, *poses_C, *registered, *cameras,
+                                      image_to_camera_index, min_angle, nullptr,
+                                      opts.initial_commit_reproj_px);
+  LOG(INFO) << "run_global_sfm: triangulated " << n_tri << " tracks";
+
+  double rmse = 0.0;
+  if (!run_ba_with_outlier_detection(store, poses_R, poses_C, *registered, image_to_camera_index,
+                                     cameras, reg_images.front(),
+                                     static_cast<int>(reg_images.size()), ba_opts, &rmse)) {
+    LOG(ERROR) << "run_global_sfm: global BA failed";
+    return false;
+  }
+  // Tracks cleared by outlier rejection get another chance with the refined poses.
+  n_tri = run_full_scan_triangulation(store, *poses_R, *poses_C, *registered, *cameras,
+                                      image_to_camera_index, min_angle,
+                                      ba_opts.triangulation.commit_reproj_px);
+  LOG(INFO) << "run_global_sfm: global BA RMSE=" << rmse << " px, re-triangulated " << n_tri
+            << " tracks";
+  return true;
+}
+
+} // namespace sfm
+} // namespace insight
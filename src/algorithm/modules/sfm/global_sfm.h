@@ -0,0 +1,154 @@
+/**
+ * @file  global_sfm.h
+ * @brief Global SfM: rotation and translation averaging over the view graph, then one BA.
+ *
+ * Flow (driven by isat_global_sfm)
+ * ────────────────────────────────
+ *   1. estimate_relative_poses: per view-graph pair on the track correspondences (undistorted
+ *      normalised coordinates), in parallel: the isat_geo two-view pose when there is one (Sampson
+ *      inlier check + refinement), else 5-point RANSAC.  Keeps the inlier observation pairs.
+ *   2. filter_edges_by_loop_consistency: drop edges whose every triangle has a rotation cycle
+ *      error above the threshold.
+ *   3. average_rotations: maximum-spanning-tree initialisation, then an L1 IRLS pass followed by a
+ *      Geman-McClure IRLS refinement on the Lie algebra.  Edges with a large residual are dropped.
+ *   4. refine_relative_translations: with global rotations fixed, re-fit every pair's translation
+ *      direction from its inliers (linear epipolar constraint + cheirality).
+ *   5. average_translations: LUD-style IRLS on  ‖c_i − c_j − d_ij v_ij‖,  d_ij ≥ 1.
+ *   6. run_global_sfm: triangulate every track from the averaged poses, one global BA with
+ *      outlier rejection, then a full-scan retriangulation.
+ *
+ * Conventions: R_i is world-to-camera, c_i the camera centre.  A relative pose (i, j) maps
+ * camera-i coordinates to camera-j coordinates: X_j = R_ij X_i + t_ij, so R_ij = R_j R_iᵀ and
+ * t_ij ∝ R_j (c_i − c_j).
+ */
+
+#pragma once
+
+#include "../camera/camera_types.h"
+#include "incremental_sfm_pipeline.h"
+#include "track_store.h"
+#include "view_graph.h"
+#include <Eigen/Core>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace insight {
+namespace sfm {
+
+struct GlobalSfMOptions {
+  // ── Relative poses ────────────────────────────────────────────────────────
+  double rel_pose_max_error_px = 4.0; ///< RANSAC inlier threshold (converted with the mean focal).
+  int rel_pose_min_inliers = 30;
+  int rel_pose_ransac_max_iterations = 1000;
+  /// isat_geo output directory: pairs with a two-view R/t there start from it (inlier check +
+  /// refinement) instead of RANSAC.  Empty: every pair runs RANSAC.
+  std::string geo_dir;
+
+  // ── Rotations ─────────────────────────────────────────────────────────────
+  /// Triangle rotation cycle error above which a triangle is inconsistent.
+  double loop_max_rotation_error_deg = 5.0;
+  int rotation_l1_iterations = 10;
+  int rotation_irls_iterations = 20;
+  double rotation_irls_sigma_deg = 5.0; ///< Geman-McClure scale.
+  /// Edges whose residual to the averaged rotations exceeds this are removed.
+  double rotation_max_residual_deg = 5.0;
+
+  // ── Translations ──────────────────────────────────────────────────────────
+  /// Pairs whose median rotation-compensated ray angle is below this carry no usable translation
+  /// direction (still used for rotations).
+  double min_translation_parallax_deg = 1.0;
+  int translation_iterations = 50;
+  /// Edges whose direction disagrees with the averaged centres by more than this are removed
+  /// before the final translation solve.
+  double translation_max_angle_deg = 10.0;
+
+  // ── Triangulation ─────────────────────────────────────────────────────────
+  /// Commit threshold for the first triangulation from the averaged poses (poses are only
+  /// approximate before BA).
+  double initial_commit_reproj_px = 16.0;
+};
+
+/// One view-graph pair with its estimated relative pose (image_i < image_j).
+struct RelativePoseEdge {
+  int image_i = -1;
+  int image_j = -1;
+  Eigen::Matrix3d R_ij = Eigen::Matrix3d::Identity();
+  Eigen::Vector3d t_ij = Eigen::Vector3d::Zero(); ///< Unit length.
+  bool translation_ok = false;
+  int num_inliers = 0;
+  std::vector<std::pair<int, int>> inlier_obs; ///< (obs id in image_i, obs id in image_j).
+};
+
+/**
+ * Relative pose of every view-graph pair from the tracks both images observe.  The undistorted
+ * cache of \p store must be up to date (TrackStore::refresh_undistorted_cache).  Pairs with fewer
+ * than opts.rel_pose_min_inliers inliers are dropped.  Pairs with an isat_geo two-view pose in
+ * opts.geo_dir skip RANSAC unless the tracks reject that pose.  Parallel over pairs; output order
+ * follows the view graph.
+ */
+void estimate_relative_poses(const ViewGraph& view_graph, const TrackStore& store,
+                             const std::vector<camera::Intrinsics>& cameras,
+                             const std::vector<int>& image_to_camera_index,
+                             const GlobalSfMOptions& opts, std::vector<RelativePoseEdge>* edges);
+
+/**
+ * Remove edges that lie on at least one triangle but on no triangle whose rotation cycle error
+ * R_ikᵀ R_jk R_ij is within \p max_error_deg.  Edges on no triangle are kept.
+ * @return Number of edges removed.
+ */
+int filter_edges_by_loop_consistency(std::vector<RelativePoseEdge>* edges, double max_error_deg);
+
+/**
+ * Global rotations from relative rotations (largest connected component of \p edges).
+ * @param rotations  Out: size n_images; identity for images outside the component.
+ * @param valid      Out: size n_images; true for images in the component.
+ * @return false when no edge is usable.
+ */
+bool average_rotations(int n_images, const std::vector<RelativePoseEdge>& edges,
+                       const GlobalSfMOptions& opts, std::vector<Eigen::Matrix3d>* rotations,
+                       std::vector<bool>* valid);
+
+/// Remove edges whose angle between R_ij and R_j R_iᵀ exceeds \p max_residual_deg (or that touch
+/// an invalid image).  @return Number of edges removed.
+int filter_edges_by_rotation_residual(std::vector<RelativePoseEdge>* edges,
+                                      const std::vector<Eigen::Matrix3d>& rotations,
+                                      const std::vector<bool>& valid, double max_residual_deg);
+
+/**
+ * Replace R_ij by R_j R_iᵀ and re-fit t_ij from the inlier observations.  Sets translation_ok
+ * when the fit succeeds and the median rotation-compensated parallax reaches
+ * opts.min_translation_parallax_deg.
+ */
+void refine_relative_translations(const TrackStore& store,
+                                  const std::vector<Eigen::Matrix3d>& rotations,
+                                  const GlobalSfMOptions& opts,
+                                  std::vector<RelativePoseEdge>* edges);
+
+/**
+ * Camera centres from translation directions (edges with translation_ok, among \p valid images).
+ * Only the largest component connected by such edges is solved; \p valid is narrowed to it.
+ * The result is defined up to a similarity (first image of the component at the origin).
+ * @return false when fewer than two images are connected.
+ */
+bool average_translations(int n_images, const std::vector<RelativePoseEdge>& edges,
+                          const std::vector<Eigen::Matrix3d>& rotations,
+                          const GlobalSfMOptions& opts, std::vector<Eigen::Vector3d>* centers,
+                          std::vector<bool>* valid);
+
+/**
+ * Full global SfM on \p store: steps 1–5 above, then triangulation of all tracks, one global BA
+ * with outlier rejection (ba_opts.global_ba / ba_opts.outlier) and a full-scan retriangulation.
+ *
+ * @param cameras  In: initial intrinsics.  Out: refined intrinsics.
+ * @return false when rotation or translation averaging fails, or BA fails.
+ */
+bool run_global_sfm(TrackStore* store, const ViewGraph& view_graph,
+                    const std::vector<int>& image_to_camera_index, const GlobalSfMOptions& opts,
+                    const IncrementalSfMOptions& ba_opts,
+                    std::vector<camera::Intrinsics>* cameras,
+                    std::vector<Eigen::Matrix3d>* poses_R, std::vector<Eigen::Vector3d>* poses_C,
+                    std::vector<bool>* registered);
+
+} // namespace sfm
+} // namespace insight
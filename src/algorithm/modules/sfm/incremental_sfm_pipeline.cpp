@@ -12,6 +12,7 @@
 #include "bundle_adjustment_analytic.h"
 #include "resection.h"
 #include "scene_normalization.h"
+#include "sfm_checkpoint.h"
 #include "track_store.h"
 #include "two_view_reconstruction.h"
 #include "view_graph.h"
@@ -59,6 +60,14 @@ uint32_t IntrinsicsSchedule::fix_mask_for(int n_registered) const {
   return 0u;
 }
 
+int IntrinsicsSchedule::phase_for(int n_registered) const {
+  if (n_registered < phase1_min_images)
+    return 0;
+  if (n_registered < phase2_min_images)
+    return 1;
+  return n_registered < phase3_min_images ? 2 : 3;
+}
+
 std::vector<uint32_t>
 IntrinsicsSchedule::fix_masks_per_camera(const std::vector<bool>& registered,
                                          const std::vector<int>& image_to_camera_index,
@@ -1200,6 +1209,7 @@ InitPairTrialResult try_initial_pair_candidate(const TrackStore& store, int im0,
   struct TrackCorr {
     int tid;
     double u0, v0, u1, v1;
+    int obs0, obs1;
   };
   std::vector<TrackCorr> corrs;
   std::vector<Observation> obs_buf;
@@ -1208,6 +1218,7 @@ InitPairTrialResult try_initial_pair_candidate(const TrackStore& store, int im0,
     if (!store.is_track_valid(tid))
       continue;
     double u0 = 0, v0 = 0, u1 = 0, v1 = 0;
+    int obs0 = -1, obs1 = -1;
     bool has0 = false, has1 = false;
     const auto& track_obs_ids = store.track_all_obs_ids_view(tid);
     for (int obs_id : track_obs_ids) {
@@ -1217,17 +1228,19 @@ InitPairTrialResult try_initial_pair_candidate(const TrackStore& store, int im0,
       if (image_index == uim0) {
         u0 = static_cast<double>(store.obs_u(obs_id));
         v0 = static_cast<double>(store.obs_v(obs_id));
+        obs0 = obs_id;
         has0 = true;
       }
       if (image_index == uim1) {
         u1 = static_cast<double>(store.obs_u(obs_id));
         v1 = static_cast<double>(store.obs_v(obs_id));
+        obs1 = obs_id;
         has1 = true;
       }
     }
     if (!has0 || !has1)
       continue;
-    corrs.push_back({tid, u0, v0, u1, v1});
+    corrs.push_back({tid, u0, v0, u1, v1, obs0, obs1});
   }
 
   if (static_cast<int>(corrs.size()) < min_tracks_for_intital_pair) {
@@ -1304,14 +1317,20 @@ InitPairTrialResult try_initial_pair_candidate(const TrackStore& store, int im0,
   }
 
   // 3. Triangulate RANSAC-inlier tracks into LOCAL buffer (no store mutation).
+  const bool cached0 = store.undistorted_cache_matches(im0, K0);
+  const bool cached1 = store.undistorted_cache_matches(im1, K1);
+  auto normalized = [&store](const camera::Intrinsics& K, bool cached, int obs_id, double u,
+                             double v) {
+    Eigen::Vector2d n;
+    if (cached && store.obs_undistorted_normalized(obs_id, &n.x(), &n.y()))
+      return n;
+    if (K.has_distortion())
+      camera::undistort_point(K, u, v, &u, &v);
+    return Eigen::Vector2d((u - K.cx) / K.fx, (v - K.cy) / K.fy);
+  };
   for (const auto& c : corrs) {
-    double u0 = c.u0, v0 = c.v0, u1 = c.u1, v1 = c.v1;
-    if (K0.has_distortion())
-      camera::undistort_point(K0, u0, v0, &u0, &v0);
-    if (K1.has_distortion())
-      camera::undistort_point(K1, u1, v1, &u1, &v1);
-    Eigen::Vector2d n0((u0 - K0.cx) / K0.fx, (v0 - K0.cy) / K0.fy);
-    Eigen::Vector2d n1((u1 - K1.cx) / K1.fx, (v1 - K1.cy) / K1.fy);
+    const Eigen::Vector2d n0 = normalized(K0, cached0, c.obs0, c.u0, c.v0);
+    const Eigen::Vector2d n1 = normalized(K1, cached1, c.obs1, c.u1, c.v1);
     const Eigen::Vector3d t_cam = -R * C1;
     const Eigen::Vector3d X = triangulate_point(n0, n1, R, t_cam);
 
@@ -1654,6 +1673,7 @@ bool run_initial_pair_loop(
       << "Initial pair selection: first image by track correspondences, second by ViewGraph score";
   LOG(INFO) << "  n_images=" << n_images << ", n_tracks=" << store->num_tracks()
             << ", n_obs=" << store->num_observations();
+  store->refresh_undistorted_cache(cameras, image_to_camera_index);
   LOG(INFO) << "  min_tracks_for_intital_pair=" << min_tracks_for_intital_pair
             << ", min_num_inliers=" << min_num_inliers
             << ", max_forward_motion=" << max_forward_motion
@@ -2261,7 +2281,7 @@ bool build_ba_input_from_store(
   //   Pass A – iterate BA-window images (n_reg images × avg_obs/img),
   //            build track_ba_degree[tid] and track_ba_im_a/b for each tid seen ≥1 times.
   //            Cost: O(N_window_obs) — e.g. 383×~10K = ~3.8M ops, vs 400K×10 = 4M (similar)
-  //            but memory access pattern is image_obs_ids_[] which is sequential/warm.
+  //            but memory access pattern is image_obs_ CSR rows which is sequential/warm.
   //   Pass B – iterate only tids with track_ba_degree[tid] >= 2 (the accepted tracks),
   //            load track_all_obs_ids_view for those tracks only → O(N_accepted × avg_obs).
   //            Saves loading obs for N_tri_tracks - N_accepted ≈ 330K tracks.
@@ -2752,6 +2772,10 @@ bool run_global_ba(TrackStore* store, std::vector<Eigen::Matrix3d>* poses_R,
   ba_in.tikhonov_lambda = solver_overrides.tikhonov_lambda;
   if (solver_overrides.num_threads > 0)
     ba_in.num_threads = solver_overrides.num_threads;
+  ba_in.solver_backend =
+      solver_overrides.native_schur ? BASolverBackend::kNativeSchur : BASolverBackend::kCeres;
+  ba_in.native_preconditioner =
+      static_cast<BAPreconditioner>(solver_overrides.native_preconditioner);
   // Build per-camera intrinsics fix flags.
   // camera_frozen: frozen cameras keep kFixIntrAll (Schur-complement sparsity benefit).
   // partial_intr_fix_per_cam (priority): per-camera schedule mask based on each camera's own
@@ -2907,6 +2931,9 @@ bool run_local_ba(TrackStore* store, std::vector<Eigen::Matrix3d>* poses_R,
     ba_in.solver_parameter_tolerance = overrides.parameter_tolerance;
   if (overrides.num_threads > 0)
     ba_in.num_threads = overrides.num_threads;
+  ba_in.solver_backend =
+      overrides.native_schur ? BASolverBackend::kNativeSchur : BASolverBackend::kCeres;
+  ba_in.native_preconditioner = static_cast<BAPreconditioner>(overrides.native_preconditioner);
   int n_optimized = 0;
   for (size_t i = 0; i < ba_in.fix_pose.size(); ++i)
     if (!ba_in.fix_pose[i])
@@ -3249,6 +3276,9 @@ bool run_local_ba_colmap(TrackStore* store, std::vector<Eigen::Matrix3d>* poses_
     ba_in.solver_parameter_tolerance = overrides.parameter_tolerance;
   if (overrides.num_threads > 0)
     ba_in.num_threads = overrides.num_threads;
+  ba_in.solver_backend =
+      overrides.native_schur ? BASolverBackend::kNativeSchur : BASolverBackend::kCeres;
+  ba_in.native_preconditioner = static_cast<BAPreconditioner>(overrides.native_preconditioner);
   int n_variable = 0, n_constant = 0;
   for (bool f : ba_in.fix_pose) {
     if (f)
@@ -3581,6 +3611,9 @@ bool run_local_ba_batch_neighbor(
     ba_in.solver_parameter_tolerance = overrides.parameter_tolerance;
   if (overrides.num_threads > 0)
     ba_in.num_threads = overrides.num_threads;
+  ba_in.solver_backend =
+      overrides.native_schur ? BASolverBackend::kNativeSchur : BASolverBackend::kCeres;
+  ba_in.native_preconditioner = static_cast<BAPreconditioner>(overrides.native_preconditioner);
   BAResult ba_out;
   if (!global_bundle_analytic(ba_in, &ba_out, max_iterations)) {
     LOG(WARNING) << "run_local_ba_batch_neighbor: solver failed";
@@ -3820,6 +3853,10 @@ static void diagnose_track_structure(const TrackStore& store, const std::vector<
   }
 }
 
+/// Grid-NMS reselect cadence counter (run_ba_with_outlier_detection); file scope so that
+/// checkpoints can save and restore it.
+static thread_local int s_ba_grid_call_count = 0;
+
 // ─── Alternating BA: fallback when joint SPARSE_SCHUR/CHOLMOD fails ──────────
 //
 // When the joint Schur complement is not positive definite (e.g. due to near-collinear
@@ -4008,9 +4045,8 @@ bool run_ba_with_outlier_detection(TrackStore* store, std::vector<Eigen::Matrix3
 
   // Grid-NMS BA subset selection: recompute every ba_grid_reselect_every_n calls.
   if (opts.global_ba.ba_grid_subset && num_registered > 50) {
-    static thread_local int ba_grid_call_count = 0;
-    ++ba_grid_call_count;
-    if ((ba_grid_call_count - 1) % std::max(1, opts.global_ba.ba_grid_reselect_every_n) == 0) {
+    ++s_ba_grid_call_count;
+    if ((s_ba_grid_call_count - 1) % std::max(1, opts.global_ba.ba_grid_reselect_every_n) == 0) {
       using Clock = std::chrono::steady_clock;
       auto t0 = Clock::now();
       select_ba_subset(*store, *poses_C, registered, image_to_camera_index, *cameras,
@@ -4134,6 +4170,9 @@ bool run_ba_with_outlier_detection(TrackStore* store, std::vector<Eigen::Matrix3
     ba.tikhonov_lambda = ov.tikhonov_lambda;
     if (ov.num_threads > 0)
       ba.num_threads = ov.num_threads;
+    ba.solver_backend =
+        ov.native_schur ? BASolverBackend::kNativeSchur : BASolverBackend::kCeres;
+    ba.native_preconditioner = static_cast<BAPreconditioner>(ov.native_preconditioner);
 
     // Build per-camera intrinsics fix flags.
     {
@@ -4467,8 +4506,23 @@ bool run_incremental_sfm_pipeline(const std::string& tracks_idc_path,
     LOG(INFO) << "run_incremental_sfm_pipeline: omp_num_threads=" << opts.omp_num_threads;
   }
 
+  // Resume: tracks, poses, intrinsics and loop state come from the checkpoint; the input tracks
+  // IDC only contributes its embedded view graph (used by diagnostics after the loop).
+  const bool resuming = !opts.checkpoint.resume_from.empty();
+  SfMCheckpointState resume_state;
   ViewGraph view_graph;
-  if (!load_track_store_from_idc(tracks_idc_path, store_out, nullptr, &view_graph)) {
+  if (resuming) {
+    if (!load_sfm_checkpoint(opts.checkpoint.resume_from, &resume_state, store_out, poses_R_out,
+                             poses_C_out, registered_out, cameras)) {
+      LOG(ERROR) << "run_incremental_sfm_pipeline: failed to resume from "
+                 << opts.checkpoint.resume_from;
+      return false;
+    }
+    io::IDCReader vg_reader(tracks_idc_path);
+    if (vg_reader.is_valid() && vg_reader.get_metadata().contains("view_graph_pairs") &&
+        !view_graph_from_json_array(vg_reader.get_metadata()["view_graph_pairs"], &view_graph))
+      view_graph.clear();
+  } else if (!load_track_store_from_idc(tracks_idc_path, store_out, nullptr, &view_graph)) {
     LOG(ERROR) << "run_incremental_sfm_pipeline: failed to load tracks from " << tracks_idc_path;
     return false;
   }
@@ -4496,49 +4550,59 @@ bool run_incremental_sfm_pipeline(const std::string& tracks_idc_path,
   uint32_t local_im0 = 0, local_im1 = 0;
   uint32_t* im0_ptr = &local_im0;
   uint32_t* im1_ptr = &local_im1;
-  if (!run_initial_pair_loop(view_graph, store_out, *cameras, image_to_camera_index,
-                             opts.init.min_tracks_for_intital_pair,
-                             opts.init.min_num_inliers,
-                             opts.init.max_forward_motion,
-                             opts.init.min_angle_deg,
-                             opts.init.min_median_angle_deg,
-                             im0_ptr, im1_ptr, poses_R_out, poses_C_out, registered_out,
-                             opts.init.max_first_images, opts.init.max_second_images)) {
-    LOG(ERROR) << "run_incremental_sfm_pipeline: no initial pair succeeded";
-    return false;
-  }
-  int num_registered = 2;
+  int num_registered = 0;
+  if (resuming) {
+    local_im0 = static_cast<uint32_t>(resume_state.anchor_image);
+    local_im1 = static_cast<uint32_t>(resume_state.second_image);
+    num_registered = resume_state.num_registered;
+    LOG(INFO) << "Resumed from checkpoint seq=" << resume_state.seq
+              << " sfm_iter=" << resume_state.sfm_iter << ". Registered: " << num_registered
+              << "/" << n_images;
+  } else {
+    if (!run_initial_pair_loop(view_graph, store_out, *cameras, image_to_camera_index,
+                               opts.init.min_tracks_for_intital_pair,
+                               opts.init.min_num_inliers,
+                               opts.init.max_forward_motion,
+                               opts.init.min_angle_deg,
+                               opts.init.min_median_angle_deg,
+                               im0_ptr, im1_ptr, poses_R_out, poses_C_out, registered_out,
+                               opts.init.max_first_images, opts.init.max_second_images)) {
+      LOG(ERROR) << "run_incremental_sfm_pipeline: no initial pair succeeded";
+      return false;
+    }
+    num_registered = 2;
 
-  if (opts.max_registered_images > 0 && num_registered >= opts.max_registered_images) {
-    LOG(INFO) << "Early stop: max_registered_images reached at initial pair ("
-              << num_registered << "/" << opts.max_registered_images << ")";
-    return true;
-  }
+    if (opts.max_registered_images > 0 && num_registered >= opts.max_registered_images) {
+      LOG(INFO) << "Early stop: max_registered_images reached at initial pair ("
+                << num_registered << "/" << opts.max_registered_images << ")";
+      return true;
+    }
 
-  LOG(INFO) << "Initial pair done. Registered: " << num_registered << "/" << n_images;
-  // ── Initial-pair diagnostic ──────────────────────────────────────────────
-  {
-    const int ip0 = static_cast<int>(*im0_ptr);
-    const int ip1 = static_cast<int>(*im1_ptr);
-    VLOG(1) << "  Initial pair images: im0=" << ip0 << " im1=" << ip1;
-    const auto& C0 = (*poses_C_out)[static_cast<size_t>(ip0)];
-    const auto& C1 = (*poses_C_out)[static_cast<size_t>(ip1)];
-    VLOG(1) << "  C_im0=" << C0.transpose() << "  C_im1=" << C1.transpose()
-            << "  baseline=" << (C1 - C0).norm();
-    // Print first few triangulated 3D points and depth in im0's camera frame
-    int shown = 0;
-    for (size_t ti = 0; ti < store_out->num_tracks() && shown < 5; ++ti) {
-      const int tid = static_cast<int>(ti);
-      if (!store_out->is_track_valid(tid) || !store_out->track_has_triangulated_xyz(tid))
-        continue;
-      float px, py, pz;
-      store_out->get_track_xyz(tid, &px, &py, &pz);
-      const Eigen::Vector3d X(px, py, pz);
-      const double depth0 = ((*poses_R_out)[static_cast<size_t>(ip0)] * (X - C0))(2);
-      const double depth1 = ((*poses_R_out)[static_cast<size_t>(ip1)] * (X - C1))(2);
-      VLOG(1) << "  track " << tid << ": X=" << X.transpose() << "  depth0=" << depth0
-              << "  depth1=" << depth1;
-      ++shown;
+    LOG(INFO) << "Initial pair done. Registered: " << num_registered << "/" << n_images;
+    // ── Initial-pair diagnostic ──────────────────────────────────────────────
+    {
+      const int ip0 = static_cast<int>(*im0_ptr);
+      const int ip1 = static_cast<int>(*im1_ptr);
+      VLOG(1) << "  Initial pair images: im0=" << ip0 << " im1=" << ip1;
+      const auto& C0 = (*poses_C_out)[static_cast<size_t>(ip0)];
+      const auto& C1 = (*poses_C_out)[static_cast<size_t>(ip1)];
+      VLOG(1) << "  C_im0=" << C0.transpose() << "  C_im1=" << C1.transpose()
+              << "  baseline=" << (C1 - C0).norm();
+      // Print first few triangulated 3D points and depth in im0's camera frame
+      int shown = 0;
+      for (size_t ti = 0; ti < store_out->num_tracks() && shown < 5; ++ti) {
+        const int tid = static_cast<int>(ti);
+        if (!store_out->is_track_valid(tid) || !store_out->track_has_triangulated_xyz(tid))
+          continue;
+        float px, py, pz;
+        store_out->get_track_xyz(tid, &px, &py, &pz);
+        const Eigen::Vector3d X(px, py, pz);
+        const double depth0 = ((*poses_R_out)[static_cast<size_t>(ip0)] * (X - C0))(2);
+        const double depth1 = ((*poses_R_out)[static_cast<size_t>(ip1)] * (X - C1))(2);
+        VLOG(1) << "  track " << tid << ": X=" << X.transpose() << "  depth0=" << depth0
+                << "  depth1=" << depth1;
+        ++shown;
+      }
     }
   }
   // Warm-up GPU context before entering the main loop so the first resection
@@ -4599,6 +4663,48 @@ bool run_incremental_sfm_pipeline(const std::string& tracks_idc_path,
   constexpr int kMaxNoCandidateRetries = 2;
   int next_periodic_global_registered = -1; ///< Late-phase linear milestone for periodic global BA.
   int next_mid_global_registered = -1; ///< Mid-phase linear milestone for full global BA cadence.
+
+  // Per-camera IntrinsicsSchedule phase (recorded in checkpoints; the schedule itself is derived
+  // from registered counts, so it needs no restoring — only a consistency check on resume).
+  auto intrinsics_phases = [&]() {
+    std::vector<int> n_reg_cam(cameras->size(), 0);
+    for (int i = 0; i < n_images; ++i) {
+      const int c = image_to_camera_index[static_cast<size_t>(i)];
+      if ((*registered_out)[static_cast<size_t>(i)] && c >= 0 &&
+          static_cast<size_t>(c) < n_reg_cam.size())
+        ++n_reg_cam[static_cast<size_t>(c)];
+    }
+    std::vector<int> phase(n_reg_cam.size());
+    for (size_t c = 0; c < n_reg_cam.size(); ++c)
+      phase[c] = opts.intrinsics.phase_for(n_reg_cam[c]);
+    return phase;
+  };
+  if (resuming) {
+    sfm_iter = resume_state.sfm_iter;
+    no_candidate_consecutive = resume_state.no_candidate_consecutive;
+    next_periodic_global_registered = resume_state.next_periodic_global_registered;
+    next_mid_global_registered = resume_state.next_mid_global_registered;
+    s_ba_grid_call_count = resume_state.ba_grid_call_count;
+    resection_score_cache = std::move(resume_state.resection_score_cache);
+    ba_cameras_snapshot = std::move(resume_state.ba_cameras_snapshot);
+    ms_choose_candidates = resume_state.ms_choose_candidates;
+    ms_resection = resume_state.ms_resection;
+    ms_triangulation = resume_state.ms_triangulation;
+    ms_local_ba = resume_state.ms_local_ba;
+    ms_global_ba = resume_state.ms_global_ba;
+    ms_retriangulation = resume_state.ms_retriangulation;
+    if (intrinsics_phases() != resume_state.intrinsics_phase)
+      LOG(WARNING) << "Resume: intrinsics schedule phases differ from the checkpoint "
+                      "(IntrinsicsSchedule options changed?)";
+  }
+
+  // ── Checkpoint cadence ────────────────────────────────────────────────────
+  const CheckpointOptions& ck = opts.checkpoint;
+  const bool checkpoint_enabled =
+      !ck.dir.empty() && (ck.every_n_registrations > 0 || ck.every_minutes > 0.0);
+  int checkpoint_seq = resuming ? resume_state.seq + 1 : 0;
+  int checkpoint_last_registered = num_registered;
+  Clock::time_point checkpoint_last_time = Clock::now();
   for (;;) {
     if (opts.max_registered_images > 0 && num_registered >= opts.max_registered_images) {
       LOG(INFO) << "Early stop: max_registered_images reached (" << num_registered << "/"
@@ -4959,6 +5065,8 @@ bool run_incremental_sfm_pipeline(const std::string& tracks_idc_path,
       auto t_lba0 = Clock::now();
       BASolverOverrides local_ov{};
       local_ov.num_threads = opts.global_ba.solver_overrides.num_threads;
+      local_ov.native_schur = opts.global_ba.solver_overrides.native_schur;
+      local_ov.native_preconditioner = opts.global_ba.solver_overrides.native_preconditioner;
       // Local BA warm-starts periodic / full global BA.  Never reuse global BA's optional loose
       // solver_overrides (e.g. intermediate rounds use function_tolerance≈1e-4): enforce Ceres
       // defaults explicitly so local steps converge tightly before the next global solve.
@@ -5155,6 +5263,49 @@ bool run_incremental_sfm_pipeline(const std::string& tracks_idc_path,
                              *store_out);
     }
 
+    // Checkpoint at the iteration boundary: everything the next iteration reads is either in the
+    // store/poses/cameras or in the loop state captured below.
+    if (checkpoint_enabled &&
+        ((ck.every_n_registrations > 0 &&
+          num_registered - checkpoint_last_registered >= ck.every_n_registrations) ||
+         (ck.every_minutes > 0.0 &&
+          std::chrono::duration<double>(Clock::now() - checkpoint_last_time).count() >=
+              60.0 * ck.every_minutes))) {
+      auto t_ck0 = Clock::now();
+      SfMCheckpointState st;
+      st.seq = checkpoint_seq;
+      st.sfm_iter = sfm_iter;
+      st.num_registered = num_registered;
+      st.anchor_image = anchor_image;
+      st.second_image = static_cast<int>(*im1_ptr);
+      st.no_candidate_consecutive = no_candidate_consecutive;
+      st.next_periodic_global_registered = next_periodic_global_registered;
+      st.next_mid_global_registered = next_mid_global_registered;
+      st.ba_grid_call_count = s_ba_grid_call_count;
+      st.intrinsics_phase = intrinsics_phases();
+      st.ms_choose_candidates = ms_choose_candidates;
+      st.ms_resection = ms_resection;
+      st.ms_triangulation = ms_triangulation;
+      st.ms_local_ba = ms_local_ba;
+      st.ms_global_ba = ms_global_ba;
+      st.ms_retriangulation = ms_retriangulation;
+      st.ba_cameras_snapshot = ba_cameras_snapshot;
+      st.resection_score_cache = resection_score_cache;
+      if (save_sfm_checkpoint(ck.dir, st, *store_out, *poses_R_out, *poses_C_out, *registered_out,
+                              *cameras, image_to_camera_index)) {
+        LOG(INFO) << "[checkpoint] seq=" << checkpoint_seq << " iter=" << sfm_iter
+                  << " n_reg=" << num_registered << " → " << ck.dir << " ("
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t_ck0)
+                         .count()
+                  << "ms)";
+        ++checkpoint_seq;
+      } else {
+        LOG(WARNING) << "[checkpoint] failed to write checkpoint to " << ck.dir;
+      }
+      checkpoint_last_registered = num_registered;
+      checkpoint_last_time = Clock::now();
+    }
+
     {
       const uint64_t d_ch = ms_choose_candidates - iter_ms_choose_t0;
       const uint64_t d_re = ms_resection - iter_ms_resect_t0;
@@ -67,6 +67,10 @@ struct BASolverOverrides {
   double tikhonov_lambda = 0.0;  ///< Tikhonov regularization lambda. 0 = disabled. Passed to BAInput::tikhonov_lambda.
   /// Ceres `Solver::Options::num_threads`. 0 = use BAInput default (hardware concurrency).
   int num_threads = 0;
+  /// Solve with the native Schur + PCG solver (BASolverBackend::kNativeSchur) instead of Ceres.
+  bool native_schur = false;
+  /// BAPreconditioner of the native solver: 0 = block Jacobi, 1 = Schur-Jacobi, 2 = cluster Jacobi.
+  int native_preconditioner = 1;
 };
 
 /**
@@ -234,6 +238,8 @@ struct IntrinsicsSchedule {
 
   /// Returns the partial_intr_fix bitmask for run_global_ba() based on registration count.
   uint32_t fix_mask_for(int n_registered) const;
+  /// Phase index 0..3 (see above) for a camera with n_registered registered images.
+  int phase_for(int n_registered) const;
 
   /// Returns a per-camera vector of partial_intr_fix bitmasks.
   /// Each camera's phase is determined by its own registered image count (images of that
@@ -495,6 +501,18 @@ struct DebugOptions {
       on_snapshot;
 };
 
+/// Periodic checkpoints and resume (sfm_checkpoint.h).  A checkpoint is written at the end of an
+/// SfM iteration once every_n_registrations images were registered or every_minutes of wall time
+/// passed since the previous checkpoint (whichever comes first).
+struct CheckpointOptions {
+  std::string dir;               ///< Checkpoint directory; empty = no checkpoints.
+  int every_n_registrations = 0; ///< 0 = no registration-count trigger.
+  double every_minutes = 0.0;    ///< 0 = no wall-time trigger.
+  /// Checkpoint directory (or its checkpoint.json) to resume from instead of the initial pair.
+  /// The tracks IDC is then read only for its embedded view graph.
+  std::string resume_from;
+};
+
 struct IncrementalSfMOptions {
   InitPairOptions init;
   ResectionOptions resection;
@@ -505,6 +523,7 @@ struct IncrementalSfMOptions {
   OutlierOptions outlier;
   TriangulationOptions triangulation;
   DebugOptions debug; ///< Per-iteration debug snapshots (disabled by default).
+  CheckpointOptions checkpoint; ///< Periodic checkpoints / resume (disabled by default).
 
   /// Early stop when registered images reach this cap (including initial pair).
   /// 0 = disabled (run full incremental reconstruction).
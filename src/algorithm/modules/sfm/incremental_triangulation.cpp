@@ -7,10 +7,10 @@
 
 #include "../camera/camera_utils.h"
 #include "track_store.h"
+#include "triangulation_kernels.h"
 #include "util/numeric.h"
 
 #include <Eigen/Dense>
-#include <Eigen/SVD>
 #include <algorithm>
 #include <array>
 #include <chrono>
@@ -118,22 +118,10 @@ Eigen::Vector3d triangulate_point_multiview(const std::vector<Eigen::Matrix3d>&
   const int N = static_cast<int>(R_list.size());
   if (N < 2 || static_cast<int>(C_list.size()) != N || static_cast<int>(rays_n.size()) != N)
     return Eigen::Vector3d(0, 0, 0);
-  Eigen::MatrixXd A(2 * N, 4);
-  for (int i = 0; i < N; ++i) {
-    const Eigen::Matrix3d& R = R_list[i];
-    const Eigen::Vector3d t = -R * C_list[i];
-    const double nx = rays_n[i](0), ny = rays_n[i](1);
-    // DLT constraints from q_x/q_z = nx and q_y/q_z = ny (q = R*X + t):
-    //   -(q_x - nx*q_z) = 0  →  (nx*R[2] - R[0])*X + (nx*t2 - t0) = 0
-    //   -(q_y - ny*q_z) = 0  →  (ny*R[2] - R[1])*X + (ny*t2 - t1) = 0
-    A.row(2 * i) << nx * R.row(2) - R.row(0), nx * t(2) - t(0);
-    A.row(2 * i + 1) << ny * R.row(2) - R.row(1), ny * t(2) - t(1);
-  }
-  Eigen::JacobiSVD<Eigen::MatrixXd> svd(A, Eigen::ComputeFullV);
-  const Eigen::Vector4d v = svd.matrixV().col(3);
-  if (std::fabs(v(3)) < 1e-12)
+  Eigen::Vector3d X;
+  if (!tri_kernel::triangulate_dlt_n(R_list.data(), C_list.data(), rays_n.data(), nullptr, N, &X))
     return Eigen::Vector3d(0, 0, 0);
-  return v.head<3>() / v(3);
+  return X;
 }
 
 // OpenMVG-style DLT (HZ 12.2 p.312): projection matrix P = K * [R | t] with undistorted pixel
@@ -150,22 +138,12 @@ bool check_all_depths_positive(const Eigen::Vector3d& X, const std::vector<Eigen
   return true;
 }
 
-double compute_max_ray_angle_deg(const Eigen::Vector3d& X,
-                                 const std::vector<Eigen::Vector3d>& C_list) {
-  double max_angle = 0.0;
-  const int N = static_cast<int>(C_list.size());
-  for (int i = 0; i < N; ++i) {
-    const Eigen::Vector3d ri = (X - C_list[i]).normalized();
-    for (int j = i + 1; j < N; ++j) {
-      const Eigen::Vector3d rj = (X - C_list[j]).normalized();
-      double d = ri.dot(rj);
-      d = d < -1.0 ? -1.0 : (d > 1.0 ? 1.0 : d);
-      const double angle_deg = std::acos(d) * (180.0 / M_PI);
-      if (angle_deg > max_angle)
-        max_angle = angle_deg;
-    }
-  }
-  return max_angle;
+/// Angle (degrees) between the rays from centres \p Ca and \p Cb to \p X.
+double ray_angle_deg(const Eigen::Vector3d& X, const Eigen::Vector3d& Ca,
+                     const Eigen::Vector3d& Cb) {
+  double d = (X - Ca).normalized().dot((X - Cb).normalized());
+  d = d < -1.0 ? -1.0 : (d > 1.0 ? 1.0 : d);
+  return std::acos(d) * (180.0 / M_PI);
 }
 
 void world_to_pixel(const Eigen::Matrix3d& R, const Eigen::Vector3d& C, const camera::Intrinsics& K,
@@ -201,60 +179,9 @@ refine_point_multiview_gn(Eigen::Vector3d X, const std::vector<Eigen::Matrix3d>&
   const size_t m = view_idx.size();
   if (m < 2)
     return X;
-  const double h = 1e-6;
-  for (int it = 0; it < max_iter; ++it) {
-    Eigen::VectorXd r(2 * static_cast<Eigen::Index>(m));
-    int row = 0;
-    for (size_t ii = 0; ii < m; ++ii) {
-      const size_t i = view_idx[ii];
-      double up, vp;
-      world_to_pixel(R_list[i], C_list[i], K_list[i], X, &up, &vp);
-      r(row++) = u_px[i] - up;
-      r(row++) = v_px[i] - vp;
-    }
-    if (r.norm() < tol * std::sqrt(static_cast<double>(m)))
-      break;
-    Eigen::MatrixXd J(r.size(), 3);
-    for (int k = 0; k < 3; ++k) {
-      Eigen::Vector3d Xp = X;
-      Xp(k) += h;
-      Eigen::VectorXd rp(2 * static_cast<Eigen::Index>(m));
-      row = 0;
-      for (size_t ii = 0; ii < m; ++ii) {
-        const size_t i = view_idx[ii];
-        double up, vp;
-        world_to_pixel(R_list[i], C_list[i], K_list[i], Xp, &up, &vp);
-        rp(row++) = u_px[i] - up;
-        rp(row++) = v_px[i] - vp;
-      }
-      J.col(k) = (rp - r) / h;
-    }
-    const Eigen::Matrix3d JtJ = J.transpose() * J;
-    const Eigen::Vector3d Jtr = J.transpose() * r;
-    const Eigen::Vector3d dx = JtJ.ldlt().solve(Jtr);
-    if (!dx.allFinite())
-      break;
-    const Eigen::Vector3d X_new = X - dx; // correct GN descent: X_new = X - (J^T J)^{-1} J^T r
-    // Only accept the step if it actually reduces the residual (no line search, so guard against
-    // ill-conditioned J^T J producing an overshooting step).
-    Eigen::VectorXd r_new(r.size());
-    {
-      int row2 = 0;
-      for (size_t ii = 0; ii < m; ++ii) {
-        const size_t i = view_idx[ii];
-        double up, vp;
-        world_to_pixel(R_list[i], C_list[i], K_list[i], X_new, &up, &vp);
-        r_new(row2++) = u_px[i] - up;
-        r_new(row2++) = v_px[i] - vp;
-      }
-    }
-    if (r_new.norm() >= r.norm())
-      break;
-    X = X_new;
-    if (dx.norm() < tol)
-      break;
-  }
-  return X;
+  return tri_kernel::refine_point_gn_n(X, R_list.data(), C_list.data(), K_list.data(),
+                                       u_px.data(), v_px.data(), view_idx.data(),
+                                       static_cast<int>(m), max_iter, tol);
 }
 
 void count_inliers_and_mask(const Eigen::Vector3d& X, const std::vector<Eigen::Matrix3d>& R_list,
@@ -349,16 +276,18 @@ void log_robust_tri_diag() {
 // rays_n as  x = rays_n * (fx, fy) + (cx, cy)  — a lossless linear transform.
 constexpr bool kTriDLTUndistPx = true;
 
-/// Dispatch triangulation for a single view-pair.
-/// @param ray1 / ray2  Undistorted normalised coordinates (= K⁻¹ × undist_pixel).
-/// @param K1 / K2      Per-view intrinsics.
-static Eigen::Vector3d triangulate_pair(const Eigen::Matrix3d& R1, const Eigen::Vector3d& C1,
-                                        const Eigen::Vector2d& ray1,
-                                        const camera::Intrinsics& /*K1*/, const Eigen::Matrix3d& R2,
-                                        const Eigen::Vector3d& C2, const Eigen::Vector2d& ray2,
-                                        const camera::Intrinsics& /*K2*/) {
+/// Triangulate views \p a and \p b of the lists (fixed 2-view DLT kernel, no allocation).
+/// rays_n holds undistorted normalised coordinates (= K⁻¹ × undist_pixel).
+static Eigen::Vector3d triangulate_pair(const std::vector<Eigen::Matrix3d>& R_list,
+                                        const std::vector<Eigen::Vector3d>& C_list,
+                                        const std::vector<Eigen::Vector2d>& rays_n, size_t a,
+                                        size_t b) {
   // DLT in normalised coords: P = [R | -R*C], input = undistorted normalised ray.
-  return triangulate_point_multiview({R1, R2}, {C1, C2}, {ray1, ray2});
+  const size_t ab[2] = {a, b};
+  Eigen::Vector3d X;
+  if (!tri_kernel::triangulate_dlt<2>(R_list.data(), C_list.data(), rays_n.data(), ab, 2, &X))
+    return Eigen::Vector3d(0, 0, 0);
+  return X;
 }
 
 } // namespace
@@ -396,11 +325,7 @@ bool robust_triangulate_point_multiview(const std::vector<Eigen::Matrix3d>& R_li
       return false;
     }
 
-    std::vector<Eigen::Matrix3d> R2 = {R_list[0], R_list[1]};
-    std::vector<Eigen::Vector3d> C2 = {C_list[0], C_list[1]};
-
-    Eigen::Vector3d X = triangulate_pair(R_list[0], C_list[0], rays_n[0], cameras_per_view[0],
-                                         R_list[1], C_list[1], rays_n[1], cameras_per_view[1]);
+    Eigen::Vector3d X = triangulate_pair(R_list, C_list, rays_n, 0, 1);
     if (!X.allFinite() || X.norm() < 1e-12) {
       ++s_rtd.n2_dlt_fail;
       return false;
@@ -409,7 +334,7 @@ bool robust_triangulate_point_multiview(const std::vector<Eigen::Matrix3d>& R_li
       ++s_rtd.n2_depth;
       return false;
     }
-    const double ang_pre = compute_max_ray_angle_deg(X, C2);
+    const double ang_pre = ray_angle_deg(X, C_list[0], C_list[1]);
     if (ang_pre < opt.min_tri_angle_deg || ang_pre > opt.max_tri_angle_deg) {
       ++s_rtd.n2_angle;
       return false;
@@ -481,9 +406,8 @@ bool robust_triangulate_point_multiview(const std::vector<Eigen::Matrix3d>& R_li
   for (const auto& ab : pairs) {
     const int a = ab.first, b = ab.second;
     ++local_pair_total;
-    const std::vector<Eigen::Vector3d> C2 = {C_list[a], C_list[b]};
-    Eigen::Vector3d X = triangulate_pair(R_list[a], C_list[a], rays_n[a], cameras_per_view[a],
-                                         R_list[b], C_list[b], rays_n[b], cameras_per_view[b]);
+    Eigen::Vector3d X = triangulate_pair(R_list, C_list, rays_n, static_cast<size_t>(a),
+                                         static_cast<size_t>(b));
     if (!X.allFinite() || X.norm() < 1e-12) {
       ++local_pair_dlt;
       continue;
@@ -494,7 +418,7 @@ bool robust_triangulate_point_multiview(const std::vector<Eigen::Matrix3d>& R_li
     }
     // Reject pairs with degenerate triangulation angle — small angles produce points at infinity
     // that artificially inflate the inlier count across views.
-    const double pair_angle = compute_max_ray_angle_deg(X, C2);
+    const double pair_angle = ray_angle_deg(X, C_list[a], C_list[b]);
     if (pair_angle < opt.min_tri_angle_deg || pair_angle > opt.max_tri_angle_deg) {
       ++local_pair_angle;
       continue;
@@ -588,7 +512,7 @@ enum class TriFailCode : int {
 ///   (reproj outliers), so run_retriangulation can re-triangulate after BA clears XYZ when only
 ///   restorable deleted views would bring nv back to >= 2.
 static bool rebuild_registered_arrays_from_track(
-    TrackStore* store, int track_id, int n_images, const std::vector<bool>& registered,
+    const TrackStore* store, int track_id, int n_images, const std::vector<bool>& registered,
     const std::vector<camera::Intrinsics>& cameras, const std::vector<int>& image_to_camera_index,
     std::vector<int>* reg_obs_ids, std::vector<int>* reg_inds, std::vector<Eigen::Vector2d>* rays_n,
     std::vector<double>* u_px, std::vector<double>* v_px,
@@ -618,13 +542,19 @@ static bool rebuild_registered_arrays_from_track(
     // compares apples-to-apples.  Previously u_px/v_px stored undistorted coords
     // while reproj_error_px returned distorted → systematic mismatch that inflated
     // apparent error and killed most RANSAC inliers once K had non-zero distortion.
-    double u_undist = u_raw, v_undist = v_raw;
-    if (K.has_distortion()) {
-      camera::undistort_point(K, u_raw, v_raw, &u_undist, &v_undist);
+    // Rays come from the store's undistortion cache (refreshed on entry of the run_* passes);
+    // uncached observations fall back to undistorting here.
+    double xn, yn;
+    if (!store->obs_undistorted_normalized(oid, &xn, &yn)) {
+      double u_undist = u_raw, v_undist = v_raw;
+      if (K.has_distortion())
+        camera::undistort_point(K, u_raw, v_raw, &u_undist, &v_undist);
+      xn = (u_undist - K.cx) / K.fx;
+      yn = (v_undist - K.cy) / K.fy;
     }
     reg_obs_ids->push_back(oid);
     reg_inds->push_back(im);
-    rays_n->push_back(Eigen::Vector2d((u_undist - K.cx) / K.fx, (v_undist - K.cy) / K.fy));
+    rays_n->push_back(Eigen::Vector2d(xn, yn));
     u_px->push_back(u_raw); // distorted pixel — matches reproj_error_px output
     v_px->push_back(v_raw); // distorted pixel — matches reproj_error_px output
     K_per_view->push_back(K);
@@ -632,28 +562,39 @@ static bool rebuild_registered_arrays_from_track(
   return static_cast<int>(reg_inds->size()) >= 2;
 }
 
+/// Outcome of triangulating one track, computed without mutating the store
+/// (compute_track_triangulation) and applied later by commit_track_triangulation.
+struct TrackTriangulationUpdate {
+  TriFailCode fail = TriFailCode::kOk;
+  Eigen::Vector3d X = Eigen::Vector3d::Zero();
+  /// Store mutations in registered-view order: obs id and kRestoreObs / kDeleteObsRestorable.
+  std::vector<std::pair<int, uint8_t>> obs_ops;
+};
+constexpr uint8_t kRestoreObs = 1;          ///< robust inlier that is currently deleted
+constexpr uint8_t kDeleteObsRestorable = 2; ///< robust outlier
+
 /**
- * Single entry for incremental triangulation (2 or N views).
+ * Single entry for incremental triangulation (2 or N views), compute half.
  *
  * Flow:
  *  1. Build registered-view arrays from the store.
  *  2. Call robust_triangulate_point_multiview -- it runs RANSAC internally, refines on the inlier
  *     subset, and returns rr.X + rr.inlier_mask. Angle/depth are already checked inside.
- *  3. On success: use rr.inlier_mask to permanently mark outlier observations deleted in the store,
- *     then commit rr.X. No extra GN or outer loop needed.
- *  4. On failure with nv==2: fall back to bare DLT + GN (robust skips nv==2 when
- *     min_inlier_views > 2). Bad observation is deleted so retriangulation can recover later.
- *  5. On failure with nv>=3: report and return.
+ *  3. On success: record the outlier observations to delete (restorable) and the deleted inliers
+ *     to restore, plus rr.X. No extra GN or outer loop needed.
+ *
+ * Reads only the track's own observations and a per-call RANSAC seed, so tracks can be computed
+ * concurrently and committed in any fixed order with the same result as the serial loop.
  */
-static bool triangulate_track_common(
-    TrackStore* store, int track_id, const std::vector<Eigen::Matrix3d>& poses_R,
+static bool compute_track_triangulation(
+    const TrackStore* store, int track_id, const std::vector<Eigen::Matrix3d>& poses_R,
     const std::vector<Eigen::Vector3d>& poses_C, int n_images, const std::vector<bool>& registered,
     const std::vector<camera::Intrinsics>& cameras, const std::vector<int>& image_to_camera_index,
     double min_tri_angle_deg, const RobustTriangulationOptions& robust_opt,
-    TriFailCode* fail_out = nullptr, bool include_deleted_restorable_obs = false) {
+    TrackTriangulationUpdate* up, bool include_deleted_restorable_obs = false) {
+  up->obs_ops.clear();
   auto set_fail = [&](TriFailCode c) {
-    if (fail_out)
-      *fail_out = c;
+    up->fail = c;
     return false;
   };
 
@@ -709,7 +650,7 @@ static bool triangulate_track_common(
       CHECK_LE(e, accept_px) << "reproj error " << e << " is less than accept px " << accept_px;
       const int oid_in = reg_obs_ids[static_cast<size_t>(i)];
       if (!store->is_obs_valid(oid_in))
-        store->mark_observation_restored(oid_in);
+        up->obs_ops.emplace_back(oid_in, kRestoreObs);
       ++n_committed;
     } else {
       // RANSAC outlier: always mark as kRestorable (soft-delete) regardless of which pass.
@@ -722,19 +663,49 @@ static bool triangulate_track_common(
       // late-stage unregistered images of 3D-2D correspondences (they rely on those same tracks
       // being triangulated).  Marking as kRestorable lets retri_restore_deleted_obs_branch_a and
       // subsequent kFullScan passes reconsider the observation once poses have been refined by BA.
-      store->mark_observation_deleted_restorable(reg_obs_ids[static_cast<size_t>(i)]);
+      up->obs_ops.emplace_back(reg_obs_ids[static_cast<size_t>(i)], kDeleteObsRestorable);
     }
   }
 
   CHECK_GE(n_committed, 2) << "n_committed " << n_committed << " is less than 2";
 
-  store->set_track_xyz(track_id, static_cast<float>(rr.X(0)), static_cast<float>(rr.X(1)),
-                       static_cast<float>(rr.X(2)));
-  if (fail_out)
-    *fail_out = TriFailCode::kOk;
+  up->X = rr.X;
+  up->fail = TriFailCode::kOk;
   return true;
 }
 
+/// Commit half: apply a successful update (obs restore/delete in view order, then XYZ).
+static void commit_track_triangulation(TrackStore* store, int track_id,
+                                       const TrackTriangulationUpdate& up) {
+  for (const auto& op : up.obs_ops) {
+    if (op.second == kRestoreObs)
+      store->mark_observation_restored(op.first);
+    else
+      store->mark_observation_deleted_restorable(op.first);
+  }
+  store->set_track_xyz(track_id, static_cast<float>(up.X(0)), static_cast<float>(up.X(1)),
+                       static_cast<float>(up.X(2)));
+}
+
+/// Serial compute + commit of one track.
+static bool triangulate_track_common(
+    TrackStore* store, int track_id, const std::vector<Eigen::Matrix3d>& poses_R,
+    const std::vector<Eigen::Vector3d>& poses_C, int n_images, const std::vector<bool>& registered,
+    const std::vector<camera::Intrinsics>& cameras, const std::vector<int>& image_to_camera_index,
+    double min_tri_angle_deg, const RobustTriangulationOptions& robust_opt,
+    TriFailCode* fail_out = nullptr, bool include_deleted_restorable_obs = false) {
+  TrackTriangulationUpdate up;
+  const bool ok = compute_track_triangulation(store, track_id, poses_R, poses_C, n_images,
+                                              registered, cameras, image_to_camera_index,
+                                              min_tri_angle_deg, robust_opt, &up,
+                                              include_deleted_restorable_obs);
+  if (fail_out)
+    *fail_out = up.fail;
+  if (ok)
+    commit_track_triangulation(store, track_id, up);
+  return ok;
+}
+
 static void reproj_mean_max_for_views(const Eigen::Vector3d& X, const std::vector<int>& reg_inds,
                                       const std::vector<double>& u_px,
                                       const std::vector<double>& v_px,
@@ -841,6 +812,7 @@ int run_batch_triangulation(TrackStore* store, const std::vector<int>& new_regis
       static_cast<int>(poses_C.size()) != n_images ||
       static_cast<int>(registered.size()) != n_images)
     return 0;
+  store->refresh_undistorted_cache(cameras, image_to_camera_index);
   RobustTriangulationOptions robust_defaults;
   robust_defaults.min_tri_angle_deg = min_tri_angle_deg;
   robust_defaults.ransac_inlier_px = commit_reproj_px;
@@ -902,51 +874,69 @@ int run_batch_triangulation(TrackStore* store, const std::vector<int>& new_regis
   std::vector<double> dbg_up2, dbg_vp2;
   std::vector<camera::Intrinsics> dbg_Kp2;
 
+  // Compute in parallel (read-only on the store), commit serially in candidate order.  Each
+  // track owns its observations and RANSAC is seeded per call, so the store ends up bit-identical
+  // to triangulating the candidates one after another.  Blocks bound the buffered updates.
+  constexpr size_t kTriBlock = 4096;
+  std::vector<TrackTriangulationUpdate> block_updates(
+      std::min(kTriBlock, candidate_track_ids.size()));
+  std::vector<uint8_t> block_ok(block_updates.size(), 0);
   auto t0 = Clock::now();
-  for (int track_id : candidate_track_ids) {
-    ++tracks_scanned;
-    TriFailCode fcode = TriFailCode::kOk;
-    if (triangulate_track_common(store, track_id, poses_R, poses_C, n_images, registered, cameras,
-                                 image_to_camera_index, min_tri_angle_deg, robust_defaults,
-                                 &fcode)) {
-      ++updated;
-      if (new_track_ids_out)
-        new_track_ids_out->push_back(track_id);
-      if (collect_debug_stats) {
-        float tx, ty, tz;
-        store->get_track_xyz(track_id, &tx, &ty, &tz);
-        const Eigen::Vector3d Xstore(static_cast<double>(tx), static_cast<double>(ty),
-                                     static_cast<double>(tz));
-        dbg_roid.clear();
-        dbg_rind.clear();
-        dbg_rn2.clear();
-        dbg_up2.clear();
-        dbg_vp2.clear();
-        dbg_Kp2.clear();
-        rebuild_registered_arrays_from_track(store, track_id, n_images, registered, cameras,
-                                             image_to_camera_index, &dbg_roid, &dbg_rind, &dbg_rn2,
-                                             &dbg_up2, &dbg_vp2, &dbg_Kp2);
-        double mpx = 0.0, mxpx = 0.0;
-        reproj_mean_max_for_views(Xstore, dbg_rind, dbg_up2, dbg_vp2, dbg_Kp2, poses_R, poses_C,
-                                  &mpx, &mxpx);
-        success_mean_px.push_back(mpx);
-        success_max_px.push_back(mxpx);
-        worst_tracks.push_back({mxpx, track_id});
-        std::sort(worst_tracks.begin(), worst_tracks.end(),
-                  [](const std::pair<double, int>& a, const std::pair<double, int>& b) {
-                    return a.first > b.first;
-                  });
-        if (worst_tracks.size() > 12)
-          worst_tracks.resize(12);
-      }
-    } else {
-      if (fcode == TriFailCode::kInsufficientRegisteredViews)
-        ++tracks_skipped_few_views;
-      else {
-        ++tracks_skipped_fail;
-        const int ci = static_cast<int>(fcode);
-        if (ci >= 1 && ci < static_cast<int>(fail_by_code.size()))
-          ++fail_by_code[static_cast<size_t>(ci)];
+  for (size_t b0 = 0; b0 < candidate_track_ids.size(); b0 += kTriBlock) {
+    const int n_block = static_cast<int>(std::min(kTriBlock, candidate_track_ids.size() - b0));
+#pragma omp parallel for schedule(dynamic, 8)
+    for (int i = 0; i < n_block; ++i) {
+      block_ok[static_cast<size_t>(i)] = compute_track_triangulation(
+          store, candidate_track_ids[b0 + static_cast<size_t>(i)], poses_R, poses_C, n_images,
+          registered, cameras, image_to_camera_index, min_tri_angle_deg, robust_defaults,
+          &block_updates[static_cast<size_t>(i)]);
+    }
+    for (int i = 0; i < n_block; ++i) {
+      const int track_id = candidate_track_ids[b0 + static_cast<size_t>(i)];
+      const TrackTriangulationUpdate& up = block_updates[static_cast<size_t>(i)];
+      ++tracks_scanned;
+      const TriFailCode fcode = up.fail;
+      if (block_ok[static_cast<size_t>(i)]) {
+        commit_track_triangulation(store, track_id, up);
+        ++updated;
+        if (new_track_ids_out)
+          new_track_ids_out->push_back(track_id);
+        if (collect_debug_stats) {
+          float tx, ty, tz;
+          store->get_track_xyz(track_id, &tx, &ty, &tz);
+          const Eigen::Vector3d Xstore(static_cast<double>(tx), static_cast<double>(ty),
+                                       static_cast<double>(tz));
+          dbg_roid.clear();
+          dbg_rind.clear();
+          dbg_rn2.clear();
+          dbg_up2.clear();
+          dbg_vp2.clear();
+          dbg_Kp2.clear();
+          rebuild_registered_arrays_from_track(store, track_id, n_images, registered, cameras,
+                                               image_to_camera_index, &dbg_roid, &dbg_rind, &dbg_rn2,
+                                               &dbg_up2, &dbg_vp2, &dbg_Kp2);
+          double mpx = 0.0, mxpx = 0.0;
+          reproj_mean_max_for_views(Xstore, dbg_rind, dbg_up2, dbg_vp2, dbg_Kp2, poses_R, poses_C,
+                                    &mpx, &mxpx);
+          success_mean_px.push_back(mpx);
+          success_max_px.push_back(mxpx);
+          worst_tracks.push_back({mxpx, track_id});
+          std::sort(worst_tracks.begin(), worst_tracks.end(),
+                    [](const std::pair<double, int>& a, const std::pair<double, int>& b) {
+                      return a.first > b.first;
+                    });
+          if (worst_tracks.size() > 12)
+            worst_tracks.resize(12);
+        }
+      } else {
+        if (fcode == TriFailCode::kInsufficientRegisteredViews)
+          ++tracks_skipped_few_views;
+        else {
+          ++tracks_skipped_fail;
+          const int ci = static_cast<int>(fcode);
+          if (ci >= 1 && ci < static_cast<int>(fail_by_code.size()))
+            ++fail_by_code[static_cast<size_t>(ci)];
+        }
       }
     }
   }
@@ -1098,6 +1088,7 @@ int run_retriangulation(TrackStore* store, const std::vector<Eigen::Matrix3d>& p
       static_cast<int>(poses_C.size()) != n_images ||
       static_cast<int>(registered.size()) != n_images)
     return 0;
+  store->refresh_undistorted_cache(cameras, image_to_camera_index);
   using Clock = std::chrono::steady_clock;
   auto t0 = Clock::now();
 
@@ -1404,7 +1395,7 @@ int restore_observations_from_cameras(
   int restored = 0;
 
   // Build list of images that belong to changed camera models.
-  // Using the pre-built per-image obs index (image_obs_ids_) avoids scanning all observations.
+  // Using the pre-built per-image obs index (image_obs_, CSR) avoids scanning all observations.
   std::vector<int> obs_ids;
   for (int im = 0; im < n_images; ++im) {
     if (!registered[static_cast<size_t>(im)])
@@ -136,7 +136,7 @@ int run_full_scan_triangulation(TrackStore* store,
  * Degenerate tracks whose XYZ has been cleared (clear_track_xyz) are skipped here; they
  * remain the responsibility of the pending-queue run_retriangulation mechanism.
  *
- * Uses the pre-built per-image obs index (image_obs_ids_) inside TrackStore so that only
+ * Uses the pre-built per-image obs index (image_obs_, CSR) inside TrackStore so that only
  * observations belonging to the changed cameras are visited, not the full observation list.
  *
  * @param changed_cam_model_indices  Set of camera-model indices (into `cameras`) that changed.
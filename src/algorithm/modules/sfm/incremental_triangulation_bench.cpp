@@ -0,0 +1,101 @@
+/**
+ * @file  incremental_triangulation_bench.cpp
+ * @brief Thread-scaling benchmark for run_batch_triangulation (parallel compute + serial commit).
+ *
+ * Builds a synthetic ring of distorted cameras observing random points (pixel noise + gross
+ * outliers), registers all images at once and triangulates every track.  Runs with 1 thread as
+ * the reference, then with 2, 4, ... up to omp_get_max_threads(); each run must leave the store
+ * bit-identical to the reference (XYZ bits, observation flags, newly-triangulated id order,
+ * pending retriangulation queue).
+ *
+ * Usage: bench_batch_triangulation [num_tracks=200000] [num_images=60]
+ */
+
+#include "bench_ring_scene.h"
+#include "incremental_triangulation.h"
+#include "track_store.h"
+
+#include <Eigen/Dense>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <omp.h>
+#include <vector>
+
+using insight::sfm::TrackStore;
+
+namespace {
+
+using Scene = insight::sfm::bench::RingScene;
+
+Scene make_scene(int num_tracks, int num_images, uint32_t seed) {
+  return insight::sfm::bench::make_ring_scene(num_tracks, num_images, 0.05, 200.0, seed);
+}
+
+struct RunResult {
+  double ms = 0.0;
+  int n_tri = 0;
+  std::vector<int> new_ids;
+  std::vector<uint32_t> xyz_bits;
+  std::vector<uint8_t> obs_state;
+  std::vector<int> pending;
+};
+
+RunResult run(const Scene& base, int threads) {
+  Scene s = base; // fresh copy of the store per run
+  const int n_images = s.store.num_images();
+  std::vector<int> all(static_cast<size_t>(n_images));
+  for (int i = 0; i < n_images; ++i)
+    all[static_cast<size_t>(i)] = i;
+  const std::vector<bool> registered(static_cast<size_t>(n_images), true);
+
+  omp_set_num_threads(threads);
+  RunResult r;
+  const auto t0 = std::chrono::steady_clock::now();
+  r.n_tri = insight::sfm::run_batch_triangulation(&s.store, all, s.R, s.C, registered, s.cameras,
+                                                  s.image_to_camera, 1.0, &r.new_ids, 4.0);
+  r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+  const int n_tracks = static_cast<int>(s.store.num_tracks());
+  r.xyz_bits.reserve(static_cast<size_t>(n_tracks) * 4);
+  for (int t = 0; t < n_tracks; ++t) {
+    float xyz[3];
+    s.store.get_track_xyz(t, &xyz[0], &xyz[1], &xyz[2]);
+    uint32_t bits[3];
+    std::memcpy(bits, xyz, sizeof(bits));
+    r.xyz_bits.insert(r.xyz_bits.end(), bits, bits + 3);
+    r.xyz_bits.push_back(s.store.track_has_triangulated_xyz(t) ? 1u : 0u);
+  }
+  for (int o = 0; o < static_cast<int>(s.store.num_observations()); ++o)
+    r.obs_state.push_back(static_cast<uint8_t>((s.store.is_obs_valid(o) ? 1 : 0) |
+                                               (s.store.is_obs_restorable(o) ? 2 : 0)));
+  s.store.drain_retriangulation_pending(&r.pending);
+  return r;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int num_tracks = argc > 1 ? std::atoi(argv[1]) : 200000;
+  const int num_images = argc > 2 ? std::atoi(argv[2]) : 60;
+  const int max_threads = omp_get_max_threads();
+  std::printf("bench_batch_triangulation: %d tracks, %d images, up to %d threads\n", num_tracks,
+              num_images, max_threads);
+  const Scene scene = make_scene(num_tracks, num_images, 7u);
+
+  const RunResult ref = run(scene, 1);
+  std::printf("  threads=%-3d %9.1f ms  newly_tri=%d\n", 1, ref.ms, ref.n_tri);
+  int failures = 0;
+  for (int th = 2; th <= max_threads; th *= 2) {
+    const RunResult r = run(scene, th);
+    const bool same = r.n_tri == ref.n_tri && r.new_ids == ref.new_ids &&
+                      r.xyz_bits == ref.xyz_bits && r.obs_state == ref.obs_state &&
+                      r.pending == ref.pending;
+    std::printf("  threads=%-3d %9.1f ms  speedup=%.2fx  %s\n", th, r.ms, ref.ms / r.ms,
+                same ? "identical" : "MISMATCH");
+    if (!same)
+      ++failures;
+  }
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
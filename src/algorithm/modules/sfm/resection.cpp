@@ -680,87 +680,142 @@ bool resection_single_image(TrackStore& store, int image_index, double fx, doubl
   return true;
 }
 
-bool resection_single_image(const camera::Intrinsics& K, TrackStore& store, int image_index,
-                            Eigen::Matrix3d* R_out, Eigen::Vector3d* t_out, int min_inliers,
-                            double ransac_thresh_px, int* inliers_out, double* rmse_px_out,
-                            double min_inlier_ratio) {
-  if (!K.has_distortion()) {
-    return resection_single_image(store, image_index, K.fx, K.fy, K.cx, K.cy, R_out, t_out,
-                                  min_inliers, ransac_thresh_px, inliers_out, rmse_px_out,
-                                  min_inlier_ratio);
-  }
+namespace {
 
+/// Observation ids and track XYZ of the image's 3D–2D pairs (observations whose track has
+/// triangulated xyz), in image observation order.  Const reads only.
+int collect_resection_pairs(const TrackStore& store, int image_index, std::vector<int>* obs_ids,
+                            std::vector<Eigen::Vector3f>* xyz) {
   std::vector<int> obs_ids_all;
-  const int n = store.get_image_observation_indices(image_index, &obs_ids_all);
-  if (n < static_cast<int>(min_inliers))
+  store.get_image_observation_indices(image_index, &obs_ids_all);
+  obs_ids->clear();
+  xyz->clear();
+  obs_ids->reserve(obs_ids_all.size());
+  xyz->reserve(obs_ids_all.size());
+  for (int obs_id : obs_ids_all) {
+    const int tid = store.obs_track_id(obs_id);
+    if (!store.track_has_triangulated_xyz(tid))
+      continue;
+    float x, y, z;
+    store.get_track_xyz(tid, &x, &y, &z);
+    obs_ids->push_back(obs_id);
+    xyz->emplace_back(x, y, z);
+  }
+  return static_cast<int>(obs_ids->size());
+}
+
+bool same_intrinsics(const camera::Intrinsics& a, const camera::Intrinsics& b) {
+  return a.fx == b.fx && a.fy == b.fy && a.cx == b.cx && a.cy == b.cy && a.k1 == b.k1 &&
+         a.k2 == b.k2 && a.k3 == b.k3 && a.p1 == b.p1 && a.p2 == b.p2;
+}
+
+} // namespace
+
+bool resection_compute(const camera::Intrinsics& K, const TrackStore& store, int image_index,
+                       int min_inliers, double ransac_thresh_px, double min_inlier_ratio,
+                       ResectionPoseResult* out) {
+  if (!out)
+    return false;
+  *out = ResectionPoseResult();
+  out->image_index = image_index;
+  out->K = K;
+  out->min_inliers = min_inliers;
+  out->ransac_thresh_px = ransac_thresh_px;
+  out->min_inlier_ratio = min_inlier_ratio;
+
+  using Clock = std::chrono::steady_clock;
+  auto t0 = Clock::now();
+
+  const int n = collect_resection_pairs(store, image_index, &out->pnp_obs_ids, &out->pts3d);
+  if (n < min_inliers)
     return false;
 
   std::vector<float> u_raw(static_cast<size_t>(n)), v_raw(static_cast<size_t>(n));
   for (int i = 0; i < n; ++i) {
     Observation o;
-    store.get_obs(obs_ids_all[static_cast<size_t>(i)], &o);
+    store.get_obs(out->pnp_obs_ids[static_cast<size_t>(i)], &o);
     u_raw[static_cast<size_t>(i)] = o.u;
     v_raw[static_cast<size_t>(i)] = o.v;
   }
-  std::vector<float> u_und(static_cast<size_t>(n)), v_und(static_cast<size_t>(n));
-  camera::undistort_points(K, u_raw.data(), v_raw.data(), u_und.data(), v_und.data(), n);
-
-  std::vector<int> pnp_obs_ids;
-  std::vector<Point3D2D> pts_pnp;
-  pnp_obs_ids.reserve(static_cast<size_t>(n));
-  pts_pnp.reserve(static_cast<size_t>(n));
-  for (int i = 0; i < n; ++i) {
-    const int tid = store.obs_track_id(obs_ids_all[static_cast<size_t>(i)]);
-    if (!store.track_has_triangulated_xyz(tid))
-      continue;
-    float x, y, z;
-    store.get_track_xyz(tid, &x, &y, &z);
-    Point3D2D pt;
-    pt.x = x;
-    pt.y = y;
-    pt.z = z;
-    pt.u = u_und[static_cast<size_t>(i)];
-    pt.v = v_und[static_cast<size_t>(i)];
-    pnp_obs_ids.push_back(obs_ids_all[static_cast<size_t>(i)]);
-    pts_pnp.push_back(pt);
+  // Undistorted pixels for the pinhole PnP kernel: from the store's cache where available, one
+  // batched call for the rest.
+  const bool distorted = K.has_distortion();
+  std::vector<float> u_und = u_raw, v_und = v_raw;
+  if (distorted) {
+    std::vector<int> uncached;
+    const bool use_cache = store.undistorted_cache_matches(image_index, K);
+    for (int i = 0; i < n; ++i) {
+      double xn, yn;
+      if (use_cache &&
+          store.obs_undistorted_normalized(out->pnp_obs_ids[static_cast<size_t>(i)], &xn, &yn)) {
+        u_und[static_cast<size_t>(i)] = static_cast<float>(K.fx * xn + K.cx);
+        v_und[static_cast<size_t>(i)] = static_cast<float>(K.fy * yn + K.cy);
+      } else {
+        uncached.push_back(i);
+      }
+    }
+    if (static_cast<int>(uncached.size()) == n) {
+      camera::undistort_points(K, u_raw.data(), v_raw.data(), u_und.data(), v_und.data(), n);
+    } else if (!uncached.empty()) {
+      const int m = static_cast<int>(uncached.size());
+      std::vector<float> u_in(static_cast<size_t>(m)), v_in(static_cast<size_t>(m));
+      for (int j = 0; j < m; ++j) {
+        u_in[static_cast<size_t>(j)] = u_raw[static_cast<size_t>(uncached[static_cast<size_t>(j)])];
+        v_in[static_cast<size_t>(j)] = v_raw[static_cast<size_t>(uncached[static_cast<size_t>(j)])];
+      }
+      camera::undistort_points(K, u_in.data(), v_in.data(), u_in.data(), v_in.data(), m);
+      for (int j = 0; j < m; ++j) {
+        u_und[static_cast<size_t>(uncached[static_cast<size_t>(j)])] = u_in[static_cast<size_t>(j)];
+        v_und[static_cast<size_t>(uncached[static_cast<size_t>(j)])] = v_in[static_cast<size_t>(j)];
+      }
+    }
   }
-  if (static_cast<int>(pts_pnp.size()) < min_inliers)
-    return false;
 
   if (g_resection_backend == ResectionBackend::kPoseLib) {
     std::vector<Eigen::Vector3d> pts3d;
     std::vector<Eigen::Vector2d> pts2d;
-    pts3d.reserve(pts_pnp.size());
-    pts2d.reserve(pts_pnp.size());
-    for (const Point3D2D& pt : pts_pnp) {
-      pts3d.emplace_back(static_cast<double>(pt.x), static_cast<double>(pt.y),
-                         static_cast<double>(pt.z));
-      pts2d.emplace_back(static_cast<double>(pt.u), static_cast<double>(pt.v));
+    pts3d.reserve(static_cast<size_t>(n));
+    pts2d.reserve(static_cast<size_t>(n));
+    for (int i = 0; i < n; ++i) {
+      pts3d.push_back(out->pts3d[static_cast<size_t>(i)].cast<double>());
+      pts2d.emplace_back(static_cast<double>(u_und[static_cast<size_t>(i)]),
+                         static_cast<double>(v_und[static_cast<size_t>(i)]));
     }
-    std::vector<char> inlier_full;
-    if (!resection_poselib_pinhole(pts3d, pts2d, K.fx, K.fy, K.cx, K.cy, min_inliers,
-                                   ransac_thresh_px, R_out, t_out, inliers_out, rmse_px_out,
-                                   &inlier_full, min_inlier_ratio))
-      return false;
-    mark_pnp_outliers_deleted(store, pnp_obs_ids, inlier_full);
-    return true;
+    out->ok = resection_poselib_pinhole(pts3d, pts2d, K.fx, K.fy, K.cx, K.cy, min_inliers,
+                                        ransac_thresh_px, &out->R, &out->t, &out->inliers,
+                                        &out->rmse_px, &out->inlier_mask, min_inlier_ratio);
+    return out->ok;
   }
 
-  const int num_pts = static_cast<int>(pts_pnp.size());
+  auto t1 = Clock::now(); // after data prep
+  std::vector<Point3D2D> pts_pnp(static_cast<size_t>(n));
+  for (int i = 0; i < n; ++i) {
+    Point3D2D& pt = pts_pnp[static_cast<size_t>(i)];
+    pt.x = out->pts3d[static_cast<size_t>(i)].x();
+    pt.y = out->pts3d[static_cast<size_t>(i)].y();
+    pt.z = out->pts3d[static_cast<size_t>(i)].z();
+    pt.u = u_und[static_cast<size_t>(i)];
+    pt.v = v_und[static_cast<size_t>(i)];
+  }
   const float fx = static_cast<float>(K.fx), fy = static_cast<float>(K.fy);
   const float cx = static_cast<float>(K.cx), cy = static_cast<float>(K.cy);
   float K_mat[9] = {fx, 0.f, cx, 0.f, fy, cy, 0.f, 0.f, 1.f};
   const float thresh_sq = static_cast<float>(ransac_thresh_px * ransac_thresh_px);
   float R_init[9], t_init[3];
-  std::vector<unsigned char> inlier_mask(static_cast<size_t>(num_pts), 0);
+  std::vector<unsigned char> inlier_mask(static_cast<size_t>(n), 0);
 
   ensure_gpu_geo_init();
-
   const int n_inliers =
-      gpu_ransac_pnp(pts_pnp.data(), num_pts, K_mat, R_init, t_init, thresh_sq, inlier_mask.data());
+      gpu_ransac_pnp(pts_pnp.data(), n, K_mat, R_init, t_init, thresh_sq, inlier_mask.data());
+  auto t2 = Clock::now(); // after gpu_ransac_pnp
+  out->inliers = n_inliers >= 0 ? n_inliers : 0;
   if (n_inliers < min_inliers) {
-    if (inliers_out)
-      *inliers_out = n_inliers >= 0 ? n_inliers : 0;
+    VLOG(1) << "[PERF] resection_single_image im=" << image_index << "  pts=" << n
+            << "  data_prep="
+            << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << "ms"
+            << "  gpu_ransac="
+            << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << "ms"
+            << "  FAILED inliers=" << n_inliers;
     return false;
   }
 
@@ -768,44 +823,90 @@ bool resection_single_image(const camera::Intrinsics& K, TrackStore& store, int
   Eigen::Vector3d t_eig;
   float_rt_to_eigen(R_init, t_init, &R_eig, &t_eig);
 
+  // Distortion-aware refinement runs on the original (distorted) pixels; the pinhole one on the
+  // same pixels PnP saw.
   std::vector<Eigen::Vector3d> inlier_pts3d;
-  std::vector<Eigen::Vector2d> inlier_pts2d_raw;
+  std::vector<Eigen::Vector2d> inlier_pts2d;
   inlier_pts3d.reserve(static_cast<size_t>(n_inliers));
-  inlier_pts2d_raw.reserve(static_cast<size_t>(n_inliers));
-  for (int i = 0; i < num_pts; ++i) {
+  inlier_pts2d.reserve(static_cast<size_t>(n_inliers));
+  for (int i = 0; i < n; ++i) {
     if (!inlier_mask[static_cast<size_t>(i)])
       continue;
-    inlier_pts3d.push_back(Eigen::Vector3d(static_cast<double>(pts_pnp[static_cast<size_t>(i)].x),
-                                           static_cast<double>(pts_pnp[static_cast<size_t>(i)].y),
-                                           static_cast<double>(pts_pnp[static_cast<size_t>(i)].z)));
-    // Use original distorted pixel obs for distortion-aware refinement.
-    // pts_pnp is built in the same order as pnp_obs_ids / u_raw / v_raw.
-    inlier_pts2d_raw.push_back(Eigen::Vector2d(
-        static_cast<double>(u_raw[static_cast<size_t>(i)]),
-        static_cast<double>(v_raw[static_cast<size_t>(i)])));
+    inlier_pts3d.push_back(out->pts3d[static_cast<size_t>(i)].cast<double>());
+    inlier_pts2d.emplace_back(static_cast<double>(u_raw[static_cast<size_t>(i)]),
+                              static_cast<double>(v_raw[static_cast<size_t>(i)]));
   }
 
   Eigen::Matrix3d R_refined = R_eig;
   Eigen::Vector3d t_refined = t_eig;
   double rmse = 0.0;
-  pose_refine_gn(inlier_pts3d, inlier_pts2d_raw, K, R_eig, t_eig, &R_refined, &t_refined,
-                 &rmse, 20);
-  if (rmse_px_out)
-    *rmse_px_out = rmse;
-  if (!is_resection_stable(n_inliers, num_pts, rmse,
+  if (distorted)
+    pose_refine_gn(inlier_pts3d, inlier_pts2d, K, R_eig, t_eig, &R_refined, &t_refined, &rmse, 20);
+  else
+    pose_refine_gn(inlier_pts3d, inlier_pts2d, K.fx, K.fy, K.cx, K.cy, R_eig, t_eig, &R_refined,
+                   &t_refined, &rmse, 10);
+  auto t3 = Clock::now(); // after GN refinement
+  VLOG(1) << "[PERF] resection_single_image im=" << image_index << "  pts=" << n
+          << "  inliers=" << n_inliers << "  data_prep="
+          << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << "ms"
+          << "  gpu_ransac="
+          << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << "ms"
+          << "  gn_refine="
+          << std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count() << "ms"
+          << "  rmse=" << rmse;
+  out->rmse_px = rmse;
+  if (!is_resection_stable(n_inliers, n, rmse,
                            /*min_inlier_ratio=*/min_inlier_ratio,
-                           /*max_rmse_px=*/std::max(6.0, 1.5 * ransac_thresh_px)))
+                           /*max_rmse_px=*/std::max(6.0, 1.5 * ransac_thresh_px))) {
+    VLOG(1) << "[PERF] resection_single_image im=" << image_index
+            << "  rejected_by_stability: inlier_ratio="
+            << static_cast<double>(n_inliers) / static_cast<double>(n) << "  rmse=" << rmse;
     return false;
-  if (inliers_out)
-    *inliers_out = n_inliers;
-  {
-    std::vector<char> mask_char(static_cast<size_t>(num_pts));
-    for (int i = 0; i < num_pts; ++i)
-      mask_char[static_cast<size_t>(i)] = inlier_mask[static_cast<size_t>(i)] ? 1 : 0;
-    mark_pnp_outliers_deleted(store, pnp_obs_ids, mask_char);
   }
-  *R_out = R_refined;
-  *t_out = t_refined;
+  out->inlier_mask.resize(static_cast<size_t>(n));
+  for (int i = 0; i < n; ++i)
+    out->inlier_mask[static_cast<size_t>(i)] = inlier_mask[static_cast<size_t>(i)] ? 1 : 0;
+  out->R = R_refined;
+  out->t = t_refined;
+  out->ok = true;
+  return true;
+}
+
+bool resection_result_is_current(const TrackStore& store, const camera::Intrinsics& K,
+                                 int min_inliers, double ransac_thresh_px,
+                                 double min_inlier_ratio, const ResectionPoseResult& r) {
+  if (r.min_inliers != min_inliers || r.ransac_thresh_px != ransac_thresh_px ||
+      r.min_inlier_ratio != min_inlier_ratio || !same_intrinsics(K, r.K))
+    return false;
+  std::vector<int> obs_ids;
+  std::vector<Eigen::Vector3f> xyz;
+  collect_resection_pairs(store, r.image_index, &obs_ids, &xyz);
+  return obs_ids == r.pnp_obs_ids && xyz == r.pts3d;
+}
+
+void resection_commit_outliers(TrackStore& store, const ResectionPoseResult& r) {
+  if (r.ok)
+    mark_pnp_outliers_deleted(store, r.pnp_obs_ids, r.inlier_mask);
+}
+
+bool resection_single_image(const camera::Intrinsics& K, TrackStore& store, int image_index,
+                            Eigen::Matrix3d* R_out, Eigen::Vector3d* t_out, int min_inliers,
+                            double ransac_thresh_px, int* inliers_out, double* rmse_px_out,
+                            double min_inlier_ratio) {
+  if (!R_out || !t_out)
+    return false;
+  ResectionPoseResult r;
+  const bool ok = resection_compute(K, store, image_index, min_inliers, ransac_thresh_px,
+                                    min_inlier_ratio, &r);
+  if (inliers_out)
+    *inliers_out = r.inliers;
+  if (rmse_px_out)
+    *rmse_px_out = r.rmse_px;
+  if (!ok)
+    return false;
+  resection_commit_outliers(store, r);
+  *R_out = r.R;
+  *t_out = r.t;
   return true;
 }
 
@@ -63,12 +63,57 @@ bool resection_single_image(TrackStore& store, int image_index, double fx, doubl
                             double min_inlier_ratio = 0.02);
 
 /// If K.has_distortion(), observations are undistorted before PnP.
+/// Equivalent to resection_compute() followed by resection_commit_outliers() on success.
 bool resection_single_image(const camera::Intrinsics& K, TrackStore& store, int image_index,
                             Eigen::Matrix3d* R_out, Eigen::Vector3d* t_out,
                             int min_inliers = 15, double ransac_thresh_px = 8.0,
                             int* inliers_out = nullptr, double* rmse_px_out = nullptr,
                             double min_inlier_ratio = 0.02);
 
+/**
+ * Outcome of resection_compute(): the pose plus the exact 3D–2D set and gates it was estimated
+ * from, so a later commit can tell whether the store has moved underneath it.
+ */
+struct ResectionPoseResult {
+  int image_index = -1;
+  bool ok = false; ///< Passed min_inliers and the stability gate.
+  Eigen::Matrix3d R = Eigen::Matrix3d::Identity();
+  Eigen::Vector3d t = Eigen::Vector3d::Zero();
+  int inliers = 0;
+  double rmse_px = 0.0;
+
+  // Inputs (validation key for resection_result_is_current).
+  camera::Intrinsics K;
+  int min_inliers = 0;
+  double ransac_thresh_px = 0.0;
+  double min_inlier_ratio = 0.0;
+  std::vector<int> pnp_obs_ids;        ///< 3D–2D observation ids, in PnP order.
+  std::vector<Eigen::Vector3f> pts3d;  ///< Track XYZ of each pair at compute time.
+  std::vector<char> inlier_mask;       ///< Per pnp_obs_ids entry; filled only when ok.
+};
+
+/**
+ * PnP RANSAC + pose refinement for one image without touching the store (const reads only).
+ * Safe to call concurrently on the same store with the PoseLib backend; the GPU backend shares
+ * one context and must stay on a single thread.  PoseLib RANSAC is seeded, so equal inputs give
+ * bit-identical results regardless of thread.
+ * @return out->ok.
+ */
+bool resection_compute(const camera::Intrinsics& K, const TrackStore& store, int image_index,
+                       int min_inliers, double ransac_thresh_px, double min_inlier_ratio,
+                       ResectionPoseResult* out);
+
+/**
+ * True when recomputing r now would see the same input: same intrinsics and gates, and the
+ * image's triangulated 3D–2D set (observation ids and track XYZ) is unchanged.  O(#obs on image).
+ */
+bool resection_result_is_current(const TrackStore& store, const camera::Intrinsics& K,
+                                 int min_inliers, double ransac_thresh_px,
+                                 double min_inlier_ratio, const ResectionPoseResult& r);
+
+/// Mark r's RANSAC outliers deleted on its image (the store write of resection_single_image).
+void resection_commit_outliers(TrackStore& store, const ResectionPoseResult& r);
+
 /**
  * Count grid cells that contain at least one 3D–2D observation (COLMAP-style
  * distribution check). Only observations from tracks with triangulated xyz are used.
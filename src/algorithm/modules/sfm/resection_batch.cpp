@@ -40,7 +40,7 @@ static void image_size_for_pyramid(const camera::Intrinsics& K, size_t* out_w, s
 /// Build the VisibilityPyramid score from structural image observation ids.
 /// Returns normalized score [0,1] and sets *n_tri_out to the number of triangulated points used.
 static float build_visibility_score_from_obs_ids(const TrackStore& store,
-                                                 const std::vector<int>& obs_ids,
+                                                 ObsIdSpan obs_ids,
                                                  const camera::Intrinsics& K,
                                                  size_t num_levels, int* n_tri_out) {
   *n_tri_out = 0;
@@ -351,6 +351,38 @@ std::vector<ResectionCandidate> choose_resection_candidates(
   return out;
 }
 
+namespace {
+/// PnP RANSAC threshold for incremental registration: tighter than the single-image default since
+/// the 3D points come from already-refined tracks.
+constexpr double kBatchResectionRansacThreshPx = 4.0;
+} // namespace
+
+void precompute_resection_poses(const TrackStore& store, const std::vector<int>& image_indices,
+                                const std::vector<camera::Intrinsics>& cameras,
+                                const std::vector<int>& image_to_camera_index, int min_inliers,
+                                double min_inlier_ratio, ResectionPrecompute* out) {
+  if (!out)
+    return;
+  const int n = static_cast<int>(image_indices.size());
+  out->results.assign(static_cast<size_t>(n), ResectionPoseResult());
+  out->reused = 0;
+  out->recomputed = 0;
+  // The GPU RANSAC context is a process-wide singleton: keep it on the calling thread.
+  const bool parallel = !resection_backend_uses_gpu(get_resection_backend());
+#pragma omp parallel for schedule(dynamic, 1) if (parallel)
+  for (int i = 0; i < n; ++i) {
+    const int im = image_indices[static_cast<size_t>(i)];
+    ResectionPoseResult& r = out->results[static_cast<size_t>(i)];
+    if (im < 0 || static_cast<size_t>(im) >= image_to_camera_index.size()) {
+      r.image_index = im;
+      continue;
+    }
+    const camera::Intrinsics& K = cameras[static_cast<size_t>(image_to_camera_index[im])];
+    resection_compute(K, store, im, min_inliers, kBatchResectionRansacThreshPx, min_inlier_ratio,
+                      &r);
+  }
+}
+
 int run_batch_resection(TrackStore& store, const std::vector<int>& image_indices,
                         const std::vector<camera::Intrinsics>& cameras,
                         const std::vector<int>& image_to_camera_index,
@@ -358,7 +390,8 @@ int run_batch_resection(TrackStore& store, const std::vector<int>& image_indices
                         std::vector<Eigen::Vector3d>* poses_C, std::vector<bool>* registered,
                         int min_inliers, std::vector<int>* registered_images_out,
                         double min_inlier_ratio,
-                        double post_resection_reproj_thresh_px) {
+                        double post_resection_reproj_thresh_px,
+                        ResectionPrecompute* precomputed) {
   if (!poses_R || !poses_C || !registered)
     return 0;
   if (registered_images_out)
@@ -369,21 +402,32 @@ int run_batch_resection(TrackStore& store, const std::vector<int>& image_indices
       continue;
     const camera::Intrinsics& K = cameras[static_cast<size_t>(image_to_camera_index[im])];
     const int n_3d2d = store.image_tri_count(im);
-    Eigen::Matrix3d R;
-    Eigen::Vector3d t;
-    int inliers = 0;
-    double rmse_px = 0.0;
-    const double ransac_thresh_px =
-        4.0; // tighter threshold since we have good initialization from tracks
-    if (!resection_single_image(K, store, im, &R, &t, min_inliers, ransac_thresh_px, &inliers,
-                                &rmse_px, min_inlier_ratio)) {
+    // Serial commit: a snapshot result stands only if nothing committed since then touched this
+    // image's 3D-2D set; otherwise recompute against the live store.
+    ResectionPoseResult fresh;
+    const ResectionPoseResult* res = precomputed ? precomputed->find(im) : nullptr;
+    if (res && resection_result_is_current(store, K, min_inliers, kBatchResectionRansacThreshPx,
+                                           min_inlier_ratio, *res)) {
+      ++precomputed->reused;
+    } else {
+      if (res)
+        ++precomputed->recomputed;
+      resection_compute(K, store, im, min_inliers, kBatchResectionRansacThreshPx,
+                        min_inlier_ratio, &fresh);
+      res = &fresh;
+    }
+    const int inliers = res->inliers;
+    const double rmse_px = res->rmse_px;
+    if (!res->ok) {
       LOG(INFO) << "  resection image " << im << ": FAILED (3D-2D=" << n_3d2d
                 << ", inliers=" << inliers << ", rmse=" << rmse_px << ", need " << min_inliers
                 << ", ratio>=" << min_inlier_ratio
                 << ")";
       continue;
     }
-    Eigen::Vector3d C = -R.transpose() * t;
+    resection_commit_outliers(store, *res);
+    const Eigen::Matrix3d R = res->R;
+    Eigen::Vector3d C = -R.transpose() * res->t;
     if (post_resection_reproj_thresh_px > 0.0) {
       const int n_pr = prune_resection_observations_reprojection(&store, im, R, C, K,
                                                                  post_resection_reproj_thresh_px);
@@ -8,6 +8,7 @@
 #pragma once
 
 #include "../camera/camera_types.h"
+#include "resection.h"
 #include "track_store.h"
 #include <Eigen/Core>
 #include <limits>
@@ -90,9 +91,44 @@ std::vector<ResectionCandidate> choose_resection_candidates(
     int min_3d2d_count, int max_candidates, float min_coverage_good = 0.02f,
     size_t visibility_pyramid_levels = 6, ResectionScoreCache* score_cache = nullptr);
 
+/**
+ * PnP results for the top-K resection candidates, computed ahead of the serial commit.
+ * run_batch_resection() consumes them in its own (rank) order and re-validates each against the
+ * live store.  Only bench_batch_resection uses this: the incremental pipeline registers one image
+ * per iteration, so PnP for candidates 2..K would be discarded there.
+ */
+struct ResectionPrecompute {
+  std::vector<ResectionPoseResult> results; ///< Same order as the precomputed image list.
+  int reused = 0;     ///< Results committed (or rejected) as computed on the snapshot.
+  int recomputed = 0; ///< Results invalidated by an earlier commit and recomputed serially.
+
+  const ResectionPoseResult* find(int image_index) const {
+    for (const ResectionPoseResult& r : results)
+      if (r.image_index == image_index)
+        return &r;
+    return nullptr;
+  }
+};
+
+/**
+ * Run resection_compute() for every image against the current store, which is only read.
+ * Images are processed concurrently (OpenMP) with the PoseLib backend and one by one with the
+ * GPU backend.  Each result depends only on its own inputs, so the output is bit-identical for
+ * any thread count.  ransac threshold and intrinsics match run_batch_resection().
+ */
+void precompute_resection_poses(const TrackStore& store, const std::vector<int>& image_indices,
+                                const std::vector<camera::Intrinsics>& cameras,
+                                const std::vector<int>& image_to_camera_index, int min_inliers,
+                                double min_inlier_ratio, ResectionPrecompute* out);
+
 /**
  * Run resection for each image in the batch; intrinsics = cameras[image_to_camera_index[im]].
  * Updates poses_R, poses_C, registered for each successful resection.
+ *
+ * @param precomputed  Optional snapshot results (precompute_resection_poses).  An image's result
+ *                     is used when resection_result_is_current() still holds, i.e. no earlier
+ *                     commit or triangulation changed its 3D-2D set; otherwise the image is
+ *                     recomputed.  Either way the outcome equals a purely serial run.
  * @return Number of images newly registered.
  */
 int run_batch_resection(TrackStore& store, const std::vector<int>& image_indices,
@@ -103,7 +139,8 @@ int run_batch_resection(TrackStore& store, const std::vector<int>& image_indices
                         int min_inliers = 15,
                         std::vector<int>* registered_images_out = nullptr,
                         double min_inlier_ratio = 0.02,
-                        double post_resection_reproj_thresh_px = 0.0);
+                        double post_resection_reproj_thresh_px = 0.0,
+                        ResectionPrecompute* precomputed = nullptr);
 
 } // namespace sfm
 } // namespace insight
@@ -0,0 +1,166 @@
+/**
+ * @file  resection_batch_bench.cpp
+ * @brief Thread-scaling benchmark for parallel resection (top-K PnP + serial rank-order commit).
+ *
+ * Builds a synthetic ring of distorted cameras (pixel noise + gross outliers), registers the
+ * first half of the ring and triangulates it, then registers the remaining images the way the
+ * pipeline's global-BA phase does: candidates in rank order, each accepted pose followed by
+ * triangulation of the new image (which invalidates the 3D-2D sets of its neighbours).
+ *
+ * The serial path (no precompute) is the reference.  The parallel path runs with 1, 2, 4, ... up
+ * to omp_get_max_threads() threads and must register the same images in the same order with
+ * bit-identical poses and observation flags.
+ *
+ * Usage: bench_batch_resection [num_tracks=60000] [num_images=48] [top_k=16]
+ */
+
+#include "bench_ring_scene.h"
+#include "incremental_triangulation.h"
+#include "resection.h"
+#include "resection_batch.h"
+#include "track_store.h"
+
+#include "../camera/camera_types.h"
+
+#include <Eigen/Dense>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <omp.h>
+#include <utility>
+#include <vector>
+
+using insight::camera::Intrinsics;
+using insight::sfm::ResectionCandidate;
+using insight::sfm::ResectionPrecompute;
+using insight::sfm::TrackStore;
+
+namespace {
+
+struct Scene {
+  std::vector<Eigen::Matrix3d> R;
+  std::vector<Eigen::Vector3d> C;
+  std::vector<bool> registered;
+  std::vector<Intrinsics> cameras;
+  std::vector<int> image_to_camera;
+  TrackStore store;
+};
+
+Scene make_scene(int num_tracks, int num_images, uint32_t seed) {
+  // 20 % gross outliers keep RANSAC busy.
+  insight::sfm::bench::RingScene ring =
+      insight::sfm::bench::make_ring_scene(num_tracks, num_images, 0.2, 400.0, seed);
+  Scene s;
+  s.cameras = std::move(ring.cameras);
+  s.image_to_camera = std::move(ring.image_to_camera);
+  s.store = std::move(ring.store);
+  const std::vector<Eigen::Matrix3d>& R_true = ring.R;
+  const std::vector<Eigen::Vector3d>& C_true = ring.C;
+
+  // First half of the ring registered (true poses) and triangulated.
+  s.R.assign(static_cast<size_t>(num_images), Eigen::Matrix3d::Identity());
+  s.C.assign(static_cast<size_t>(num_images), Eigen::Vector3d::Zero());
+  s.registered.assign(static_cast<size_t>(num_images), false);
+  std::vector<int> seed_images;
+  for (int i = 0; i < num_images / 2; ++i) {
+    s.R[static_cast<size_t>(i)] = R_true[static_cast<size_t>(i)];
+    s.C[static_cast<size_t>(i)] = C_true[static_cast<size_t>(i)];
+    s.registered[static_cast<size_t>(i)] = true;
+    seed_images.push_back(i);
+  }
+  insight::sfm::run_batch_triangulation(&s.store, seed_images, s.R, s.C, s.registered, s.cameras,
+                                        s.image_to_camera, 1.0, nullptr, 4.0);
+  return s;
+}
+
+struct RunResult {
+  double ms = 0.0;
+  double ms_precompute = 0.0;
+  int reused = 0;
+  int recomputed = 0;
+  std::vector<int> order;
+  std::vector<uint64_t> pose_bits;
+  std::vector<uint8_t> obs_state;
+};
+
+RunResult run(const Scene& base, int threads, int top_k, bool parallel) {
+  Scene s = base; // fresh copy of the store per run
+  omp_set_num_threads(threads);
+  RunResult r;
+  const auto t0 = std::chrono::steady_clock::now();
+  const std::vector<ResectionCandidate> cands = insight::sfm::choose_resection_candidates(
+      s.store, s.registered, s.cameras, s.image_to_camera, 15, top_k);
+  ResectionPrecompute pre;
+  if (parallel) {
+    std::vector<int> ims;
+    for (const ResectionCandidate& c : cands)
+      ims.push_back(c.image_index);
+    const auto tp = std::chrono::steady_clock::now();
+    insight::sfm::precompute_resection_poses(s.store, ims, s.cameras, s.image_to_camera, 15, 0.02,
+                                             &pre);
+    r.ms_precompute =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tp).count();
+  }
+  std::vector<int> added;
+  for (const ResectionCandidate& c : cands) {
+    const int n = insight::sfm::run_batch_resection(s.store, {c.image_index}, s.cameras,
+                                                    s.image_to_camera, &s.R, &s.C, &s.registered,
+                                                    15, &added, 0.02, 0.0,
+                                                    parallel ? &pre : nullptr);
+    if (n <= 0)
+      continue;
+    r.order.insert(r.order.end(), added.begin(), added.end());
+    insight::sfm::run_batch_triangulation(&s.store, added, s.R, s.C, s.registered, s.cameras,
+                                          s.image_to_camera, 1.0, nullptr, 4.0);
+  }
+  r.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+  r.reused = pre.reused;
+  r.recomputed = pre.recomputed;
+
+  for (int im : r.order) {
+    const double* pr = s.R[static_cast<size_t>(im)].data();
+    const double* pc = s.C[static_cast<size_t>(im)].data();
+    for (int k = 0; k < 12; ++k) {
+      uint64_t bits;
+      std::memcpy(&bits, k < 9 ? pr + k : pc + (k - 9), sizeof(bits));
+      r.pose_bits.push_back(bits);
+    }
+  }
+  for (int o = 0; o < static_cast<int>(s.store.num_observations()); ++o)
+    r.obs_state.push_back(static_cast<uint8_t>((s.store.is_obs_valid(o) ? 1 : 0) |
+                                               (s.store.is_obs_restorable(o) ? 2 : 0)));
+  return r;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int num_tracks = argc > 1 ? std::atoi(argv[1]) : 60000;
+  const int num_images = argc > 2 ? std::atoi(argv[2]) : 48;
+  const int top_k = argc > 3 ? std::atoi(argv[3]) : 16;
+  const int max_threads = omp_get_max_threads();
+  insight::sfm::set_resection_backend(insight::sfm::ResectionBackend::kPoseLib);
+  std::printf("bench_batch_resection: %d tracks, %d images, top-%d, up to %d threads\n",
+              num_tracks, num_images, top_k, max_threads);
+  const Scene scene = make_scene(num_tracks, num_images, 11u);
+
+  const RunResult ref = run(scene, 1, top_k, /*parallel=*/false);
+  std::printf("  serial        %9.1f ms  registered=%zu  order:", ref.ms, ref.order.size());
+  for (int im : ref.order)
+    std::printf(" %d", im);
+  std::printf("\n");
+  int failures = 0;
+  for (int th = 1; th <= max_threads; th *= 2) {
+    const RunResult r = run(scene, th, top_k, /*parallel=*/true);
+    const bool same =
+        r.order == ref.order && r.pose_bits == ref.pose_bits && r.obs_state == ref.obs_state;
+    std::printf("  threads=%-3d  %9.1f ms  (precompute %.1f ms)  speedup=%.2fx  reused=%d "
+                "recomputed=%d  %s\n",
+                th, r.ms, r.ms_precompute, ref.ms / r.ms, r.reused, r.recomputed,
+                same ? "identical" : "MISMATCH");
+    if (!same)
+      ++failures;
+  }
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,451 @@
+/**
+ * @file  sfm_checkpoint.cpp
+ * @brief Incremental SfM checkpoint / resume (see sfm_checkpoint.h for the on-disk layout).
+ */
+
+#include "sfm_checkpoint.h"
+
+#include "../../io/idc_reader.h"
+#include "../../io/idc_writer.h"
+#include "../../io/track_store_idc.h"
+
+#include <filesystem>
+#include <fstream>
+#include <glog/logging.h>
+#include <nlohmann/json.hpp>
+#include <system_error>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace insight {
+namespace sfm {
+
+namespace {
+
+constexpr const char* kPointerFile = "checkpoint.json";
+constexpr int kIntrinsicsStride = 11; ///< [fx,fy,cx,cy,w,h,k1,k2,k3,p1,p2] as in SfMResultData.
+
+void pack_intrinsics(const camera::Intrinsics& K, double* k) {
+  k[0] = K.fx;
+  k[1] = K.fy;
+  k[2] = K.cx;
+  k[3] = K.cy;
+  k[4] = static_cast<double>(K.width);
+  k[5] = static_cast<double>(K.height);
+  k[6] = K.k1;
+  k[7] = K.k2;
+  k[8] = K.k3;
+  k[9] = K.p1;
+  k[10] = K.p2;
+}
+
+camera::Intrinsics unpack_intrinsics(const double* k) {
+  camera::Intrinsics K;
+  K.fx = k[0];
+  K.fy = k[1];
+  K.cx = k[2];
+  K.cy = k[3];
+  K.width = static_cast<int>(k[4]);
+  K.height = static_cast<int>(k[5]);
+  K.k1 = k[6];
+  K.k2 = k[7];
+  K.k3 = k[8];
+  K.p1 = k[9];
+  K.p2 = k[10];
+  return K;
+}
+
+template <typename T>
+void add_vector_blob(io::IDCWriter* writer, const char* name, const std::vector<T>& v,
+                     const char* dtype) {
+  if (!v.empty())
+    writer->add_blob(name, v.data(), v.size() * sizeof(T), dtype, {static_cast<int>(v.size())});
+}
+
+template <typename T> std::vector<T> read_optional_blob(io::IDCReader* reader, const char* name) {
+  return reader->has_blob(name) ? reader->read_blob<T>(name) : std::vector<T>();
+}
+
+/// Flush a written file (or, on POSIX, a directory after a rename) to stable storage, so the
+/// pointer file can never survive a power loss that truncates the slot it names.
+bool sync_to_disk(const std::string& path, bool is_directory = false) {
+#ifdef _WIN32
+  if (is_directory)
+    return true; // NTFS journals the rename; directory handles cannot be flushed.
+  HANDLE fh = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (fh == INVALID_HANDLE_VALUE)
+    return false;
+  const bool ok = FlushFileBuffers(fh) != 0;
+  CloseHandle(fh);
+  return ok;
+#else
+  const int fd = ::open(path.c_str(), is_directory ? O_RDONLY | O_DIRECTORY : O_RDONLY);
+  if (fd < 0)
+    return false;
+  const bool ok = ::fsync(fd) == 0;
+  ::close(fd);
+  return ok;
+#endif
+}
+
+std::string slot_path(const std::string& dir, int seq, const char* ext) {
+  return (std::filesystem::path(dir) / ("checkpoint_" + std::to_string(seq % 2) + ext)).string();
+}
+
+bool save_state_idc(const std::string& path, const SfMCheckpointState& st,
+                    const TrackStoreSchedulerState& ss) {
+  nlohmann::json meta;
+  meta["schema_version"] = "1.0";
+  meta["task_type"] = "sfm_checkpoint_state";
+  meta["seq"] = st.seq;
+  meta["sfm_iter"] = st.sfm_iter;
+  meta["num_registered"] = st.num_registered;
+  meta["anchor_image"] = st.anchor_image;
+  meta["second_image"] = st.second_image;
+  meta["no_candidate_consecutive"] = st.no_candidate_consecutive;
+  meta["ba_milestones"] = {{"next_periodic_global_registered", st.next_periodic_global_registered},
+                           {"next_mid_global_registered", st.next_mid_global_registered},
+                           {"ba_grid_call_count", st.ba_grid_call_count}};
+  meta["intrinsics_phase"] = st.intrinsics_phase;
+  meta["timing_ms"] = {{"choose_candidates", st.ms_choose_candidates},
+                       {"resection", st.ms_resection},
+                       {"triangulation", st.ms_triangulation},
+                       {"local_ba", st.ms_local_ba},
+                       {"global_ba", st.ms_global_ba},
+                       {"retriangulation", st.ms_retriangulation}};
+  meta["store_epochs"] = {{"obs", ss.obs_epoch},
+                          {"xyz", ss.xyz_epoch},
+                          {"registration", ss.registration_epoch},
+                          {"tri_status", ss.tri_status_epoch},
+                          {"global_pose", ss.global_pose_epoch}};
+
+  const ResectionScoreCache& sc = st.resection_score_cache;
+  nlohmann::json cands = nlohmann::json::array();
+  for (const ResectionCandidate& c : sc.cached_candidates)
+    cands.push_back({c.image_index, c.num_3d2d, c.coverage});
+  meta["score_cache"] = {{"last_obs_epoch", sc.last_obs_epoch},
+                         {"last_tri_status_epoch", sc.last_tri_status_epoch},
+                         {"last_registration_epoch", sc.last_registration_epoch},
+                         {"last_registered_count", sc.last_registered_count},
+                         {"last_min_3d2d_count", sc.last_min_3d2d_count},
+                         {"last_max_candidates", sc.last_max_candidates},
+                         {"last_min_coverage_good", sc.last_min_coverage_good},
+                         {"last_visibility_pyramid_levels", sc.last_visibility_pyramid_levels},
+                         {"cached_candidates", cands}};
+  meta["num_ba_cameras_snapshot"] = static_cast<int>(st.ba_cameras_snapshot.size());
+
+  std::vector<int32_t> entry_n_tri;
+  std::vector<float> entry_score;
+  entry_n_tri.reserve(sc.entries.size());
+  entry_score.reserve(sc.entries.size());
+  for (const ResectionScoreCache::Entry& e : sc.entries) {
+    entry_n_tri.push_back(e.n_tri);
+    entry_score.push_back(e.score);
+  }
+  std::vector<double> snapshot(st.ba_cameras_snapshot.size() * kIntrinsicsStride);
+  for (size_t c = 0; c < st.ba_cameras_snapshot.size(); ++c)
+    pack_intrinsics(st.ba_cameras_snapshot[c], &snapshot[c * kIntrinsicsStride]);
+
+  io::IDCWriter writer(path);
+  writer.set_metadata(meta);
+  add_vector_blob(&writer, "score_cache_n_tri", entry_n_tri, "int32");
+  add_vector_blob(&writer, "score_cache_score", entry_score, "float32");
+  add_vector_blob(&writer, "ba_cameras_snapshot", snapshot, "float64");
+  add_vector_blob(&writer, "track_last_tri_epoch", ss.track_last_tri_epoch, "uint64");
+  add_vector_blob(&writer, "retri_pending", ss.retri_pending, "int32");
+  add_vector_blob(&writer, "dirty_images", ss.dirty_images, "int32");
+  add_vector_blob(&writer, "dirty_tracks", ss.dirty_tracks, "int32");
+  return writer.write();
+}
+
+bool load_state_idc(const std::string& path, SfMCheckpointState* st) {
+  io::IDCReader reader(path);
+  if (!reader.is_valid())
+    return false;
+  const nlohmann::json& meta = reader.get_metadata();
+  if (meta.value("task_type", "") != "sfm_checkpoint_state")
+    return false;
+  st->seq = meta.at("seq").get<int>();
+  st->sfm_iter = meta.at("sfm_iter").get<int>();
+  st->num_registered = meta.at("num_registered").get<int>();
+  st->anchor_image = meta.at("anchor_image").get<int>();
+  st->second_image = meta.at("second_image").get<int>();
+  st->no_candidate_consecutive = meta.at("no_candidate_consecutive").get<int>();
+  const nlohmann::json& ba = meta.at("ba_milestones");
+  st->next_periodic_global_registered = ba.at("next_periodic_global_registered").get<int>();
+  st->next_mid_global_registered = ba.at("next_mid_global_registered").get<int>();
+  st->ba_grid_call_count = ba.at("ba_grid_call_count").get<int>();
+  st->intrinsics_phase = meta.at("intrinsics_phase").get<std::vector<int>>();
+  const nlohmann::json& ms = meta.at("timing_ms");
+  st->ms_choose_candidates = ms.at("choose_candidates").get<uint64_t>();
+  st->ms_resection = ms.at("resection").get<uint64_t>();
+  st->ms_triangulation = ms.at("triangulation").get<uint64_t>();
+  st->ms_local_ba = ms.at("local_ba").get<uint64_t>();
+  st->ms_global_ba = ms.at("global_ba").get<uint64_t>();
+  st->ms_retriangulation = ms.at("retriangulation").get<uint64_t>();
+
+  TrackStoreSchedulerState& ss = st->store_state;
+  const nlohmann::json& ep = meta.at("store_epochs");
+  ss.obs_epoch = ep.at("obs").get<uint64_t>();
+  ss.xyz_epoch = ep.at("xyz").get<uint64_t>();
+  ss.registration_epoch = ep.at("registration").get<uint64_t>();
+  ss.tri_status_epoch = ep.at("tri_status").get<uint64_t>();
+  ss.global_pose_epoch = ep.at("global_pose").get<uint64_t>();
+  ss.track_last_tri_epoch = read_optional_blob<uint64_t>(&reader, "track_last_tri_epoch");
+  ss.retri_pending = read_optional_blob<int>(&reader, "retri_pending");
+  ss.dirty_images = read_optional_blob<int>(&reader, "dirty_images");
+  ss.dirty_tracks = read_optional_blob<int>(&reader, "dirty_tracks");
+
+  ResectionScoreCache& sc = st->resection_score_cache;
+  const nlohmann::json& scj = meta.at("score_cache");
+  sc.last_obs_epoch = scj.at("last_obs_epoch").get<uint64_t>();
+  sc.last_tri_status_epoch = scj.at("last_tri_status_epoch").get<uint64_t>();
+  sc.last_registration_epoch = scj.at("last_registration_epoch").get<uint64_t>();
+  sc.last_registered_count = scj.at("last_registered_count").get<int>();
+  sc.last_min_3d2d_count = scj.at("last_min_3d2d_count").get<int>();
+  sc.last_max_candidates = scj.at("last_max_candidates").get<int>();
+  sc.last_min_coverage_good = scj.at("last_min_coverage_good").get<float>();
+  sc.last_visibility_pyramid_levels = scj.at("last_visibility_pyramid_levels").get<size_t>();
+  sc.cached_candidates.clear();
+  for (const nlohmann::json& c : scj.at("cached_candidates")) {
+    ResectionCandidate rc;
+    rc.image_index = c.at(0).get<int>();
+    rc.num_3d2d = c.at(1).get<int>();
+    rc.coverage = c.at(2).get<float>();
+    sc.cached_candidates.push_back(rc);
+  }
+  const std::vector<int32_t> entry_n_tri = read_optional_blob<int32_t>(&reader, "score_cache_n_tri");
+  const std::vector<float> entry_score = read_optional_blob<float>(&reader, "score_cache_score");
+  if (entry_n_tri.size() != entry_score.size())
+    return false;
+  sc.entries.resize(entry_n_tri.size());
+  for (size_t i = 0; i < entry_n_tri.size(); ++i) {
+    sc.entries[i].n_tri = entry_n_tri[i];
+    sc.entries[i].score = entry_score[i];
+  }
+
+  const std::vector<double> snapshot = read_optional_blob<double>(&reader, "ba_cameras_snapshot");
+  const size_t n_snap = static_cast<size_t>(meta.value("num_ba_cameras_snapshot", 0));
+  if (snapshot.size() != n_snap * kIntrinsicsStride)
+    return false;
+  st->ba_cameras_snapshot.resize(n_snap);
+  for (size_t c = 0; c < n_snap; ++c)
+    st->ba_cameras_snapshot[c] = unpack_intrinsics(&snapshot[c * kIntrinsicsStride]);
+  return true;
+}
+
+} // namespace
+
+std::string sfm_checkpoint_tracks_path(const std::string& dir, int seq) {
+  return slot_path(dir, seq, ".isat_tracks");
+}
+
+std::string sfm_checkpoint_state_path(const std::string& dir, int seq) {
+  return slot_path(dir, seq, ".isat_sfm_state");
+}
+
+bool save_sfm_checkpoint(const std::string& dir, const SfMCheckpointState& state,
+                         const TrackStore& store, const std::vector<Eigen::Matrix3d>& poses_R,
+                         const std::vector<Eigen::Vector3d>& poses_C,
+                         const std::vector<bool>& registered,
+                         const std::vector<camera::Intrinsics>& cameras,
+                         const std::vector<int>& image_to_camera_index) {
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  if (ec) {
+    LOG(ERROR) << "save_sfm_checkpoint: cannot create " << dir << ": " << ec.message();
+    return false;
+  }
+  const int n_imgs = store.num_images();
+  const size_t n = static_cast<size_t>(n_imgs);
+  if (poses_R.size() != n || poses_C.size() != n || registered.size() != n ||
+      image_to_camera_index.size() != n) {
+    LOG(ERROR) << "save_sfm_checkpoint: per-image array size mismatch";
+    return false;
+  }
+
+  // ── Tracks + SfMResultData (float32 for readers of schema 1.3, f64 for exact resume) ──────
+  SfMResultData pose;
+  pose.pose_R.assign(n * 9, 0.f);
+  pose.pose_C.assign(n * 3, 0.f);
+  pose.pose_R_f64.assign(n * 9, 0.0);
+  pose.pose_C_f64.assign(n * 3, 0.0);
+  pose.registered.assign(n, 0);
+  pose.cam_idx.assign(image_to_camera_index.begin(), image_to_camera_index.end());
+  int n_reg = 0;
+  for (size_t i = 0; i < n; ++i) {
+    if (!registered[i])
+      continue;
+    ++n_reg;
+    pose.registered[i] = 1;
+    for (int r = 0; r < 3; ++r) {
+      for (int c = 0; c < 3; ++c) {
+        pose.pose_R_f64[i * 9 + static_cast<size_t>(r * 3 + c)] = poses_R[i](r, c);
+        pose.pose_R[i * 9 + static_cast<size_t>(r * 3 + c)] = static_cast<float>(poses_R[i](r, c));
+      }
+      pose.pose_C_f64[i * 3 + static_cast<size_t>(r)] = poses_C[i](r);
+      pose.pose_C[i * 3 + static_cast<size_t>(r)] = static_cast<float>(poses_C[i](r));
+    }
+  }
+  pose.num_cameras = static_cast<int>(cameras.size());
+  pose.intrinsics_f64.assign(cameras.size() * kIntrinsicsStride, 0.0);
+  pose.intrinsics.assign(cameras.size() * kIntrinsicsStride, 0.f);
+  for (size_t c = 0; c < cameras.size(); ++c) {
+    pack_intrinsics(cameras[c], &pose.intrinsics_f64[c * kIntrinsicsStride]);
+    for (int k = 0; k < kIntrinsicsStride; ++k)
+      pose.intrinsics[c * kIntrinsicsStride + static_cast<size_t>(k)] =
+          static_cast<float>(pose.intrinsics_f64[c * kIntrinsicsStride + static_cast<size_t>(k)]);
+  }
+
+  std::vector<uint32_t> img_indices(n);
+  for (int i = 0; i < n_imgs; ++i)
+    img_indices[static_cast<size_t>(i)] = static_cast<uint32_t>(i);
+  TrackSaveOptions save_opts;
+  save_opts.is_sfm_result = true;
+  save_opts.num_registered_images = n_reg;
+  save_opts.sfm_pose = &pose;
+  save_opts.keep_deleted_observations = true;
+
+  const std::string tracks_path = sfm_checkpoint_tracks_path(dir, state.seq);
+  const std::string state_path = sfm_checkpoint_state_path(dir, state.seq);
+  if (!save_track_store_to_idc(store, img_indices, tracks_path, nullptr, &save_opts)) {
+    LOG(ERROR) << "save_sfm_checkpoint: failed to write " << tracks_path;
+    return false;
+  }
+  if (!save_state_idc(state_path, state, store.scheduler_state())) {
+    LOG(ERROR) << "save_sfm_checkpoint: failed to write " << state_path;
+    return false;
+  }
+  if (!sync_to_disk(tracks_path) || !sync_to_disk(state_path)) {
+    LOG(ERROR) << "save_sfm_checkpoint: fsync of slot " << state.seq % 2 << " failed";
+    return false;
+  }
+
+  // ── Pointer file last, atomically: checkpoint.json only ever names a complete slot ────────
+  nlohmann::json ptr;
+  ptr["seq"] = state.seq;
+  ptr["sfm_iter"] = state.sfm_iter;
+  ptr["num_registered"] = state.num_registered;
+  ptr["tracks"] = std::filesystem::path(tracks_path).filename().string();
+  ptr["state"] = std::filesystem::path(state_path).filename().string();
+  const std::filesystem::path final_path = std::filesystem::path(dir) / kPointerFile;
+  const std::filesystem::path tmp_path = final_path.string() + ".tmp";
+  {
+    std::ofstream out(tmp_path);
+    out << ptr.dump(2) << "\n";
+    out.flush();
+    if (!out) {
+      LOG(ERROR) << "save_sfm_checkpoint: failed to write " << tmp_path;
+      return false;
+    }
+  }
+  if (!sync_to_disk(tmp_path.string())) {
+    LOG(ERROR) << "save_sfm_checkpoint: fsync of " << tmp_path << " failed";
+    return false;
+  }
+  std::filesystem::rename(tmp_path, final_path, ec);
+  if (ec) {
+    LOG(ERROR) << "save_sfm_checkpoint: rename to " << final_path << " failed: " << ec.message();
+    return false;
+  }
+  // Persist the rename itself; failure only risks losing this (newest) checkpoint.
+  if (!sync_to_disk(dir, true))
+    LOG(WARNING) << "save_sfm_checkpoint: fsync of directory " << dir << " failed";
+  return true;
+}
+
+bool load_sfm_checkpoint(const std::string& path, SfMCheckpointState* state, TrackStore* store,
+                         std::vector<Eigen::Matrix3d>* poses_R,
+                         std::vector<Eigen::Vector3d>* poses_C, std::vector<bool>* registered,
+                         std::vector<camera::Intrinsics>* cameras) {
+  if (!state || !store || !poses_R || !poses_C || !registered || !cameras)
+    return false;
+  std::filesystem::path ptr_path(path);
+  if (std::filesystem::is_directory(ptr_path))
+    ptr_path /= kPointerFile;
+  std::ifstream in(ptr_path);
+  if (!in) {
+    LOG(ERROR) << "load_sfm_checkpoint: cannot open " << ptr_path;
+    return false;
+  }
+  nlohmann::json ptr;
+  try {
+    in >> ptr;
+  } catch (const nlohmann::json::exception& e) {
+    LOG(ERROR) << "load_sfm_checkpoint: bad JSON in " << ptr_path << ": " << e.what();
+    return false;
+  }
+  const std::filesystem::path dir = ptr_path.parent_path();
+  const std::string tracks_path = (dir / ptr.value("tracks", "")).string();
+  const std::string state_path = (dir / ptr.value("state", "")).string();
+
+  SfMResultData pose;
+  *store = TrackStore();
+  if (!load_track_store_from_idc(tracks_path, store, nullptr, nullptr, &pose)) {
+    LOG(ERROR) << "load_sfm_checkpoint: failed to load " << tracks_path;
+    return false;
+  }
+  const size_t n = static_cast<size_t>(store->num_images());
+  if (pose.pose_R_f64.size() != n * 9 || pose.pose_C_f64.size() != n * 3 ||
+      pose.registered.size() != n) {
+    LOG(ERROR) << "load_sfm_checkpoint: " << tracks_path << " has no full-precision pose data";
+    return false;
+  }
+  if (pose.num_cameras < 0 ||
+      pose.intrinsics_f64.size() != static_cast<size_t>(pose.num_cameras) * kIntrinsicsStride) {
+    LOG(ERROR) << "load_sfm_checkpoint: " << tracks_path << " has "
+               << pose.intrinsics_f64.size() << " intrinsics values, expected "
+               << pose.num_cameras << " x " << kIntrinsicsStride;
+    return false;
+  }
+  if (!cameras->empty() && static_cast<size_t>(pose.num_cameras) != cameras->size()) {
+    LOG(ERROR) << "load_sfm_checkpoint: checkpoint has " << pose.num_cameras
+               << " cameras, project has " << cameras->size();
+    return false;
+  }
+
+  try {
+    if (!load_state_idc(state_path, state)) {
+      LOG(ERROR) << "load_sfm_checkpoint: invalid scheduler state " << state_path;
+      return false;
+    }
+  } catch (const nlohmann::json::exception& e) {
+    LOG(ERROR) << "load_sfm_checkpoint: bad scheduler state " << state_path << ": " << e.what();
+    return false;
+  }
+  if (state->store_state.track_last_tri_epoch.size() != store->num_tracks()) {
+    LOG(ERROR) << "load_sfm_checkpoint: track_last_tri_epoch size mismatch";
+    return false;
+  }
+  store->restore_scheduler_state(state->store_state);
+
+  poses_R->assign(n, Eigen::Matrix3d::Identity());
+  poses_C->assign(n, Eigen::Vector3d::Zero());
+  registered->assign(n, false);
+  for (size_t i = 0; i < n; ++i) {
+    (*registered)[i] = pose.registered[i] != 0;
+    for (int r = 0; r < 3; ++r) {
+      for (int c = 0; c < 3; ++c)
+        (*poses_R)[i](r, c) = pose.pose_R_f64[i * 9 + static_cast<size_t>(r * 3 + c)];
+      (*poses_C)[i](r) = pose.pose_C_f64[i * 3 + static_cast<size_t>(r)];
+    }
+  }
+  cameras->resize(static_cast<size_t>(pose.num_cameras));
+  for (size_t c = 0; c < cameras->size(); ++c)
+    (*cameras)[c] = unpack_intrinsics(&pose.intrinsics_f64[c * kIntrinsicsStride]);
+  LOG(INFO) << "load_sfm_checkpoint: " << tracks_path << " (seq=" << state->seq
+            << " sfm_iter=" << state->sfm_iter << " registered=" << state->num_registered << ")";
+  return true;
+}
+
+} // namespace sfm
+} // namespace insight
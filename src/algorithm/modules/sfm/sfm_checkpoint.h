@@ -0,0 +1,88 @@
+/**
+ * @file  sfm_checkpoint.h
+ * @brief Incremental SfM checkpoint / resume: exact-state tracks + scheduler state on disk.
+ *
+ * Directory layout
+ * ────────────────
+ *   checkpoint_<slot>.isat_tracks     Schema 1.3 tracks with SfMResultData (poses, intrinsics,
+ *                                     registered; f64 copies) and deleted observations kept, so a
+ *                                     reload reproduces observation ids and flags exactly.
+ *   checkpoint_<slot>.isat_sfm_state  IDC with the scheduler state: loop counters, BA milestones,
+ *                                     ResectionScoreCache watermarks + entries, TrackStore epochs
+ *                                     and queues, intrinsics schedule phase per camera.
+ *   checkpoint.json                   Pointer to the last complete slot; replaced by rename only
+ *                                     after both slot files are written.
+ * Slots alternate (slot = seq % 2), so a crash while writing leaves the previous checkpoint
+ * intact and still referenced by checkpoint.json.
+ */
+
+#pragma once
+
+#include "../camera/camera_types.h"
+#include "resection_batch.h"
+#include "track_store.h"
+#include <Eigen/Core>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace insight {
+namespace sfm {
+
+/// Main-loop state of run_incremental_sfm_pipeline that is not stored in the tracks/poses.
+struct SfMCheckpointState {
+  int seq = 0;            ///< Checkpoint sequence number (0, 1, ...); slot = seq % 2.
+  int sfm_iter = 0;       ///< Last completed SfM iteration.
+  int num_registered = 0;
+  int anchor_image = -1;  ///< Initial-pair im0: world origin, fixed in every global BA.
+  int second_image = -1;  ///< Initial-pair im1: passed to BA as the scale reference.
+  int no_candidate_consecutive = 0;
+  int next_periodic_global_registered = -1; ///< Late-phase global BA milestone.
+  int next_mid_global_registered = -1;      ///< Mid-phase global BA milestone.
+  int ba_grid_call_count = 0;               ///< Grid-NMS reselect cadence counter.
+  /// IntrinsicsSchedule phase (0..3) per camera at checkpoint time.  The schedule is derived from
+  /// per-camera registered counts; the saved value lets resume detect a changed schedule.
+  std::vector<int> intrinsics_phase;
+
+  // Accumulated per-stage wall time (ms) of all previous runs, continued after resume.
+  uint64_t ms_choose_candidates = 0;
+  uint64_t ms_resection = 0;
+  uint64_t ms_triangulation = 0;
+  uint64_t ms_local_ba = 0;
+  uint64_t ms_global_ba = 0;
+  uint64_t ms_retriangulation = 0;
+
+  std::vector<camera::Intrinsics> ba_cameras_snapshot; ///< Intrinsics before the last global BA.
+  ResectionScoreCache resection_score_cache;
+  TrackStoreSchedulerState store_state;
+};
+
+/// Paths of the slot files for checkpoint number seq inside dir.
+std::string sfm_checkpoint_tracks_path(const std::string& dir, int seq);
+std::string sfm_checkpoint_state_path(const std::string& dir, int seq);
+
+/**
+ * Write checkpoint state.seq into dir (created if missing) and then point checkpoint.json at it.
+ * state.store_state is ignored; the store's current scheduler state is written instead.
+ * Returns false (and leaves checkpoint.json untouched) on any write failure.
+ */
+bool save_sfm_checkpoint(const std::string& dir, const SfMCheckpointState& state,
+                         const TrackStore& store, const std::vector<Eigen::Matrix3d>& poses_R,
+                         const std::vector<Eigen::Vector3d>& poses_C,
+                         const std::vector<bool>& registered,
+                         const std::vector<camera::Intrinsics>& cameras,
+                         const std::vector<int>& image_to_camera_index);
+
+/**
+ * Load the checkpoint referenced by dir/checkpoint.json (or, when path names a .json file
+ * directly, by that file).  Rebuilds the store, restores its scheduler state, and fills poses,
+ * registered flags and camera intrinsics (full precision).  Cameras keep their count: the
+ * checkpoint must have been written for the same camera list.
+ */
+bool load_sfm_checkpoint(const std::string& path, SfMCheckpointState* state, TrackStore* store,
+                         std::vector<Eigen::Matrix3d>* poses_R,
+                         std::vector<Eigen::Vector3d>* poses_C, std::vector<bool>* registered,
+                         std::vector<camera::Intrinsics>* cameras);
+
+} // namespace sfm
+} // namespace insight
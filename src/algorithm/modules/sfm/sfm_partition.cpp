@@ -0,0 +1,718 @@
+/**
+ * @file  sfm_partition.cpp
+ * @brief View-graph clustering and Sim3 sub-model merge for partitioned SfM (see sfm_partition.h).
+ */
+
+#include "sfm_partition.h"
+
+#include "../../io/track_store_idc.h"
+
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <cmath>
+#include <glog/logging.h>
+#include <numeric>
+#include <queue>
+#include <random>
+
+namespace insight {
+namespace sfm {
+
+namespace {
+
+using Adjacency = std::vector<std::vector<std::pair<int, int>>>; ///< image → (neighbour, weight)
+
+inline uint64_t pair_key(uint32_t a, uint32_t b) {
+  if (a > b)
+    std::swap(a, b);
+  return (static_cast<uint64_t>(a) << 32) | b;
+}
+
+/// Edge weights = shared alive tracks per view-graph pair; zero-weight pairs are dropped.
+Adjacency build_covisibility_adjacency(const ViewGraph& view_graph, const TrackStore& store,
+                                       int max_track_images) {
+  const int n_images = store.num_images();
+  std::unordered_map<uint64_t, int> edge_weight;
+  edge_weight.reserve(view_graph.num_pairs() * 2);
+  for (size_t i = 0; i < view_graph.num_pairs(); ++i) {
+    const PairGeoInfo& p = view_graph.pair_at(i);
+    if (p.image1_index == p.image2_index || static_cast<int>(p.image1_index) >= n_images ||
+        static_cast<int>(p.image2_index) >= n_images)
+      continue;
+    edge_weight.emplace(pair_key(p.image1_index, p.image2_index), 0);
+  }
+
+  std::vector<int> obs_ids;
+  std::vector<uint32_t> images;
+  for (int tid = 0; tid < static_cast<int>(store.num_tracks()); ++tid) {
+    if (!store.is_track_valid(tid))
+      continue;
+    store.get_track_obs_ids(tid, &obs_ids);
+    images.clear();
+    for (int obs_id : obs_ids) {
+      Observation o;
+      store.get_obs(obs_id, &o);
+      images.push_back(o.image_index);
+    }
+    std::sort(images.begin(), images.end());
+    images.erase(std::unique(images.begin(), images.end()), images.end());
+    if (static_cast<int>(images.size()) > max_track_images)
+      images.resize(static_cast<size_t>(max_track_images));
+    for (size_t a = 0; a < images.size(); ++a)
+      for (size_t b = a + 1; b < images.size(); ++b) {
+        auto it = edge_weight.find(pair_key(images[a], images[b]));
+        if (it != edge_weight.end())
+          ++it->second;
+      }
+  }
+
+  Adjacency adj(static_cast<size_t>(n_images));
+  for (const auto& kv : edge_weight) {
+    if (kv.second <= 0)
+      continue;
+    const int a = static_cast<int>(kv.first >> 32);
+    const int b = static_cast<int>(kv.first & 0xffffffffu);
+    adj[static_cast<size_t>(a)].emplace_back(b, kv.second);
+    adj[static_cast<size_t>(b)].emplace_back(a, kv.second);
+  }
+  for (auto& nb : adj)
+    std::sort(nb.begin(), nb.end()); // deterministic neighbour order (hash map order is not)
+  return adj;
+}
+
+/// Connected components of the subgraph induced by nodes (member[v] == part).
+std::vector<std::vector<int>> components_in_part(const Adjacency& adj, std::vector<int>& member,
+                                                 const std::vector<int>& nodes, int part) {
+  std::vector<std::vector<int>> comps;
+  std::vector<char> seen(adj.size(), 0);
+  for (int s : nodes) {
+    if (seen[static_cast<size_t>(s)])
+      continue;
+    comps.emplace_back();
+    std::vector<int> stack = {s};
+    seen[static_cast<size_t>(s)] = 1;
+    while (!stack.empty()) {
+      const int v = stack.back();
+      stack.pop_back();
+      comps.back().push_back(v);
+      for (const auto& e : adj[static_cast<size_t>(v)]) {
+        if (member[static_cast<size_t>(e.first)] != part || seen[static_cast<size_t>(e.first)])
+          continue;
+        seen[static_cast<size_t>(e.first)] = 1;
+        stack.push_back(e.first);
+      }
+    }
+    std::sort(comps.back().begin(), comps.back().end());
+  }
+  return comps;
+}
+
+/// BFS hop distances from src inside part; returns the farthest node (lowest index on ties).
+int bfs_farthest(const Adjacency& adj, const std::vector<int>& member, int part, int src,
+                 std::vector<int>* dist) {
+  for (auto& d : *dist)
+    d = -1;
+  std::queue<int> q;
+  q.push(src);
+  (*dist)[static_cast<size_t>(src)] = 0;
+  int far = src;
+  while (!q.empty()) {
+    const int v = q.front();
+    q.pop();
+    const int dv = (*dist)[static_cast<size_t>(v)];
+    if (dv > (*dist)[static_cast<size_t>(far)] ||
+        (dv == (*dist)[static_cast<size_t>(far)] && v < far))
+      far = v;
+    for (const auto& e : adj[static_cast<size_t>(v)]) {
+      if (member[static_cast<size_t>(e.first)] != part || (*dist)[static_cast<size_t>(e.first)] >= 0)
+        continue;
+      (*dist)[static_cast<size_t>(e.first)] = dv + 1;
+      q.push(e.first);
+    }
+  }
+  return far;
+}
+
+/// Balanced bisection of a connected part: split along the BFS axis between two peripheral
+/// images, then greedy boundary moves that cut fewer shared tracks while keeping 45/55 balance.
+void bisect(const Adjacency& adj, std::vector<int>& member, const std::vector<int>& nodes,
+            int part, int part_a, int part_b, std::vector<int>* a_out, std::vector<int>* b_out) {
+  std::vector<int> dist(adj.size(), -1), dist_a(adj.size(), -1), dist_b(adj.size(), -1);
+  const int a = bfs_farthest(adj, member, part, nodes.front(), &dist);
+  const int b = bfs_farthest(adj, member, part, a, &dist_a);
+  bfs_farthest(adj, member, part, b, &dist_b);
+
+  std::vector<int> order = nodes;
+  std::sort(order.begin(), order.end(), [&](int x, int y) {
+    const int kx = dist_a[static_cast<size_t>(x)] - dist_b[static_cast<size_t>(x)];
+    const int ky = dist_a[static_cast<size_t>(y)] - dist_b[static_cast<size_t>(y)];
+    if (kx != ky)
+      return kx < ky;
+    if (dist_a[static_cast<size_t>(x)] != dist_a[static_cast<size_t>(y)])
+      return dist_a[static_cast<size_t>(x)] < dist_a[static_cast<size_t>(y)];
+    return x < y;
+  });
+  const int n = static_cast<int>(order.size());
+  int n_a = n / 2;
+  for (int i = 0; i < n; ++i)
+    member[static_cast<size_t>(order[static_cast<size_t>(i)])] = i < n_a ? part_a : part_b;
+
+  const int lo = std::max(1, static_cast<int>(std::floor(0.45 * n)));
+  const int hi = std::min(n - 1, static_cast<int>(std::ceil(0.55 * n)));
+  for (int pass = 0; pass < 4; ++pass) {
+    bool moved = false;
+    for (int v : nodes) {
+      const int own = member[static_cast<size_t>(v)];
+      const int other = own == part_a ? part_b : part_a;
+      int w_own = 0, w_other = 0;
+      for (const auto& e : adj[static_cast<size_t>(v)]) {
+        const int m = member[static_cast<size_t>(e.first)];
+        if (m == own)
+          w_own += e.second;
+        else if (m == other)
+          w_other += e.second;
+      }
+      if (w_other <= w_own)
+        continue;
+      const int n_a_after = own == part_a ? n_a - 1 : n_a + 1;
+      if (n_a_after < lo || n_a_after > hi)
+        continue;
+      member[static_cast<size_t>(v)] = other;
+      n_a = n_a_after;
+      moved = true;
+    }
+    if (!moved)
+      break;
+  }
+  a_out->clear();
+  b_out->clear();
+  for (int v : nodes)
+    (member[static_cast<size_t>(v)] == part_a ? a_out : b_out)->push_back(v);
+}
+
+void split_recursive(const Adjacency& adj, std::vector<int>& member, std::vector<int> nodes,
+                     int part, int max_size, int* next_part,
+                     std::vector<std::vector<int>>* clusters) {
+  for (std::vector<int>& comp : components_in_part(adj, member, nodes, part)) {
+    if (static_cast<int>(comp.size()) <= max_size) {
+      clusters->push_back(std::move(comp));
+      continue;
+    }
+    const int comp_part = (*next_part)++;
+    for (int v : comp)
+      member[static_cast<size_t>(v)] = comp_part;
+    const int part_a = (*next_part)++;
+    const int part_b = (*next_part)++;
+    std::vector<int> half_a, half_b;
+    bisect(adj, member, comp, comp_part, part_a, part_b, &half_a, &half_b);
+    split_recursive(adj, member, std::move(half_a), part_a, max_size, next_part, clusters);
+    split_recursive(adj, member, std::move(half_b), part_b, max_size, next_part, clusters);
+  }
+}
+
+bool umeyama_sim3(const std::vector<Eigen::Vector3d>& src, const std::vector<Eigen::Vector3d>& dst,
+                  const std::vector<int>& idx, Sim3* out) {
+  const int m = static_cast<int>(idx.size());
+  Eigen::Matrix3Xd S(3, m), D(3, m);
+  for (int i = 0; i < m; ++i) {
+    S.col(i) = src[static_cast<size_t>(idx[static_cast<size_t>(i)])];
+    D.col(i) = dst[static_cast<size_t>(idx[static_cast<size_t>(i)])];
+  }
+  const Eigen::Matrix4d T = Eigen::umeyama(S, D, true);
+  const double scale = T.block<3, 1>(0, 0).norm();
+  if (!(scale > 0.0) || !std::isfinite(scale) || !T.allFinite())
+    return false;
+  out->scale = scale;
+  out->R = T.block<3, 3>(0, 0) / scale;
+  out->t = T.block<3, 1>(0, 3);
+  return true;
+}
+
+int count_sim3_inliers(const std::vector<Eigen::Vector3d>& src,
+                       const std::vector<Eigen::Vector3d>& dst, const Sim3& sim, double thresh,
+                       std::vector<int>* inliers) {
+  const double thresh_sq = thresh * thresh;
+  if (inliers)
+    inliers->clear();
+  int n = 0;
+  for (size_t i = 0; i < src.size(); ++i) {
+    if ((sim.apply(src[i]) - dst[i]).squaredNorm() > thresh_sq)
+      continue;
+    ++n;
+    if (inliers)
+      inliers->push_back(static_cast<int>(i));
+  }
+  return n;
+}
+
+} // namespace
+
+std::vector<int> SfMCluster::images() const {
+  std::vector<int> all = core;
+  all.insert(all.end(), overlap.begin(), overlap.end());
+  std::sort(all.begin(), all.end());
+  all.erase(std::unique(all.begin(), all.end()), all.end());
+  return all;
+}
+
+std::vector<SfMCluster> partition_view_graph(const ViewGraph& view_graph, const TrackStore& store,
+                                             const PartitionOptions& opts) {
+  const int n_images = store.num_images();
+  const Adjacency adj =
+      build_covisibility_adjacency(view_graph, store, std::max(2, opts.max_track_images_for_weights));
+
+  std::vector<int> nodes;
+  for (int i = 0; i < n_images; ++i)
+    if (!adj[static_cast<size_t>(i)].empty())
+      nodes.push_back(i);
+  std::vector<int> member(static_cast<size_t>(n_images), -1);
+  for (int v : nodes)
+    member[static_cast<size_t>(v)] = 0;
+  int next_part = 1;
+  std::vector<std::vector<int>> cores;
+  split_recursive(adj, member, nodes, 0, std::max(1, opts.max_cluster_images), &next_part, &cores);
+
+  // Fold undersized clusters into their best-connected neighbour (smallest first); isolated small
+  // components cannot be merged with anything and are dropped.
+  std::vector<int> cluster_of(static_cast<size_t>(n_images), -1);
+  for (size_t c = 0; c < cores.size(); ++c)
+    for (int v : cores[c])
+      cluster_of[static_cast<size_t>(v)] = static_cast<int>(c);
+  for (;;) {
+    int smallest = -1;
+    for (size_t c = 0; c < cores.size(); ++c) {
+      if (cores[c].empty() || static_cast<int>(cores[c].size()) >= opts.min_cluster_images)
+        continue;
+      if (smallest < 0 || cores[c].size() < cores[static_cast<size_t>(smallest)].size())
+        smallest = static_cast<int>(c);
+    }
+    if (smallest < 0)
+      break;
+    std::unordered_map<int, long long> w_to;
+    for (int v : cores[static_cast<size_t>(smallest)])
+      for (const auto& e : adj[static_cast<size_t>(v)]) {
+        const int c = cluster_of[static_cast<size_t>(e.first)];
+        if (c >= 0 && c != smallest)
+          w_to[c] += e.second;
+      }
+    int best = -1;
+    long long best_w = 0;
+    for (const auto& kv : w_to)
+      if (kv.second > best_w || (kv.second == best_w && best >= 0 && kv.first < best)) {
+        best = kv.first;
+        best_w = kv.second;
+      }
+    std::vector<int>& src = cores[static_cast<size_t>(smallest)];
+    if (best >= 0) {
+      for (int v : src)
+        cluster_of[static_cast<size_t>(v)] = best;
+      std::vector<int>& dst = cores[static_cast<size_t>(best)];
+      dst.insert(dst.end(), src.begin(), src.end());
+      std::sort(dst.begin(), dst.end());
+    } else {
+      VLOG(1) << "partition_view_graph: dropping isolated component of " << src.size()
+              << " images";
+      for (int v : src)
+        cluster_of[static_cast<size_t>(v)] = -1;
+    }
+    src.clear();
+  }
+
+  std::vector<SfMCluster> clusters;
+  std::vector<int> new_id(cores.size(), -1);
+  for (size_t c = 0; c < cores.size(); ++c) {
+    if (cores[c].empty())
+      continue;
+    new_id[c] = static_cast<int>(clusters.size());
+    clusters.emplace_back();
+    clusters.back().core = cores[c];
+  }
+  for (int v = 0; v < n_images; ++v)
+    if (cluster_of[static_cast<size_t>(v)] >= 0)
+      cluster_of[static_cast<size_t>(v)] = new_id[static_cast<size_t>(cluster_of[static_cast<size_t>(v)])];
+
+  // Overlap: grow each cluster greedily by the outside image most strongly tied to it (the
+  // images already borrowed count too, so the overlap extends as a band past the boundary).
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    const size_t k = static_cast<size_t>(std::max<double>(
+        opts.min_overlap_images,
+        std::ceil(opts.overlap_ratio * static_cast<double>(clusters[c].core.size()))));
+    std::unordered_map<int, long long> w_out;
+    auto add_edges = [&](int v) {
+      for (const auto& e : adj[static_cast<size_t>(v)]) {
+        const int oc = cluster_of[static_cast<size_t>(e.first)];
+        if (oc >= 0 && oc != static_cast<int>(c))
+          w_out[e.first] += e.second;
+      }
+    };
+    for (int v : clusters[c].core)
+      add_edges(v);
+    while (clusters[c].overlap.size() < k && !w_out.empty()) {
+      int best = -1;
+      long long best_w = -1;
+      for (const auto& kv : w_out)
+        if (kv.second > best_w || (kv.second == best_w && kv.first < best)) {
+          best = kv.first;
+          best_w = kv.second;
+        }
+      clusters[c].overlap.push_back(best);
+      add_edges(best);
+      for (int v : clusters[c].overlap)
+        w_out.erase(v);
+    }
+    std::sort(clusters[c].overlap.begin(), clusters[c].overlap.end());
+  }
+
+  LOG(INFO) << "partition_view_graph: " << nodes.size() << " connected images → "
+            << clusters.size() << " clusters (max_core=" << opts.max_cluster_images
+            << ", overlap_ratio=" << opts.overlap_ratio << ")";
+  return clusters;
+}
+
+void extract_cluster_track_store(const TrackStore& full, const std::vector<int>& images,
+                                 TrackStore* out) {
+  if (!out)
+    return;
+  *out = TrackStore();
+  out->set_num_images(full.num_images());
+  std::vector<char> in_cluster(static_cast<size_t>(full.num_images()), 0);
+  for (int im : images)
+    if (im >= 0 && im < full.num_images())
+      in_cluster[static_cast<size_t>(im)] = 1;
+
+  std::vector<int> obs_ids;
+  std::vector<Observation> kept;
+  for (int tid = 0; tid < static_cast<int>(full.num_tracks()); ++tid) {
+    if (!full.is_track_valid(tid))
+      continue;
+    full.get_track_obs_ids(tid, &obs_ids);
+    kept.clear();
+    for (int obs_id : obs_ids) {
+      Observation o;
+      full.get_obs(obs_id, &o);
+      if (in_cluster[o.image_index])
+        kept.push_back(o);
+    }
+    if (kept.size() < 2)
+      continue;
+    const int new_tid = out->add_track(0.f, 0.f, 0.f);
+    for (const Observation& o : kept)
+      out->add_observation(new_tid, o.image_index, o.feature_id, o.u, o.v, o.scale);
+  }
+  out->compact();
+}
+
+ViewGraph filter_view_graph(const ViewGraph& view_graph, const std::vector<int>& images) {
+  int max_im = -1;
+  for (int im : images)
+    max_im = std::max(max_im, im);
+  std::vector<char> in_set(static_cast<size_t>(max_im + 1), 0);
+  for (int im : images)
+    if (im >= 0)
+      in_set[static_cast<size_t>(im)] = 1;
+  auto inside = [&](uint32_t im) { return im < in_set.size() && in_set[im]; };
+  ViewGraph out;
+  for (size_t i = 0; i < view_graph.num_pairs(); ++i) {
+    const PairGeoInfo& p = view_graph.pair_at(i);
+    if (inside(p.image1_index) && inside(p.image2_index))
+      out.add_pair(p);
+  }
+  return out;
+}
+
+bool estimate_sim3_ransac(const std::vector<Eigen::Vector3d>& src,
+                          const std::vector<Eigen::Vector3d>& dst, const Sim3RansacOptions& opts,
+                          Sim3* out, std::vector<char>* inlier_mask, int* num_inliers) {
+  if (num_inliers)
+    *num_inliers = 0;
+  const int n = static_cast<int>(src.size());
+  if (!out || n < 3 || dst.size() != src.size() || n < opts.min_inliers)
+    return false;
+
+  Eigen::Vector3d centroid = Eigen::Vector3d::Zero();
+  for (const Eigen::Vector3d& p : dst)
+    centroid += p;
+  centroid /= static_cast<double>(n);
+  std::vector<double> spread(static_cast<size_t>(n));
+  for (int i = 0; i < n; ++i)
+    spread[static_cast<size_t>(i)] = (dst[static_cast<size_t>(i)] - centroid).norm();
+  std::nth_element(spread.begin(), spread.begin() + n / 2, spread.end());
+  const double thresh = opts.inlier_threshold_rel * spread[static_cast<size_t>(n / 2)];
+  if (!(thresh > 0.0))
+    return false;
+
+  std::mt19937 rng(opts.seed);
+  std::uniform_int_distribution<int> pick(0, n - 1);
+  Sim3 best;
+  int best_n = -1;
+  std::vector<int> sample(3);
+  for (int it = 0; it < opts.max_iterations && best_n < n; ++it) {
+    sample[0] = pick(rng);
+    do
+      sample[1] = pick(rng);
+    while (sample[1] == sample[0]);
+    do
+      sample[2] = pick(rng);
+    while (sample[2] == sample[0] || sample[2] == sample[1]);
+    // Skip near-collinear samples (rotation about the line is unconstrained).
+    const Eigen::Vector3d d1 = src[static_cast<size_t>(sample[1])] - src[static_cast<size_t>(sample[0])];
+    const Eigen::Vector3d d2 = src[static_cast<size_t>(sample[2])] - src[static_cast<size_t>(sample[0])];
+    if (d1.cross(d2).norm() <= 1e-9 * std::max(1e-12, d1.squaredNorm() + d2.squaredNorm()))
+      continue;
+    Sim3 sim;
+    if (!umeyama_sim3(src, dst, sample, &sim))
+      continue;
+    const int n_in = count_sim3_inliers(src, dst, sim, thresh, nullptr);
+    if (n_in > best_n) {
+      best_n = n_in;
+      best = sim;
+    }
+  }
+  if (best_n < std::max(3, opts.min_inliers))
+    return false;
+
+  // Least-squares refit on the consensus set (twice: the set can grow after the first refit).
+  std::vector<int> inliers;
+  count_sim3_inliers(src, dst, best, thresh, &inliers);
+  for (int round = 0; round < 2; ++round) {
+    Sim3 refit;
+    if (!umeyama_sim3(src, dst, inliers, &refit))
+      break;
+    std::vector<int> refit_inliers;
+    count_sim3_inliers(src, dst, refit, thresh, &refit_inliers);
+    if (refit_inliers.size() < inliers.size())
+      break;
+    best = refit;
+    inliers.swap(refit_inliers);
+  }
+  if (static_cast<int>(inliers.size()) < std::max(3, opts.min_inliers))
+    return false;
+
+  *out = best;
+  if (num_inliers)
+    *num_inliers = static_cast<int>(inliers.size());
+  if (inlier_mask) {
+    inlier_mask->assign(static_cast<size_t>(n), 0);
+    for (int i : inliers)
+      (*inlier_mask)[static_cast<size_t>(i)] = 1;
+  }
+  return true;
+}
+
+void collect_observation_points(const TrackStore& store,
+                                std::unordered_map<uint64_t, Eigen::Vector3d>* out) {
+  if (!out)
+    return;
+  out->clear();
+  std::vector<int> obs_ids;
+  for (int tid = 0; tid < static_cast<int>(store.num_tracks()); ++tid) {
+    if (!store.is_track_valid(tid) || !store.track_has_triangulated_xyz(tid))
+      continue;
+    float x, y, z;
+    store.get_track_xyz(tid, &x, &y, &z);
+    const Eigen::Vector3d X(x, y, z);
+    store.get_track_obs_ids(tid, &obs_ids);
+    for (int obs_id : obs_ids) {
+      Observation o;
+      store.get_obs(obs_id, &o);
+      out->emplace(observation_key(o.image_index, o.feature_id), X);
+    }
+  }
+}
+
+bool load_sub_reconstruction(const std::string& tracks_path, SubReconstruction* out) {
+  if (!out)
+    return false;
+  TrackStore store;
+  SfMResultData pose;
+  if (!load_track_store_from_idc(tracks_path, &store, nullptr, nullptr, &pose)) {
+    LOG(ERROR) << "load_sub_reconstruction: failed to load " << tracks_path;
+    return false;
+  }
+  const size_t n = static_cast<size_t>(store.num_images());
+  const bool f64 = pose.pose_R_f64.size() == n * 9 && pose.pose_C_f64.size() == n * 3;
+  if (pose.registered.size() != n || (!f64 && (pose.pose_R.size() != n * 9 ||
+                                                pose.pose_C.size() != n * 3))) {
+    LOG(ERROR) << "load_sub_reconstruction: " << tracks_path << " has no pose data";
+    return false;
+  }
+  out->poses_R.assign(n, Eigen::Matrix3d::Identity());
+  out->poses_C.assign(n, Eigen::Vector3d::Zero());
+  out->registered.assign(n, false);
+  for (size_t i = 0; i < n; ++i) {
+    out->registered[i] = pose.registered[i] != 0;
+    for (int r = 0; r < 3; ++r) {
+      for (int c = 0; c < 3; ++c) {
+        const size_t k = i * 9 + static_cast<size_t>(r * 3 + c);
+        out->poses_R[i](r, c) = f64 ? pose.pose_R_f64[k] : static_cast<double>(pose.pose_R[k]);
+      }
+      const size_t k = i * 3 + static_cast<size_t>(r);
+      out->poses_C[i](r) = f64 ? pose.pose_C_f64[k] : static_cast<double>(pose.pose_C[k]);
+    }
+  }
+  // Intrinsics layout: [fx,fy,cx,cy,w,h,k1,k2,k3,p1,p2] per camera.
+  const size_t n_cams = static_cast<size_t>(std::max(0, pose.num_cameras));
+  const bool k64 = pose.intrinsics_f64.size() == n_cams * 11;
+  if (!k64 && pose.intrinsics.size() != n_cams * 11) {
+    LOG(ERROR) << "load_sub_reconstruction: " << tracks_path << " has no intrinsics";
+    return false;
+  }
+  out->cameras.assign(n_cams, camera::Intrinsics());
+  for (size_t c = 0; c < n_cams; ++c) {
+    double k[11];
+    for (size_t j = 0; j < 11; ++j)
+      k[j] = k64 ? pose.intrinsics_f64[c * 11 + j] : static_cast<double>(pose.intrinsics[c * 11 + j]);
+    camera::Intrinsics& K = out->cameras[c];
+    K.fx = k[0];
+    K.fy = k[1];
+    K.cx = k[2];
+    K.cy = k[3];
+    K.width = static_cast<int>(k[4]);
+    K.height = static_cast<int>(k[5]);
+    K.k1 = k[6];
+    K.k2 = k[7];
+    K.k3 = k[8];
+    K.p1 = k[9];
+    K.p2 = k[10];
+  }
+  collect_observation_points(store, &out->points);
+  return true;
+}
+
+bool merge_sub_reconstructions(const std::vector<SubReconstruction>& subs,
+                               const std::vector<int>& image_to_camera_index,
+                               const MergeOptions& opts, std::vector<Eigen::Matrix3d>* poses_R,
+                               std::vector<Eigen::Vector3d>* poses_C,
+                               std::vector<bool>* registered,
+                               std::vector<camera::Intrinsics>* cameras,
+                               std::vector<SubModelMergeInfo>* info) {
+  if (!poses_R || !poses_C || !registered || !cameras)
+    return false;
+  const size_t n_images = image_to_camera_index.size();
+  poses_R->assign(n_images, Eigen::Matrix3d::Identity());
+  poses_C->assign(n_images, Eigen::Vector3d::Zero());
+  registered->assign(n_images, false);
+  std::vector<SubModelMergeInfo> merge_info(subs.size());
+
+  auto is_reg = [&](const SubReconstruction& s, size_t im) {
+    return im < s.registered.size() && s.registered[im] && im < s.poses_R.size() &&
+           im < s.poses_C.size();
+  };
+  int ref = -1, ref_n = 0;
+  for (size_t k = 0; k < subs.size(); ++k) {
+    int n = 0;
+    for (size_t im = 0; im < n_images; ++im)
+      n += is_reg(subs[k], im) ? 1 : 0;
+    if (n > ref_n) {
+      ref = static_cast<int>(k);
+      ref_n = n;
+    }
+  }
+  if (ref < 0)
+    return false;
+
+  std::unordered_map<uint64_t, Eigen::Vector3d> merged_points;
+  auto add_sub = [&](size_t k, const Sim3& sim) {
+    const SubReconstruction& s = subs[k];
+    const Eigen::Matrix3d Rt = sim.R.transpose();
+    for (size_t im = 0; im < n_images; ++im) {
+      if (!is_reg(s, im) || (*registered)[im])
+        continue;
+      // X_cam = R_k (X - C_k) with X = sim⁻¹(X') → rotation R_k Rᵀ, centre sim(C_k).
+      (*poses_R)[im] = s.poses_R[im] * Rt;
+      (*poses_C)[im] = sim.apply(s.poses_C[im]);
+      (*registered)[im] = true;
+    }
+    for (const auto& kv : s.points)
+      merged_points.emplace(kv.first, sim.apply(kv.second));
+    merge_info[k].merged = true;
+    merge_info[k].to_merged = sim;
+  };
+  add_sub(static_cast<size_t>(ref), Sim3());
+  merge_info[static_cast<size_t>(ref)].reference = true;
+
+  std::vector<char> done(subs.size(), 0);
+  done[static_cast<size_t>(ref)] = 1;
+  for (;;) {
+    int best = -1, best_shared = 0;
+    for (size_t k = 0; k < subs.size(); ++k) {
+      if (done[k])
+        continue;
+      int shared = 0;
+      for (size_t im = 0; im < n_images; ++im)
+        shared += (is_reg(subs[k], im) && (*registered)[im]) ? 1 : 0;
+      merge_info[k].shared_images = shared;
+      if (shared > best_shared) {
+        best = static_cast<int>(k);
+        best_shared = shared;
+      }
+    }
+    if (best < 0 || best_shared < opts.min_shared_images)
+      break;
+    done[static_cast<size_t>(best)] = 1;
+    const SubReconstruction& s = subs[static_cast<size_t>(best)];
+
+    // Correspondences in a fixed order (hash-map iteration order is not reproducible).
+    std::vector<uint64_t> keys;
+    keys.reserve(s.points.size());
+    for (const auto& kv : s.points)
+      if (merged_points.count(kv.first))
+        keys.push_back(kv.first);
+    std::sort(keys.begin(), keys.end());
+    std::vector<Eigen::Vector3d> src, dst;
+    src.reserve(keys.size() + static_cast<size_t>(best_shared));
+    dst.reserve(keys.size() + static_cast<size_t>(best_shared));
+    for (uint64_t key : keys) {
+      src.push_back(s.points.at(key));
+      dst.push_back(merged_points.at(key));
+    }
+    for (size_t im = 0; im < n_images; ++im)
+      if (is_reg(s, im) && (*registered)[im]) {
+        src.push_back(s.poses_C[im]);
+        dst.push_back((*poses_C)[im]);
+      }
+    SubModelMergeInfo& mi = merge_info[static_cast<size_t>(best)];
+    mi.correspondences = static_cast<int>(src.size());
+    Sim3 sim;
+    if (!estimate_sim3_ransac(src, dst, opts.ransac, &sim, nullptr, &mi.inliers)) {
+      LOG(WARNING) << "merge_sub_reconstructions: sub-model " << best << " not aligned ("
+                   << best_shared << " shared images, " << src.size() << " correspondences)";
+      continue;
+    }
+    add_sub(static_cast<size_t>(best), sim);
+    LOG(INFO) << "merge_sub_reconstructions: sub-model " << best << " aligned: shared_images="
+              << best_shared << " inliers=" << mi.inliers << "/" << mi.correspondences
+              << " scale=" << sim.scale;
+  }
+
+  // Intrinsics per camera from the merged sub-model that registered most images of it.
+  for (size_t c = 0; c < cameras->size(); ++c) {
+    int best = -1, best_n = 0;
+    for (size_t k = 0; k < subs.size(); ++k) {
+      if (!merge_info[k].merged || subs[k].cameras.size() <= c)
+        continue;
+      int n = 0;
+      for (size_t im = 0; im < n_images; ++im)
+        n += (is_reg(subs[k], im) && image_to_camera_index[im] == static_cast<int>(c)) ? 1 : 0;
+      if (n > best_n) {
+        best = static_cast<int>(k);
+        best_n = n;
+      }
+    }
+    if (best >= 0)
+      (*cameras)[c] = subs[static_cast<size_t>(best)].cameras[c];
+  }
+
+  int n_merged = 0;
+  for (const SubModelMergeInfo& mi : merge_info)
+    n_merged += mi.merged ? 1 : 0;
+  if (n_merged < static_cast<int>(subs.size()))
+    LOG(WARNING) << "merge_sub_reconstructions: " << (subs.size() - n_merged) << " of "
+                 << subs.size() << " sub-models could not be attached";
+  if (info)
+    info->swap(merge_info);
+  return true;
+}
+
+} // namespace sfm
+} // namespace insight
@@ -0,0 +1,164 @@
+/**
+ * @file  sfm_partition.h
+ * @brief Partitioned (divide-and-conquer) SfM: view-graph clustering and Sim3 sub-model merge.
+ *
+ * Flow (driven by isat_sfm step "partitioned_sfm")
+ * ────────────────────────────────────────────────
+ *   1. partition_view_graph: weight every ViewGraph edge by the number of tracks shared by its two
+ *      images, cut the graph by recursive balanced bisection until each cluster has at most
+ *      max_cluster_images, then grow every cluster by its most strongly connected outside images.
+ *   2. extract_cluster_track_store: one tracks IDC per cluster (global image indices kept) that
+ *      run_incremental_sfm_pipeline reconstructs independently.
+ *   3. merge_sub_reconstructions: align sub-models one by one onto the largest, with a RANSAC Sim3
+ *      on shared observations (same image + feature id) and shared camera centres.  The caller
+ *      then re-triangulates the full track store and runs one global BA.
+ */
+
+#pragma once
+
+#include "../camera/camera_types.h"
+#include "track_store.h"
+#include "view_graph.h"
+#include <Eigen/Core>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace insight {
+namespace sfm {
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Partition
+// ─────────────────────────────────────────────────────────────────────────────
+
+struct PartitionOptions {
+  int max_cluster_images = 500; ///< Core size cap per cluster (before overlap is added).
+  /// Overlap added per cluster, as a fraction of its core size (at least min_overlap_images).
+  double overlap_ratio = 0.15;
+  int min_overlap_images = 10;
+  /// Clusters whose core is smaller than this are folded into their best-connected neighbour.
+  int min_cluster_images = 10;
+  /// Long tracks only contribute their first N images to the covisibility weights.
+  int max_track_images_for_weights = 32;
+};
+
+struct SfMCluster {
+  std::vector<int> core;    ///< Images owned by this cluster (disjoint across clusters), sorted.
+  std::vector<int> overlap; ///< Extra images borrowed from neighbouring clusters, sorted.
+
+  /// core ∪ overlap, sorted.
+  std::vector<int> images() const;
+};
+
+/**
+ * Cut the view graph into clusters.  Edge weight = number of alive tracks observed in both
+ * images (pairs without shared tracks are dropped).  Images without any weighted edge are not
+ * assigned.  Deterministic for a given graph and store.
+ */
+std::vector<SfMCluster> partition_view_graph(const ViewGraph& view_graph, const TrackStore& store,
+                                             const PartitionOptions& opts);
+
+/**
+ * Copy of \p full restricted to \p images: every alive observation on those images, for tracks
+ * that keep at least two of them.  num_images and image indices are unchanged.  Track XYZ is not
+ * copied.  The result is compacted.
+ */
+void extract_cluster_track_store(const TrackStore& full, const std::vector<int>& images,
+                                 TrackStore* out);
+
+/// Pairs of \p view_graph with both images in \p images.
+ViewGraph filter_view_graph(const ViewGraph& view_graph, const std::vector<int>& images);
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Sim3
+// ─────────────────────────────────────────────────────────────────────────────
+
+/// Similarity transform x' = scale * R * x + t.
+struct Sim3 {
+  double scale = 1.0;
+  Eigen::Matrix3d R = Eigen::Matrix3d::Identity();
+  Eigen::Vector3d t = Eigen::Vector3d::Zero();
+
+  Eigen::Vector3d apply(const Eigen::Vector3d& x) const { return scale * (R * x) + t; }
+};
+
+struct Sim3RansacOptions {
+  int max_iterations = 1000;
+  /// Inlier distance as a fraction of the median distance of dst points from their centroid.
+  double inlier_threshold_rel = 0.02;
+  int min_inliers = 6;
+  uint32_t seed = 0;
+};
+
+/**
+ * Robust Sim3 from src to dst (3-point Umeyama samples, then an Umeyama fit on all inliers).
+ * @return false when fewer than opts.min_inliers correspondences agree.
+ */
+bool estimate_sim3_ransac(const std::vector<Eigen::Vector3d>& src,
+                          const std::vector<Eigen::Vector3d>& dst, const Sim3RansacOptions& opts,
+                          Sim3* out, std::vector<char>* inlier_mask = nullptr,
+                          int* num_inliers = nullptr);
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Merge
+// ─────────────────────────────────────────────────────────────────────────────
+
+/// Observation key shared by all sub-models: (image_index << 32) | feature_id.
+inline uint64_t observation_key(uint32_t image_index, uint32_t feature_id) {
+  return (static_cast<uint64_t>(image_index) << 32) | feature_id;
+}
+
+/// One reconstructed cluster (world-to-camera R, centre C, all in the sub-model's own frame).
+struct SubReconstruction {
+  std::vector<Eigen::Matrix3d> poses_R;
+  std::vector<Eigen::Vector3d> poses_C;
+  std::vector<bool> registered;
+  std::vector<camera::Intrinsics> cameras;
+  std::unordered_map<uint64_t, Eigen::Vector3d> points; ///< observation_key → track XYZ.
+};
+
+/// observation_key → XYZ for every alive observation of a triangulated track.
+void collect_observation_points(const TrackStore& store,
+                                std::unordered_map<uint64_t, Eigen::Vector3d>* out);
+
+/**
+ * Load a sub-model from the tracks.isat_tracks written by isat_incremental_sfm (embedded poses;
+ * the float64 copies are used when present).
+ * @return false when the file cannot be read or carries no pose data.
+ */
+bool load_sub_reconstruction(const std::string& tracks_path, SubReconstruction* out);
+
+struct MergeOptions {
+  int min_shared_images = 3; ///< A sub-model needs this many registered images in common.
+  Sim3RansacOptions ransac;
+};
+
+struct SubModelMergeInfo {
+  bool merged = false;
+  bool reference = false;
+  int shared_images = 0;
+  int correspondences = 0;
+  int inliers = 0;
+  Sim3 to_merged; ///< Sub-model frame → merged frame.
+};
+
+/**
+ * Merge sub-models into one frame.  The sub-model with the most registered images is the
+ * reference; the others are attached greedily, most shared registered images first.  Images
+ * registered in several sub-models keep the pose from the first model that brought them in.
+ * Each camera takes the intrinsics of the merged sub-model that registered most of its images.
+ *
+ * @param cameras  In: project intrinsics (size = num cameras).  Out: merged intrinsics.
+ * @return false when no sub-model has a registered image.
+ */
+bool merge_sub_reconstructions(const std::vector<SubReconstruction>& subs,
+                               const std::vector<int>& image_to_camera_index,
+                               const MergeOptions& opts, std::vector<Eigen::Matrix3d>* poses_R,
+                               std::vector<Eigen::Vector3d>* poses_C,
+                               std::vector<bool>* registered,
+                               std::vector<camera::Intrinsics>* cameras,
+                               std::vector<SubModelMergeInfo>* info = nullptr);
+
+} // namespace sfm
+} // namespace insight
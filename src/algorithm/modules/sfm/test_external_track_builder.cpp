@@ -0,0 +1,141 @@
+/**
+ * @file  test_external_track_builder.cpp
+ * @brief Unit tests for ExternalTrackBuilder: spilled sort/merge build == in-memory union-find.
+ */
+
+#include "external_track_builder.h"
+#include "track_test_pairs.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using insight::sfm::ExternalTrackBuilder;
+using insight::sfm::ExternalTrackBuilderOptions;
+using insight::sfm::ExternalTrackStats;
+using insight::sfm::TrackInlierMatch;
+using insight::sfm::TrackPairMatches;
+using insight::sfm::TrackUnionFind;
+using insight::sfm::track_node_key;
+using insight::sfm::test::PairData;
+using insight::sfm::test::as_views;
+using insight::sfm::test::make_pairs;
+
+namespace {
+
+int fail(const std::string& msg) {
+  std::cerr << "  FAIL: " << msg << "\n";
+  return 1;
+}
+
+struct Obs {
+  int track;
+  uint64_t key;
+  float u, v, s;
+};
+
+int check_against_union_find(const std::vector<PairData>& pairs, size_t budget_bytes,
+                             bool expect_spill, ExternalTrackStats* stats_out = nullptr) {
+  TrackUnionFind ref;
+  int64_t merged = 0, rejected = 0;
+  for (const PairData& d : pairs)
+    for (const TrackInlierMatch& m : d.matches) {
+      if (ref.merge_keys(track_node_key(d.image1, m.idx1), track_node_key(d.image2, m.idx2),
+                         m.x1, m.y1, m.s1, m.x2, m.y2, m.s2))
+        ++merged;
+      else
+        ++rejected;
+    }
+  // Reference numbering: tracks ordered by smallest node key, observations by key.
+  std::map<uint64_t, int> by_key;
+  for (const auto& kv : ref.node_id_) by_key.emplace(kv.first, kv.second);
+  std::map<int, int> root_track;
+  std::vector<Obs> expected;
+  for (const auto& [key, id] : by_key) {
+    const int root = ref.find_by_id(id);
+    const int t = root_track.emplace(root, static_cast<int>(root_track.size())).first->second;
+    expected.push_back({t, key, ref.node_u_[static_cast<size_t>(id)],
+                        ref.node_v_[static_cast<size_t>(id)], ref.node_s_[static_cast<size_t>(id)]});
+  }
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const Obs& a, const Obs& b) { return a.track < b.track; });
+
+  ExternalTrackBuilderOptions opts;
+  opts.memory_budget_bytes = budget_bytes;
+  std::string spill_dir;
+  std::vector<Obs> got;
+  ExternalTrackStats stats;
+  {
+    ExternalTrackBuilder builder(opts);
+    spill_dir = builder.spill_directory();
+    const size_t half = pairs.size() / 2;
+    if (!builder.add_pairs(as_views(pairs, 0, half)) ||
+        !builder.add_pairs(as_views(pairs, half, pairs.size())))
+      return fail("add_pairs failed");
+    if (!builder.build([&](int t, uint64_t key, float u, float v, float s) {
+          got.push_back({t, key, u, v, s});
+        }, &stats))
+      return fail("build failed");
+  }
+  if (std::filesystem::exists(spill_dir))
+    return fail("spill directory not removed");
+  if (expect_spill != (stats.num_runs > 0))
+    return fail("unexpected spill behaviour (runs=" + std::to_string(stats.num_runs) + ")");
+  if (stats.merged != merged || stats.rejected != rejected)
+    return fail("merged/rejected differ: " + std::to_string(stats.merged) + "/" +
+                std::to_string(stats.rejected) + " vs " + std::to_string(merged) + "/" +
+                std::to_string(rejected));
+  if (stats.num_tracks != static_cast<int64_t>(root_track.size()) ||
+      stats.num_nodes != static_cast<int64_t>(by_key.size()))
+    return fail("track/node counts differ");
+  if (got.size() != expected.size())
+    return fail("observation count differs");
+  for (size_t i = 0; i < got.size(); ++i) {
+    const Obs& a = got[i];
+    const Obs& b = expected[i];
+    if (a.track != b.track || a.key != b.key || a.u != b.u || a.v != b.v || a.s != b.s)
+      return fail("observation " + std::to_string(i) + " differs");
+  }
+  std::cout << "  PASS (" << stats.num_tracks << " tracks, " << rejected << " rejected, "
+            << stats.num_runs << " runs, " << stats.num_components << " components)\n";
+  if (stats_out) *stats_out = stats;
+  return 0;
+}
+
+int test_spilled_build_matches_union_find() {
+  std::cout << "[test1] spilled build (many runs) == serial union-find\n";
+  const auto pairs = make_pairs(20, 600, 80, 50, 3);
+  return check_against_union_find(pairs, 512u << 10, true);
+}
+
+int test_in_memory_build_matches_union_find() {
+  std::cout << "[test2] build within budget (no runs) == serial union-find\n";
+  const auto pairs = make_pairs(50, 300, 400, 30, 5);
+  return check_against_union_find(pairs, 256u << 20, false);
+}
+
+int test_component_over_budget_replayed() {
+  std::cout << "[test3] component too large for the budget: replayed past it, same tracks\n";
+  const auto pairs = make_pairs(20, 600, 80, 50, 3);  // one component of ~1600 features
+  ExternalTrackStats stats;
+  if (check_against_union_find(pairs, 16u << 10, true, &stats) != 0)
+    return 1;
+  if (stats.over_budget_components != 1)
+    return fail("over_budget_components=" + std::to_string(stats.over_budget_components));
+  return 0;
+}
+
+}  // namespace
+
+int main() {
+  int failures = 0;
+  failures += test_spilled_build_matches_union_find();
+  failures += test_in_memory_build_matches_union_find();
+  failures += test_component_over_budget_replayed();
+  if (failures == 0)
+    std::cout << "\nAll tests PASSED.\n";
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
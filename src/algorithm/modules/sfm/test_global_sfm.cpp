@@ -0,0 +1,402 @@
+/**
+ * @file  test_global_sfm.cpp
+ * @brief Unit tests for global SfM: loop filter, rotation averaging, translation averaging and the
+ *        relative-pose front end (global_sfm.h).
+ */
+
+#include "../../io/idc_writer.h"
+#include "global_sfm.h"
+#include "track_store.h"
+#include "view_graph.h"
+
+#include <Eigen/Geometry>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using insight::camera::Intrinsics;
+using insight::sfm::GlobalSfMOptions;
+using insight::sfm::PairGeoInfo;
+using insight::sfm::RelativePoseEdge;
+using insight::sfm::TrackStore;
+using insight::sfm::ViewGraph;
+
+namespace {
+
+int fail(const std::string& msg) {
+  std::cerr << "  FAIL: " << msg << "\n";
+  return 1;
+}
+
+double angle_deg(const Eigen::Matrix3d& R) {
+  return Eigen::AngleAxisd(R).angle() * 180.0 / M_PI;
+}
+
+Eigen::Matrix3d random_rotation(std::mt19937* rng, double max_angle) {
+  std::uniform_real_distribution<double> u(-1.0, 1.0);
+  const Eigen::Vector3d axis = Eigen::Vector3d(u(*rng), u(*rng), u(*rng)).normalized();
+  return Eigen::AngleAxisd(max_angle * u(*rng), axis).toRotationMatrix();
+}
+
+/// Largest rotation error of \p est against \p gt after removing the gauge (first image).
+double max_rotation_error_deg(const std::vector<Eigen::Matrix3d>& gt,
+                              const std::vector<Eigen::Matrix3d>& est) {
+  const Eigen::Matrix3d gauge = est[0].transpose() * gt[0];
+  double worst = 0.0;
+  for (size_t i = 0; i < gt.size(); ++i)
+    worst = std::max(worst, angle_deg(gt[i].transpose() * est[i] * gauge));
+  return worst;
+}
+
+/// Largest centre error of \p est against \p gt after a least-squares similarity alignment,
+/// relative to the extent of \p gt.
+double max_center_error_rel(const std::vector<Eigen::Vector3d>& gt,
+                            const std::vector<Eigen::Vector3d>& est) {
+  Eigen::Matrix3Xd src(3, gt.size()), dst(3, gt.size());
+  for (size_t i = 0; i < gt.size(); ++i) {
+    src.col(static_cast<Eigen::Index>(i)) = est[i];
+    dst.col(static_cast<Eigen::Index>(i)) = gt[i];
+  }
+  const Eigen::Matrix4d T = Eigen::umeyama(src, dst, true);
+  const Eigen::Vector3d mean = dst.rowwise().mean();
+  double extent = 0.0, worst = 0.0;
+  for (size_t i = 0; i < gt.size(); ++i) {
+    const Eigen::Vector3d aligned = T.topLeftCorner<3, 3>() * est[i] + T.topRightCorner<3, 1>();
+    worst = std::max(worst, (aligned - gt[i]).norm());
+    extent = std::max(extent, (gt[i] - mean).norm());
+  }
+  return worst / extent;
+}
+
+RelativePoseEdge make_edge(int i, int j, const std::vector<Eigen::Matrix3d>& R,
+                           const std::vector<Eigen::Vector3d>& C) {
+  RelativePoseEdge e;
+  e.image_i = i;
+  e.image_j = j;
+  e.R_ij = R[static_cast<size_t>(j)] * R[static_cast<size_t>(i)].transpose();
+  e.t_ij = (R[static_cast<size_t>(j)] * (C[static_cast<size_t>(i)] - C[static_cast<size_t>(j)]))
+               .normalized();
+  e.translation_ok = true;
+  e.num_inliers = 100;
+  return e;
+}
+
+/// Cameras on a noisy circle looking roughly at the origin.
+void make_ring(int n, std::mt19937* rng, std::vector<Eigen::Matrix3d>* R,
+               std::vector<Eigen::Vector3d>* C) {
+  R->clear();
+  C->clear();
+  std::normal_distribution<double> jitter(0.0, 0.3);
+  for (int i = 0; i < n; ++i) {
+    const double a = 2.0 * M_PI * i / n;
+    const Eigen::Vector3d c(10.0 * std::cos(a) + jitter(*rng), 10.0 * std::sin(a) + jitter(*rng),
+                            2.0 + jitter(*rng));
+    // Camera z-axis towards the origin (world-to-camera rows = camera axes in world).
+    const Eigen::Vector3d z = (-c).normalized();
+    const Eigen::Vector3d x = Eigen::Vector3d::UnitZ().cross(z).normalized();
+    const Eigen::Vector3d y = z.cross(x);
+    Eigen::Matrix3d Rw;
+    Rw.row(0) = x.transpose();
+    Rw.row(1) = y.transpose();
+    Rw.row(2) = z.transpose();
+    R->push_back(random_rotation(rng, 0.05) * Rw);
+    C->push_back(c);
+  }
+}
+
+int test_rotation_averaging_with_outliers() {
+  std::cout << "[test1] loop filter + rotation averaging with noisy and corrupted edges\n";
+  std::mt19937 rng(11);
+  std::vector<Eigen::Matrix3d> R;
+  std::vector<Eigen::Vector3d> C;
+  const int n = 30;
+  make_ring(n, &rng, &R, &C);
+  std::vector<RelativePoseEdge> edges;
+  int n_corrupted = 0;
+  for (int i = 0; i < n; ++i)
+    for (int d = 1; d <= 4; ++d) {
+      const int j = (i + d) % n;
+      RelativePoseEdge e = make_edge(std::min(i, j), std::max(i, j), R, C);
+      if (i % 7 == 3 && d == 2) {
+        e.R_ij = random_rotation(&rng, M_PI) * e.R_ij; // gross outlier
+        ++n_corrupted;
+      } else {
+        e.R_ij = random_rotation(&rng, 0.3 * M_PI / 180.0) * e.R_ij;
+      }
+      edges.push_back(e);
+    }
+  GlobalSfMOptions opts;
+  const int removed = insight::sfm::filter_edges_by_loop_consistency(&edges, 5.0);
+  if (removed < n_corrupted)
+    return fail("loop filter removed " + std::to_string(removed) + " edges, expected at least " +
+                std::to_string(n_corrupted));
+  std::vector<Eigen::Matrix3d> est;
+  std::vector<bool> valid;
+  if (!insight::sfm::average_rotations(n, edges, opts, &est, &valid))
+    return fail("average_rotations failed");
+  for (int i = 0; i < n; ++i)
+    if (!valid[static_cast<size_t>(i)])
+      return fail("image " + std::to_string(i) + " not in the solved component");
+  const double err = max_rotation_error_deg(R, est);
+  if (err > 0.5)
+    return fail("rotation error " + std::to_string(err) + " deg");
+
+  // Robust even when the outliers are not pre-filtered: residual filter catches them.
+  std::vector<RelativePoseEdge> raw;
+  for (int i = 0; i < n; ++i) {
+    const int j = (i + 1) % n, k = (i + 2) % n;
+    raw.push_back(make_edge(std::min(i, j), std::max(i, j), R, C));
+    raw.push_back(make_edge(std::min(i, k), std::max(i, k), R, C));
+  }
+  raw[5].R_ij = random_rotation(&rng, M_PI) * raw[5].R_ij;
+  raw[5].num_inliers = 10;
+  if (!insight::sfm::average_rotations(n, raw, opts, &est, &valid))
+    return fail("average_rotations failed on unfiltered graph");
+  if (insight::sfm::filter_edges_by_rotation_residual(&raw, est, valid, 5.0) != 1)
+    return fail("residual filter did not isolate the corrupted edge");
+  if (max_rotation_error_deg(R, est) > 1e-3)
+    return fail("unfiltered rotation error " + std::to_string(max_rotation_error_deg(R, est)));
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+int test_translation_averaging() {
+  std::cout << "[test2] average_translations recovers centres up to a similarity\n";
+  std::mt19937 rng(3);
+  std::vector<Eigen::Matrix3d> R;
+  std::vector<Eigen::Vector3d> C;
+  const int n = 24;
+  make_ring(n, &rng, &R, &C);
+  std::normal_distribution<double> noise(0.0, 0.002);
+  std::vector<RelativePoseEdge> edges;
+  for (int i = 0; i < n; ++i)
+    for (int d = 1; d <= 5; ++d) {
+      const int j = (i + d) % n;
+      RelativePoseEdge e = make_edge(std::min(i, j), std::max(i, j), R, C);
+      e.t_ij = (e.t_ij + Eigen::Vector3d(noise(rng), noise(rng), noise(rng))).normalized();
+      edges.push_back(e);
+    }
+  edges[4].t_ij = -edges[4].t_ij;                                  // flipped direction
+  edges[17].t_ij = Eigen::Vector3d(0.3, -0.9, 0.2).normalized();   // wrong direction
+  edges[40].translation_ok = false;                                // ignored
+  edges[40].t_ij = Eigen::Vector3d::UnitX();
+
+  std::vector<Eigen::Vector3d> est;
+  std::vector<bool> valid(static_cast<size_t>(n), true);
+  if (!insight::sfm::average_translations(n, edges, R, GlobalSfMOptions(), &est, &valid))
+    return fail("average_translations failed");
+  for (int i = 0; i < n; ++i)
+    if (!valid[static_cast<size_t>(i)])
+      return fail("image " + std::to_string(i) + " dropped");
+  const double err = max_center_error_rel(C, est);
+  if (err > 0.02)
+    return fail("relative centre error " + std::to_string(err));
+
+  // Invalid images are excluded from the solve.
+  valid.assign(static_cast<size_t>(n), true);
+  valid[7] = false;
+  if (!insight::sfm::average_translations(n, edges, R, GlobalSfMOptions(), &est, &valid) ||
+      valid[7])
+    return fail("invalid image was solved");
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+/// Eight cameras on a short arc looking at 400 points (every 10th point mismatched in image 2),
+/// with the complete view graph.
+void make_arc_scene(std::vector<Eigen::Matrix3d>* R_out, std::vector<Eigen::Vector3d>* C_out,
+                    std::vector<Intrinsics>* cameras_out, TrackStore* store, ViewGraph* vg) {
+  std::mt19937 rng(7);
+  std::vector<Eigen::Matrix3d>& R = *R_out;
+  std::vector<Eigen::Vector3d>& C = *C_out;
+  const int n = 8;
+  R.resize(static_cast<size_t>(n));
+  C.resize(static_cast<size_t>(n));
+  // Keep the cameras on a short arc so every pair sees the central points.
+  for (int i = 0; i < n; ++i) {
+    const double a = 1.2 * i / n;
+    const Eigen::Vector3d c(10.0 * std::cos(a), 10.0 * std::sin(a), 1.0 + 0.2 * i);
+    const Eigen::Vector3d z = (-c).normalized();
+    const Eigen::Vector3d x = Eigen::Vector3d::UnitZ().cross(z).normalized();
+    R[static_cast<size_t>(i)].row(0) = x.transpose();
+    R[static_cast<size_t>(i)].row(1) = z.cross(x).transpose();
+    R[static_cast<size_t>(i)].row(2) = z.transpose();
+    C[static_cast<size_t>(i)] = c;
+  }
+  Intrinsics K;
+  K.fx = K.fy = 1000.0;
+  K.cx = 500.0;
+  K.cy = 400.0;
+  K.width = 1000;
+  K.height = 800;
+  *cameras_out = {K};
+  const std::vector<int> img2cam(static_cast<size_t>(n), 0);
+
+  store->set_num_images(n);
+  std::uniform_real_distribution<double> u(-3.0, 3.0);
+  std::normal_distribution<double> px_noise(0.0, 0.3);
+  uint32_t feat = 0;
+  for (int t = 0; t < 400; ++t) {
+    const Eigen::Vector3d X(u(rng), u(rng), u(rng));
+    const int tid = store->add_track(0.f, 0.f, 0.f);
+    for (int i = 0; i < n; ++i) {
+      const Eigen::Vector3d p = R[static_cast<size_t>(i)] * (X - C[static_cast<size_t>(i)]);
+      double uu = K.fx * p.x() / p.z() + K.cx + px_noise(rng);
+      double vv = K.fy * p.y() / p.z() + K.cy + px_noise(rng);
+      if (t % 10 == 0 && i == 2) { // mismatches
+        uu = 1000.0 * (0.5 + 0.5 * u(rng) / 3.0);
+        vv = 800.0 * (0.5 + 0.5 * u(rng) / 3.0);
+      }
+      store->add_observation(tid, static_cast<uint32_t>(i), feat++, static_cast<float>(uu),
+                             static_cast<float>(vv));
+    }
+  }
+  store->compact();
+  store->refresh_undistorted_cache(*cameras_out, img2cam);
+  for (int i = 0; i < n; ++i)
+    for (int j = i + 1; j < n; ++j) {
+      PairGeoInfo p;
+      p.image1_index = static_cast<uint32_t>(i);
+      p.image2_index = static_cast<uint32_t>(j);
+      vg->add_pair(p);
+    }
+}
+
+int test_relative_poses_from_tracks() {
+  std::cout << "[test3] relative poses from tracks → rotations → translations\n";
+  std::vector<Eigen::Matrix3d> R;
+  std::vector<Eigen::Vector3d> C;
+  std::vector<Intrinsics> cameras;
+  TrackStore store;
+  ViewGraph vg;
+  make_arc_scene(&R, &C, &cameras, &store, &vg);
+  const int n = static_cast<int>(R.size());
+  const std::vector<int> img2cam(static_cast<size_t>(n), 0);
+
+  GlobalSfMOptions opts;
+  std::vector<RelativePoseEdge> edges;
+  insight::sfm::estimate_relative_poses(vg, store, cameras, img2cam, opts, &edges);
+  if (edges.size() != vg.num_pairs())
+    return fail("relative poses for " + std::to_string(edges.size()) + " / " +
+                std::to_string(vg.num_pairs()) + " pairs");
+  for (const RelativePoseEdge& e : edges) {
+    const Eigen::Matrix3d gt = R[static_cast<size_t>(e.image_j)] *
+                               R[static_cast<size_t>(e.image_i)].transpose();
+    if (angle_deg(gt.transpose() * e.R_ij) > 0.5)
+      return fail("relative rotation off for pair " + std::to_string(e.image_i) + "," +
+                  std::to_string(e.image_j));
+    if (static_cast<int>(e.inlier_obs.size()) != e.num_inliers)
+      return fail("inlier observation list size mismatch");
+  }
+
+  std::vector<Eigen::Matrix3d> rotations;
+  std::vector<bool> valid;
+  if (!insight::sfm::average_rotations(n, edges, opts, &rotations, &valid))
+    return fail("average_rotations failed");
+  if (max_rotation_error_deg(R, rotations) > 0.2)
+    return fail("rotation error " + std::to_string(max_rotation_error_deg(R, rotations)));
+  insight::sfm::refine_relative_translations(store, rotations, opts, &edges);
+  std::vector<Eigen::Vector3d> centers;
+  if (!insight::sfm::average_translations(n, edges, rotations, opts, &centers, &valid))
+    return fail("average_translations failed");
+  const double err = max_center_error_rel(C, centers);
+  if (err > 0.02)
+    return fail("relative centre error " + std::to_string(err));
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+/// Writes an isat_geo --twoview style file for pair (i, j): X_j = R X_i + t.
+bool write_two_view_geo(const std::string& dir, int i, int j, const Eigen::Matrix3d& R,
+                        const Eigen::Vector3d& t) {
+  float R_f[9], t_f[3];
+  for (int r = 0; r < 3; ++r) {
+    for (int c = 0; c < 3; ++c)
+      R_f[r * 3 + c] = static_cast<float>(R(r, c));
+    t_f[r] = static_cast<float>(t(r));
+  }
+  insight::io::IDCWriter writer(dir + "/" + std::to_string(i) + "_" + std::to_string(j) +
+                                ".isat_geo");
+  writer.set_metadata({{"twoview", {{"stable", true}}}});
+  writer.add_blob("R_matrix", R_f, sizeof(R_f), "float32", {3, 3});
+  writer.add_blob("t_vector", t_f, sizeof(t_f), "float32", {3});
+  return writer.write();
+}
+
+int test_relative_poses_from_geo() {
+  std::cout << "[test4] relative poses seeded from isat_geo two-view poses\n";
+  std::vector<Eigen::Matrix3d> R;
+  std::vector<Eigen::Vector3d> C;
+  std::vector<Intrinsics> cameras;
+  TrackStore store;
+  ViewGraph vg;
+  make_arc_scene(&R, &C, &cameras, &store, &vg);
+  const std::vector<int> img2cam(R.size(), 0);
+  auto rel = [&](int i, int j, Eigen::Matrix3d* R_ij, Eigen::Vector3d* t_ij) {
+    *R_ij = R[static_cast<size_t>(j)] * R[static_cast<size_t>(i)].transpose();
+    *t_ij = (R[static_cast<size_t>(j)] * (C[static_cast<size_t>(i)] - C[static_cast<size_t>(j)]))
+                .normalized();
+  };
+
+  // (0, 1): true pose; (0, 2): rotation 20 deg off, rejected by the tracks; others: no geo.
+  const std::string dir =
+      (std::filesystem::temp_directory_path() / "isat_test_global_sfm_geo").string();
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  Eigen::Matrix3d R01, R02;
+  Eigen::Vector3d t01, t02;
+  rel(0, 1, &R01, &t01);
+  rel(0, 2, &R02, &t02);
+  R02 = Eigen::AngleAxisd(20.0 * M_PI / 180.0, Eigen::Vector3d::UnitY()) * R02;
+  if (!write_two_view_geo(dir, 0, 1, R01, t01) || !write_two_view_geo(dir, 0, 2, R02, t02))
+    return fail("cannot write geo files to " + dir);
+
+  // Without RANSAC iterations only the pair with a consistent two-view pose gets an edge.
+  GlobalSfMOptions opts;
+  opts.geo_dir = dir;
+  opts.rel_pose_ransac_max_iterations = 0;
+  std::vector<RelativePoseEdge> edges;
+  insight::sfm::estimate_relative_poses(vg, store, cameras, img2cam, opts, &edges);
+  if (edges.size() != 1 || edges[0].image_i != 0 || edges[0].image_j != 1)
+    return fail(std::to_string(edges.size()) + " edges without RANSAC, expected only (0, 1)");
+  if (angle_deg(R01.transpose() * edges[0].R_ij) > 0.5 || edges[0].t_ij.dot(t01) < 0.999)
+    return fail("seeded pose (0, 1) off");
+  if (edges[0].num_inliers < 350 ||
+      static_cast<int>(edges[0].inlier_obs.size()) != edges[0].num_inliers)
+    return fail("seeded pose (0, 1) has " + std::to_string(edges[0].num_inliers) + " inliers");
+
+  // With RANSAC the rejected seed (0, 2) and the pairs without geo are estimated from scratch.
+  opts.rel_pose_ransac_max_iterations = 1000;
+  insight::sfm::estimate_relative_poses(vg, store, cameras, img2cam, opts, &edges);
+  std::filesystem::remove_all(dir);
+  if (edges.size() != vg.num_pairs())
+    return fail("relative poses for " + std::to_string(edges.size()) + " / " +
+                std::to_string(vg.num_pairs()) + " pairs");
+  for (const RelativePoseEdge& e : edges) {
+    Eigen::Matrix3d gt;
+    Eigen::Vector3d t_gt;
+    rel(e.image_i, e.image_j, &gt, &t_gt);
+    if (angle_deg(gt.transpose() * e.R_ij) > 0.5)
+      return fail("relative rotation off for pair " + std::to_string(e.image_i) + "," +
+                  std::to_string(e.image_j));
+  }
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+} // namespace
+
+int main() {
+  int failures = 0;
+  failures += test_rotation_averaging_with_outliers();
+  failures += test_translation_averaging();
+  failures += test_relative_poses_from_tracks();
+  failures += test_relative_poses_from_geo();
+  if (failures == 0)
+    std::cout << "\nAll tests PASSED.\n";
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,288 @@
+/**
+ * @file  test_sfm_checkpoint.cpp
+ * @brief Unit tests for incremental SfM checkpoint save / resume (sfm_checkpoint.h).
+ */
+
+#include "resection_batch.h"
+#include "sfm_checkpoint.h"
+#include "track_store.h"
+
+#include <Eigen/Geometry>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using insight::camera::Intrinsics;
+using insight::sfm::ResectionCandidate;
+using insight::sfm::ResectionScoreCache;
+using insight::sfm::SfMCheckpointState;
+using insight::sfm::TrackStore;
+using insight::sfm::TrackStoreSchedulerState;
+using insight::sfm::choose_resection_candidates;
+
+namespace {
+
+int fail(const std::string& msg) {
+  std::cerr << "  FAIL: " << msg << "\n";
+  return 1;
+}
+
+struct Scene {
+  TrackStore store;
+  std::vector<Eigen::Matrix3d> R;
+  std::vector<Eigen::Vector3d> C;
+  std::vector<bool> registered;
+  std::vector<Intrinsics> cameras;
+  std::vector<int> image_to_camera;
+};
+
+// 5 images (0..2 registered), 40 tracks seen by 3 consecutive images; some triangulated, some
+// observations deleted (plain and restorable), one track deleted, queues left non-empty.
+Scene make_scene() {
+  Scene s;
+  const int n_images = 5;
+  Intrinsics K;
+  K.fx = 1234.56789;
+  K.fy = 1234.56789;
+  K.cx = 511.25;
+  K.cy = 383.75;
+  K.width = 1024;
+  K.height = 768;
+  K.k1 = -0.0123456789;
+  K.p2 = 1e-5;
+  s.cameras = {K, K};
+  s.cameras[1].fx = s.cameras[1].fy = 987.654321;
+  s.image_to_camera = {0, 0, 1, 1, 0};
+  s.registered = {true, true, true, false, false};
+  for (int i = 0; i < n_images; ++i) {
+    s.R.push_back(Eigen::AngleAxisd(0.1 * i + 1e-9, Eigen::Vector3d(0.3, 1.0, 0.2).normalized())
+                      .toRotationMatrix());
+    s.C.emplace_back(0.3 * i + 1e-12, -0.1 * i, 0.01 * i * i);
+  }
+
+  TrackStore& st = s.store;
+  st.set_num_images(n_images);
+  for (int t = 0; t < 40; ++t) {
+    const int tid = st.add_track(0.f, 0.f, 0.f);
+    const int i0 = t % 3;
+    for (int k = 0; k < 3; ++k)
+      st.add_observation(tid, static_cast<uint32_t>(i0 + k), static_cast<uint32_t>(100 * t + k),
+                         10.f * t + 0.25f * k, 5.f * t + 0.5f * k, 1.f + 0.1f * k);
+    if (t % 4 != 3)
+      st.set_track_xyz(tid, 0.1f * t, -0.2f * t, 5.f + 0.01f * t);
+  }
+  st.compact();
+  st.bump_global_pose_epoch();
+  st.mark_track_tri_attempted(5);
+  st.mark_observation_deleted(7);
+  st.mark_observation_deleted_restorable(20);
+  st.mark_observation_deleted_restorable(33);
+  st.mark_track_deleted(12);
+  st.set_track_skip_ba(9, true);
+  st.set_track_skip_ba(17, true);
+  // Partially drain: queue now holds only what is flagged afterwards.
+  st.drain_retriangulation_pending(nullptr);
+  st.set_track_retriangulation_flag(2, true);
+  st.set_track_retriangulation_flag(30, true);
+  st.set_track_retriangulation_flag(2, false); // stale queue entry
+  st.set_track_retriangulation_flag(2, true);
+  st.refresh_undistorted_cache(s.cameras, s.image_to_camera);
+  return s;
+}
+
+bool same_candidates(const std::vector<ResectionCandidate>& a,
+                     const std::vector<ResectionCandidate>& b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); ++i)
+    if (a[i].image_index != b[i].image_index || a[i].num_3d2d != b[i].num_3d2d ||
+        a[i].coverage != b[i].coverage)
+      return false;
+  return true;
+}
+
+bool same_scheduler_state(const TrackStoreSchedulerState& a, const TrackStoreSchedulerState& b) {
+  return a.obs_epoch == b.obs_epoch && a.xyz_epoch == b.xyz_epoch &&
+         a.registration_epoch == b.registration_epoch && a.tri_status_epoch == b.tri_status_epoch &&
+         a.global_pose_epoch == b.global_pose_epoch &&
+         a.track_last_tri_epoch == b.track_last_tri_epoch && a.retri_pending == b.retri_pending &&
+         a.dirty_images == b.dirty_images && a.dirty_tracks == b.dirty_tracks;
+}
+
+std::string temp_dir(const char* name) {
+  const std::filesystem::path p = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(p);
+  return p.string();
+}
+
+int test_round_trip_exact() {
+  std::cout << "[test1] checkpoint round trip restores store, poses and scheduler state\n";
+  Scene s = make_scene();
+  ResectionScoreCache cache;
+  choose_resection_candidates(s.store, s.registered, s.cameras, s.image_to_camera, 2, 10, 0.0f, 4,
+                              &cache);
+  // Leave unconsumed dirty state behind the cache watermarks, as the main loop does.
+  s.store.mark_observation_deleted(50);
+
+  SfMCheckpointState st;
+  st.seq = 0;
+  st.sfm_iter = 17;
+  st.num_registered = 3;
+  st.anchor_image = 0;
+  st.second_image = 1;
+  st.no_candidate_consecutive = 1;
+  st.next_periodic_global_registered = 140;
+  st.next_mid_global_registered = 57;
+  st.ba_grid_call_count = 9;
+  st.intrinsics_phase = {1, 0};
+  st.ms_global_ba = 123456789012ull;
+  st.ms_resection = 42;
+  st.ba_cameras_snapshot = s.cameras;
+  st.ba_cameras_snapshot[0].fx = 1200.0;
+  st.resection_score_cache = cache;
+
+  const std::string dir = temp_dir("isat_test_sfm_checkpoint_1");
+  if (!insight::sfm::save_sfm_checkpoint(dir, st, s.store, s.R, s.C, s.registered, s.cameras,
+                                         s.image_to_camera))
+    return fail("save_sfm_checkpoint failed");
+
+  SfMCheckpointState rs;
+  TrackStore rstore;
+  std::vector<Eigen::Matrix3d> R;
+  std::vector<Eigen::Vector3d> C;
+  std::vector<bool> reg;
+  std::vector<Intrinsics> cams(2);
+  if (!insight::sfm::load_sfm_checkpoint(dir, &rs, &rstore, &R, &C, &reg, &cams))
+    return fail("load_sfm_checkpoint failed");
+
+  if (rstore.num_tracks() != s.store.num_tracks() ||
+      rstore.num_observations() != s.store.num_observations() ||
+      rstore.num_valid_observations() != s.store.num_valid_observations() ||
+      rstore.num_triangulated_tracks() != s.store.num_triangulated_tracks())
+    return fail("track / observation counts differ");
+  for (int o = 0; o < static_cast<int>(s.store.num_observations()); ++o) {
+    if (rstore.is_obs_valid(o) != s.store.is_obs_valid(o) ||
+        rstore.is_obs_restorable(o) != s.store.is_obs_restorable(o) ||
+        rstore.obs_feature_id(o) != s.store.obs_feature_id(o) || rstore.obs_u(o) != s.store.obs_u(o))
+      return fail("observation " + std::to_string(o) + " differs");
+  }
+  for (int t = 0; t < static_cast<int>(s.store.num_tracks()); ++t) {
+    float a[3], b[3];
+    s.store.get_track_xyz(t, &a[0], &a[1], &a[2]);
+    rstore.get_track_xyz(t, &b[0], &b[1], &b[2]);
+    if (rstore.is_track_valid(t) != s.store.is_track_valid(t) ||
+        rstore.track_has_triangulated_xyz(t) != s.store.track_has_triangulated_xyz(t) ||
+        rstore.track_needs_retriangulation(t) != s.store.track_needs_retriangulation(t) ||
+        rstore.is_track_skip_ba(t) != s.store.is_track_skip_ba(t) || a[0] != b[0] ||
+        a[1] != b[1] || a[2] != b[2])
+      return fail("track " + std::to_string(t) + " differs");
+  }
+  for (int i = 0; i < rstore.num_images(); ++i)
+    if (rstore.image_tri_count(i) != s.store.image_tri_count(i))
+      return fail("image_tri_count differs");
+  if (!same_scheduler_state(rstore.scheduler_state(), s.store.scheduler_state()))
+    return fail("TrackStore epochs / queues differ");
+
+  if (reg != s.registered)
+    return fail("registered flags differ");
+  for (size_t i = 0; i < reg.size(); ++i)
+    if (reg[i] && (R[i] != s.R[i] || C[i] != s.C[i]))
+      return fail("pose " + std::to_string(i) + " not restored bit-exactly");
+  for (size_t c = 0; c < cams.size(); ++c)
+    if (cams[c].fx != s.cameras[c].fx || cams[c].k1 != s.cameras[c].k1 ||
+        cams[c].p2 != s.cameras[c].p2 || cams[c].width != s.cameras[c].width)
+      return fail("camera intrinsics not restored bit-exactly");
+
+  if (rs.sfm_iter != 17 || rs.num_registered != 3 || rs.anchor_image != 0 ||
+      rs.second_image != 1 || rs.no_candidate_consecutive != 1 ||
+      rs.next_periodic_global_registered != 140 || rs.next_mid_global_registered != 57 ||
+      rs.ba_grid_call_count != 9 || rs.intrinsics_phase != st.intrinsics_phase ||
+      rs.ms_global_ba != st.ms_global_ba || rs.ms_resection != 42)
+    return fail("loop state differs");
+  if (rs.ba_cameras_snapshot.size() != 2 || rs.ba_cameras_snapshot[0].fx != 1200.0)
+    return fail("ba_cameras_snapshot differs");
+  const ResectionScoreCache& rc = rs.resection_score_cache;
+  if (rc.entries.size() != cache.entries.size() || rc.last_obs_epoch != cache.last_obs_epoch ||
+      rc.last_tri_status_epoch != cache.last_tri_status_epoch ||
+      rc.last_registration_epoch != cache.last_registration_epoch ||
+      rc.last_registered_count != cache.last_registered_count ||
+      rc.last_visibility_pyramid_levels != cache.last_visibility_pyramid_levels ||
+      !same_candidates(rc.cached_candidates, cache.cached_candidates))
+    return fail("ResectionScoreCache watermarks differ");
+  for (size_t i = 0; i < rc.entries.size(); ++i)
+    if (rc.entries[i].n_tri != cache.entries[i].n_tri ||
+        rc.entries[i].score != cache.entries[i].score)
+      return fail("ResectionScoreCache entry differs");
+
+  // The next iteration must behave identically on the original and the resumed state.
+  ResectionScoreCache rcache = rs.resection_score_cache;
+  const auto a = choose_resection_candidates(s.store, s.registered, s.cameras, s.image_to_camera,
+                                             2, 10, 0.0f, 4, &cache);
+  const auto b = choose_resection_candidates(rstore, reg, cams, s.image_to_camera, 2, 10, 0.0f, 4,
+                                             &rcache);
+  if (a.empty() || !same_candidates(a, b))
+    return fail("next choose_resection_candidates differs after resume");
+  std::vector<int> pa, pb;
+  s.store.drain_retriangulation_pending(&pa);
+  rstore.drain_retriangulation_pending(&pb);
+  if (pa != pb)
+    return fail("retriangulation queue differs after resume");
+  if (rstore.is_track_tri_stale(5) != s.store.is_track_tri_stale(5))
+    return fail("per-track tri epoch differs");
+
+  std::filesystem::remove_all(dir);
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+int test_slots_alternate() {
+  std::cout << "[test2] slots alternate and checkpoint.json names the latest one\n";
+  Scene s = make_scene();
+  const std::string dir = temp_dir("isat_test_sfm_checkpoint_2");
+  SfMCheckpointState st;
+  for (int seq = 0; seq < 3; ++seq) {
+    st.seq = seq;
+    st.sfm_iter = 10 * (seq + 1);
+    if (!insight::sfm::save_sfm_checkpoint(dir, st, s.store, s.R, s.C, s.registered, s.cameras,
+                                           s.image_to_camera))
+      return fail("save_sfm_checkpoint failed at seq " + std::to_string(seq));
+  }
+  if (!std::filesystem::exists(insight::sfm::sfm_checkpoint_tracks_path(dir, 0)) ||
+      !std::filesystem::exists(insight::sfm::sfm_checkpoint_state_path(dir, 1)) ||
+      std::filesystem::exists(std::filesystem::path(dir) / "checkpoint_2.isat_tracks"))
+    return fail("expected exactly two alternating slots");
+
+  SfMCheckpointState rs;
+  TrackStore rstore;
+  std::vector<Eigen::Matrix3d> R;
+  std::vector<Eigen::Vector3d> C;
+  std::vector<bool> reg;
+  std::vector<Intrinsics> cams;
+  if (!insight::sfm::load_sfm_checkpoint((std::filesystem::path(dir) / "checkpoint.json").string(),
+                                         &rs, &rstore, &R, &C, &reg, &cams))
+    return fail("load_sfm_checkpoint failed");
+  if (rs.seq != 2 || rs.sfm_iter != 30)
+    return fail("resumed from seq " + std::to_string(rs.seq) + ", expected 2");
+
+  // A camera list of the wrong size must be rejected rather than silently truncated.
+  std::vector<Intrinsics> wrong(3);
+  if (insight::sfm::load_sfm_checkpoint(dir, &rs, &rstore, &R, &C, &reg, &wrong))
+    return fail("camera count mismatch must fail");
+
+  std::filesystem::remove_all(dir);
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+} // namespace
+
+int main() {
+  int failures = 0;
+  failures += test_round_trip_exact();
+  failures += test_slots_alternate();
+  if (failures == 0)
+    std::cout << "\nAll tests PASSED.\n";
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,274 @@
+/**
+ * @file  test_sfm_partition.cpp
+ * @brief Unit tests for partitioned SfM: view-graph clustering, cluster extraction and Sim3 merge
+ *        (sfm_partition.h).
+ */
+
+#include "sfm_partition.h"
+#include "track_store.h"
+#include "view_graph.h"
+
+#include <Eigen/Geometry>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using insight::camera::Intrinsics;
+using insight::sfm::MergeOptions;
+using insight::sfm::PairGeoInfo;
+using insight::sfm::PartitionOptions;
+using insight::sfm::SfMCluster;
+using insight::sfm::Sim3;
+using insight::sfm::Sim3RansacOptions;
+using insight::sfm::SubModelMergeInfo;
+using insight::sfm::SubReconstruction;
+using insight::sfm::TrackStore;
+using insight::sfm::ViewGraph;
+using insight::sfm::observation_key;
+
+namespace {
+
+int fail(const std::string& msg) {
+  std::cerr << "  FAIL: " << msg << "\n";
+  return 1;
+}
+
+Sim3 make_sim3(double scale, double angle, const Eigen::Vector3d& axis, const Eigen::Vector3d& t) {
+  Sim3 s;
+  s.scale = scale;
+  s.R = Eigen::AngleAxisd(angle, axis.normalized()).toRotationMatrix();
+  s.t = t;
+  return s;
+}
+
+// Strip of n images; track t is seen by images t%n .. t%n+2 (clamped), pairs (i,i+1), (i,i+2).
+void make_strip(int n_images, int n_tracks, TrackStore* store, ViewGraph* vg) {
+  store->set_num_images(n_images);
+  for (int t = 0; t < n_tracks; ++t) {
+    const int tid = store->add_track(0.f, 0.f, 0.f);
+    const int i0 = t % (n_images - 2);
+    for (int k = 0; k < 3; ++k)
+      store->add_observation(tid, static_cast<uint32_t>(i0 + k), static_cast<uint32_t>(t), 1.f * t,
+                             2.f * k);
+  }
+  store->compact();
+  for (int i = 0; i < n_images; ++i)
+    for (int d = 1; d <= 2 && i + d < n_images; ++d) {
+      PairGeoInfo p;
+      p.image1_index = static_cast<uint32_t>(i);
+      p.image2_index = static_cast<uint32_t>(i + d);
+      vg->add_pair(p);
+    }
+}
+
+int test_sim3_ransac() {
+  std::cout << "[test1] estimate_sim3_ransac recovers a similarity with 30% outliers\n";
+  const Sim3 gt = make_sim3(2.5, 0.7, Eigen::Vector3d(0.2, 1.0, -0.4), Eigen::Vector3d(3, -1, 7));
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<double> u(-10.0, 10.0);
+  std::vector<Eigen::Vector3d> src, dst;
+  std::vector<char> truth;
+  for (int i = 0; i < 200; ++i) {
+    const Eigen::Vector3d x(u(rng), u(rng), u(rng));
+    src.push_back(x);
+    const bool outlier = (i % 10) < 3;
+    dst.push_back(outlier ? Eigen::Vector3d(u(rng), u(rng), u(rng)) * 5.0 : gt.apply(x));
+    truth.push_back(outlier ? 0 : 1);
+  }
+  Sim3 est;
+  std::vector<char> mask;
+  int n_in = 0;
+  if (!insight::sfm::estimate_sim3_ransac(src, dst, Sim3RansacOptions(), &est, &mask, &n_in))
+    return fail("RANSAC failed");
+  if (n_in != 140 || mask != truth)
+    return fail("wrong inlier set: " + std::to_string(n_in));
+  if (std::abs(est.scale - gt.scale) > 1e-9 || (est.R - gt.R).norm() > 1e-9 ||
+      (est.t - gt.t).norm() > 1e-8)
+    return fail("transform not recovered");
+
+  // Too few agreeing points.
+  std::vector<Eigen::Vector3d> few_src(src.begin(), src.begin() + 5);
+  std::vector<Eigen::Vector3d> few_dst(dst.begin(), dst.begin() + 5);
+  if (insight::sfm::estimate_sim3_ransac(few_src, few_dst, Sim3RansacOptions(), &est))
+    return fail("accepted fewer than min_inliers correspondences");
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+int test_partition_cover_and_overlap() {
+  std::cout << "[test2] partition_view_graph covers every image once, caps cores, adds overlap\n";
+  TrackStore store;
+  ViewGraph vg;
+  const int n_images = 100;
+  make_strip(n_images, 2000, &store, &vg);
+  PartitionOptions opts;
+  opts.max_cluster_images = 30;
+  opts.overlap_ratio = 0.1;
+  opts.min_overlap_images = 4;
+  opts.min_cluster_images = 5;
+  const std::vector<SfMCluster> clusters = insight::sfm::partition_view_graph(vg, store, opts);
+  if (clusters.size() < 4)
+    return fail("expected at least 4 clusters, got " + std::to_string(clusters.size()));
+  std::vector<int> owner(n_images, -1);
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    if (clusters[c].core.size() > 30)
+      return fail("core over the cap");
+    if (clusters[c].overlap.size() < 4)
+      return fail("overlap below min_overlap_images");
+    for (int im : clusters[c].core) {
+      if (owner[static_cast<size_t>(im)] >= 0)
+        return fail("image in two cores");
+      owner[static_cast<size_t>(im)] = static_cast<int>(c);
+    }
+  }
+  for (size_t c = 0; c < clusters.size(); ++c)
+    for (int im : clusters[c].overlap)
+      if (owner[static_cast<size_t>(im)] == static_cast<int>(c))
+        return fail("overlap image from own core");
+  for (int im = 0; im < n_images; ++im)
+    if (owner[static_cast<size_t>(im)] < 0)
+      return fail("image " + std::to_string(im) + " not assigned");
+
+  // A strip must be cut into contiguous runs: each core spans max-min+1 == size.
+  for (const SfMCluster& c : clusters)
+    if (c.core.back() - c.core.front() + 1 != static_cast<int>(c.core.size()))
+      return fail("core is not a contiguous run of the strip");
+
+  const std::vector<SfMCluster> again = insight::sfm::partition_view_graph(vg, store, opts);
+  for (size_t c = 0; c < clusters.size(); ++c)
+    if (again.size() != clusters.size() || again[c].core != clusters[c].core ||
+        again[c].overlap != clusters[c].overlap)
+      return fail("partition not deterministic");
+  std::cout << "  PASS (" << clusters.size() << " clusters)\n";
+  return 0;
+}
+
+int test_extract_cluster() {
+  std::cout << "[test3] extract_cluster_track_store / filter_view_graph keep only cluster data\n";
+  TrackStore store;
+  ViewGraph vg;
+  make_strip(10, 8, &store, &vg); // tracks t: images t..t+2
+  store.mark_observation_deleted(0); // track 0 loses image 0
+  const std::vector<int> images = {0, 1, 2, 3};
+  TrackStore sub;
+  insight::sfm::extract_cluster_track_store(store, images, &sub);
+  // Track 0: images {1,2} alive → kept.  Track 1: {1,2,3}.  Track 2: {2,3}.  Track 3: {3} → dropped.
+  if (sub.num_images() != 10 || sub.num_tracks() != 3)
+    return fail("expected 3 tracks over 10 images, got " + std::to_string(sub.num_tracks()));
+  if (sub.num_observations() != 7)
+    return fail("expected 7 observations, got " + std::to_string(sub.num_observations()));
+  const ViewGraph sub_vg = insight::sfm::filter_view_graph(vg, images);
+  if (sub_vg.num_pairs() != 5) // (0,1) (0,2) (1,2) (1,3) (2,3)
+    return fail("expected 5 pairs, got " + std::to_string(sub_vg.num_pairs()));
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+int test_merge_two_models() {
+  std::cout << "[test4] merge_sub_reconstructions aligns overlapping sub-models by Sim3\n";
+  const int n_images = 12;
+  std::vector<Eigen::Matrix3d> R_gt;
+  std::vector<Eigen::Vector3d> C_gt;
+  for (int i = 0; i < n_images; ++i) {
+    R_gt.push_back(
+        Eigen::AngleAxisd(0.05 * i, Eigen::Vector3d(0.1, 1.0, 0.3).normalized()).toRotationMatrix());
+    C_gt.emplace_back(1.0 * i, 0.2 * std::sin(i), 0.1 * i);
+  }
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> u(-5.0, 5.0);
+  std::vector<Eigen::Vector3d> X_gt;
+  for (int p = 0; p < 300; ++p)
+    X_gt.emplace_back(u(rng) + 6.0, u(rng), u(rng) + 10.0);
+
+  // Sub-model A: images 0..7 in the ground-truth frame.  Sub-model B: images 3..11 in a frame
+  // related by to_b; point p is observed as feature p on images p%12 and (p+1)%12.
+  const Sim3 to_b = make_sim3(0.4, -1.1, Eigen::Vector3d(1, 0.5, 0.2), Eigen::Vector3d(-2, 4, 1));
+  SubReconstruction a, b;
+  for (SubReconstruction* s : {&a, &b}) {
+    s->poses_R.assign(n_images, Eigen::Matrix3d::Identity());
+    s->poses_C.assign(n_images, Eigen::Vector3d::Zero());
+    s->registered.assign(n_images, false);
+  }
+  Intrinsics K;
+  K.fx = K.fy = 1000.0;
+  K.cx = 500.0;
+  K.cy = 400.0;
+  a.cameras = {K};
+  b.cameras = {K};
+  b.cameras[0].fx = b.cameras[0].fy = 1111.0; // B registers more images of camera 0 → wins
+  for (int i = 0; i <= 7; ++i) {
+    a.registered[static_cast<size_t>(i)] = true;
+    a.poses_R[static_cast<size_t>(i)] = R_gt[static_cast<size_t>(i)];
+    a.poses_C[static_cast<size_t>(i)] = C_gt[static_cast<size_t>(i)];
+  }
+  for (int i = 3; i < n_images; ++i) {
+    b.registered[static_cast<size_t>(i)] = true;
+    b.poses_R[static_cast<size_t>(i)] = R_gt[static_cast<size_t>(i)] * to_b.R.transpose();
+    b.poses_C[static_cast<size_t>(i)] = to_b.apply(C_gt[static_cast<size_t>(i)]);
+  }
+  for (int p = 0; p < 300; ++p) {
+    for (int k = 0; k < 2; ++k) {
+      const int im = (p + k) % n_images;
+      const uint64_t key = observation_key(static_cast<uint32_t>(im), static_cast<uint32_t>(p));
+      if (a.registered[static_cast<size_t>(im)])
+        a.points[key] = X_gt[static_cast<size_t>(p)];
+      if (b.registered[static_cast<size_t>(im)])
+        b.points[key] = p % 17 == 0 ? Eigen::Vector3d(100, 100, 100) // mis-triangulated in B
+                                    : to_b.apply(X_gt[static_cast<size_t>(p)]);
+    }
+  }
+
+  std::vector<Eigen::Matrix3d> R;
+  std::vector<Eigen::Vector3d> C;
+  std::vector<bool> registered;
+  std::vector<Intrinsics> cameras = {K};
+  std::vector<SubModelMergeInfo> info;
+  const std::vector<int> img2cam(n_images, 0);
+  if (!insight::sfm::merge_sub_reconstructions({a, b}, img2cam, MergeOptions(), &R, &C,
+                                               &registered, &cameras, &info))
+    return fail("merge failed");
+  // B (9 images) is the reference; A is attached through images 3..7.
+  if (!info[1].reference || !info[0].merged || info[0].shared_images != 5)
+    return fail("unexpected merge order / shared images");
+  // Merged frame = B's frame: compare with ground truth mapped through to_b.
+  for (int i = 0; i < n_images; ++i) {
+    if (!registered[static_cast<size_t>(i)])
+      return fail("image " + std::to_string(i) + " not registered");
+    const Eigen::Matrix3d R_exp = R_gt[static_cast<size_t>(i)] * to_b.R.transpose();
+    const Eigen::Vector3d C_exp = to_b.apply(C_gt[static_cast<size_t>(i)]);
+    if ((R[static_cast<size_t>(i)] - R_exp).norm() > 1e-9 ||
+        (C[static_cast<size_t>(i)] - C_exp).norm() > 1e-9)
+      return fail("pose " + std::to_string(i) + " off");
+  }
+  if (cameras[0].fx != 1111.0)
+    return fail("intrinsics not taken from the sub-model with most images of the camera");
+  const Sim3 a_to_b = info[0].to_merged;
+  if (std::abs(a_to_b.scale - to_b.scale) > 1e-9 || (a_to_b.t - to_b.t).norm() > 1e-8)
+    return fail("A→merged transform off");
+
+  // Too few shared images: A is left out.
+  MergeOptions strict;
+  strict.min_shared_images = 6;
+  insight::sfm::merge_sub_reconstructions({a, b}, img2cam, strict, &R, &C, &registered, &cameras,
+                                          &info);
+  if (info[0].merged || registered[0])
+    return fail("merged a sub-model below min_shared_images");
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+} // namespace
+
+int main() {
+  int failures = 0;
+  failures += test_sim3_ransac();
+  failures += test_partition_cover_and_overlap();
+  failures += test_extract_cluster();
+  failures += test_merge_two_models();
+  if (failures == 0)
+    std::cout << "\nAll tests PASSED.\n";
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
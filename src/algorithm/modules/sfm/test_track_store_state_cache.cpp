@@ -4,9 +4,11 @@
  */
 
 #include "track_store.h"
+#include "../camera/camera_utils.h"
 
 #include <cstdlib>
 #include <iostream>
+#include <random>
 #include <string>
 #include <vector>
 
@@ -196,6 +198,181 @@ static int test_pose_epoch_and_tri_stale() {
   return 0;
 }
 
+// ─────────────────────────────────────────────────────────────────────────────
+// test5: CSR adjacency + overflow arena + compact()
+// ─────────────────────────────────────────────────────────────────────────────
+static int check_views(const TrackStore& s, const std::vector<std::vector<int>>& by_track,
+                       const std::vector<std::vector<int>>& by_image, const std::string& when) {
+  for (size_t t = 0; t < by_track.size(); ++t) {
+    const auto& view = s.track_all_obs_ids_view(static_cast<int>(t));
+    if (std::vector<int>(view.begin(), view.end()) != by_track[t])
+      return fail("track view mismatch " + when);
+  }
+  for (size_t i = 0; i < by_image.size(); ++i) {
+    std::vector<int> ids;
+    s.get_image_all_obs_ids(static_cast<int>(i), &ids);
+    if (ids != by_image[i])
+      return fail("image view mismatch " + when);
+  }
+  return 0;
+}
+
+static int test_csr_overflow_and_compact() {
+  std::cout << "[test5] CSR adjacency: overflow appends + compact()\n";
+
+  const int n_images = 7;
+  TrackStore s;
+  s.set_num_images(n_images);
+  std::vector<std::vector<int>> by_track, by_image(n_images);
+  auto add = [&](int t, int im) {
+    const int o = s.add_observation(t, static_cast<uint32_t>(im), 0u, 0.f, 0.f);
+    by_track[static_cast<size_t>(t)].push_back(o);
+    by_image[static_cast<size_t>(im)].push_back(o);
+  };
+
+  // Track-by-track load: tracks extend CSR in place, images go to the overflow arena.
+  for (int t = 0; t < 50; ++t) {
+    by_track.emplace_back();
+    s.add_track(0.f, 0.f, 0.f);
+    for (int k = 0; k < 2 + t % 4; ++k)
+      add(t, (t + k) % n_images);
+  }
+  if (int rc = check_views(s, by_track, by_image, "after load"))
+    return rc;
+  if (s.is_compact())
+    return fail("interleaved image appends must use the overflow arena");
+  s.compact();
+  if (!s.is_compact() || check_views(s, by_track, by_image, "after compact"))
+    return fail("compact() must keep every list");
+
+  // Random appends after load (old tracks move to the arena, new tracks start empty).
+  std::mt19937 rng(17);
+  for (int t = 0; t < 10; ++t) {
+    by_track.emplace_back();
+    s.add_track(0.f, 0.f, 0.f);
+  }
+  std::uniform_int_distribution<int> track(0, static_cast<int>(by_track.size()) - 1);
+  std::uniform_int_distribution<int> image(0, n_images - 1);
+  for (int i = 0; i < 500; ++i)
+    add(track(rng), image(rng));
+  if (int rc = check_views(s, by_track, by_image, "after overflow appends"))
+    return rc;
+  s.compact();
+  if (int rc = check_views(s, by_track, by_image, "after second compact"))
+    return rc;
+
+  // All tracks first, then observations in track order (IDC load): stays in CSR.
+  TrackStore bulk;
+  bulk.set_num_images(1);
+  for (int t = 0; t < 5; ++t)
+    bulk.add_track(0.f, 0.f, 0.f);
+  for (int t = 0; t < 5; t += 2)
+    bulk.add_observation(t, 0u, static_cast<uint32_t>(t), 0.f, 0.f);
+  if (!bulk.is_compact() || bulk.track_all_obs_ids_view(2).size() != 1 ||
+      !bulk.track_all_obs_ids_view(3).empty() || bulk.image_all_obs_ids_view(0).size() != 3)
+    return fail("sorted bulk load must not use the overflow arena");
+
+  // Shrinking the image count drops the trailing image lists.
+  s.set_num_images(3);
+  if (!s.image_all_obs_ids_view(3).empty() || s.image_all_obs_ids_view(2).size() != by_image[2].size())
+    return fail("set_num_images shrink");
+
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// test6: undistorted normalised coordinate cache
+// ─────────────────────────────────────────────────────────────────────────────
+static int test_undistorted_cache() {
+  std::cout << "[test6] undistorted coordinate cache: refresh / tolerance / fallback\n";
+
+  using insight::camera::Intrinsics;
+  std::vector<Intrinsics> cams(2);
+  cams[0].fx = cams[0].fy = 3000.0;
+  cams[0].cx = 2000.0;
+  cams[0].cy = 1500.0;
+  cams[0].k1 = -0.12;
+  cams[0].k2 = 0.05;
+  cams[0].p1 = 1e-4;
+  cams[1] = cams[0];
+  cams[1].fx = cams[1].fy = 2500.0;
+  cams[1].k1 = 0.03;
+  const std::vector<int> image_cam = {0, 1, 0};
+
+  TrackStore s;
+  s.set_num_images(3);
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> px(0.f, 3000.f);
+  for (int t = 0; t < 300; ++t) {
+    s.add_track(0.f, 0.f, 0.f);
+    for (uint32_t im = 0; im < 3; ++im)
+      s.add_observation(t, im, 0u, px(rng), px(rng));
+  }
+  auto check_all = [&](const std::string& when) {
+    for (int o = 0; o < static_cast<int>(s.num_observations()); ++o) {
+      const Intrinsics& K = cams[static_cast<size_t>(image_cam[s.obs_image_index(o)])];
+      double u, v, xn, yn;
+      insight::camera::undistort_point(K, s.obs_u(o), s.obs_v(o), &u, &v);
+      if (!s.obs_undistorted_normalized(o, &xn, &yn))
+        return fail("observation not cached " + when);
+      // The cache must be exact: triangulation and resection results may not depend on it.
+      if (xn != (u - K.cx) / K.fx || yn != (v - K.cy) / K.fy)
+        return fail("cached coordinates differ from undistort_point " + when);
+    }
+    return 0;
+  };
+
+  double xn, yn;
+  if (s.obs_undistorted_normalized(0, &xn, &yn))
+    return fail("cache must be empty before the first refresh");
+  if (s.refresh_undistorted_cache(cams, image_cam) != 900)
+    return fail("first refresh must compute every observation");
+  if (int rc = check_all("after first refresh"))
+    return rc;
+  if (s.refresh_undistorted_cache(cams, image_cam) != 0)
+    return fail("unchanged intrinsics must not recompute");
+
+  // Drift within tolerance keeps the cache; beyond it recomputes only that camera.
+  cams[1].fx *= 1.0 + 1e-8;
+  if (s.refresh_undistorted_cache(cams, image_cam) != 0)
+    return fail("sub-tolerance change must keep the cache");
+  if (!s.undistorted_cache_matches(1, cams[1]) || s.undistorted_cache_matches(1, cams[0]))
+    return fail("undistorted_cache_matches");
+  cams[1].k1 = 0.01;
+  if (s.undistorted_cache_matches(1, cams[1]))
+    return fail("changed distortion must not match the snapshot");
+  if (s.refresh_undistorted_cache(cams, image_cam) != 300)
+    return fail("only the changed camera's observations must be recomputed");
+  if (int rc = check_all("after camera 1 change"))
+    return rc;
+
+  // Observations added later are picked up; invalidation forces a recompute.
+  const int t = s.add_track(0.f, 0.f, 0.f);
+  const int o_new = s.add_observation(t, 2u, 0u, 10.f, 20.f);
+  if (s.obs_undistorted_normalized(o_new, &xn, &yn))
+    return fail("new observation must not be cached before refresh");
+  if (s.refresh_undistorted_cache(cams, image_cam) != 1)
+    return fail("refresh must pick up the new observation");
+  s.invalidate_undistorted_cache(0);
+  if (s.obs_undistorted_normalized(o_new, &xn, &yn))
+    return fail("invalidated camera must not serve cached coordinates");
+  if (s.refresh_undistorted_cache(cams, image_cam) != 601)
+    return fail("invalidated camera must be recomputed");
+  if (int rc = check_all("after invalidate"))
+    return rc;
+
+  // Images beyond the cached image count are reported as not cached.
+  s.set_num_images(2);
+  if (s.obs_undistorted_normalized(o_new, &xn, &yn))
+    return fail("observation of an image beyond the cached count must not be served");
+  if (!s.obs_undistorted_normalized(0, &xn, &yn))
+    return fail("observation of a cached image must still be served");
+
+  std::cout << "  PASS\n";
+  return 0;
+}
+
 } // namespace
 
 int main() {
@@ -204,6 +381,8 @@ int main() {
   failures += test_retri_pending_dedupe();
   failures += test_observation_views_and_scalar_accessors();
   failures += test_pose_epoch_and_tri_stale();
+  failures += test_csr_overflow_and_compact();
+  failures += test_undistorted_cache();
   if (failures == 0)
     std::cout << "\nAll tests PASSED.\n";
   return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
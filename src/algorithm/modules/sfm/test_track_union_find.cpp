@@ -0,0 +1,120 @@
+/**
+ * @file  test_track_union_find.cpp
+ * @brief Unit tests for TrackUnionFind: parallel merge_pairs reproduces serial merge_keys.
+ */
+
+#include "track_union_find.h"
+#include "track_test_pairs.h"
+
+#include <omp.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using insight::sfm::TrackInlierMatch;
+using insight::sfm::TrackMergeStats;
+using insight::sfm::TrackPairMatches;
+using insight::sfm::TrackUnionFind;
+using insight::sfm::track_node_key;
+using insight::sfm::test::PairData;
+using insight::sfm::test::as_views;
+using insight::sfm::test::make_pairs;
+
+namespace {
+
+int fail(const std::string& msg) {
+  std::cerr << "  FAIL: " << msg << "\n";
+  return 1;
+}
+
+TrackUnionFind serial_reference(const std::vector<PairData>& pairs, int64_t* merged,
+                                int64_t* rejected) {
+  TrackUnionFind uf;
+  for (const PairData& d : pairs) {
+    for (const TrackInlierMatch& m : d.matches) {
+      if (uf.merge_keys(track_node_key(d.image1, m.idx1), track_node_key(d.image2, m.idx2), m.x1,
+                        m.y1, m.s1, m.x2, m.y2, m.s2))
+        ++*merged;
+      else
+        ++*rejected;
+    }
+  }
+  return uf;
+}
+
+int compare(TrackUnionFind& ref, TrackUnionFind& got) {
+  if (ref.node_id_ != got.node_id_)
+    return fail("node ids differ");
+  if (ref.node_u_ != got.node_u_ || ref.node_v_ != got.node_v_)
+    return fail("first-seen node coords differ");
+  for (size_t i = 0; i < ref.parent_.size(); ++i) {
+    const int r = ref.find_by_id(static_cast<int>(i));
+    const int g = got.find_by_id(static_cast<int>(i));
+    if (r != g)
+      return fail("root of node " + std::to_string(i) + " differs");
+    if (ref.component_size_[static_cast<size_t>(r)] != got.component_size_[static_cast<size_t>(g)] ||
+        ref.component_images_[static_cast<size_t>(r)] != got.component_images_[static_cast<size_t>(g)])
+      return fail("component of node " + std::to_string(i) + " differs");
+  }
+  return 0;
+}
+
+int test_parallel_matches_serial() {
+  std::cout << "[test1] merge_pairs == serial merge_keys (1 and 4 threads, several blocks)\n";
+  const auto pairs = make_pairs(12, 400, 60, 40, 7);
+  int64_t ref_merged = 0, ref_rejected = 0;
+  TrackUnionFind ref = serial_reference(pairs, &ref_merged, &ref_rejected);
+  if (ref_rejected == 0)
+    return fail("test data does not exercise the same-image conflict rule");
+
+  for (int threads : {1, 4}) {
+    omp_set_num_threads(threads);
+    TrackUnionFind uf;
+    int64_t merged = 0, rejected = 0;
+    // Three blocks of unequal size, like consecutive geopack blocks.
+    const size_t cuts[] = {0, 50, 260, pairs.size()};
+    for (int b = 0; b < 3; ++b) {
+      const TrackMergeStats s = uf.merge_pairs(as_views(pairs, cuts[b], cuts[b + 1]));
+      merged += s.merged;
+      rejected += s.rejected;
+    }
+    if (merged != ref_merged || rejected != ref_rejected)
+      return fail("merged/rejected counts differ with " + std::to_string(threads) + " threads");
+    if (compare(ref, uf) != 0)
+      return 1;
+  }
+  std::cout << "  PASS (" << ref_merged << " merged, " << ref_rejected << " rejected)\n";
+  return 0;
+}
+
+int test_empty_and_duplicate_matches() {
+  std::cout << "[test2] empty pairs and repeated matches\n";
+  std::vector<PairData> pairs(3);
+  pairs[0] = {0, 1, {}};
+  TrackInlierMatch m{5, 6, 1.f, 2.f, 3.f, 4.f, 1.f, 1.f};
+  pairs[1] = {0, 1, {m, m, m}};
+  pairs[2] = {1, 2, {}};
+  TrackUnionFind uf;
+  const TrackMergeStats s = uf.merge_pairs(as_views(pairs, 0, pairs.size()));
+  if (s.merged != 3 || s.rejected != 0 || uf.parent_.size() != 2)
+    return fail("repeated match must create 2 nodes and count 3 merges");
+  if (uf.find_by_id(0) != uf.find_by_id(1))
+    return fail("nodes not united");
+  if (uf.merge_pairs({}).merged != 0)
+    return fail("empty batch");
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+}  // namespace
+
+int main() {
+  int failures = 0;
+  failures += test_parallel_matches_serial();
+  failures += test_empty_and_duplicate_matches();
+  if (failures == 0)
+    std::cout << "\nAll tests PASSED.\n";
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,252 @@
+/**
+ * @file  test_track_update.cpp
+ * @brief Unit tests for incremental track update (seed existing tracks, merge new matches).
+ */
+
+#include "track_update.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using insight::sfm::Observation;
+using insight::sfm::TrackStore;
+using insight::sfm::TrackUnionFind;
+using insight::sfm::TrackUpdateStats;
+using insight::sfm::build_updated_track_store;
+using insight::sfm::seed_union_find_from_track_store;
+using insight::sfm::track_node_key;
+namespace track_update = insight::sfm::track_update;
+
+namespace {
+
+int fail(const std::string& msg) {
+  std::cerr << "  FAIL: " << msg << "\n";
+  return 1;
+}
+
+struct Match {
+  uint32_t img1, feat1, img2, feat2;
+};
+
+void merge(TrackUnionFind* uf, const Match& m) {
+  uf->merge_keys(track_node_key(m.img1, m.feat1), track_node_key(m.img2, m.feat2),
+                 static_cast<float>(m.feat1), 0.f, 1.f, static_cast<float>(m.feat2), 0.f, 1.f);
+}
+
+std::set<uint64_t> track_keys(const TrackStore& s, int t) {
+  std::vector<Observation> obs;
+  s.get_track_observations(t, &obs);
+  std::set<uint64_t> keys;
+  for (const Observation& o : obs) keys.insert(track_node_key(o.image_index, o.feature_id));
+  return keys;
+}
+
+int test_status_and_id_preservation() {
+  std::cout << "[test1] ids preserved; unchanged/extended/merged/split/new marked\n";
+  TrackStore old;
+  old.set_num_images(8);
+  const int t0 = old.add_track(1.f, 2.f, 3.f);  // extended, keeps triangulated xyz
+  old.set_track_xyz(t0, 1.f, 2.f, 3.f);
+  old.add_observation(t0, 0, 1, 1.f, 0.f);
+  old.add_observation(t0, 1, 1, 1.f, 0.f);
+  const int t1 = old.add_track(0.f, 0.f, 0.f);  // merged with t2
+  old.add_observation(t1, 2, 5, 5.f, 0.f);
+  old.add_observation(t1, 3, 5, 5.f, 0.f);
+  const int t2 = old.add_track(0.f, 0.f, 0.f);  // merged away into t1
+  old.add_observation(t2, 0, 7, 7.f, 0.f);
+  old.add_observation(t2, 4, 7, 7.f, 0.f);
+  const int t3 = old.add_track(4.f, 5.f, 6.f);  // unchanged
+  old.set_track_xyz(t3, 4.f, 5.f, 6.f);
+  old.add_observation(t3, 4, 9, 9.f, 0.f);
+  old.add_observation(t3, 5, 9, 9.f, 0.f);
+  const int t4 = old.add_track(0.f, 0.f, 0.f);  // image 6 twice → split while seeding
+  old.add_observation(t4, 6, 1, 1.f, 0.f);
+  old.add_observation(t4, 6, 2, 2.f, 0.f);
+  old.add_observation(t4, 7, 1, 1.f, 0.f);
+
+  TrackUnionFind uf;
+  if (seed_union_find_from_track_store(old, &uf) != 1)
+    return fail("seeding must reject exactly the duplicate-image observation");
+  merge(&uf, {1, 1, 5, 3});   // extends t0
+  merge(&uf, {3, 5, 4, 7});   // t1 + t2
+  merge(&uf, {8, 1, 9, 1});   // new track (images beyond the old list)
+  merge(&uf, {8, 2, 9, 2});   // new track, dropped by min length 3
+  merge(&uf, {8, 2, 10, 2});  // ... now 3 nodes: kept
+
+  TrackStore out;
+  std::vector<uint8_t> status;
+  std::vector<int32_t> link;
+  const TrackUpdateStats st = build_updated_track_store(old, uf, 11, 3, &out, &status, &link);
+  if (out.num_tracks() != 7 || status.size() != 7 || link.size() != 7)
+    return fail("expected 5 existing + split piece + 1 new track, got " +
+                std::to_string(out.num_tracks()));
+  if (st.skipped_short != 1)
+    return fail("short new track must be skipped");
+  const uint8_t want[] = {track_update::kExtended, track_update::kMerged, track_update::kMergedAway,
+                          track_update::kUnchanged, track_update::kSplit, track_update::kSplit,
+                          track_update::kNew};
+  const int32_t want_link[] = {-1, -1, 1, -1, -1, 4, -1};
+  for (int t = 0; t < 7; ++t)
+    if (status[static_cast<size_t>(t)] != want[t] || link[static_cast<size_t>(t)] != want_link[t])
+      return fail("status/link of track " + std::to_string(t));
+  if (track_keys(out, 0) != std::set<uint64_t>{track_node_key(0, 1), track_node_key(1, 1),
+                                               track_node_key(5, 3)})
+    return fail("extended track observations");
+  if (track_keys(out, 1).size() != 4 || !track_keys(out, 2).empty() || out.is_track_valid(2))
+    return fail("merged / merged-away tracks");
+  if (track_keys(out, 5) != std::set<uint64_t>{track_node_key(6, 2)})
+    return fail("split-off piece");
+  float x, y, z;
+  out.get_track_xyz(0, &x, &y, &z);
+  if (!out.track_has_triangulated_xyz(0) || x != 1.f || !out.track_has_triangulated_xyz(3) ||
+      out.track_has_triangulated_xyz(1))
+    return fail("triangulation must be kept only for unchanged/extended tracks");
+  std::cout << "  PASS\n";
+  return 0;
+}
+
+// Store numbered by smallest key, like isat_tracks.
+TrackStore store_from_union_find(TrackUnionFind& uf, int num_images) {
+  std::map<uint64_t, int> keys(uf.node_id_.begin(), uf.node_id_.end());
+  std::map<int, int> root_track;
+  TrackStore store;
+  store.set_num_images(num_images);
+  std::vector<std::pair<int, uint64_t>> obs;
+  for (const auto& [key, id] : keys) {
+    const int root = uf.find_by_id(id);
+    auto it = root_track.emplace(root, static_cast<int>(root_track.size())).first;
+    obs.push_back({it->second, key});
+  }
+  for (size_t t = 0; t < root_track.size(); ++t) store.add_track(0.f, 0.f, 0.f);
+  std::stable_sort(obs.begin(), obs.end(),
+                   [](const auto& a, const auto& b) { return a.first < b.first; });
+  for (const auto& [t, key] : obs)
+    store.add_observation(t, static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key), 0.f,
+                          0.f);
+  return store;
+}
+
+std::set<std::set<uint64_t>> components(TrackUnionFind& uf) {
+  std::map<int, std::set<uint64_t>> by_root;
+  for (const auto& [key, id] : uf.node_id_) by_root[uf.find_by_id(id)].insert(key);
+  std::set<std::set<uint64_t>> out;
+  for (auto& kv : by_root) out.insert(kv.second);
+  return out;
+}
+
+std::set<std::set<uint64_t>> valid_tracks(const TrackStore& s) {
+  std::set<std::set<uint64_t>> out;
+  for (int t = 0; t < static_cast<int>(s.num_tracks()); ++t)
+    if (s.is_track_valid(t)) out.insert(track_keys(s, t));
+  return out;
+}
+
+std::vector<Match> random_matches(uint32_t max_feature, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<uint32_t> img(0, 14), feat(0, max_feature);
+  std::vector<Match> matches;
+  for (int i = 0; i < 3000; ++i) {
+    Match m{img(rng), feat(rng), img(rng), feat(rng)};
+    if (m.img1 != m.img2) matches.push_back(m);
+  }
+  return matches;
+}
+
+int test_update_equals_rebuild() {
+  std::cout << "[test2] update(old pairs) + new pairs == rebuild over all pairs\n";
+  const std::vector<Match> matches = random_matches(40, 9);
+  const size_t half = matches.size() / 2;
+
+  TrackUnionFind first;
+  for (size_t i = 0; i < half; ++i) merge(&first, matches[i]);
+  const TrackStore old = store_from_union_find(first, 15);
+
+  TrackUnionFind uf;
+  if (seed_union_find_from_track_store(old, &uf) != 0)
+    return fail("clean store must seed without rejections");
+  for (size_t i = half; i < matches.size(); ++i) merge(&uf, matches[i]);
+  TrackStore out;
+  std::vector<uint8_t> status;
+  std::vector<int32_t> link;
+  const TrackUpdateStats st = build_updated_track_store(old, uf, 15, 1, &out, &status, &link);
+
+  TrackUnionFind full;
+  for (const Match& m : matches) merge(&full, m);
+  const std::set<std::set<uint64_t>> got = valid_tracks(out);
+  if (got != components(full))
+    return fail("updated tracks differ from a full rebuild");
+  if (st.split != 0 || st.merged == 0 || st.merged_away == 0)
+    return fail("unexpected update statistics");
+  std::cout << "  PASS (" << old.num_tracks() << " -> " << got.size() << " tracks, merged="
+            << st.merged << " merged_away=" << st.merged_away << " extended=" << st.extended
+            << " new=" << st.new_tracks << ")\n";
+  return 0;
+}
+
+int test_update_with_min_track_length() {
+  std::cout << "[test3] min length: rebuild minus short components without existing obs\n";
+  // Many features per image: plenty of 2-node components among old and new matches.
+  const std::vector<Match> matches = random_matches(400, 21);
+  const size_t half = matches.size() / 2;
+  constexpr int kMinLength = 3;
+
+  TrackUnionFind first;
+  for (size_t i = 0; i < half; ++i) merge(&first, matches[i]);
+  const TrackStore old = store_from_union_find(first, 15);
+  std::set<uint64_t> old_keys;
+  for (const auto& kv : first.node_id_) old_keys.insert(kv.first);
+
+  TrackUnionFind uf;
+  seed_union_find_from_track_store(old, &uf);
+  for (size_t i = half; i < matches.size(); ++i) merge(&uf, matches[i]);
+  TrackStore out;
+  std::vector<uint8_t> status;
+  std::vector<int32_t> link;
+  const TrackUpdateStats st =
+      build_updated_track_store(old, uf, 15, kMinLength, &out, &status, &link);
+
+  // The length filter applies to new components only: existing tracks are kept however short,
+  // so this is not the full build's --min-track-length degree filter.
+  TrackUnionFind full;
+  for (const Match& m : matches) merge(&full, m);
+  std::set<std::set<uint64_t>> expected;
+  int short_new = 0, short_existing = 0;
+  for (const std::set<uint64_t>& c : components(full)) {
+    const bool has_old = std::any_of(c.begin(), c.end(),
+                                     [&old_keys](uint64_t k) { return old_keys.count(k) != 0; });
+    if (static_cast<int>(c.size()) < kMinLength) {
+      if (!has_old) {
+        ++short_new;
+        continue;
+      }
+      ++short_existing;
+    }
+    expected.insert(c);
+  }
+  if (valid_tracks(out) != expected)
+    return fail("updated tracks differ from the filtered rebuild");
+  if (st.skipped_short != short_new || short_new == 0 || short_existing == 0)
+    return fail("short component bookkeeping: skipped=" + std::to_string(st.skipped_short) +
+                " expected=" + std::to_string(short_new));
+  std::cout << "  PASS (" << short_new << " short new components dropped, " << short_existing
+            << " short existing tracks kept)\n";
+  return 0;
+}
+
+}  // namespace
+
+int main() {
+  int failures = 0;
+  failures += test_status_and_id_preservation();
+  failures += test_update_equals_rebuild();
+  failures += test_update_with_min_track_length();
+  if (failures == 0)
+    std::cout << "\nAll tests PASSED.\n";
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
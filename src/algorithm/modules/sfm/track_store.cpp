@@ -4,20 +4,97 @@
  */
 
 #include "track_store.h"
+#include "../camera/camera_utils.h"
 #include <algorithm>
 #include <cassert>
 
 namespace insight {
 namespace sfm {
 
-namespace {
+// ─────────────────────────────────────────────────────────────────────────────
+// ObsIdAdjacency
+// ─────────────────────────────────────────────────────────────────────────────
 
-const std::vector<int>& empty_obs_id_view() {
-  static const std::vector<int> kEmpty;
-  return kEmpty;
+void ObsIdAdjacency::resize_rows(size_t n) {
+  if (n < num_rows()) {
+    compact();
+    if (n + 1 < row_offset_.size()) {
+      row_offset_.resize(n + 1);
+      csr_ids_.resize(row_offset_.back());
+    }
+  }
+  overflow_slot_.resize(n, -1);
 }
 
-} // namespace
+void ObsIdAdjacency::reserve_rows(size_t n) {
+  row_offset_.reserve(n + 1);
+  overflow_slot_.reserve(n);
+}
+
+void ObsIdAdjacency::append(size_t row, int id) {
+  assert(row < num_rows());
+  int32_t& slot = overflow_slot_[row];
+  if (slot < 0) {
+    // Last CSR row or beyond the frontier: CSR grows in place (bulk load never hits the arena
+    // for the owner it is sorted by).
+    if (row + 2 >= row_offset_.size()) {
+      row_offset_.resize(row + 2, row_offset_.back());
+      csr_ids_.push_back(id);
+      ++row_offset_.back();
+      return;
+    }
+    // Move the row to the arena so that it stays contiguous.
+    Extent e;
+    e.size = row_offset_[row + 1] - row_offset_[row];
+    e.cap = std::max<uint32_t>(4u, 2u * e.size);
+    e.begin = arena_.size();
+    arena_.resize(arena_.size() + e.cap);
+    std::copy(csr_ids_.begin() + row_offset_[row], csr_ids_.begin() + row_offset_[row + 1],
+              arena_.begin() + static_cast<std::ptrdiff_t>(e.begin));
+    slot = static_cast<int32_t>(overflow_extent_.size());
+    overflow_extent_.push_back(e);
+  }
+  Extent& e = overflow_extent_[static_cast<size_t>(slot)];
+  if (e.size == e.cap) {
+    if (e.begin + e.cap == arena_.size()) {
+      arena_.resize(arena_.size() + e.cap); // last extent: grow in place
+    } else {
+      const uint64_t new_begin = arena_.size();
+      arena_.resize(arena_.size() + 2u * e.cap);
+      std::copy(arena_.begin() + static_cast<std::ptrdiff_t>(e.begin),
+                arena_.begin() + static_cast<std::ptrdiff_t>(e.begin + e.size),
+                arena_.begin() + static_cast<std::ptrdiff_t>(new_begin));
+      e.begin = new_begin;
+    }
+    e.cap *= 2u;
+  }
+  arena_[static_cast<size_t>(e.begin + e.size++)] = id;
+}
+
+void ObsIdAdjacency::compact() {
+  if (overflow_extent_.empty()) {
+    row_offset_.resize(num_rows() + 1, row_offset_.back());
+    return;
+  }
+  const size_t n = num_rows();
+  std::vector<uint32_t> offset(n + 1, 0u);
+  for (size_t r = 0; r < n; ++r)
+    offset[r + 1] = offset[r] + static_cast<uint32_t>(row(r).size());
+  std::vector<int> ids(offset.back());
+  for (size_t r = 0; r < n; ++r) {
+    const ObsIdSpan span = row(r);
+    std::copy(span.begin(), span.end(), ids.begin() + offset[r]);
+  }
+  row_offset_.swap(offset);
+  csr_ids_.swap(ids);
+  std::fill(overflow_slot_.begin(), overflow_slot_.end(), -1);
+  std::vector<Extent>().swap(overflow_extent_);
+  std::vector<int>().swap(arena_);
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// TrackStore
+// ─────────────────────────────────────────────────────────────────────────────
 
 void TrackStore::mark_dirty_image(int image_index) {
   if (image_index < 0 || static_cast<size_t>(image_index) >= dirty_image_mark_.size())
@@ -40,10 +117,9 @@ void TrackStore::mark_dirty_track(int track_id) {
 }
 
 void TrackStore::mark_track_observation_images_dirty(int track_id) {
-  if (track_id < 0 || static_cast<size_t>(track_id) >= track_obs_ids_.size())
+  if (track_id < 0 || static_cast<size_t>(track_id) >= track_obs_.num_rows())
     return;
-  const auto& obs_ids = track_obs_ids_[static_cast<size_t>(track_id)];
-  for (int obs_id : obs_ids) {
+  for (int obs_id : track_obs_.row(static_cast<size_t>(track_id))) {
     if (!is_obs_valid(obs_id))
       continue;
     const int image_index = static_cast<int>(obs_image_id_[static_cast<size_t>(obs_id)]);
@@ -54,16 +130,17 @@ void TrackStore::mark_track_observation_images_dirty(int track_id) {
 void TrackStore::set_num_images(int n) {
   assert(n >= 0);
   num_images_ = n;
-  image_obs_ids_.resize(static_cast<size_t>(n));
+  image_obs_.resize_rows(static_cast<size_t>(n));
   dirty_image_mark_.assign(static_cast<size_t>(n), 0u);
   dirty_images_.clear();
   image_n_tri_.assign(static_cast<size_t>(n), 0);
+  image_undist_camera_.resize(static_cast<size_t>(n), -1);
 }
 
 void TrackStore::reserve_tracks(size_t cap) {
   track_xyz_.reserve(cap * 3);
   track_flags_.reserve(cap);
-  track_obs_ids_.reserve(cap);
+  track_obs_.reserve_rows(cap);
   dirty_track_mark_.reserve(cap);
   retri_pending_mark_.reserve(cap);
   track_last_tri_epoch_.reserve(cap);
@@ -85,7 +162,7 @@ int TrackStore::add_track(float x, float y, float z) {
   track_xyz_.push_back(y);
   track_xyz_.push_back(z);
   track_flags_.push_back(track_flags::kAlive);
-  track_obs_ids_.emplace_back();
+  track_obs_.add_row();
   dirty_track_mark_.push_back(0u);
   retri_pending_mark_.push_back(0u);
   track_last_tri_epoch_.push_back(0u); // 0 < global_pose_epoch_(=1) → stale by default
@@ -109,9 +186,9 @@ int TrackStore::add_observation(int track_id, uint32_t image_index, uint32_t fea
   obs_flags_.push_back(obs_flags::kAlive);
   ++n_valid_obs_;
 
-  track_obs_ids_[static_cast<size_t>(track_id)].push_back(obs_id);
-  if (static_cast<size_t>(image_index) < image_obs_ids_.size())
-    image_obs_ids_[image_index].push_back(obs_id);
+  track_obs_.append(static_cast<size_t>(track_id), obs_id);
+  if (static_cast<size_t>(image_index) < image_obs_.num_rows())
+    image_obs_.append(image_index, obs_id);
 
   // If the parent track already has XYZ, this new observation immediately contributes to n_tri.
   if (static_cast<size_t>(image_index) < image_n_tri_.size() &&
@@ -189,7 +266,7 @@ void TrackStore::set_track_xyz(int track_id, float x, float y, float z) {
       // Pure XYZ value updates (BA refinement) do NOT alter the pyramid score.
       ++tri_status_epoch_;
       mark_track_observation_images_dirty(track_id);
-      for (int obs_id : track_obs_ids_[static_cast<size_t>(track_id)]) {
+      for (int obs_id : track_obs_.row(static_cast<size_t>(track_id))) {
         if (!is_obs_valid(obs_id))
           continue;
         const int im = static_cast<int>(obs_image_id_[static_cast<size_t>(obs_id)]);
@@ -219,7 +296,7 @@ void TrackStore::clear_track_xyz(int track_id) {
     mark_dirty_track(track_id);
     mark_track_observation_images_dirty(track_id);
     // Decrement image_n_tri_ for all valid observers of this track.
-    for (int obs_id : track_obs_ids_[static_cast<size_t>(track_id)]) {
+    for (int obs_id : track_obs_.row(static_cast<size_t>(track_id))) {
       if (!is_obs_valid(obs_id))
         continue;
       const int im = static_cast<int>(obs_image_id_[static_cast<size_t>(obs_id)]);
@@ -301,16 +378,170 @@ void TrackStore::clear_dirty_sets() {
   dirty_tracks_.clear();
 }
 
-const std::vector<int>& TrackStore::track_all_obs_ids_view(int track_id) const {
-  if (track_id < 0 || static_cast<size_t>(track_id) >= track_obs_ids_.size())
-    return empty_obs_id_view();
-  return track_obs_ids_[static_cast<size_t>(track_id)];
+TrackStoreSchedulerState TrackStore::scheduler_state() const {
+  TrackStoreSchedulerState s;
+  s.obs_epoch = obs_epoch_;
+  s.xyz_epoch = xyz_epoch_;
+  s.registration_epoch = registration_epoch_;
+  s.tri_status_epoch = tri_status_epoch_;
+  s.global_pose_epoch = global_pose_epoch_;
+  s.track_last_tri_epoch = track_last_tri_epoch_;
+  s.retri_pending = retri_pending_ids_;
+  s.dirty_images = dirty_images_;
+  s.dirty_tracks = dirty_tracks_;
+  return s;
+}
+
+void TrackStore::restore_scheduler_state(const TrackStoreSchedulerState& state) {
+  obs_epoch_ = state.obs_epoch;
+  xyz_epoch_ = state.xyz_epoch;
+  registration_epoch_ = state.registration_epoch;
+  tri_status_epoch_ = state.tri_status_epoch;
+  global_pose_epoch_ = state.global_pose_epoch;
+  if (state.track_last_tri_epoch.size() == track_last_tri_epoch_.size())
+    track_last_tri_epoch_ = state.track_last_tri_epoch;
+
+  // The queue is restored verbatim (duplicates included); a track is marked as queued when it is
+  // in the queue and still flagged, which is exactly the invariant set_track_retriangulation_flag
+  // maintains between drains.
+  drain_retriangulation_pending(nullptr);
+  for (int tid : state.retri_pending) {
+    if (tid < 0 || static_cast<size_t>(tid) >= retri_pending_mark_.size())
+      continue;
+    retri_pending_ids_.push_back(tid);
+    if (track_flags_[static_cast<size_t>(tid)] & track_flags::kNeedsRetriangulation)
+      retri_pending_mark_[static_cast<size_t>(tid)] = 1;
+  }
+  clear_dirty_sets();
+  for (int im : state.dirty_images)
+    mark_dirty_image(im);
+  for (int tid : state.dirty_tracks)
+    mark_dirty_track(tid);
+}
+
+void TrackStore::compact() {
+  track_obs_.compact();
+  image_obs_.compact();
+}
+
+int64_t TrackStore::refresh_undistorted_cache(const std::vector<camera::Intrinsics>& cameras,
+                                              const std::vector<int>& image_to_camera_index,
+                                              const UndistortCacheTolerance& tol) {
+  const size_t n_cams = cameras.size();
+  const size_t n_obs = num_observations();
+  const size_t n_cached_obs = obs_xn_.size();
+  image_undist_camera_.resize(static_cast<size_t>(num_images_), -1);
+  undist_camera_K_.resize(n_cams);
+  undist_camera_valid_.resize(n_cams, 0u);
+
+  std::vector<uint8_t> stale(n_cams, 0u);
+  for (size_t c = 0; c < n_cams; ++c) {
+    const camera::IntrinsicsDelta d = cameras[c].delta(undist_camera_K_[c]);
+    stale[c] = !undist_camera_valid_[c] || d.focal_rel > tol.focal_rel || d.pp_px > tol.pp_px ||
+               d.distortion > tol.distortion;
+  }
+  auto camera_of = [&](size_t im) -> int {
+    if (im >= image_to_camera_index.size())
+      return -1;
+    const int c = image_to_camera_index[im];
+    return (c >= 0 && static_cast<size_t>(c) < n_cams) ? c : -1;
+  };
+
+  // Observations to recompute, grouped by camera: every observation of an image whose camera is
+  // stale (or whose camera assignment changed), and observations added since the last refresh.
+  std::vector<std::vector<int>> todo(n_cams);
+  std::vector<uint8_t> image_redo(static_cast<size_t>(num_images_), 0u);
+  for (size_t im = 0; im < image_undist_camera_.size(); ++im) {
+    const int c = camera_of(im);
+    if (c < 0) {
+      image_undist_camera_[im] = -1;
+      continue;
+    }
+    if (!stale[static_cast<size_t>(c)] && image_undist_camera_[im] == c)
+      continue;
+    image_redo[im] = 1u;
+    image_undist_camera_[im] = c;
+    const ObsIdSpan ids = image_obs_.row(im);
+    auto& list = todo[static_cast<size_t>(c)];
+    for (int obs_id : ids)
+      if (static_cast<size_t>(obs_id) < n_obs)
+        list.push_back(obs_id);
+  }
+  for (size_t o = n_cached_obs; o < n_obs; ++o) {
+    const size_t im = obs_image_id_[o];
+    const int c = im < image_redo.size() ? image_undist_camera_[im] : -1;
+    if (c >= 0 && !image_redo[im])
+      todo[static_cast<size_t>(c)].push_back(static_cast<int>(o));
+  }
+  obs_xn_.resize(n_obs, 0.0);
+  obs_yn_.resize(n_obs, 0.0);
+
+  constexpr int64_t kChunk = 4096;
+  int64_t n_done = 0;
+  for (size_t c = 0; c < n_cams; ++c) {
+    const std::vector<int>& ids = todo[c];
+    if (ids.empty()) {
+      if (stale[c] && cameras[c].fx > 0.0) {
+        undist_camera_K_[c] = cameras[c];
+        undist_camera_valid_[c] = 1u;
+      }
+      continue;
+    }
+    const camera::Intrinsics& K = cameras[c];
+    if (!(K.fx > 0.0 && K.fy > 0.0)) {
+      undist_camera_valid_[c] = 0u;
+      continue;
+    }
+    const int64_t n = static_cast<int64_t>(ids.size());
+    const int64_t n_chunks = (n + kChunk - 1) / kChunk;
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t ch = 0; ch < n_chunks; ++ch) {
+      const int64_t end = std::min(n, (ch + 1) * kChunk);
+      for (int64_t i = ch * kChunk; i < end; ++i) {
+        const size_t o = static_cast<size_t>(ids[static_cast<size_t>(i)]);
+        double u, v;
+        camera::undistort_point(K, obs_u_[o], obs_v_[o], &u, &v);
+        obs_xn_[o] = (u - K.cx) / K.fx;
+        obs_yn_[o] = (v - K.cy) / K.fy;
+      }
+    }
+    undist_camera_K_[c] = K;
+    undist_camera_valid_[c] = 1u;
+    n_done += n;
+  }
+  return n_done;
+}
+
+void TrackStore::invalidate_undistorted_cache(int camera_index) {
+  if (camera_index < 0) {
+    std::fill(undist_camera_valid_.begin(), undist_camera_valid_.end(), 0u);
+    return;
+  }
+  if (static_cast<size_t>(camera_index) < undist_camera_valid_.size())
+    undist_camera_valid_[static_cast<size_t>(camera_index)] = 0u;
+}
+
+bool TrackStore::undistorted_cache_matches(int image_index, const camera::Intrinsics& K,
+                                           const UndistortCacheTolerance& tol) const {
+  if (image_index < 0 || static_cast<size_t>(image_index) >= image_undist_camera_.size())
+    return false;
+  const int cam = image_undist_camera_[static_cast<size_t>(image_index)];
+  if (cam < 0 || !undist_camera_valid_[static_cast<size_t>(cam)])
+    return false;
+  const camera::IntrinsicsDelta d = K.delta(undist_camera_K_[static_cast<size_t>(cam)]);
+  return d.focal_rel <= tol.focal_rel && d.pp_px <= tol.pp_px && d.distortion <= tol.distortion;
+}
+
+ObsIdSpan TrackStore::track_all_obs_ids_view(int track_id) const {
+  if (track_id < 0 || static_cast<size_t>(track_id) >= track_obs_.num_rows())
+    return ObsIdSpan();
+  return track_obs_.row(static_cast<size_t>(track_id));
 }
 
-const std::vector<int>& TrackStore::image_all_obs_ids_view(int image_index) const {
-  if (image_index < 0 || static_cast<size_t>(image_index) >= image_obs_ids_.size())
-    return empty_obs_id_view();
-  return image_obs_ids_[static_cast<size_t>(image_index)];
+ObsIdSpan TrackStore::image_all_obs_ids_view(int image_index) const {
+  if (image_index < 0 || static_cast<size_t>(image_index) >= image_obs_.num_rows())
+    return ObsIdSpan();
+  return image_obs_.row(static_cast<size_t>(image_index));
 }
 
 uint32_t TrackStore::obs_image_index(int obs_id) const {
@@ -347,11 +578,11 @@ bool TrackStore::track_needs_retriangulation(int track_id) const {
 int TrackStore::get_track_observations(int track_id, std::vector<Observation>* obs_out) const {
   assert(obs_out);
   obs_out->clear();
-  if (track_id < 0 || static_cast<size_t>(track_id) >= track_obs_ids_.size())
+  if (track_id < 0 || static_cast<size_t>(track_id) >= track_obs_.num_rows())
     return 0;
   if (!is_track_valid(track_id))
     return 0;
-  const std::vector<int>& ids = track_obs_ids_[static_cast<size_t>(track_id)];
+  const ObsIdSpan ids = track_obs_.row(static_cast<size_t>(track_id));
   for (int obs_id : ids) {
     if (!is_obs_valid(obs_id))
       continue;
@@ -365,11 +596,11 @@ int TrackStore::get_track_observations(int track_id, std::vector<Observation>* o
 int TrackStore::get_track_obs_ids(int track_id, std::vector<int>* obs_ids_out) const {
   assert(obs_ids_out);
   obs_ids_out->clear();
-  if (track_id < 0 || static_cast<size_t>(track_id) >= track_obs_ids_.size())
+  if (track_id < 0 || static_cast<size_t>(track_id) >= track_obs_.num_rows())
     return 0;
   if (!is_track_valid(track_id))
     return 0;
-  const std::vector<int>& ids = track_obs_ids_[static_cast<size_t>(track_id)];
+  const ObsIdSpan ids = track_obs_.row(static_cast<size_t>(track_id));
   for (int obs_id : ids) {
     if (is_obs_valid(obs_id))
       obs_ids_out->push_back(obs_id);
@@ -380,12 +611,13 @@ int TrackStore::get_track_obs_ids(int track_id, std::vector<int>* obs_ids_out) c
 int TrackStore::get_track_all_obs_ids(int track_id, std::vector<int>* obs_ids_out) const {
   assert(obs_ids_out);
   obs_ids_out->clear();
-  if (track_id < 0 || static_cast<size_t>(track_id) >= track_obs_ids_.size())
+  if (track_id < 0 || static_cast<size_t>(track_id) >= track_obs_.num_rows())
     return 0;
   // Structural access: return every obs id for this track (alive + deleted).
   // Callers that must ignore mark_track_deleted tracks should check is_track_valid() first.
   // (mark_observation_deleted does NOT clear track kAlive — only mark_track_deleted does.)
-  *obs_ids_out = track_obs_ids_[static_cast<size_t>(track_id)];
+  const ObsIdSpan ids = track_obs_.row(static_cast<size_t>(track_id));
+  obs_ids_out->assign(ids.begin(), ids.end());
   return static_cast<int>(obs_ids_out->size());
 }
 
@@ -393,9 +625,9 @@ int TrackStore::get_image_observation_indices(int image_index,
                                               std::vector<int>* obs_indices_out) const {
   assert(obs_indices_out);
   obs_indices_out->clear();
-  if (image_index < 0 || static_cast<size_t>(image_index) >= image_obs_ids_.size())
+  if (image_index < 0 || static_cast<size_t>(image_index) >= image_obs_.num_rows())
     return 0;
-  const std::vector<int>& ids = image_obs_ids_[static_cast<size_t>(image_index)];
+  const ObsIdSpan ids = image_obs_.row(static_cast<size_t>(image_index));
   for (int obs_id : ids) {
     if (is_obs_valid(obs_id))
       obs_indices_out->push_back(obs_id);
@@ -406,9 +638,10 @@ int TrackStore::get_image_observation_indices(int image_index,
 int TrackStore::get_image_all_obs_ids(int image_index, std::vector<int>* obs_ids_out) const {
   assert(obs_ids_out);
   obs_ids_out->clear();
-  if (image_index < 0 || static_cast<size_t>(image_index) >= image_obs_ids_.size())
+  if (image_index < 0 || static_cast<size_t>(image_index) >= image_obs_.num_rows())
     return 0;
-  *obs_ids_out = image_obs_ids_[static_cast<size_t>(image_index)];
+  const ObsIdSpan ids = image_obs_.row(static_cast<size_t>(image_index));
+  obs_ids_out->assign(ids.begin(), ids.end());
   return static_cast<int>(obs_ids_out->size());
 }
 
@@ -469,7 +702,7 @@ void TrackStore::mark_track_deleted(int track_id) {
       --num_triangulated_;
       ++tri_status_epoch_;
       // Decrement image_n_tri_ for all valid observers.
-      for (int obs_id : track_obs_ids_[static_cast<size_t>(track_id)]) {
+      for (int obs_id : track_obs_.row(static_cast<size_t>(track_id))) {
         if (!is_obs_valid(obs_id))
           continue;
         const int im = static_cast<int>(obs_image_id_[static_cast<size_t>(obs_id)]);
@@ -578,7 +811,7 @@ void TrackStore::rebuild_image_n_tri() {
     const int tid = static_cast<int>(t);
     if (!is_track_valid(tid) || !track_has_triangulated_xyz(tid))
       continue;
-    for (int obs_id : track_obs_ids_[t]) {
+    for (int obs_id : track_obs_.row(t)) {
       if (!is_obs_valid(obs_id))
         continue;
       const int im = static_cast<int>(obs_image_id_[static_cast<size_t>(obs_id)]);
@@ -11,6 +11,15 @@
  * - Delete: set flag bits only (no array shift). track bit0=alive, bit1=needs_retriangulation;
  *           obs bit0=alive.
  * - Reverse index: image_index → list of observation indices (image_index is 0..n-1).
+ * - Adjacency (track → obs ids, image → obs ids) is CSR: one offsets array + one flat id array.
+ *   Observations added later go to an append-overflow arena (the owner's list is moved there on
+ *   its first append); compact() folds the arena back into CSR.  Appends to the last owner (the
+ *   usual track-by-track load order) extend CSR in place.  Views are spans and are invalidated
+ *   by add_observation / compact().
+ * - Undistortion cache: obs_xn_/obs_yn_ hold K⁻¹·undistort(u, v) per observation (SoA, double,
+ *   bit-identical to undistorting on the fly).  It is refreshed per camera by
+ *   refresh_undistorted_cache() and only recomputed for cameras whose intrinsics moved beyond a
+ *   tolerance since the last refresh.
  *
  * Usage
  * ─────
@@ -21,6 +30,7 @@
  *   int t = store.add_track(x, y, z);
  *   store.add_observation(t, image_index, feat_id, u, v, scale);  // image_index in [0, n_images)
  *   store.get_image_track_observations(image_index, ...);
+ *   store.compact();  // after bulk load: fold overflow into CSR
  */
 
 #pragma once
@@ -32,6 +42,8 @@
 #include <cstdint>
 #include <vector>
 
+#include "../camera/camera_types.h"
+
 namespace insight {
 namespace sfm {
 
@@ -73,6 +85,91 @@ struct Observation {
   float scale = 1.f;
 };
 
+// ─────────────────────────────────────────────────────────────────────────────
+// ObsIdSpan / ObsIdAdjacency (CSR owner → observation ids)
+// ─────────────────────────────────────────────────────────────────────────────
+
+/// Read-only contiguous view of observation ids (C++17 stand-in for std::span<const int>).
+class ObsIdSpan {
+public:
+  ObsIdSpan() = default;
+  ObsIdSpan(const int* data, size_t size) : data_(data), size_(size) {}
+
+  const int* begin() const { return data_; }
+  const int* end() const { return data_ + size_; }
+  const int* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  int operator[](size_t i) const { return data_[i]; }
+
+private:
+  const int* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+/// Rows of observation ids in CSR form plus an append-overflow arena.
+/// Rows [0, row_offset_.size()-1) are CSR rows; rows past that frontier are empty until appended
+/// to, so appends in non-decreasing row order only extend CSR.  Any other append moves the row to
+/// one contiguous arena extent (doubling when full) until the next compact().
+class ObsIdAdjacency {
+public:
+  size_t num_rows() const { return overflow_slot_.size(); }
+  /// Grow with empty rows, or shrink (compacts first).
+  void resize_rows(size_t n);
+  void reserve_rows(size_t n);
+  void add_row() { overflow_slot_.push_back(-1); }
+  void append(size_t row, int id);
+  ObsIdSpan row(size_t r) const {
+    const int32_t slot = overflow_slot_[r];
+    if (slot >= 0) {
+      const Extent& e = overflow_extent_[static_cast<size_t>(slot)];
+      return ObsIdSpan(arena_.data() + e.begin, e.size);
+    }
+    if (r + 1 >= row_offset_.size())
+      return ObsIdSpan();
+    return ObsIdSpan(csr_ids_.data() + row_offset_[r], row_offset_[r + 1] - row_offset_[r]);
+  }
+  /// Rebuild CSR from all rows and release the arena.
+  void compact();
+  /// Number of rows currently in the overflow arena.
+  size_t num_overflow_rows() const { return overflow_extent_.size(); }
+
+private:
+  struct Extent {
+    uint64_t begin = 0;
+    uint32_t size = 0;
+    uint32_t cap = 0;
+  };
+  std::vector<uint32_t> row_offset_{0u}; ///< CSR offsets into csr_ids_ (back() == csr_ids_.size())
+  std::vector<int> csr_ids_;
+  std::vector<int32_t> overflow_slot_; ///< per row: index into overflow_extent_, -1 = not in arena
+  std::vector<Extent> overflow_extent_;
+  std::vector<int> arena_;
+};
+
+/// Intrinsics drift (camera::IntrinsicsDelta units) that keeps a camera's cached undistorted
+/// coordinates; anything larger triggers a recompute in refresh_undistorted_cache().
+struct UndistortCacheTolerance {
+  double focal_rel = 1e-6;
+  double pp_px = 1e-3;
+  double distortion = 1e-6;
+};
+
+/// Epoch counters and pending queues that drive the incremental schedulers but are not part of
+/// the track/observation data.  Captured into a checkpoint so that a resumed run sees the same
+/// cache watermarks (ResectionScoreCache) and retriangulation backlog as the interrupted one.
+struct TrackStoreSchedulerState {
+  uint64_t obs_epoch = 0;
+  uint64_t xyz_epoch = 0;
+  uint64_t registration_epoch = 0;
+  uint64_t tri_status_epoch = 0;
+  uint64_t global_pose_epoch = 1;
+  std::vector<uint64_t> track_last_tri_epoch; ///< Per track (see is_track_tri_stale).
+  std::vector<int> retri_pending;             ///< Undrained retriangulation queue, in order.
+  std::vector<int> dirty_images;              ///< Unconsumed dirty image ids, in order.
+  std::vector<int> dirty_tracks;              ///< Unconsumed dirty track ids, in order.
+};
+
 // ─────────────────────────────────────────────────────────────────────────────
 // TrackStore
 // ─────────────────────────────────────────────────────────────────────────────
@@ -96,6 +193,14 @@ public:
   int add_observation(int track_id, uint32_t image_index, uint32_t feature_id, float u, float v,
                       float scale = 1.f);
 
+  /// Fold observation lists appended since the last compact() back into CSR (O(N_obs)).
+  /// Call after bulk loading/building; invalidates outstanding obs-id views.
+  void compact();
+  /// True when no track/image list lives in the overflow arena.
+  bool is_compact() const {
+    return track_obs_.num_overflow_rows() == 0 && image_obs_.num_overflow_rows() == 0;
+  }
+
   /// Query track
   bool is_track_valid(int track_id) const;
   bool track_has_triangulated_xyz(int track_id) const;
@@ -164,12 +269,20 @@ public:
   /// Clear all pending dirty ids without consuming.
   void clear_dirty_sets();
 
+  /// Snapshot epochs, per-track last-tri epochs and the pending/dirty queues (checkpointing).
+  TrackStoreSchedulerState scheduler_state() const;
+  /// Overwrite epochs and queues with a saved snapshot.  Call after the tracks, observations and
+  /// flags have been reloaded: loading bumps the epochs and enqueues tracks as a side effect.
+  /// track_last_tri_epoch is applied only when its size matches num_tracks().
+  void restore_scheduler_state(const TrackStoreSchedulerState& state);
+
   /// Zero-copy read-only views over structural observation lists.
   /// These return all observation ids for the owner (alive + deleted). Callers that only want
   /// alive observations must filter with is_obs_valid(). They are intended for query engines
-  /// that want to avoid repeatedly materializing temporary vectors.
-  const std::vector<int>& track_all_obs_ids_view(int track_id) const;
-  const std::vector<int>& image_all_obs_ids_view(int image_index) const;
+  /// that want to avoid repeatedly materializing temporary vectors.  Valid until the next
+  /// add_observation() / compact().
+  ObsIdSpan track_all_obs_ids_view(int track_id) const;
+  ObsIdSpan image_all_obs_ids_view(int image_index) const;
 
   /// Zero-copy views over flat SoA arrays.  Avoids function-call + assert overhead of the
   /// scalar accessors (obs_image_index, get_track_xyz) in hot loops (e.g. outlier rejection).
@@ -206,6 +319,38 @@ public:
   /// find kRestorable deleted observations without a full store-wide scan.
   int get_image_all_obs_ids(int image_index, std::vector<int>* obs_ids_out) const;
 
+  // ── Undistorted normalised coordinate cache (obs_xn_ / obs_yn_) ─────────
+  /// Recompute cached coordinates for cameras that are new or whose intrinsics moved beyond
+  /// \p tol since their last refresh, plus observations added since the last call.  Batched
+  /// camera::undistort_point (double, same result as undistorting on the fly) per camera,
+  /// parallel over chunks.  O(num_images) when nothing changed.  Returns the number of
+  /// observations recomputed.
+  int64_t refresh_undistorted_cache(const std::vector<camera::Intrinsics>& cameras,
+                                    const std::vector<int>& image_to_camera_index,
+                                    const UndistortCacheTolerance& tol = {});
+  /// Drop the cache of one camera (-1 = all cameras).
+  void invalidate_undistorted_cache(int camera_index = -1);
+  /// True when the image's observations are cached with intrinsics within \p tol of \p K
+  /// (for callers that hold a single camera rather than the full camera list).
+  bool undistorted_cache_matches(int image_index, const camera::Intrinsics& K,
+                                 const UndistortCacheTolerance& tol = {}) const;
+  /// Normalised undistorted coordinates of an observation (alive or deleted).  Returns false when
+  /// the observation (or its image) is not cached; callers then undistort with the current
+  /// intrinsics.
+  bool obs_undistorted_normalized(int obs_id, double* xn, double* yn) const {
+    if (obs_id < 0 || static_cast<size_t>(obs_id) >= obs_xn_.size())
+      return false;
+    const uint32_t im = obs_image_id_[static_cast<size_t>(obs_id)];
+    if (im >= image_undist_camera_.size())
+      return false;
+    const int cam = image_undist_camera_[im];
+    if (cam < 0 || !undist_camera_valid_[static_cast<size_t>(cam)])
+      return false;
+    *xn = obs_xn_[static_cast<size_t>(obs_id)];
+    *yn = obs_yn_[static_cast<size_t>(obs_id)];
+    return true;
+  }
+
   /// Observation by global index
   bool is_obs_valid(int obs_id) const;
   int obs_track_id(int obs_id) const;
@@ -241,16 +386,20 @@ private:
   int num_images_ = 0;
   std::vector<float> track_xyz_;
   std::vector<uint8_t> track_flags_;
-  std::vector<std::vector<int>>
-      track_obs_ids_; // per-track list of global obs indices (for iteration)
+  ObsIdAdjacency track_obs_; // per-track list of global obs indices (for iteration)
 
   std::vector<int> obs_track_id_;
   std::vector<uint32_t> obs_image_id_;
   std::vector<uint32_t> obs_feature_id_;
   std::vector<float> obs_u_, obs_v_, obs_scale_;
   std::vector<uint8_t> obs_flags_;
+  std::vector<double> obs_xn_, obs_yn_; ///< Undistorted normalised coords (last refresh).
+
+  std::vector<int> image_undist_camera_;           ///< Camera index the image was cached with, -1 = none.
+  std::vector<camera::Intrinsics> undist_camera_K_; ///< Intrinsics snapshot per cached camera.
+  std::vector<uint8_t> undist_camera_valid_;
 
-  std::vector<std::vector<int>> image_obs_ids_; // image_index -> list of global obs indices
+  ObsIdAdjacency image_obs_; // image_index -> list of global obs indices
 
   int num_triangulated_ = 0; ///< Maintained by set_track_xyz (+1 on first XYZ) and mark_track_deleted (-1 if triangulated)
   int n_valid_obs_ = 0;      ///< Maintained incrementally: +1 in add_observation, -1 in mark_observation_deleted/mark_observation_deleted_restorable..
@@ -0,0 +1,75 @@
+/**
+ * @file  track_test_pairs.h
+ * @brief Synthetic match pairs shared by the track union-find and external track builder tests.
+ */
+
+#pragma once
+
+#ifndef TRACK_TEST_PAIRS_H
+#define TRACK_TEST_PAIRS_H
+
+#include "track_union_find.h"
+
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace insight {
+namespace sfm {
+namespace test {
+
+struct PairData {
+  uint32_t image1, image2;
+  std::vector<TrackInlierMatch> matches;
+};
+
+/**
+ * Random pairs over few images and few features per image, so that many matches hit the
+ * same-image conflict rule and many matches contend for the same components.  Coordinates
+ * encode (image, feature, pair) so first-seen coords can be checked exactly.
+ */
+inline std::vector<PairData> make_pairs(int num_images, int num_pairs, int features_per_image,
+                                        int matches_per_pair, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> img(0, num_images - 1);
+  std::uniform_int_distribution<int> feat(0, features_per_image - 1);
+  std::vector<PairData> pairs;
+  for (int p = 0; p < num_pairs; ++p) {
+    PairData d;
+    d.image1 = static_cast<uint32_t>(img(rng));
+    do {
+      d.image2 = static_cast<uint32_t>(img(rng));
+    } while (d.image2 == d.image1);
+    if (d.image1 > d.image2) std::swap(d.image1, d.image2);
+    for (int j = 0; j < matches_per_pair; ++j) {
+      TrackInlierMatch m;
+      m.idx1 = static_cast<uint16_t>(feat(rng));
+      m.idx2 = static_cast<uint16_t>(feat(rng));
+      m.x1 = static_cast<float>(d.image1 * 1000 + m.idx1);
+      m.y1 = static_cast<float>(p);
+      m.x2 = static_cast<float>(d.image2 * 1000 + m.idx2);
+      m.y2 = static_cast<float>(p);
+      m.s1 = m.s2 = 1.f;
+      d.matches.push_back(m);
+    }
+    pairs.push_back(std::move(d));
+  }
+  return pairs;
+}
+
+/// Non-owning views of pairs[begin, end) in order.
+inline std::vector<TrackPairMatches> as_views(const std::vector<PairData>& pairs, size_t begin,
+                                              size_t end) {
+  std::vector<TrackPairMatches> views;
+  for (size_t p = begin; p < end; ++p)
+    views.push_back({pairs[p].image1, pairs[p].image2, pairs[p].matches.data(),
+                     pairs[p].matches.size()});
+  return views;
+}
+
+}  // namespace test
+}  // namespace sfm
+}  // namespace insight
+
+#endif  // TRACK_TEST_PAIRS_H
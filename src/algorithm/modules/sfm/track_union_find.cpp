@@ -0,0 +1,250 @@
+/**
+ * @file  track_union_find.cpp
+ * @brief TrackUnionFind: serial merge and deterministic-reservation parallel batch merge.
+ */
+
+#include "track_union_find.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+namespace insight {
+namespace sfm {
+
+namespace {
+
+constexpr int kNoReservation = std::numeric_limits<int>::max();
+/// Pending matches examined per reservation round.
+constexpr size_t kRoundWindow = size_t(1) << 20;
+/// Matches per merge_range call (keeps match sequence numbers within int).
+constexpr size_t kMaxRangeMatches = size_t(1) << 30;
+
+enum MatchState : uint8_t { kDone = 0, kWaiting = 1, kCommitted = 2 };
+
+void reserve_min(std::atomic<int>& slot, int seq) {
+  int cur = slot.load(std::memory_order_relaxed);
+  while (seq < cur && !slot.compare_exchange_weak(cur, seq, std::memory_order_relaxed)) {
+  }
+}
+
+}  // namespace
+
+void TrackUnionFind::reserve(size_t num_nodes) {
+  node_id_.reserve(num_nodes);
+  parent_.reserve(num_nodes);
+  component_size_.reserve(num_nodes);
+  component_images_.reserve(num_nodes);
+  node_u_.reserve(num_nodes);
+  node_v_.reserve(num_nodes);
+  node_s_.reserve(num_nodes);
+}
+
+bool TrackUnionFind::components_overlap_images(const std::vector<uint32_t>& a,
+                                               const std::vector<uint32_t>& b) {
+  size_t i = 0, j = 0;
+  while (i < a.size() && j < b.size()) {
+    if (a[i] == b[j]) return true;
+    if (a[i] < b[j]) ++i; else ++j;
+  }
+  return false;
+}
+
+int TrackUnionFind::get_or_create(uint64_t key, float u, float v, float s) {
+  auto it = node_id_.find(key);
+  if (it != node_id_.end())
+    return it->second;
+  const int id = static_cast<int>(parent_.size());
+  node_id_[key] = id;
+  parent_.push_back(id);
+  component_size_.push_back(1);
+  component_images_.push_back({image_index_from_track_node_key(key)});
+  node_u_.push_back(u);
+  node_v_.push_back(v);
+  node_s_.push_back(s);
+  return id;
+}
+
+// Iterative path compression (avoids stack overflow on deep chains).
+int TrackUnionFind::find_by_id(int i) {
+  int root = i;
+  while (parent_[static_cast<size_t>(root)] != root)
+    root = parent_[static_cast<size_t>(root)];
+  while (parent_[static_cast<size_t>(i)] != root) {
+    int next = parent_[static_cast<size_t>(i)];
+    parent_[static_cast<size_t>(i)] = root;
+    i = next;
+  }
+  return root;
+}
+
+void TrackUnionFind::unite_roots(int a, int b) {
+  // Union by size: attach smaller to larger.
+  if (component_size_[static_cast<size_t>(a)] < component_size_[static_cast<size_t>(b)])
+    std::swap(a, b);
+
+  parent_[static_cast<size_t>(b)] = a;
+  component_size_[static_cast<size_t>(a)] += component_size_[static_cast<size_t>(b)];
+
+  auto& dst = component_images_[static_cast<size_t>(a)];
+  auto& src = component_images_[static_cast<size_t>(b)];
+  std::vector<uint32_t> merged;
+  merged.reserve(dst.size() + src.size());
+  std::merge(dst.begin(), dst.end(), src.begin(), src.end(), std::back_inserter(merged));
+  dst = std::move(merged);
+  src.clear();
+  src.shrink_to_fit();
+}
+
+bool TrackUnionFind::merge_keys(uint64_t k1, uint64_t k2,
+                                float u1, float v1, float s1,
+                                float u2, float v2, float s2) {
+  int id1 = get_or_create(k1, u1, v1, s1);
+  int id2 = get_or_create(k2, u2, v2, s2);
+  int a = find_by_id(id1);
+  int b = find_by_id(id2);
+  if (a == b) return true;
+
+  if (components_overlap_images(component_images_[static_cast<size_t>(a)],
+                                component_images_[static_cast<size_t>(b)]))
+    return false;
+
+  unite_roots(a, b);
+  return true;
+}
+
+TrackMergeStats TrackUnionFind::merge_pairs(const std::vector<TrackPairMatches>& pairs) {
+  TrackMergeStats total;
+  size_t begin = 0;
+  while (begin < pairs.size()) {
+    size_t end = begin;
+    size_t n = 0;
+    do {
+      n += pairs[end].num_matches;
+      ++end;
+    } while (end < pairs.size() && n + pairs[end].num_matches <= kMaxRangeMatches);
+    const TrackMergeStats s = merge_range(pairs, begin, end);
+    total.merged += s.merged;
+    total.rejected += s.rejected;
+    total.rounds += s.rounds;
+    begin = end;
+  }
+  return total;
+}
+
+TrackMergeStats TrackUnionFind::merge_range(const std::vector<TrackPairMatches>& pairs,
+                                            size_t begin, size_t end) {
+  TrackMergeStats stats;
+  const int num_pairs = static_cast<int>(end - begin);
+  std::vector<size_t> offset(static_cast<size_t>(num_pairs) + 1, 0);
+  for (int p = 0; p < num_pairs; ++p)
+    offset[static_cast<size_t>(p) + 1] = offset[static_cast<size_t>(p)] + pairs[begin + p].num_matches;
+  const size_t m = offset.back();
+  if (m == 0)
+    return stats;
+
+  // ── 1. Node ids: parallel lookup of existing nodes, serial creation in match order ──
+  std::vector<int> id1(m), id2(m);
+#pragma omp parallel for schedule(dynamic, 16)
+  for (int p = 0; p < num_pairs; ++p) {
+    const TrackPairMatches& pm = pairs[begin + static_cast<size_t>(p)];
+    const size_t o = offset[static_cast<size_t>(p)];
+    for (size_t j = 0; j < pm.num_matches; ++j) {
+      const auto it1 = node_id_.find(track_node_key(pm.image1_index, pm.matches[j].idx1));
+      const auto it2 = node_id_.find(track_node_key(pm.image2_index, pm.matches[j].idx2));
+      id1[o + j] = it1 == node_id_.end() ? -1 : it1->second;
+      id2[o + j] = it2 == node_id_.end() ? -1 : it2->second;
+    }
+  }
+  for (int p = 0; p < num_pairs; ++p) {
+    const TrackPairMatches& pm = pairs[begin + static_cast<size_t>(p)];
+    const size_t o = offset[static_cast<size_t>(p)];
+    for (size_t j = 0; j < pm.num_matches; ++j) {
+      const TrackInlierMatch& im = pm.matches[j];
+      if (id1[o + j] < 0)
+        id1[o + j] = get_or_create(track_node_key(pm.image1_index, im.idx1), im.x1, im.y1, im.s1);
+      if (id2[o + j] < 0)
+        id2[o + j] = get_or_create(track_node_key(pm.image2_index, im.idx2), im.x2, im.y2, im.s2);
+    }
+  }
+
+  if (reservation_capacity_ < parent_.size()) {
+    reservation_capacity_ = std::max(parent_.size(), reservation_capacity_ * 2);
+    reservation_.reset(new std::atomic<int>[reservation_capacity_]);
+    for (size_t i = 0; i < reservation_capacity_; ++i)
+      reservation_[i].store(kNoReservation, std::memory_order_relaxed);
+  }
+
+  // ── 2. Unions: deterministic reservations over a window of pending matches ──
+  std::vector<int> window;
+  window.reserve(std::min(m, kRoundWindow));
+  std::vector<int> root_a(std::min(m, kRoundWindow)), root_b(std::min(m, kRoundWindow));
+  std::vector<uint8_t> state(std::min(m, kRoundWindow));
+  size_t next = 0;
+  int64_t merged = 0, rejected = 0;
+  std::atomic<int>* res = reservation_.get();
+
+  while (next < m || !window.empty()) {
+    while (window.size() < kRoundWindow && next < m)
+      window.push_back(static_cast<int>(next++));
+    const int w = static_cast<int>(window.size());
+
+    // Reserve: accepted/rejected matches are final regardless of earlier pending matches
+    // (components only grow), the rest bid for both roots with their sequence number.
+#pragma omp parallel for schedule(static) reduction(+:merged,rejected)
+    for (int t = 0; t < w; ++t) {
+      const int e = window[static_cast<size_t>(t)];
+      const int a = find_root(id1[static_cast<size_t>(e)]);
+      const int b = find_root(id2[static_cast<size_t>(e)]);
+      if (a == b) {
+        state[static_cast<size_t>(t)] = kDone;
+        ++merged;
+      } else if (components_overlap_images(component_images_[static_cast<size_t>(a)],
+                                           component_images_[static_cast<size_t>(b)])) {
+        state[static_cast<size_t>(t)] = kDone;
+        ++rejected;
+      } else {
+        state[static_cast<size_t>(t)] = kWaiting;
+        root_a[static_cast<size_t>(t)] = a;
+        root_b[static_cast<size_t>(t)] = b;
+        reserve_min(res[a], e);
+        reserve_min(res[b], e);
+      }
+    }
+
+    // Commit: a match holding both roots touches components no earlier pending match touches,
+    // and the roots of different committing matches are disjoint.
+#pragma omp parallel for schedule(static) reduction(+:merged)
+    for (int t = 0; t < w; ++t) {
+      if (state[static_cast<size_t>(t)] != kWaiting) continue;
+      const int e = window[static_cast<size_t>(t)];
+      const int a = root_a[static_cast<size_t>(t)];
+      const int b = root_b[static_cast<size_t>(t)];
+      if (res[a].load(std::memory_order_relaxed) == e && res[b].load(std::memory_order_relaxed) == e) {
+        unite_roots(a, b);
+        state[static_cast<size_t>(t)] = kCommitted;
+        ++merged;
+      }
+    }
+
+    // Release reservations; keep the still-waiting matches in order.
+    size_t keep = 0;
+    for (int t = 0; t < w; ++t) {
+      const uint8_t st = state[static_cast<size_t>(t)];
+      if (st == kDone) continue;
+      res[root_a[static_cast<size_t>(t)]].store(kNoReservation, std::memory_order_relaxed);
+      res[root_b[static_cast<size_t>(t)]].store(kNoReservation, std::memory_order_relaxed);
+      if (st == kWaiting)
+        window[keep++] = window[static_cast<size_t>(t)];
+    }
+    window.resize(keep);
+    ++stats.rounds;
+  }
+
+  stats.merged = merged;
+  stats.rejected = rejected;
+  return stats;
+}
+
+}  // namespace sfm
+}  // namespace insight
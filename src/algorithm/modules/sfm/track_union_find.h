@@ -0,0 +1,137 @@
+/**
+ * @file  track_union_find.h
+ * @brief Union-Find over (image_index, feature_id) nodes for track building, with a
+ *        multi-threaded batch merge that reproduces the serial merge order exactly.
+ *
+ * Design
+ * ──────
+ * - Node key: (image_index << 32) | feature_id; internal node ids are assigned in first-seen
+ *   order and per-node coords (u, v, scale) are captured at creation (first-seen wins).
+ * - Conflict rule: two components are never merged when they already contain a feature of the
+ *   same image (one-feature-per-image-per-track). Because this rule is order dependent, the
+ *   result of a merge sequence depends on the order of the matches.
+ * - merge_pairs() is the parallel equivalent of calling merge_keys() for every match in order:
+ *     1. node ids: parallel read-only lookup, then one serial pass creates the missing nodes
+ *        in the same order as the serial path (so ids, coords and hash-map order are identical);
+ *     2. unions: deterministic reservations in rounds over a window of pending matches.
+ *        A match whose roots are equal is accepted, one whose components share an image is
+ *        rejected (both stay so whatever earlier matches do); otherwise it reserves both roots
+ *        with its sequence number (atomic min) and commits only if it holds both, i.e. no
+ *        earlier pending match touches either component. The lowest pending match always
+ *        commits, and each commit sees exactly the components the serial path would see.
+ *   The resulting components, roots and sizes are therefore identical to the serial path for any
+ *   thread count; only the internal parent chains differ (no path compression while merging).
+ *
+ * Usage
+ * ─────
+ *   TrackUnionFind uf;
+ *   std::vector<TrackPairMatches> block = ...;   // pairs in processing order
+ *   const TrackMergeStats s = uf.merge_pairs(block);
+ *   int root = uf.find_by_id(uf.node_id_.at(track_node_key(img, feat)));
+ */
+
+#pragma once
+
+#ifndef TRACK_UNION_FIND_H
+#define TRACK_UNION_FIND_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace insight {
+namespace sfm {
+
+inline uint64_t track_node_key(uint32_t image_index, uint32_t feature_id) {
+  return (static_cast<uint64_t>(image_index) << 32) | feature_id;
+}
+
+inline uint32_t image_index_from_track_node_key(uint64_t key) {
+  return static_cast<uint32_t>(key >> 32);
+}
+
+/// One inlier correspondence of an image pair (feature ids + pixel coords in both images).
+struct TrackInlierMatch {
+  uint16_t idx1;
+  uint16_t idx2;
+  float x1, y1, x2, y2;  // pixel coordinates (image1, image2)
+  float s1, s2;          // scales (1.0 if not available)
+};
+
+/// Inlier matches of one image pair, as input to TrackUnionFind::merge_pairs.
+struct TrackPairMatches {
+  uint32_t image1_index = 0;
+  uint32_t image2_index = 0;
+  const TrackInlierMatch* matches = nullptr;
+  size_t num_matches = 0;
+};
+
+struct TrackMergeStats {
+  int64_t merged = 0;    ///< matches accepted (already connected or united)
+  int64_t rejected = 0;  ///< matches rejected by the same-image conflict rule
+  int rounds = 0;        ///< reservation rounds (parallel path only)
+};
+
+// ─────────────────────────────────────────────────────────────────────────────
+// component_images_ stores the set of image indices per component as a
+// sorted small vector.  Most tracks span 2–10 images, so linear scan on a
+// contiguous array is faster than a hash table (better cache locality, no
+// pointer indirection, branch-predictor-friendly).  Merge keeps the vector
+// sorted via std::merge into a temporary, then swaps back.
+// ─────────────────────────────────────────────────────────────────────────────
+
+struct TrackUnionFind {
+  std::unordered_map<uint64_t, int> node_id_;
+  std::vector<int> parent_;
+  std::vector<int> component_size_;
+  // Sorted small vector per component — cache-friendly for the typical 2–10 image case.
+  std::vector<std::vector<uint32_t>> component_images_;
+  // Per-node observation coords, parallel to parent_.  Populated at node creation (first-seen
+  // wins).  Eliminates the need to keep all PairRawData alive through Phase 2.
+  std::vector<float> node_u_, node_v_, node_s_;
+
+  void reserve(size_t num_nodes);
+
+  /// Create node with coords if new; return its internal id in both cases.
+  int get_or_create(uint64_t key, float u, float v, float s);
+
+  /// Root with iterative path compression (serial use only).
+  int find_by_id(int i);
+
+  /// Root without modifying parent_ (safe for concurrent readers).
+  int find_root(int i) const {
+    while (parent_[static_cast<size_t>(i)] != i)
+      i = parent_[static_cast<size_t>(i)];
+    return i;
+  }
+
+  /// Merge two features into the same track.  Creates nodes (storing coords) if they don't
+  /// exist yet.  Returns false only when the merge would put two features from the same image
+  /// into the same track (one-feature-per-image-per-track invariant).
+  bool merge_keys(uint64_t k1, uint64_t k2,
+                  float u1, float v1, float s1,
+                  float u2, float v2, float s2);
+
+  /// Same result as merge_keys() over every match of `pairs` in order, using OpenMP threads.
+  TrackMergeStats merge_pairs(const std::vector<TrackPairMatches>& pairs);
+
+ private:
+  static bool components_overlap_images(const std::vector<uint32_t>& a,
+                                        const std::vector<uint32_t>& b);
+  /// Union by size of two distinct, non-overlapping roots (a = root of the first key).
+  void unite_roots(int a, int b);
+  TrackMergeStats merge_range(const std::vector<TrackPairMatches>& pairs, size_t begin,
+                              size_t end);
+
+  // Reservation slot per node for merge_pairs (kept across calls, grown geometrically).
+  std::unique_ptr<std::atomic<int>[]> reservation_;
+  size_t reservation_capacity_ = 0;
+};
+
+}  // namespace sfm
+}  // namespace insight
+
+#endif  // TRACK_UNION_FIND_H
@@ -0,0 +1,197 @@
+/**
+ * @file  track_update.cpp
+ * @brief Incremental track update: seeding and id-preserving rebuild of the TrackStore.
+ */
+
+#include "track_update.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace insight {
+namespace sfm {
+
+int64_t seed_union_find_from_track_store(const TrackStore& existing, TrackUnionFind* uf) {
+  int64_t rejected = 0;
+  std::vector<Observation> obs;
+  const int n_tracks = static_cast<int>(existing.num_tracks());
+  for (int t = 0; t < n_tracks; ++t) {
+    obs.clear();
+    if (existing.get_track_observations(t, &obs) == 0) continue;
+    const Observation& o0 = obs[0];
+    const uint64_t k0 = track_node_key(o0.image_index, o0.feature_id);
+    uf->get_or_create(k0, o0.u, o0.v, o0.scale);
+    for (size_t i = 1; i < obs.size(); ++i) {
+      const Observation& o = obs[i];
+      if (!uf->merge_keys(k0, track_node_key(o.image_index, o.feature_id), o0.u, o0.v, o0.scale,
+                          o.u, o.v, o.scale))
+        ++rejected;
+    }
+  }
+  return rejected;
+}
+
+TrackUpdateStats build_updated_track_store(const TrackStore& existing, TrackUnionFind& uf,
+                                           int num_images, int min_new_track_length,
+                                           TrackStore* out, std::vector<uint8_t>* status,
+                                           std::vector<int32_t>* link) {
+  TrackUpdateStats stats;
+  const int n_old = static_cast<int>(existing.num_tracks());
+
+  // Existing observations: key → track (first owner), first key and size per track.
+  std::unordered_map<uint64_t, int> key_old_track;
+  std::vector<uint64_t> first_key(static_cast<size_t>(n_old), 0);
+  std::vector<int> old_size(static_cast<size_t>(n_old), 0);
+  std::vector<Observation> obs;
+  for (int t = 0; t < n_old; ++t) {
+    obs.clear();
+    old_size[static_cast<size_t>(t)] = existing.get_track_observations(t, &obs);
+    for (size_t i = 0; i < obs.size(); ++i) {
+      const uint64_t key = track_node_key(obs[i].image_index, obs[i].feature_id);
+      if (i == 0) first_key[static_cast<size_t>(t)] = key;
+      key_old_track.emplace(key, t);
+    }
+  }
+
+  struct Entry {
+    int comp;  // UF root, then dense component index in smallest-key order
+    int old_track;
+    uint64_t key;
+    float u, v, s;
+  };
+  std::vector<Entry> entries;
+  entries.reserve(uf.node_id_.size());
+  for (const auto& [key, id] : uf.node_id_) {
+    auto it = key_old_track.find(key);
+    entries.push_back({uf.find_by_id(id), it == key_old_track.end() ? -1 : it->second, key,
+                       uf.node_u_[static_cast<size_t>(id)], uf.node_v_[static_cast<size_t>(id)],
+                       uf.node_s_[static_cast<size_t>(id)]});
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) { return a.key < b.key; });
+  std::unordered_map<int, int> root_to_comp;
+  root_to_comp.reserve(entries.size());
+  for (Entry& e : entries)
+    e.comp = root_to_comp.emplace(e.comp, static_cast<int>(root_to_comp.size())).first->second;
+  const int n_comp = static_cast<int>(root_to_comp.size());
+  root_to_comp = std::unordered_map<int, int>();
+
+  // Primary component of each existing track = component of its first observation.
+  std::vector<int> primary(static_cast<size_t>(n_old), -1);
+  {
+    std::unordered_map<uint64_t, int> key_comp;
+    key_comp.reserve(static_cast<size_t>(n_old));
+    for (int t = 0; t < n_old; ++t)
+      if (old_size[static_cast<size_t>(t)] > 0) key_comp.emplace(first_key[static_cast<size_t>(t)], -1);
+    for (const Entry& e : entries) {
+      auto it = key_comp.find(e.key);
+      if (it != key_comp.end()) it->second = e.comp;
+    }
+    for (int t = 0; t < n_old; ++t)
+      if (old_size[static_cast<size_t>(t)] > 0)
+        primary[static_cast<size_t>(t)] = key_comp[first_key[static_cast<size_t>(t)]];
+  }
+  std::vector<int> survivor(static_cast<size_t>(n_comp), -1);
+  for (int t = 0; t < n_old; ++t) {
+    const int c = primary[static_cast<size_t>(t)];
+    if (c >= 0 && survivor[static_cast<size_t>(c)] < 0) survivor[static_cast<size_t>(c)] = t;
+  }
+
+  std::vector<int> comp_size(static_cast<size_t>(n_comp), 0);
+  std::vector<int> comp_first_old(static_cast<size_t>(n_comp), -1);
+  std::vector<uint8_t> comp_foreign(static_cast<size_t>(n_comp), 0);  // obs of a non-survivor track
+  std::vector<int> kept_old(static_cast<size_t>(n_old), 0);
+  for (const Entry& e : entries) {
+    const size_t c = static_cast<size_t>(e.comp);
+    ++comp_size[c];
+    if (e.old_track < 0) continue;
+    if (comp_first_old[c] < 0) comp_first_old[c] = e.old_track;
+    if (e.old_track == survivor[c])
+      ++kept_old[static_cast<size_t>(e.old_track)];
+    else
+      comp_foreign[c] = 1;
+  }
+
+  // Output ids: survivors keep theirs, the rest are appended in component order.
+  std::vector<int> comp_out(static_cast<size_t>(n_comp), -1);
+  status->assign(static_cast<size_t>(n_old), track_update::kUnchanged);
+  link->assign(static_cast<size_t>(n_old), -1);
+  int next_id = n_old;
+  for (int c = 0; c < n_comp; ++c) {
+    const size_t ci = static_cast<size_t>(c);
+    if (survivor[ci] >= 0) {
+      comp_out[ci] = survivor[ci];
+      continue;
+    }
+    if (comp_first_old[ci] < 0 && comp_size[ci] < min_new_track_length) {
+      ++stats.skipped_short;
+      continue;
+    }
+    comp_out[ci] = next_id++;
+    status->push_back(comp_first_old[ci] < 0 ? track_update::kNew : track_update::kSplit);
+    link->push_back(comp_first_old[ci]);
+  }
+  for (int t = 0; t < n_old; ++t) {
+    const size_t ti = static_cast<size_t>(t);
+    const int c = primary[ti];
+    if (c < 0) continue;  // no observations: passed through unchanged
+    const size_t ci = static_cast<size_t>(c);
+    if (survivor[ci] != t) {
+      (*status)[ti] = track_update::kMergedAway;
+      (*link)[ti] = survivor[ci];
+    } else if (comp_foreign[ci]) {
+      (*status)[ti] = track_update::kMerged;
+    } else if (kept_old[ti] < old_size[ti]) {
+      (*status)[ti] = track_update::kSplit;
+    } else if (comp_size[ci] > old_size[ti]) {
+      (*status)[ti] = track_update::kExtended;
+    }
+  }
+
+  // Tracks: kUnchanged / kExtended keep xyz (and the triangulated flag) of a valid existing track.
+  *out = TrackStore{};
+  out->set_num_images(num_images);
+  out->reserve_tracks(static_cast<size_t>(next_id));
+  out->reserve_observations(entries.size());
+  for (int t = 0; t < next_id; ++t) {
+    const uint8_t st = (*status)[static_cast<size_t>(t)];
+    const bool keep_xyz = t < n_old && existing.is_track_valid(t) &&
+                          (st == track_update::kUnchanged || st == track_update::kExtended);
+    float x = 0.f, y = 0.f, z = 0.f;
+    if (keep_xyz) existing.get_track_xyz(t, &x, &y, &z);
+    out->add_track(x, y, z);
+    if (keep_xyz && existing.track_has_triangulated_xyz(t)) out->set_track_xyz(t, x, y, z);
+  }
+
+  std::stable_sort(entries.begin(), entries.end(), [&comp_out](const Entry& a, const Entry& b) {
+    return comp_out[static_cast<size_t>(a.comp)] < comp_out[static_cast<size_t>(b.comp)];
+  });
+  for (const Entry& e : entries) {
+    const int t = comp_out[static_cast<size_t>(e.comp)];
+    if (t < 0) continue;
+    out->add_observation(t, image_index_from_track_node_key(e.key),
+                         static_cast<uint32_t>(e.key & 0xFFFFFFFFu), e.u, e.v, e.s);
+    if (e.old_track < 0) ++stats.new_observations;
+  }
+  out->compact();
+
+  for (int t = 0; t < next_id; ++t) {
+    const uint8_t st = (*status)[static_cast<size_t>(t)];
+    if (st == track_update::kMergedAway ||
+        (st == track_update::kUnchanged && t < n_old && !existing.is_track_valid(t)))
+      out->mark_track_deleted(t);
+    switch (st) {
+      case track_update::kUnchanged: ++stats.unchanged; break;
+      case track_update::kExtended: ++stats.extended; break;
+      case track_update::kMerged: ++stats.merged; break;
+      case track_update::kMergedAway: ++stats.merged_away; break;
+      case track_update::kNew: ++stats.new_tracks; break;
+      case track_update::kSplit: ++stats.split; break;
+      default: break;
+    }
+  }
+  return stats;
+}
+
+}  // namespace sfm
+}  // namespace insight
@@ -0,0 +1,77 @@
+/**
+ * @file  track_update.h
+ * @brief Incremental track update: union new pair matches into an existing TrackStore while
+ *        preserving existing track ids.
+ *
+ * Design
+ * ──────
+ * - seed_union_find_from_track_store(): one component per existing track (its observations are
+ *   merged in order, coords taken from the store).  New matches are merged afterwards, so the
+ *   result equals a full rebuild that processes the old pairs before the new ones.  With
+ *   min_new_track_length > 1 it equals that rebuild minus the short components holding no
+ *   existing observation: existing tracks are never dropped, so this is not the full build's
+ *   degree filter.
+ * - build_updated_track_store(): existing track t keeps id t when its first observation's final
+ *   component is not claimed by a smaller existing id; otherwise t is retired (deleted, no
+ *   observations) and linked to the surviving id.  Components without a surviving id get new ids
+ *   appended after the existing ones, in order of their smallest (image_index, feature_id).
+ * - Each output track carries a status (track_update::k*) and a link id, so SfM can reuse the
+ *   triangulation of kUnchanged / kExtended tracks and re-triangulate the rest.
+ * - Splits only happen when an existing track holds two features of one image (the conflict rule
+ *   then rejects the second while seeding); a union step never splits a track otherwise.
+ */
+
+#pragma once
+
+#ifndef TRACK_UPDATE_H
+#define TRACK_UPDATE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "track_store.h"
+#include "track_union_find.h"
+
+namespace insight {
+namespace sfm {
+
+namespace track_update {
+constexpr uint8_t kUnchanged = 0;   ///< same observations as the existing track
+constexpr uint8_t kExtended = 1;    ///< existing track + new observations (xyz kept)
+constexpr uint8_t kMerged = 2;      ///< absorbed other existing track(s); link = -1
+constexpr uint8_t kMergedAway = 3;  ///< retired id (deleted, no observations); link = survivor
+constexpr uint8_t kNew = 4;         ///< only new observations
+constexpr uint8_t kSplit = 5;       ///< survivor that lost observations (link = -1), or the
+                                    ///< split-off part of existing track `link`
+}  // namespace track_update
+
+struct TrackUpdateStats {
+  int unchanged = 0;
+  int extended = 0;
+  int merged = 0;
+  int merged_away = 0;
+  int new_tracks = 0;
+  int split = 0;
+  int skipped_short = 0;  ///< new components below min_new_track_length (not written)
+  int64_t new_observations = 0;
+};
+
+/// Seed `uf` (empty) with every track of `existing`.  Returns the number of observations that
+/// could not join their track (same image twice in one existing track).
+int64_t seed_union_find_from_track_store(const TrackStore& existing, TrackUnionFind* uf);
+
+/**
+ * Build the updated store from `uf` (seeded + new matches merged).
+ * \p out is reset; \p status / \p link get one entry per output track.
+ * Components that contain no existing observation and have fewer than `min_new_track_length`
+ * nodes are dropped.
+ */
+TrackUpdateStats build_updated_track_store(const TrackStore& existing, TrackUnionFind& uf,
+                                           int num_images, int min_new_track_length,
+                                           TrackStore* out, std::vector<uint8_t>* status,
+                                           std::vector<int32_t>* link);
+
+}  // namespace sfm
+}  // namespace insight
+
+#endif  // TRACK_UPDATE_H
@@ -0,0 +1,267 @@
+/**
+ * @file  triangulation_kernels.h
+ * @brief Fixed-size, allocation-free point triangulation kernels (DLT + Gauss-Newton).
+ *
+ * Design
+ * ──────
+ * - Views are read in place from caller arrays (R, C, rays / pixels, per-view K), optionally
+ *   through an index array, so RANSAC pair samples and inlier subsets need no gathering.
+ * - N is the view count as a template argument: 2 and 3 fully unroll, Eigen::Dynamic loops over
+ *   the runtime count.  triangulate_dlt_n / refine_point_gn_n pick the specialisation.
+ * - DLT accumulates the 4×4 normal matrix AᵀA and takes the eigenvector of its smallest
+ *   eigenvalue (inverse iteration on a fixed-size LDLT) instead of a 2N×4 JacobiSVD.  The
+ *   origin is moved to the centroid of the camera centres and scaled by their mean spread
+ *   first, so squaring the conditioning does not cost precision in large scenes.
+ * - Gauss-Newton uses the analytic 2×3 Jacobian of the distorted pixel projection (same
+ *   Brown-Conrady model as camera::apply_distortion) accumulated into a 3×3 system.
+ * - No heap allocation anywhere; safe to call concurrently.
+ *
+ * Usage
+ * ─────
+ *   Eigen::Vector3d X;
+ *   const size_t ab[2] = {a, b};
+ *   if (tri_kernel::triangulate_dlt<2>(R.data(), C.data(), rays.data(), ab, 2, &X))
+ *     X = tri_kernel::refine_point_gn_n(X, R.data(), C.data(), K.data(), u.data(), v.data(),
+ *                                       nullptr, n, 10, 1e-8);
+ */
+
+#pragma once
+
+#ifndef TRIANGULATION_KERNELS_H
+#define TRIANGULATION_KERNELS_H
+
+#include <cmath>
+#include <cstddef>
+
+#include <Eigen/Cholesky>
+#include <Eigen/Core>
+#include <Eigen/Eigenvalues>
+
+#include "../camera/camera_types.h"
+
+namespace insight {
+namespace sfm {
+namespace tri_kernel {
+
+/// View count: compile-time N, or the runtime \p n for Eigen::Dynamic.
+template <int N> struct ViewCount {
+  static constexpr int get(int /*n*/) { return N; }
+};
+template <> struct ViewCount<Eigen::Dynamic> {
+  static constexpr int get(int n) { return n; }
+};
+
+/// k-th view: idx[k], or k when \p idx is null.
+inline size_t view_at(const size_t* idx, int k) {
+  return idx ? idx[k] : static_cast<size_t>(k);
+}
+
+/**
+ * Unit eigenvector of the smallest eigenvalue of a symmetric PSD 4×4 matrix.
+ * Inverse iteration on M + εI (one LDLT, a few solves; the shift only slows convergence, it
+ * does not bias the result).  Falls back to SelfAdjointEigenSolver when the two smallest
+ * eigenvalues are too close for inverse iteration to converge quickly.
+ */
+inline bool smallest_eigenvector(const Eigen::Matrix4d& M, Eigen::Vector4d* v) {
+  const double shift = 1e-14 * M.trace() + 1e-300;
+  const Eigen::LDLT<Eigen::Matrix4d> ldlt(M + shift * Eigen::Matrix4d::Identity());
+  if (ldlt.info() == Eigen::Success) {
+    Eigen::Vector4d x(0.0, 0.0, 0.0, 1.0);
+    for (int it = 0; it < 8; ++it) {
+      Eigen::Vector4d y = ldlt.solve(x);
+      const double norm = y.norm();
+      if (!(norm > 0.0) || !std::isfinite(norm))
+        break;
+      y /= norm;
+      if (y.dot(x) < 0.0)
+        y = -y;
+      const double change = (y - x).squaredNorm();
+      x = y;
+      if (change < 1e-24) {
+        *v = x;
+        return true;
+      }
+    }
+  }
+  const Eigen::SelfAdjointEigenSolver<Eigen::Matrix4d> es(M);
+  if (es.info() != Eigen::Success)
+    return false;
+  *v = es.eigenvectors().col(0); // eigenvalues are sorted ascending
+  return true;
+}
+
+/**
+ * Linear (DLT) triangulation from undistorted normalised rays.
+ * Equivalent to the smallest right singular vector of the 2N×4 DLT matrix.
+ * @return false for fewer than two views or a point at infinity (w ≈ 0).
+ */
+template <int N>
+inline bool triangulate_dlt(const Eigen::Matrix3d* R, const Eigen::Vector3d* C,
+                            const Eigen::Vector2d* rays, const size_t* idx, int n,
+                            Eigen::Vector3d* X) {
+  const int m = ViewCount<N>::get(n);
+  if (m < 2)
+    return false;
+  Eigen::Vector3d c0 = Eigen::Vector3d::Zero();
+  for (int k = 0; k < m; ++k)
+    c0 += C[view_at(idx, k)];
+  c0 /= static_cast<double>(m);
+  double s = 0.0;
+  for (int k = 0; k < m; ++k)
+    s += (C[view_at(idx, k)] - c0).norm();
+  s /= static_cast<double>(m);
+  if (!(s > 0.0))
+    s = 1.0; // coincident centres: no rescaling
+  const double inv_s = 1.0 / s;
+
+  Eigen::Matrix4d AtA = Eigen::Matrix4d::Zero();
+  for (int k = 0; k < m; ++k) {
+    const size_t i = view_at(idx, k);
+    const Eigen::Matrix3d& Ri = R[i];
+    const Eigen::Vector3d t = -Ri * ((C[i] - c0) * inv_s);
+    const double nx = rays[i](0), ny = rays[i](1);
+    // Rows of the DLT system (q = R*X + t):  (nx*R[2] - R[0])*X + (nx*t2 - t0) = 0, same for y.
+    Eigen::RowVector4d a0, a1;
+    a0 << nx * Ri.row(2) - Ri.row(0), nx * t(2) - t(0);
+    a1 << ny * Ri.row(2) - Ri.row(1), ny * t(2) - t(1);
+    AtA.noalias() += a0.transpose() * a0;
+    AtA.noalias() += a1.transpose() * a1;
+  }
+  Eigen::Vector4d v;
+  if (!smallest_eigenvector(AtA, &v))
+    return false;
+  if (std::fabs(v(3)) < 1e-12)
+    return false;
+  *X = c0 + s * (v.head<3>() / v(3));
+  return true;
+}
+
+/**
+ * Distorted pixel projection of world point \p X and its analytic 2×3 Jacobian d(u,v)/dX.
+ * @return false when X is not in front of the camera (depth <= 1e-12).
+ */
+inline bool project_with_jacobian(const Eigen::Matrix3d& R, const Eigen::Vector3d& C,
+                                  const camera::Intrinsics& K, const Eigen::Vector3d& X,
+                                  Eigen::Vector2d* uv, Eigen::Matrix<double, 2, 3>* J) {
+  const Eigen::Vector3d p = R * (X - C);
+  if (p(2) <= 1e-12)
+    return false;
+  const double iz = 1.0 / p(2);
+  const double x = p(0) * iz, y = p(1) * iz;
+  double xd = x, yd = y;
+  double dxx = 1.0, dxy = 0.0, dyx = 0.0, dyy = 1.0; // d(xd,yd)/d(x,y)
+  if (K.has_distortion()) {
+    const double r2 = x * x + y * y;
+    const double r4 = r2 * r2;
+    const double radial = 1.0 + K.k1 * r2 + K.k2 * r4 + K.k3 * r4 * r2;
+    const double dradial = K.k1 + 2.0 * K.k2 * r2 + 3.0 * K.k3 * r4; // d radial / d r2
+    xd = radial * x + 2.0 * K.p2 * x * y + K.p1 * (r2 + 2.0 * x * x);
+    yd = radial * y + 2.0 * K.p1 * x * y + K.p2 * (r2 + 2.0 * y * y);
+    dxx = radial + 2.0 * x * x * dradial + 2.0 * K.p2 * y + 6.0 * K.p1 * x;
+    dxy = 2.0 * x * y * dradial + 2.0 * K.p2 * x + 2.0 * K.p1 * y;
+    dyx = 2.0 * x * y * dradial + 2.0 * K.p1 * y + 2.0 * K.p2 * x;
+    dyy = radial + 2.0 * y * y * dradial + 2.0 * K.p1 * x + 6.0 * K.p2 * y;
+  }
+  (*uv)(0) = K.fx * xd + K.cx;
+  (*uv)(1) = K.fy * yd + K.cy;
+  if (J) {
+    // d(x,y)/dp, chained through distortion and focal length, then dp/dX = R.
+    Eigen::Matrix<double, 2, 3> dn;
+    dn << iz, 0.0, -x * iz, 0.0, iz, -y * iz;
+    Eigen::Matrix2d dd;
+    dd << K.fx * dxx, K.fx * dxy, K.fy * dyx, K.fy * dyy;
+    J->noalias() = (dd * dn) * R;
+  }
+  return true;
+}
+
+/**
+ * Gauss-Newton refinement of \p X on the pixel reprojection error of the given views.
+ * A step is accepted only if it lowers the squared error; stops when the RMS residual is below
+ * \p tol, the step is below \p tol, or after \p max_iter iterations.
+ */
+template <int N>
+inline Eigen::Vector3d refine_point_gn(Eigen::Vector3d X, const Eigen::Matrix3d* R,
+                                       const Eigen::Vector3d* C, const camera::Intrinsics* K,
+                                       const double* u_px, const double* v_px, const size_t* idx,
+                                       int n, int max_iter, double tol) {
+  const int m = ViewCount<N>::get(n);
+  if (m < 2)
+    return X;
+  // Squared residual at Xe (and JᵀJ / Jᵀr when requested); negative if a view is behind.
+  auto accumulate = [&](const Eigen::Vector3d& Xe, Eigen::Matrix3d* JtJ,
+                        Eigen::Vector3d* Jtr) -> double {
+    double cost = 0.0;
+    if (JtJ) {
+      JtJ->setZero();
+      Jtr->setZero();
+    }
+    for (int k = 0; k < m; ++k) {
+      const size_t i = view_at(idx, k);
+      Eigen::Vector2d uv;
+      Eigen::Matrix<double, 2, 3> J;
+      if (!project_with_jacobian(R[i], C[i], K[i], Xe, &uv, JtJ ? &J : nullptr))
+        return -1.0;
+      const Eigen::Vector2d r(u_px[i] - uv(0), v_px[i] - uv(1));
+      cost += r.squaredNorm();
+      if (JtJ) {
+        JtJ->noalias() += J.transpose() * J;
+        Jtr->noalias() += J.transpose() * r;
+      }
+    }
+    return cost;
+  };
+  for (int it = 0; it < max_iter; ++it) {
+    Eigen::Matrix3d JtJ;
+    Eigen::Vector3d Jtr;
+    const double cost = accumulate(X, &JtJ, &Jtr);
+    if (cost < 0.0 || std::sqrt(cost) < tol * std::sqrt(static_cast<double>(m)))
+      break;
+    const Eigen::Vector3d dx = JtJ.ldlt().solve(Jtr); // r = obs - proj: X_new = X + dx
+    if (!dx.allFinite())
+      break;
+    const Eigen::Vector3d X_new = X + dx;
+    const double cost_new = accumulate(X_new, nullptr, nullptr);
+    if (cost_new < 0.0 || cost_new >= cost)
+      break;
+    X = X_new;
+    if (dx.norm() < tol)
+      break;
+  }
+  return X;
+}
+
+/// triangulate_dlt with the 2- / 3-view specialisation chosen from \p n.
+inline bool triangulate_dlt_n(const Eigen::Matrix3d* R, const Eigen::Vector3d* C,
+                              const Eigen::Vector2d* rays, const size_t* idx, int n,
+                              Eigen::Vector3d* X) {
+  switch (n) {
+  case 2:
+    return triangulate_dlt<2>(R, C, rays, idx, n, X);
+  case 3:
+    return triangulate_dlt<3>(R, C, rays, idx, n, X);
+  default:
+    return triangulate_dlt<Eigen::Dynamic>(R, C, rays, idx, n, X);
+  }
+}
+
+/// refine_point_gn with the 2- / 3-view specialisation chosen from \p n.
+inline Eigen::Vector3d refine_point_gn_n(const Eigen::Vector3d& X, const Eigen::Matrix3d* R,
+                                         const Eigen::Vector3d* C, const camera::Intrinsics* K,
+                                         const double* u_px, const double* v_px,
+                                         const size_t* idx, int n, int max_iter, double tol) {
+  switch (n) {
+  case 2:
+    return refine_point_gn<2>(X, R, C, K, u_px, v_px, idx, n, max_iter, tol);
+  case 3:
+    return refine_point_gn<3>(X, R, C, K, u_px, v_px, idx, n, max_iter, tol);
+  default:
+    return refine_point_gn<Eigen::Dynamic>(X, R, C, K, u_px, v_px, idx, n, max_iter, tol);
+  }
+}
+
+} // namespace tri_kernel
+} // namespace sfm
+} // namespace insight
+
+#endif // TRIANGULATION_KERNELS_H
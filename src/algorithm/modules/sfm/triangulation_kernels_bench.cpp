@@ -0,0 +1,195 @@
+/**
+ * @file  triangulation_kernels_bench.cpp
+ * @brief Microbenchmark: fixed-size triangulation kernels vs the previous dynamic-size code.
+ *
+ * Baseline = the former incremental_triangulation.cpp code: DLT via a 2N×4 MatrixXd + JacobiSVD
+ * (called through std::vector arguments, as the RANSAC pair loop did) and Gauss-Newton with a
+ * finite-difference Jacobian in VectorXd / MatrixXd.  Kernel = triangulation_kernels.h.
+ * Reports ns per call for N = 2, 3 and 8 views and the max |X_kernel - X_baseline|.
+ *
+ * Usage: bench_triangulation_kernels [iterations=200000]
+ */
+
+#include "triangulation_kernels.h"
+
+#include "../camera/camera_types.h"
+#include "../camera/camera_utils.h"
+
+#include <Eigen/Dense>
+#include <Eigen/SVD>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using insight::camera::Intrinsics;
+namespace tri_kernel = insight::sfm::tri_kernel;
+
+namespace {
+
+Eigen::Vector3d baseline_dlt(const std::vector<Eigen::Matrix3d>& R_list,
+                             const std::vector<Eigen::Vector3d>& C_list,
+                             const std::vector<Eigen::Vector2d>& rays_n) {
+  const int N = static_cast<int>(R_list.size());
+  Eigen::MatrixXd A(2 * N, 4);
+  for (int i = 0; i < N; ++i) {
+    const Eigen::Matrix3d& R = R_list[i];
+    const Eigen::Vector3d t = -R * C_list[i];
+    const double nx = rays_n[i](0), ny = rays_n[i](1);
+    A.row(2 * i) << nx * R.row(2) - R.row(0), nx * t(2) - t(0);
+    A.row(2 * i + 1) << ny * R.row(2) - R.row(1), ny * t(2) - t(1);
+  }
+  Eigen::JacobiSVD<Eigen::MatrixXd> svd(A, Eigen::ComputeFullV);
+  const Eigen::Vector4d v = svd.matrixV().col(3);
+  if (std::fabs(v(3)) < 1e-12)
+    return Eigen::Vector3d(0, 0, 0);
+  return v.head<3>() / v(3);
+}
+
+void baseline_world_to_pixel(const Eigen::Matrix3d& R, const Eigen::Vector3d& C,
+                             const Intrinsics& K, const Eigen::Vector3d& X, double* u,
+                             double* v) {
+  const Eigen::Vector3d p = R * (X - C);
+  double xd, yd;
+  insight::camera::apply_distortion(p(0) / p(2), p(1) / p(2), K, &xd, &yd);
+  *u = K.fx * xd + K.cx;
+  *v = K.fy * yd + K.cy;
+}
+
+Eigen::Vector3d baseline_gn(Eigen::Vector3d X, const std::vector<Eigen::Matrix3d>& R_list,
+                            const std::vector<Eigen::Vector3d>& C_list,
+                            const std::vector<Intrinsics>& K_list, const std::vector<double>& u_px,
+                            const std::vector<double>& v_px, int max_iter, double tol) {
+  const Eigen::Index m = static_cast<Eigen::Index>(R_list.size());
+  auto residual = [&](const Eigen::Vector3d& Xe, Eigen::VectorXd* r) {
+    for (Eigen::Index i = 0; i < m; ++i) {
+      double up, vp;
+      baseline_world_to_pixel(R_list[i], C_list[i], K_list[i], Xe, &up, &vp);
+      (*r)(2 * i) = u_px[i] - up;
+      (*r)(2 * i + 1) = v_px[i] - vp;
+    }
+  };
+  const double h = 1e-6;
+  for (int it = 0; it < max_iter; ++it) {
+    Eigen::VectorXd r(2 * m);
+    residual(X, &r);
+    if (r.norm() < tol * std::sqrt(static_cast<double>(m)))
+      break;
+    Eigen::MatrixXd J(r.size(), 3);
+    for (int k = 0; k < 3; ++k) {
+      Eigen::Vector3d Xp = X;
+      Xp(k) += h;
+      Eigen::VectorXd rp(2 * m);
+      residual(Xp, &rp);
+      J.col(k) = (rp - r) / h;
+    }
+    const Eigen::Vector3d dx = (J.transpose() * J).ldlt().solve(J.transpose() * r);
+    if (!dx.allFinite())
+      break;
+    const Eigen::Vector3d X_new = X - dx;
+    Eigen::VectorXd r_new(r.size());
+    residual(X_new, &r_new);
+    if (r_new.norm() >= r.norm())
+      break;
+    X = X_new;
+    if (dx.norm() < tol)
+      break;
+  }
+  return X;
+}
+
+struct Problem {
+  std::vector<Eigen::Matrix3d> R;
+  std::vector<Eigen::Vector3d> C;
+  std::vector<Eigen::Vector2d> rays;
+  std::vector<Intrinsics> K;
+  std::vector<double> u, v;
+  Eigen::Vector3d X0;
+};
+
+std::vector<Problem> make_problems(int n_views, int count, uint32_t seed) {
+  Intrinsics K;
+  K.fx = K.fy = 2400.0;
+  K.cx = 2000.0;
+  K.cy = 1500.0;
+  K.k1 = -0.08;
+  K.k2 = 0.02;
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> unit(-1.0, 1.0);
+  std::normal_distribution<double> noise(0.0, 0.5);
+  std::vector<Problem> out(static_cast<size_t>(count));
+  for (Problem& p : out) {
+    const Eigen::Vector3d X(unit(rng), unit(rng), 10.0 + unit(rng));
+    for (int i = 0; i < n_views; ++i) {
+      const Eigen::Vector3d axis(unit(rng), unit(rng), unit(rng));
+      const Eigen::Matrix3d R =
+          Eigen::AngleAxisd(0.1 * unit(rng), axis.normalized()).toRotationMatrix();
+      const Eigen::Vector3d C(2.0 * unit(rng), 2.0 * unit(rng), 0.5 * unit(rng));
+      const Eigen::Vector3d q = R * (X - C);
+      double xd, yd;
+      insight::camera::apply_distortion(q(0) / q(2), q(1) / q(2), K, &xd, &yd);
+      p.R.push_back(R);
+      p.C.push_back(C);
+      p.K.push_back(K);
+      p.u.push_back(K.fx * xd + K.cx + noise(rng));
+      p.v.push_back(K.fy * yd + K.cy + noise(rng));
+      double ux, uy;
+      insight::camera::undistort_point(K, p.u.back(), p.v.back(), &ux, &uy);
+      p.rays.emplace_back((ux - K.cx) / K.fx, (uy - K.cy) / K.fy);
+    }
+    p.X0 = baseline_dlt(p.R, p.C, p.rays);
+  }
+  return out;
+}
+
+template <class F> double ns_per_call(int iterations, const std::vector<Problem>& probs, F&& f) {
+  double sink = 0.0;
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int it = 0; it < iterations; ++it)
+    sink += f(probs[static_cast<size_t>(it) % probs.size()]).x();
+  const double ns =
+      std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+  if (sink == 12345.678) // keep the results observable
+    std::printf(" ");
+  return ns / iterations;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int iterations = argc > 1 ? std::atoi(argv[1]) : 200000;
+  std::printf("bench_triangulation_kernels: %d calls per row (ns/call)\n", iterations);
+  std::printf("  %-3s %12s %12s %8s   %12s %12s %8s   %10s\n", "N", "dlt_base", "dlt_kernel",
+              "speedup", "gn_base", "gn_kernel", "speedup", "max|dX|");
+  for (const int n : {2, 3, 8}) {
+    const std::vector<Problem> probs = make_problems(n, 1024, 17u + static_cast<uint32_t>(n));
+    const double dlt_base = ns_per_call(iterations, probs, [](const Problem& p) {
+      return baseline_dlt(p.R, p.C, p.rays);
+    });
+    const double dlt_kern = ns_per_call(iterations, probs, [n](const Problem& p) {
+      Eigen::Vector3d X(0, 0, 0);
+      tri_kernel::triangulate_dlt_n(p.R.data(), p.C.data(), p.rays.data(), nullptr, n, &X);
+      return X;
+    });
+    const double gn_base = ns_per_call(iterations / 4, probs, [](const Problem& p) {
+      return baseline_gn(p.X0, p.R, p.C, p.K, p.u, p.v, 10, 1e-8);
+    });
+    const double gn_kern = ns_per_call(iterations / 4, probs, [n](const Problem& p) {
+      return tri_kernel::refine_point_gn_n(p.X0, p.R.data(), p.C.data(), p.K.data(), p.u.data(),
+                                           p.v.data(), nullptr, n, 10, 1e-8);
+    });
+    double max_dx = 0.0;
+    for (const Problem& p : probs) {
+      const Eigen::Vector3d a = baseline_gn(p.X0, p.R, p.C, p.K, p.u, p.v, 10, 1e-8);
+      const Eigen::Vector3d b = tri_kernel::refine_point_gn_n(
+          p.X0, p.R.data(), p.C.data(), p.K.data(), p.u.data(), p.v.data(), nullptr, n, 10, 1e-8);
+      max_dx = std::max(max_dx, (a - b).norm());
+    }
+    std::printf("  %-3d %12.1f %12.1f %7.2fx   %12.1f %12.1f %7.2fx   %10.3g\n", n, dlt_base,
+                dlt_kern, dlt_base / dlt_kern, gn_base, gn_kern, gn_base / gn_kern, max_dx);
+  }
+  return EXIT_SUCCESS;
+}
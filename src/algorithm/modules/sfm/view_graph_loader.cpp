@@ -12,7 +12,9 @@
 #include <filesystem>
 #include <fstream>
 #include <glog/logging.h>
+#include <memory>
 #include <set>
+#include <unordered_map>
 #include <unordered_set>
 #include <nlohmann/json.hpp>
 
@@ -116,6 +118,62 @@ bool load_pair_geo_info_from_isat_geo_file(const std::string& geo_path, uint32_t
   return true;
 }
 
+size_t load_two_view_poses_from_geo_dir(const std::string& geo_dir,
+                                        const std::vector<std::pair<uint32_t, uint32_t>>& pairs,
+                                        std::vector<Eigen::Matrix3d>* R,
+                                        std::vector<Eigen::Vector3d>* t, std::vector<char>* found) {
+  R->assign(pairs.size(), Eigen::Matrix3d::Identity());
+  t->assign(pairs.size(), Eigen::Vector3d::Zero());
+  found->assign(pairs.size(), 0);
+  std::string dir = geo_dir;
+  if (!dir.empty() && dir.back() != '/')
+    dir += '/';
+
+  io::GeoPackIndex geopack_index;
+  const bool have_geopack_index = geopack_index.load_from_dir(geo_dir);
+  std::unordered_map<std::string, std::unique_ptr<io::IDCReader>> packs;
+  auto fill = [&](size_t k, io::IDCReader& reader, const std::string& prefix) {
+    const std::vector<float> R_blob = reader.read_blob<float>(prefix + "R_matrix");
+    const std::vector<float> t_blob = reader.read_blob<float>(prefix + "t_vector");
+    if (R_blob.size() != 9u || t_blob.size() != 3u)
+      return;
+    for (int r = 0; r < 3; ++r) {
+      for (int c = 0; c < 3; ++c)
+        (*R)[k](r, c) = static_cast<double>(R_blob[static_cast<size_t>(r * 3 + c)]);
+      (*t)[k](r) = static_cast<double>(t_blob[static_cast<size_t>(r)]);
+    }
+    (*found)[k] = 1;
+  };
+
+  size_t n_found = 0;
+  for (size_t k = 0; k < pairs.size(); ++k) {
+    const uint32_t i = std::min(pairs[k].first, pairs[k].second);
+    const uint32_t j = std::max(pairs[k].first, pairs[k].second);
+    const io::GeoPackPairEntry* entry = have_geopack_index ? geopack_index.find(i, j) : nullptr;
+    if (entry) {
+      // Pack blobs are named "<pair prefix>/R_matrix"; the prefix is that of the F_inliers blob.
+      const std::string& f_blob = entry->f_inliers_blob;
+      if (!entry->twoview_ok || f_blob.size() < 9 ||
+          f_blob.compare(f_blob.size() - 9, 9, "F_inliers") != 0)
+        continue;
+      auto& reader = packs[entry->pack_path];
+      if (!reader)
+        reader = std::make_unique<io::IDCReader>(entry->pack_path, io::IDCReadMode::kMapped);
+      if (reader->is_valid())
+        fill(k, *reader, f_blob.substr(0, f_blob.size() - 9));
+    } else {
+      const std::string path = dir + std::to_string(i) + "_" + std::to_string(j) + ".isat_geo";
+      if (!geo_file_exists(path))
+        continue;
+      io::IDCReader reader(path);
+      if (reader.is_valid() && reader.get_metadata().contains("twoview"))
+        fill(k, reader, std::string());
+    }
+    n_found += static_cast<size_t>((*found)[k]);
+  }
+  return n_found;
+}
+
 void collect_covisible_image_pairs_from_track_store(const TrackStore& store,
                                                     std::vector<std::pair<uint32_t, uint32_t>>* out_pairs) {
   if (!out_pairs)
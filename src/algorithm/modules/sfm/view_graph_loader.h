@@ -12,6 +12,7 @@
 #pragma once
 
 #include "view_graph.h"
+#include <Eigen/Core>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <utility>
@@ -30,6 +31,17 @@ void pair_geo_info_from_isat_geo_metadata(const nlohmann::json& meta, PairGeoInf
 bool load_pair_geo_info_from_isat_geo_file(const std::string& geo_path, uint32_t image1_index,
                                            uint32_t image2_index, PairGeoInfo* out);
 
+/**
+ * Two-view relative pose written by isat_geo --twoview (R_matrix / t_vector blobs) for each of
+ * \p pairs, read from the geopack in \p geo_dir when it has one, else from per-pair .isat_geo
+ * files.  For pair k = (i, j), i < j: X_j = R[k] X_i + t[k].  \p found[k] is 0 when the pair has
+ * no two-view pose (no geo, twoview not ok, or bad blobs).  @return Number of poses found.
+ */
+size_t load_two_view_poses_from_geo_dir(const std::string& geo_dir,
+                                        const std::vector<std::pair<uint32_t, uint32_t>>& pairs,
+                                        std::vector<Eigen::Matrix3d>* R,
+                                        std::vector<Eigen::Vector3d>* t, std::vector<char>* found);
+
 /// Covisibility edges from filtered tracks: all unordered pairs (i,j) with i<j that co-appear on ≥1 track
 /// (cliques per track — includes transitive pairs that may have no direct geo file).
 void collect_covisible_image_pairs_from_track_store(const TrackStore& store,
@@ -8,6 +8,8 @@
  * Pipeline (Stage/chain):
  *   Stage 0  [single-thread]      Build global sample model from sampled images
  *   Stage 1  [multi-thread I/O]   Load features + compute image hash features
+ *                                 (shared FeatureCache: images reused by the next block are
+ *                                 not reloaded; pairs are ordered by PairScheduler)
  *   Stage 2  [multi-thread CPU]   Cascade-hash matching
  *   Stage 3  [multi-thread I/O]   Write .isat_match
  *
@@ -23,6 +25,7 @@
 #include <future>
 #include <glog/logging.h>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <nlohmann/json.hpp>
 #include <string>
@@ -32,7 +35,11 @@
 
 #include "../io/idc_reader.h"
 #include "../io/idc_writer.h"
+#include "../io/matchpack.h"
 #include "../modules/cpu_cascade_hash/cpu_cascade_hash.h"
+#include "../modules/matching/feature_cache.h"
+#include "../modules/matching/feature_loader.h"
+#include "../modules/matching/pair_scheduler.h"
 #include "cli_logging.h"
 #include "cmdLine/cmdLine.h"
 #include "pair_json_utils.h"
@@ -47,10 +54,14 @@ using insight::algorithm::cpu_cascade_hash::build_sample_model_from_mean_descrip
 using insight::algorithm::cpu_cascade_hash::compute_image_features;
 using insight::algorithm::cpu_cascade_hash::match_cascade_hash;
 using insight::algorithm::matching::DescriptorType;
+using insight::algorithm::matching::FeatureCache;
+using insight::algorithm::matching::FeatureCacheStats;
 using insight::algorithm::matching::FeatureData;
 using insight::algorithm::matching::MatchResult;
 using insight::io::IDCReader;
 using insight::io::IDCWriter;
+using insight::io::MatchPackIndex;
+using insight::io::MatchPackWriter;
 
 static constexpr const char* kEventPrefix = "ISAT_EVENT ";
 
@@ -61,14 +72,7 @@ static void print_event(const json& j) {
 
 static bool write_pairs_json(const std::string& output_path,
                              const std::vector<std::pair<uint32_t, uint32_t>>& pairs) {
-  json pairs_arr = json::array();
-  for (const auto& [i, j] : pairs)
-    pairs_arr.push_back({{"image1_index", i}, {"image2_index", j}});
-  std::ofstream f(output_path);
-  if (!f.is_open())
-    return false;
-  f << json{{"pairs", pairs_arr}}.dump(2) << "\n";
-  return true;
+  return insight::tools::write_pair_list(output_path, pairs, insight::io::kPairMethodMatched);
 }
 
 struct PairTask {
@@ -84,12 +88,24 @@ struct PairTask {
   std::vector<float> match_scales;
 };
 
+/** Decoded features + cascade hash of one image, shared through the FeatureCache. */
+struct HashedImage {
+  FeatureData features;
+  ImageFeatures image_features;
+};
+
+static size_t hashed_image_bytes(const HashedImage& image) {
+  const auto& h = image.image_features;
+  return insight::algorithm::matching::feature_data_bytes(image.features) +
+         h.compressed_hashes.size() * sizeof(h.compressed_hashes[0]) +
+         h.bucket_ids_flat.size() * sizeof(uint16_t) +
+         (h.bucket_counts.size() + h.bucket_offsets.size() + h.bucket_indices.size()) * sizeof(int);
+}
+
 struct ImageCacheEntry {
   uint32_t image_index = 0;
   std::string feature_file;
-  FeatureData features;
-  ImageFeatures image_features;
-  bool valid = false;
+  std::shared_ptr<const HashedImage> data;  ///< null = failed / empty features
 };
 
 struct BlockRange {
@@ -108,82 +124,35 @@ struct BlockRuntimeData {
 
 static std::vector<PairTask> load_pairs_json(const std::string& json_path,
                                              const std::string& feature_dir) {
-  std::ifstream file(json_path);
-  if (!file.is_open()) {
-    LOG(FATAL) << "Failed to open pairs file: " << json_path;
-  }
-
-  json j;
-  file >> j;
-
   std::vector<PairTask> pairs;
   int index = 0;
-  for (const auto& pair : j["pairs"]) {
-    PairTask task;
-    task.image1_index = insight::tools::get_image_index_from_pair(pair, "image1_index");
-    task.image2_index = insight::tools::get_image_index_from_pair(pair, "image2_index");
-    task.priority = pair.value("priority", 1.0f);
-    task.index = index++;
-
-    if (!feature_dir.empty()) {
-      task.feature1_file = feature_dir + "/" + std::to_string(task.image1_index) + ".isat_feat";
-      task.feature2_file = feature_dir + "/" + std::to_string(task.image2_index) + ".isat_feat";
-    } else {
-      task.feature1_file = pair["feature1_file"];
-      task.feature2_file = pair["feature2_file"];
-    }
-    pairs.push_back(std::move(task));
+  const bool ok = insight::tools::for_each_pair_in_list(
+      json_path, [&](const insight::tools::PairListEntry& pair) {
+        PairTask task;
+        task.image1_index = pair.image1_index;
+        task.image2_index = pair.image2_index;
+        task.priority = 1.0f + pair.score;
+        task.index = index++;
+
+        if (!feature_dir.empty()) {
+          task.feature1_file = feature_dir + "/" + std::to_string(task.image1_index) + ".isat_feat";
+          task.feature2_file = feature_dir + "/" + std::to_string(task.image2_index) + ".isat_feat";
+        } else if (pair.feature1_file && pair.feature2_file) {
+          task.feature1_file = *pair.feature1_file;
+          task.feature2_file = *pair.feature2_file;
+        } else {
+          LOG(FATAL) << "Pair list has no feature files; pass --feature-dir: " << json_path;
+        }
+        pairs.push_back(std::move(task));
+      });
+  if (!ok) {
+    LOG(FATAL) << "Failed to open pairs file: " << json_path;
   }
   return pairs;
 }
 
 static FeatureData load_features_idc(const std::string& idc_path) {
-  IDCReader reader(idc_path);
-  if (!reader.is_valid()) {
-    LOG(ERROR) << "Invalid IDC file: " << idc_path;
-    return FeatureData();
-  }
-
-  const auto keypoints_raw = reader.read_blob<float>("keypoints");
-  if (keypoints_raw.empty()) {
-    LOG(ERROR) << "Failed to read keypoints from " << idc_path;
-    return FeatureData();
-  }
-
-  const auto desc_blob = reader.get_blob_descriptor("descriptors");
-  const std::string dtype = desc_blob["dtype"];
-  const size_t num_features = keypoints_raw.size() / 4;
-
-  DescriptorType descriptor_type = DescriptorType::kUInt8;
-  if (dtype == "uint8") {
-    descriptor_type = DescriptorType::kUInt8;
-  } else if (dtype == "float32") {
-    descriptor_type = DescriptorType::kFloat32;
-  } else {
-    LOG(ERROR) << "Unsupported descriptor dtype: " << dtype << " in " << idc_path;
-    return FeatureData();
-  }
-
-  FeatureData features(num_features, descriptor_type);
-  for (size_t i = 0; i < num_features; ++i) {
-    features.keypoints[i] << keypoints_raw[i * 4 + 0], keypoints_raw[i * 4 + 1],
-        keypoints_raw[i * 4 + 2], keypoints_raw[i * 4 + 3];
-  }
-
-  if (descriptor_type == DescriptorType::kUInt8) {
-    features.descriptors_uint8 = reader.read_blob<uint8_t>("descriptors");
-    if (features.descriptors_uint8.empty()) {
-      LOG(ERROR) << "Failed to read uint8 descriptors from " << idc_path;
-      return FeatureData();
-    }
-  } else {
-    features.descriptors_float = reader.read_blob<float>("descriptors");
-    if (features.descriptors_float.empty()) {
-      LOG(ERROR) << "Failed to read float descriptors from " << idc_path;
-      return FeatureData();
-    }
-  }
-  return features;
+  return insight::algorithm::matching::load_feature_data_idc(idc_path);
 }
 
 static std::vector<float> build_scales_flat(const MatchResult& matches,
@@ -209,7 +178,8 @@ static std::vector<float> build_scales_flat(const MatchResult& matches,
 }
 
 static bool write_match_idc(const MatchResult& matches, const PairTask& pair,
-                            const std::string& output_dir) {
+                            const std::string& output_dir, bool write_file,
+                            MatchPackWriter* pack_writer) {
   if (matches.num_matches == 0) {
     return false;
   }
@@ -248,6 +218,20 @@ static bool write_match_idc(const MatchResult& matches, const PairTask& pair,
     distances = matches.distances;
   }
 
+  if (pack_writer &&
+      !pack_writer->add_pair(pair.image1_index, pair.image2_index, indices_flat.data(),
+                             coords_flat.data(),
+                             pair.match_scales.size() == matches.num_matches * 2
+                                 ? pair.match_scales.data()
+                                 : nullptr,
+                             distances.data(), matches.num_matches)) {
+    LOG(ERROR) << "Failed to pack matches for pair " << pair.image1_index << " - "
+               << pair.image2_index;
+    return false;
+  }
+  if (!write_file)
+    return true;
+
   IDCWriter writer(output_file);
   writer.set_metadata(metadata);
   writer.add_blob("indices", indices_flat.data(), indices_flat.size() * sizeof(uint16_t), "uint16",
@@ -299,12 +283,12 @@ static std::vector<ImageCacheEntry> collect_unique_images(const std::vector<Pair
     if (image_to_cache_idx->find(task.image1_index) == image_to_cache_idx->end()) {
       const int idx = static_cast<int>(images.size());
       image_to_cache_idx->emplace(task.image1_index, idx);
-      images.push_back({task.image1_index, task.feature1_file, FeatureData(), ImageFeatures(), false});
+      images.push_back({task.image1_index, task.feature1_file, nullptr});
     }
     if (image_to_cache_idx->find(task.image2_index) == image_to_cache_idx->end()) {
       const int idx = static_cast<int>(images.size());
       image_to_cache_idx->emplace(task.image2_index, idx);
-      images.push_back({task.image2_index, task.feature2_file, FeatureData(), ImageFeatures(), false});
+      images.push_back({task.image2_index, task.feature2_file, nullptr});
     }
   }
   return images;
@@ -448,6 +432,8 @@ int main(int argc, char* argv[]) {
   int num_threads = -1;
   int sample_images = 256;
   int image_block_size = 1000;
+  int feature_cache_mb = 2048;
+  std::string pair_order = "locality";
   int hash_bits = 128;
   int bucket_groups = 6;
   int bucket_bits = 8;
@@ -458,20 +444,32 @@ int main(int argc, char* argv[]) {
   float ratio_test = 0.8f;
   uint32_t random_seed = 1337;
   std::string preset = "modern";
+  std::string output_format_str = "file";
+  int matchpack_block_size = 10000;
   std::string log_level;
 
-  cmd.add(make_option('i', pairs_json, "input").doc("Input pairs list (JSON format)"));
+  cmd.add(make_option('i', pairs_json, "input").doc("Input pairs list (.isat_pairs or JSON)"));
   cmd.add(make_option('o', output_dir, "output").doc("Output directory for .isat_match files"));
   cmd.add(make_option(0, output_pairs_json, "output-pairs-json")
-              .doc("Optional JSON path listing only pairs whose .isat_match files were written."));
+              .doc("Optional list of pairs whose matches were written "
+                   "(.isat_pairs = binary pair list, otherwise JSON)."));
   cmd.add(make_option('f', feature_dir, "feature-dir")
               .doc("Matching feature directory (.isat_feat files from isat_extract -o)"));
+  cmd.add(make_option(0, output_format_str, "output-format")
+              .doc("Output match format: file|matchpack|both (default: file)"));
+  cmd.add(make_option(0, matchpack_block_size, "matchpack-block-size")
+              .doc("Pairs per .isat_matchpack block (default: 10000)"));
   cmd.add(make_option('j', num_threads, "threads")
               .doc("Number of CPU threads (-1 = auto detect, default: -1)"));
   cmd.add(make_option(0, sample_images, "sample-images")
               .doc("Max unique images used to build global sample model (default: 256)"));
   cmd.add(make_option(0, image_block_size, "image-block-size")
               .doc("Max unique images per in-memory block (default: 1000)."));
+  cmd.add(make_option(0, feature_cache_mb, "feature-cache-mb")
+              .doc("Memory budget (MB) for hashed images kept across blocks (default: 2048)"));
+  cmd.add(make_option(0, pair_order, "pair-order")
+              .doc("Pair processing order: locality (graph traversal maximising image reuse "
+                   "across blocks) or input (default: locality)"));
   cmd.add(make_option(0, preset, "preset")
               .doc("Preset: legacy or modern (default: modern)"));
   cmd.add(make_option(0, hash_bits, "hash-bits").doc("Hash bit length (default: 128)"));
@@ -527,6 +525,24 @@ int main(int argc, char* argv[]) {
     LOG(ERROR) << "min-output-matches must be >= 0";
     return 1;
   }
+  if (feature_cache_mb < 0) {
+    LOG(ERROR) << "feature-cache-mb must be >= 0";
+    return 1;
+  }
+  if (pair_order != "locality" && pair_order != "input") {
+    LOG(ERROR) << "pair-order must be locality or input";
+    return 1;
+  }
+  if (output_format_str != "file" && output_format_str != "matchpack" &&
+      output_format_str != "both") {
+    LOG(ERROR) << "output-format must be file, matchpack, or both";
+    return 1;
+  }
+  if (matchpack_block_size <= 0) {
+    LOG(ERROR) << "matchpack-block-size must be > 0";
+    return 1;
+  }
+  const bool write_match_files = (output_format_str != "matchpack");
 
   insight::tools::apply_log_level(cmd.used('v'), cmd.used('q'), log_level);
 
@@ -588,6 +604,28 @@ int main(int argc, char* argv[]) {
   LOG(INFO) << "Built sample model from " << valid_sample_images << " images and "
             << total_sample_features << " descriptors in " << model_ms << " ms";
 
+  // Reorder after the sample model so the model (first sampled images) does not depend on it.
+  if (pair_order == "locality") {
+    std::vector<std::pair<uint32_t, uint32_t>> pair_ids;
+    pair_ids.reserve(pair_tasks.size());
+    for (const auto& task : pair_tasks) {
+      pair_ids.emplace_back(task.image1_index, task.image2_index);
+    }
+    insight::algorithm::matching::PairScheduleStats schedule_stats;
+    const std::vector<int> order =
+        insight::algorithm::matching::schedule_pairs_for_locality(pair_ids, &schedule_stats);
+    std::vector<PairTask> reordered;
+    reordered.reserve(pair_tasks.size());
+    for (int i : order) {
+      reordered.push_back(std::move(pair_tasks[static_cast<size_t>(i)]));
+    }
+    pair_tasks = std::move(reordered);
+    LOG(INFO) << "Pair schedule: " << schedule_stats.num_images << " images, bandwidth "
+              << schedule_stats.input_bandwidth << " -> " << schedule_stats.bandwidth;
+  }
+  FeatureCache<HashedImage> image_cache(static_cast<size_t>(feature_cache_mb) << 20,
+                                        hashed_image_bytes);
+
   const int queue_size = 16;
   auto match_start = std::chrono::high_resolution_clock::now();
   int preload_ms_total = 0;
@@ -618,8 +656,7 @@ int main(int argc, char* argv[]) {
       if (it1 == image_to_cache_idx.end()) {
         const int idx = static_cast<int>(runtime.image_cache.size());
         image_to_cache_idx.emplace(task.image1_index, idx);
-        runtime.image_cache.push_back(
-            {task.image1_index, task.feature1_file, FeatureData(), ImageFeatures(), false});
+        runtime.image_cache.push_back({task.image1_index, task.feature1_file, nullptr});
         task.image1_cache_idx = idx;
       } else {
         task.image1_cache_idx = it1->second;
@@ -629,8 +666,7 @@ int main(int argc, char* argv[]) {
       if (it2 == image_to_cache_idx.end()) {
         const int idx = static_cast<int>(runtime.image_cache.size());
         image_to_cache_idx.emplace(task.image2_index, idx);
-        runtime.image_cache.push_back(
-            {task.image2_index, task.feature2_file, FeatureData(), ImageFeatures(), false});
+        runtime.image_cache.push_back({task.image2_index, task.feature2_file, nullptr});
         task.image2_cache_idx = idx;
       } else {
         task.image2_cache_idx = it2->second;
@@ -639,15 +675,17 @@ int main(int argc, char* argv[]) {
 
     auto preload_start = std::chrono::high_resolution_clock::now();
     Stage preload_stage("PreloadBlockImages", num_threads, queue_size,
-                        [&runtime, &model](int index) {
+                        [&runtime, &model, &image_cache](int index) {
                           auto& entry = runtime.image_cache[static_cast<size_t>(index)];
-                          entry.features = load_features_idc(entry.feature_file);
-                          if (entry.features.num_features == 0) {
-                            entry.valid = false;
-                            return;
-                          }
-                          entry.image_features = compute_image_features(entry.features, model);
-                          entry.valid = true;
+                          entry.data = image_cache.acquire(entry.image_index, [&entry, &model] {
+                            auto image = std::make_shared<HashedImage>();
+                            image->features = load_features_idc(entry.feature_file);
+                            if (image->features.num_features == 0) {
+                              return std::shared_ptr<const HashedImage>();
+                            }
+                            image->image_features = compute_image_features(image->features, model);
+                            return std::shared_ptr<const HashedImage>(std::move(image));
+                          });
                         });
     preload_stage.setTaskCount(static_cast<int>(runtime.image_cache.size()));
     for (int i = 0; i < static_cast<int>(runtime.image_cache.size()); ++i) {
@@ -660,7 +698,7 @@ int main(int argc, char* argv[]) {
     runtime.unique_images = static_cast<int>(runtime.image_cache.size());
     runtime.valid_images = 0;
     for (const auto& entry : runtime.image_cache) {
-      if (entry.valid) {
+      if (entry.data) {
         ++runtime.valid_images;
       }
     }
@@ -697,11 +735,15 @@ int main(int argc, char* argv[]) {
                       [&pair_tasks, &runtime, &model, block_begin](int local_index) {
                         const int global_index = block_begin + local_index;
                         auto& task = pair_tasks[static_cast<size_t>(global_index)];
-                        const auto& left = runtime.image_cache[static_cast<size_t>(task.image1_cache_idx)];
-                        const auto& right = runtime.image_cache[static_cast<size_t>(task.image2_cache_idx)];
-                        if (!left.valid || !right.valid) {
+                        const auto& left_entry =
+                            runtime.image_cache[static_cast<size_t>(task.image1_cache_idx)];
+                        const auto& right_entry =
+                            runtime.image_cache[static_cast<size_t>(task.image2_cache_idx)];
+                        if (!left_entry.data || !right_entry.data) {
                           return;
                         }
+                        const HashedImage& left = *left_entry.data;
+                        const HashedImage& right = *right_entry.data;
                         task.matches = match_cascade_hash(left.features, left.image_features, right.features,
                                                           right.image_features, model);
                         task.match_scales = build_scales_flat(task.matches, left.features, right.features);
@@ -730,24 +772,41 @@ int main(int argc, char* argv[]) {
               << ", total_matches=" << block_total_matches;
   }
 
+  const FeatureCacheStats cache_stats = image_cache.stats();
+  LOG(INFO) << "Image cache: " << cache_stats.misses << " loads, " << cache_stats.hits
+            << " hits across blocks, peak " << (cache_stats.peak_bytes >> 20) << " MB";
+
   auto match_end = std::chrono::high_resolution_clock::now();
   const int match_time_s =
       std::chrono::duration_cast<std::chrono::seconds>(match_end - match_start).count();
 
+  std::unique_ptr<MatchPackWriter> pack_writer;
+  if (output_format_str != "file") {
+    json algorithm;
+    algorithm["name"] = "CASCADE_HASH_CPU";
+    algorithm["impl"] = "cpu_cascade_hash";
+    algorithm["version"] = "1.0";
+    pack_writer = std::make_unique<MatchPackWriter>(output_dir, matchpack_block_size, algorithm);
+  } else {
+    // File output only: drop a pack left by an earlier run, readers would prefer it.
+    MatchPackIndex::remove_from_dir(output_dir);
+  }
+
   auto write_start = std::chrono::high_resolution_clock::now();
   std::mutex written_pairs_mu;
   std::vector<std::pair<uint32_t, uint32_t>> written_pairs;
   written_pairs.reserve(static_cast<size_t>(total_pairs));
   Stage write_stage("WriteAllResultsAtEnd", num_threads, queue_size,
                     [&pair_tasks, &output_dir, min_output_matches, &written_pairs_mu,
-                     &written_pairs](int index) {
+                     &written_pairs, &pack_writer, write_match_files](int index) {
                       auto& task = pair_tasks[static_cast<size_t>(index)];
                       if (static_cast<int>(task.matches.num_matches) < min_output_matches) {
                         task.matches.clear();
                         task.match_scales.clear();
                         return;
                       }
-                      if (write_match_idc(task.matches, task, output_dir)) {
+                      if (write_match_idc(task.matches, task, output_dir, write_match_files,
+                                          pack_writer.get())) {
                         std::lock_guard<std::mutex> lock(written_pairs_mu);
                         written_pairs.emplace_back(task.image1_index, task.image2_index);
                       }
@@ -757,6 +816,14 @@ int main(int argc, char* argv[]) {
     write_stage.push(i);
   }
   write_stage.wait();
+  std::string matchpack_index_path;
+  if (pack_writer) {
+    matchpack_index_path = pack_writer->finish();
+    if (matchpack_index_path.empty()) {
+      print_event({{"type", "match.complete"}, {"ok", false}, {"error", "matchpack write failed"}});
+      return 1;
+    }
+  }
   auto write_end = std::chrono::high_resolution_clock::now();
   const int write_time_s =
       std::chrono::duration_cast<std::chrono::seconds>(write_end - write_start).count();
@@ -793,10 +860,15 @@ int main(int argc, char* argv[]) {
                  {"preload_images_ms", preload_ms_total},
                  {"unique_images_total", unique_images_total},
                  {"image_block_size", image_block_size},
+                 {"pair_order", pair_order},
+                 {"feature_loads", cache_stats.misses},
+                 {"feature_cache_hits", cache_stats.hits},
                  {"min_output_matches", min_output_matches},
                  {"blocks", block_count},
                  {"preset", preset},
                  {"output_dir", output_dir},
+                 {"output_format", output_format_str},
+                 {"matchpack_index", matchpack_index_path},
                  {"output_pairs_json", output_pairs_json}}}});
   return 0;
 }
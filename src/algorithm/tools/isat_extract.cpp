@@ -1,17 +1,23 @@
 /**
  * isat_extract.cpp
- * InsightAT Feature Extractor – GPU-accelerated SIFT extraction
+ * InsightAT Feature Extractor – GPU-accelerated SIFT extraction (CPU fallback)
  *
- * Reads an image list, extracts SIFT features per image (via SiftGPU),
+ * Reads an image list, extracts SIFT features per image (via SiftGPU/PopSift, or the
+ * multi-threaded CPU SIFT backend with --extract-backend cpu),
  * optionally outputs both matching and retrieval features (dual-output),
  * and writes .isat_feat files (IDC format).
  *
  * Pipeline (Stage/chain):
  *   Stage 1  [multi-thread I/O]   Load images (and resize for retrieval if dual-output)
  *   Stage 2  [main thread, GPU]   Extract SIFT features
+ *            [multi-thread, CPU]  --extract-backend cpu: one CpuSiftExtractor pass per worker
  *   Stage 3  [multi-thread]      Post-process (normalization, NMS, uint8)
  *   Stage 4  [multi-thread I/O]  Write .isat_feat
  *
+ * Decoded images between Stage 1 and the end of Stage 2 are bounded by --images-in-flight.
+ * Before Stage 1, images whose existing .isat_feat carries the same metadata.cache_key
+ * (image mtime/content + output parameters) are skipped; see --no-cache / --cache-key.
+ *
  * Output .isat_feat (IDC): keypoints, descriptors, metadata (feature_type, params).
  * Supports --output (matching) and --output-retrieval (dual-output or retrieval-only).
  *
@@ -20,17 +26,25 @@
  *   isat_extract -i image_list.txt -o feat_dir/ --output-retrieval retrieval_dir/
  */
 
+#include <algorithm>
+#include <cctype>
 #include <chrono>
+#include <condition_variable>
 #include <filesystem>
 #include <fstream>
 #include <glog/logging.h>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include <opencv2/opencv.hpp>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "../io/idc_reader.h"
 #include "../io/idc_writer.h"
+#include "../modules/extraction/cpu_sift_extractor.h"
 #include "../modules/extraction/sift_gpu_extractor.h"
 #include "cli_logging.h"
 #include "cmdLine/cmdLine.h"
@@ -46,6 +60,29 @@ static void printEvent(const json& j) {
   std::cout.flush();
 }
 
+/// Counting semaphore bounding the number of decoded images held by Stage 1 → Stage 2.
+class ImageBudget {
+public:
+  explicit ImageBudget(int n) : available_(n) {}
+  void acquire() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return available_ > 0; });
+    --available_;
+  }
+  void release() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++available_;
+    }
+    cv_.notify_one();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  int available_;
+};
+
 struct ImageTask {
   uint32_t image_index = 0; ///< Dense index 0..n-1 (output filename: {image_index}.isat_feat)
   uint32_t image_id = 0;    ///< Original id from project (for metadata/check only)
@@ -60,6 +97,8 @@ struct ImageTask {
   float image_retrieval_coord_scale_back = 1.0f; // for keypoint remap to original image
   int camera_id;
   int index;
+  std::string cache_key_matching;  ///< Extraction cache key stored in the .isat_feat metadata
+  std::string cache_key_retrieval;
 
   // SIFT features (128-dim)
   std::vector<SiftGPU::SiftKeypoint> keypoints;
@@ -101,6 +140,129 @@ std::vector<ImageTask> loadImageList(const std::string& json_path) {
   return tasks;
 }
 
+/// Stored (pre-EXIF-rotation) size from the JPEG SOFn header, without decoding.
+/// Returns false for non-JPEG or truncated files.
+static bool readJpegSize(const std::string& path, int* width, int* height) {
+  std::ifstream f(path, std::ios::binary);
+  unsigned char b[2];
+  if (!f.read(reinterpret_cast<char*>(b), 2) || b[0] != 0xFF || b[1] != 0xD8)
+    return false;
+  while (f) {
+    int c = f.get();
+    if (c != 0xFF)
+      continue;
+    int marker = f.get();
+    while (marker == 0xFF)
+      marker = f.get();
+    if (marker == EOF || marker == 0xD9 || marker == 0xDA)
+      return false; // EOI / SOS before any frame header
+    if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+      continue; // standalone markers
+    if (!f.read(reinterpret_cast<char*>(b), 2))
+      return false;
+    const int length = (b[0] << 8) | b[1];
+    const bool is_sof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 &&
+                        marker != 0xCC;
+    if (is_sof) {
+      unsigned char sof[5];
+      if (!f.read(reinterpret_cast<char*>(sof), 5))
+        return false;
+      *height = (sof[1] << 8) | sof[2];
+      *width = (sof[3] << 8) | sof[4];
+      return *width > 0 && *height > 0;
+    }
+    f.seekg(length - 2, std::ios::cur);
+  }
+  return false;
+}
+
+/// Largest libjpeg DCT scale denominator (8/4/2/1) whose decoded long edge
+/// ceil(full / d) still covers required_max_dim.
+static int jpegReductionFactor(int full_max_dim, int required_max_dim) {
+  for (int d : {8, 4, 2}) {
+    if ((full_max_dim + d - 1) / d >= required_max_dim)
+      return d;
+  }
+  return 1;
+}
+
+// ─────────────────────────────────────────────────────────────────────────────
+// Extraction cache: every .isat_feat records metadata.cache_key = hash(image signature,
+// output parameters). A re-run skips images whose existing outputs carry the same key.
+// ─────────────────────────────────────────────────────────────────────────────
+
+static uint64_t fnv1a64(const void* data, size_t size, uint64_t h = 0xcbf29ce484222325ull) {
+  const auto* p = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    h ^= p[i];
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+static std::string hex64(uint64_t v) {
+  char buf[17];
+  std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(v));
+  return buf;
+}
+
+/// "mtime": path + size + mtime (no read); "content": hash of the file bytes.
+/// Returns "" when the image cannot be stat'ed / read (never a cache hit).
+static std::string imageSignature(const std::string& path, const std::string& mode) {
+  std::error_code ec;
+  const auto size = fs::file_size(path, ec);
+  if (ec)
+    return "";
+  if (mode == "content") {
+    std::ifstream f(path, std::ios::binary);
+    if (!f)
+      return "";
+    std::vector<char> buf(1 << 20);
+    uint64_t h = fnv1a64(nullptr, 0);
+    while (f) {
+      f.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+      h = fnv1a64(buf.data(), static_cast<size_t>(f.gcount()), h);
+    }
+    return "content:" + std::to_string(size) + ":" + hex64(h);
+  }
+  const auto mtime = fs::last_write_time(path, ec);
+  if (ec)
+    return "";
+  return "mtime:" + path + ":" + std::to_string(size) + ":" +
+         std::to_string(mtime.time_since_epoch().count());
+}
+
+static std::string cacheKey(const std::string& image_signature, const json& output_params) {
+  if (image_signature.empty())
+    return "";
+  const std::string params = output_params.dump();
+  return hex64(fnv1a64(params.data(), params.size(),
+                       fnv1a64(image_signature.data(), image_signature.size())));
+}
+
+/// metadata.cache_key of an existing .isat_feat ("" if missing/unreadable); header only.
+static std::string cachedFeatureKey(const std::string& feat_path, bool* low_peak_matching) {
+  std::error_code ec;
+  if (!fs::is_regular_file(feat_path, ec))
+    return "";
+  insight::io::IDCReader reader(feat_path, insight::io::IDCReadMode::kMapped);
+  if (!reader.is_valid())
+    return "";
+  const auto& meta = reader.get_metadata();
+  if (!meta.contains("metadata") || !meta["metadata"].is_object())
+    return "";
+  if (low_peak_matching)
+    *low_peak_matching = meta["metadata"].value("low_peak_matching", false);
+  return meta["metadata"].value("cache_key", std::string());
+}
+
+static bool isJpegPath(const std::string& path) {
+  std::string ext = fs::path(path).extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return ext == ".jpg" || ext == ".jpeg" || ext == ".jpe" || ext == ".jfif";
+}
+
 int main(int argc, char* argv[]) {
   // Initialize glog
   google::InitGoogleLogging(argv[0]);
@@ -159,9 +321,24 @@ int main(int argc, char* argv[]) {
   bool use_pop_sift = false;
   bool use_sift_gpu = false;
   cmd.add(make_option(0, extract_backend, "extract-backend")
-              .doc("[SIFT] GPU backend: cuda or glsl (default: cuda when built with CUDA)"));
+              .doc("[SIFT] Backend: cuda, glsl or cpu (default: cuda when built with CUDA)"));
   cmd.add(make_switch(0, "use-pop-sift").doc("[SIFT] Use PopSift extractor implementation"));
   cmd.add(make_switch(0, "use-sift-gpu").doc("[SIFT] Force use SiftGPU extractor implementation"));
+  int cpu_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+  int images_in_flight = 0;
+  cmd.add(make_option(0, cpu_threads, "cpu-threads")
+              .doc("[SIFT] Extraction worker threads for --extract-backend cpu (default: all cores)"));
+  cmd.add(make_switch(0, "no-jpeg-scaled-decode")
+              .doc("Always decode JPEGs at full resolution (default: DCT-scaled 1/2, 1/4, 1/8 "
+                   "decode when --image-max-dim / --resize-retrieval allow it)"));
+  std::string cache_key_mode = "mtime";
+  cmd.add(make_switch(0, "no-cache")
+              .doc("Re-extract every image even if its .isat_feat is up to date"));
+  cmd.add(make_option(0, cache_key_mode, "cache-key")
+              .doc("Extraction cache key: mtime (path+size+mtime, default) or content (file hash)"));
+  cmd.add(make_option(0, images_in_flight, "images-in-flight")
+              .doc("Max decoded images held between load and extraction (default: 0 = auto; "
+                   "cpu: 2 x cpu-threads, gpu: threads + 5). Bounds peak memory"));
 
   // Descriptor options
   cmd.add(make_option(0, normalization, "norm")
@@ -228,13 +405,31 @@ int main(int argc, char* argv[]) {
   // Process switches
   bool adapt_darkness = !cmd.used("no-adapt");
   bool use_uint8 = cmd.used("uint8");
+  bool jpeg_scaled_decode = !cmd.used("no-jpeg-scaled-decode");
+  bool use_cache = !cmd.used("no-cache");
+  if (cache_key_mode != "mtime" && cache_key_mode != "content") {
+    std::cerr << "Error: --cache-key must be mtime or content\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
   bool enable_nms = cmd.used("nms");
   bool nms_keep_orientation = !cmd.used("nms-no-orient");
 
   // Set logging level
   insight::tools::apply_log_level(cmd.used('v'), cmd.used('q'), log_level);
 
+  if (extract_backend != "cuda" && extract_backend != "glsl" && extract_backend != "cpu") {
+    std::cerr << "Error: --extract-backend must be cuda, glsl or cpu\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
   bool use_cuda_extract = (extract_backend == "cuda");
+  bool use_cpu_extract = (extract_backend == "cpu");
+  if (cpu_threads < 1 || images_in_flight < 0) {
+    std::cerr << "Error: --cpu-threads must be >= 1 and --images-in-flight >= 0\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
   use_pop_sift = cmd.used("use-pop-sift");
   use_sift_gpu = cmd.used("use-sift-gpu");
 
@@ -275,14 +470,36 @@ int main(int argc, char* argv[]) {
   sift_params_retrieval.truncate_method = 1;
   sift_params_retrieval.image_max_dimension = image_max_dim;
 
+  auto to_cpu_params = [](const insight::modules::SiftGPUParams& p) {
+    insight::modules::CpuSiftParams c;
+    c.n_octave_from = p.n_octave_from;
+    c.n_octaves = p.n_octaves;
+    c.n_level = p.n_level;
+    c.d_peak = p.d_peak;
+    c.n_max_features = p.n_max_features;
+    c.adapt_darkness = p.adapt_darkness;
+    c.image_max_dimension = p.image_max_dimension;
+    return c;
+  };
+  const std::string extractor_impl =
+      use_cpu_extract ? "cpu_sift" : (use_pop_sift ? "popsift" : "sift_gpu");
+  const std::string extractor_name =
+      use_cpu_extract ? "CPU_SIFT" : (use_pop_sift ? "POP_SIFT" : "SIFT_GPU");
+
   // Log configuration
   LOG(INFO) << "Feature extraction configuration:";
-  LOG(INFO) << "  SIFT extract backend: " << (use_cuda_extract ? "cuda" : "glsl");
-  LOG(INFO) << "  SIFT implementation: " << (use_pop_sift ? "popsift" : "sift_gpu");
+  LOG(INFO) << "  SIFT extract backend: " << extract_backend;
+  LOG(INFO) << "  SIFT implementation: " << extractor_impl;
+  if (use_cpu_extract) {
+    LOG(INFO) << "  CPU SIFT threads: " << cpu_threads
+              << " (AVX2: " << (insight::modules::CpuSiftExtractor::simd_enabled() ? "yes" : "no")
+              << ")";
+  }
   LOG(INFO) << "  SIFT first octave (-fo): " << sift_params.n_octave_from << " (octaves=" << octaves
             << ", levels per octave=" << levels << ")";
   LOG(INFO) << "  SIFT threshold: " << threshold;
   LOG(INFO) << "  SIFT image max dim: " << image_max_dim;
+  LOG(INFO) << "  JPEG scaled decode: " << (jpeg_scaled_decode ? "yes" : "no");
   LOG(INFO) << "  Normalization: " << normalization;
   LOG(INFO) << "  uint8 format: " << (use_uint8 ? "yes" : "no");
   LOG(INFO) << "  NMS enabled: " << (enable_nms ? "yes" : "no");
@@ -324,164 +541,307 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
+  const int IO_QUEUE_SIZE = 10;
+  const int IO_QUEUE_SIZE_CACHE = 64;
+
   // Snapshot image_index per task order (writeStage clears tasks).
   std::vector<uint32_t> image_index_snapshot(static_cast<size_t>(total_images));
   for (int i = 0; i < total_images; ++i)
     image_index_snapshot[static_cast<size_t>(i)] = image_tasks[static_cast<size_t>(i)].image_index;
   std::vector<uint8_t> matching_used_low_peak(static_cast<size_t>(total_images), 0);
 
+  // Everything that changes the bytes of an output file goes into its cache key.
+  json common_cache_params = {{"cache_format", 1},
+                              {"extractor_impl", extractor_impl},
+                              {"extract_backend", extract_backend},
+                              {"octaves", octaves},
+                              {"levels", levels},
+                              {"threshold", threshold},
+                              {"adapt_darkness", adapt_darkness},
+                              {"normalization", normalization},
+                              {"uint8", use_uint8},
+                              {"nms", enable_nms},
+                              {"nms_radius", enable_nms ? nms_radius : 0.0f},
+                              {"nms_keep_orientation", enable_nms && nms_keep_orientation},
+                              {"jpeg_scaled_decode", jpeg_scaled_decode}};
+  json matching_cache_params = common_cache_params;
+  matching_cache_params["output"] = "matching";
+  matching_cache_params["nfeatures"] = nfeatures;
+  matching_cache_params["image_max_dim"] = image_max_dim;
+  matching_cache_params["low_peak_min_features"] = 10000;
+  json retrieval_cache_params = common_cache_params;
+  retrieval_cache_params["output"] = "retrieval";
+  retrieval_cache_params["nfeatures"] = nfeatures_retrieval;
+  retrieval_cache_params["resize_retrieval"] = resize_retrieval;
+
+  // Cache lookup (parallel, header-only reads): only stale images enter the Stage chain.
+  std::vector<uint8_t> cache_hit(static_cast<size_t>(total_images), 0);
+  {
+    Stage cacheStage("CacheCheck", io_threads, IO_QUEUE_SIZE_CACHE, [&](int index) {
+      auto& task = image_tasks[static_cast<size_t>(index)];
+      const std::string sig = imageSignature(task.image_path, cache_key_mode);
+      const std::string base_filename = std::to_string(task.image_index) + ".isat_feat";
+      bool hit = use_cache;
+      if (process_matching) {
+        task.cache_key_matching = cacheKey(sig, matching_cache_params);
+        bool low = false;
+        hit = hit && !task.cache_key_matching.empty() &&
+              cachedFeatureKey((fs::path(output_dir) / base_filename).string(), &low) ==
+                  task.cache_key_matching;
+        if (hit)
+          matching_used_low_peak[static_cast<size_t>(index)] = low ? 1 : 0;
+      }
+      if (process_retrieval) {
+        task.cache_key_retrieval = cacheKey(sig, retrieval_cache_params);
+        hit = hit && !task.cache_key_retrieval.empty() &&
+              cachedFeatureKey((fs::path(output_retrieval_dir) / base_filename).string(),
+                               nullptr) == task.cache_key_retrieval;
+      }
+      cache_hit[static_cast<size_t>(index)] = hit ? 1 : 0;
+    });
+    cacheStage.setTaskCount(total_images);
+    for (int i = 0; i < total_images; ++i)
+      cacheStage.push(i);
+    cacheStage.wait();
+  }
+  std::vector<int> stale_indices;
+  for (int i = 0; i < total_images; ++i) {
+    if (!cache_hit[static_cast<size_t>(i)])
+      stale_indices.push_back(i);
+  }
+  const int cache_hits = total_images - static_cast<int>(stale_indices.size());
+  const int cache_misses = static_cast<int>(stale_indices.size());
+  LOG(INFO) << "Extraction cache: " << cache_hits << " hit(s), " << cache_misses
+            << " miss(es)" << (use_cache ? "" : " (--no-cache)");
+
   // Create pipeline stages
-  const int IO_QUEUE_SIZE = 10;
   const int GPU_QUEUE_SIZE = 5;
+  if (images_in_flight == 0)
+    images_in_flight = use_cpu_extract ? 2 * cpu_threads : io_threads + GPU_QUEUE_SIZE;
+  LOG(INFO) << "  Images in flight: " << images_in_flight;
+  ImageBudget image_budget(images_in_flight);
 
   // Stage 1: Image loading (multi-threaded I/O)
-  Stage imageLoadStage("ImageLoad", io_threads, IO_QUEUE_SIZE,
-                       [&image_tasks, process_retrieval, resize_retrieval, image_max_dim](int index) {
-                         auto& task = image_tasks[index];
-                         cv::Mat image = cv::imread(task.image_path, cv::IMREAD_UNCHANGED);
-                         if (image.empty()) {
-                           LOG(ERROR) << "Failed to load image: " << task.image_path;
-                           return;
-                         }
-                         LOG(INFO) << "Loaded image [" << index << "]: " << task.image_path << " ("
-                                   << image.cols << "x" << image.rows << ")";
-                         task.image_cols = image.cols;
-                         task.image_rows = image.rows;
-                         task.image_coord_scale_back = 1.0f;
-
-                         // Prepare matching image for extraction (CPU stage), then remap keypoints later.
-                         task.image = image;
-                         const int match_max_dim = std::max(task.image.cols, task.image.rows);
-                         if (image_max_dim > 0 && match_max_dim > image_max_dim) {
-                           const float scale = static_cast<float>(image_max_dim) / match_max_dim;
-                           cv::Mat image_resized;
-                           cv::resize(task.image, image_resized, cv::Size(), scale, scale, cv::INTER_AREA);
-                           task.image = std::move(image_resized);
-                           task.image_coord_scale_back = 1.0f / scale;
-                           LOG(INFO) << "  Resized for matching: " << task.image.cols << "x"
-                                     << task.image.rows << " (scale_back="
-                                     << task.image_coord_scale_back << ")";
-                         }
-
-                         // Prepare retrieval image if needed (dual-output or retrieval-only)
-                         if (process_retrieval) {
-                           int max_dim = std::max(image.rows, image.cols);
-                           if (max_dim > resize_retrieval) {
-                             float scale = static_cast<float>(resize_retrieval) / max_dim;
-                             cv::Mat image_resized;
-                             cv::resize(image, image_resized, cv::Size(), scale, scale,
-                                        cv::INTER_AREA);
-                             task.image_retrieval = image_resized;
-                             task.image_retrieval_coord_scale_back = 1.0f / scale;
-                             LOG(INFO) << "  Resized for retrieval: " << image_resized.cols << "x"
-                                       << image_resized.rows << " (scale_back="
-                                       << task.image_retrieval_coord_scale_back << ")";
-                           } else {
-                             task.image_retrieval = image.clone();
-                             task.image_retrieval_coord_scale_back = 1.0f;
-                             LOG(INFO) << "  Retrieval image (no resize needed): " << image.cols
-                                       << "x" << image.rows;
-                           }
-                         }
-                       });
+  Stage imageLoadStage(
+      "ImageLoad", io_threads, IO_QUEUE_SIZE,
+      [&image_tasks, &image_budget, process_matching, process_retrieval, resize_retrieval,
+       image_max_dim, jpeg_scaled_decode](int index) {
+        auto& task = image_tasks[index];
+        // Released by Stage 2 once the decoded images are dropped.
+        image_budget.acquire();
+
+        // JPEG: pick the coarsest DCT-domain scale (1/2, 1/4, 1/8) whose decode still covers
+        // every requested output size, so large frames are never decoded at full resolution.
+        // decode_factor maps decoded pixels back to full resolution (x_full = x * factor
+        // in the +0.5 pixel-center keypoint convention).
+        int full_cols = 0;
+        int full_rows = 0;
+        int decode_factor = 1;
+        if (jpeg_scaled_decode && isJpegPath(task.image_path) &&
+            readJpegSize(task.image_path, &full_cols, &full_rows)) {
+          const int full_max_dim = std::max(full_cols, full_rows);
+          int required = 0;
+          if (process_matching)
+            required = image_max_dim > 0 ? std::min(full_max_dim, image_max_dim) : full_max_dim;
+          if (process_retrieval)
+            required = std::max(required, std::min(full_max_dim, resize_retrieval));
+          decode_factor = jpegReductionFactor(full_max_dim, required);
+        }
+
+        cv::Mat image;
+        if (decode_factor > 1) {
+          // REDUCED_COLOR applies EXIF orientation by default; IMREAD_UNCHANGED does not.
+          const int reduced_flag = decode_factor == 8   ? cv::IMREAD_REDUCED_COLOR_8
+                                   : decode_factor == 4 ? cv::IMREAD_REDUCED_COLOR_4
+                                                        : cv::IMREAD_REDUCED_COLOR_2;
+          image = cv::imread(task.image_path, reduced_flag | cv::IMREAD_IGNORE_ORIENTATION);
+        } else {
+          image = cv::imread(task.image_path, cv::IMREAD_UNCHANGED);
+        }
+        if (image.empty()) {
+          LOG(ERROR) << "Failed to load image: " << task.image_path;
+          return;
+        }
+        if (decode_factor == 1) {
+          full_cols = image.cols;
+          full_rows = image.rows;
+        }
+        LOG(INFO) << "Loaded image [" << index << "]: " << task.image_path << " (" << full_cols
+                  << "x" << full_rows << ")";
+        if (decode_factor > 1)
+          LOG(INFO) << "  DCT-scaled decode 1/" << decode_factor << ": " << image.cols << "x"
+                    << image.rows;
+        task.image_cols = full_cols;
+        task.image_rows = full_rows;
+        const int full_max_dim = std::max(full_cols, full_rows);
+
+        // Resize from the decoded image so that the result's long edge is target_max_dim
+        // (relative to full resolution); returns the full-resolution coordinate scale-back.
+        auto prepare = [&](int target_max_dim, cv::Mat* out, bool share) {
+          const float full_scale = static_cast<float>(target_max_dim) / full_max_dim;
+          const float decoded_scale = full_scale * decode_factor;
+          if (target_max_dim > 0 && full_max_dim > target_max_dim && decoded_scale < 1.0f) {
+            cv::resize(image, *out, cv::Size(), decoded_scale, decoded_scale, cv::INTER_AREA);
+            return decode_factor / decoded_scale;
+          }
+          *out = share ? image : image.clone();
+          return static_cast<float>(decode_factor);
+        };
+
+        // Prepare matching image for extraction (CPU stage), then remap keypoints later.
+        task.image_coord_scale_back = 1.0f;
+        if (process_matching) {
+          task.image_coord_scale_back = prepare(image_max_dim, &task.image, true);
+          if (task.image_coord_scale_back != 1.0f) {
+            LOG(INFO) << "  Resized for matching: " << task.image.cols << "x" << task.image.rows
+                      << " (scale_back=" << task.image_coord_scale_back << ")";
+          }
+        }
+
+        // Prepare retrieval image if needed (dual-output or retrieval-only)
+        if (process_retrieval) {
+          task.image_retrieval_coord_scale_back =
+              prepare(resize_retrieval, &task.image_retrieval, false);
+          LOG(INFO) << "  Retrieval image: " << task.image_retrieval.cols << "x"
+                    << task.image_retrieval.rows
+                    << " (scale_back=" << task.image_retrieval_coord_scale_back << ")";
+        }
+      });
 
   // Stage 2: Feature extraction (GPU/CPU, backend-specific)
-  // SIFT GPU extraction
-  {
-    insight::modules::SiftGPUExtractor extractor(sift_params);
-    if (!extractor.initialize()) {
-      LOG(FATAL) << "Failed to initialize SiftGPU";
+  // Shared per-image body; extract(pass, image, keypoints, descriptors) runs one SIFT pass
+  // on the backend and returns the feature count.
+  enum class SiftPass { kMatching, kMatchingLowPeak, kRetrieval };
+  auto extract_task = [&image_tasks, &image_budget, process_matching, process_retrieval,
+                       &matching_used_low_peak](int index, const auto& extract) {
+    auto& task = image_tasks[index];
+    auto start = std::chrono::high_resolution_clock::now();
+
+    int num_features_matching = 0;
+    int num_features_retrieval = 0;
+
+    // Extract matching features from original image
+    // 这里期望特征点不少于1w，如果少的话， 就调整threshold
+    if (process_matching && !task.image.empty()) {
+      num_features_matching =
+          extract(SiftPass::kMatching, task.image, task.keypoints, task.descriptors);
+      if (num_features_matching < 10000) {
+        num_features_matching =
+            extract(SiftPass::kMatchingLowPeak, task.image, task.keypoints, task.descriptors);
+        matching_used_low_peak[static_cast<size_t>(index)] = 1;
+      }
+      if (task.image_coord_scale_back != 1.0f) {
+        for (auto& kp : task.keypoints) {
+          kp.x *= task.image_coord_scale_back;
+          kp.y *= task.image_coord_scale_back;
+          kp.s *= task.image_coord_scale_back;
+        }
+      }
+      task.image.release(); // Free original image memory
     }
-    LOG(INFO) << "SiftGPU initialized successfully";
-    LOG(INFO) << "SiftGPU parameters: " << sift_params.n_octave_from << " " << sift_params.n_octaves
-              << " " << sift_params.n_level << " " << sift_params.d_peak << " "
-              << sift_params.n_max_features << " " << sift_params.adapt_darkness << " "
-              << sift_params.use_cuda << " " << sift_params.truncate_method << " "
-              << sift_params.image_max_dimension;
-              
-    StageCurrent siftGPUStage(
-        "SiftGPU", 1, GPU_QUEUE_SIZE,
-        [&image_tasks, &extractor, &sift_params, &lowThreshold_sift_params, &sift_params_retrieval,
-         process_matching, process_retrieval, &matching_used_low_peak](int index) {
-          auto& task = image_tasks[index];
-          auto start = std::chrono::high_resolution_clock::now();
-
-          int num_features_matching = 0;
-          int num_features_retrieval = 0;
-
-          // Extract matching features from original image
-          // 这里期望特征点不少于1w，如果少的话， 就调整threshold
-          if (process_matching && !task.image.empty()) {
-            // Configure for matching features (high count)
-            if (!extractor.reconfigure(sift_params)) {
-              LOG(ERROR) << "Failed to reconfigure SiftGPU for matching features";
-              exit(1);
-            }
 
-            num_features_matching = extractor.extract(task.image, task.keypoints, task.descriptors);
-            if (num_features_matching < 10000) {
-              if (!extractor.reconfigure(lowThreshold_sift_params)) {
-                LOG(ERROR) << "Failed to reconfigure SiftGPU for matching features";
-                exit(1);
-              }
-              num_features_matching =
-                  extractor.extract(task.image, task.keypoints, task.descriptors);
-              matching_used_low_peak[static_cast<size_t>(index)] = 1;
-            }
-            if (task.image_coord_scale_back != 1.0f) {
-              for (auto& kp : task.keypoints) {
-                kp.x *= task.image_coord_scale_back;
-                kp.y *= task.image_coord_scale_back;
-                kp.s *= task.image_coord_scale_back;
-              }
-            }
-            task.image.release(); // Free original image memory
-          }
+    // Extract retrieval features from resized image
+    if (process_retrieval && !task.image_retrieval.empty()) {
+      num_features_retrieval = extract(SiftPass::kRetrieval, task.image_retrieval,
+                                       task.keypoints_retrieval, task.descriptors_retrieval);
+      task.image_retrieval_cols = task.image_cols;
+      task.image_retrieval_rows = task.image_rows;
+      if (task.image_retrieval_coord_scale_back != 1.0f) {
+        for (auto& kp : task.keypoints_retrieval) {
+          kp.x *= task.image_retrieval_coord_scale_back;
+          kp.y *= task.image_retrieval_coord_scale_back;
+          kp.s *= task.image_retrieval_coord_scale_back;
+        }
+      }
+      task.image_retrieval.release(); // Free resized image memory
+    }
+    task.image.release();
+    task.image_retrieval.release();
+    image_budget.release(); // acquired in Stage 1
 
-          // Extract retrieval features from resized image
-          if (process_retrieval && !task.image_retrieval.empty()) {
-            // Reconfigure for retrieval features (lower count)
-            extractor.reconfigure(sift_params_retrieval);
-
-            num_features_retrieval = extractor.extract(
-                task.image_retrieval, task.keypoints_retrieval, task.descriptors_retrieval);
-            task.image_retrieval_cols = task.image_cols;
-            task.image_retrieval_rows = task.image_rows;
-            if (task.image_retrieval_coord_scale_back != 1.0f) {
-              for (auto& kp : task.keypoints_retrieval) {
-                kp.x *= task.image_retrieval_coord_scale_back;
-                kp.y *= task.image_retrieval_coord_scale_back;
-                kp.s *= task.image_retrieval_coord_scale_back;
-              }
-            }
-            task.image_retrieval.release(); // Free resized image memory
-          }
+    auto end = std::chrono::high_resolution_clock::now();
+    int exec_time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
-          auto end = std::chrono::high_resolution_clock::now();
-          int exec_time =
-              std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    if (process_matching && num_features_matching == 0) {
+      LOG(WARNING) << "No matching features extracted from [" << index << "] - "
+                   << task.image_path;
+    }
+    if (process_retrieval && num_features_retrieval == 0) {
+      LOG(WARNING) << "No retrieval features extracted from [" << index << "] - "
+                   << task.image_path;
+    }
 
-          if (process_matching && num_features_matching == 0) {
-            LOG(WARNING) << "No matching features extracted from [" << index << "] - "
-                         << task.image_path;
-          }
-          if (process_retrieval && num_features_retrieval == 0) {
-            LOG(WARNING) << "No retrieval features extracted from [" << index << "] - "
-                         << task.image_path;
-          }
+    if (process_matching && process_retrieval) {
+      LOG(INFO) << "Extracted [" << index << "] in " << exec_time
+                << "ms: " << num_features_matching << " matching, " << num_features_retrieval
+                << " retrieval features";
+    } else if (process_matching) {
+      LOG(INFO) << "Extracted " << num_features_matching << " matching features from [" << index
+                << "] in " << exec_time << "ms";
+    } else {
+      LOG(INFO) << "Extracted " << num_features_retrieval << " retrieval features from ["
+                << index << "] in " << exec_time << "ms";
+    }
+  };
+
+  if (!stale_indices.empty()) {
+    const int num_stale = static_cast<int>(stale_indices.size());
+    // GPU: SiftGPU needs its context on the main thread (StageCurrent, one image at a time,
+    // reconfigured per pass). CPU: independent const extractors shared by a worker pool.
+    std::unique_ptr<insight::modules::SiftGPUExtractor> gpu_extractor;
+    std::unique_ptr<StageCurrent> siftGPUStage;
+    std::unique_ptr<Stage> cpuSiftStage;
+    const insight::modules::CpuSiftExtractor cpu_extractor(to_cpu_params(sift_params));
+    const insight::modules::CpuSiftExtractor cpu_extractor_low(
+        to_cpu_params(lowThreshold_sift_params));
+    const insight::modules::CpuSiftExtractor cpu_extractor_retrieval(
+        to_cpu_params(sift_params_retrieval));
+
+    if (use_cpu_extract) {
+      cpuSiftStage = std::make_unique<Stage>(
+          "CpuSift", cpu_threads, images_in_flight,
+          [&extract_task, &cpu_extractor, &cpu_extractor_low, &cpu_extractor_retrieval](int index) {
+            extract_task(index, [&](SiftPass pass, const cv::Mat& image,
+                                    std::vector<SiftGPU::SiftKeypoint>& keypoints,
+                                    std::vector<float>& descriptors) {
+              const auto& ex = pass == SiftPass::kMatching         ? cpu_extractor
+                               : pass == SiftPass::kMatchingLowPeak ? cpu_extractor_low
+                                                                    : cpu_extractor_retrieval;
+              return ex.extract(image, keypoints, descriptors);
+            });
+          });
+    } else {
+      gpu_extractor = std::make_unique<insight::modules::SiftGPUExtractor>(sift_params);
+      if (!gpu_extractor->initialize()) {
+        LOG(FATAL) << "Failed to initialize SiftGPU";
+      }
+      LOG(INFO) << "SiftGPU initialized successfully";
+      LOG(INFO) << "SiftGPU parameters: " << sift_params.n_octave_from << " "
+                << sift_params.n_octaves << " " << sift_params.n_level << " "
+                << sift_params.d_peak << " " << sift_params.n_max_features << " "
+                << sift_params.adapt_darkness << " " << sift_params.use_cuda << " "
+                << sift_params.truncate_method << " " << sift_params.image_max_dimension;
+
+      auto& extractor = *gpu_extractor;
+      siftGPUStage = std::make_unique<StageCurrent>(
+          "SiftGPU", 1, GPU_QUEUE_SIZE,
+          [&extract_task, &extractor, &sift_params, &lowThreshold_sift_params,
+           &sift_params_retrieval](int index) {
+            extract_task(index, [&](SiftPass pass, const cv::Mat& image,
+                                    std::vector<SiftGPU::SiftKeypoint>& keypoints,
+                                    std::vector<float>& descriptors) {
+              const auto& params = pass == SiftPass::kMatching         ? sift_params
+                                   : pass == SiftPass::kMatchingLowPeak ? lowThreshold_sift_params
+                                                                        : sift_params_retrieval;
+              if (!extractor.reconfigure(params) && pass != SiftPass::kRetrieval) {
+                LOG(ERROR) << "Failed to reconfigure SiftGPU for matching features";
+                exit(1);
+              }
+              return extractor.extract(image, keypoints, descriptors);
+            });
+          });
+    }
 
-          if (process_matching && process_retrieval) {
-            LOG(INFO) << "Extracted [" << index << "] in " << exec_time
-                      << "ms: " << num_features_matching << " matching, " << num_features_retrieval
-                      << " retrieval features";
-          } else if (process_matching) {
-            LOG(INFO) << "Extracted " << num_features_matching << " matching features from ["
-                      << index << "] in " << exec_time << "ms";
-          } else {
-            LOG(INFO) << "Extracted " << num_features_retrieval << " retrieval features from ["
-                      << index << "] in " << exec_time << "ms";
-          }
-        });
     // Stage 3: CPU post-processing (normalization, distribution, uint8 conversion)
     Stage postProcessStage(
         "PostProcess", io_threads, IO_QUEUE_SIZE,
@@ -547,7 +907,7 @@ int main(int argc, char* argv[]) {
         "WriteIDC", io_threads, IO_QUEUE_SIZE,
         [&output_dir, &output_retrieval_dir, &image_tasks, use_uint8, enable_nms, normalization,
          nms_radius, nms_keep_orientation, &sift_params, &sift_params_retrieval, process_matching,
-         process_retrieval, use_pop_sift](int index) {
+         process_retrieval, &extractor_impl, &extractor_name, &matching_used_low_peak](int index) {
           auto& task = image_tasks[index];
 
           // Use image_index for output filename: {image_index}.isat_feat
@@ -559,7 +919,7 @@ int main(int argc, char* argv[]) {
                                     const std::vector<float>& descriptors,
                                     const std::vector<unsigned char>& descriptors_uchar,
                                     const insight::modules::SiftGPUParams& params,
-                                    const std::string& feature_type) {
+                                    const std::string& feature_type, const json& cache_meta) {
             if (keypoints.empty())
               return false;
 
@@ -575,7 +935,7 @@ int main(int argc, char* argv[]) {
             params_json["uint8"] = use_uint8;
             params_json["nms_enabled"] = enable_nms;
             params_json["feature_type"] = feature_type; // "matching" or "retrieval"
-            params_json["extractor_impl"] = use_pop_sift ? "popsift" : "sift_gpu";
+            params_json["extractor_impl"] = extractor_impl;
             if (enable_nms) {
               params_json["nms_radius"] = nms_radius;
               params_json["nms_keep_orientation"] = nms_keep_orientation;
@@ -589,11 +949,11 @@ int main(int argc, char* argv[]) {
             schema.normalization = normalization;
             schema.quantization_scale = use_uint8 ? 512.0f : 1.0f;
 
-            const std::string extractor_name = use_pop_sift ? "POP_SIFT" : "SIFT_GPU";
             auto metadata =
                 insight::io::create_feature_metadata(task.image_path, extractor_name,
                                                      "1.2", // Version bump for dual-output support
                                                      params_json, schema, 0);
+            metadata["metadata"].update(cache_meta);
 
             writer.set_metadata(metadata);
 
@@ -626,7 +986,10 @@ int main(int argc, char* argv[]) {
           if (process_matching) {
             std::string output_path = (fs::path(output_dir) / base_filename).string();
             if (write_features(output_path, task.keypoints, task.descriptors,
-                               task.descriptors_uchar, sift_params, "matching")) {
+                               task.descriptors_uchar, sift_params, "matching",
+                               {{"cache_key", task.cache_key_matching},
+                                {"low_peak_matching",
+                                 matching_used_low_peak[static_cast<size_t>(index)] != 0}})) {
               LOG(INFO) << "Written matching features [" << index << "]: " << output_path;
             }
           }
@@ -636,7 +999,7 @@ int main(int argc, char* argv[]) {
             std::string output_path = (fs::path(output_retrieval_dir) / base_filename).string();
             if (write_features(output_path, task.keypoints_retrieval, task.descriptors_retrieval,
                                task.descriptors_uchar_retrieval, sift_params_retrieval,
-                               "retrieval")) {
+                               "retrieval", {{"cache_key", task.cache_key_retrieval}})) {
               LOG(INFO) << "Written retrieval features [" << index << "]: " << output_path;
             }
           }
@@ -649,31 +1012,43 @@ int main(int argc, char* argv[]) {
         });
 
     // Chain stages
-    chain(imageLoadStage, siftGPUStage);
-    chain(siftGPUStage, postProcessStage);
+    if (use_cpu_extract) {
+      chain(imageLoadStage, *cpuSiftStage);
+      chain(*cpuSiftStage, postProcessStage);
+      cpuSiftStage->setTaskCount(num_stale);
+    } else {
+      chain(imageLoadStage, *siftGPUStage);
+      chain(*siftGPUStage, postProcessStage);
+      siftGPUStage->setTaskCount(num_stale);
+    }
     chain(postProcessStage, writeStage);
     // Set task counts
-    imageLoadStage.setTaskCount(total_images);
-    siftGPUStage.setTaskCount(total_images);
-    postProcessStage.setTaskCount(total_images);
-    writeStage.setTaskCount(total_images);
+    imageLoadStage.setTaskCount(num_stale);
+    postProcessStage.setTaskCount(num_stale);
+    writeStage.setTaskCount(num_stale);
 
     // Start processing
     auto start_time = std::chrono::high_resolution_clock::now();
 
     // Push tasks in background thread, process GPU in main thread
     std::thread push_thread([&]() {
-      for (int i = 0; i < total_images; ++i) {
+      for (int i : stale_indices) {
         imageLoadStage.push(i);
       }
     });
 
-    // Run GPU stage in main thread (OpenGL context requirement)
-    siftGPUStage.run();
+    if (use_cpu_extract) {
+      push_thread.join();
+      imageLoadStage.wait();
+      cpuSiftStage->wait();
+    } else {
+      // Run GPU stage in main thread (OpenGL context requirement)
+      siftGPUStage->run();
+      push_thread.join();
+      imageLoadStage.wait();
+    }
 
     // Wait for all stages to complete
-    push_thread.join();
-    imageLoadStage.wait();
     postProcessStage.wait();
     writeStage.wait();
 
@@ -682,37 +1057,40 @@ int main(int argc, char* argv[]) {
         std::chrono::duration_cast<std::chrono::seconds>(end_time - start_time).count();
 
     LOG(INFO) << "Feature extraction completed in " << extract_total_time_s << "s";
-    LOG(INFO) << "Average time per image: " << (float)extract_total_time_s / total_images << "s";
-
-    if (process_matching) {
-      json meta;
-      meta["schema"] = "insightat_matching_extract_meta_v1";
-      meta["min_matching_features_for_full_peak"] = 10000;
-      json arr = json::array();
-      int n_low = 0;
-      for (int i = 0; i < total_images; ++i) {
-        const bool low = matching_used_low_peak[static_cast<size_t>(i)] != 0;
-        if (low)
-          ++n_low;
-        arr.push_back({{"image_index", image_index_snapshot[static_cast<size_t>(i)]},
-                       {"low_peak_matching", low}});
-      }
-      meta["images"] = arr;
-      const fs::path meta_path = fs::path(output_dir) / "matching_extract_meta.json";
-      std::ofstream mf(meta_path);
-      if (mf) {
-        mf << meta.dump(2) << "\n";
-        LOG(INFO) << "Wrote matching extract meta (" << n_low
-                  << " low-peak images): " << meta_path.string();
-      } else {
-        LOG(WARNING) << "Could not write " << meta_path.string();
-      }
+    LOG(INFO) << "Average time per image: " << (float)extract_total_time_s / num_stale << "s";
+  }
+
+  // Written on every run (cache hits carry their low-peak flag from the cached file).
+  if (process_matching) {
+    json meta;
+    meta["schema"] = "insightat_matching_extract_meta_v1";
+    meta["min_matching_features_for_full_peak"] = 10000;
+    json arr = json::array();
+    int n_low = 0;
+    for (int i = 0; i < total_images; ++i) {
+      const bool low = matching_used_low_peak[static_cast<size_t>(i)] != 0;
+      if (low)
+        ++n_low;
+      arr.push_back({{"image_index", image_index_snapshot[static_cast<size_t>(i)]},
+                     {"low_peak_matching", low}});
+    }
+    meta["images"] = arr;
+    const fs::path meta_path = fs::path(output_dir) / "matching_extract_meta.json";
+    std::ofstream mf(meta_path);
+    if (mf) {
+      mf << meta.dump(2) << "\n";
+      LOG(INFO) << "Wrote matching extract meta (" << n_low
+                << " low-peak images): " << meta_path.string();
+    } else {
+      LOG(WARNING) << "Could not write " << meta_path.string();
     }
   }
 
   json extract_data = {{"num_images", total_images},
                        {"output_dir", output_dir},
-                       {"total_time_s", extract_total_time_s}};
+                       {"total_time_s", extract_total_time_s},
+                       {"cache_hits", cache_hits},
+                       {"cache_misses", cache_misses}};
   if (process_matching) {
     extract_data["matching_extract_meta"] =
         (fs::path(output_dir) / "matching_extract_meta.json").string();
@@ -7,7 +7,9 @@
  * and optionally Homography (--estimate-h), then writes .isat_geo files.
  *
  * Pipeline (CPU–GPU async, same Stage/chain pattern as isat_match):
- *   Stage 1  [multi-thread I/O]  Read .isat_match → coords_pixel
+ *   Stage 1  [multi-thread I/O]  Read .isat_match (or the pair's rows of a .isat_matchpack
+ *                                block when match_dir holds matchpack_index.isat_mpkx)
+ *                                → coords_pixel
  *   Stage 2  [main thread]      GPU RANSAC F [E] [H] — CUDA when built with
  *                               INSIGHTAT_HAS_CUDA_GEO and --backend gpu;
  *                               otherwise EGL + OpenGL 4.3 compute (--backend gpu-gl).
@@ -41,6 +43,7 @@
 #include <fstream>
 #include <functional>
 #include <iomanip>
+#include <memory>
 #include <numeric>
 #include <sstream>
 #include <set>
@@ -64,6 +67,7 @@
 #include "../io/idc_reader.h"
 #include "../io/idc_writer.h"
 #include "../io/geopack_index.h"
+#include "../io/matchpack.h"
 #include "cli_logging.h"
 #include "cmdLine/cmdLine.h"
 #include "task_queue/task_queue.hpp"
@@ -149,6 +153,7 @@ struct GeoTask {
   uint32_t image1_index = 0;
   uint32_t image2_index = 0;
   std::string match_file;
+  const MatchPackIndexRecordV1* pack_rec = nullptr; // set when match_dir is a match pack
   int index = 0;
 
   // Stage 1 output ─────────────────────────────────────────────────────────
@@ -215,28 +220,24 @@ static GeoOutputFormat parse_output_format(const std::string& s) {
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-// Pairs loading (reuses same JSON schema as isat_match / isat_retrieve)
+// Pairs loading (.isat_pairs or the pairs JSON schema of isat_match / isat_retrieve)
 // ─────────────────────────────────────────────────────────────────────────────
 
 static std::vector<GeoTask> load_pairs(const std::string& json_path, const std::string& match_dir) {
-  std::ifstream file(json_path);
-  if (!file.is_open()) {
-    LOG(FATAL) << "Cannot open pairs file: " << json_path;
-  }
-  json j;
-  file >> j;
-
   std::vector<GeoTask> tasks;
   int idx = 0;
-  for (const auto& pair : j["pairs"]) {
-    GeoTask t;
-    t.image1_index = insight::tools::get_image_index_from_pair(pair, "image1_index");
-    t.image2_index = insight::tools::get_image_index_from_pair(pair, "image2_index");
-    t.match_file = match_dir + "/" + std::to_string(t.image1_index) + "_" +
-                   std::to_string(t.image2_index) + ".isat_match";
-    t.index = idx++;
-    tasks.push_back(std::move(t));
-  }
+  const bool ok = insight::tools::for_each_pair_in_list(
+      json_path, [&](const insight::tools::PairListEntry& pair) {
+        GeoTask t;
+        t.image1_index = pair.image1_index;
+        t.image2_index = pair.image2_index;
+        t.match_file = match_dir + "/" + std::to_string(t.image1_index) + "_" +
+                       std::to_string(t.image2_index) + ".isat_match";
+        t.index = idx++;
+        tasks.push_back(std::move(t));
+      });
+  if (!ok)
+    LOG(FATAL) << "Cannot open pairs file: " << json_path;
   LOG(INFO) << "Loaded " << tasks.size() << " pairs from " << json_path;
   return tasks;
 }
@@ -245,15 +246,37 @@ static std::vector<GeoTask> load_pairs(const std::string& json_path, const std::
 // Stage 1 helper – read coords_pixel from .isat_match
 // ─────────────────────────────────────────────────────────────────────────────
 
-static void read_match_coords(GeoTask& task) {
-  IDCReader reader(task.match_file);
+static void read_match_coords(GeoTask& task, const MatchPackIndex* pack) {
+  if (pack && task.pack_rec) {
+    MatchPackPairView view;
+    if (!pack->read_pair(*task.pack_rec, &view) || view.num_matches == 0) {
+      LOG(WARNING) << "Unreadable match pack entry for pair " << task.image1_index << "_"
+                   << task.image2_index;
+      return;
+    }
+    task.coords.assign(view.coords_pixel.begin(), view.coords_pixel.end());
+    if (view.image1_index != task.image1_index) {
+      // Pack stores the pair as matched; re-orient rows to [x1,y1,x2,y2] of this task.
+      for (size_t k = 0; k + 3 < task.coords.size(); k += 4) {
+        std::swap(task.coords[k + 0], task.coords[k + 2]);
+        std::swap(task.coords[k + 1], task.coords[k + 3]);
+      }
+    }
+    task.num_matches = static_cast<int>(view.num_matches);
+    VLOG(1) << "Read " << task.num_matches << " matches from match pack block "
+            << task.pack_rec->block_index;
+    return;
+  }
+
+  IDCReader reader(task.match_file, IDCReadMode::kMapped);
   if (!reader.is_valid()) {
     LOG(WARNING) << "Invalid .isat_match file: " << task.match_file;
     return;
   }
 
-  // coords_pixel blob: float32[N, 4]  →  [x1, y1, x2, y2] per row
-  task.coords = reader.read_blob<float>("coords_pixel");
+  // coords_pixel blob: float32[N, 4]  →  [x1, y1, x2, y2] per row (one copy out of the mapping)
+  const auto coords = reader.view_blob<float>("coords_pixel");
+  task.coords.assign(coords.begin(), coords.end());
   if (task.coords.empty()) {
     LOG(WARNING) << "Empty coords_pixel in: " << task.match_file;
     return;
@@ -834,10 +857,11 @@ int main(int argc, char* argv[]) {
   int geopack_block_size = 100000;
 
   cmd.add(make_option('i', pairs_json, "input")
-              .doc("Input pairs JSON (same format as isat_retrieve / isat_match output)"));
+              .doc("Input pair list: .isat_pairs or pairs JSON (isat_retrieve / isat_match output)"));
   cmd.add(make_option('m', match_dir, "match-dir")
               .doc("Directory containing .isat_match files from isat_match.\n"
-                   "  File names are derived as {dir}/{id1}_{id2}.isat_match"));
+                   "  File names are derived as {dir}/{id1}_{id2}.isat_match; if the directory\n"
+                   "  holds matchpack_index.isat_mpkx, pairs are read from .isat_matchpack blocks"));
   cmd.add(make_option('o', output_dir, "output").doc("Output directory for .isat_geo files"));
   cmd.add(
       make_option('k', intrinsics_json, "intrinsics")
@@ -1035,6 +1059,26 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
+  // ── Optional match pack (isat_match --output-format matchpack|both) ─────
+  std::unique_ptr<MatchPackIndex> match_pack;
+  if (MatchPackIndex::exists_in_dir(match_dir)) {
+    match_pack = std::make_unique<MatchPackIndex>();
+    if (!match_pack->load_from_dir(match_dir)) {
+      LOG(ERROR) << "Failed to load match pack index in " << match_dir;
+      return 1;
+    }
+    // Enough open blocks for every loader thread to sit on a different block.
+    match_pack->set_max_open_blocks(static_cast<size_t>(num_threads) + 2);
+    int missing = 0;
+    for (auto& t : tasks) {
+      t.pack_rec = match_pack->find(t.image1_index, t.image2_index);
+      if (!t.pack_rec)
+        ++missing;
+    }
+    LOG(INFO) << "  Match pack   : " << match_pack->size() << " pairs (" << missing
+              << " requested pairs not in pack)";
+  }
+
   const bool need_gpu_geo = (f_backend == FundamentalBackend::kGpu) ||
                             (estimate_E && e_backend == EssentialBackend::kGpu) ||
                             (estimate_H && h_backend == HomographyBackend::kGpu);
@@ -1070,9 +1114,9 @@ int main(int argc, char* argv[]) {
   const int IO_Q = 12;
   const int GPU_Q = 4;
 
-  Stage loadStage("LoadMatches", num_threads, IO_Q, [&tasks](int i) {
+  Stage loadStage("LoadMatches", num_threads, IO_Q, [&tasks, &match_pack](int i) {
     auto t0 = std::chrono::high_resolution_clock::now();
-    read_match_coords(tasks[i]);
+    read_match_coords(tasks[i], match_pack.get());
     auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
                   std::chrono::high_resolution_clock::now() - t0)
                   .count();
@@ -1555,8 +1599,22 @@ int main(int argc, char* argv[]) {
   auto t_start = std::chrono::high_resolution_clock::now();
 
   // Push tasks from background thread; GPU runs on main thread (EGL context)
+  // With a match pack, feed pairs in (block, row) order so each block is streamed once.
+  std::vector<int> load_order(static_cast<size_t>(total));
+  std::iota(load_order.begin(), load_order.end(), 0);
+  if (match_pack) {
+    std::stable_sort(load_order.begin(), load_order.end(), [&tasks](int a, int b) {
+      const auto* ra = tasks[static_cast<size_t>(a)].pack_rec;
+      const auto* rb = tasks[static_cast<size_t>(b)].pack_rec;
+      if (!ra || !rb)
+        return ra != nullptr && rb == nullptr;
+      if (ra->block_index != rb->block_index)
+        return ra->block_index < rb->block_index;
+      return ra->row_offset < rb->row_offset;
+    });
+  }
   std::thread push_thread([&]() {
-    for (int i = 0; i < total; ++i)
+    for (int i : load_order)
       loadStage.push(i);
   });
 
@@ -8,7 +8,8 @@
  * post-processing (mask computation, degeneracy detection, stability metrics).
  *
  * Pipeline:
- *   Stage 1  [N CPU threads]   Read .isat_match → coords into GeoTask batch
+ *   Stage 1  [N CPU threads]   Read .isat_match (or .isat_matchpack rows) → coords into
+ *                              GeoTask batch
  *   Stage 2  [main thread]     GPU batch:
  *                                F RANSAC (cuda_ransac_F_batch)
  *                                E RANSAC (cuda_ransac_E_batch, K-normalised)
@@ -32,6 +33,7 @@
 #include <fstream>
 #include <functional>
 #include <iomanip>
+#include <memory>
 #include <numeric>
 #include <set>
 #include <sstream>
@@ -53,6 +55,7 @@
 #include "../io/idc_reader.h"
 #include "../io/idc_writer.h"
 #include "../io/geopack_index.h"
+#include "../io/matchpack.h"
 #include "cli_logging.h"
 #include "cmdLine/cmdLine.h"
 #include "task_queue/task_queue.hpp"
@@ -101,6 +104,7 @@ struct GeoTask {
   uint32_t image1_index = 0;
   uint32_t image2_index = 0;
   std::string match_file;
+  const MatchPackIndexRecordV1* pack_rec = nullptr; // set when match_dir is a match pack
   int index = 0;
 
   // Stage 1 output
@@ -158,23 +162,20 @@ static std::string geopack_file_name(int block_index) {
 
 static std::vector<GeoTask> load_pairs(const std::string& json_path,
                                         const std::string& match_dir) {
-  std::ifstream file(json_path);
-  if (!file.is_open())
-    LOG(FATAL) << "Cannot open pairs file: " << json_path;
-  json j;
-  file >> j;
-
   std::vector<GeoTask> tasks;
   int idx = 0;
-  for (const auto& pair : j["pairs"]) {
-    GeoTask t;
-    t.image1_index = insight::tools::get_image_index_from_pair(pair, "image1_index");
-    t.image2_index = insight::tools::get_image_index_from_pair(pair, "image2_index");
-    t.match_file = match_dir + "/" + std::to_string(t.image1_index) + "_" +
-                   std::to_string(t.image2_index) + ".isat_match";
-    t.index = idx++;
-    tasks.push_back(std::move(t));
-  }
+  const bool ok = insight::tools::for_each_pair_in_list(
+      json_path, [&](const insight::tools::PairListEntry& pair) {
+        GeoTask t;
+        t.image1_index = pair.image1_index;
+        t.image2_index = pair.image2_index;
+        t.match_file = match_dir + "/" + std::to_string(t.image1_index) + "_" +
+                       std::to_string(t.image2_index) + ".isat_match";
+        t.index = idx++;
+        tasks.push_back(std::move(t));
+      });
+  if (!ok)
+    LOG(FATAL) << "Cannot open pairs file: " << json_path;
   LOG(INFO) << "Loaded " << tasks.size() << " pairs from " << json_path;
   return tasks;
 }
@@ -183,13 +184,32 @@ static std::vector<GeoTask> load_pairs(const std::string& json_path,
 // Stage 1: read .isat_match
 // ─────────────────────────────────────────────────────────────────────────────
 
-static void read_match_coords(GeoTask& task) {
-  IDCReader reader(task.match_file);
+static void read_match_coords(GeoTask& task, const MatchPackIndex* pack) {
+  if (pack && task.pack_rec) {
+    MatchPackPairView view;
+    if (!pack->read_pair(*task.pack_rec, &view) || view.num_matches == 0) {
+      LOG(WARNING) << "Unreadable match pack entry: " << task.image1_index << "_"
+                   << task.image2_index;
+      return;
+    }
+    task.coords.assign(view.coords_pixel.begin(), view.coords_pixel.end());
+    if (view.image1_index != task.image1_index) {
+      for (size_t k = 0; k + 3 < task.coords.size(); k += 4) {
+        std::swap(task.coords[k + 0], task.coords[k + 2]);
+        std::swap(task.coords[k + 1], task.coords[k + 3]);
+      }
+    }
+    task.num_matches = static_cast<int>(view.num_matches);
+    return;
+  }
+
+  IDCReader reader(task.match_file, IDCReadMode::kMapped);
   if (!reader.is_valid()) {
     LOG(WARNING) << "Invalid .isat_match: " << task.match_file;
     return;
   }
-  task.coords = reader.read_blob<float>("coords_pixel");
+  const auto coords = reader.view_blob<float>("coords_pixel");
+  task.coords.assign(coords.begin(), coords.end());
   if (task.coords.empty()) {
     LOG(WARNING) << "Empty coords_pixel: " << task.match_file;
     return;
@@ -945,8 +965,9 @@ int main(int argc, char* argv[]) {
   std::string output_format_str = "geopack";
   int geopack_block_size = 100000;
 
-  cmd.add(make_option('i', pairs_json, "input").doc("Input pairs JSON"));
-  cmd.add(make_option('m', match_dir, "match-dir").doc("Directory with .isat_match files"));
+  cmd.add(make_option('i', pairs_json, "input").doc("Input pair list (.isat_pairs or JSON)"));
+  cmd.add(make_option('m', match_dir, "match-dir")
+              .doc("Directory with .isat_match files (or a match pack: matchpack_index.isat_mpkx)"));
   cmd.add(make_option('o', output_dir, "output").doc("Output directory for .isat_geo files"));
   cmd.add(make_option('l', image_list_json, "image-list")
               .doc("Image list JSON (cameras + images[].camera_index) for per-image K"));
@@ -1049,6 +1070,28 @@ int main(int argc, char* argv[]) {
   std::vector<GeoTask> tasks = load_pairs(pairs_json, match_dir);
   const int total = static_cast<int>(tasks.size());
   if (total == 0) { LOG(ERROR) << "No pairs to process"; return 1; }
+
+  // Match pack: batches are contiguous task ranges, so order tasks by (block, row) to keep
+  // each batch inside as few pack blocks as possible.
+  std::unique_ptr<MatchPackIndex> match_pack;
+  if (MatchPackIndex::exists_in_dir(match_dir)) {
+    match_pack = std::make_unique<MatchPackIndex>();
+    if (!match_pack->load_from_dir(match_dir)) {
+      LOG(ERROR) << "Failed to load match pack index in " << match_dir;
+      return 1;
+    }
+    match_pack->set_max_open_blocks(static_cast<size_t>(num_threads) + 2);
+    for (auto& t : tasks)
+      t.pack_rec = match_pack->find(t.image1_index, t.image2_index);
+    std::stable_sort(tasks.begin(), tasks.end(), [](const GeoTask& a, const GeoTask& b) {
+      if (!a.pack_rec || !b.pack_rec)
+        return a.pack_rec != nullptr && b.pack_rec == nullptr;
+      if (a.pack_rec->block_index != b.pack_rec->block_index)
+        return a.pack_rec->block_index < b.pack_rec->block_index;
+      return a.pack_rec->row_offset < b.pack_rec->row_offset;
+    });
+    LOG(INFO) << "  Match pack   : " << match_pack->size() << " pairs";
+  }
   const int num_batches_preview = (total + batch_size - 1) / batch_size;
   LOG(INFO) << "  Total pairs  : " << total
             << "  batches=" << num_batches_preview
@@ -1088,14 +1131,14 @@ int main(int argc, char* argv[]) {
   // and chain() pushes it to GpuStage.
   Stage load_stage(
       "GeoLoadBatch", 1, /*capacity=*/2,
-      [&tasks, &batch_size, &total, &num_threads](int batch_idx) {
+      [&tasks, &batch_size, &total, &num_threads, &match_pack](int batch_idx) {
         const int bs = batch_idx * batch_size;
         const int be = std::min(bs + batch_size, total);
         const int n  = be - bs;
         Stage inner_load(
             "GeoInnerLoad", num_threads, /*capacity=*/n + 4,
-            [&tasks, bs](int j) {
-              read_match_coords(tasks[static_cast<size_t>(bs + j)]);
+            [&tasks, bs, &match_pack](int j) {
+              read_match_coords(tasks[static_cast<size_t>(bs + j)], match_pack.get());
             });
         inner_load.setTaskCount(n);
         for (int j = 0; j < n; ++j) inner_load.push(j);
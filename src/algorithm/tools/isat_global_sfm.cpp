@@ -0,0 +1,254 @@
+/**
+ * isat_global_sfm.cpp
+ * Global SfM CLI: every camera pose at once from the view graph (rotation averaging, then
+ * translation averaging), followed by triangulation and a single global BA.  Much faster than
+ * isat_incremental_sfm on large well-connected datasets; the incremental pipeline stays the
+ * robust default for weakly connected ones.
+ *
+ * Usage:
+ *   isat_global_sfm -t tracks.isat_tracks -p project.json -o output_dir/ [-m pairs.json -g geo_dir/]
+ *
+ * Options:
+ *   -t / --tracks    Path to .isat_tracks IDC (view graph embedded, or -m / -g)
+ *   -p / --project   Path to project JSON (images[] + cameras[], camera_index per image)
+ *   -m / --pairs     Pairs JSON (view graph fallback when the IDC has no embedded graph)
+ *   -g / --geo       Directory of .isat_geo files: view graph with -m; pairs whose geo has a
+ *                    two-view pose (isat_geo --twoview) start from it instead of RANSAC
+ *   -o / --output    Output directory; same files as isat_incremental_sfm (poses.json,
+ *                    bundle.out, list.txt, colmap/sparse/0, tracks.isat_tracks)
+ *   --ba-solver      BA backend: ceres (default) | native (block-sparse Schur + PCG)
+ *   --ba-preconditioner  Native solver PCG preconditioner: jacobi | schur-jacobi (default) |
+ *                    cluster-jacobi
+ *
+ * Steps (global_sfm.h): per-pair relative pose on track correspondences (isat_geo two-view
+ * pose when -g has one, else 5-point RANSAC) → loop-consistency
+ * filter → L1 / IRLS rotation averaging → LUD translation averaging → triangulation → global BA
+ * with outlier rejection → full-scan retriangulation.
+ */
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "cli_logging.h"
+#include "cmdLine/cmdLine.h"
+#include "sfm_result_writers.h"
+#include "tools/project_loader.h"
+
+#include "../io/track_store_idc.h"
+#include "../modules/sfm/global_sfm.h"
+#include "../modules/sfm/incremental_sfm_pipeline.h"
+#include "../modules/sfm/track_store.h"
+#include "../modules/sfm/view_graph.h"
+#include "../modules/sfm/view_graph_loader.h"
+
+using namespace insight;
+using namespace insight::sfm;
+using namespace insight::tools;
+
+int main(int argc, char* argv[]) {
+  std::string tracks_path;
+  std::string project_path;
+  std::string pairs_path;
+  std::string geo_dir;
+  std::string output_dir;
+  std::string log_level;
+  int ba_threads = 0;
+  std::string ba_solver = "ceres";
+  std::string ba_preconditioner = "schur-jacobi";
+  int bundler_max_cameras = -1;
+  GlobalSfMOptions gopts;
+  CmdLine cmd("Global SfM: tracks IDC + project JSON → poses by rotation/translation averaging");
+  cmd.add(make_option('t', tracks_path, "tracks").doc("Path to .isat_tracks IDC"));
+  cmd.add(make_option('p', project_path, "project").doc("Path to project JSON"));
+  cmd.add(make_option('m', pairs_path, "pairs")
+              .doc("Pairs JSON (view graph fallback when the IDC has no embedded graph)"));
+  cmd.add(make_option('g', geo_dir, "geo")
+              .doc("Directory of .isat_geo files (view graph with -m; two-view poses seed the "
+                   "relative poses)"));
+  cmd.add(make_option('o', output_dir, "output").doc("Output directory"));
+  cmd.add(make_option(0, log_level, "log-level").doc("Log level: error|warn|info|debug"));
+  cmd.add(make_option(0, bundler_max_cameras, "bundler-max-cameras")
+              .doc("Subsample to at most N cameras in Bundler output (default: all)"));
+  cmd.add(make_switch(0, "fix-intrinsics")
+              .doc("Keep camera intrinsics fixed (do not optimize in BA). "));
+  cmd.add(make_option(0, ba_threads, "ba-threads")
+              .doc("Ceres num_threads for BA solves (default: 0 = use hardware concurrency)."));
+  cmd.add(make_option(0, ba_solver, "ba-solver")
+              .doc("BA backend: ceres [default] | native (block-sparse Schur + PCG)."));
+  cmd.add(make_option(0, ba_preconditioner, "ba-preconditioner")
+              .doc("Native BA preconditioner: jacobi | schur-jacobi [default] | cluster-jacobi."));
+  cmd.add(make_option(0, gopts.rel_pose_max_error_px, "rel-pose-max-error")
+              .doc("Relative pose RANSAC inlier threshold in pixels (default: 4.0)."));
+  cmd.add(make_option(0, gopts.rel_pose_min_inliers, "rel-pose-min-inliers")
+              .doc("Minimum relative pose inliers to keep a pair (default: 30)."));
+  cmd.add(make_option(0, gopts.loop_max_rotation_error_deg, "loop-max-error-deg")
+              .doc("Triangle rotation cycle error threshold in degrees (default: 5.0)."));
+  cmd.add(make_option(0, gopts.rotation_max_residual_deg, "rotation-max-residual-deg")
+              .doc("Drop pairs off the averaged rotations by more than this (default: 5.0)."));
+  cmd.add(make_option(0, gopts.translation_max_angle_deg, "translation-max-angle-deg")
+              .doc("Drop pairs off the averaged centres by more than this (default: 10.0)."));
+  cmd.add(make_switch('v', "verbose").doc("Verbose (INFO)"));
+  cmd.add(make_switch('q', "quiet").doc("Quiet (ERROR only)"));
+  cmd.add(make_switch('h', "help").doc("Show help"));
+  try {
+    cmd.process(argc, argv);
+  } catch (const std::string& s) {
+    std::cerr << "Error: " << s << "\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+  if (cmd.checkHelp(argv[0]))
+    return 0;
+  if (tracks_path.empty() || project_path.empty() || output_dir.empty()) {
+    std::cerr << "Error: -t, -p, -o are required\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+  if (ba_threads < 0) {
+    std::cerr << "Error: --ba-threads must be >= 0\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+  int native_preconditioner = -1;
+  if (ba_preconditioner == "jacobi")
+    native_preconditioner = 0;
+  else if (ba_preconditioner == "schur-jacobi")
+    native_preconditioner = 1;
+  else if (ba_preconditioner == "cluster-jacobi")
+    native_preconditioner = 2;
+  if ((ba_solver != "ceres" && ba_solver != "native") || native_preconditioner < 0) {
+    std::cerr << "Error: --ba-solver must be ceres|native and --ba-preconditioner "
+                 "jacobi|schur-jacobi|cluster-jacobi\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+  if (gopts.rel_pose_max_error_px <= 0.0 || gopts.rel_pose_min_inliers < 5 ||
+      gopts.loop_max_rotation_error_deg <= 0.0 || gopts.rotation_max_residual_deg <= 0.0 ||
+      gopts.translation_max_angle_deg <= 0.0) {
+    std::cerr << "Error: thresholds must be > 0 and --rel-pose-min-inliers >= 5\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+  insight::tools::apply_log_level(cmd.used('v'), cmd.used('q'), log_level);
+
+  ProjectData project;
+  {
+    ScopedTimer timer("load_project_data");
+    if (!load_project_data(project_path, &project)) {
+      LOG(ERROR) << "Failed to load project from " << project_path;
+      return 1;
+    }
+  }
+
+  TrackStore store;
+  ViewGraph view_graph;
+  {
+    ScopedTimer timer("load_track_store_from_idc");
+    std::vector<uint32_t> image_indices;
+    if (!load_track_store_from_idc(tracks_path, &store, &image_indices, &view_graph)) {
+      LOG(ERROR) << "Failed to load " << tracks_path;
+      return 1;
+    }
+  }
+  if (store.num_images() != project.num_images()) {
+    LOG(ERROR) << tracks_path << " has " << store.num_images() << " images, project has "
+               << project.num_images();
+    return 1;
+  }
+  if (view_graph.num_pairs() == 0) {
+    if (pairs_path.empty() || geo_dir.empty()) {
+      LOG(ERROR) << tracks_path << " has no embedded view graph; pass -m and -g";
+      return 1;
+    }
+    if (!build_view_graph_from_geo(pairs_path, geo_dir, &view_graph)) {
+      LOG(ERROR) << "Failed to build view graph from " << pairs_path;
+      return 1;
+    }
+  }
+
+  gopts.geo_dir = geo_dir;
+
+  // Single global BA: same objective and subset heuristics as isat_incremental_sfm's globals.
+  IncrementalSfMOptions opts;
+  opts.global_ba.max_iterations = 500;
+  opts.global_ba.skip_2degree_tracks = true;
+  opts.global_ba.ba_grid_subset = true;
+  opts.global_ba.ba_grid_target_per_image = 1000;
+  opts.global_ba.max_observations_per_track = 12;
+  opts.global_ba.ba_fixed_pose_optimize_skipped = true;
+  opts.intrinsics.focal_prior_weight = 1.f;
+  if (ba_threads > 0) {
+    opts.global_ba.solver_overrides.num_threads = ba_threads;
+    LOG(INFO) << "Ceres BA num_threads=" << ba_threads;
+  }
+  if (ba_solver == "native") {
+    opts.global_ba.solver_overrides.native_schur = true;
+    opts.global_ba.solver_overrides.native_preconditioner = native_preconditioner;
+    LOG(INFO) << "BA backend: native Schur + PCG (" << ba_preconditioner << ")";
+  }
+  if (cmd.used("fix-intrinsics")) {
+    opts.global_ba.optimize_intrinsics = false;
+    LOG(INFO) << "--fix-intrinsics: camera intrinsics will be held constant in BA.";
+  }
+
+  std::vector<Eigen::Matrix3d> poses_R;
+  std::vector<Eigen::Vector3d> poses_C;
+  std::vector<bool> registered;
+  {
+    ScopedTimer timer("run_global_sfm");
+    if (!run_global_sfm(&store, view_graph, project.image_to_camera_index, gopts, opts,
+                        &project.cameras, &poses_R, &poses_C, &registered)) {
+      LOG(ERROR) << "Global SfM failed";
+      return 1;
+    }
+  }
+
+  int n_reg = 0;
+  for (bool r : registered)
+    if (r)
+      ++n_reg;
+  LOG(INFO) << "Registered " << n_reg << " / " << project.num_images() << " images";
+
+  std::error_code ec;
+  std::filesystem::create_directories(output_dir, ec);
+  if (ec) {
+    LOG(ERROR) << "Cannot create " << output_dir << ": " << ec.message();
+    return 1;
+  }
+  std::string out_path = output_dir;
+  if (!out_path.empty() && out_path.back() != '/')
+    out_path += '/';
+  out_path += "poses.json";
+  {
+    ScopedTimer timer("write_poses_json");
+    if (!write_poses_json(out_path, poses_R, poses_C, registered, project.cameras,
+                          project.image_to_camera_index)) {
+      LOG(ERROR) << "Failed to write poses";
+      return 1;
+    }
+  }
+  LOG(INFO) << "Wrote " << out_path;
+
+  {
+    ScopedTimer timer("write_bundler");
+    write_bundler(output_dir, project.image_paths, poses_R, poses_C, registered, project.cameras,
+                  project.image_to_camera_index, store, bundler_max_cameras);
+  }
+
+  {
+    ScopedTimer timer("write_colmap");
+    write_colmap(output_dir, project.image_paths, poses_R, poses_C, registered, project.cameras,
+                 project.image_to_camera_index, store);
+  }
+
+  {
+    ScopedTimer timer("save_track_store_to_idc");
+    save_sfm_result_tracks(output_dir, store, poses_R, poses_C, registered, project.cameras,
+                           project.image_to_camera_index);
+  }
+
+  return 0;
+}
@@ -8,7 +8,8 @@
  *             ↓ chain
  *   StageCurrent [main thread, CUDA]  Upload → batch kernel → download → free GPU/host mem.
  *             ↓ chain
- *   Stage 3  [N IO threads]  Write .isat_match files (results freed after write).
+ *   Stage 3  [N IO threads]  Write .isat_match files and/or .isat_matchpack blocks
+ *                            (--output-format; results freed after write).
  *
  * Block-pair strategy:
  *   - All unique images are sorted and divided into image blocks of size B.
@@ -31,6 +32,7 @@
 #include <fstream>
 #include <glog/logging.h>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <nlohmann/json.hpp>
 #include <string>
@@ -43,8 +45,10 @@
 
 #include "../io/idc_reader.h"
 #include "../io/idc_writer.h"
+#include "../io/matchpack.h"
 #include "../modules/gpu_cascade_hash/gpu_cascade_hash.h"
 #include "../modules/cpu_cascade_hash/cpu_cascade_hash.h"
+#include "../modules/matching/feature_loader.h"
 #include "cli_logging.h"
 #include "cmdLine/cmdLine.h"
 #include "pair_json_utils.h"
@@ -61,6 +65,8 @@ using insight::algorithm::matching::FeatureData;
 using insight::algorithm::matching::MatchResult;
 using insight::io::IDCReader;
 using insight::io::IDCWriter;
+using insight::io::MatchPackIndex;
+using insight::io::MatchPackWriter;
 
 static constexpr const char* kEventPrefix = "ISAT_EVENT ";
 
@@ -71,14 +77,7 @@ static void print_event(const json& j) {
 
 static bool write_pairs_json(const std::string& output_path,
                              const std::vector<std::pair<uint32_t, uint32_t>>& pairs) {
-  json pairs_arr = json::array();
-  for (const auto& [i, j] : pairs)
-    pairs_arr.push_back({{"image1_index", i}, {"image2_index", j}});
-  std::ofstream f(output_path);
-  if (!f.is_open())
-    return false;
-  f << json{{"pairs", pairs_arr}}.dump(2) << "\n";
-  return true;
+  return insight::tools::write_pair_list(output_path, pairs, insight::io::kPairMethodMatched);
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -159,84 +158,39 @@ static std::vector<float> build_scales_flat(const MatchResult& matches,
 
 static std::vector<PairTask> load_pairs_json(const std::string& json_path,
                                              const std::string& feature_dir) {
-  std::ifstream file(json_path);
-  if (!file.is_open()) {
-    LOG(FATAL) << "Failed to open pairs file: " << json_path;
-  }
-  json j;
-  file >> j;
-  
-  if (!j.contains("pairs")) {
-    LOG(FATAL) << "Input JSON does not contain 'pairs' array: " << json_path;
-  }
-  
   std::vector<PairTask> pairs;
-  for (const auto& pair : j["pairs"]) {
-    PairTask task;
-    task.image1_index = insight::tools::get_image_index_from_pair(pair, "image1_index");
-    task.image2_index = insight::tools::get_image_index_from_pair(pair, "image2_index");
-    if (!feature_dir.empty()) {
-      task.feature1_file = feature_dir + "/" + std::to_string(task.image1_index) + ".isat_feat";
-      task.feature2_file = feature_dir + "/" + std::to_string(task.image2_index) + ".isat_feat";
-    } else {
-      if (pair.contains("feature1_file")) {
-        task.feature1_file = pair["feature1_file"];
-      } else {
-        LOG(ERROR) << "Missing feature1_file in pair JSON";
-        continue;
-      }
-      if (pair.contains("feature2_file")) {
-        task.feature2_file = pair["feature2_file"];
-      } else {
-        LOG(ERROR) << "Missing feature2_file in pair JSON";
-        continue;
-      }
-    }
-    pairs.push_back(std::move(task));
+  const bool ok = insight::tools::for_each_pair_in_list(
+      json_path, [&](const insight::tools::PairListEntry& pair) {
+        PairTask task;
+        task.image1_index = pair.image1_index;
+        task.image2_index = pair.image2_index;
+        if (!feature_dir.empty()) {
+          task.feature1_file = feature_dir + "/" + std::to_string(task.image1_index) + ".isat_feat";
+          task.feature2_file = feature_dir + "/" + std::to_string(task.image2_index) + ".isat_feat";
+        } else if (pair.feature1_file && pair.feature2_file) {
+          task.feature1_file = *pair.feature1_file;
+          task.feature2_file = *pair.feature2_file;
+        } else {
+          LOG(ERROR) << "Missing feature files for pair " << pair.image1_index << "_"
+                     << pair.image2_index;
+          return;
+        }
+        pairs.push_back(std::move(task));
+      });
+  if (!ok) {
+    LOG(FATAL) << "Failed to open pairs file: " << json_path;
   }
   return pairs;
 }
 
 static FeatureData load_features_idc(const std::string& idc_path) {
-  IDCReader reader(idc_path);
-  if (!reader.is_valid()) return FeatureData();
-  const auto keypoints_raw = reader.read_blob<float>("keypoints");
-  if (keypoints_raw.empty()) return FeatureData();
-  const auto desc_blob = reader.get_blob_descriptor("descriptors");
-  if (desc_blob.is_null() || !desc_blob.contains("dtype")) {
-    LOG(ERROR) << "Missing descriptors blob or dtype in " << idc_path;
-    return FeatureData();
-  }
-  const std::string dtype = desc_blob["dtype"];
-  const size_t num_features = keypoints_raw.size() / 4;
-  DescriptorType descriptor_type =
-      (dtype == "float32") ? DescriptorType::kFloat32 : DescriptorType::kUInt8;
-
-  FeatureData features;
-  features.num_features = static_cast<int>(num_features);
-  features.descriptor_type = descriptor_type;
-  features.keypoints.resize(num_features);
-  for (int i = 0; i < static_cast<int>(num_features); ++i) {
-    features.keypoints[i] << keypoints_raw[i * 4], keypoints_raw[i * 4 + 1],
-        keypoints_raw[i * 4 + 2], keypoints_raw[i * 4 + 3];
-  }
-
-  if (descriptor_type == DescriptorType::kUInt8) {
-    const auto desc_raw = reader.read_blob<uint8_t>("descriptors");
-    features.descriptors_uint8.resize(desc_raw.size());
-    std::copy(desc_raw.begin(), desc_raw.end(), features.descriptors_uint8.begin());
-  } else {
-    const auto desc_raw = reader.read_blob<float>("descriptors");
-    features.descriptors_float.resize(desc_raw.size());
-    std::copy(desc_raw.begin(), desc_raw.end(), features.descriptors_float.begin());
-  }
-
-  return features;
+  return insight::algorithm::matching::load_feature_data_idc(idc_path);
 }
 
 static bool write_match_idc(const MatchResult& matches, const PairTask& pair,
                             const std::vector<float>& scales_flat,
-                            const std::string& output_dir) {
+                            const std::string& output_dir, bool write_file,
+                            MatchPackWriter* pack_writer) {
   if (matches.num_matches == 0) return false;
   const std::string output_file = output_dir + "/" + std::to_string(pair.image1_index) + "_" +
                                   std::to_string(pair.image2_index) + ".isat_match";
@@ -265,6 +219,17 @@ static bool write_match_idc(const MatchResult& matches, const PairTask& pair,
     coords_flat.push_back(coord(3));
   }
   std::vector<float> distances(matches.num_matches, 0.0f);
+  if (pack_writer &&
+      !pack_writer->add_pair(pair.image1_index, pair.image2_index, indices_flat.data(),
+                             coords_flat.data(), scales_flat.data(), distances.data(),
+                             matches.num_matches)) {
+    LOG(ERROR) << "Failed to pack matches for pair " << pair.image1_index << " - "
+               << pair.image2_index;
+    return false;
+  }
+  if (!write_file)
+    return true;
+
   IDCWriter writer(output_file);
   writer.set_metadata(metadata);
   writer.add_blob("indices", indices_flat.data(), indices_flat.size() * sizeof(uint16_t), "uint16",
@@ -533,13 +498,20 @@ int main(int argc, char* argv[]) {
   int image_block_size = 1000;  // max images held simultaneously in GPU (= 2*B for inter-block)
   int min_output_matches = 16;
   int cuda_device = 0;
+  std::string output_format_str = "file";
+  int matchpack_block_size = 10000;
   std::string log_level;
 
-  cmd.add(make_option('i', pairs_json, "input").doc("Input pairs list (JSON format)"));
+  cmd.add(make_option('i', pairs_json, "input").doc("Input pairs list (.isat_pairs or JSON)"));
   cmd.add(make_option('o', output_dir, "output").doc("Output directory for .isat_match files"));
   cmd.add(make_option(0, output_pairs_json, "output-pairs-json")
-              .doc("Optional JSON path listing only pairs whose .isat_match files were written."));
+              .doc("Optional list of pairs whose matches were written "
+                   "(.isat_pairs = binary pair list, otherwise JSON)."));
   cmd.add(make_option('f', feature_dir, "feature-dir").doc("Feature directory (.isat_feat files)"));
+  cmd.add(make_option(0, output_format_str, "output-format")
+              .doc("Output match format: file|matchpack|both (default: file)"));
+  cmd.add(make_option(0, matchpack_block_size, "matchpack-block-size")
+              .doc("Pairs per .isat_matchpack block (default: 10000)"));
   cmd.add(make_option('j', num_threads, "threads").doc("I/O worker threads (-1 = auto)"));
   cmd.add(make_option(0, sample_images, "sample-images")
               .doc("Images for global mean descriptor (default: 256)"));
@@ -575,6 +547,16 @@ int main(int argc, char* argv[]) {
     std::cerr << "Error: --threads and --image-block-size must be > 0\n";
     return 1;
   }
+  if (output_format_str != "file" && output_format_str != "matchpack" &&
+      output_format_str != "both") {
+    std::cerr << "Error: --output-format must be file, matchpack, or both\n";
+    return 1;
+  }
+  if (matchpack_block_size <= 0) {
+    std::cerr << "Error: --matchpack-block-size must be > 0\n";
+    return 1;
+  }
+  const bool write_match_files = (output_format_str != "matchpack");
   insight::tools::apply_log_level(cmd.used('v'), cmd.used('q'), log_level);
 
   // ── Load pair list ────────────────────────────────────────────────────────
@@ -766,10 +748,21 @@ int main(int argc, char* argv[]) {
   std::vector<std::pair<uint32_t, uint32_t>> written_pairs;
   written_pairs.reserve(static_cast<size_t>(total_pairs));
   std::atomic<int> total_matches_written{0};
+  std::unique_ptr<MatchPackWriter> pack_writer;
+  if (output_format_str != "file") {
+    json algorithm;
+    algorithm["name"] = "CASCADE_HASH_GPU";
+    algorithm["impl"] = "gpu_cascade_hash";
+    algorithm["version"] = "1.0";
+    pack_writer = std::make_unique<MatchPackWriter>(output_dir, matchpack_block_size, algorithm);
+  } else {
+    // File output only: drop a pack left by an earlier run, readers would prefer it.
+    MatchPackIndex::remove_from_dir(output_dir);
+  }
   Stage write_stage(
       "GpuWriteStage", num_threads, 6,
       [&block_jobs, &pair_tasks, &output_dir, min_output_matches, &written_pairs_mu,
-       &written_pairs, &total_matches_written](int job_idx) {
+       &written_pairs, &total_matches_written, &pack_writer, write_match_files](int job_idx) {
         auto& job = block_jobs[static_cast<size_t>(job_idx)];
         for (size_t k = 0; k < job.pair_indices.size(); ++k) {
           if (k >= job.results.size()) break;
@@ -780,7 +773,8 @@ int main(int argc, char* argv[]) {
           if (scales.empty()) {
             std::vector<float> default_scales(res.num_matches * 2, 1.0f);
             if (write_match_idc(res, pair_tasks[static_cast<size_t>(job.pair_indices[k])],
-                                default_scales, output_dir)) {
+                                default_scales, output_dir, write_match_files,
+                                pack_writer.get())) {
               const auto& pair = pair_tasks[static_cast<size_t>(job.pair_indices[k])];
               total_matches_written.fetch_add(static_cast<int>(res.num_matches),
                                               std::memory_order_relaxed);
@@ -789,7 +783,7 @@ int main(int argc, char* argv[]) {
             }
           } else {
             if (write_match_idc(res, pair_tasks[static_cast<size_t>(job.pair_indices[k])],
-                                scales, output_dir)) {
+                                scales, output_dir, write_match_files, pack_writer.get())) {
               const auto& pair = pair_tasks[static_cast<size_t>(job.pair_indices[k])];
               total_matches_written.fetch_add(static_cast<int>(res.num_matches),
                                               std::memory_order_relaxed);
@@ -829,6 +823,15 @@ int main(int argc, char* argv[]) {
   load_stage.wait();
   write_stage.wait();
 
+  std::string matchpack_index_path;
+  if (pack_writer) {
+    matchpack_index_path = pack_writer->finish();
+    if (matchpack_index_path.empty()) {
+      print_event({{"type", "match.complete"}, {"ok", false}, {"error", "matchpack write failed"}});
+      return 1;
+    }
+  }
+
   const double total_s = std::chrono::duration<double>(
       std::chrono::steady_clock::now() - t_pipeline_start).count();
 
@@ -856,6 +859,8 @@ int main(int argc, char* argv[]) {
                  {"image_block_size", image_block_size},
                  {"min_output_matches", min_output_matches},
                  {"output_dir", output_dir},
+                 {"output_format", output_format_str},
+                 {"matchpack_index", matchpack_index_path},
                  {"output_pairs_json", output_pairs_json}}}});
   return 0;
 }
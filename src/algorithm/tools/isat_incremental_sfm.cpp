@@ -14,12 +14,25 @@
  *   -o / --output    Output directory; writes poses.json, bundle.out, list.txt
  *
  *   --ba-threads N   Ceres solver thread count for bundle adjustment (0 = hardware default).
+ *   --ba-solver S    BA backend: ceres (default) | native (block-sparse Schur + PCG).
+ *   --ba-preconditioner P  Native solver PCG preconditioner: jacobi | schur-jacobi (default) |
+ *                    cluster-jacobi.
+ *
+ *   --checkpoint-dir D        Periodic checkpoints (every --checkpoint-every-n registrations or
+ *                             --checkpoint-every-min minutes; default 30 min).
+ *   --resume D                Continue from the latest checkpoint in D (same -t/-p/-m/-g inputs).
+ *
+ * Partitioned SfM merge (-m / -g not needed):
+ *   isat_incremental_sfm -t tracks.isat_tracks -p project.json -o output_dir/ \
+ *       --merge-models cluster_000/,cluster_001/,...
+ *   Each directory holds the tracks.isat_tracks of one isat_incremental_sfm run on a cluster from
+ *   isat_sfm_partition.  Sub-models are aligned by RANSAC Sim3 (sfm_partition.h), the full tracks
+ *   (-t) are triangulated from the merged poses and refined by one global BA with outlier
+ *   rejection; outputs are the same as a normal run.
  */
 
-#include <chrono>
-#include <cmath>
+#include <algorithm>
 #include <filesystem>
-#include <fstream>
 #include <iomanip>
 #include <sstream>
 #include <string>
@@ -27,495 +40,86 @@
 #include <vector>
 
 #include <glog/logging.h>
-#include <nlohmann/json.hpp>
 
 #include "cli_logging.h"
 #include "cmdLine/cmdLine.h"
+#include "sfm_result_writers.h"
 #include "tools/project_loader.h"
 
 #include "../io/track_store_idc.h"
-#include "../modules/camera/camera_utils.h"
 #include "../modules/sfm/incremental_sfm_pipeline.h"
+#include "../modules/sfm/incremental_triangulation.h"
+#include "../modules/sfm/sfm_partition.h"
 #include "../modules/sfm/track_store.h"
 
-using json = nlohmann::json;
 using namespace insight;
 using namespace insight::sfm;
 using namespace insight::tools;
 
-class ScopedTimer {
-public:
-  explicit ScopedTimer(std::string label)
-      : label_(std::move(label)), t0_(std::chrono::steady_clock::now()) {}
-  ~ScopedTimer() {
-    const auto t1 = std::chrono::steady_clock::now();
-    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0_).count();
-    LOG(INFO) << "[timing] " << label_ << ": " << ms << " ms";
-  }
-
-private:
-  std::string label_;
-  std::chrono::steady_clock::time_point t0_;
-};
-
-static json intrinsics_to_json(const camera::Intrinsics& K) {
-  json j;
-  j["fx"] = K.fx;
-  j["fy"] = K.fy;
-  j["cx"] = K.cx;
-  j["cy"] = K.cy;
-  j["width"] = K.width;
-  j["height"] = K.height;
-  j["k1"] = K.k1;
-  j["k2"] = K.k2;
-  j["k3"] = K.k3;
-  j["p1"] = K.p1;
-  j["p2"] = K.p2;
-  return j;
-}
-
-static bool write_poses_json(const std::string& path, const std::vector<Eigen::Matrix3d>& poses_R,
-                             const std::vector<Eigen::Vector3d>& poses_C,
-                             const std::vector<bool>& registered,
-                             const std::vector<camera::Intrinsics>& cameras,
-                             const std::vector<int>& image_to_camera_index) {
-  json poses = json::array();
-  for (size_t i = 0; i < registered.size(); ++i) {
-    if (!registered[i])
-      continue;
-    json pose;
-    pose["image_index"] = static_cast<int>(i);
-    pose["camera_index"] = image_to_camera_index[i];
-    pose["R"] = std::vector<double>{poses_R[i](0, 0), poses_R[i](0, 1), poses_R[i](0, 2),
-                                    poses_R[i](1, 0), poses_R[i](1, 1), poses_R[i](1, 2),
-                                    poses_R[i](2, 0), poses_R[i](2, 1), poses_R[i](2, 2)};
-    pose["C"] = std::vector<double>{poses_C[i](0), poses_C[i](1), poses_C[i](2)};
-    poses.push_back(std::move(pose));
-  }
-
-  json cameras_json = json::array();
-  for (const auto& K : cameras)
-    cameras_json.push_back(intrinsics_to_json(K));
-
-  json root;
-  root["format"] = "isat_incremental_sfm_pose_bundle_v2";
-  root["poses"] = std::move(poses);
-  root["cameras"] = std::move(cameras_json);
-  root["image_to_camera_index"] = image_to_camera_index;
-
-  std::ofstream f(path);
-  if (!f.is_open()) {
-    LOG(ERROR) << "Cannot write " << path;
+// ─── --merge-models: Sim3 merge of partitioned sub-models + global refinement ──────────────────
+static bool merge_sub_models(const std::string& tracks_path,
+                             const std::vector<std::string>& model_dirs,
+                             const MergeOptions& merge_opts, const IncrementalSfMOptions& opts,
+                             std::vector<camera::Intrinsics>* cameras,
+                             const std::vector<int>& image_to_camera_index, TrackStore* store,
+                             std::vector<Eigen::Matrix3d>* poses_R,
+                             std::vector<Eigen::Vector3d>* poses_C,
+                             std::vector<bool>* registered) {
+  if (!load_track_store_from_idc(tracks_path, store)) {
+    LOG(ERROR) << "Failed to load " << tracks_path;
     return false;
   }
-  f << root.dump(2);
-  return true;
-}
-
-// ─── Bundler output (bundle.out + list.txt) for MeshLab visualisation ────────
-// Bundler convention: t = R * (-C), y-axis flipped relative to OpenCV.
-// We apply diag(1,-1,-1) to R so cameras face the right direction in MeshLab.
-//
-// bundler_max_cameras: if > 0, uniformly subsample registered cameras to at most this many.
-//   Points are filtered to only include observations from the kept cameras (≥2 views required).
-static bool write_bundler(const std::string& out_dir, const std::vector<std::string>& image_paths,
-                          const std::vector<Eigen::Matrix3d>& poses_R,
-                          const std::vector<Eigen::Vector3d>& poses_C,
-                          const std::vector<bool>& registered,
-                          const std::vector<camera::Intrinsics>& cameras,
-                          const std::vector<int>& image_to_camera_index, const TrackStore& store,
-                          int bundler_max_cameras = -1) {
-  const int n_images = static_cast<int>(registered.size());
-
-  // Build list of registered image indices in order
-  std::vector<int> all_reg_indices;
-  for (int i = 0; i < n_images; ++i)
-    if (registered[static_cast<size_t>(i)])
-      all_reg_indices.push_back(i);
-
-  // Uniformly subsample if requested
-  std::vector<int> reg_indices;
-  if (bundler_max_cameras > 0 && static_cast<int>(all_reg_indices.size()) > bundler_max_cameras) {
-    reg_indices.reserve(static_cast<size_t>(bundler_max_cameras));
-    const double step = static_cast<double>(all_reg_indices.size() - 1) / (bundler_max_cameras - 1);
-    for (int k = 0; k < bundler_max_cameras; ++k) {
-      const int idx = static_cast<int>(std::round(k * step));
-      reg_indices.push_back(all_reg_indices[static_cast<size_t>(idx)]);
-    }
-    LOG(INFO) << "write_bundler: subsampled " << all_reg_indices.size() << " registered cameras → "
-              << reg_indices.size() << " for Bundler output";
-  } else {
-    reg_indices = all_reg_indices;
+  const size_t n_imgs = image_to_camera_index.size();
+  if (static_cast<size_t>(store->num_images()) != n_imgs) {
+    LOG(ERROR) << tracks_path << " has " << store->num_images() << " images, project has "
+               << n_imgs;
+    return false;
   }
 
-  // Map global image index → bundler camera index (only registered images)
-  std::vector<int> global_to_bundler(static_cast<size_t>(n_images), -1);
-  for (int bi = 0; bi < static_cast<int>(reg_indices.size()); ++bi)
-    global_to_bundler[static_cast<size_t>(reg_indices[bi])] = bi;
-
-  // Collect valid (triangulated) tracks and their observation lists
-  struct BundlerPoint {
-    float x, y, z;
-    std::vector<std::tuple<int, int, float, float>> views; // (cam_idx, key_idx, bx, by)
-  };
-  std::vector<BundlerPoint> points;
-  points.reserve(store.num_tracks());
-
-  std::vector<Observation> obs_buf;
-  for (size_t ti = 0; ti < store.num_tracks(); ++ti) {
-    const int tid = static_cast<int>(ti);
-    if (!store.is_track_valid(tid) || !store.track_has_triangulated_xyz(tid))
+  std::vector<SubReconstruction> subs;
+  for (const std::string& dir : model_dirs) {
+    const std::string sub_path = (std::filesystem::path(dir) / "tracks.isat_tracks").string();
+    SubReconstruction sub;
+    if (!load_sub_reconstruction(sub_path, &sub) || sub.registered.size() != n_imgs) {
+      LOG(WARNING) << "Skipping sub-model " << dir << " (missing or incompatible result)";
       continue;
-    float px, py, pz;
-    store.get_track_xyz(tid, &px, &py, &pz);
-
-    obs_buf.clear();
-    store.get_track_observations(tid, &obs_buf);
-
-    BundlerPoint bp;
-    bp.x = px;
-    bp.y = py;
-    bp.z = pz;
-    for (const auto& o : obs_buf) {
-      const int im = static_cast<int>(o.image_index);
-      if (im < 0 || im >= n_images || !registered[static_cast<size_t>(im)])
-        continue;
-      const int bi = global_to_bundler[static_cast<size_t>(im)];
-      if (bi < 0)
-        continue;
-      const camera::Intrinsics& K =
-          cameras[static_cast<size_t>(image_to_camera_index[static_cast<size_t>(im)])];
-      // Bundler image coords: origin at principal point, y-axis up
-      const float bx = static_cast<float>(o.u) - static_cast<float>(K.cx);
-      const float by = -(static_cast<float>(o.v) - static_cast<float>(K.cy));
-      bp.views.emplace_back(bi, tid, bx, by);
     }
-    if (bp.views.size() >= 2)
-      points.push_back(std::move(bp));
+    subs.push_back(std::move(sub));
   }
-
-  // Write list.txt
-  const std::string list_path = out_dir + "/list.txt";
-  {
-    std::ofstream lf(list_path);
-    if (!lf.is_open()) {
-      LOG(ERROR) << "Cannot write " << list_path;
-      return false;
-    }
-    for (int gi : reg_indices) {
-      const std::string& p = (gi < static_cast<int>(image_paths.size()))
-                                 ? image_paths[static_cast<size_t>(gi)]
-                                 : "image_" + std::to_string(gi) + ".jpg";
-      lf << p << "\n";
-    }
-  }
-  LOG(INFO) << "Wrote " << list_path;
-
-  // Write bundle.out
-  const std::string bundle_path = out_dir + "/bundle.out";
-  std::ofstream bf(bundle_path);
-  if (!bf.is_open()) {
-    LOG(ERROR) << "Cannot write " << bundle_path;
+  std::vector<SubModelMergeInfo> info;
+  if (subs.empty() || !merge_sub_reconstructions(subs, image_to_camera_index, merge_opts, poses_R,
+                                                 poses_C, registered, cameras, &info)) {
+    LOG(ERROR) << "No sub-model could be merged";
     return false;
   }
 
-  bf << "# Bundle file v0.3\n";
-  bf << reg_indices.size() << " " << points.size() << "\n";
-  bf << std::fixed;
-
-  // Flip matrix: converts OpenCV → Bundler (flip y and z axes)
-  const Eigen::Matrix3d flip = Eigen::DiagonalMatrix<double, 3>(1.0, -1.0, -1.0);
-
-  for (int gi : reg_indices) {
-    const camera::Intrinsics& K =
-        cameras[static_cast<size_t>(image_to_camera_index[static_cast<size_t>(gi)])];
-    const double f = (K.fx + K.fy) * 0.5;
-    const double k1 = K.k1;
-    const double k2 = K.k2;
-    bf << f << " " << k1 << " " << k2 << "\n";
-
-    // R_bundler = flip * R_opencv
-    const Eigen::Matrix3d Rb = flip * poses_R[static_cast<size_t>(gi)];
-    for (int r = 0; r < 3; ++r) {
-      bf << Rb(r, 0) << " " << Rb(r, 1) << " " << Rb(r, 2) << "\n";
-    }
-    // t = R_bundler * (-C_opencv) = flip * R * (-C)
-    const Eigen::Vector3d t = Rb * (-poses_C[static_cast<size_t>(gi)]);
-    bf << t(0) << " " << t(1) << " " << t(2) << "\n";
-  }
-
-  for (const auto& p : points) {
-    bf << p.x << " " << p.y << " " << p.z << "\n";
-    bf << "128 128 128\n"; // dummy colour
-    bf << p.views.size();
-    for (const auto& [cam_idx, key_idx, bx, by] : p.views)
-      bf << " " << cam_idx << " " << key_idx << " " << bx << " " << by;
-    bf << "\n";
-  }
-
-  LOG(INFO) << "Wrote " << bundle_path << " (" << reg_indices.size() << " cameras, "
-            << points.size() << " points)";
-  return true;
-}
-
-// Mean reprojection error (px) for one track: pipeline-consistent with incremental_sfm_pipeline /
-// bundle_adjustment_analytic (distorted pixels, same as collect_reproj_errors).
-static double track_mean_reprojection_error_px(
-    const std::vector<Observation>& track_obs, const Eigen::Vector3d& X,
-    const std::vector<Eigen::Matrix3d>& poses_R, const std::vector<Eigen::Vector3d>& poses_C,
-    const std::vector<bool>& registered, const std::vector<camera::Intrinsics>& cameras,
-    const std::vector<int>& image_to_camera_index, int n_images) {
-  double sum = 0.0;
-  int n = 0;
-  for (const auto& o : track_obs) {
-    const int im = static_cast<int>(o.image_index);
-    if (im < 0 || im >= n_images || !registered[static_cast<size_t>(im)])
-      continue;
-    const int ci = image_to_camera_index[static_cast<size_t>(im)];
-    if (ci < 0 || ci >= static_cast<int>(cameras.size()))
+  int anchor_image = -1, n_reg = 0;
+  for (size_t i = 0; i < n_imgs; ++i) {
+    if (!(*registered)[i])
       continue;
-    const Eigen::Matrix3d& R = poses_R[static_cast<size_t>(im)];
-    const Eigen::Vector3d& C = poses_C[static_cast<size_t>(im)];
-    Eigen::Vector3d p = R * (X - C);
-    if (p(2) <= 1e-12)
-      continue;
-    const camera::Intrinsics& K = cameras[static_cast<size_t>(ci)];
-    const double xn = p(0) / p(2), yn = p(1) / p(2);
-    double xd = 0.0, yd = 0.0;
-    camera::apply_distortion(xn, yn, K, &xd, &yd);
-    const double u_pred = K.fx * xd + K.cx;
-    const double v_pred = K.fy * yd + K.cy;
-    const double du = static_cast<double>(o.u) - u_pred;
-    const double dv = static_cast<double>(o.v) - v_pred;
-    sum += std::sqrt(du * du + dv * dv);
-    ++n;
-  }
-  return n > 0 ? sum / static_cast<double>(n) : 0.0;
-}
-
-// ─── COLMAP sparse text output ────────────────────────────────────────────────
-// Writes three text files to <out_dir>/colmap/sparse/0/:
-//   cameras.txt  – OPENCV only (OpenCV tangential order; p1/p2 swapped from internal
-//   ContextCapture) images.txt   – registered images: pose as quaternion + translation, with
-//   per-image 2D points points3D.txt – triangulated 3D points with full track (IMAGE_ID POINT2D_IDX
-//   pairs);
-//                  ERROR column = mean reprojection error (px) over track observations
-//
-// COLMAP conventions:
-//   rotation: QW QX QY QZ  (Eigen::Quaterniond(R))
-//   translation: t = R * (-C)  (same as Bundler but without y-flip)
-//   camera IDs and image IDs are 1-indexed
-//   POINT2D_IDX: 0-based index into the image's POINTS2D list in images.txt
-static bool write_colmap(const std::string& out_dir, const std::vector<std::string>& image_paths,
-                         const std::vector<Eigen::Matrix3d>& poses_R,
-                         const std::vector<Eigen::Vector3d>& poses_C,
-                         const std::vector<bool>& registered,
-                         const std::vector<camera::Intrinsics>& cameras,
-                         const std::vector<int>& image_to_camera_index, const TrackStore& store) {
-  ScopedTimer total_timer("write_colmap total");
-  namespace fs = std::filesystem;
-
-  const std::string sparse_dir = out_dir + "/colmap/sparse/0";
-  try {
-    fs::create_directories(sparse_dir);
-  } catch (const std::exception& e) {
-    LOG(ERROR) << "write_colmap: cannot create " << sparse_dir << ": " << e.what();
+    if (anchor_image < 0)
+      anchor_image = static_cast<int>(i);
+    ++n_reg;
+  }
+  LOG(INFO) << "merge_sub_models: " << subs.size() << " sub-models → " << n_reg
+            << " registered images";
+
+  const double min_angle = opts.triangulation.min_angle_deg;
+  const double commit_px = opts.triangulation.commit_reproj_px;
+  int n_tri = run_full_scan_triangulation(store, *poses_R, *poses_C, *registered, *cameras,
+                                          image_to_camera_index, min_angle, commit_px);
+  LOG(INFO) << "merge_sub_models: triangulated " << n_tri << " tracks from merged poses";
+  double rmse = 0.0;
+  if (!run_ba_with_outlier_detection(store, poses_R, poses_C, *registered, image_to_camera_index,
+                                     cameras, anchor_image, n_reg, opts, &rmse)) {
+    LOG(ERROR) << "merge_sub_models: global BA failed";
     return false;
   }
-
-  const int n_images = static_cast<int>(registered.size());
-
-  // ── Map global image index → COLMAP 1-based image ID ─────────────────────
-  std::vector<int> global_to_colmap_id(static_cast<size_t>(n_images), 0);
-  int next_img_id = 1;
-  for (int i = 0; i < n_images; ++i)
-    if (registered[static_cast<size_t>(i)])
-      global_to_colmap_id[static_cast<size_t>(i)] = next_img_id++;
-
-  // ── Determine unique cameras and assign COLMAP camera IDs ─────────────────
-  // We map each camera index in project → COLMAP camera ID (1-based)
-  const int n_cams = static_cast<int>(cameras.size());
-  std::vector<int> cam_to_colmap_id(static_cast<size_t>(n_cams), 0);
-  int next_cam_id = 1;
-  // Only emit cameras that are actually used by at least one registered image
-  for (int i = 0; i < n_images; ++i) {
-    if (!registered[static_cast<size_t>(i)])
-      continue;
-    const int ci = image_to_camera_index[static_cast<size_t>(i)];
-    if (ci >= 0 && ci < n_cams && cam_to_colmap_id[static_cast<size_t>(ci)] == 0)
-      cam_to_colmap_id[static_cast<size_t>(ci)] = next_cam_id++;
-  }
-
-  // ── cameras.txt ──────────────────────────────────────────────────────────
-  const std::string cams_path = sparse_dir + "/cameras.txt";
-  {
-    std::ofstream f(cams_path);
-    if (!f.is_open()) {
-      LOG(ERROR) << "Cannot write " << cams_path;
-      return false;
-    }
-    f << "# Camera list with one line of data per camera:\n"
-      << "#   CAMERA_ID, MODEL, WIDTH, HEIGHT, PARAMS[]\n"
-      << "# Number of cameras: " << (next_cam_id - 1) << "\n";
-    f << std::fixed << std::setprecision(6);
-    for (int ci = 0; ci < n_cams; ++ci) {
-      if (cam_to_colmap_id[static_cast<size_t>(ci)] == 0)
-        continue;
-      const camera::Intrinsics& K = cameras[static_cast<size_t>(ci)];
-      const int cmap_id = cam_to_colmap_id[static_cast<size_t>(ci)];
-      // COLMAP OpenCV tangential order differs from internal ContextCapture: OpenCV p1 = K.p2,
-      // OpenCV p2 = K.p1.
-      // - OPENCV: fx fy cx cy k1 k2 p1 p2 — only two radial coeffs (no k3 in this model).
-      // - FULL_OPENCV: fx fy cx cy k1 k2 p1 p2 k3 k4 k5 k6 — rational radial; with k4=k5=k6=0
-      //   matches polynomial (1 + k1*r² + k2*r⁴ + k3*r⁶) / 1, i.e. standard OpenCV + k3.
-      if (std::abs(K.k3) <= 1e-12) {
-        f << cmap_id << " OPENCV " << K.width << " " << K.height << " " << K.fx << " " << K.fy
-          << " " << K.cx << " " << K.cy << " " << K.k1 << " " << K.k2 << " " << K.p2 << " " << K.p1
-          << "\n";
-      } else {
-        f << cmap_id << " FULL_OPENCV " << K.width << " " << K.height << " " << K.fx << " " << K.fy
-          << " " << K.cx << " " << K.cy << " " << K.k1 << " " << K.k2 << " " << K.p2 << " " << K.p1
-          << " " << K.k3 << " 0 0 0\n";
-      }
-    }
-  }
-  LOG(INFO) << "write_colmap: wrote " << cams_path;
-
-  // ── Build per-image 2D → 3D observation lists (for images.txt + points3D.txt) ────
-  // obs2d[global_image_index] = list of (u, v, point3d_id_1based, track_id)
-  struct Obs2D {
-    float u, v;
-    int point3d_id;
-  };
-  std::vector<std::vector<Obs2D>> img_obs(static_cast<size_t>(n_images));
-
-  // Collect valid tracks and assign 1-based COLMAP point3D IDs
-  struct ColmapPoint3D {
-    float x, y, z;
-    int point3d_id;                         // 1-based
-    double mean_reproj_px;                  ///< COLMAP points3D.txt ERROR field
-    std::vector<std::pair<int, int>> track; // (colmap_image_id, point2d_idx)
-  };
-
-  std::vector<ColmapPoint3D> colmap_points;
-  colmap_points.reserve(store.num_tracks());
-  int next_pt_id = 1;
-
-  std::vector<Observation> obs_buf;
-  size_t total_obs_for_reproj = 0;
-  for (size_t ti = 0; ti < store.num_tracks(); ++ti) {
-    const int tid = static_cast<int>(ti);
-    if (!store.is_track_valid(tid) || !store.track_has_triangulated_xyz(tid))
-      continue;
-    float px, py, pz;
-    store.get_track_xyz(tid, &px, &py, &pz);
-
-    obs_buf.clear();
-    store.get_track_observations(tid, &obs_buf);
-
-    ColmapPoint3D pt;
-    pt.x = px;
-    pt.y = py;
-    pt.z = pz;
-    pt.point3d_id = next_pt_id;
-    const Eigen::Vector3d Xw(static_cast<double>(px), static_cast<double>(py),
-                             static_cast<double>(pz));
-    total_obs_for_reproj += obs_buf.size();
-    pt.mean_reproj_px = track_mean_reprojection_error_px(obs_buf, Xw, poses_R, poses_C, registered,
-                                                         cameras, image_to_camera_index, n_images);
-
-    for (const auto& o : obs_buf) {
-      const int im = static_cast<int>(o.image_index);
-      if (im < 0 || im >= n_images || !registered[static_cast<size_t>(im)])
-        continue;
-      const int cmap_img_id = global_to_colmap_id[static_cast<size_t>(im)];
-      if (cmap_img_id == 0)
-        continue;
-      // POINT2D_IDX will be the current size of img_obs[im] before we push
-      const int pt2d_idx = static_cast<int>(img_obs[static_cast<size_t>(im)].size());
-      img_obs[static_cast<size_t>(im)].push_back({o.u, o.v, next_pt_id});
-      pt.track.emplace_back(cmap_img_id, pt2d_idx);
-    }
-
-    if (pt.track.size() >= 2) {
-      colmap_points.push_back(std::move(pt));
-      ++next_pt_id;
-    }
-  }
-
-  // ── images.txt ───────────────────────────────────────────────────────────
-  const std::string imgs_path = sparse_dir + "/images.txt";
-  {
-    std::ofstream f(imgs_path);
-    if (!f.is_open()) {
-      LOG(ERROR) << "Cannot write " << imgs_path;
-      return false;
-    }
-    f << "# Image list with two lines of data per image:\n"
-      << "#   IMAGE_ID, QW, QX, QY, QZ, TX, TY, TZ, CAMERA_ID, NAME\n"
-      << "#   POINTS2D[] as (X, Y, POINT3D_ID)\n"
-      << "# Number of images: " << (next_img_id - 1) << "\n";
-    f << std::fixed << std::setprecision(9);
-    for (int i = 0; i < n_images; ++i) {
-      if (!registered[static_cast<size_t>(i)])
-        continue;
-      const int cmap_img_id = global_to_colmap_id[static_cast<size_t>(i)];
-      const int ci = image_to_camera_index[static_cast<size_t>(i)];
-      const int cmap_cam_id = cam_to_colmap_id[static_cast<size_t>(ci)];
-
-      const Eigen::Quaterniond q(poses_R[static_cast<size_t>(i)]);
-      const Eigen::Vector3d t =
-          poses_R[static_cast<size_t>(i)] * (-poses_C[static_cast<size_t>(i)]);
-
-      const std::string name =
-          (i < static_cast<int>(image_paths.size()))
-              ? fs::path(image_paths[static_cast<size_t>(i)]).filename().string()
-              : "image_" + std::to_string(i) + ".jpg";
-
-      // Line 1: pose
-      f << cmap_img_id << " " << q.w() << " " << q.x() << " " << q.y() << " " << q.z() << " "
-        << t(0) << " " << t(1) << " " << t(2) << " " << cmap_cam_id << " " << name << "\n";
-
-      // Line 2: 2D points (X Y POINT3D_ID, -1 if not triangulated)
-      const auto& obs = img_obs[static_cast<size_t>(i)];
-      if (obs.empty()) {
-        f << "\n";
-      } else {
-        f << std::setprecision(2);
-        for (size_t oi = 0; oi < obs.size(); ++oi) {
-          if (oi > 0)
-            f << " ";
-          f << obs[oi].u << " " << obs[oi].v << " " << obs[oi].point3d_id;
-        }
-        f << "\n";
-        f << std::setprecision(9);
-      }
-    }
-  }
-  LOG(INFO) << "write_colmap: wrote " << imgs_path;
-
-  // ── points3D.txt ─────────────────────────────────────────────────────────
-  const std::string pts_path = sparse_dir + "/points3D.txt";
-  {
-    std::ofstream f(pts_path);
-    if (!f.is_open()) {
-      LOG(ERROR) << "Cannot write " << pts_path;
-      return false;
-    }
-    f << "# 3D point list with one line of data per point:\n"
-      << "#   POINT3D_ID, X, Y, Z, R, G, B, ERROR, TRACK[]\n"
-      << "# Number of points: " << colmap_points.size() << "\n";
-    f << std::fixed << std::setprecision(6);
-    for (const auto& pt : colmap_points) {
-      f << pt.point3d_id << " " << pt.x << " " << pt.y << " " << pt.z << " 128 128 128 "
-        << pt.mean_reproj_px;
-      for (const auto& [img_id, pt2d_idx] : pt.track)
-        f << " " << img_id << " " << pt2d_idx;
-      f << "\n";
-    }
-  }
-  LOG(INFO) << "write_colmap: wrote " << pts_path << " (" << colmap_points.size() << " points)";
-  LOG(INFO) << "[timing] write_colmap reproj_eval observations=" << total_obs_for_reproj;
+  // Tracks cleared by outlier rejection get another chance with the refined poses.
+  n_tri = run_full_scan_triangulation(store, *poses_R, *poses_C, *registered, *cameras,
+                                      image_to_camera_index, min_angle, commit_px);
+  LOG(INFO) << "merge_sub_models: global BA RMSE=" << rmse << " px, re-triangulated " << n_tri
+            << " tracks";
   return true;
 }
 
@@ -532,12 +136,20 @@ int main(int argc, char* argv[]) {
   int bundler_max_cameras = -1;
   int ba_grid_target = 1000;
   int ba_threads = 0;
+  std::string ba_solver = "ceres";
+  std::string ba_preconditioner = "schur-jacobi";
   int max_registered_images = 0;
   int init_min_inliers = 100;
   double init_max_forward_motion = 0.95;
   double init_min_angle_deg = 2.0;
   double init_min_median_angle_deg = 30.0;
   int resection_min_inliers = 15;
+  std::string checkpoint_dir;
+  std::string resume_dir;
+  int checkpoint_every_n = 0;
+  double checkpoint_every_min = 0.0;
+  std::string merge_models;
+  MergeOptions merge_opts;
   CmdLine cmd("Incremental SfM: tracks IDC + project JSON + pairs + geo → poses");
   cmd.add(make_option('t', tracks_path, "tracks").doc("Path to .isat_tracks IDC"));
   cmd.add(make_option('p', project_path, "project").doc("Path to project JSON"));
@@ -567,6 +179,10 @@ int main(int argc, char* argv[]) {
                    "0=off)."));
   cmd.add(make_option(0, ba_threads, "ba-threads")
               .doc("Ceres num_threads for BA solves (default: 0 = use hardware concurrency)."));
+  cmd.add(make_option(0, ba_solver, "ba-solver")
+              .doc("BA backend: ceres [default] | native (block-sparse Schur + PCG)."));
+  cmd.add(make_option(0, ba_preconditioner, "ba-preconditioner")
+              .doc("Native BA preconditioner: jacobi | schur-jacobi [default] | cluster-jacobi."));
   cmd.add(make_option(0, max_registered_images, "max-registered-images")
               .doc("Early stop when registered image count reaches this cap (0=disabled)."));
   cmd.add(make_option(0, init_min_inliers, "init-min-inliers")
@@ -579,6 +195,21 @@ int main(int argc, char* argv[]) {
               .doc("Initial pair gate: minimum median triangulation angle in degrees (default: 30.0)."));
   cmd.add(make_option(0, resection_min_inliers, "resection-min-inliers")
               .doc("Resection gate: minimum PnP RANSAC inliers to accept new image registration (default: 15)."));
+  cmd.add(make_option(0, checkpoint_dir, "checkpoint-dir")
+              .doc("Write periodic checkpoints (tracks + poses + scheduler state) to this directory."));
+  cmd.add(make_option(0, checkpoint_every_n, "checkpoint-every-n")
+              .doc("Checkpoint every N newly registered images (0=off)."));
+  cmd.add(make_option(0, checkpoint_every_min, "checkpoint-every-min")
+              .doc("Checkpoint every M minutes of wall time (0=off; default 30 when "
+                   "--checkpoint-every-n is also 0)."));
+  cmd.add(make_option(0, resume_dir, "resume")
+              .doc("Resume from the latest checkpoint in this directory (skips the initial pair; "
+                   "keeps checkpointing there unless --checkpoint-dir is given)."));
+  cmd.add(make_option(0, merge_models, "merge-models")
+              .doc("Comma-separated sub-model output directories (partitioned SfM): merge them by "
+                   "Sim3 instead of running the incremental pipeline (-m/-g not needed)."));
+  cmd.add(make_option(0, merge_opts.min_shared_images, "merge-min-shared-images")
+              .doc("Registered images a sub-model must share with the merged model (default: 3)."));
   cmd.add(make_switch('v', "verbose").doc("Verbose (INFO)"));
   cmd.add(make_switch('q', "quiet").doc("Quiet (ERROR only)"));
   cmd.add(make_switch('h', "help").doc("Show help"));
@@ -591,17 +222,48 @@ int main(int argc, char* argv[]) {
   }
   if (cmd.checkHelp(argv[0]))
     return 0;
-  if (tracks_path.empty() || project_path.empty() || pairs_path.empty() || geo_dir.empty() ||
-      output_dir.empty()) {
+  std::vector<std::string> merge_dirs;
+  {
+    std::stringstream ss(merge_models);
+    std::string dir;
+    while (std::getline(ss, dir, ','))
+      if (!dir.empty())
+        merge_dirs.push_back(dir);
+  }
+  if (merge_dirs.empty() && (tracks_path.empty() || project_path.empty() || pairs_path.empty() ||
+                             geo_dir.empty() || output_dir.empty())) {
     std::cerr << "Error: -t, -p, -m, -g, -o are required\n\n";
     cmd.printHelp(std::cerr, argv[0]);
     return 1;
   }
+  if (!merge_dirs.empty() && (tracks_path.empty() || project_path.empty() || output_dir.empty())) {
+    std::cerr << "Error: -t, -p, -o are required with --merge-models\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+  if (merge_opts.min_shared_images < 1) {
+    std::cerr << "Error: --merge-min-shared-images must be >= 1\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
   if (ba_threads < 0) {
     std::cerr << "Error: --ba-threads must be >= 0\n\n";
     cmd.printHelp(std::cerr, argv[0]);
     return 1;
   }
+  int native_preconditioner = -1;
+  if (ba_preconditioner == "jacobi")
+    native_preconditioner = 0;
+  else if (ba_preconditioner == "schur-jacobi")
+    native_preconditioner = 1;
+  else if (ba_preconditioner == "cluster-jacobi")
+    native_preconditioner = 2;
+  if ((ba_solver != "ceres" && ba_solver != "native") || native_preconditioner < 0) {
+    std::cerr << "Error: --ba-solver must be ceres|native and --ba-preconditioner "
+                 "jacobi|schur-jacobi|cluster-jacobi\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
   if (max_registered_images < 0) {
     std::cerr << "Error: --max-registered-images must be >= 0\n\n";
     cmd.printHelp(std::cerr, argv[0]);
@@ -627,6 +289,11 @@ int main(int argc, char* argv[]) {
     cmd.printHelp(std::cerr, argv[0]);
     return 1;
   }
+  if (checkpoint_every_n < 0 || checkpoint_every_min < 0.0) {
+    std::cerr << "Error: --checkpoint-every-n and --checkpoint-every-min must be >= 0\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
   insight::tools::apply_log_level(cmd.used('v'), cmd.used('q'), log_level);
 
   ProjectData project;
@@ -698,6 +365,11 @@ int main(int argc, char* argv[]) {
     opts.global_ba.solver_overrides.num_threads = ba_threads;
     LOG(INFO) << "Ceres BA num_threads=" << ba_threads;
   }
+  if (ba_solver == "native") {
+    opts.global_ba.solver_overrides.native_schur = true;
+    opts.global_ba.solver_overrides.native_preconditioner = native_preconditioner;
+    LOG(INFO) << "BA backend: native Schur + PCG (" << ba_preconditioner << ")";
+  }
   if (cmd.used("fix-intrinsics")) {
     opts.global_ba.optimize_intrinsics = false;
     LOG(INFO) << "--fix-intrinsics: camera intrinsics will be held constant in all BA runs.";
@@ -760,7 +432,30 @@ int main(int argc, char* argv[]) {
               << (bundler_max_cameras > 0 ? std::to_string(bundler_max_cameras) : "all");
   }
 
-  {
+  // Checkpoints / resume: a resumed run keeps checkpointing into the directory it resumed from.
+  if (checkpoint_dir.empty())
+    checkpoint_dir = resume_dir;
+  if (!checkpoint_dir.empty()) {
+    opts.checkpoint.dir = checkpoint_dir;
+    opts.checkpoint.every_n_registrations = checkpoint_every_n;
+    opts.checkpoint.every_minutes =
+        (checkpoint_every_n == 0 && checkpoint_every_min == 0.0) ? 30.0 : checkpoint_every_min;
+    opts.checkpoint.resume_from = resume_dir;
+    LOG(INFO) << "--checkpoint-dir=" << checkpoint_dir
+              << "  every_n=" << opts.checkpoint.every_n_registrations
+              << "  every_min=" << opts.checkpoint.every_minutes
+              << (resume_dir.empty() ? "" : "  (resuming from " + resume_dir + ")");
+  }
+
+  if (!merge_dirs.empty()) {
+    ScopedTimer timer("merge_sub_models");
+    if (!merge_sub_models(tracks_path, merge_dirs, merge_opts, opts, &project.cameras,
+                          project.image_to_camera_index, &store, &poses_R, &poses_C,
+                          &registered)) {
+      LOG(ERROR) << "Sub-model merge failed";
+      return 1;
+    }
+  } else {
     ScopedTimer timer("run_incremental_sfm_pipeline");
     bool ok = false;
     ok = run_incremental_sfm_pipeline(tracks_path, pairs_path, geo_dir, &project.cameras,
@@ -804,69 +499,12 @@ int main(int argc, char* argv[]) {
                  project.image_to_camera_index, store);
   }
 
-  // ── Save TrackStore (3-D points + observation flags) to bundle dir ────────
   // Saved as tracks.isat_tracks in the same output directory so downstream
   // tools (test_sfm_diag2, isat_incremental_sfm re-run, …) can load it.
-  // All tracks are written (including dead/outlier), track_flags preserves
-  // kHasTriangulated so report tools can distinguish triangulated from raw.
   {
-    const int n_imgs = project.num_images();
-    std::vector<uint32_t> img_indices(static_cast<size_t>(n_imgs));
-    for (int i = 0; i < n_imgs; ++i)
-      img_indices[static_cast<size_t>(i)] = static_cast<uint32_t>(i);
-
-    // ── Build embedded pose + intrinsics data (replaces poses.json) ─────────
-    insight::sfm::SfMResultData sfm_pose;
-    sfm_pose.pose_R.resize(static_cast<size_t>(n_imgs) * 9, 0.0f);
-    sfm_pose.pose_C.resize(static_cast<size_t>(n_imgs) * 3, 0.0f);
-    sfm_pose.registered.resize(static_cast<size_t>(n_imgs), 0);
-    sfm_pose.cam_idx.resize(static_cast<size_t>(n_imgs), 0);
-
-    for (int i = 0; i < n_imgs; ++i) {
-      sfm_pose.registered[static_cast<size_t>(i)] = registered[static_cast<size_t>(i)] ? 1 : 0;
-      sfm_pose.cam_idx[static_cast<size_t>(i)] = project.image_to_camera_index[static_cast<size_t>(i)];
-      if (registered[static_cast<size_t>(i)]) {
-        const auto& R = poses_R[static_cast<size_t>(i)];
-        const auto& C = poses_C[static_cast<size_t>(i)];
-        float* r = &sfm_pose.pose_R[static_cast<size_t>(i) * 9];
-        r[0] = static_cast<float>(R(0,0)); r[1] = static_cast<float>(R(0,1)); r[2] = static_cast<float>(R(0,2));
-        r[3] = static_cast<float>(R(1,0)); r[4] = static_cast<float>(R(1,1)); r[5] = static_cast<float>(R(1,2));
-        r[6] = static_cast<float>(R(2,0)); r[7] = static_cast<float>(R(2,1)); r[8] = static_cast<float>(R(2,2));
-        float* c = &sfm_pose.pose_C[static_cast<size_t>(i) * 3];
-        c[0] = static_cast<float>(C(0)); c[1] = static_cast<float>(C(1)); c[2] = static_cast<float>(C(2));
-      }
-    }
-
-    sfm_pose.num_cameras = project.num_cameras();
-    sfm_pose.intrinsics.resize(static_cast<size_t>(sfm_pose.num_cameras) * 11, 0.0f);
-    for (int ci = 0; ci < sfm_pose.num_cameras; ++ci) {
-      const auto& K = project.cameras[static_cast<size_t>(ci)];
-      float* k = &sfm_pose.intrinsics[static_cast<size_t>(ci) * 11];
-      k[0] = static_cast<float>(K.fx);  k[1] = static_cast<float>(K.fy);
-      k[2] = static_cast<float>(K.cx);  k[3] = static_cast<float>(K.cy);
-      k[4] = static_cast<float>(K.width); k[5] = static_cast<float>(K.height);
-      k[6] = static_cast<float>(K.k1);  k[7] = static_cast<float>(K.k2);
-      k[8] = static_cast<float>(K.k3);  k[9] = static_cast<float>(K.p1);
-      k[10] = static_cast<float>(K.p2);
-    }
-
-    TrackSaveOptions sfm_opts;
-    sfm_opts.is_sfm_result = true;
-    sfm_opts.num_registered_images = n_reg;
-    sfm_opts.sfm_pose = &sfm_pose;
-    // num_triangulated / num_inlier auto-counted in save_track_store_to_idc
-
-    const std::string tracks_out = output_dir + "/tracks.isat_tracks";
-    {
-      ScopedTimer timer("save_track_store_to_idc");
-      if (save_track_store_to_idc(store, img_indices, tracks_out,
-                                  /*view_graph=*/nullptr, &sfm_opts)) {
-        LOG(INFO) << "Saved TrackStore → " << tracks_out << " (with " << n_reg
-                  << " embedded poses, " << sfm_pose.num_cameras << " cameras)";
-      } else {
-        LOG(ERROR) << "Failed to save TrackStore to " << tracks_out;
-      }
-    }
+    ScopedTimer timer("save_track_store_to_idc");
+    save_sfm_result_tracks(output_dir, store, poses_R, poses_C, registered, project.cameras,
+                           project.image_to_camera_index);
   }
 
   return 0;
@@ -3,15 +3,20 @@
  * InsightAT Feature Matching Tool – GPU-accelerated SIFT matching
  *
  * Reads a pairs JSON and .isat_feat files from a feature directory, runs
- * GPU-accelerated matching (SiftGPU), and writes
+ * GPU-accelerated matching (SiftGPU / PopSift) or, with --match-backend cpu,
+ * SIMD brute-force matching on the CPU, and writes
  * .isat_match files (pixel correspondences in IDC format).
  *
  * Pipeline (Stage/chain):
- *   Stage 1  [multi-thread I/O]   Load .isat_feat for each pair
+ *   Stage 1  [multi-thread I/O]   Load .isat_feat for each pair (shared FeatureCache;
+ *                                 pairs are fed in PairScheduler locality order)
  *   Stage 2  [main thread, EGL]   GPU matching (ratio test, optional cross-check)
+ *            [--match-threads]    or CPU matching, many pairs concurrently
  *   Stage 3  [multi-thread I/O]  Write .isat_match
  *
  * Output .isat_match (IDC): coords_pixel blob [x1,y1,x2,y2,...], metadata.
+ * With --output-format matchpack|both, pairs are also appended to block-packed
+ * .isat_matchpack files indexed by matchpack_index.isat_mpkx (see io/matchpack.h).
  *
  * Usage:
  *   isat_match -i pairs.json -f feat_dir/ -o match_dir/
@@ -25,15 +30,21 @@
 #include <glog/logging.h>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <mutex>
 #include <nlohmann/json.hpp>
 #include <numeric>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "../io/idc_reader.h"
 #include "../io/idc_writer.h"
+#include "../io/matchpack.h"
+#include "../modules/matching/feature_cache.h"
+#include "../modules/matching/feature_loader.h"
 #include "../modules/matching/match_types.h"
+#include "../modules/matching/pair_scheduler.h"
 #include "../modules/matching/sift_matcher.h"
 #include "cli_logging.h"
 #include "cmdLine/cmdLine.h"
@@ -54,14 +65,7 @@ static void printEvent(const json& j) {
 
 static bool write_pairs_json(const std::string& output_path,
                              const std::vector<std::pair<uint32_t, uint32_t>>& pairs) {
-  json pairs_arr = json::array();
-  for (const auto& [i, j] : pairs)
-    pairs_arr.push_back({{"image1_index", i}, {"image2_index", j}});
-  std::ofstream f(output_path);
-  if (!f.is_open())
-    return false;
-  f << json{{"pairs", pairs_arr}}.dump(2) << "\n";
-  return true;
+  return insight::tools::write_pair_list(output_path, pairs, insight::io::kPairMethodMatched);
 }
 using namespace insight::io;
 
@@ -75,9 +79,9 @@ struct PairTask {
   std::string feature2_file;
   float priority = 1.0f;
 
-  // Loaded features (stage 1)
-  FeatureData features1;
-  FeatureData features2;
+  // Loaded features (stage 1), shared through the feature cache; released after write
+  std::shared_ptr<const FeatureData> features1;
+  std::shared_ptr<const FeatureData> features2;
 
   // Match result (stage 2)
   MatchResult matches;
@@ -86,42 +90,40 @@ struct PairTask {
 };
 
 /**
- * Load pairs from JSON file.
+ * Load pairs from a .isat_pairs list or pairs JSON.
  *
  * If feature_dir is non-empty, feature paths are rebuilt from image IDs
  * as {feature_dir}/{image_id}.isat_feat (matching features, not retrieval features).
- * Otherwise, feature1_file/feature2_file from the JSON are used as-is.
+ * Otherwise, the feature files recorded in the pair list are used as-is.
  */
 std::vector<PairTask> loadPairsJSON(const std::string& json_path,
                                     const std::string& feature_dir = "") {
-  std::ifstream file(json_path);
-  if (!file.is_open()) {
-    LOG(FATAL) << "Failed to open pairs file: " << json_path;
-  }
-
-  json j;
-  file >> j;
-
   std::vector<PairTask> pairs;
   int index = 0;
 
-  for (const auto& pair : j["pairs"]) {
-    PairTask task;
-    task.image1_index = insight::tools::get_image_index_from_pair(pair, "image1_index");
-    task.image2_index = insight::tools::get_image_index_from_pair(pair, "image2_index");
-    task.priority = pair.value("priority", 1.0f);
-    task.index = index++;
-
-    if (!feature_dir.empty()) {
-      task.feature1_file = feature_dir + "/" + std::to_string(task.image1_index) + ".isat_feat";
-      task.feature2_file = feature_dir + "/" + std::to_string(task.image2_index) + ".isat_feat";
-    } else {
-      // Fall back to paths recorded in the pairs JSON (retrieval feature paths)
-      task.feature1_file = pair["feature1_file"];
-      task.feature2_file = pair["feature2_file"];
-    }
+  const bool ok = insight::tools::for_each_pair_in_list(
+      json_path, [&](const insight::tools::PairListEntry& pair) {
+        PairTask task;
+        task.image1_index = pair.image1_index;
+        task.image2_index = pair.image2_index;
+        task.priority = 1.0f + pair.score;
+        task.index = index++;
+
+        if (!feature_dir.empty()) {
+          task.feature1_file = feature_dir + "/" + std::to_string(task.image1_index) + ".isat_feat";
+          task.feature2_file = feature_dir + "/" + std::to_string(task.image2_index) + ".isat_feat";
+        } else if (pair.feature1_file && pair.feature2_file) {
+          // Fall back to paths recorded in the pair list (retrieval feature paths)
+          task.feature1_file = *pair.feature1_file;
+          task.feature2_file = *pair.feature2_file;
+        } else {
+          LOG(FATAL) << "Pair list has no feature files; pass --feature-dir: " << json_path;
+        }
 
-    pairs.push_back(task);
+        pairs.push_back(std::move(task));
+      });
+  if (!ok) {
+    LOG(FATAL) << "Failed to open pairs file: " << json_path;
   }
 
   LOG(INFO) << "Loaded " << pairs.size() << " pairs from " << json_path;
@@ -132,66 +134,10 @@ std::vector<PairTask> loadPairsJSON(const std::string& json_path,
 }
 
 /**
- * Load features from IDC file
+ * Load features from IDC file (memory-mapped, single copy per blob)
  */
 FeatureData loadFeaturesIDC(const std::string& idc_path) {
-  IDCReader reader(idc_path);
-
-  if (!reader.is_valid()) {
-    LOG(ERROR) << "Invalid IDC file: " << idc_path;
-    return FeatureData();
-  }
-
-  // Read keypoints blob
-  auto keypoints_raw = reader.read_blob<float>("keypoints");
-  if (keypoints_raw.empty()) {
-    LOG(ERROR) << "Failed to read keypoints from " << idc_path;
-    return FeatureData();
-  }
-
-  // Read descriptors blob - auto-detect dtype
-  auto desc_blob = reader.get_blob_descriptor("descriptors");
-  std::string dtype = desc_blob["dtype"];
-
-  size_t num_features = keypoints_raw.size() / 4;
-  DescriptorType descriptor_type;
-
-  if (dtype == "uint8") {
-    descriptor_type = DescriptorType::kUInt8;
-  } else if (dtype == "float32") {
-    descriptor_type = DescriptorType::kFloat32;
-  } else {
-    LOG(ERROR) << "Unsupported descriptor dtype: " << dtype << " in " << idc_path;
-    return FeatureData();
-  }
-
-  // Create FeatureData with appropriate descriptor type
-  FeatureData features(num_features, descriptor_type);
-
-  // Fill keypoints
-  for (size_t i = 0; i < num_features; ++i) {
-    features.keypoints[i] << keypoints_raw[i * 4 + 0], keypoints_raw[i * 4 + 1],
-        keypoints_raw[i * 4 + 2], keypoints_raw[i * 4 + 3];
-  }
-
-  // Read descriptors based on type
-  if (descriptor_type == DescriptorType::kUInt8) {
-    features.descriptors_uint8 = reader.read_blob<uint8_t>("descriptors");
-    if (features.descriptors_uint8.empty()) {
-      LOG(ERROR) << "Failed to read uint8 descriptors from " << idc_path;
-      return FeatureData();
-    }
-  } else {
-    features.descriptors_float = reader.read_blob<float>("descriptors");
-    if (features.descriptors_float.empty()) {
-      LOG(ERROR) << "Failed to read float32 descriptors from " << idc_path;
-      return FeatureData();
-    }
-  }
-
-  VLOG(1) << "Loaded " << num_features << " features (" << dtype << ") from " << idc_path;
-
-  return features;
+  return load_feature_data_idc(idc_path);
 }
 
 /**
@@ -266,11 +212,19 @@ static size_t sanitize_matches_one_to_one(MatchResult* matches) {
   return removed;
 }
 
+/** metadata algorithm.name for a matcher impl string ("popsift" / "sift_gpu" / "cpu_bruteforce"). */
+std::string matcherAlgorithmName(const std::string& matcher_impl) {
+  if (matcher_impl == "popsift") return "POP_SIFT";
+  if (matcher_impl == "cpu_bruteforce") return "CPU_BRUTE_FORCE";
+  return "SIFT_GPU";
+}
+
 /**
  * Write match result to IDC file
  */
 bool writeMatchIDC(const MatchResult& matches, const PairTask& pair,
-                   const std::string& output_dir, const std::string& matcher_impl) {
+                   const std::string& output_dir, const std::string& matcher_impl,
+                   bool write_file, MatchPackWriter* pack_writer) {
 
   if (matches.num_matches == 0) {
     LOG(WARNING) << "No matches for pair " << pair.image1_index << " - " << pair.image2_index;
@@ -283,7 +237,7 @@ bool writeMatchIDC(const MatchResult& matches, const PairTask& pair,
   json metadata;
   metadata["schema_version"] = "1.0";
   metadata["task_type"] = "feature_matching";
-  metadata["algorithm"]["name"] = (matcher_impl == "popsift") ? "POP_SIFT" : "SIFT_GPU";
+  metadata["algorithm"]["name"] = matcherAlgorithmName(matcher_impl);
   metadata["algorithm"]["impl"] = matcher_impl;
   metadata["algorithm"]["version"] = "1.2";
 
@@ -312,8 +266,9 @@ bool writeMatchIDC(const MatchResult& matches, const PairTask& pair,
   // Scales per match [s1, s2] for weighted BA; from keypoints (index 2 = scale)
   std::vector<float> scales_flat;
   scales_flat.reserve(matches.num_matches * 2);
-  const auto& kpts1 = pair.features1.keypoints;
-  const auto& kpts2 = pair.features2.keypoints;
+  static const std::vector<Eigen::Vector4f> kNoKeypoints;
+  const auto& kpts1 = pair.features1 ? pair.features1->keypoints : kNoKeypoints;
+  const auto& kpts2 = pair.features2 ? pair.features2->keypoints : kNoKeypoints;
   for (size_t m = 0; m < matches.num_matches; ++m) {
     float s1 = 1.0f;
     float s2 = 1.0f;
@@ -325,6 +280,21 @@ bool writeMatchIDC(const MatchResult& matches, const PairTask& pair,
     scales_flat.push_back(s2);
   }
 
+  if (pack_writer) {
+    std::vector<float> distances_flat(matches.num_matches, 0.0f);
+    if (matches.distances.size() == matches.num_matches)
+      distances_flat = matches.distances;
+    if (!pack_writer->add_pair(pair.image1_index, pair.image2_index, indices_flat.data(),
+                               coords_flat.data(), scales_flat.data(), distances_flat.data(),
+                               matches.num_matches)) {
+      LOG(ERROR) << "Failed to pack matches for pair " << pair.image1_index << " - "
+                 << pair.image2_index;
+      return false;
+    }
+  }
+  if (!write_file)
+    return true;
+
   // Write IDC file
   IDCWriter writer(output_file);
   writer.set_metadata(metadata);
@@ -369,20 +339,33 @@ int main(int argc, char* argv[]) {
   int grid_rows = 4;        // spatial stratification grid rows
   int grid_cols = 4;        // spatial stratification grid cols
   int num_threads = 4;
+  std::string output_format_str = "file";
+  int matchpack_block_size = 10000;
+  int feature_cache_mb = 2048;
+  std::string pair_order = "locality";
   bool use_pop_sift = false;
   bool use_sift_gpu = false;
 
   // Required arguments
   cmd.add(make_option('i', pairs_json, "input")
-              .doc("Input pairs list (JSON format, from isat_retrieve)"));
+              .doc("Input pairs list (.isat_pairs or JSON, from isat_retrieve)"));
   cmd.add(make_option('o', output_dir, "output").doc("Output directory for .isat_match files"));
   cmd.add(make_option(0, output_pairs_json, "output-pairs-json")
-              .doc("Optional JSON path listing only pairs whose .isat_match files were written."));
+              .doc("Optional list of pairs whose matches were written "
+                   "(.isat_pairs = binary pair list, otherwise JSON)."));
   cmd.add(make_option('f', feature_dir, "feature-dir")
               .doc("Matching feature directory (.isat_feat files from isat_extract -o). "
                    "Paths are rebuilt as {dir}/{image_id}.isat_feat, overriding the "
                    "retrieval feature paths stored in the pairs JSON."));
 
+  cmd.add(make_option(0, output_format_str, "output-format")
+              .doc("Output match format: file|matchpack|both. Default: file.\n"
+                   "  file      -> per-pair .isat_match files.\n"
+                   "  matchpack -> block .isat_matchpack + matchpack_index.isat_mpkx.\n"
+                   "  both      -> write both formats."));
+  cmd.add(make_option(0, matchpack_block_size, "matchpack-block-size")
+              .doc("Pairs per .isat_matchpack block (default: 10000)"));
+
   // Matching parameters
   cmd.add(make_option('r', ratio_test, "ratio").doc("Ratio test threshold (default: 0.8)"));
   cmd.add(make_option(0, max_matches, "max-matches")
@@ -400,9 +383,19 @@ int main(int argc, char* argv[]) {
   // Performance options
   cmd.add(
       make_option('j', num_threads, "threads").doc("Number of CPU threads for I/O (default: 4)"));
+  cmd.add(make_option(0, feature_cache_mb, "feature-cache-mb")
+              .doc("Memory budget (MB) for decoded .isat_feat shared across pairs (default: 2048). "
+                   "0 = no reuse beyond pairs in flight"));
+  cmd.add(make_option(0, pair_order, "pair-order")
+              .doc("Pair processing order: locality (graph traversal maximising feature reuse) "
+                   "or input (default: locality)"));
   std::string match_backend = "cuda";
   cmd.add(make_option(0, match_backend, "match-backend")
-              .doc("GPU backend for matching: cuda or glsl (default: cuda when built with CUDA)"));
+              .doc("Matching backend: cuda, glsl or cpu (default: cuda when built with CUDA). "
+                   "cpu = SIMD brute force with the same ratio / distance / cross-check rule"));
+  int match_threads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+  cmd.add(make_option(0, match_threads, "match-threads")
+              .doc("Concurrent pair matchers for --match-backend cpu (default: all cores)"));
   cmd.add(make_switch(0, "use-pop-sift").doc("Use PopSift brute-force matcher backend"));
   cmd.add(make_switch(0, "use-sift-gpu").doc("Use SiftGPU matcher backend"));
 
@@ -434,6 +427,40 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
+  if (output_format_str != "file" && output_format_str != "matchpack" &&
+      output_format_str != "both") {
+    std::cerr << "Error: --output-format must be file, matchpack, or both\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+  if (matchpack_block_size <= 0) {
+    std::cerr << "Error: --matchpack-block-size must be > 0\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+  if (match_backend != "cuda" && match_backend != "glsl" && match_backend != "cpu") {
+    std::cerr << "Error: --match-backend must be cuda, glsl, or cpu\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+  if (pair_order != "locality" && pair_order != "input") {
+    std::cerr << "Error: --pair-order must be locality or input\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+  if (feature_cache_mb < 0) {
+    std::cerr << "Error: --feature-cache-mb must be >= 0\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+  if (match_threads < 1) {
+    std::cerr << "Error: --match-threads must be >= 1\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+  const bool write_match_files = (output_format_str != "matchpack");
+  const bool write_matchpack = (output_format_str != "file");
+
   // Set logging level
   insight::tools::apply_log_level(cmd.used('v'), cmd.used('q'), log_level);
 
@@ -449,7 +476,9 @@ int main(int argc, char* argv[]) {
                                  : "unlimited (all features)");
   LOG(INFO) << "  Max matches: " << (max_matches > 0 ? std::to_string(max_matches) : "unlimited");
   LOG(INFO) << "  CPU threads: " << num_threads;
+  LOG(INFO) << "  Output format: " << output_format_str;
   bool use_cuda_match = (match_backend == "cuda");
+  const bool use_cpu_match = (match_backend == "cpu");
   use_pop_sift = cmd.used("use-pop-sift");
   use_sift_gpu = cmd.used("use-sift-gpu");
   if (use_pop_sift && use_sift_gpu) {
@@ -459,8 +488,13 @@ int main(int argc, char* argv[]) {
   if (!use_pop_sift && !use_sift_gpu) {
     use_pop_sift = true;
   }
-  LOG(INFO) << "  Match backend: " << (use_cuda_match ? "cuda" : "glsl");
-  LOG(INFO) << "  Matcher implementation: " << (use_pop_sift ? "popsift" : "sift_gpu");
+  const std::string matcher_impl =
+      use_cpu_match ? "cpu_bruteforce" : (use_pop_sift ? "popsift" : "sift_gpu");
+  LOG(INFO) << "  Match backend: " << match_backend;
+  LOG(INFO) << "  Matcher implementation: " << matcher_impl;
+  if (use_cpu_match) {
+    LOG(INFO) << "  CPU match threads: " << match_threads;
+  }
 
   // Validate feature directory if provided
   if (!feature_dir.empty() && !fs::is_directory(feature_dir)) {
@@ -481,6 +515,22 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
+  // Processing order: consecutive pairs share images so the feature cache can serve them
+  std::vector<int> pair_schedule(static_cast<size_t>(total_pairs));
+  std::iota(pair_schedule.begin(), pair_schedule.end(), 0);
+  if (pair_order == "locality") {
+    std::vector<std::pair<uint32_t, uint32_t>> pair_ids;
+    pair_ids.reserve(pair_tasks.size());
+    for (const auto& task : pair_tasks)
+      pair_ids.emplace_back(task.image1_index, task.image2_index);
+    PairScheduleStats schedule_stats;
+    pair_schedule = schedule_pairs_for_locality(pair_ids, &schedule_stats);
+    LOG(INFO) << "Pair schedule: " << schedule_stats.num_images << " images, bandwidth "
+              << schedule_stats.input_bandwidth << " -> " << schedule_stats.bandwidth;
+  }
+  FeatureCache<FeatureData> feature_cache(static_cast<size_t>(feature_cache_mb) << 20,
+                                          feature_data_bytes);
+
   // Create matching options
   MatchOptions match_options;
   match_options.ratio_test = ratio_test;
@@ -490,29 +540,48 @@ int main(int argc, char* argv[]) {
   match_options.spatial_grid_cols = grid_cols;
   match_options.mutual_best_match = true;
 
+  std::unique_ptr<MatchPackWriter> pack_writer;
+  if (write_matchpack) {
+    json algorithm;
+    algorithm["name"] = matcherAlgorithmName(matcher_impl);
+    algorithm["impl"] = matcher_impl;
+    algorithm["version"] = "1.2";
+    pack_writer = std::make_unique<MatchPackWriter>(output_dir, matchpack_block_size, algorithm);
+  } else {
+    // File output only: drop a pack left by an earlier run, readers would prefer it.
+    MatchPackIndex::remove_from_dir(output_dir);
+  }
+
   // Create pipeline stages
   const int IO_QUEUE_SIZE = 10;
   const int GPU_QUEUE_SIZE = 3;
 
   // Stage 1: Load features (multi-threaded I/O)
-  Stage loadStage("LoadFeatures", num_threads, IO_QUEUE_SIZE, [&pair_tasks](int index) {
+  auto load_cached = [&feature_cache](uint32_t image_index, const std::string& path) {
+    auto features = feature_cache.acquire(image_index, [&path] {
+      return std::make_shared<const FeatureData>(loadFeaturesIDC(path));
+    });
+    return features ? features : std::make_shared<const FeatureData>();
+  };
+  Stage loadStage("LoadFeatures", num_threads, IO_QUEUE_SIZE, [&pair_tasks, &load_cached](int index) {
     auto& task = pair_tasks[index];
 
     auto start = std::chrono::high_resolution_clock::now();
 
-    task.features1 = loadFeaturesIDC(task.feature1_file);
-    task.features2 = loadFeaturesIDC(task.feature2_file);
+    task.features1 = load_cached(task.image1_index, task.feature1_file);
+    task.features2 = load_cached(task.image2_index, task.feature2_file);
 
     auto end = std::chrono::high_resolution_clock::now();
     int load_time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
 
     LOG(INFO) << "Loaded pair [" << index << "/" << pair_tasks.size() << "]: " << task.image1_index
-              << " (" << task.features1.num_features << ") vs " << task.image2_index << " ("
-              << task.features2.num_features << ") "
+              << " (" << task.features1->num_features << ") vs " << task.image2_index << " ("
+              << task.features2->num_features << ") "
               << "in " << load_time << "ms";
   });
 
-  // Stage 2: GPU matching (single thread, GPU context requirement)
+  // Stage 2: GPU matching (single thread, GPU context requirement), or CPU matching where the
+  // stateless CPU backend matches match_threads pairs at once.
   // GPU buffer must cover the actual number of features uploaded.
   // When cap is -1 (all features), use a large safe upper bound (32768 ≈ typical SIFT max).
   int gpu_buf = max_features > 0 ? max_features : 32768;
@@ -521,53 +590,65 @@ int main(int argc, char* argv[]) {
   matcher_params.use_cuda = use_cuda_match;
   matcher_params.use_sift_gpu = use_sift_gpu;
   matcher_params.use_pop_sift = use_pop_sift;
+  matcher_params.use_cpu = use_cpu_match;
   SiftMatcher matcher(matcher_params);
 
   if (!matcher.verify_context()) {
     LOG(FATAL) << "Failed to initialize SiftMatchGPU - OpenGL context error";
   }
 
-  StageCurrent matchStage(
-      "GPUMatch", 1, GPU_QUEUE_SIZE, [&pair_tasks, &matcher, &match_options](int index) {
-        auto& task = pair_tasks[index];
-
-        if (task.features1.num_features == 0 || task.features2.num_features == 0) {
-          LOG(WARNING) << "Skipping pair [" << index << "] - empty features";
-          return;
-        }
-
-        auto start = std::chrono::high_resolution_clock::now();
+  auto match_task = [&pair_tasks, &matcher, &match_options](int index) {
+    auto& task = pair_tasks[index];
 
-        task.matches = matcher.match(task.features1, task.features2, match_options);
-        const size_t removed_non_unique = sanitize_matches_one_to_one(&task.matches);
+    if (task.features1->num_features == 0 || task.features2->num_features == 0) {
+      LOG(WARNING) << "Skipping pair [" << index << "] - empty features";
+      task.features1.reset();
+      task.features2.reset();
+      return;
+    }
 
-        auto end = std::chrono::high_resolution_clock::now();
-        int match_time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    auto start = std::chrono::high_resolution_clock::now();
 
-        LOG(INFO) << "Matched pair [" << index << "/" << pair_tasks.size()
-                  << "]: " << task.matches.num_matches << " matches in " << match_time << "ms"
-                  << (removed_non_unique > 0 ? " (removed " + std::to_string(removed_non_unique) +
-                                                   " non-unique matches)"
-                                             : "");
+    task.matches = matcher.match(*task.features1, *task.features2, match_options);
+    const size_t removed_non_unique = sanitize_matches_one_to_one(&task.matches);
 
-        // Free feature memory
-        task.features1.clear();
-        task.features2.clear();
-      });
+    auto end = std::chrono::high_resolution_clock::now();
+    int match_time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+
+    LOG(INFO) << "Matched pair [" << index << "/" << pair_tasks.size()
+              << "]: " << task.matches.num_matches << " matches in " << match_time << "ms"
+              << (removed_non_unique > 0 ? " (removed " + std::to_string(removed_non_unique) +
+                                               " non-unique matches)"
+                                         : "");
+  };
+  std::unique_ptr<StageCurrent> gpuMatchStage;
+  std::unique_ptr<Stage> cpuMatchStage;
+  if (use_cpu_match) {
+    cpuMatchStage =
+        std::make_unique<Stage>("CpuMatch", match_threads, 2 * match_threads, match_task);
+  } else {
+    gpuMatchStage = std::make_unique<StageCurrent>("GPUMatch", 1, GPU_QUEUE_SIZE, match_task);
+  }
 
   // Stage 3: Write results (multi-threaded I/O)
   Stage writeStage(
       "WriteResults", num_threads, IO_QUEUE_SIZE,
-      [&pair_tasks, &output_dir, &output_pairs_json, use_pop_sift](int index) {
+      [&pair_tasks, &output_dir, &pack_writer, &matcher_impl, write_match_files](int index) {
         auto& task = pair_tasks[index];
 
         if (task.matches.num_matches == 0) {
+          task.features1.reset();
+          task.features2.reset();
           return;
         }
 
         auto start = std::chrono::high_resolution_clock::now();
 
-        writeMatchIDC(task.matches, task, output_dir, use_pop_sift ? "popsift" : "sift_gpu");
+        writeMatchIDC(task.matches, task, output_dir, matcher_impl, write_match_files,
+                      pack_writer.get());
+        // Unpin features (scales were read from keypoints); the cache decides when to free
+        task.features1.reset();
+        task.features2.reset();
 
         auto end = std::chrono::high_resolution_clock::now();
         int write_time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
@@ -580,12 +661,18 @@ int main(int argc, char* argv[]) {
       });
 
   // Chain stages
-  chain(loadStage, matchStage);
-  chain(matchStage, writeStage);
+  if (use_cpu_match) {
+    chain(loadStage, *cpuMatchStage);
+    chain(*cpuMatchStage, writeStage);
+    cpuMatchStage->setTaskCount(total_pairs);
+  } else {
+    chain(loadStage, *gpuMatchStage);
+    chain(*gpuMatchStage, writeStage);
+    gpuMatchStage->setTaskCount(total_pairs);
+  }
 
   // Set task counts
   loadStage.setTaskCount(total_pairs);
-  matchStage.setTaskCount(total_pairs);
   writeStage.setTaskCount(total_pairs);
 
   // Process all pairs
@@ -593,19 +680,35 @@ int main(int argc, char* argv[]) {
 
   // Push tasks in background thread, process GPU in main thread
   std::thread push_thread([&]() {
-    for (int i = 0; i < total_pairs; ++i) {
+    for (int i : pair_schedule) {
       loadStage.push(i);
     }
   });
 
-  // Run GPU stage in main thread (OpenGL context requirement)
-  matchStage.run();
+  if (use_cpu_match) {
+    push_thread.join();
+    loadStage.wait();
+    cpuMatchStage->wait();
+  } else {
+    // Run GPU stage in main thread (OpenGL context requirement)
+    gpuMatchStage->run();
+    push_thread.join();
+    loadStage.wait();
+  }
 
   // Wait for all stages to complete
-  push_thread.join();
-  loadStage.wait();
   writeStage.wait();
 
+  std::string matchpack_index_path;
+  if (pack_writer) {
+    matchpack_index_path = pack_writer->finish();
+    if (matchpack_index_path.empty()) {
+      LOG(ERROR) << "Failed to finalize match pack in " << output_dir;
+      printEvent({{"type", "match.complete"}, {"ok", false}, {"error", "matchpack write failed"}});
+      return 1;
+    }
+  }
+
   auto pipeline_end = std::chrono::high_resolution_clock::now();
   int total_time =
       std::chrono::duration_cast<std::chrono::seconds>(pipeline_end - pipeline_start).count();
@@ -640,6 +743,10 @@ int main(int argc, char* argv[]) {
     }
   }
 
+  const FeatureCacheStats cache_stats = feature_cache.stats();
+  LOG(INFO) << "Feature cache: " << cache_stats.misses << " loads, " << cache_stats.hits
+            << " hits, peak " << (cache_stats.peak_bytes >> 20) << " MB";
+
   // Machine-readable result (CLI_IO_CONVENTIONS: stdout = ISAT_EVENT only)
   printEvent({{"type", "match.complete"},
               {"ok", true},
@@ -651,7 +758,12 @@ int main(int argc, char* argv[]) {
                 {"total_time_s", total_time},
                 {"avg_matches_per_pair", std::round(avg_matches * 100) / 100.0},
                 {"avg_time_per_pair_s", std::round(avg_time_per_pair * 100) / 100.0},
+                {"pair_order", pair_order},
+                {"feature_loads", cache_stats.misses},
+                {"feature_cache_hits", cache_stats.hits},
                 {"output_dir", output_dir},
+                {"output_format", output_format_str},
+                {"matchpack_index", matchpack_index_path},
                 {"output_pairs_json", output_pairs_json}}}});
 
   LOG(INFO) << "=== Matching Complete ===";
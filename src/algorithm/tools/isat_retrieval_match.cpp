@@ -36,8 +36,10 @@
 #include <glog/logging.h>
 #include <nlohmann/json.hpp>
 
+#include "../io/pair_list.h"
 #include "cli_logging.h"
 #include "cmdLine/cmdLine.h"
+#include "pair_json_utils.h"
 
 namespace fs = std::filesystem;
 using json = nlohmann::json;
@@ -111,18 +113,17 @@ static int count_images(const std::string& image_list_path) {
   return 0;
 }
 
-/// Generate exhaustive pairs JSON: all (i,j) where i < j
+/// Generate exhaustive pairs as a binary .isat_pairs list: all (i,j) where i < j
 static void write_exhaustive_pairs(const std::string& output_path, int n_images) {
-  json pairs_arr = json::array();
+  insight::io::PairListWriter writer;
+  writer.reserve(static_cast<size_t>(n_images) * static_cast<size_t>(std::max(n_images - 1, 0)) / 2);
   for (int i = 0; i < n_images; ++i) {
     for (int j = i + 1; j < n_images; ++j) {
-      pairs_arr.push_back({{"image1_index", i}, {"image2_index", j}});
+      writer.add(static_cast<uint32_t>(i), static_cast<uint32_t>(j), 1.0f,
+                 insight::io::kPairMethodExhaustive);
     }
   }
-  json out = {{"pairs", pairs_arr}};
-  std::ofstream f(output_path);
-  f << out.dump(2) << "\n";
-  LOG(INFO) << "Wrote " << pairs_arr.size() << " exhaustive pairs to " << output_path;
+  writer.write(output_path);
 }
 
 /// Read geo output pairs.json → set of (min,max) index pairs + per-image neighbour count
@@ -155,17 +156,15 @@ static void read_geo_pairs(const std::string& pairs_path,
   LOG(INFO) << "Read " << verified_pairs.size() << " verified pairs from " << pairs_path;
 }
 
-/// Write final merged pairs JSON
+/// Write final merged pair list (.isat_pairs → binary, otherwise pairs JSON)
 static void write_final_pairs(const std::string& output_path,
                               const std::set<std::pair<int,int>>& pairs) {
-  json pairs_arr = json::array();
-  for (const auto& [i, j] : pairs) {
-    pairs_arr.push_back({{"image1_index", i}, {"image2_index", j}});
-  }
-  json out = {{"pairs", pairs_arr}};
-  std::ofstream f(output_path);
-  f << out.dump(2) << "\n";
-  LOG(INFO) << "Wrote " << pairs_arr.size() << " final pairs to " << output_path;
+  std::vector<std::pair<uint32_t, uint32_t>> out;
+  out.reserve(pairs.size());
+  for (const auto& [i, j] : pairs)
+    out.emplace_back(static_cast<uint32_t>(i), static_cast<uint32_t>(j));
+  if (!insight::tools::write_pair_list(output_path, out))
+    LOG(ERROR) << "Failed to write final pairs: " << output_path;
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -200,7 +199,7 @@ int main(int argc, char* argv[]) {
   cmd.add(make_option('l', image_list, "image-list").doc("Image list JSON (images_all.json)"));
   cmd.add(make_option('f', feat_dir, "feat-dir").doc("Feature directory (.isat_feat files)"));
   cmd.add(make_option('w', work_dir, "work-dir").doc("Working directory for intermediate match/geo results"));
-  cmd.add(make_option('o', output_path, "output").doc("Output pairs JSON path"));
+  cmd.add(make_option('o', output_path, "output").doc("Output pair list path (.isat_pairs = binary, otherwise JSON)"));
   cmd.add(make_option(0, match_impl, "match-impl")
               .doc("Matcher: gpu | cascade | cascade-gpu (default: cascade-gpu; "
                    "gpu=isat_match, cascade=CPU hash, cascade-gpu=GPU hash)"));
@@ -269,8 +268,9 @@ int main(int argc, char* argv[]) {
   fs::path wp = fs::absolute(work_dir);
   fs::path match_dir = wp / "match";
   fs::path geo_dir   = wp / "geo";
-  fs::path exhaustive_pairs = wp / "exhaustive_pairs.json";
-  fs::path matched_pairs = wp / "matched_pairs.json";
+  // Intermediate lists are binary: exhaustive pairs grow as n² and would dominate as JSON.
+  fs::path exhaustive_pairs = wp / "exhaustive_pairs.isat_pairs";
+  fs::path matched_pairs = wp / "matched_pairs.isat_pairs";
   fs::create_directories(match_dir);
   fs::create_directories(geo_dir);
 
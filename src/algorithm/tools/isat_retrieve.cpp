@@ -4,14 +4,20 @@
  *
  * Reads .isat_feat (or VLAD aggregated descriptors), runs retrieval
  * (VLAD, exhaustive, sequential, or GPS-based) to score
- * image pairs, and writes a pairs JSON for downstream isat_match / isat_geo.
+ * image pairs, and writes a pair list for downstream isat_match / isat_geo.
  *
- * Strategies: exhaustive, sequential, gps, vlad (with optional PCA).
- * Output: JSON with "pairs" array of {image1_id, image2_id, score, ...}.
+ * Strategies: exhaustive, sequential, gps, vlad (with optional PCA), vlad-ann (HNSW index over
+ *             the same VLAD/PCA vectors; persistent with --ann-index, incremental across runs).
+ * Output: -o *.isat_pairs → binary pair list (io/pair_list.h, fixed 16-byte records);
+ *         otherwise JSON with "pairs" array of {image1_id, image2_id, score, ...}.
+ *         --export-json additionally writes the JSON form next to a binary list.
  *
  * Usage:
+ *   isat_retrieve -i image_list.json -f feat_dir/ -o pairs.isat_pairs --strategy exhaustive
  *   isat_retrieve -i image_list.json -f feat_dir/ -o pairs.json --strategy exhaustive
  *   isat_retrieve -i image_list.json -f feat_dir/ -o pairs.json --strategy vlad -c codebook.bin
+ *   isat_retrieve -i image_list.json -f feat_dir/ -o pairs.isat_pairs --strategy vlad-ann \
+ *       --vlad-codebook codebook.vcbt --pca-model vlad.pca --ann-index vlad.isat_ann [--ann-benchmark]
  */
 
 #include <algorithm>
@@ -25,6 +31,7 @@
 #include <string>
 #include <vector>
 
+#include "../io/pair_list.h"
 #include "../modules/retrieval/pca_whitening.h"
 #include "../modules/retrieval/retrieval_types.h"
 #include "../modules/retrieval/spatial_retrieval.h"
@@ -401,6 +408,31 @@ bool writePairsJSON(const std::vector<ImageInfo>& images, const std::vector<Imag
   return true;
 }
 
+/**
+ * Write pairs as a binary .isat_pairs list. Feature paths are stored once per image in the
+ * list metadata instead of once per pair.
+ */
+bool writePairList(const std::vector<ImageInfo>& images, const std::vector<ImagePair>& pairs,
+                   const std::string& output_path, const std::string& retrieval_method) {
+  insight::io::PairListWriter writer;
+  writer.reserve(pairs.size());
+  for (const auto& p : pairs) {
+    if (!p.is_valid() || p.image1_idx >= static_cast<int>(images.size()) ||
+        p.image2_idx >= static_cast<int>(images.size())) {
+      continue;
+    }
+    writer.add(static_cast<uint32_t>(p.image1_idx), static_cast<uint32_t>(p.image2_idx),
+               static_cast<float>(p.score), insight::io::pair_method_flags_from_string(p.method));
+  }
+  std::vector<std::string> feature_files;
+  feature_files.reserve(images.size());
+  for (const auto& img : images)
+    feature_files.push_back(img.feature_file);
+  writer.set_feature_files(std::move(feature_files));
+  writer.set_extra_metadata({{"retrieval_method", retrieval_method}});
+  return writer.write(output_path);
+}
+
 int main(int argc, char* argv[]) {
   // Initialize glog
   google::InitGoogleLogging(argv[0]);
@@ -412,6 +444,7 @@ int main(int argc, char* argv[]) {
 
   std::string feature_dir;
   std::string output_file;
+  std::string export_json;
   std::string image_list;
   std::string strategy = "exhaustive";
   int max_pairs = -1;
@@ -430,17 +463,23 @@ int main(int argc, char* argv[]) {
   float target_scale = 4.0f;
   float scale_sigma = 2.0f;
 
+  // VLAD ANN (HNSW) options
+  VladAnnOptions ann_options;
+
   // Required arguments
   cmd.add(make_option('f', feature_dir, "features")
               .doc("Feature directory containing .isat_feat files"));
-  cmd.add(make_option('o', output_file, "output").doc("Output pairs file (JSON format)"));
+  cmd.add(make_option('o', output_file, "output")
+              .doc("Output pair list: *.isat_pairs = binary, anything else = JSON"));
+  cmd.add(make_option(0, export_json, "export-json")
+              .doc("Also export the pairs as JSON to this path (with a binary -o)"));
 
   // Optional arguments
   cmd.add(make_option('i', image_list, "input")
               .doc("Input image list (JSON format with optional GNSS/IMU)"));
   cmd.add(make_option('s', strategy, "strategy")
-              .doc("Strategy: exhaustive|sequential|gps|vlad|gps+sequential|gps+vlad (default: "
-                   "exhaustive)"));
+              .doc("Strategy: exhaustive|sequential|gps|vlad|vlad-ann|gps+sequential|gps+vlad "
+                   "(default: exhaustive)"));
   cmd.add(make_option('m', max_pairs, "max-pairs")
               .doc("Maximum number of pairs, -1=unlimited (default: -1)"));
   cmd.add(make_option('w', window_size, "window")
@@ -458,7 +497,7 @@ int main(int argc, char* argv[]) {
   cmd.add(make_option(0, vlad_codebook, "vlad-codebook")
               .doc("VLAD codebook file (.vcbt format) for visual retrieval"));
   cmd.add(make_option(0, vlad_cache_dir, "vlad-cache")
-              .doc("Directory for VLAD vector cache (.isat_vlad files)"));
+              .doc("Directory for the VLAD vector store (vlad_store.isat_vlads)"));
   cmd.add(make_option(0, vlad_top_k, "vlad-top-k")
               .doc("Top-k most similar images per query for VLAD (default: 50)"));
   cmd.add(make_option(0, pca_model_file, "pca-model")
@@ -469,6 +508,19 @@ int main(int argc, char* argv[]) {
               .doc("Gaussian sigma for VLAD scale weighting (default: 2.0)"));
   cmd.add(make_switch(0, "vlad-scale-weighted").doc("Enable scale-weighted VLAD encoding"));
 
+  // VLAD ANN options
+  cmd.add(make_option(0, ann_options.index_file, "ann-index")
+              .doc("vlad-ann: persistent HNSW index (.isat_ann); loaded if present, new images are "
+                   "inserted, re-extracted images replaced and the file is rewritten"));
+  cmd.add(make_option(0, ann_options.hnsw.M, "ann-m")
+              .doc("vlad-ann: HNSW links per node (default: 16)"));
+  cmd.add(make_option(0, ann_options.hnsw.ef_construction, "ann-ef-construction")
+              .doc("vlad-ann: HNSW build candidate list size (default: 200)"));
+  cmd.add(make_option(0, ann_options.hnsw.ef_search, "ann-ef-search")
+              .doc("vlad-ann: HNSW query candidate list size (default: 128)"));
+  cmd.add(make_switch(0, "ann-benchmark")
+              .doc("vlad-ann: also run exact top-k on the same vectors and report recall@k"));
+
   // Logging options
   std::string log_level;
   cmd.add(make_option(0, log_level, "log-level").doc("Log level: error|warn|info|debug"));
@@ -580,6 +632,8 @@ int main(int argc, char* argv[]) {
 
   // Create dynamic strategy registry (extends static STRATEGIES with VLAD)
   auto strategies = STRATEGIES; // Copy static registry
+  VladAnnStats ann_stats;
+  bool ann_used = false;
   if (vlad_enabled) {
     // Only pass cache_dir if it's not empty (avoid cache write errors)
     if (!vlad_cache_dir.empty()) {
@@ -599,6 +653,16 @@ int main(int argc, char* argv[]) {
       return retrieve_by_vlad(imgs, opts, vlad_centroids, cache_path, pca_ptr, use_scale_weighting,
                             target_scale, scale_sigma);
     };
+
+    ann_options.benchmark = cmd.used("ann-benchmark");
+    strategies["vlad-ann"] = [&vlad_centroids, &ann_options, &ann_stats, &ann_used, cache_path,
+                              pca_ptr, use_scale_weighting, target_scale,
+                              scale_sigma](const std::vector<ImageInfo>& imgs,
+                                           const RetrievalOptions& opts) -> std::vector<ImagePair> {
+      ann_used = true;
+      return retrieve_by_vlad_ann(imgs, opts, vlad_centroids, ann_options, cache_path, pca_ptr,
+                                  use_scale_weighting, target_scale, scale_sigma, &ann_stats);
+    };
   }
 
   // Execute retrieval strategy
@@ -612,7 +676,7 @@ int main(int argc, char* argv[]) {
     auto it = strategies.find(strategy_names[0]);
     if (it == strategies.end()) {
       LOG(ERROR) << "Unknown strategy: " << strategy_names[0];
-      LOG(ERROR) << "Available strategies: exhaustive, sequential, gps, vlad";
+      LOG(ERROR) << "Available strategies: exhaustive, sequential, gps, vlad, vlad-ann";
       return 1;
     }
     pairs = it->second(images, options);
@@ -645,6 +709,22 @@ int main(int argc, char* argv[]) {
 
   LOG(INFO) << "Generated " << pairs.size() << " pairs in " << gen_time << "ms";
 
+  if (ann_used) {
+    json ann_data = {{"index_file", ann_options.index_file},
+                     {"loaded_from_file", ann_stats.loaded_from_file},
+                     {"indexed_before", ann_stats.indexed_before},
+                     {"inserted", ann_stats.inserted},
+                     {"updated", ann_stats.updated},
+                     {"build_ms", ann_stats.build_ms},
+                     {"query_ms", ann_stats.query_ms}};
+    if (ann_options.benchmark) {
+      ann_data["exact_ms"] = ann_stats.exact_ms;
+      ann_data["recall_at_k"] = ann_stats.recall;
+      ann_data["top_k"] = options.top_k;
+    }
+    printEvent({{"type", "retrieve.ann"}, {"data", ann_data}});
+  }
+
   // Post-processing: filter by score and limit count
   pairs = filter_pairs(pairs, [](const ImagePair& p) { return p.score > 0.01; });
   pairs = sort_by_score(pairs);
@@ -659,9 +739,12 @@ int main(int argc, char* argv[]) {
   LOG(INFO) << "Coverage: " << pairs.size() << "/" << total_possible << " (" << coverage << "%)";
 
   // Write output
-  if (!writePairsJSON(images, pairs, output_file, strategy)) {
+  const bool binary_output = fs::path(output_file).extension() == ".isat_pairs";
+  const bool write_ok = binary_output ? writePairList(images, pairs, output_file, strategy)
+                                      : writePairsJSON(images, pairs, output_file, strategy);
+  if (!write_ok || (!export_json.empty() && !writePairsJSON(images, pairs, export_json, strategy))) {
     printEvent(
-        {{"type", "retrieve.complete"}, {"ok", false}, {"error", "failed to write pairs JSON"}});
+        {{"type", "retrieve.complete"}, {"ok", false}, {"error", "failed to write pair list"}});
     return 1;
   }
 
@@ -671,6 +754,8 @@ int main(int argc, char* argv[]) {
                {{"num_images", static_cast<int>(images.size())},
                 {"num_pairs", static_cast<int>(pairs.size())},
                 {"output_file", output_file},
+                {"output_format", binary_output ? "isat_pairs" : "json"},
+                {"export_json", export_json},
                 {"time_ms", gen_time}}}});
 
   LOG(INFO) << "=== Retrieval Complete ===";
@@ -11,6 +11,8 @@
  *   4. tracks            – build tracks from matches + geometry
  *   5. seed_eval         – 四策略 seed 评估（balanced/wide_baseline/support_first/conservative）
  *   6. incremental_sfm   – incremental SfM (resection + BA)
+ *   6'. partitioned_sfm  – [可选，替代 incremental_sfm] 视图图分块 → 各块并行 incremental SfM →
+ *                          Sim3 合并 + 全局 BA（isat_sfm_partition + isat_incremental_sfm --merge-models）
  *   7. undistort         – [可选] 去畸变图像导出 + COLMAP sparse (--undistort 开启)
  *
  * Usage:
@@ -25,11 +27,14 @@
  *   isat_sfm -i /photos -w work/ --output-interval-sfm           # 在 <work>/sfm_interval/ 写每步 Bundler 快照，at_bundler_viewer 查看
  *   isat_sfm -i /photos -w work/ --undistort                     # SfM 后导出去畸变图像 + COLMAP (txt)
  *   isat_sfm -i /photos -w work/ --undistort --binary            # 同上，COLMAP 二进制格式
+ *   isat_sfm -w work/ --existing-task --steps partitioned_sfm --partition-max-images 300
+ *                                                               # 大场景分块并行重建后合并
  *
  * The binary locates sibling tools relative to its own path (same directory).
  */
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <cstdio>
@@ -47,8 +52,10 @@
 #include <glog/logging.h>
 #include <nlohmann/json.hpp>
 
+#include "../io/pair_list.h"
 #include "cli_logging.h"
 #include "cmdLine/cmdLine.h"
+#include "pair_json_utils.h"
 #include "seed_eval_common.h"
 
 namespace fs = std::filesystem;
@@ -280,8 +287,10 @@ static std::vector<json> run_capture_or_die(const std::string& step,
 // Steps parsing
 // ─────────────────────────────────────────────────────────────────────────────
 
-static const std::vector<std::string> ALL_STEPS = {"create", "extract", "match", "tracks",
-                                                   "seed_eval", "incremental_sfm", "undistort"};
+static const std::vector<std::string> ALL_STEPS = {"create",          "extract",
+                                                   "match",           "tracks",
+                                                   "seed_eval",       "incremental_sfm",
+                                                   "partitioned_sfm", "undistort"};
 
 static std::set<std::string> parse_steps(const std::string& steps_str) {
   std::set<std::string> result;
@@ -295,7 +304,8 @@ static std::set<std::string> parse_steps(const std::string& steps_str) {
       continue;
     if (std::find(ALL_STEPS.begin(), ALL_STEPS.end(), token) == ALL_STEPS.end()) {
       LOG(ERROR) << "Unknown step: '" << token << "'";
-      LOG(ERROR) << "Valid steps: create, extract, match, tracks, seed_eval, incremental_sfm, undistort";
+      LOG(ERROR) << "Valid steps: create, extract, match, tracks, seed_eval, incremental_sfm, "
+                    "partitioned_sfm, undistort";
       std::exit(2);
     }
     result.insert(token);
@@ -319,28 +329,27 @@ static int count_images_in_images_all_json(const fs::path& images_all_path) {
   return 0;
 }
 
-/// 写入全穷举图像对 JSON（image1_index < image2_index），供 isat_match / isat_geo 使用。
-static bool write_exhaustive_pairs_json(const fs::path& output_path, int n_images,
+/// 写入全穷举图像对（image1_index < image2_index，二进制 .isat_pairs），供 isat_match / isat_geo 使用。
+static bool write_exhaustive_pairs(const fs::path& output_path, int n_images,
                                         std::string* err_out) {
   if (n_images < 2) {
     if (err_out)
       *err_out = "need at least 2 images for exhaustive pairs";
     return false;
   }
-  json pairs_arr = json::array();
+  insight::io::PairListWriter writer;
+  writer.reserve(static_cast<size_t>(n_images) * static_cast<size_t>(n_images - 1) / 2);
   for (int i = 0; i < n_images; ++i) {
     for (int j = i + 1; j < n_images; ++j)
-      pairs_arr.push_back({{"image1_index", i}, {"image2_index", j}});
+      writer.add(static_cast<uint32_t>(i), static_cast<uint32_t>(j), 1.0f,
+                 insight::io::kPairMethodExhaustive);
   }
-  json out = {{"pairs", pairs_arr}};
-  std::ofstream f(output_path);
-  if (!f) {
+  if (!writer.write(output_path.string())) {
     if (err_out)
       *err_out = "cannot write " + output_path.string();
     return false;
   }
-  f << out.dump(2) << "\n";
-  LOG(INFO) << "Exhaustive pairs: " << pairs_arr.size() << " → " << output_path.string();
+  LOG(INFO) << "Exhaustive pairs: " << writer.size() << " → " << output_path.string();
   return true;
 }
 
@@ -369,7 +378,7 @@ static std::vector<int> read_low_peak_matching_indices(const fs::path& meta_path
   return out;
 }
 
-/// 将检索得到的 pairs 与「所有涉及 boost 图像的穷举对」取并集，写回 pairs_path（同一 JSON 格式）。
+/// 将检索得到的 pairs 与「所有涉及 boost 图像的穷举对」取并集，写回 pairs_path（.isat_pairs 或 JSON，按扩展名）。
 static bool merge_retrieval_pairs_with_low_peak_boost(const fs::path& pairs_path, int n_images,
                                                       const std::vector<int>& boost_indices,
                                                       std::string* err_out) {
@@ -379,31 +388,19 @@ static bool merge_retrieval_pairs_with_low_peak_boost(const fs::path& pairs_path
     return false;
   }
   std::set<std::pair<int, int>> seen;
-  std::ifstream pf(pairs_path);
-  if (!pf) {
+  const bool read_ok = insight::tools::for_each_pair_in_list(
+      pairs_path.string(), [&seen](const insight::tools::PairListEntry& p) {
+        int a = static_cast<int>(p.image1_index);
+        int b = static_cast<int>(p.image2_index);
+        if (a > b)
+          std::swap(a, b);
+        seen.insert({a, b});
+      });
+  if (!read_ok) {
     if (err_out)
       *err_out = "cannot read " + pairs_path.string();
     return false;
   }
-  json jp;
-  try {
-    pf >> jp;
-  } catch (...) {
-    if (err_out)
-      *err_out = "invalid JSON " + pairs_path.string();
-    return false;
-  }
-  if (jp.contains("pairs") && jp["pairs"].is_array()) {
-    for (const auto& p : jp["pairs"]) {
-      int a = p.value("image1_index", -1);
-      int b = p.value("image2_index", -1);
-      if (a < 0 || b < 0)
-        continue;
-      if (a > b)
-        std::swap(a, b);
-      seen.insert({a, b});
-    }
-  }
   const size_t from_retrieval = seen.size();
   for (int bi : boost_indices) {
     if (bi < 0 || bi >= n_images)
@@ -417,19 +414,17 @@ static bool merge_retrieval_pairs_with_low_peak_boost(const fs::path& pairs_path
       seen.insert({a, b});
     }
   }
-  json pairs_arr = json::array();
+  std::vector<std::pair<uint32_t, uint32_t>> merged;
+  merged.reserve(seen.size());
   for (const auto& pr : seen)
-    pairs_arr.push_back({{"image1_index", pr.first}, {"image2_index", pr.second}});
-  json out = {{"pairs", pairs_arr}};
-  std::ofstream of(pairs_path);
-  if (!of) {
+    merged.emplace_back(static_cast<uint32_t>(pr.first), static_cast<uint32_t>(pr.second));
+  if (!insight::tools::write_pair_list(pairs_path.string(), merged)) {
     if (err_out)
       *err_out = "cannot write " + pairs_path.string();
     return false;
   }
-  of << out.dump(2) << "\n";
   LOG(INFO) << "Adaptive pairs: retrieval " << from_retrieval << " unique → merged "
-            << pairs_arr.size() << " (added exhaustive links for " << boost_indices.size()
+            << merged.size() << " (added exhaustive links for " << boost_indices.size()
             << " low-peak image(s)) → " << pairs_path.string();
   return true;
 }
@@ -570,6 +565,10 @@ int main(int argc, char* argv[]) {
   int ba_threads = 0;
   /// isat_seed_eval short-window evaluation cap.
   int seed_eval_max_images = 6;
+  /// partitioned_sfm: cluster core size cap / overlap fraction / concurrent cluster runs (0 = auto).
+  int partition_max_images = 500;
+  double partition_overlap = 0.15;
+  int partition_jobs = 0;
 
   CmdLine cmd("InsightAT SfM Pipeline – end-to-end incremental SfM");
   cmd.add(make_option('i', input_dir, "input").doc("Input directory containing images (required unless --existing-task)"));
@@ -589,7 +588,7 @@ int main(int argc, char* argv[]) {
   cmd.add(make_switch(0, "use-sift-gpu")
               .doc("Feature extraction implementation: force SiftGPU instead of PopSift"));
   cmd.add(make_option(0, match_backend, "match-backend")
-              .doc("Matching backend: cuda or glsl (default: cuda)"));
+              .doc("Matching backend: cuda, glsl or cpu (default: cuda)"));
   cmd.add(make_option(0, match_impl, "match-impl")
               .doc("Matching implementation: gpu or cascade or cascade-gpu (default: cascade-gpu). "
                    "cascade invokes isat_cpu_cascade_hashing_match; "
@@ -654,6 +653,14 @@ int main(int argc, char* argv[]) {
                    "isat_incremental_sfm hardware default). Set >0 to cap or fix parallelism."));
   cmd.add(make_option(0, seed_eval_max_images, "seed-eval-max-images")
               .doc("Short-window max registered images for seed evaluation step (default: 6)."));
+  cmd.add(make_option(0, partition_max_images, "partition-max-images")
+              .doc("partitioned_sfm: maximum core images per cluster (default: 500)."));
+  cmd.add(make_option(0, partition_overlap, "partition-overlap")
+              .doc("partitioned_sfm: overlap images per cluster as a fraction of its core "
+                   "(default: 0.15)."));
+  cmd.add(make_option(0, partition_jobs, "partition-jobs")
+              .doc("partitioned_sfm: clusters reconstructed concurrently (default: 0 = auto, "
+                   "hardware threads / 4). --ba-threads is split across the jobs."));
   cmd.add(make_switch(0, "output-interval-sfm")
               .doc("During incremental SfM, write per-iteration Bundler bundle.out + list.txt under "
                    "<work-dir>/sfm_interval/iter_NNNN/ (interval fixed at 1; view with "
@@ -729,6 +736,12 @@ int main(int argc, char* argv[]) {
     cmd.printHelp(std::cerr, argv[0]);
     return 1;
   }
+  if (partition_max_images < 2 || partition_overlap < 0.0 || partition_jobs < 0) {
+    std::cerr << "Error: --partition-max-images must be >= 2, --partition-overlap and "
+                 "--partition-jobs >= 0\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
   if (seed_eval_max_images < 2) {
     std::cerr << "Error: --seed-eval-max-images must be >= 2\n\n";
     cmd.printHelp(std::cerr, argv[0]);
@@ -865,6 +878,11 @@ int main(int argc, char* argv[]) {
         active_list += (active_list.empty() ? "" : ", ") + s;
     LOG(INFO) << "Active steps: " << active_list;
   }
+  if (active_steps.count("incremental_sfm") && active_steps.count("partitioned_sfm")) {
+    LOG(ERROR) << "Steps incremental_sfm and partitioned_sfm are mutually exclusive "
+                  "(both write <work-dir>/incremental_sfm).";
+    return 2;
+  }
   if (cmd.used("output-interval-sfm") && !active_steps.count("incremental_sfm")) {
     LOG(WARNING) << "--output-interval-sfm is ignored: incremental_sfm is not in --steps.";
   }
@@ -909,8 +927,9 @@ int main(int argc, char* argv[]) {
   fs::path images_all = work_path / "images_all.json";
   fs::path feat_dir = work_path / "feat";
   fs::path feat_ret_dir = work_path / "feat_retrieval";
-  fs::path pairs_retrieve = work_path / "pairs_retrieve.json";
-  fs::path pairs_matched = work_path / "pairs_matched.json";
+  // Candidate / matched pair lists are binary (.isat_pairs); geo/pairs.json stays JSON.
+  fs::path pairs_retrieve = work_path / "pairs_retrieve.isat_pairs";
+  fs::path pairs_matched = work_path / "pairs_matched.isat_pairs";
   fs::path match_dir_path = work_path / "match";
   fs::path geo_dir = work_path / "geo";
   fs::path pairs_json = geo_dir / "pairs.json";
@@ -1133,7 +1152,7 @@ int main(int argc, char* argv[]) {
                         "memory-heavy.";
       }
       std::string werr;
-      if (!write_exhaustive_pairs_json(pairs_retrieve, n_img, &werr)) {
+      if (!write_exhaustive_pairs(pairs_retrieve, n_img, &werr)) {
         LOG(ERROR) << werr;
         return 1;
       }
@@ -1295,6 +1314,8 @@ int main(int argc, char* argv[]) {
     ++step_num;
     LOG(INFO) << "=== Step " << step_num << "/" << total_steps << ": Track building ===";
 
+    // --min-track-length 2: a later isat_tracks --update on this file cannot bring back the
+    // observations this filter removes.
     run_or_die("tracks",
                {tool_path("isat_tracks"), "-i", pairs_json.string(), "-m", match_dir_path.string(),
                 "-g", geo_dir.string(), "-l", images_all.string(), "-o", tracks_path.string(),
@@ -1328,6 +1349,43 @@ int main(int argc, char* argv[]) {
     run_or_die("seed-eval", seed_eval_cmd);
   }
 
+  // Seed-eval winner (initial-pair / resection gates) shared by incremental_sfm and every
+  // partitioned_sfm cluster run.
+  insight::tools::SeedStrategyProfile seed_profile;
+  bool use_seed_profile = false;
+  auto append_seed_profile_flags = [&](std::vector<std::string>* sfm_cmd) {
+    if (use_seed_profile) {
+      sfm_cmd->push_back("--init-min-inliers");
+      sfm_cmd->push_back(std::to_string(seed_profile.init_min_inliers));
+      sfm_cmd->push_back("--init-max-forward-motion");
+      sfm_cmd->push_back(std::to_string(seed_profile.init_max_forward_motion));
+      sfm_cmd->push_back("--init-min-angle-deg");
+      sfm_cmd->push_back(std::to_string(seed_profile.init_min_angle_deg));
+      sfm_cmd->push_back("--init-min-median-angle-deg");
+      sfm_cmd->push_back(std::to_string(seed_profile.init_min_median_angle_deg));
+      sfm_cmd->push_back("--resection-min-inliers");
+      sfm_cmd->push_back(std::to_string(seed_profile.resection_min_inliers));
+    }
+    if (fix_intrinsics)
+      sfm_cmd->push_back("--fix-intrinsics");
+  };
+  if ((active_steps.count("incremental_sfm") || active_steps.count("partitioned_sfm")) &&
+      active_steps.count("seed_eval")) {
+    std::string seed_error;
+    if (load_seed_eval_best_profile(seed_eval_out / "best_seed.json", &seed_profile,
+                                    &seed_error)) {
+      use_seed_profile = true;
+      LOG(INFO) << "Using seed-eval winner for incremental SfM: " << seed_profile.name
+                << " (min_inliers=" << seed_profile.init_min_inliers
+                << ", max_forward_motion=" << seed_profile.init_max_forward_motion
+                << ", min_angle_deg=" << seed_profile.init_min_angle_deg
+                << ", min_median_angle_deg=" << seed_profile.init_min_median_angle_deg << ")";
+    } else {
+      LOG(WARNING) << "Seed-eval best profile unavailable; falling back to incremental SfM "
+                   << "defaults (" << seed_error << ")";
+    }
+  }
+
   // ════════════════════════════════════════════════════════════════════════
   // Step: INCREMENTAL_SFM
   // ════════════════════════════════════════════════════════════════════════
@@ -1336,24 +1394,6 @@ int main(int argc, char* argv[]) {
     LOG(INFO) << "=== Step " << step_num << "/" << total_steps << ": Incremental SfM ===";
     fs::create_directories(sfm_out);
 
-    insight::tools::SeedStrategyProfile seed_profile;
-    bool use_seed_profile = false;
-    if (active_steps.count("seed_eval")) {
-      std::string seed_error;
-      if (load_seed_eval_best_profile(seed_eval_out / "best_seed.json", &seed_profile,
-                                      &seed_error)) {
-        use_seed_profile = true;
-        LOG(INFO) << "Using seed-eval winner for incremental SfM: " << seed_profile.name
-                  << " (min_inliers=" << seed_profile.init_min_inliers
-                  << ", max_forward_motion=" << seed_profile.init_max_forward_motion
-                  << ", min_angle_deg=" << seed_profile.init_min_angle_deg
-                  << ", min_median_angle_deg=" << seed_profile.init_min_median_angle_deg << ")";
-      } else {
-        LOG(WARNING) << "Seed-eval best profile unavailable; falling back to incremental SfM "
-                     << "defaults (" << seed_error << ")";
-      }
-    }
-
     std::vector<std::string> sfm_cmd = {tool_path("isat_incremental_sfm"),
                                         "-t",
                                         tracks_path.string(),
@@ -1365,20 +1405,7 @@ int main(int argc, char* argv[]) {
                                         geo_dir.string(),
                                         "-o",
                                         sfm_out.string()};
-    if (use_seed_profile) {
-      sfm_cmd.push_back("--init-min-inliers");
-      sfm_cmd.push_back(std::to_string(seed_profile.init_min_inliers));
-      sfm_cmd.push_back("--init-max-forward-motion");
-      sfm_cmd.push_back(std::to_string(seed_profile.init_max_forward_motion));
-      sfm_cmd.push_back("--init-min-angle-deg");
-      sfm_cmd.push_back(std::to_string(seed_profile.init_min_angle_deg));
-      sfm_cmd.push_back("--init-min-median-angle-deg");
-      sfm_cmd.push_back(std::to_string(seed_profile.init_min_median_angle_deg));
-      sfm_cmd.push_back("--resection-min-inliers");
-      sfm_cmd.push_back(std::to_string(seed_profile.resection_min_inliers));
-    }
-    if (fix_intrinsics)
-      sfm_cmd.push_back("--fix-intrinsics");
+    append_seed_profile_flags(&sfm_cmd);
     if (ba_threads > 0) {
       sfm_cmd.push_back("--ba-threads");
       sfm_cmd.push_back(std::to_string(ba_threads));
@@ -1397,6 +1424,111 @@ int main(int argc, char* argv[]) {
     run_or_die("incremental-sfm", sfm_cmd);
   }
 
+  // ════════════════════════════════════════════════════════════════════════
+  // Step: PARTITIONED_SFM (optional, replaces incremental_sfm)
+  // ════════════════════════════════════════════════════════════════════════
+  if (active_steps.count("partitioned_sfm")) {
+    ++step_num;
+    LOG(INFO) << "=== Step " << step_num << "/" << total_steps << ": Partitioned SfM ===";
+    const fs::path partition_dir = work_path / "sfm_partition";
+    fs::create_directories(partition_dir);
+    fs::create_directories(sfm_out);
+    run_or_die("sfm-partition", {tool_path("isat_sfm_partition"), "-t", tracks_path.string(), "-m",
+                                 pairs_json.string(), "-g", geo_dir.string(), "-o",
+                                 partition_dir.string(), "--max-cluster-images",
+                                 std::to_string(partition_max_images), "--cluster-overlap",
+                                 std::to_string(partition_overlap)});
+
+    std::vector<fs::path> cluster_dirs;
+    try {
+      std::ifstream f(partition_dir / "clusters.json");
+      json clusters_json;
+      f >> clusters_json;
+      for (const auto& c : clusters_json.at("clusters"))
+        cluster_dirs.push_back(partition_dir / c.at("dir").get<std::string>());
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "Cannot read " << (partition_dir / "clusters.json") << ": " << e.what();
+      return 1;
+    }
+    if (cluster_dirs.empty()) {
+      LOG(ERROR) << "Partition produced no clusters";
+      return 1;
+    }
+
+    // Cluster runs are independent subprocesses; --ba-threads (or the hardware) is split evenly.
+    const int hw = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    int jobs = partition_jobs > 0 ? partition_jobs : std::max(1, hw / 4);
+    jobs = std::min(jobs, static_cast<int>(cluster_dirs.size()));
+    const int job_ba_threads = std::max(1, (ba_threads > 0 ? ba_threads : hw) / jobs);
+    LOG(INFO) << "Reconstructing " << cluster_dirs.size() << " clusters, " << jobs
+              << " at a time (ba_threads=" << job_ba_threads << " each)";
+    for (const fs::path& dir : cluster_dirs)
+      fs::create_directories(dir / "sfm");
+    std::vector<int> cluster_rc(cluster_dirs.size(), 1);
+    std::atomic<size_t> next_cluster{0};
+    auto t_clusters = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int w = 0; w < jobs; ++w) {
+      workers.emplace_back([&]() {
+        for (size_t k = next_cluster++; k < cluster_dirs.size(); k = next_cluster++) {
+          std::vector<std::string> cluster_cmd = {tool_path("isat_incremental_sfm"),
+                                                  "-t",
+                                                  (cluster_dirs[k] / "tracks.isat_tracks").string(),
+                                                  "-p",
+                                                  images_all.string(),
+                                                  "-m",
+                                                  pairs_json.string(),
+                                                  "-g",
+                                                  geo_dir.string(),
+                                                  "-o",
+                                                  (cluster_dirs[k] / "sfm").string(),
+                                                  "--ba-threads",
+                                                  std::to_string(job_ba_threads)};
+          append_seed_profile_flags(&cluster_cmd);
+          cluster_rc[k] = run(cluster_cmd);
+        }
+      });
+    }
+    for (std::thread& t : workers)
+      t.join();
+    const double cluster_secs =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - t_clusters).count();
+    g_step_timings.push_back({"partitioned-sfm-clusters", cluster_secs});
+
+    // A failed cluster is left out of the merge; its images can still come in through overlap.
+    std::string merge_list;
+    for (size_t k = 0; k < cluster_dirs.size(); ++k) {
+      if (cluster_rc[k] != 0) {
+        LOG(WARNING) << "Cluster " << cluster_dirs[k].filename() << " failed (exit code "
+                     << cluster_rc[k] << "); excluded from merge";
+        continue;
+      }
+      merge_list += (merge_list.empty() ? "" : ",") + (cluster_dirs[k] / "sfm").string();
+    }
+    LOG(INFO) << "Cluster reconstructions completed in " << cluster_secs << "s";
+    if (merge_list.empty()) {
+      LOG(ERROR) << "Step [partitioned-sfm] failed: no cluster was reconstructed";
+      return 1;
+    }
+
+    std::vector<std::string> merge_cmd = {tool_path("isat_incremental_sfm"),
+                                          "-t",
+                                          tracks_path.string(),
+                                          "-p",
+                                          images_all.string(),
+                                          "-o",
+                                          sfm_out.string(),
+                                          "--merge-models",
+                                          merge_list};
+    if (fix_intrinsics)
+      merge_cmd.push_back("--fix-intrinsics");
+    if (ba_threads > 0) {
+      merge_cmd.push_back("--ba-threads");
+      merge_cmd.push_back(std::to_string(ba_threads));
+    }
+    run_or_die("sfm-merge", merge_cmd);
+  }
+
   // ════════════════════════════════════════════════════════════════════════
   // Step: UNDISTORT (optional, off by default)
   // ════════════════════════════════════════════════════════════════════════
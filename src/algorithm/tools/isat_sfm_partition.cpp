@@ -0,0 +1,165 @@
+/**
+ * isat_sfm_partition.cpp
+ * Partitioned SfM, step 1: cut the view graph into overlapping clusters and write one tracks IDC
+ * per cluster for independent isat_incremental_sfm runs (merged afterwards with
+ * isat_incremental_sfm --merge-models).
+ *
+ * Edge weights are track covisibility; clusters are cut by recursive balanced bisection down to
+ * --max-cluster-images core images, then each cluster borrows its most strongly connected
+ * outside images (--cluster-overlap × core size, at least --min-overlap-images) so neighbouring
+ * sub-models share registered images for the Sim3 merge.
+ *
+ * Usage:
+ *   isat_sfm_partition -t tracks.isat_tracks -o partition_dir/ [-m pairs.json -g geo_dir/]
+ *
+ * Output:
+ *   partition_dir/clusters.json                    cluster list (core / overlap image indices)
+ *   partition_dir/cluster_NNN/tracks.isat_tracks   cluster tracks (global image indices, embedded
+ *                                                   view graph restricted to the cluster)
+ */
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glog/logging.h>
+#include <nlohmann/json.hpp>
+
+#include "cli_logging.h"
+#include "cmdLine/cmdLine.h"
+
+#include "../io/track_store_idc.h"
+#include "../modules/sfm/sfm_partition.h"
+#include "../modules/sfm/track_store.h"
+#include "../modules/sfm/view_graph.h"
+#include "../modules/sfm/view_graph_loader.h"
+
+using json = nlohmann::json;
+using namespace insight;
+using namespace insight::sfm;
+
+int main(int argc, char* argv[]) {
+  std::string tracks_path;
+  std::string pairs_path;
+  std::string geo_dir;
+  std::string output_dir;
+  std::string log_level;
+  PartitionOptions popts;
+  CmdLine cmd("Partitioned SfM: split tracks IDC into overlapping view-graph clusters");
+  cmd.add(make_option('t', tracks_path, "tracks").doc("Path to .isat_tracks IDC"));
+  cmd.add(make_option('m', pairs_path, "pairs")
+              .doc("Pairs JSON (view graph fallback when the IDC has no embedded graph)"));
+  cmd.add(make_option('g', geo_dir, "geo").doc("Directory of .isat_geo files (with -m)"));
+  cmd.add(make_option('o', output_dir, "output").doc("Output directory"));
+  cmd.add(make_option(0, popts.max_cluster_images, "max-cluster-images")
+              .doc("Maximum core images per cluster (default: 500)."));
+  cmd.add(make_option(0, popts.overlap_ratio, "cluster-overlap")
+              .doc("Overlap images per cluster as a fraction of its core size (default: 0.15)."));
+  cmd.add(make_option(0, popts.min_overlap_images, "min-overlap-images")
+              .doc("Minimum overlap images per cluster (default: 10)."));
+  cmd.add(make_option(0, log_level, "log-level").doc("Log level: error|warn|info|debug"));
+  cmd.add(make_switch('v', "verbose").doc("Verbose (INFO)"));
+  cmd.add(make_switch('q', "quiet").doc("Quiet (ERROR only)"));
+  cmd.add(make_switch('h', "help").doc("Show help"));
+  try {
+    cmd.process(argc, argv);
+  } catch (const std::string& s) {
+    std::cerr << "Error: " << s << "\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+  if (cmd.checkHelp(argv[0]))
+    return 0;
+  if (tracks_path.empty() || output_dir.empty()) {
+    std::cerr << "Error: -t and -o are required\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+  if (popts.max_cluster_images < 2 || popts.overlap_ratio < 0.0 || popts.min_overlap_images < 0) {
+    std::cerr << "Error: --max-cluster-images must be >= 2, --cluster-overlap and "
+                 "--min-overlap-images >= 0\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+  // Undersized clusters are folded into a neighbour; keep that floor well below the cap.
+  popts.min_cluster_images = std::min(popts.min_cluster_images, popts.max_cluster_images / 4 + 1);
+  insight::tools::apply_log_level(cmd.used('v'), cmd.used('q'), log_level);
+
+  TrackStore store;
+  std::vector<uint32_t> image_indices;
+  ViewGraph view_graph;
+  if (!load_track_store_from_idc(tracks_path, &store, &image_indices, &view_graph)) {
+    LOG(ERROR) << "Failed to load " << tracks_path;
+    return 1;
+  }
+  if (view_graph.num_pairs() == 0) {
+    if (pairs_path.empty() || geo_dir.empty()) {
+      LOG(ERROR) << tracks_path << " has no embedded view graph; pass -m and -g";
+      return 1;
+    }
+    if (!build_view_graph_from_geo(pairs_path, geo_dir, &view_graph)) {
+      LOG(ERROR) << "Failed to build view graph from " << pairs_path;
+      return 1;
+    }
+  }
+  LOG(INFO) << "Loaded " << store.num_images() << " images, " << store.num_tracks()
+            << " tracks, " << view_graph.num_pairs() << " view-graph pairs";
+
+  const std::vector<SfMCluster> clusters = partition_view_graph(view_graph, store, popts);
+  if (clusters.empty()) {
+    LOG(ERROR) << "Partition produced no clusters";
+    return 1;
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(output_dir, ec);
+  if (ec) {
+    LOG(ERROR) << "Cannot create " << output_dir << ": " << ec.message();
+    return 1;
+  }
+  json clusters_json = json::array();
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    std::ostringstream name;
+    name << "cluster_" << std::setw(3) << std::setfill('0') << c;
+    const std::filesystem::path dir = std::filesystem::path(output_dir) / name.str();
+    std::filesystem::create_directories(dir, ec);
+    const std::vector<int> images = clusters[c].images();
+    TrackStore sub;
+    extract_cluster_track_store(store, images, &sub);
+    const ViewGraph sub_graph = filter_view_graph(view_graph, images);
+    const std::string sub_tracks = (dir / "tracks.isat_tracks").string();
+    if (!save_track_store_to_idc(sub, image_indices, sub_tracks, &sub_graph)) {
+      LOG(ERROR) << "Failed to write " << sub_tracks;
+      return 1;
+    }
+    LOG(INFO) << name.str() << ": core=" << clusters[c].core.size()
+              << " overlap=" << clusters[c].overlap.size() << " tracks=" << sub.num_tracks()
+              << " pairs=" << sub_graph.num_pairs();
+    json jc;
+    jc["dir"] = name.str();
+    jc["core"] = clusters[c].core;
+    jc["overlap"] = clusters[c].overlap;
+    clusters_json.push_back(std::move(jc));
+  }
+
+  json root;
+  root["format"] = "isat_sfm_partition_v1";
+  root["tracks"] = tracks_path;
+  root["num_images"] = store.num_images();
+  root["max_cluster_images"] = popts.max_cluster_images;
+  root["overlap_ratio"] = popts.overlap_ratio;
+  root["clusters"] = std::move(clusters_json);
+  const std::string clusters_path = (std::filesystem::path(output_dir) / "clusters.json").string();
+  std::ofstream f(clusters_path);
+  if (!f.is_open()) {
+    LOG(ERROR) << "Cannot write " << clusters_path;
+    return 1;
+  }
+  f << root.dump(2);
+  LOG(INFO) << "Wrote " << clusters.size() << " clusters → " << clusters_path;
+  return 0;
+}
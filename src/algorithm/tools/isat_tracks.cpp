@@ -3,15 +3,37 @@
  * InsightAT Track Building CLI – load match + geo, build tracks, write IDC.
  *
  * Pipeline:
- *   Phase 0+1  Block-interleaved parallel I/O + Union-Find: one geopack block fread at a time
- *              (~1.5 GB peak vs 8.3 GB before). Coords stored per-node at first creation.
+ *   Phase 0+1  Block-interleaved parallel I/O + Union-Find: one geopack block mmap'd at a time,
+ *              merged serially by TrackUnionFind::merge_keys (--parallel-merge: merge_pairs,
+ *              multi-threaded with the same tracks, opt-in until it is shown faster on multi-core),
+ *              match blobs viewed in place (no payload copies). Coords stored per-node at first
+ *              creation. When match_dir holds matchpack_index.isat_mpkx, match rows come from
+ *              the mapped .isat_matchpack blocks instead of per-pair .isat_match files.
  *   Phase 2    Observations from UF node iteration — O(N_unique_features), not O(N_total_inliers).
  *              (~5.7 s vs 104 s before, 18×). UF freed immediately after this phase.
+ *   --memory-budget  Out-of-core Phase 1+2 (ExternalTrackBuilder): inlier matches are spilled to
+ *              sorted run files under --spill-dir and tracks are built by sort/merge passes, so
+ *              the node hash map and per-component image lists never have to fit in RAM. A
+ *              connected component too large to replay within the budget (before the same-image
+ *              rule splits it) is replayed anyway, past the budget, with a warning.
+ * Tracks are numbered by their smallest (image_index, feature_id), so both modes write the same IDC.
+ * The IDC records the pairs it was built from ("source_pairs"); --update seeds the UF with the
+ * existing tracks, merges only the new pairs, keeps existing track ids and writes per-track
+ * update status/link blobs (track_update.h). The result equals a full rebuild over old + new
+ * pairs only without --min-track-length: with it, --update drops short new tracks but keeps
+ * short existing ones, and cannot restore observations the existing file had filtered out.
+ * Limitation: --update cannot restore observations removed by an earlier --min-track-length
+ * (isat_sfm builds with 2); the filtered-out observations are not recorded in the IDC, so a short
+ * track that new pairs would have extended is rebuilt from the new matches alone.
+ * The embedded view graph is built from the -i pairs in input order; with --update, from
+ * source_pairs (canonical (min, max) pairs, sorted), since -i then holds only the new pairs.
  * Track xyz is left for incremental SfM (no two-view 3D). Output: single .isat_tracks IDC
  * (schema 1.1 embeds view_graph_pairs: PairGeoInfo per covisible edge after degree filter, from geo_dir).
  *
  * Usage:
  *   isat_tracks -i pairs.json -m match_dir/ -g geo_dir/ -l image_list.json -o tracks.isat_tracks
+ *   isat_tracks ... -o tracks.isat_tracks --memory-budget 4096 --spill-dir /local/tmp
+ *   isat_tracks ... -o tracks_v2.isat_tracks --update tracks.isat_tracks   (merge new pairs only)
  *   isat_tracks --stats -o tracks.isat_tracks
  */
 
@@ -24,6 +46,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <numeric>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -39,8 +62,12 @@
 
 #include "../io/idc_reader.h"
 #include "../io/geopack_index.h"
+#include "../io/matchpack.h"
 #include "../io/track_store_idc.h"
+#include "../modules/sfm/external_track_builder.h"
 #include "../modules/sfm/track_store.h"
+#include "../modules/sfm/track_union_find.h"
+#include "../modules/sfm/track_update.h"
 #include "../modules/sfm/view_graph.h"
 #include "../modules/sfm/view_graph_loader.h"
 #include "cli_logging.h"
@@ -71,44 +98,44 @@ struct PairDesc {
   std::string geopack_file;
   std::string geopack_f_blob;
   std::string geopack_e_blob;
+  const insight::io::MatchPackIndexRecordV1* match_pack_rec = nullptr;
 };
 
 static std::vector<PairDesc> load_pairs(const std::string& json_path, const std::string& match_dir,
                                        const std::string& geo_dir,
-                                       const insight::io::GeoPackIndex* geopack_index) {
-  std::ifstream file(json_path);
-  if (!file.is_open()) {
-    LOG(FATAL) << "Cannot open pairs file: " << json_path;
-  }
-  json j;
-  file >> j;
+                                       const insight::io::GeoPackIndex* geopack_index,
+                                       const insight::io::MatchPackIndex* match_pack) {
   std::vector<PairDesc> pairs;
-  pairs.reserve(j["pairs"].size());
-  for (const auto& p : j["pairs"]) {
-    PairDesc d;
-    d.image1_index = insight::tools::get_image_index_from_pair(p, "image1_index");
-    d.image2_index = insight::tools::get_image_index_from_pair(p, "image2_index");
-    // Match and geo files are always stored as min_max (image1_index < image2_index).
-    // Canonicalise so that image1_index <= image2_index to guarantee correct path lookup
-    // and correct feature-index interpretation (indices[m*2] belongs to image1).
-    if (d.image1_index > d.image2_index)
-      std::swap(d.image1_index, d.image2_index);
-    d.match_file = match_dir + "/" + std::to_string(d.image1_index) + "_" +
-                   std::to_string(d.image2_index) + ".isat_match";
-    d.geo_file = geo_dir + "/" + std::to_string(d.image1_index) + "_" + std::to_string(d.image2_index) +
-                 ".isat_geo";
-    if (geopack_index) {
-      const insight::io::GeoPackPairEntry* e =
-          geopack_index->find(d.image1_index, d.image2_index);
-      if (e) {
-        d.use_geopack = true;
-        d.geopack_file = e->pack_path;
-        d.geopack_f_blob = e->f_inliers_blob;
-        d.geopack_e_blob = e->e_inliers_blob;
-      }
-    }
-    pairs.push_back(std::move(d));
-  }
+  const bool ok = insight::tools::for_each_pair_in_list(
+      json_path, [&](const insight::tools::PairListEntry& p) {
+        PairDesc d;
+        d.image1_index = p.image1_index;
+        d.image2_index = p.image2_index;
+        // Match and geo files are always stored as min_max (image1_index < image2_index).
+        // Canonicalise so that image1_index <= image2_index to guarantee correct path lookup
+        // and correct feature-index interpretation (indices[m*2] belongs to image1).
+        if (d.image1_index > d.image2_index)
+          std::swap(d.image1_index, d.image2_index);
+        d.match_file = match_dir + "/" + std::to_string(d.image1_index) + "_" +
+                       std::to_string(d.image2_index) + ".isat_match";
+        d.geo_file = geo_dir + "/" + std::to_string(d.image1_index) + "_" +
+                     std::to_string(d.image2_index) + ".isat_geo";
+        if (geopack_index) {
+          const insight::io::GeoPackPairEntry* e =
+              geopack_index->find(d.image1_index, d.image2_index);
+          if (e) {
+            d.use_geopack = true;
+            d.geopack_file = e->pack_path;
+            d.geopack_f_blob = e->f_inliers_blob;
+            d.geopack_e_blob = e->e_inliers_blob;
+          }
+        }
+        if (match_pack)
+          d.match_pack_rec = match_pack->find(d.image1_index, d.image2_index);
+        pairs.push_back(std::move(d));
+      });
+  if (!ok)
+    LOG(FATAL) << "Cannot open pairs file: " << json_path;
   LOG(INFO) << "Loaded " << pairs.size() << " pairs from " << json_path;
   return pairs;
 }
@@ -139,141 +166,28 @@ static std::vector<uint32_t> get_image_indices_from_list(const std::string& imag
   return out;
 }
 
-// ─────────────────────────────────────────────────────────────────────────────
-// Union-Find key: (image_index, feature_id) → node (high=image_index, low=feature_id)
-// ─────────────────────────────────────────────────────────────────────────────
-
-static uint64_t node_key(uint32_t image_index, uint32_t feature_id) {
-  return (static_cast<uint64_t>(image_index) << 32) | feature_id;
-}
-
-static uint32_t image_index_from_node_key(uint64_t key) {
-  return static_cast<uint32_t>(key >> 32);
-}
-
-// ─────────────────────────────────────────────────────────────────────────────
-// Union-Find
-//
-// component_images_ stores the set of image indices per component as a
-// sorted small vector.  Most tracks span 2–10 images, so linear scan on a
-// contiguous array is faster than a hash table (better cache locality, no
-// pointer indirection, branch-predictor-friendly).  Merge keeps the vector
-// sorted via std::merge into a temporary, then swaps back.
-// ─────────────────────────────────────────────────────────────────────────────
-
-struct UnionFind {
-  std::unordered_map<uint64_t, int> node_id_;
-  std::vector<int> parent_;
-  std::vector<int> component_size_;
-  // Sorted small vector per component — cache-friendly for the typical 2–10 image case.
-  std::vector<std::vector<uint32_t>> component_images_;
-  // Per-node observation coords, parallel to parent_.  Populated at node creation (first-seen
-  // wins).  Eliminates the need to keep all PairRawData alive through Phase 2.
-  std::vector<float> node_u_, node_v_, node_s_;
-
-  static bool components_overlap_images(const std::vector<uint32_t>& a,
-                                        const std::vector<uint32_t>& b) {
-    size_t i = 0, j = 0;
-    while (i < a.size() && j < b.size()) {
-      if (a[i] == b[j]) return true;
-      if (a[i] < b[j]) ++i; else ++j;
-    }
-    return false;
-  }
-
-  // Create node with coords if new; return its internal id in both cases.
-  int get_or_create(uint64_t key, float u, float v, float s) {
-    auto it = node_id_.find(key);
-    if (it != node_id_.end())
-      return it->second;
-    const int id = static_cast<int>(parent_.size());
-    node_id_[key] = id;
-    parent_.push_back(id);
-    component_size_.push_back(1);
-    component_images_.push_back({image_index_from_node_key(key)});
-    node_u_.push_back(u);
-    node_v_.push_back(v);
-    node_s_.push_back(s);
-    return id;
-  }
-
-  // Iterative path compression (avoids stack overflow on deep chains).
-  int find_by_id(int i) {
-    int root = i;
-    while (parent_[static_cast<size_t>(root)] != root)
-      root = parent_[static_cast<size_t>(root)];
-    while (parent_[static_cast<size_t>(i)] != root) {
-      int next = parent_[static_cast<size_t>(i)];
-      parent_[static_cast<size_t>(i)] = root;
-      i = next;
-    }
-    return root;
-  }
-
-  // Merge two features into the same track.  Creates nodes (storing coords) if they don't
-  // exist yet.  Returns false only when the merge would put two features from the same image
-  // into the same track (one-feature-per-image-per-track invariant).
-  bool merge_keys(uint64_t k1, uint64_t k2,
-                  float u1, float v1, float s1,
-                  float u2, float v2, float s2) {
-    int id1 = get_or_create(k1, u1, v1, s1);
-    int id2 = get_or_create(k2, u2, v2, s2);
-    int a = find_by_id(id1);
-    int b = find_by_id(id2);
-    if (a == b) return true;
-
-    if (components_overlap_images(component_images_[static_cast<size_t>(a)],
-                                  component_images_[static_cast<size_t>(b)]))
-      return false;
-
-    // Union by size: attach smaller to larger.
-    if (component_size_[static_cast<size_t>(a)] < component_size_[static_cast<size_t>(b)])
-      std::swap(a, b);
-
-    parent_[static_cast<size_t>(b)] = a;
-    component_size_[static_cast<size_t>(a)] += component_size_[static_cast<size_t>(b)];
-
-    auto& dst = component_images_[static_cast<size_t>(a)];
-    auto& src = component_images_[static_cast<size_t>(b)];
-    std::vector<uint32_t> merged;
-    merged.reserve(dst.size() + src.size());
-    std::merge(dst.begin(), dst.end(), src.begin(), src.end(), std::back_inserter(merged));
-    dst = std::move(merged);
-    src.clear();
-    src.shrink_to_fit();
-    return true;
-  }
-};
-
 // ─────────────────────────────────────────────────────────────────────────────
 // Phase 0+1 combined: block-interleaved I/O + Union-Find
 //
 // Memory model (was 8.3 GB, now ≤ ~1.5 GB peak):
 //   - One geopack block payload (~300 MB) live at a time.
-//   - Per-block PairRawData (~1.2 GB) allocated, used for serial UF, then freed.
+//   - Per-block PairRawData (~1.2 GB) allocated, used for the parallel UF merge, then freed.
 //   - Node coords (u,v,scale) stored once per-node in uf.node_[uvs]_ (240 MB).
 //   - No global pair_raw vector: PairRawData never accumulates across blocks.
 // ─────────────────────────────────────────────────────────────────────────────
 
-struct InlierMatch {
-  uint16_t idx1;
-  uint16_t idx2;
-  float x1, y1, x2, y2;  // pixel coordinates (image1, image2)
-  float s1, s2;           // scales (1.0 if not available)
-};
-
 struct PairRawData {
-  std::vector<InlierMatch> matches;
+  std::vector<TrackInlierMatch> matches;
 };
 
 /**
- * Phase 0+1 pipeline: block-interleaved parallel I/O + serial Union-Find.
- * Each geopack block: fread payload → OMP fill PairRawData → serial UF → free.
+ * Phase 0+1 pipeline: block-interleaved parallel I/O + parallel Union-Find.
+ * Each geopack block: fread payload → OMP fill PairRawData → merge_block (Union-Find) → free.
  *
  * Peak extra memory: ~1.5 GB/block (vs 8.3 GB total before).
  */
 // ─────────────────────────────────────────────────────────────────────────────
-// Helper: build InlierMatch vector from raw pointers (used by both code paths)
+// Helper: build TrackInlierMatch vector from raw pointers (used by both code paths)
 // ─────────────────────────────────────────────────────────────────────────────
 static void fill_pair_raw(PairRawData& out,
                           const uint8_t* mask_ptr, size_t num_matches,
@@ -289,7 +203,7 @@ static void fill_pair_raw(PairRawData& out,
   out.matches.reserve(safe_m);
   for (size_t m = 0; m < safe_m; ++m) {
     if (!mask_ptr[m]) continue;
-    InlierMatch im;
+    TrackInlierMatch im;
     im.idx1 = indices_data[m * 2];
     im.idx2 = indices_data[m * 2 + 1];
     im.x1   = coords_all[m * 4];
@@ -305,27 +219,89 @@ static void fill_pair_raw(PairRawData& out,
   out.matches.shrink_to_fit();
 }
 
-// Serial UF over one block of pre-loaded pairs, capturing coords on first node creation.
-static void uf_block(UnionFind* uf, const std::vector<PairDesc>& pairs,
-                     const std::vector<int>& idx_list, const std::vector<PairRawData>& blk_raw,
-                     int& merged, int& rejected) {
+// Zero-copy variant: blobs are read straight out of the mapped .isat_match (no payload buffer).
+// "scales" is optional (older match files), so it is only viewed when present.
+static void fill_pair_raw_mapped(PairRawData& out, const BlobView<uint8_t>& mask,
+                                 const IDCReader& match_rd) {
+  const auto idx   = match_rd.view_blob<uint16_t>("indices");
+  const auto coord = match_rd.view_blob<float>("coords_pixel");
+  BlobView<float> scale;
+  if (match_rd.has_blob("scales"))
+    scale = match_rd.view_blob<float>("scales");
+  fill_pair_raw(out, mask.data(), mask.size(), idx.data(), idx.size(), coord.data(), coord.size(),
+                scale.data(), scale.size());
+}
+
+// Match rows for one pair, from the match pack when indexed there, else from its .isat_match.
+// Pack rows keep the orientation they were matched in; flip them to the canonical min_max pair.
+static bool fill_pair_raw_match(PairRawData& out, const BlobView<uint8_t>& mask,
+                                const PairDesc& pd, const insight::io::MatchPackIndex* match_pack) {
+  if (match_pack && pd.match_pack_rec) {
+    insight::io::MatchPackPairView view;
+    if (!match_pack->read_pair(*pd.match_pack_rec, &view))
+      return false;
+    fill_pair_raw(out, mask.data(), mask.size(), view.indices.data(), view.indices.size(),
+                  view.coords_pixel.data(), view.coords_pixel.size(), view.scales.data(),
+                  view.scales.size());
+    if (view.image1_index != pd.image1_index) {
+      for (TrackInlierMatch& im : out.matches) {
+        std::swap(im.idx1, im.idx2);
+        std::swap(im.x1, im.x2);
+        std::swap(im.y1, im.y2);
+        std::swap(im.s1, im.s2);
+      }
+    }
+    return true;
+  }
+  IDCReader match_rd(pd.match_file, IDCReadMode::kMapped);
+  if (!match_rd.is_valid())
+    return false;
+  fill_pair_raw_mapped(out, mask, match_rd);
+  return true;
+}
+
+// Positions into idx_list in match-pack (block, row) order, so pack blocks are streamed, not
+// thrashed. Only the read order changes: the sink still receives pairs in idx_list order, which
+// the order-dependent conflict rule of the union-find requires.
+static std::vector<int> match_pack_read_order(const std::vector<PairDesc>& pairs,
+                                              const std::vector<int>& idx_list, bool by_pack) {
+  std::vector<int> order(idx_list.size());
+  std::iota(order.begin(), order.end(), 0);
+  if (!by_pack)
+    return order;
+  std::stable_sort(order.begin(), order.end(), [&pairs, &idx_list](int a, int b) {
+    const auto* ra = pairs[static_cast<size_t>(idx_list[static_cast<size_t>(a)])].match_pack_rec;
+    const auto* rb = pairs[static_cast<size_t>(idx_list[static_cast<size_t>(b)])].match_pack_rec;
+    if (!ra || !rb)
+      return ra != nullptr && rb == nullptr;
+    if (ra->block_index != rb->block_index)
+      return ra->block_index < rb->block_index;
+    return ra->row_offset < rb->row_offset;
+  });
+  return order;
+}
+
+// Consumer of one block of matches in processing order (in-memory UF or external builder).
+using BlockSink = std::function<bool(const std::vector<TrackPairMatches>&)>;
+
+// Views of the non-empty pairs of one pre-loaded block, in idx_list order.
+static std::vector<TrackPairMatches> block_matches(const std::vector<PairDesc>& pairs,
+                                                   const std::vector<int>& idx_list,
+                                                   const std::vector<PairRawData>& blk_raw) {
   const int blk_n = static_cast<int>(idx_list.size());
+  std::vector<TrackPairMatches> batch;
+  batch.reserve(static_cast<size_t>(blk_n));
   for (int bi = 0; bi < blk_n; ++bi) {
     const PairRawData& rd = blk_raw[static_cast<size_t>(bi)];
     if (rd.matches.empty()) continue;
-    const uint32_t img1 = pairs[static_cast<size_t>(idx_list[bi])].image1_index;
-    const uint32_t img2 = pairs[static_cast<size_t>(idx_list[bi])].image2_index;
-    for (const InlierMatch& im : rd.matches) {
-      if (uf->merge_keys(node_key(img1, im.idx1), node_key(img2, im.idx2),
-                         im.x1, im.y1, im.s1, im.x2, im.y2, im.s2))
-        ++merged;
-      else
-        ++rejected;
-    }
+    const PairDesc& pd = pairs[static_cast<size_t>(idx_list[bi])];
+    batch.push_back({pd.image1_index, pd.image2_index, rd.matches.data(), rd.matches.size()});
   }
+  return batch;
 }
 
-static void phase0_1_pipeline(const std::vector<PairDesc>& pairs, UnionFind* uf,
+static bool phase0_1_pipeline(const std::vector<PairDesc>& pairs,
+                               const insight::io::MatchPackIndex* match_pack, const BlockSink& sink,
                                int& total_loaded, int& total_skipped) {
   const int n = static_cast<int>(pairs.size());
   const int log_interval = std::max(1, n / 20);
@@ -340,15 +316,13 @@ static void phase0_1_pipeline(const std::vector<PairDesc>& pairs, UnionFind* uf,
       legacy_idx.push_back(i);
   }
 
-  int merged_total = 0, rejected_total = 0;
-
-  // ── Geopack: one block fread at a time (~300 MB), UF, free ───────────────
+  // ── Geopack: one block mapped at a time (~300 MB), UF, unmap ─────────────
   int block_no = 0;
   const int num_blocks = static_cast<int>(geopack_groups.size());
   for (auto& [pack_path, idx_list] : geopack_groups) {
     ++block_no;
 
-    IDCReader pack_rd(pack_path);
+    IDCReader pack_rd(pack_path, IDCReadMode::kMapped);
     if (!pack_rd.is_valid()) {
       const int skip_n = static_cast<int>(idx_list.size());
       total_skipped += skip_n;
@@ -357,29 +331,29 @@ static void phase0_1_pipeline(const std::vector<PairDesc>& pairs, UnionFind* uf,
                    << ": unreadable, skipping " << skip_n << " pairs";
       continue;
     }
-    std::vector<uint8_t> pack_payload = pack_rd.read_full_payload();
     LOG(INFO) << "Phase 0+1 block " << block_no << "/" << num_blocks << ": "
-              << idx_list.size() << " pairs, payload=" << (pack_payload.size() >> 20) << " MB";
+              << idx_list.size() << " pairs, mapped=" << (pack_rd.mapped_file()->size() >> 20)
+              << " MB";
 
     const int blk_n = static_cast<int>(idx_list.size());
+    const std::vector<int> read_order =
+        match_pack_read_order(pairs, idx_list, match_pack != nullptr);
     std::vector<PairRawData> blk_raw(static_cast<size_t>(blk_n));
     int blk_loaded = 0, blk_skipped = 0;
 
-    // Phase 0 for this block: parallel I/O (mask from payload, match from disk).
+    // Phase 0 for this block: parallel I/O (mask viewed in the mapped pack, match file mapped).
 #pragma omp parallel for schedule(dynamic, 64) reduction(+:blk_loaded,blk_skipped)
-    for (int bi = 0; bi < blk_n; ++bi) {
+    for (int k = 0; k < blk_n; ++k) {
+      const int bi = read_order[static_cast<size_t>(k)];
       const int i = idx_list[static_cast<size_t>(bi)];
       const PairDesc& pd = pairs[static_cast<size_t>(i)];
 
-      size_t mask_size = 0;
-      const uint8_t* mask_ptr = nullptr;
-      if (!pd.geopack_f_blob.empty())
-        mask_ptr = pack_rd.get_blob_from_payload(pd.geopack_f_blob, pack_payload, &mask_size);
-      if (!mask_ptr || mask_size == 0) {
-        if (!pd.geopack_e_blob.empty())
-          mask_ptr = pack_rd.get_blob_from_payload(pd.geopack_e_blob, pack_payload, &mask_size);
-      }
-      if (!mask_ptr || mask_size == 0) {
+      BlobView<uint8_t> mask;
+      if (!pd.geopack_f_blob.empty() && pack_rd.has_blob(pd.geopack_f_blob))
+        mask = pack_rd.view_blob<uint8_t>(pd.geopack_f_blob);
+      if (mask.empty() && !pd.geopack_e_blob.empty() && pack_rd.has_blob(pd.geopack_e_blob))
+        mask = pack_rd.view_blob<uint8_t>(pd.geopack_e_blob);
+      if (mask.empty()) {
         ++blk_skipped;
         const int d = ++total_done;
         if (d % log_interval == 0) {
@@ -389,22 +363,9 @@ static void phase0_1_pipeline(const std::vector<PairDesc>& pairs, UnionFind* uf,
         continue;
       }
 
-      IDCReader match_rd(pd.match_file);
-      if (!match_rd.is_valid()) { ++blk_skipped; ++total_done; continue; }
-      thread_local std::vector<uint8_t> tl_mpl;
-      match_rd.read_full_payload_into(tl_mpl);
-      size_t idx_sz = 0, coord_sz = 0, scale_sz = 0;
-      const auto* idx_ptr   = reinterpret_cast<const uint16_t*>(
-          match_rd.get_blob_from_payload("indices",      tl_mpl, &idx_sz));
-      const auto* coord_ptr = reinterpret_cast<const float*>(
-          match_rd.get_blob_from_payload("coords_pixel", tl_mpl, &coord_sz));
-      const auto* scale_ptr = reinterpret_cast<const float*>(
-          match_rd.get_blob_from_payload("scales",       tl_mpl, &scale_sz));
-
-      fill_pair_raw(blk_raw[static_cast<size_t>(bi)], mask_ptr, mask_size,
-                    idx_ptr,   idx_sz   / sizeof(uint16_t),
-                    coord_ptr, coord_sz / sizeof(float),
-                    scale_ptr, scale_sz / sizeof(float));
+      if (!fill_pair_raw_match(blk_raw[static_cast<size_t>(bi)], mask, pd, match_pack)) {
+        ++blk_skipped; ++total_done; continue;
+      }
       if (!blk_raw[static_cast<size_t>(bi)].matches.empty()) ++blk_loaded; else ++blk_skipped;
 
       const int d = ++total_done;
@@ -414,54 +375,41 @@ static void phase0_1_pipeline(const std::vector<PairDesc>& pairs, UnionFind* uf,
       }
     }  // OMP
 
-    // Phase 1 for this block (serial, coord-capturing UF).
-    int blk_merged = 0, blk_rejected = 0;
-    uf_block(uf, pairs, idx_list, blk_raw, blk_merged, blk_rejected);
-    merged_total  += blk_merged;
-    rejected_total += blk_rejected;
+    // Phase 1 for this block (parallel, coord-capturing UF; serial-equivalent result).
+    if (!sink(block_matches(pairs, idx_list, blk_raw)))
+      return false;
     total_loaded  += blk_loaded;
     total_skipped += blk_skipped;
-    // blk_raw and pack_payload destroyed here → frees ~1.5 GB.
+    // blk_raw and the block mapping released here.
   }
 
   // ── Legacy per-pair .isat_geo ─────────────────────────────────────────────
   const int leg_n = static_cast<int>(legacy_idx.size());
   if (leg_n > 0) {
     LOG(INFO) << "Phase 0+1 legacy: " << leg_n << " per-pair .isat_geo pairs";
+    const std::vector<int> read_order =
+        match_pack_read_order(pairs, legacy_idx, match_pack != nullptr);
     std::vector<PairRawData> leg_raw(static_cast<size_t>(leg_n));
     int leg_loaded = 0, leg_skipped = 0;
 
 #pragma omp parallel for schedule(dynamic, 64) reduction(+:leg_loaded,leg_skipped)
-    for (int li = 0; li < leg_n; ++li) {
+    for (int k = 0; k < leg_n; ++k) {
+      const int li = read_order[static_cast<size_t>(k)];
       const int i = legacy_idx[static_cast<size_t>(li)];
       const PairDesc& pd = pairs[static_cast<size_t>(i)];
 
-      IDCReader geo_rd(pd.geo_file);
+      IDCReader geo_rd(pd.geo_file, IDCReadMode::kMapped);
       if (!geo_rd.is_valid()) { ++leg_skipped; ++total_done; continue; }
-      thread_local std::vector<uint8_t> tl_gpl;
-      geo_rd.read_full_payload_into(tl_gpl);
-      size_t mask_size = 0;
-      const uint8_t* mask_ptr = geo_rd.get_blob_from_payload("F_inliers", tl_gpl, &mask_size);
-      if (!mask_ptr || mask_size == 0)
-        mask_ptr = geo_rd.get_blob_from_payload("E_inliers", tl_gpl, &mask_size);
-      if (!mask_ptr || mask_size == 0) { ++leg_skipped; ++total_done; continue; }
-
-      IDCReader match_rd(pd.match_file);
-      if (!match_rd.is_valid()) { ++leg_skipped; ++total_done; continue; }
-      thread_local std::vector<uint8_t> tl_mpl_leg;
-      match_rd.read_full_payload_into(tl_mpl_leg);
-      size_t idx_sz = 0, coord_sz = 0, scale_sz = 0;
-      const auto* idx_ptr   = reinterpret_cast<const uint16_t*>(
-          match_rd.get_blob_from_payload("indices",      tl_mpl_leg, &idx_sz));
-      const auto* coord_ptr = reinterpret_cast<const float*>(
-          match_rd.get_blob_from_payload("coords_pixel", tl_mpl_leg, &coord_sz));
-      const auto* scale_ptr = reinterpret_cast<const float*>(
-          match_rd.get_blob_from_payload("scales",       tl_mpl_leg, &scale_sz));
-
-      fill_pair_raw(leg_raw[static_cast<size_t>(li)], mask_ptr, mask_size,
-                    idx_ptr,   idx_sz   / sizeof(uint16_t),
-                    coord_ptr, coord_sz / sizeof(float),
-                    scale_ptr, scale_sz / sizeof(float));
+      BlobView<uint8_t> mask;
+      if (geo_rd.has_blob("F_inliers"))
+        mask = geo_rd.view_blob<uint8_t>("F_inliers");
+      if (mask.empty() && geo_rd.has_blob("E_inliers"))
+        mask = geo_rd.view_blob<uint8_t>("E_inliers");
+      if (mask.empty()) { ++leg_skipped; ++total_done; continue; }
+
+      if (!fill_pair_raw_match(leg_raw[static_cast<size_t>(li)], mask, pd, match_pack)) {
+        ++leg_skipped; ++total_done; continue;
+      }
       if (!leg_raw[static_cast<size_t>(li)].matches.empty()) ++leg_loaded; else ++leg_skipped;
 
       const int d = ++total_done;
@@ -470,20 +418,48 @@ static void phase0_1_pipeline(const std::vector<PairDesc>& pairs, UnionFind* uf,
         LOG(INFO) << "Phase 0+1 legacy: " << d << "/" << n << " pairs processed";
       }
     }
-    int leg_merged = 0, leg_rejected = 0;
-    uf_block(uf, pairs, legacy_idx, leg_raw, leg_merged, leg_rejected);
-    merged_total  += leg_merged;
-    rejected_total += leg_rejected;
+    if (!sink(block_matches(pairs, legacy_idx, leg_raw)))
+      return false;
     total_loaded  += leg_loaded;
     total_skipped += leg_skipped;
     // leg_raw freed here.
   }
 
   LOG(INFO) << "Phase 0+1 done: loaded=" << total_loaded << " skipped=" << total_skipped
-            << " merged_edges=" << merged_total
-            << " rejected_same_image=" << rejected_total
-            << " unique_nodes=" << uf->node_id_.size()
             << " (threads=" << omp_get_max_threads() << ")";
+  return true;
+}
+
+// Blocks with fewer matches than this always take the serial merge: the parallel node pass and
+// reservation rounds cost more than they save on small blocks.
+static constexpr size_t kParallelMergeMinMatches = size_t{1} << 18;
+
+/**
+ * Phase 1 merge of one block. Default: serial merge_keys over every match in order.
+ * TrackUnionFind::merge_pairs (same tracks) is used only when --parallel-merge is given, more
+ * than one OpenMP thread is available and the block holds at least kParallelMergeMinMatches
+ * matches; it has not been shown faster than the serial loop on a multi-core run yet.
+ */
+static TrackMergeStats merge_block(TrackUnionFind& uf, const std::vector<TrackPairMatches>& block,
+                                   bool parallel_merge) {
+  size_t n_matches = 0;
+  for (const auto& p : block)
+    n_matches += p.num_matches;
+  if (parallel_merge && omp_get_max_threads() > 1 && n_matches >= kParallelMergeMinMatches)
+    return uf.merge_pairs(block);
+
+  TrackMergeStats stats;
+  for (const auto& p : block) {
+    for (size_t k = 0; k < p.num_matches; ++k) {
+      const TrackInlierMatch& m = p.matches[k];
+      if (uf.merge_keys(track_node_key(p.image1_index, m.idx1),
+                        track_node_key(p.image2_index, m.idx2), m.x1, m.y1, m.s1, m.x2, m.y2, m.s2))
+        ++stats.merged;
+      else
+        ++stats.rejected;
+    }
+  }
+  return stats;
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
@@ -492,12 +468,13 @@ static void phase0_1_pipeline(const std::vector<PairDesc>& pairs, UnionFind* uf,
 // The UF already has every unique (image, feature) pair as a node, with coords
 // stored at first creation.  Iterating nodes directly replaces the old approach
 // of re-visiting all 560 M non-unique inlier matches with 560 M hash-set ops.
+// Tracks are numbered in order of their smallest (image_index, feature_id) — the same
+// numbering as ExternalTrackBuilder, independent of hash-map iteration order.
 // Memory: ~20 M × 28 B = ~560 MB temporary sort buffer, freed after insert.
 // ─────────────────────────────────────────────────────────────────────────────
-static void phase2_from_nodes(TrackStore* store, UnionFind& uf,
-                               const std::unordered_map<int, int>& root_to_track_id) {
+static int phase2_from_nodes(TrackStore* store, TrackUnionFind& uf) {
   struct ObsEntry {
-    int      track_id;
+    int      track_id;  // UF root until renumbered
     uint32_t image_index;
     uint32_t feature_id;
     float    u, v, scale;
@@ -507,32 +484,71 @@ static void phase2_from_nodes(TrackStore* store, UnionFind& uf,
   obs.reserve(uf.node_id_.size());
 
   for (const auto& [key, id] : uf.node_id_) {
-    const int root = uf.find_by_id(id);
-    auto it = root_to_track_id.find(root);
-    if (it == root_to_track_id.end()) continue;
-    obs.push_back({it->second,
-                   image_index_from_node_key(key),
+    obs.push_back({uf.find_by_id(id),
+                   image_index_from_track_node_key(key),
                    static_cast<uint32_t>(key & 0xFFFFFFFFu),
                    uf.node_u_[static_cast<size_t>(id)],
                    uf.node_v_[static_cast<size_t>(id)],
                    uf.node_s_[static_cast<size_t>(id)]});
   }
 
-  // Sort by (track_id, image_index, feature_id) — required by TrackStore.
+  // Key order, then track ids by first appearance of each root.
   std::sort(obs.begin(), obs.end(), [](const ObsEntry& a, const ObsEntry& b) {
-    if (a.track_id    != b.track_id)    return a.track_id    < b.track_id;
     if (a.image_index != b.image_index) return a.image_index < b.image_index;
     return a.feature_id < b.feature_id;
   });
+  std::unordered_map<int, int> root_to_track_id;
+  root_to_track_id.reserve(obs.size());
+  for (ObsEntry& e : obs)
+    e.track_id = root_to_track_id.emplace(e.track_id, static_cast<int>(root_to_track_id.size()))
+                     .first->second;
+  const int num_tracks = static_cast<int>(root_to_track_id.size());
+  root_to_track_id = std::unordered_map<int, int>();
 
+  // Sort by (track_id, image_index, feature_id) — required by TrackStore.
+  std::stable_sort(obs.begin(), obs.end(), [](const ObsEntry& a, const ObsEntry& b) {
+    return a.track_id < b.track_id;
+  });
+
+  store->reserve_tracks(static_cast<size_t>(num_tracks));
+  store->reserve_observations(obs.size());
+  for (int t = 0; t < num_tracks; ++t)
+    store->add_track(0.f, 0.f, 0.f);
   for (const ObsEntry& e : obs)
     store->add_observation(e.track_id, e.image_index, e.feature_id, e.u, e.v, e.scale);
+  store->compact();
 
-  LOG(INFO) << "Phase 2: " << obs.size() << " observations from "
+  LOG(INFO) << "Phase 2: " << obs.size() << " observations, " << num_tracks << " tracks from "
             << uf.node_id_.size() << " unique features";
+  return num_tracks;
   // obs freed here (~560 MB released).
 }
 
+// Out-of-core Phase 1+2: the block sink spilled every match; build tracks by sort/merge passes.
+static bool phase1_2_external(TrackStore* store, ExternalTrackBuilder* builder) {
+  ExternalTrackStats st;
+  const bool ok = builder->build(
+      [store](int track_id, uint64_t key, float u, float v, float scale) {
+        while (static_cast<int>(store->num_tracks()) <= track_id)
+          store->add_track(0.f, 0.f, 0.f);
+        store->add_observation(track_id, image_index_from_track_node_key(key),
+                               static_cast<uint32_t>(key & 0xFFFFFFFFu), u, v, scale);
+      },
+      &st);
+  if (!ok) {
+    LOG(ERROR) << "Out-of-core track build failed (spill dir " << builder->spill_directory() << ")";
+    return false;
+  }
+  store->compact();
+  LOG(INFO) << "Phase 1+2 (out-of-core): " << st.num_tracks << " tracks from " << st.num_nodes
+            << " unique features, matches=" << st.num_matches << " merged_edges=" << st.merged
+            << " rejected_same_image=" << st.rejected << " components=" << st.num_components
+            << " largest_component_edges=" << st.largest_component_edges
+            << " over_budget_components=" << st.over_budget_components << " runs=" << st.num_runs
+            << " spilled=" << (st.spill_bytes >> 20) << " MB";
+  return true;
+}
+
 // ─────────────────────────────────────────────────────────────────────────────
 // Post-build filter: remove tracks with fewer than min_degree observations.
 // Builds a compact new TrackStore (renumbered) and returns stats.
@@ -577,6 +593,7 @@ static FilterStats compact_tracks_min_degree(const TrackStore& src, int n_images
     for (const Observation& o : obs_buf)
       dst->add_observation(new_tid, o.image_index, o.feature_id, o.u, o.v, o.scale);
   }
+  dst->compact();
 
   stats.out_tracks = static_cast<int>(dst->num_tracks());
   stats.out_obs    = static_cast<int>(dst->num_observations());
@@ -596,8 +613,9 @@ int main(int argc, char* argv[]) {
   std::string pairs_json, match_dir, geo_dir, image_list, output_path;
   bool stats_only = false;
 
-  cmd.add(make_option('i', pairs_json, "input").doc("Pairs JSON (e.g. from isat_geo output)"));
-  cmd.add(make_option('m', match_dir, "match-dir").doc("Directory of .isat_match files"));
+  cmd.add(make_option('i', pairs_json, "input").doc("Pair list, .isat_pairs or JSON (e.g. from isat_geo output)"));
+  cmd.add(make_option('m', match_dir, "match-dir")
+              .doc("Directory of .isat_match files or a match pack (matchpack_index.isat_mpkx)"));
   cmd.add(make_option('g', geo_dir, "geo-dir").doc("Directory of .isat_geo files"));
   cmd.add(make_option('l', image_list, "image-list")
               .doc("Image list JSON from isat_project extract (required). Defines image_index baseline for SfM."));
@@ -609,6 +627,23 @@ int main(int argc, char* argv[]) {
   int num_threads = 0;  // 0 = auto (use all available cores)
   cmd.add(make_option(0, num_threads, "num-threads")
               .doc("Number of threads for parallel I/O pre-load. Default=0 (all cores)."));
+  int memory_budget_mb = 0;  // 0 = in-memory union-find
+  cmd.add(make_option(0, memory_budget_mb, "memory-budget")
+              .doc("Out-of-core track building: spill matches to sorted runs and build tracks by "
+                   "sort/merge within this many MB of sort buffers (plus 4 B per unique feature). "
+                   "Default=0 (in-memory union-find). Output is identical to the in-memory mode. "
+                   "A match component too large for the budget is replayed past it (warning)."));
+  std::string update_path;
+  cmd.add(make_option(0, update_path, "update")
+              .doc("Existing .isat_tracks to update: only pairs of -i it was not built from are "
+                   "merged in; existing track ids are preserved and merged/split tracks marked. "
+                   "Observations removed by the earlier --min-track-length are not restored."));
+  cmd.add(make_switch(0, "parallel-merge")
+              .doc("Merge large match blocks into the union-find with OpenMP threads (same tracks "
+                   "as the default serial merge; experimental)."));
+  std::string spill_dir;
+  cmd.add(make_option(0, spill_dir, "spill-dir")
+              .doc("Directory for --memory-budget run files (local disk). Default: system temp dir"));
   cmd.add(make_switch(0, "stats").doc("Only load existing IDC and print stats to stderr"));
   std::string log_level;
   cmd.add(make_option(0, log_level, "log-level").doc("Log level: error|warn|info|debug"));
@@ -627,6 +662,7 @@ int main(int argc, char* argv[]) {
     return 0;
   insight::tools::apply_log_level(cmd.used('v'), cmd.used('q'), log_level);
   stats_only = cmd.used("stats");
+  const bool parallel_merge = cmd.used("parallel-merge");
 
   if (output_path.empty()) {
     std::cerr << "Error: -o/--output is required\n\n";
@@ -664,6 +700,12 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
+  if (memory_budget_mb < 0) {
+    std::cerr << "Error: --memory-budget must be >= 0\n\n";
+    cmd.printHelp(std::cerr, argv[0]);
+    return 1;
+  }
+
   if (!fs::is_directory(match_dir)) {
     LOG(ERROR) << "Match directory not found: " << match_dir;
     return 1;
@@ -688,8 +730,17 @@ int main(int argc, char* argv[]) {
     LOG(INFO) << "Using " << omp_get_max_threads() << " threads for parallel I/O (auto)";
   }
 
+  insight::io::MatchPackIndex match_pack;
+  const bool has_match_pack =
+      insight::io::MatchPackIndex::exists_in_dir(match_dir) && match_pack.load_from_dir(match_dir);
+  if (has_match_pack) {
+    match_pack.set_max_open_blocks(static_cast<size_t>(omp_get_max_threads()) + 2);
+    LOG(INFO) << "Match input mode: matchpack_index.isat_mpkx + .isat_matchpack (fallback .isat_match)";
+  }
+
   std::vector<PairDesc> pairs =
-      load_pairs(pairs_json, match_dir, geo_dir, has_geopack ? &geopack_index : nullptr);
+      load_pairs(pairs_json, match_dir, geo_dir, has_geopack ? &geopack_index : nullptr,
+                 has_match_pack ? &match_pack : nullptr);
   if (pairs.empty()) {
     LOG(ERROR) << "No pairs to process";
     return 1;
@@ -702,64 +753,161 @@ int main(int argc, char* argv[]) {
   }
   const int n_images = static_cast<int>(image_indices.size());
 
-  // ── Phase 0+1 combined: block-interleaved I/O + Union-Find ────────────────
-  // Pre-reserve node_id_ to avoid repeated rehash. Estimate: n_images * 512 matched features.
-  UnionFind uf;
-  uf.node_id_.reserve(static_cast<size_t>(n_images) * 512u);
-  uf.parent_.reserve(static_cast<size_t>(n_images) * 512u);
-  uf.component_size_.reserve(static_cast<size_t>(n_images) * 512u);
-  uf.component_images_.reserve(static_cast<size_t>(n_images) * 512u);
-  uf.node_u_.reserve(static_cast<size_t>(n_images) * 512u);
-  uf.node_v_.reserve(static_cast<size_t>(n_images) * 512u);
-  uf.node_s_.reserve(static_cast<size_t>(n_images) * 512u);
-
-  LOG(INFO) << "Phase 0+1: loading+UF " << pairs.size() << " pairs (block-interleaved)...";
-  auto t0 = std::chrono::steady_clock::now();
-  int loaded_count = 0, skipped_count = 0;
-  phase0_1_pipeline(pairs, &uf, loaded_count, skipped_count);
-  auto t1 = std::chrono::steady_clock::now();
-  LOG(INFO) << "Phase 0+1 wall time: "
-            << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << " ms";
-
-  std::unordered_map<int, int> root_to_track_id;
-  root_to_track_id.reserve(uf.node_id_.size());
-  int next_track = 0;
-  for (const auto& kv : uf.node_id_) {
-    int root = uf.find_by_id(kv.second);
-    if (root_to_track_id.find(root) == root_to_track_id.end())
-      root_to_track_id[root] = next_track++;
+  // Every pair the output tracks are built from (canonical, sorted): recorded as source_pairs so
+  // that a later --update merges only pairs that are new.
+  std::set<std::pair<uint32_t, uint32_t>> source_pairs;
+  for (const auto& p : pairs)
+    source_pairs.emplace(std::min(p.image1_index, p.image2_index),
+                         std::max(p.image1_index, p.image2_index));
+
+  // ── --update: load existing tracks, keep only pairs they were not built from ─
+  const bool update_mode = !update_path.empty();
+  TrackStore existing;
+  if (update_mode) {
+    if (memory_budget_mb > 0) {
+      LOG(ERROR) << "--update is not supported together with --memory-budget";
+      return 1;
+    }
+    std::vector<uint32_t> old_indices;
+    ViewGraph old_view_graph;
+    TrackProvenance old_prov;
+    if (!load_track_store_from_idc(update_path, &existing, &old_indices, &old_view_graph) ||
+        !load_track_provenance_from_idc(update_path, &old_prov))
+      return 1;
+    if (old_indices.size() > image_indices.size() ||
+        !std::equal(old_indices.begin(), old_indices.end(), image_indices.begin())) {
+      LOG(ERROR) << "--update: image list of " << update_path << " (" << old_indices.size()
+                 << " images) is not a prefix of " << image_list << " (" << n_images << " images)";
+      return 1;
+    }
+    std::set<std::pair<uint32_t, uint32_t>> done;
+    if (!old_prov.source_pairs.empty()) {
+      for (size_t k = 0; k + 1 < old_prov.source_pairs.size(); k += 2)
+        done.emplace(std::min(old_prov.source_pairs[k], old_prov.source_pairs[k + 1]),
+                     std::max(old_prov.source_pairs[k], old_prov.source_pairs[k + 1]));
+    } else {
+      LOG(WARNING) << "--update: " << update_path << " has no source_pairs blob; pairs in its "
+                   << "view graph are treated as done, all other pairs of -i are merged";
+      for (size_t k = 0; k < old_view_graph.num_pairs(); ++k) {
+        const PairGeoInfo& g = old_view_graph.pair_at(k);
+        done.emplace(std::min(g.image1_index, g.image2_index),
+                     std::max(g.image1_index, g.image2_index));
+      }
+    }
+    source_pairs.insert(done.begin(), done.end());
+    const size_t n_before = pairs.size();
+    pairs.erase(std::remove_if(pairs.begin(), pairs.end(),
+                               [&done](const PairDesc& p) {
+                                 return done.count({std::min(p.image1_index, p.image2_index),
+                                                    std::max(p.image1_index, p.image2_index)}) != 0;
+                               }),
+                pairs.end());
+    LOG(INFO) << "Update: " << existing.num_tracks() << " existing tracks, "
+              << existing.num_observations() << " observations; merging " << pairs.size()
+              << " new pairs (" << (n_before - pairs.size()) << " already in " << update_path << ")";
   }
-  const int num_tracks = next_track;
-  LOG(INFO) << "Phase 1 (UF): " << num_tracks << " tracks from " << uf.node_id_.size()
-            << " unique features";
 
   TrackStore store;
   store.set_num_images(n_images);
-  store.reserve_tracks(static_cast<size_t>(num_tracks));
-  store.reserve_observations(static_cast<size_t>(uf.node_id_.size()));
-  for (int t = 0; t < num_tracks; ++t)
-    store.add_track(0.f, 0.f, 0.f);
-
-  // ── Phase 2: observations from UF node iteration (O(N_unique_features)) ───
-  LOG(INFO) << "Phase 2: filling " << uf.node_id_.size() << " unique feature observations...";
-  auto t2 = std::chrono::steady_clock::now();
-  phase2_from_nodes(&store, uf, root_to_track_id);
-  auto t3 = std::chrono::steady_clock::now();
-  LOG(INFO) << "Phase 2 wall time: "
-            << std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count() << " ms";
-  LOG(INFO) << "Phase 2: " << store.num_observations() << " observations";
-
-  // Release UF (~1.1 GB: node_id_ ~400 MB, node_uvs ~240 MB, component_images_ headers ~480 MB)
-  // and root_to_track_id (~400 MB elements + ~128 MB bucket array) immediately.
-  // Use move-assignment from a default-constructed object to guarantee full deallocation
-  // (including bucket arrays that unordered_map::clear() would retain).
-  uf = UnionFind{};
-  root_to_track_id = std::unordered_map<int,int>();
+  TrackProvenance provenance;
+  int loaded_count = 0, skipped_count = 0;
+  const insight::io::MatchPackIndex* match_pack_ptr = has_match_pack ? &match_pack : nullptr;
+
+  if (memory_budget_mb > 0) {
+    // ── Out-of-core: spill matches to sorted runs, sort/merge into tracks ────
+    ExternalTrackBuilderOptions ext_opts;
+    ext_opts.memory_budget_bytes = static_cast<size_t>(memory_budget_mb) << 20;
+    ext_opts.spill_dir = spill_dir;
+    ExternalTrackBuilder builder(ext_opts);
+    LOG(INFO) << "Phase 0+1: loading+spilling " << pairs.size() << " pairs (memory budget "
+              << memory_budget_mb << " MB, spill dir " << builder.spill_directory() << ")...";
+    auto t0 = std::chrono::steady_clock::now();
+    if (!phase0_1_pipeline(pairs, match_pack_ptr,
+                           [&builder](const std::vector<TrackPairMatches>& block) {
+                             return builder.add_pairs(block);
+                           },
+                           loaded_count, skipped_count)) {
+      LOG(ERROR) << "Failed to spill matches to " << builder.spill_directory();
+      return 1;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    if (!phase1_2_external(&store, &builder))
+      return 1;
+    auto t2 = std::chrono::steady_clock::now();
+    LOG(INFO) << "Phase 0+1 wall time: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count()
+              << " ms, Phase 1+2 (sort/merge) wall time: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << " ms";
+    // builder destructor removes the spill directory.
+  } else {
+    // ── Phase 0+1 combined: block-interleaved I/O + Union-Find ──────────────
+    // Pre-reserve node_id_ to avoid repeated rehash. Estimate: n_images * 512 matched features.
+    TrackUnionFind uf;
+    uf.reserve(static_cast<size_t>(n_images) * 512u);
+    if (update_mode) {
+      const int64_t seed_rejected = seed_union_find_from_track_store(existing, &uf);
+      LOG(INFO) << "Update: seeded UF with " << uf.node_id_.size() << " existing observations"
+                << (seed_rejected > 0 ? " (" + std::to_string(seed_rejected) +
+                                            " rejected: same image twice in one track)"
+                                      : std::string());
+    }
+
+    LOG(INFO) << "Phase 0+1: loading+UF " << pairs.size() << " pairs (block-interleaved)...";
+    auto t0 = std::chrono::steady_clock::now();
+    int64_t merged_total = 0, rejected_total = 0;
+    phase0_1_pipeline(
+        pairs, match_pack_ptr,
+        [&](const std::vector<TrackPairMatches>& block) {
+          const auto tb = std::chrono::steady_clock::now();
+          const TrackMergeStats s = merge_block(uf, block, parallel_merge);
+          merged_total += s.merged;
+          rejected_total += s.rejected;
+          VLOG(1) << "UF block: " << block.size() << " pairs, merged=" << s.merged
+                  << " rejected=" << s.rejected << " rounds=" << s.rounds << " ("
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - tb).count()
+                  << " s)";
+          return true;
+        },
+        loaded_count, skipped_count);
+    auto t1 = std::chrono::steady_clock::now();
+    LOG(INFO) << "Phase 0+1 wall time: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << " ms"
+              << " merged_edges=" << merged_total << " rejected_same_image=" << rejected_total
+              << " unique_nodes=" << uf.node_id_.size();
+
+    // ── Phase 2: observations from UF node iteration (O(N_unique_features)) ─
+    LOG(INFO) << "Phase 2: filling " << uf.node_id_.size() << " unique feature observations...";
+    auto t2 = std::chrono::steady_clock::now();
+    if (update_mode) {
+      const TrackUpdateStats us = build_updated_track_store(
+          existing, uf, n_images, min_track_length, &store, &provenance.track_update_status,
+          &provenance.track_update_link);
+      LOG(INFO) << "Update: unchanged=" << us.unchanged << " extended=" << us.extended
+                << " merged=" << us.merged << " merged_away=" << us.merged_away
+                << " split=" << us.split << " new=" << us.new_tracks
+                << " new_observations=" << us.new_observations
+                << " skipped_short_new=" << us.skipped_short;
+      existing = TrackStore{};
+    } else {
+      phase2_from_nodes(&store, uf);
+    }
+    auto t3 = std::chrono::steady_clock::now();
+    LOG(INFO) << "Phase 2 wall time: "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count() << " ms";
+
+    // Release UF (~1.1 GB: node_id_ ~400 MB, node_uvs ~240 MB, component_images_ headers ~480 MB)
+    // immediately. Use move-assignment from a default-constructed object to guarantee full
+    // deallocation (including bucket arrays that unordered_map::clear() would retain).
+    uf = TrackUnionFind{};
+  }
+  LOG(INFO) << "Tracks: " << store.num_tracks() << " tracks, " << store.num_observations()
+            << " observations";
 
   // ── Optional degree filter ─────────────────────────────────────────────────
+  // (--update applies it to new tracks only, so existing track ids stay valid.)
   const TrackStore* store_to_save = &store;
   TrackStore filtered_store;
-  if (min_track_length > 1) {
+  if (min_track_length > 1 && !update_mode) {
     const FilterStats fstats = compact_tracks_min_degree(store, n_images, min_track_length,
                                                          &filtered_store);
     LOG(INFO) << "Degree filter (min=" << min_track_length << "):"
@@ -772,10 +920,24 @@ int main(int argc, char* argv[]) {
     store = TrackStore{};
   }
 
+  const size_t num_source_pairs = source_pairs.size();
+  provenance.source_pairs.reserve(num_source_pairs * 2);
+  for (const auto& p : source_pairs) {
+    provenance.source_pairs.push_back(p.first);
+    provenance.source_pairs.push_back(p.second);
+  }
+
+  // View graph edges: the -i pairs in input order. With --update -i holds only the new pairs, so
+  // the graph is built from all source_pairs instead.
   std::vector<std::pair<uint32_t, uint32_t>> direct_pairs;
-  direct_pairs.reserve(pairs.size());
-  for (const auto& p : pairs)
-    direct_pairs.emplace_back(p.image1_index, p.image2_index);
+  if (update_mode) {
+    direct_pairs.assign(source_pairs.begin(), source_pairs.end());
+  } else {
+    direct_pairs.reserve(pairs.size());
+    for (const auto& p : pairs)
+      direct_pairs.emplace_back(p.image1_index, p.image2_index);
+  }
+  source_pairs.clear();
 
   ViewGraph view_graph;
   if (!build_view_graph_from_pairs_list_and_track_store(direct_pairs, geo_dir, *store_to_save,
@@ -783,13 +945,16 @@ int main(int argc, char* argv[]) {
     LOG(ERROR) << "Failed to build view graph from pairs list + filtered tracks + geo_dir";
     return 1;
   }
-  if (!save_track_store_to_idc(*store_to_save, image_indices, output_path, &view_graph))
+  TrackSaveOptions save_opts;
+  save_opts.provenance = &provenance;
+  if (!save_track_store_to_idc(*store_to_save, image_indices, output_path, &view_graph, &save_opts))
     return 1;
-  print_event({{"type", "tracks.build"},
+  print_event({{"type", update_mode ? "tracks.update" : "tracks.build"},
               {"ok", true},
               {"data",
                {{"output", output_path},
                 {"min_track_length", min_track_length},
+                {"source_pairs", static_cast<int>(num_source_pairs)},
                 {"num_tracks", static_cast<int>(store_to_save->num_tracks())},
                 {"num_observations", static_cast<int>(store_to_save->num_observations())},
                 {"view_graph_pairs", static_cast<int>(view_graph.num_pairs())}}}});
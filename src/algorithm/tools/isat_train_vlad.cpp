@@ -2,13 +2,15 @@
  * isat_train_vlad.cpp
  * InsightAT VLAD Codebook Training Tool
  *
- * Samples descriptors from .isat_feat files in a directory, runs k-means
- * to obtain VLAD centroids, and optionally trains a PCA model on VLAD
- * vectors for dimensionality reduction. Outputs a binary codebook and
- * optional PCA model for use with isat_retrieve --strategy vlad.
+ * Streams sampled descriptors from .isat_feat files in a directory through a
+ * multi-threaded mini-batch k-means to obtain VLAD centroids, and optionally
+ * trains a PCA model on VLAD vectors for dimensionality reduction. Outputs a
+ * binary codebook and optional PCA model for use with isat_retrieve --strategy vlad.
  *
  * Usage:
  *   isat_train_vlad -f feat_dir/ -o codebook.bin -k 64
+ *   isat_train_vlad -f feat_dir/ -o codebook.bin -k 256 -n 5000000 -b 20000 -j 16 \
+ *       --kmeans-trace kmeans_trace.json
  *   isat_train_vlad -f feat_dir/ -o codebook.bin -k 64 -P pca.bin --pca-dims 128
  */
 
@@ -19,12 +21,12 @@
 #include <glog/logging.h>
 #include <iostream>
 #include <nlohmann/json.hpp>
-#include <random>
 #include <string>
 #include <vector>
 
 #include "../io/idc_reader.h"
 #include "../modules/matching/match_types.h"
+#include "../modules/retrieval/minibatch_kmeans.h"
 #include "../modules/retrieval/pca_whitening.h"
 #include "../modules/retrieval/vlad_encoding.h"
 #include "cli_logging.h"
@@ -42,67 +44,6 @@ static void printEvent(const json& j) {
   std::cout.flush();
 }
 
-/**
- * Sample descriptors from multiple feature files
- */
-std::vector<float> sampleDescriptorsMultiFile(const std::vector<std::string>& feature_files,
-                                              int max_descriptors_per_file, int& total_sampled) {
-  std::vector<float> all_descriptors;
-  total_sampled = 0;
-
-  std::random_device rd;
-  std::mt19937 gen(rd());
-
-  for (const auto& file : feature_files) {
-    IDCReader reader(file);
-    if (!reader.is_valid()) {
-      LOG(WARNING) << "Skipping invalid file: " << file;
-      continue;
-    }
-
-    // Read descriptors
-    auto desc_blob = reader.get_blob_descriptor("descriptors");
-    std::string dtype = desc_blob["dtype"];
-
-    std::vector<float> descriptors;
-    if (dtype == "float32") {
-      descriptors = reader.read_blob<float>("descriptors");
-    } else if (dtype == "uint8") {
-      // uint8 descriptors were scaled by 512 during storage, need to reverse
-      auto desc_uint8 = reader.read_blob<uint8_t>("descriptors");
-      descriptors.resize(desc_uint8.size());
-      for (size_t i = 0; i < desc_uint8.size(); ++i) {
-        descriptors[i] = static_cast<float>(desc_uint8[i]) / 512.0f;
-      }
-    } else {
-      LOG(WARNING) << "Unsupported descriptor type in " << file;
-      continue;
-    }
-
-    int num_features = descriptors.size() / 128;
-
-    // Sample or take all
-    if (num_features <= max_descriptors_per_file) {
-      all_descriptors.insert(all_descriptors.end(), descriptors.begin(), descriptors.end());
-      total_sampled += num_features;
-    } else {
-      // Random sampling
-      std::vector<int> indices(num_features);
-      std::iota(indices.begin(), indices.end(), 0);
-      std::shuffle(indices.begin(), indices.end(), gen);
-
-      for (int i = 0; i < max_descriptors_per_file; ++i) {
-        int idx = indices[i];
-        all_descriptors.insert(all_descriptors.end(), descriptors.begin() + idx * 128,
-                               descriptors.begin() + (idx + 1) * 128);
-      }
-      total_sampled += max_descriptors_per_file;
-    }
-  }
-
-  return all_descriptors;
-}
-
 /**
  * Save centroids to binary file
  */
@@ -192,6 +133,11 @@ int main(int argc, char* argv[]) {
   int max_descriptors = 1000000;
   int max_per_image = 500;
   int max_iterations = 100;
+  int batch_size = 10000;
+  int num_threads = 0;
+  float tolerance = 1e-4f;
+  int seed = 42;
+  std::string kmeans_trace_file;
   int pca_dims = 256;
   float target_scale = 4.0f;
   float scale_sigma = 2.0f;
@@ -208,8 +154,17 @@ int main(int argc, char* argv[]) {
               .doc("Maximum total descriptors for training (default: 1M)"));
   cmd.add(make_option('p', max_per_image, "max-per-image")
               .doc("Maximum descriptors per image (default: 500)"));
-  cmd.add(
-      make_option('i', max_iterations, "iterations").doc("k-means max iterations (default: 100)"));
+  cmd.add(make_option('i', max_iterations, "iterations")
+              .doc("Maximum k-means epochs, i.e. passes over the sampled descriptors (default: 100)"));
+  cmd.add(make_option('b', batch_size, "batch-size")
+              .doc("Descriptors per mini-batch k-means step (default: 10000)"));
+  cmd.add(make_option('j', num_threads, "threads")
+              .doc("k-means worker threads (default: 0 = all cores)"));
+  cmd.add(make_option(0, tolerance, "tol")
+              .doc("Stop when the epoch inertia improves by less than this fraction (default: 1e-4)"));
+  cmd.add(make_option(0, seed, "seed").doc("Random seed for sampling and seeding (default: 42)"));
+  cmd.add(make_option(0, kmeans_trace_file, "kmeans-trace")
+              .doc("Write the per-epoch k-means convergence trace to this JSON file"));
 
   // PCA parameters
   cmd.add(make_option('P', pca_output_file, "pca-output")
@@ -261,6 +216,7 @@ int main(int argc, char* argv[]) {
   LOG(INFO) << "Clusters: " << num_clusters;
   LOG(INFO) << "Max descriptors: " << max_descriptors;
   LOG(INFO) << "Max per image: " << max_per_image;
+  LOG(INFO) << "Batch size: " << batch_size;
 
   // Collect all feature files
   std::vector<std::string> feature_files;
@@ -275,60 +231,72 @@ int main(int argc, char* argv[]) {
     return 1;
   }
 
+  std::sort(feature_files.begin(), feature_files.end());
+
   LOG(INFO) << "Found " << feature_files.size() << " feature files";
 
-  // Sample descriptors
+  // Train k-means: descriptors are streamed per file, so only the current and the prefetched
+  // mini-batch are held in memory. The per-image sample is capped so that one epoch sees at most
+  // max_descriptors descriptors.
   auto start = std::chrono::high_resolution_clock::now();
 
-  int total_sampled = 0;
-  auto descriptors = sampleDescriptorsMultiFile(feature_files, max_per_image, total_sampled);
-
-  auto end_sample = std::chrono::high_resolution_clock::now();
-  auto sample_ms =
-      std::chrono::duration_cast<std::chrono::milliseconds>(end_sample - start).count();
-
-  LOG(INFO) << "Sampled " << total_sampled << " descriptors from " << feature_files.size()
-            << " files in " << sample_ms << "ms";
-
-  if (descriptors.empty()) {
-    LOG(ERROR) << "Failed to sample descriptors";
-    return 1;
-  }
-
-  // Limit total descriptors if needed
-  if (total_sampled > max_descriptors) {
-    LOG(INFO) << "Downsampling from " << total_sampled << " to " << max_descriptors;
-    std::random_device rd;
-    std::mt19937 gen(rd());
-
-    std::vector<int> indices(total_sampled);
-    std::iota(indices.begin(), indices.end(), 0);
-    std::shuffle(indices.begin(), indices.end(), gen);
-
-    std::vector<float> downsampled(max_descriptors * 128);
-    for (int i = 0; i < max_descriptors; ++i) {
-      int idx = indices[i];
-      std::copy(descriptors.begin() + idx * 128, descriptors.begin() + (idx + 1) * 128,
-                downsampled.begin() + i * 128);
-    }
-    descriptors = std::move(downsampled);
-    total_sampled = max_descriptors;
-  }
-
-  // Train k-means
-  LOG(INFO) << "Training k-means with " << total_sampled << " descriptors...";
-  auto centroids = train_k_means(descriptors, num_clusters, max_iterations);
+  const int num_files = static_cast<int>(feature_files.size());
+  const int per_file =
+      std::max(1, std::min(max_per_image, static_cast<int>((static_cast<int64_t>(max_descriptors) +
+                                                            num_files - 1) / num_files)));
+  LOG(INFO) << "Training mini-batch k-means: up to " << per_file << " descriptors per image";
+
+  MiniBatchKMeansOptions kmeans_options;
+  kmeans_options.num_clusters = num_clusters;
+  kmeans_options.batch_size = batch_size;
+  kmeans_options.max_epochs = max_iterations;
+  kmeans_options.convergence_threshold = tolerance;
+  kmeans_options.num_threads = num_threads;
+  kmeans_options.seed = static_cast<uint32_t>(seed);
+
+  json trace = json::array();
+  auto kmeans = train_minibatch_kmeans(
+      feature_file_source(feature_files, per_file, static_cast<uint32_t>(seed)), kmeans_options,
+      [&trace](const KMeansEpochStats& s) {
+        LOG(INFO) << "k-means epoch " << s.epoch << ": inertia=" << s.inertia
+                  << ", center_shift=" << s.center_shift << ", reassigned=" << s.reassigned << ", "
+                  << s.samples << " descriptors in " << static_cast<int64_t>(s.elapsed_ms) << "ms";
+        json e = {{"epoch", s.epoch},
+                  {"samples", s.samples},
+                  {"inertia", s.inertia},
+                  {"center_shift", s.center_shift},
+                  {"reassigned", s.reassigned},
+                  {"elapsed_ms", s.elapsed_ms}};
+        printEvent({{"type", "train_vlad.kmeans_epoch"}, {"data", e}});
+        trace.push_back(std::move(e));
+      });
+  const std::vector<float> centroids = std::move(kmeans.centroids);
+  const int total_sampled = trace.empty() ? 0 : trace.back()["samples"].get<int>();
 
   auto end_train = std::chrono::high_resolution_clock::now();
   auto train_ms =
-      std::chrono::duration_cast<std::chrono::milliseconds>(end_train - end_sample).count();
+      std::chrono::duration_cast<std::chrono::milliseconds>(end_train - start).count();
+
+  if (!kmeans_trace_file.empty()) {
+    std::ofstream ofs(kmeans_trace_file);
+    ofs << json{{"num_clusters", num_clusters},
+                {"batch_size", batch_size},
+                {"converged", kmeans.converged},
+                {"epochs", trace}}
+               .dump(2)
+        << "\n";
+    if (!ofs.good()) {
+      LOG(WARNING) << "Failed to write k-means trace to " << kmeans_trace_file;
+    }
+  }
 
   if (centroids.empty()) {
     LOG(ERROR) << "k-means training failed";
     return 1;
   }
 
-  LOG(INFO) << "k-means training complete in " << train_ms << "ms";
+  LOG(INFO) << "k-means training complete in " << train_ms << "ms (" << trace.size() << " epochs, "
+            << (kmeans.converged ? "converged" : "epoch limit reached") << ")";
 
   // Save codebook
   if (!saveCentroids(output_file, centroids, num_clusters)) {
@@ -477,6 +445,8 @@ int main(int argc, char* argv[]) {
   json data = {{"output_file", output_file},
                {"num_clusters", num_clusters},
                {"total_sampled", total_sampled},
+               {"kmeans_epochs", trace.size()},
+               {"kmeans_converged", kmeans.converged},
                {"total_ms", total_ms}};
   if (enable_pca) {
     data["pca_output_file"] = pca_output_file;
@@ -1,14 +1,22 @@
 /**
  * pair_json_utils.h
- * Helpers for reading pair JSON. Index-only: pairs use image1_index / image2_index only.
+ * Helpers for reading pair lists. Index-only: pairs use image1_index / image2_index only.
+ * Accepts both the binary .isat_pairs list (io/pair_list.h) and legacy pairs JSON.
  */
 #pragma once
 
 #include <cstdint>
+#include <filesystem>
+#include <fstream>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include <glog/logging.h>
 #include <nlohmann/json.hpp>
 
+#include "../io/pair_list.h"
+
 namespace insight {
 namespace tools {
 
@@ -26,5 +34,83 @@ inline uint32_t get_image_index_from_pair(const nlohmann::json& pair, const char
   return static_cast<uint32_t>(std::stoul(v.get<std::string>()));
 }
 
+/** One pair as seen by for_each_pair_in_list; feature paths are nullptr when the list has none. */
+struct PairListEntry {
+  uint32_t image1_index = 0;
+  uint32_t image2_index = 0;
+  float score = 1.0f;
+  uint32_t flags = 0; // insight::io::PairMethodFlags
+  const std::string* feature1_file = nullptr;
+  const std::string* feature2_file = nullptr;
+};
+
+/**
+ * Calls fn(const PairListEntry&) for every pair in a .isat_pairs list (iterated in place over
+ * the mapped file) or a pairs JSON (parsed as before). Returns false if the file is unreadable.
+ */
+template <typename Fn>
+inline bool for_each_pair_in_list(const std::string& path, Fn&& fn) {
+  if (insight::io::is_pair_list_file(path)) {
+    insight::io::PairListReader reader(path);
+    if (!reader.is_valid())
+      return false;
+    for (const auto& r : reader) {
+      PairListEntry e;
+      e.image1_index = r.image1_index;
+      e.image2_index = r.image2_index;
+      e.score = r.score;
+      e.flags = r.flags;
+      const std::string& f1 = reader.feature_file(r.image1_index);
+      const std::string& f2 = reader.feature_file(r.image2_index);
+      e.feature1_file = f1.empty() ? nullptr : &f1;
+      e.feature2_file = f2.empty() ? nullptr : &f2;
+      fn(e);
+    }
+    return true;
+  }
+
+  std::ifstream file(path);
+  if (!file.is_open())
+    return false;
+  nlohmann::json j;
+  try {
+    file >> j;
+  } catch (const std::exception& ex) {
+    LOG(ERROR) << "Invalid pairs JSON " << path << ": " << ex.what();
+    return false;
+  }
+  if (!j.contains("pairs") || !j["pairs"].is_array())
+    return true;
+  std::string f1, f2;
+  for (const auto& pair : j["pairs"]) {
+    PairListEntry e;
+    e.image1_index = get_image_index_from_pair(pair, "image1_index");
+    e.image2_index = get_image_index_from_pair(pair, "image2_index");
+    e.score = pair.value("score", 1.0f);
+    e.flags = insight::io::pair_method_flags_from_string(pair.value("method", std::string()));
+    if (pair.contains("feature1_file") && pair.contains("feature2_file")) {
+      f1 = pair["feature1_file"].get<std::string>();
+      f2 = pair["feature2_file"].get<std::string>();
+      e.feature1_file = &f1;
+      e.feature2_file = &f2;
+    }
+    fn(e);
+  }
+  return true;
+}
+
+/** Output pair list: binary when path ends in .isat_pairs, pairs JSON otherwise. */
+inline bool write_pair_list(const std::string& path,
+                            const std::vector<std::pair<uint32_t, uint32_t>>& pairs,
+                            uint32_t flags = insight::io::kPairMethodNone) {
+  insight::io::PairListWriter writer;
+  writer.reserve(pairs.size());
+  for (const auto& p : pairs)
+    writer.add(p.first, p.second, 1.0f, flags);
+  if (std::filesystem::path(path).extension() == ".isat_pairs")
+    return writer.write(path);
+  return writer.write_json(path);
+}
+
 } // namespace tools
-} // namespace insight
\ No newline at end of file
+} // namespace insight
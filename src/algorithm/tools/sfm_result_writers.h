@@ -0,0 +1,73 @@
+/**
+ * @file  sfm_result_writers.h
+ * @brief Output writers for an SfM result (poses by image index + triangulated TrackStore).
+ *
+ * Shared by isat_incremental_sfm and isat_global_sfm so both produce the same output directory:
+ *   poses.json, bundle.out + list.txt, colmap/sparse/0/{cameras,images,points3D}.txt and
+ *   tracks.isat_tracks (tracks with embedded poses / intrinsics).
+ * Poses are world-to-camera R and camera centre C; only registered images are written.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "../modules/camera/camera_types.h"
+#include "../modules/sfm/track_store.h"
+
+namespace insight {
+namespace tools {
+
+/// Logs "[timing] <label>: N ms" when it goes out of scope.
+class ScopedTimer {
+public:
+  explicit ScopedTimer(std::string label)
+      : label_(std::move(label)), t0_(std::chrono::steady_clock::now()) {}
+  ~ScopedTimer();
+
+private:
+  std::string label_;
+  std::chrono::steady_clock::time_point t0_;
+};
+
+/// poses.json: one entry per registered image (image_index, camera_index, R, C, intrinsics).
+bool write_poses_json(const std::string& path, const std::vector<Eigen::Matrix3d>& poses_R,
+                      const std::vector<Eigen::Vector3d>& poses_C,
+                      const std::vector<bool>& registered,
+                      const std::vector<camera::Intrinsics>& cameras,
+                      const std::vector<int>& image_to_camera_index);
+
+/// Bundler bundle.out + list.txt in \p out_dir (MeshLab).  bundler_max_cameras > 0 uniformly
+/// subsamples the registered cameras.
+bool write_bundler(const std::string& out_dir, const std::vector<std::string>& image_paths,
+                   const std::vector<Eigen::Matrix3d>& poses_R,
+                   const std::vector<Eigen::Vector3d>& poses_C,
+                   const std::vector<bool>& registered,
+                   const std::vector<camera::Intrinsics>& cameras,
+                   const std::vector<int>& image_to_camera_index, const sfm::TrackStore& store,
+                   int bundler_max_cameras = -1);
+
+/// COLMAP sparse text model in \p out_dir/colmap/sparse/0.
+bool write_colmap(const std::string& out_dir, const std::vector<std::string>& image_paths,
+                  const std::vector<Eigen::Matrix3d>& poses_R,
+                  const std::vector<Eigen::Vector3d>& poses_C,
+                  const std::vector<bool>& registered,
+                  const std::vector<camera::Intrinsics>& cameras,
+                  const std::vector<int>& image_to_camera_index, const sfm::TrackStore& store);
+
+/// \p out_dir/tracks.isat_tracks: all tracks plus embedded poses and intrinsics (float and
+/// float64), the input of isat_incremental_sfm --merge-models and the report tools.
+bool save_sfm_result_tracks(const std::string& out_dir, const sfm::TrackStore& store,
+                            const std::vector<Eigen::Matrix3d>& poses_R,
+                            const std::vector<Eigen::Vector3d>& poses_C,
+                            const std::vector<bool>& registered,
+                            const std::vector<camera::Intrinsics>& cameras,
+                            const std::vector<int>& image_to_camera_index);
+
+} // namespace tools
+} // namespace insight